@@ -9,16 +9,39 @@ notExists() {
 }
 
 if notExists "${TMP_PATH}/result.dbtype"; then
-    # shellcheck disable=SC2086
-    "$MMSEQS" search "${QUERYDB}" "${TARGETDB}" "${TMP_PATH}/result" "${TMP_PATH}/search_tmp" ${SEARCH_PAR} \
-        || fail "Search died"
+    if [ -n "${COMPLEX_PREFILTER}" ]; then
+        # target complexes are selected by their sketches, the chain pairs are aligned after expansion
+        SKETCH="${TARGETDB}_sketch"
+        if notExists "${SKETCH}.dbtype"; then
+            SKETCH="${TMP_PATH}/target_sketch"
+            if notExists "${SKETCH}.dbtype"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" createcomplexsketch "${TARGETDB}" "${SKETCH}" ${CREATECOMPLEXSKETCH_PAR} \
+                    || fail "createcomplexsketch died"
+            fi
+        fi
+        # shellcheck disable=SC2086
+        "$MMSEQS" complexprefilter "${QUERYDB}" "${SKETCH}" "${TMP_PATH}/result" ${COMPLEXPREFILTER_PAR} \
+            || fail "complexprefilter died"
+    else
+        # shellcheck disable=SC2086
+        "$MMSEQS" search "${QUERYDB}" "${TARGETDB}" "${TMP_PATH}/result" "${TMP_PATH}/search_tmp" ${SEARCH_PAR} \
+            || fail "Search died"
+    fi
 fi
 
 RESULT="${TMP_PATH}/result"
-if [ "$PREFMODE" != "EXHAUSTIVE" ]; then
+if [ "$PREFMODE" != "EXHAUSTIVE" ] && [ "$MULTIMER_ALIGNMENT_ALGO" = "structurealign" ]; then
+    # expandmultimer, structurealign and scoremultimer in one step, without the expanded databases
+    if notExists "${OUTPUT}.dbtype"; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" alignmultimer "${QUERYDB}" "${TARGETDB}" "${RESULT}" "${OUTPUT}" ${ALIGNMULTIMER_PAR} \
+            || fail "alignmultimer died"
+    fi
+elif [ "$PREFMODE" != "EXHAUSTIVE" ]; then
     if notExists "${TMP_PATH}/result_expand_pref.dbtype"; then
         # shellcheck disable=SC2086
-        "$MMSEQS" expandmultimer "${QUERYDB}" "${TARGETDB}" "${RESULT}" "${RESULT}_expand_pref" ${THREADS_PAR} \
+        "$MMSEQS" expandmultimer "${QUERYDB}" "${TARGETDB}" "${RESULT}" "${RESULT}_expand_pref" ${EXPANDMULTIMER_PAR} \
             || fail "expandmultimer died"
     fi
     if notExists "${TMP_PATH}/result_expand_aligned.dbtype"; then
@@ -49,7 +72,11 @@ fi
 if [ -n "${REMOVE_TMP}" ]; then
     # shellcheck disable=SC2086
     "$MMSEQS" rmdb "${TMP_PATH}/result" ${VERBOSITY}
-    if [ "$PREFMODE" != "EXHAUSTIVE" ]; then
+    if [ -f "${TMP_PATH}/target_sketch.dbtype" ]; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/target_sketch" ${VERBOSITY}
+    fi
+    if [ "$PREFMODE" != "EXHAUSTIVE" ] && [ "$MULTIMER_ALIGNMENT_ALGO" != "structurealign" ]; then
         # shellcheck disable=SC2086
         "$MMSEQS" rmdb "${TMP_PATH}/result_expand_aligned" ${VERBOSITY}
     fi
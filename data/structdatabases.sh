@@ -78,6 +78,45 @@ downloadFileList() {
     fail "Could not download $URL to $OUTPUT"
 }
 
+# with FOLDSEEK_STREAM_DOWNLOAD set, the archive is extracted while it downloads and is never stored,
+# this needs curl or wget and falls back to downloading the archive first
+streamArchive() {
+    URL="$1"
+    DIR="$2"
+    FAILED="${DIR}/stream.failed"
+    set +e
+    for i in $STRATEGY; do
+        rm -f -- "${FAILED}"
+        case "$i" in
+        CURL)
+            { curl -fL "$URL" || touch "${FAILED}"; } | tar xvfz - -C "$DIR" && notExists "${FAILED}" && set -e && return 0
+            ;;
+        WGET)
+            { wget -O - "$URL" || touch "${FAILED}"; } | tar xvfz - -C "$DIR" && notExists "${FAILED}" && set -e && return 0
+            ;;
+        esac
+    done
+    rm -f -- "${FAILED}"
+    set -e
+    return 1
+}
+
+extractArchive() {
+    URL="$1"
+    ARCHIVE="$2"
+    DIR=$(dirname "${ARCHIVE}")
+    if [ -n "${FOLDSEEK_STREAM_DOWNLOAD}" ] && notExists "${ARCHIVE}"; then
+        if streamArchive "$URL" "$DIR"; then
+            return 0
+        fi
+        echo "Could not stream $URL, downloading it first"
+    fi
+    if notExists "${ARCHIVE}"; then
+        downloadFile "$URL" "${ARCHIVE}"
+    fi
+    tar xvfz "${ARCHIVE}" -C "$DIR"
+}
+
 # check number of input variables
 [ "$#" -ne 3 ] && echo "Please provide <selection> <outDB> <tmp>" && exit 1;
 [ ! -d "$3" ] &&  echo "tmp directory $3 not found!" && mkdir -p "$3";
@@ -90,48 +129,42 @@ INPUT_TYPE=""
 case "${SELECTION}" in
     "Alphafold/UniProt")
         if notExists "${TMP_PATH}/afdb.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/afdb.tar.gz" "${TMP_PATH}/afdb.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/afdb.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/afdb.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/afdb.tar.gz" "${TMP_PATH}/afdb.tar.gz"
         push_back "${TMP_PATH}/afdb"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
     "Alphafold/UniProt50-minimal")
         if notExists "${TMP_PATH}/afdb50.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/afdb50.tar.gz" "${TMP_PATH}/afdb50.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/afdb50.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/afdb50.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/afdb50.tar.gz" "${TMP_PATH}/afdb50.tar.gz"
         push_back "${TMP_PATH}/afdb50"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
     "Alphafold/UniProt50")
         if notExists "${TMP_PATH}/afdb50.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/afdb50.tar.gz" "${TMP_PATH}/afdb50.tar.gz"
-            downloadFile "https://foldseek.steineggerlab.workers.dev/afdb50clusearch.tar.gz" "${TMP_PATH}/afdb50clusearch.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/afdb50.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/afdb50.tar.gz" -C "${TMP_PATH}"
-        tar xvfz "${TMP_PATH}/afdb50clusearch.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/afdb50.tar.gz" "${TMP_PATH}/afdb50.tar.gz"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/afdb50clusearch.tar.gz" "${TMP_PATH}/afdb50clusearch.tar.gz"
         push_back "${TMP_PATH}/afdb50"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
     "Alphafold/Proteome")
         if notExists "${TMP_PATH}/afdb_proteome.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/afdb_proteome.tar.gz" "${TMP_PATH}/afdb_proteome.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/afdb_proteome.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/afdb_proteome.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/afdb_proteome.tar.gz" "${TMP_PATH}/afdb_proteome.tar.gz"
         push_back "${TMP_PATH}/afdb_proteome"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
     "Alphafold/Swiss-Prot")
         if notExists "${TMP_PATH}/afdb_swissprot.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/afdb_swissprot.tar.gz" "${TMP_PATH}/afdb_swissprot.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/afdb_swissprot.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/afdb_swissprot.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/afdb_swissprot.tar.gz" "${TMP_PATH}/afdb_swissprot.tar.gz"
         push_back "${TMP_PATH}/afdb_swissprot"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
@@ -143,28 +176,25 @@ case "${SELECTION}" in
     ;;
     "PDB")
         if notExists "${TMP_PATH}/pdb.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/pdb100.tar.gz" "${TMP_PATH}/pdb.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/pdb100.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/pdb.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/pdb100.tar.gz" "${TMP_PATH}/pdb.tar.gz"
         push_back "${TMP_PATH}/pdb"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
     "CATH50")
         if notExists "${TMP_PATH}/cath50.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/cath50.tar.gz" "${TMP_PATH}/cath50.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/cath50.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/cath50.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/cath50.tar.gz" "${TMP_PATH}/cath50.tar.gz"
         push_back "${TMP_PATH}/cath50"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
     "BFMD")
         if notExists "${TMP_PATH}/bfmd.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/bfmd.tar.gz" "${TMP_PATH}/bfmd.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/bfmd.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/bfmd.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/bfmd.tar.gz" "${TMP_PATH}/bfmd.tar.gz"
         push_back "${TMP_PATH}/bfmd"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
@@ -179,28 +209,25 @@ case "${SELECTION}" in
     ;;
     "BFVD")
         if notExists "${TMP_PATH}/bfvd.tar.gz"; then
-            downloadFile "https://bfvd.steineggerlab.workers.dev/bfvd_foldseekdb.tar.gz" "${TMP_PATH}/bfvd.tar.gz"
             downloadFile "https://bfvd.steineggerlab.workers.dev/bfvd.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/bfvd.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://bfvd.steineggerlab.workers.dev/bfvd_foldseekdb.tar.gz" "${TMP_PATH}/bfvd.tar.gz"
         push_back "${TMP_PATH}/bfvd"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
     "TED")
         if notExists "${TMP_PATH}/teddb.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/teddb.tar.gz" "${TMP_PATH}/teddb.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/teddb.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/teddb.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/teddb.tar.gz" "${TMP_PATH}/teddb.tar.gz"
         push_back "${TMP_PATH}/teddb"
         INPUT_TYPE="FOLDSEEK_DB"
     ;;
     "TED50")
         if notExists "${TMP_PATH}/teddb_afdb50.tar.gz"; then
-            downloadFile "https://foldseek.steineggerlab.workers.dev/teddb_afdb50.tar.gz" "${TMP_PATH}/teddb_afdb50.tar.gz"
             downloadFile "https://foldseek.steineggerlab.workers.dev/teddb_afdb50.version" "${TMP_PATH}/version"
         fi
-        tar xvfz "${TMP_PATH}/teddb_afdb50.tar.gz" -C "${TMP_PATH}"
+        extractArchive "https://foldseek.steineggerlab.workers.dev/teddb_afdb50.tar.gz" "${TMP_PATH}/teddb_afdb50.tar.gz"
         push_back "${TMP_PATH}/teddb_afdb50"
         INPUT_TYPE="FOLDSEEK_DB"
 esac
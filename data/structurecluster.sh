@@ -40,6 +40,21 @@ buildMergedDb() {
     cp "${2}.dbtype" "${3}.dbtype"
 }
 
+# Merge the TM-align results of the previous steps into a pair cache,
+# the next TM-align step reuses these pairs instead of realigning them
+# $1: output cache db
+setPairCache() {
+    PAIR_CACHE_PAR=""
+    if [ -n "${PAIR_CACHE}" ] && [ -n "${PAIR_CACHE_DBS}" ]; then
+        if notExists "${1}.dbtype"; then
+            # shellcheck disable=SC2086
+            "$MMSEQS" mergedbs "$SOURCE" "$1" ${PAIR_CACHE_DBS} ${VERBOSITY} \
+                || fail "Merging of pair cache died"
+        fi
+        PAIR_CACHE_PAR="--pair-cache $1"
+    fi
+}
+
 
 
 # check number of input variables
@@ -52,6 +67,7 @@ buildMergedDb() {
 INPUT="$1"
 TMP_PATH="$3"
 SOURCE="$INPUT"
+PAIR_CACHE_DBS=""
 
 if [ "${RUN_LINCLUST}" = "1" ]; then
 
@@ -62,63 +78,79 @@ if [ "${RUN_LINCLUST}" = "1" ]; then
           || fail "kmermatcher died"
   fi
 
-  # 2. Hamming distance pre-clustering
-  if notExists "${TMP_PATH}/pref_rescore1.dbtype"; then
-      # shellcheck disable=SC2086
-      $RUNNER "$MMSEQS" structurerescorediagonal "${INPUT}" "${INPUT}" "${TMP_PATH}/pref" "${TMP_PATH}/pref_rescore1" ${STRUCTURERESCOREDIAGONAL_PAR} \
-          || fail "Rescore with hamming distance step died"
-  fi
+  if [ -n "${STRUCTURELINCLUST_PAR}" ]; then
+      # 2.-4. Rescoring, pre-clustering, alignment and clustering in memory
+      if notExists "${TMP_PATH}/clu_redundancy.dbtype"; then
+          if [ "${RUN_ITERATIVE}" = "1" ]; then
+              # shellcheck disable=SC2086
+              $RUNNER "$MMSEQS" structurelinclust "${INPUT}" "${TMP_PATH}/pref" "${TMP_PATH}/clu_redundancy" ${STRUCTURELINCLUST_PAR} \
+                  || fail "Structure linclust step died"
+          else
+              # shellcheck disable=SC2086
+              $RUNNER "$MMSEQS" structurelinclust "${INPUT}" "${TMP_PATH}/pref" "$2" ${STRUCTURELINCLUST_PAR} \
+                  || fail "Structure linclust step died"
+          fi
+      fi
+  else
+      # 2. Hamming distance pre-clustering
+      if notExists "${TMP_PATH}/pref_rescore1.dbtype"; then
+          # shellcheck disable=SC2086
+          $RUNNER "$MMSEQS" structurerescorediagonal "${INPUT}" "${INPUT}" "${TMP_PATH}/pref" "${TMP_PATH}/pref_rescore1" ${STRUCTURERESCOREDIAGONAL_PAR} \
+              || fail "Rescore with hamming distance step died"
+      fi
 
-  if notExists "${TMP_PATH}/pre_clust.dbtype"; then
-      # shellcheck disable=SC2086,SC2153
-      "$MMSEQS" clust "$INPUT" "${TMP_PATH}/pref_rescore1" "${TMP_PATH}/pre_clust" ${CLUSTER_PAR} \
-          || fail "Pre-clustering step died"
-  fi
+      if notExists "${TMP_PATH}/pre_clust.dbtype"; then
+          # shellcheck disable=SC2086,SC2153
+          "$MMSEQS" clust "$INPUT" "${TMP_PATH}/pref_rescore1" "${TMP_PATH}/pre_clust" ${CLUSTER_PAR} \
+              || fail "Pre-clustering step died"
+      fi
 
-  awk '{ print $1 }' "${TMP_PATH}/pre_clust.index" > "${TMP_PATH}/order_redundancy"
+      awk '{ print $1 }' "${TMP_PATH}/pre_clust.index" > "${TMP_PATH}/order_redundancy"
 
-  if notExists "${TMP_PATH}/pref_filter1.dbtype"; then
-      # shellcheck disable=SC2086
-      "$MMSEQS" createsubdb "${TMP_PATH}/order_redundancy" "${TMP_PATH}/pref" "${TMP_PATH}/pref_filter1" ${VERBOSITY} --subdb-mode 1 \
-          || fail "Createsubdb step died"
-  fi
+      if notExists "${TMP_PATH}/pref_filter1.dbtype"; then
+          # shellcheck disable=SC2086
+          "$MMSEQS" createsubdb "${TMP_PATH}/order_redundancy" "${TMP_PATH}/pref" "${TMP_PATH}/pref_filter1" ${VERBOSITY} --subdb-mode 1 \
+              || fail "Createsubdb step died"
+      fi
 
-  if notExists "${TMP_PATH}/pref_filter2.dbtype"; then
-      # shellcheck disable=SC2086
-      "$MMSEQS" filterdb "${TMP_PATH}/pref_filter1" "${TMP_PATH}/pref_filter2" --filter-file "${TMP_PATH}/order_redundancy" ${VERBOSITYANDCOMPRESS} \
-          || fail "Filterdb step died"
-  fi
+      if notExists "${TMP_PATH}/pref_filter2.dbtype"; then
+          # shellcheck disable=SC2086
+          "$MMSEQS" filterdb "${TMP_PATH}/pref_filter1" "${TMP_PATH}/pref_filter2" --filter-file "${TMP_PATH}/order_redundancy" ${VERBOSITYANDCOMPRESS} \
+              || fail "Filterdb step died"
+      fi
 
-  # 3. Local gapped sequence alignment.
-  if notExists "${TMP_PATH}/aln.linclust.dbtype"; then
-      # shellcheck disable=SC2086
-      $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${INPUT}${ALN_EXTENSION}" \
-          "${INPUT}${ALN_EXTENSION}" "${TMP_PATH}/pref_filter2" \
-          "${TMP_PATH}/aln.linclust" ${ALIGNMENT_PAR} || fail "Alignment step died"
-  fi
+      # 3. Local gapped sequence alignment.
+      if notExists "${TMP_PATH}/aln.linclust.dbtype"; then
+          # shellcheck disable=SC2086
+          $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${INPUT}${ALN_EXTENSION}" \
+              "${INPUT}${ALN_EXTENSION}" "${TMP_PATH}/pref_filter2" \
+              "${TMP_PATH}/aln.linclust" ${ALIGNMENT_PAR} || fail "Alignment step died"
+      fi
+      PAIR_CACHE_DBS="${TMP_PATH}/aln.linclust"
 
-  if notExists "${TMP_PATH}/pre_clustered_seqs.dbtype"; then
-      # shellcheck disable=SC2086
-      "$MMSEQS" createsubdb "${TMP_PATH}/order_redundancy" "${INPUT}" "${TMP_PATH}/pre_clustered_seqs" ${VERBOSITY} --subdb-mode 1 \
-          || fail "Createsubdb pre_clustered_seqs step died"
-  fi
+      if notExists "${TMP_PATH}/pre_clustered_seqs.dbtype"; then
+          # shellcheck disable=SC2086
+          "$MMSEQS" createsubdb "${TMP_PATH}/order_redundancy" "${INPUT}" "${TMP_PATH}/pre_clustered_seqs" ${VERBOSITY} --subdb-mode 1 \
+              || fail "Createsubdb pre_clustered_seqs step died"
+      fi
 
-  # 4. Clustering using greedy set cover.
-  if notExists "${TMP_PATH}/clust.linclust.dbtype"; then
-      # shellcheck disable=SC2086,SC2153
-      "$MMSEQS" clust "${TMP_PATH}/pre_clustered_seqs" "${TMP_PATH}/aln.linclust" "${TMP_PATH}/clust.linclust" ${CLUSTER_PAR} \
-          || fail "Clustering step died"
-  fi
+      # 4. Clustering using greedy set cover.
+      if notExists "${TMP_PATH}/clust.linclust.dbtype"; then
+          # shellcheck disable=SC2086,SC2153
+          "$MMSEQS" clust "${TMP_PATH}/pre_clustered_seqs" "${TMP_PATH}/aln.linclust" "${TMP_PATH}/clust.linclust" ${CLUSTER_PAR} \
+              || fail "Clustering step died"
+      fi
 
-  if notExists "${TMP_PATH}/clu_redundancy.dbtype"; then
-      if [ "${RUN_ITERATIVE}" = "1" ]; then
-        # shellcheck disable=SC2086
-         "$MMSEQS" mergeclusters "$SOURCE" "${TMP_PATH}/clu_redundancy" "${TMP_PATH}/pre_clust" "${TMP_PATH}/clust.linclust" ${MERGECLU_PAR} \
-            || fail "mergeclusters died"
-      else
-         # shellcheck disable=SC2086
-         "$MMSEQS" mergeclusters "$SOURCE" "$2" "${TMP_PATH}/pre_clust" "${TMP_PATH}/clust.linclust" ${MERGECLU_PAR} \
-            || fail "mergeclusters died"
+      if notExists "${TMP_PATH}/clu_redundancy.dbtype"; then
+          if [ "${RUN_ITERATIVE}" = "1" ]; then
+            # shellcheck disable=SC2086
+             "$MMSEQS" mergeclusters "$SOURCE" "${TMP_PATH}/clu_redundancy" "${TMP_PATH}/pre_clust" "${TMP_PATH}/clust.linclust" ${MERGECLU_PAR} \
+                || fail "mergeclusters died"
+          else
+             # shellcheck disable=SC2086
+             "$MMSEQS" mergeclusters "$SOURCE" "$2" "${TMP_PATH}/pre_clust" "${TMP_PATH}/clust.linclust" ${MERGECLU_PAR} \
+                || fail "mergeclusters died"
+          fi
       fi
   fi
 fi
@@ -143,19 +175,30 @@ if [ "${RUN_ITERATIVE}" = "1" ]; then
           $RUNNER "$MMSEQS" prefilter "${INPUT}_ss" "${INPUT}_ss" "${TMP_PATH}/pref_step$STEP" ${TMP} \
               || fail "Prefilter step $STEP died"
       fi
-      PARAM=ALIGNMENT${STEP}_PAR
-      eval TMP="\$$PARAM"
-      if notExists "${TMP_PATH}/aln_step$STEP.dbtype"; then
-          # shellcheck disable=SC2086
-          $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${INPUT}${ALN_EXTENTION}" "${INPUT}${ALN_EXTENTION}" "${TMP_PATH}/pref_step$STEP" "${TMP_PATH}/aln_step$STEP" ${ALIGNMENT_PAR} \
-              || fail "Alignment step $STEP died"
-      fi
-      PARAM=CLUSTER${STEP}_PAR
-      eval TMP="\$$PARAM"
-      if notExists "${TMP_PATH}/clu_step$STEP.dbtype"; then
-           # shellcheck disable=SC2086
-          "$MMSEQS" clust "${INPUT}" "${TMP_PATH}/aln_step$STEP" "${TMP_PATH}/clu_step$STEP" ${TMP} \
-              || fail "Clustering step $STEP died"
+      if [ -n "${GREEDY_ALIGN_CLUSTER}" ]; then
+          # alignment and greedy clustering in one pass, skips the alignments of decided structures
+          if notExists "${TMP_PATH}/clu_step$STEP.dbtype"; then
+              # shellcheck disable=SC2086
+              "$MMSEQS" structuregreedyclust "${INPUT}" "${TMP_PATH}/pref_step$STEP" "${TMP_PATH}/clu_step$STEP" ${ALIGNMENT_PAR} \
+                  || fail "Alignment and clustering step $STEP died"
+          fi
+      else
+          PARAM=ALIGNMENT${STEP}_PAR
+          eval TMP="\$$PARAM"
+          if notExists "${TMP_PATH}/aln_step$STEP.dbtype"; then
+              setPairCache "${TMP_PATH}/aln_cache_step$STEP"
+              # shellcheck disable=SC2086
+              $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${INPUT}${ALN_EXTENTION}" "${INPUT}${ALN_EXTENTION}" "${TMP_PATH}/pref_step$STEP" "${TMP_PATH}/aln_step$STEP" ${ALIGNMENT_PAR} ${PAIR_CACHE_PAR} \
+                  || fail "Alignment step $STEP died"
+          fi
+          PAIR_CACHE_DBS="${PAIR_CACHE_DBS} ${TMP_PATH}/aln_step$STEP"
+          PARAM=CLUSTER${STEP}_PAR
+          eval TMP="\$$PARAM"
+          if notExists "${TMP_PATH}/clu_step$STEP.dbtype"; then
+               # shellcheck disable=SC2086
+              "$MMSEQS" clust "${INPUT}" "${TMP_PATH}/aln_step$STEP" "${TMP_PATH}/clu_step$STEP" ${TMP} \
+                  || fail "Clustering step $STEP died"
+          fi
       fi
 
       # FIXME: This won't work if paths contain spaces
@@ -191,10 +234,12 @@ if [ -n "$REASSIGN" ]; then
     STEP=$((STEP-1))
     PARAM=ALIGNMENT${STEP}_PAR
     eval ALIGNMENT_PAR="\$$PARAM"
+    # most members were already aligned to their representative in an earlier step
+    setPairCache "${TMP_PATH}/aln_cache_reassign"
     # align to cluster sequences
     if notExists "${TMP_PATH}/aln.dbtype"; then
         # shellcheck disable=SC2086
-        $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${SOURCE}${ALN_EXTENTION}" "${SOURCE}${ALN_EXTENTION}" "${TMP_PATH}/clu" "${TMP_PATH}/aln" ${ALIGNMENT_PAR} \
+        $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${SOURCE}${ALN_EXTENTION}" "${SOURCE}${ALN_EXTENTION}" "${TMP_PATH}/clu" "${TMP_PATH}/aln" ${ALIGNMENT_PAR} ${PAIR_CACHE_PAR} \
                 || fail "Alignment step $STEP died"
     fi
     # create file of cluster that do not align based on given criteria
@@ -219,6 +264,8 @@ if [ -n "$REASSIGN" ]; then
             "$MMSEQS" rmdb "${TMP_PATH}/clu_not_accepted" ${VERBOSITY}
             # shellcheck disable=SC2086
             "$MMSEQS" rmdb "${TMP_PATH}/aln" ${VERBOSITY}
+            # shellcheck disable=SC2086
+            "$MMSEQS" rmdb "${TMP_PATH}/aln_cache_reassign" ${VERBOSITY}
         fi
     else
         # create file of cluster that do align based on given criteria
@@ -268,7 +315,7 @@ if [ -n "$REASSIGN" ]; then
         if notExists "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln.dbtype"; then
             # shellcheck disable=SC2086
             $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${TMP_PATH}/seq_seeds.merged${ALN_EXTENTION}" "${TMP_PATH}/seq_wrong_assigned${ALN_EXTENTION}" \
-                                              "${TMP_PATH}/seq_wrong_assigned_pref_swaped" "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln" ${ALIGNMENT_REASSIGN_PAR} \
+                                              "${TMP_PATH}/seq_wrong_assigned_pref_swaped" "${TMP_PATH}/seq_wrong_assigned_pref_swaped_aln" ${ALIGNMENT_REASSIGN_PAR} ${PAIR_CACHE_PAR} \
                      || fail "align2 reassign died"
         fi
 
@@ -311,6 +358,8 @@ if [ -n "$REASSIGN" ]; then
             # shellcheck disable=SC2086
             "$MMSEQS" rmdb "${TMP_PATH}/aln" ${VERBOSITY}
             # shellcheck disable=SC2086
+            "$MMSEQS" rmdb "${TMP_PATH}/aln_cache_reassign" ${VERBOSITY}
+            # shellcheck disable=SC2086
             "$MMSEQS" rmdb "${TMP_PATH}/clu_not_accepted" ${VERBOSITY}
             # shellcheck disable=SC2086
             "$MMSEQS" rmdb "${TMP_PATH}/clu_accepted" ${VERBOSITY}
@@ -358,6 +407,8 @@ if [ -n "$REMOVE_TMP" ]; then
           # shellcheck disable=SC2086
           "$MMSEQS" rmdb "${TMP_PATH}/aln_step$STEP" ${VERBOSITY}
           # shellcheck disable=SC2086
+          "$MMSEQS" rmdb "${TMP_PATH}/aln_cache_step$STEP" ${VERBOSITY}
+          # shellcheck disable=SC2086
           "$MMSEQS" rmdb "${TMP_PATH}/clu_step$STEP" ${VERBOSITY}
           STEP=$((STEP+1))
       done
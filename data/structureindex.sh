@@ -40,6 +40,25 @@ fi
 "$MMSEQS" mmcreateindex "${DB}_ss" "${TMP_PATH}" ${CREATEINDEX_PAR} --index-subset ${SS_SUBSET_MODE} --index-dbsuffix "_ss" \
     || fail "createindex died"
 
+# entries added to the DB since the last createindex invalidate the per-entry data
+if notExists "${DB}_mulambda.dbtype" || [ "${DB}.index" -nt "${DB}_mulambda.index" ]; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" createmulambda "${DB}" "${DB}_mulambda" ${MULAMBDA_PAR} \
+        || fail "createmulambda died"
+fi
+
+if [ -f "${DB}.lookup" ] && { notExists "${DB}_complex.dbtype" || notExists "${DB}_symmetry.dbtype" || [ "${DB}.lookup" -nt "${DB}_complex.index" ]; }; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" createcomplexlookup "${DB}" ${THREADS_PAR} \
+        || fail "createcomplexlookup died"
+fi
+
+if [ -n "$EMBEDDING_INDEX" ] && { notExists "${DB}_emb.dbtype" || [ "${DB}_ss.index" -nt "${DB}_emb.index" ]; }; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" createembeddingindex "${DB}" "${DB}_emb" ${EMBEDDING_PAR} \
+        || fail "createembeddingindex died"
+fi
+
 if [ -n "$INCLUDE_CA" ]; then
     if [ -z "$(awk -v key="${INDEX_DB_CA_KEY_DB1}" '$1 == key;' "${DB}.idx.index")" ]; then
         # shellcheck disable=SC2086
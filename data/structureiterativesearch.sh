@@ -17,6 +17,20 @@ if [ -z "$NUM_IT" ]; then
     NUM_IT=3
 fi
 while [ "$STEP" -lt "$NUM_IT" ]; do
+    # in incremental mode intermediate iterations only search with queries that found new hits in the previous
+    # iteration, the profiles of converged queries did not change and would not find anything new.
+    # all queries take part in the last iteration, which uses the final e-value threshold.
+    SEARCHDB="${QUERYDB}"
+    if [ -n "$INCREMENTAL" ] && [ "$STEP" -ge 2 ] && [ "$STEP" -lt $((NUM_IT - 1)) ]; then
+        STEPONE=$((STEP-1))
+        SEARCHDB="$TMP_PATH/profile_active_${STEPONE}"
+        if notExists "${SEARCHDB}.dbtype"; then
+            # shellcheck disable=SC2086
+            "$MMSEQS" createsubdb "$TMP_PATH/active_${STEPONE}" "${QUERYDB}" "${SEARCHDB}" --subdb-mode 1 ${VERBOSITY} \
+                || fail "createsubdb died"
+        fi
+    fi
+
     # call prefilter module
     if notExists "$TMP_PATH/pref_tmp_${STEP}.done"; then
         PARAM="PREFILTER_PAR_$STEP"
@@ -33,7 +47,7 @@ while [ "$STEP" -lt "$NUM_IT" ]; do
                 || fail "Prefilter died"
         else
             # shellcheck disable=SC2086
-            $RUNNER "$MMSEQS" $TOOL "${QUERYDB}_ss" "${TARGET_PREFILTER}${INDEXEXT}" "$TMP_PATH/pref_tmp_${STEP}" ${TMP} \
+            $RUNNER "$MMSEQS" $TOOL "${SEARCHDB}_ss" "${TARGET_PREFILTER}${INDEXEXT}" "$TMP_PATH/pref_tmp_${STEP}" ${TMP} \
                 || fail "Prefilter died"
         fi
         touch "$TMP_PATH/pref_tmp_${STEP}.done"
@@ -62,7 +76,7 @@ while [ "$STEP" -lt "$NUM_IT" ]; do
                 || fail "Alignment died"
         else
             # shellcheck disable=SC2086
-            $RUNNER "$MMSEQS" "${ALIGNMENT_ALGO}" "${QUERYDB}" "${TARGET_ALIGNMENT}${INDEXEXT}" "$TMP_PATH/pref_${STEP}" "$TMP_PATH/aln_tmp_${STEP}" ${TMP} \
+            $RUNNER "$MMSEQS" "${ALIGNMENT_ALGO}" "${SEARCHDB}" "${TARGET_ALIGNMENT}${INDEXEXT}" "$TMP_PATH/pref_${STEP}" "$TMP_PATH/aln_tmp_${STEP}" ${TMP} \
                 || fail "Alignment died"
         fi
         touch "$TMP_PATH/aln_tmp_$STEP.done"
@@ -99,6 +113,19 @@ while [ "$STEP" -lt "$NUM_IT" ]; do
                       || fail "Merge died"
                 fi
             fi
+            if [ -n "$INCREMENTAL" ] && [ $((STEP + 1)) -lt $((NUM_IT - 1)) ]; then
+                # queries with at least one new hit
+                # shellcheck disable=SC2086
+                "$MMSEQS" result2stats "${QUERYDB}" "${TARGET_ALIGNMENT}${INDEXEXT}" "$TMP_PATH/aln_tmp_${STEP}" "$TMP_PATH/hitcount_${STEP}" --stat linecount ${VERBOSITY_THREADS_PAR} \
+                    || fail "result2stats died"
+                # shellcheck disable=SC2086
+                "$MMSEQS" prefixid "$TMP_PATH/hitcount_${STEP}" "$TMP_PATH/hitcount_${STEP}.tsv" --tsv 1 ${VERBOSITY_THREADS_PAR} \
+                    || fail "prefixid died"
+                awk '$2 > 0 { print $1 }' "$TMP_PATH/hitcount_${STEP}.tsv" > "$TMP_PATH/active_${STEP}"
+                # shellcheck disable=SC2086
+                "$MMSEQS" rmdb "$TMP_PATH/hitcount_${STEP}" ${VERBOSITY}
+                rm -f -- "$TMP_PATH/hitcount_${STEP}.tsv"
+            fi
             # shellcheck disable=SC2086
             "$MMSEQS" rmdb "$TMP_PATH/aln_${STEPONE}" ${VERBOSITY}
             # shellcheck disable=SC2086
@@ -136,6 +163,15 @@ if [ -n "$REMOVE_TMP" ]; then
         "$MMSEQS" rmdb "${TMP_PATH}/profile_${STEP}_ss" ${VERBOSITY}
         # shellcheck disable=SC2086
         "$MMSEQS" rmdb "${TMP_PATH}/profile_${STEP}_h" ${VERBOSITY}
+        if [ -n "$INCREMENTAL" ]; then
+            # shellcheck disable=SC2086
+            "$MMSEQS" rmdb "${TMP_PATH}/profile_active_${STEP}" ${VERBOSITY}
+            # shellcheck disable=SC2086
+            "$MMSEQS" rmdb "${TMP_PATH}/profile_active_${STEP}_ss" ${VERBOSITY}
+            # shellcheck disable=SC2086
+            "$MMSEQS" rmdb "${TMP_PATH}/profile_active_${STEP}_ca" ${VERBOSITY}
+            rm -f -- "$TMP_PATH/active_${STEP}"
+        fi
         STEP=$((STEP+1))
     done
     if [ -n "${EXPAND}" ]; then
@@ -22,19 +22,13 @@ B_DB="$2"
 RBH_RES="$3"
 TMP_PATH="$4"
 
-# search in both directions:
+# search A vs. B, B vs. A follows once the best A->B hits are known:
 if [ ! -e "${TMP_PATH}/resAB.dbtype" ]; then
     # shellcheck disable=SC2086
     "$MMSEQS" search "${A_DB}" "${B_DB}" "${TMP_PATH}/resAB" "${TMP_PATH}/tempAB" ${SEARCH_A_B_PAR} \
         || fail "search A vs. B died"
 fi
 
-if [ ! -e "${TMP_PATH}/resBA.dbtype" ]; then
-    # shellcheck disable=SC2086
-    "$MMSEQS" search "${B_DB}" "${A_DB}" "${TMP_PATH}/resBA" "${TMP_PATH}/tempBA" ${SEARCH_B_A_PAR} \
-        || fail "search B vs. A died"
-fi
-
 # sort A->B by decreasing bitscores:
 if [ ! -e "${TMP_PATH}/resAB_sorted.dbtype" ]; then
     # shellcheck disable=SC2086
@@ -49,6 +43,28 @@ if [ ! -e "${TMP_PATH}/resA_best_B.dbtype" ]; then
         || fail "extract A best B died"
 fi
 
+# only B entries that are the best hit of an A entry can be a reciprocal best hit
+B_QUERY_DB="${B_DB}"
+if [ -n "${RBH_BEST_ONLY}" ]; then
+    if [ ! -e "${TMP_PATH}/B_best.dbtype" ]; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" prefixid "${TMP_PATH}/resA_best_B" "${TMP_PATH}/resA_best_B.tsv" --tsv 1 ${THREADS_COMP_PAR} \
+            || fail "prefixid died"
+        awk '{ print $2 }' "${TMP_PATH}/resA_best_B.tsv" | sort -u -n > "${TMP_PATH}/B_best.list"
+        # shellcheck disable=SC2086
+        "$MMSEQS" createsubdb "${TMP_PATH}/B_best.list" "${B_DB}" "${TMP_PATH}/B_best" --subdb-mode 1 ${VERBOSITY} \
+            || fail "createsubdb died"
+        rm -f -- "${TMP_PATH}/resA_best_B.tsv" "${TMP_PATH}/B_best.list"
+    fi
+    B_QUERY_DB="${TMP_PATH}/B_best"
+fi
+
+if [ ! -e "${TMP_PATH}/resBA.dbtype" ]; then
+    # shellcheck disable=SC2086
+    "$MMSEQS" search "${B_QUERY_DB}" "${A_DB}" "${TMP_PATH}/resBA" "${TMP_PATH}/tempBA" ${SEARCH_B_A_PAR} \
+        || fail "search B vs. A died"
+fi
+
 # extract best hit(s) in B->A direction:
 if [ ! -e "${TMP_PATH}/resB_best_A.dbtype" ]; then
     # shellcheck disable=SC2086
@@ -112,5 +128,15 @@ if [ -n "$REMOVE_TMP" ]; then
     "$MMSEQS" rmdb "${TMP_PATH}/res_best_merged_sorted_aln" ${VERBOSITY}
     # shellcheck disable=SC2086
     "$MMSEQS" rmdb "${TMP_PATH}/res_best_merged" ${VERBOSITY}
+    if [ -n "${RBH_BEST_ONLY}" ]; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/B_best" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/B_best_ss" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/B_best_ca" ${VERBOSITY}
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/B_best_h" ${VERBOSITY}
+    fi
     rm -f "${TMP_PATH}/rbh.sh"
 fi
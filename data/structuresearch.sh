@@ -37,10 +37,106 @@ fake_pref() {
     awk 'BEGIN { printf("%c%c%c%c",7,0,0,0); exit; }' > "${RES}.dbtype"
 }
 
+# the exhaustive search bypasses the prefilter and with it --taxon-list,
+# so only the targets of the selected taxa are listed as candidates
+EXHAUSTIVE_TARGETS="${TARGET_PREFILTER}"
+if [ -n "$TAXON_LIST" ] && { [ "$PREFMODE" = "EXHAUSTIVE" ] || [ -n "$CASCADE_EXHAUSTIVE" ]; }; then
+    EXHAUSTIVE_TARGETS="${TMP_PATH}/target_taxa"
+    if notExists "${EXHAUSTIVE_TARGETS}.dbtype"; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" filtertaxseqdb "${TARGET_PREFILTER%_ss}" "${EXHAUSTIVE_TARGETS}" --taxon-list "${TAXON_LIST}" --subdb-mode 1 ${VERBOSITY} \
+            || fail "filtertaxseqdb died"
+    fi
+fi
+
+# 1. Cascade: a query with CASCADE_HITS hits of at most CASCADE_EVALUE is done after a step,
+# only the remaining queries are searched again with the next higher sensitivity
+if [ -n "$CASCADE_STEPS" ]; then
+    if notExists "${TMP_PATH}/strualn.dbtype"; then
+        LAST_STEP="$((CASCADE_STEPS-1))"
+        if [ -n "$CASCADE_EXHAUSTIVE" ]; then
+            LAST_STEP="$CASCADE_STEPS"
+        fi
+        ALN_DONE=""
+        SEARCHDB="${QUERY_ALIGNMENT}"
+        STEP=0
+        while [ "$STEP" -le "$LAST_STEP" ]; do
+            if [ "$STEP" -gt 0 ]; then
+                SEARCHDB="${TMP_PATH}/search_${STEP}"
+                if notExists "${SEARCHDB}.dbtype"; then
+                    # shellcheck disable=SC2086
+                    "$MMSEQS" createsubdb "${TMP_PATH}/remaining_$((STEP-1))" "${QUERY_ALIGNMENT}" "${SEARCHDB}" --subdb-mode 1 ${VERBOSITY} \
+                        || fail "createsubdb died"
+                fi
+            fi
+            if notExists "${TMP_PATH}/pref_${STEP}.dbtype"; then
+                if [ "$STEP" -eq "$CASCADE_STEPS" ]; then
+                    fake_pref "${SEARCHDB}_ss" "${EXHAUSTIVE_TARGETS}" "${TMP_PATH}/pref_${STEP}"
+                else
+                    eval SENS="\$SENSE_$STEP"
+                    # shellcheck disable=SC2086
+                    $RUNNER "$MMSEQS" prefilter "${SEARCHDB}_ss" "${TARGET_PREFILTER}${INDEXEXT}" "${TMP_PATH}/pref_${STEP}" ${CASCADE_PREFILTER_PAR} -s "${SENS}" \
+                        || fail "Kmer matching step died"
+                fi
+            fi
+            if notExists "${TMP_PATH}/aln_${STEP}.dbtype"; then
+                # shellcheck disable=SC2086
+                $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${SEARCHDB}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/pref_${STEP}" "${TMP_PATH}/aln_${STEP}" ${ALIGNMENT_PAR} \
+                    || fail "Structure alignment step died"
+            fi
+            if [ "$STEP" -eq "$LAST_STEP" ]; then
+                ALN_DONE="${ALN_DONE} ${TMP_PATH}/aln_${STEP}"
+                break
+            fi
+
+            if notExists "${TMP_PATH}/conf_${STEP}.dbtype"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" filterdb "${TMP_PATH}/aln_${STEP}" "${TMP_PATH}/conf_${STEP}" --filter-column 4 --comparison-operator le --comparison-value "${CASCADE_EVALUE}" ${THREADS_COMP_PAR} \
+                    || fail "filterdb died"
+            fi
+            if notExists "${TMP_PATH}/conf_count_${STEP}.dbtype"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" result2stats "${SEARCHDB}" "${TARGET_ALIGNMENT}" "${TMP_PATH}/conf_${STEP}" "${TMP_PATH}/conf_hits_${STEP}" --stat linecount ${THREADS_PAR} \
+                    || fail "result2stats died"
+                # shellcheck disable=SC2086
+                "$MMSEQS" filterdb "${TMP_PATH}/conf_hits_${STEP}" "${TMP_PATH}/conf_count_${STEP}" --filter-column 1 --comparison-operator ge --comparison-value "${CASCADE_HITS}" ${THREADS_PAR} \
+                    || fail "filterdb died"
+            fi
+            # entries of queries below the hit count are empty
+            awk '$3 > 1 { print $1 }' "${TMP_PATH}/conf_count_${STEP}.index" > "${TMP_PATH}/done_${STEP}"
+            awk 'FILENAME == ARGV[1] { done[$1] = 1; next } !($1 in done) { print $1 }' "${TMP_PATH}/done_${STEP}" "${SEARCHDB}.index" > "${TMP_PATH}/remaining_${STEP}"
+            if notExists "${TMP_PATH}/aln_done_${STEP}.dbtype"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" createsubdb "${TMP_PATH}/done_${STEP}" "${TMP_PATH}/aln_${STEP}" "${TMP_PATH}/aln_done_${STEP}" ${VERBOSITY} \
+                    || fail "createsubdb died"
+            fi
+            ALN_DONE="${ALN_DONE} ${TMP_PATH}/aln_done_${STEP}"
+            if [ ! -s "${TMP_PATH}/remaining_${STEP}" ]; then
+                break
+            fi
+            STEP="$((STEP+1))"
+        done
+        # shellcheck disable=SC2086
+        "$MMSEQS" mergedbs "${QUERY_ALIGNMENT}" "${TMP_PATH}/strualn" ${ALN_DONE} ${VERBOSITY} \
+            || fail "Merge died"
+    fi
 # 1. Finding exact $k$-mer matches.
-if notExists "${TMP_PATH}/pref.dbtype"; then
+elif notExists "${TMP_PATH}/pref.dbtype"; then
     if [ "$PREFMODE" = "EXHAUSTIVE" ]; then
-        fake_pref "${QUERY_PREFILTER}" "${TARGET_PREFILTER}" "${TMP_PATH}/pref"
+        fake_pref "${QUERY_PREFILTER}" "${EXHAUSTIVE_TARGETS}" "${TMP_PATH}/pref"
+    elif [ "$PREFMODE" = "EMBEDDING" ]; then
+        EMBEDDING="${TARGET_PREFILTER%_ss}_emb"
+        if notExists "${EMBEDDING}.dbtype"; then
+            EMBEDDING="${TMP_PATH}/target_emb"
+            if notExists "${EMBEDDING}.dbtype"; then
+                # shellcheck disable=SC2086
+                "$MMSEQS" createembeddingindex "${TARGET_PREFILTER%_ss}" "${EMBEDDING}" ${CREATEEMBEDDINGINDEX_PAR} \
+                    || fail "Embedding index creation died"
+            fi
+        fi
+        # shellcheck disable=SC2086
+        $RUNNER "$MMSEQS" embeddingprefilter "${QUERY_PREFILTER%_ss}" "${EMBEDDING}" "${TMP_PATH}/pref" ${EMBEDDINGPREFILTER_PAR} \
+            || fail "Embedding prefilter step died"
     elif [ "$PREFMODE" = "UNGAPPED" ]; then
         # shellcheck disable=SC2086
         $RUNNER "$MMSEQS" ungappedprefilter "${QUERY_PREFILTER}" "${TARGET_PREFILTER}${INDEXEXT}" "${TMP_PATH}/pref" ${UNGAPPEDPREFILTER_PAR} \
@@ -52,13 +148,48 @@ if notExists "${TMP_PATH}/pref.dbtype"; then
     fi
 fi
 
+PREF="${TMP_PATH}/pref"
+
+# 1a. Additional spaced seeds
+if [ -n "$SEED_COUNT" ] && [ "$PREFMODE" = "KMER" ]; then
+    if notExists "${TMP_PATH}/pref_seeds.dbtype"; then
+        SEED_PREFS=""
+        STEP=0
+        while [ "$STEP" -lt "$SEED_COUNT" ]; do
+            if notExists "${TMP_PATH}/pref_seed_${STEP}.dbtype"; then
+                PARAM="SEED_PREFILTER_PAR_$STEP"
+                eval TMP="\$$PARAM"
+                # shellcheck disable=SC2086
+                $RUNNER "$MMSEQS" prefilter "${QUERY_PREFILTER}" "${TARGET_PREFILTER}" "${TMP_PATH}/pref_seed_${STEP}" ${TMP} \
+                    || fail "Spaced seed matching step died"
+            fi
+            SEED_PREFS="${SEED_PREFS} ${TMP_PATH}/pref_seed_${STEP}"
+            STEP="$((STEP+1))"
+        done
+        # shellcheck disable=SC2086
+        "$MMSEQS" mergeprefilter "${QUERY_PREFILTER}" "${TMP_PATH}/pref_seeds" "${TMP_PATH}/pref" ${SEED_PREFS} ${MERGEPREFILTER_PAR} \
+            || fail "Merge spaced seeds step died"
+    fi
+    PREF="${TMP_PATH}/pref_seeds"
+fi
+
+# 1b. Rescoring the 3Di k-mer diagonals with 3Di+AA
+if [ -n "$JOINT_PREFILTER_PAR" ] && [ "$PREFMODE" = "KMER" ]; then
+    if notExists "${TMP_PATH}/pref_joint.dbtype"; then
+        # shellcheck disable=SC2086
+        $RUNNER "$MMSEQS" structurerescorediagonal "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${PREF}" "${TMP_PATH}/pref_joint" ${JOINT_PREFILTER_PAR} \
+            || fail "Joint prefilter step died"
+    fi
+    PREF="${TMP_PATH}/pref_joint"
+fi
+
 # check if $ALIGNMENT_ALGO is tmalign
 if [ "$ALIGNMENT_ALGO" = "tmalign" ]; then
     # 2. tm alignment
     INTERMEDIATE="${TMP_PATH}/strualn"
     if notExists "${TMP_PATH}/strualn.dbtype"; then
         # shellcheck disable=SC2086
-        $RUNNER "$MMSEQS" structurealign "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/pref" "${INTERMEDIATE}" ${STRUCTUREALIGN_PAR} \
+        $RUNNER "$MMSEQS" structurealign "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${PREF}" "${INTERMEDIATE}" ${STRUCTUREALIGN_PAR} \
             || fail "Alignment step died"
     fi
 
@@ -88,7 +219,7 @@ elif [ "$ALIGNMENT_ALGO" = "lolalign" ]; then
     INTERMEDIATE="${TMP_PATH}/strualn"
     if notExists "${TMP_PATH}/strualn.dbtype"; then
         # shellcheck disable=SC2086
-        $RUNNER "$MMSEQS" structurealign "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/pref" "${INTERMEDIATE}" ${STRUCTUREALIGN_PAR} \
+        $RUNNER "$MMSEQS" structurealign "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${PREF}" "${INTERMEDIATE}" ${STRUCTUREALIGN_PAR} \
             || fail "Alignment step died"
     fi
 
@@ -118,17 +249,24 @@ else
    # 2. Alignment
     if notExists "${TMP_PATH}/strualn.dbtype"; then
         # shellcheck disable=SC2086
-        $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/pref" "${TMP_PATH}/strualn" ${ALIGNMENT_PAR} \
+        $RUNNER "$MMSEQS" $ALIGNMENT_ALGO "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${PREF}" "${TMP_PATH}/strualn" ${REPALIGNMENT_PAR} \
             || fail "Structure alignment step died"
     fi
 
     if [ -n "${EXPAND}" ]; then
         if notExists "${TMP_PATH}/strualn_expanded.dbtype"; then
-            # shellcheck disable=SC2086
-            "$MMSEQS" mergeresultsbyset "${TMP_PATH}/strualn" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/strualn_expanded" ${MERGERESULTBYSET_PAR} \
-                || fail "Expand died"
-            # shellcheck disable=SC2086
-            "$MMSEQS" setextendeddbtype "${TMP_PATH}/strualn_expanded" --extended-dbtype 2 ${VERBOSITY}
+            if [ -n "${EXPAND_PAR}" ]; then
+                # only members whose composed alignment to the query can reach an E-value are realigned
+                # shellcheck disable=SC2086
+                "$MMSEQS" structureexpandaln "${QUERY_ALIGNMENT}" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/strualn" "${TMP_PATH}/strualn_expanded" ${EXPAND_PAR} \
+                    || fail "Expand died"
+            else
+                # shellcheck disable=SC2086
+                "$MMSEQS" mergeresultsbyset "${TMP_PATH}/strualn" "${TARGET_ALIGNMENT}${INDEXEXT}" "${TMP_PATH}/strualn_expanded" ${MERGERESULTBYSET_PAR} \
+                    || fail "Expand died"
+                # shellcheck disable=SC2086
+                "$MMSEQS" setextendeddbtype "${TMP_PATH}/strualn_expanded" --extended-dbtype 2 ${VERBOSITY}
+            fi
         fi
         INTERMEDIATE="${TMP_PATH}/strualn_expanded"
         if notExists "${TMP_PATH}/aln.dbtype"; then
@@ -157,6 +295,39 @@ if [ -n "$REMOVE_TMP" ]; then
         "$MMSEQS" rmdb "${TMP_PATH}/strualn_expanded" ${VERBOSITY}
     fi
 
-    # shellcheck disable=SC2086
-    "$MMSEQS" rmdb "${TMP_PATH}/pref" ${VERBOSITY}
+    if [ -n "$CASCADE_STEPS" ]; then
+        STEP=0
+        while [ "$STEP" -le "$CASCADE_STEPS" ]; do
+            for DB in "search_${STEP}" "search_${STEP}_ss" "search_${STEP}_ss_h" "search_${STEP}_ca" "search_${STEP}_h" \
+                      "pref_${STEP}" "aln_${STEP}" "conf_${STEP}" "conf_hits_${STEP}" "conf_count_${STEP}" "aln_done_${STEP}"; do
+                if [ -f "${TMP_PATH}/${DB}.dbtype" ]; then
+                    # shellcheck disable=SC2086
+                    "$MMSEQS" rmdb "${TMP_PATH}/${DB}" ${VERBOSITY}
+                fi
+            done
+            rm -f -- "${TMP_PATH}/done_${STEP}" "${TMP_PATH}/remaining_${STEP}"
+            STEP="$((STEP+1))"
+        done
+    else
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/pref" ${VERBOSITY}
+    fi
+    if [ -f "${TMP_PATH}/target_taxa.dbtype" ]; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/target_taxa" ${VERBOSITY}
+    fi
+    if [ -f "${TMP_PATH}/pref_joint.dbtype" ]; then
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/pref_joint" ${VERBOSITY}
+    fi
+    if [ -n "$SEED_COUNT" ]; then
+        STEP=0
+        while [ "$STEP" -lt "$SEED_COUNT" ]; do
+            # shellcheck disable=SC2086
+            "$MMSEQS" rmdb "${TMP_PATH}/pref_seed_${STEP}" ${VERBOSITY}
+            STEP="$((STEP+1))"
+        done
+        # shellcheck disable=SC2086
+        "$MMSEQS" rmdb "${TMP_PATH}/pref_seeds" ${VERBOSITY}
+    fi
 fi
@@ -0,0 +1,195 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <stddef.h>
+
+// Uniform cell list over 3D points.
+// Points are binned into cubic cells of edge length cellSize and sorted by cell,
+// so that all points of a cell can be found with a binary search.
+// Points that are not finite are never returned. Points with very large coordinates
+// are kept apart and returned by every query, so that queries never miss a point.
+class SpatialGrid {
+public:
+    struct Cell {
+        int64_t x, y, z;
+        bool operator<(const Cell & other) const {
+            if (x != other.x) return x < other.x;
+            if (y != other.y) return y < other.y;
+            return z < other.z;
+        }
+        bool operator==(const Cell & other) const {
+            return x == other.x && y == other.y && z == other.z;
+        }
+    };
+
+    explicit SpatialGrid(double cellSize = 8.0) : cellSize(cellSize), invCellSize(1.0 / cellSize) {
+        clear();
+    }
+
+    void clear() {
+        entries.clear();
+        outliers.clear();
+        minCell = { INT64_MAX, INT64_MAX, INT64_MAX };
+        maxCell = { INT64_MIN, INT64_MIN, INT64_MIN };
+    }
+
+    void add(double x, double y, double z, unsigned int id) {
+        if (std::isfinite(x) == false || std::isfinite(y) == false || std::isfinite(z) == false) {
+            return;
+        }
+        if (isOutlier(x, y, z)) {
+            outliers.push_back(id);
+            return;
+        }
+        Entry entry;
+        entry.cell = cellOf(x, y, z);
+        entry.id = id;
+        entries.push_back(entry);
+        minCell.x = std::min(minCell.x, entry.cell.x);
+        minCell.y = std::min(minCell.y, entry.cell.y);
+        minCell.z = std::min(minCell.z, entry.cell.z);
+        maxCell.x = std::max(maxCell.x, entry.cell.x);
+        maxCell.y = std::max(maxCell.y, entry.cell.y);
+        maxCell.z = std::max(maxCell.z, entry.cell.z);
+    }
+
+    // has to be called after the last add and before the first query
+    void build() {
+        std::sort(entries.begin(), entries.end());
+    }
+
+    bool empty() const {
+        return entries.empty() && outliers.empty();
+    }
+
+    double getCellSize() const {
+        return cellSize;
+    }
+
+    // query points that are not finite or have very large coordinates can not be looked up
+    bool canQuery(double x, double y, double z) const {
+        return std::isfinite(x) && std::isfinite(y) && std::isfinite(z) && isOutlier(x, y, z) == false;
+    }
+
+    Cell cellOf(double x, double y, double z) const {
+        Cell cell;
+        cell.x = static_cast<int64_t>(std::floor(x * invCellSize));
+        cell.y = static_cast<int64_t>(std::floor(y * invCellSize));
+        cell.z = static_cast<int64_t>(std::floor(z * invCellSize));
+        return cell;
+    }
+
+    const std::vector<unsigned int> & getOutliers() const {
+        return outliers;
+    }
+
+    // largest Chebyshev distance in cells between a cell and any non-empty cell
+    int64_t maxShell(const Cell & cell) const {
+        if (entries.empty()) {
+            return -1;
+        }
+        int64_t shell = 0;
+        shell = std::max(shell, std::max(cell.x - minCell.x, maxCell.x - cell.x));
+        shell = std::max(shell, std::max(cell.y - minCell.y, maxCell.y - cell.y));
+        shell = std::max(shell, std::max(cell.z - minCell.z, maxCell.z - cell.z));
+        return shell;
+    }
+
+    // calls f(id) for every point of the given cell
+    template <typename F>
+    void forEachInCell(const Cell & cell, F f) const {
+        Entry key;
+        key.cell = cell;
+        key.id = 0;
+        typename std::vector<Entry>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), key);
+        for (; it != entries.end() && it->cell == cell; ++it) {
+            f(it->id);
+        }
+    }
+
+    // calls f(id) for every point in the cells at Chebyshev distance shell around cell
+    template <typename F>
+    void forEachInShell(const Cell & cell, int64_t shell, F f) const {
+        if (shell == 0) {
+            forEachInCell(cell, f);
+            return;
+        }
+        for (int64_t dx = -shell; dx <= shell; dx++) {
+            const int64_t cx = cell.x + dx;
+            if (cx < minCell.x || cx > maxCell.x) {
+                continue;
+            }
+            const bool xBorder = (dx == -shell || dx == shell);
+            for (int64_t dy = -shell; dy <= shell; dy++) {
+                const int64_t cy = cell.y + dy;
+                if (cy < minCell.y || cy > maxCell.y) {
+                    continue;
+                }
+                const bool yBorder = (dy == -shell || dy == shell);
+                // inside the cube only the two z faces belong to the shell
+                const int64_t dzStep = (xBorder || yBorder) ? 1 : 2 * shell;
+                for (int64_t dz = -shell; dz <= shell; dz += dzStep) {
+                    const int64_t cz = cell.z + dz;
+                    if (cz < minCell.z || cz > maxCell.z) {
+                        continue;
+                    }
+                    Cell current = { cx, cy, cz };
+                    forEachInCell(current, f);
+                }
+            }
+        }
+    }
+
+    // calls f(id) for at least every point within radius of (x, y, z), including all outliers
+    template <typename F>
+    void forEachCandidate(double x, double y, double z, double radius, F f) const {
+        for (size_t i = 0; i < outliers.size(); i++) {
+            f(outliers[i]);
+        }
+        if (entries.empty() || canQuery(x, y, z) == false) {
+            return;
+        }
+        // widen the cell range slightly so that rounding in cellOf can not drop a point
+        const double margin = radius * 1e-6 + 1e-6;
+        Cell lo = cellOf(x - radius - margin, y - radius - margin, z - radius - margin);
+        Cell hi = cellOf(x + radius + margin, y + radius + margin, z + radius + margin);
+        lo.x = std::max(lo.x, minCell.x); hi.x = std::min(hi.x, maxCell.x);
+        lo.y = std::max(lo.y, minCell.y); hi.y = std::min(hi.y, maxCell.y);
+        lo.z = std::max(lo.z, minCell.z); hi.z = std::min(hi.z, maxCell.z);
+        for (int64_t cx = lo.x; cx <= hi.x; cx++) {
+            for (int64_t cy = lo.y; cy <= hi.y; cy++) {
+                for (int64_t cz = lo.z; cz <= hi.z; cz++) {
+                    Cell current = { cx, cy, cz };
+                    forEachInCell(current, f);
+                }
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        Cell cell;
+        unsigned int id;
+        bool operator<(const Entry & other) const {
+            if (cell == other.cell) {
+                return id < other.id;
+            }
+            return cell < other.cell;
+        }
+    };
+
+    // coordinates beyond this are not binned to keep cell indices far from overflowing
+    static bool isOutlier(double x, double y, double z) {
+        const double limit = 1e9;
+        return std::fabs(x) > limit || std::fabs(y) > limit || std::fabs(z) > limit;
+    }
+
+    double cellSize;
+    double invCellSize;
+    std::vector<Entry> entries;
+    std::vector<unsigned int> outliers;
+    Cell minCell;
+    Cell maxCell;
+};
@@ -133,23 +133,114 @@ void StructureTo3DiBase::createResidueMask(std::vector<bool> & validMask,
     }
 }
 
+int StructureTo3DiBase::findResiduePartnerAllPairs(size_t i, std::vector<bool> & validMask, const size_t n){
+    // The squared distances of a row are computed in a vectorizable loop. The square root is only
+    // taken for candidates that can be closer than the current partner, since sqrt is monotonic
+    // this picks the same partner as comparing all distances.
+    const double * x = cbX.data();
+    const double * y = cbY.data();
+    const double * z = cbZ.data();
+    double * dist2 = distances.data();
+    const double xi = x[i];
+    const double yi = y[i];
+    const double zi = z[i];
+    for(size_t j = 1; j < n - 1; j++){
+        const double dx = xi - x[j];
+        const double dy = yi - y[j];
+        const double dz = zi - z[j];
+        dist2[j] = dx*dx + dy*dy + dz*dz;
+    }
+    int partner = -1;
+    double minDistance = INFINITY;
+    double minDistance2 = INFINITY;
+    for(size_t j = 1; j < n - 1; j++){
+        if (dist2[j] <= minDistance2 && i != j && validMask[j]){
+            double dist = sqrt(dist2[j]);
+            if (dist < minDistance){
+                minDistance = dist;
+                minDistance2 = dist2[j];
+                partner = static_cast<int>(j);
+            }
+        }
+    }
+    return partner;
+}
+
+int StructureTo3DiBase::findResiduePartnerGrid(size_t i, std::vector<bool> & validMask){
+    // Same result as comparing all pairs: the closest residue wins and ties go to the lower index.
+    // validMask is checked at lookup time since residues without partner are removed while searching.
+    const double * x = cbX.data();
+    const double * y = cbY.data();
+    const double * z = cbZ.data();
+    const double xi = x[i];
+    const double yi = y[i];
+    const double zi = z[i];
+    int partner = -1;
+    double minDistance = INFINITY;
+    auto visit = [&](unsigned int j) {
+        if (j == i || validMask[j] == false) {
+            return;
+        }
+        const double dx = xi - x[j];
+        const double dy = yi - y[j];
+        const double dz = zi - z[j];
+        const double dist = sqrt(dx*dx + dy*dy + dz*dz);
+        if (dist < minDistance || (dist == minDistance && static_cast<int>(j) < partner)) {
+            minDistance = dist;
+            partner = static_cast<int>(j);
+        }
+    };
+    const std::vector<unsigned int> & outliers = partnerGrid.getOutliers();
+    for (size_t k = 0; k < outliers.size(); k++) {
+        visit(outliers[k]);
+    }
+    const SpatialGrid::Cell cell = partnerGrid.cellOf(xi, yi, zi);
+    const int64_t maxShell = partnerGrid.maxShell(cell);
+    const double cellSize = partnerGrid.getCellSize();
+    for (int64_t shell = 0; shell <= maxShell; shell++) {
+        partnerGrid.forEachInShell(cell, shell, visit);
+        // all points in further shells are at least shell * cellSize away,
+        // the small slack covers rounding when binning the coordinates
+        if (partner != -1 && minDistance + 1e-6 < static_cast<double>(shell) * cellSize) {
+            break;
+        }
+    }
+    return partner;
+}
+
 void StructureTo3DiBase::findResiduePartners(std::vector<int> & partnerIdx, Vec3 * cb,
                                          std::vector<bool> & validMask, const size_t n){
     // Pick for each residue the closest neighbour as partner
     // (in terms of distances between their virtual centers/C_betas).
     //
     // Ignore the first/last and invalid residues.
-    for(size_t i = 1; i < n - 1; i++){
-        double minDistance = INFINITY;
-        for(size_t j = 1; j < n - 1; j++){
-            if (i != j && validMask[j]){
-                double dist = calcDistanceBetween(cb[i], cb[j]);
-                if (dist < minDistance){
-                    minDistance = dist;
-                    partnerIdx[i] = static_cast<int>(j);
-                }
+    if (cbX.size() < n) {
+        cbX.resize(n);
+        cbY.resize(n);
+        cbZ.resize(n);
+        distances.resize(n);
+    }
+    for (size_t j = 0; j < n; j++) {
+        cbX[j] = cb[j].x;
+        cbY[j] = cb[j].y;
+        cbZ[j] = cb[j].z;
+    }
+    const bool useGrid = n >= PARTNER_GRID_MIN_LEN;
+    if (useGrid) {
+        partnerGrid.clear();
+        for (size_t j = 1; j < n - 1; j++) {
+            if (validMask[j]) {
+                partnerGrid.add(cbX[j], cbY[j], cbZ[j], static_cast<unsigned int>(j));
             }
         }
+        partnerGrid.build();
+    }
+    for(size_t i = 1; i < n - 1; i++){
+        if (useGrid && partnerGrid.canQuery(cbX[i], cbY[i], cbZ[i])) {
+            partnerIdx[i] = findResiduePartnerGrid(i, validMask);
+        } else {
+            partnerIdx[i] = findResiduePartnerAllPairs(i, validMask, n);
+        }
         if (partnerIdx[i] == -1){  // no partner found
             validMask[i] = 0;
         }
@@ -217,15 +308,33 @@ void StructureTo3Di::calcConformationDescriptors(std::vector<Feature> & features
 void StructureTo3Di::encodeFeatures(std::vector<Embedding> & embeddings, std::vector<Feature> & features,
                                         std::vector<bool> & mask, const size_t len)
 {
+    // run the encoder once on all valid residues
+    size_t validCnt = 0;
+    for (size_t i = 0; i < len; i++){
+        validCnt += mask[i];
+    }
+    if (validCnt == 0){
+        return;
+    }
+    in.resize(validCnt * Alphabet3Di::FEATURE_CNT);
+    out.resize(validCnt * Alphabet3Di::EMBEDDING_DIM);
+    size_t row = 0;
     for (size_t i = 0; i < len; i++){
         if (mask[i]){
             for (size_t j = 0; j < Alphabet3Di::FEATURE_CNT; j++){
-                in.data_[j] = static_cast<float>(features[i].f[j]);
+                in[row * Alphabet3Di::FEATURE_CNT + j] = static_cast<float>(features[i].f[j]);
             }
-            encoder.Apply(&in, &out);
+            row++;
+        }
+    }
+    encoder.Apply(in.data(), validCnt, out.data());
+    row = 0;
+    for (size_t i = 0; i < len; i++){
+        if (mask[i]){
             for (size_t j = 0; j < Alphabet3Di::EMBEDDING_DIM; j++){
-                embeddings[i].f[j] = static_cast<double>(out.data_[j]);
+                embeddings[i].f[j] = static_cast<double>(out[row * Alphabet3Di::EMBEDDING_DIM + j]);
             }
+            row++;
         }
     }
 }
@@ -262,8 +371,6 @@ char * StructureTo3Di::structure2states(Vec3 * ca, Vec3 * n,
     partnerIdx.clear();
     mask.clear();
     embeddings.clear();
-    in = Tensor(Alphabet3Di::FEATURE_CNT);
-    out = Tensor(Alphabet3Di::EMBEDDING_DIM);
 
     if(len > features.size()){
         features.resize(len);
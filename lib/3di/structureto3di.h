@@ -2,7 +2,8 @@
 #include <vector>
 #include <stddef.h>
 #include <cstring>
-#include "kerasify/keras_model.h"
+#include "kerasify/keras_dense.h"
+#include "spatialgrid.h"
 
 namespace Alphabet3Di{
     static const size_t CENTROID_CNT = 20;
@@ -73,6 +74,21 @@ protected:
     void findResiduePartners(std::vector<int> & partnerIdx, Vec3 * cb,
                              std::vector<bool> & validMask, const size_t len);
 
+private:
+    // chains of at least this length look up partners in a cell list instead of comparing all pairs
+    static const size_t PARTNER_GRID_MIN_LEN = 512;
+
+    // closest valid partner of residue i by comparing it to all other residues, -1 if there is none
+    int findResiduePartnerAllPairs(size_t i, std::vector<bool> & validMask, const size_t len);
+    // closest valid partner of residue i by searching cells of the grid in growing shells
+    int findResiduePartnerGrid(size_t i, std::vector<bool> & validMask);
+
+    // c beta coordinates as structure of arrays and squared distances of one residue to all others
+    std::vector<double> cbX;
+    std::vector<double> cbY;
+    std::vector<double> cbZ;
+    std::vector<double> distances;
+    SpatialGrid partnerGrid;
 };
 
 class StructureTo3Di : StructureTo3DiBase{
@@ -104,15 +120,15 @@ public:
         }
     };
 
-    std::vector<Feature> getFeatures(){
+    const std::vector<Feature> &getFeatures(){
         return features;
     }
 
 private:
     // Encoding
-    KerasModel encoder;
-    Tensor in;
-    Tensor out;
+    KerasDenseModel encoder;
+    std::vector<float> in;
+    std::vector<float> out;
 
     // store for the class
     std::vector<Feature> features;
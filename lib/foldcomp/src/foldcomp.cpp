@@ -870,8 +870,10 @@ int Foldcomp::decompress(std::vector<AtomCoordinate>& atom) {
         if (i != 0){
             currResidue = backBonePerResidue[i][0].residue;
         }
+        // the atoms of every amino acid start with N, CA, C, O, CB
         fullResidue = nerf.reconstructAminoAcid(
-            backBonePerResidue[i], this->sideChainAnglesPerResidue[i], AAS.at(currResidue)
+            backBonePerResidue[i], this->sideChainAnglesPerResidue[i], AAS.at(currResidue),
+            this->backboneOnly ? 5 : SIZE_MAX
         );
         if (this->useAltAtomOrder) {
             _reorderAtoms(fullResidue, AAS.at(currResidue));
@@ -290,6 +290,8 @@ public:
     bool isCompressed = false;
     bool backwardReconstruction = true;
     bool useAltAtomOrder = false;
+    // only reconstruct N, CA, C, O and CB, the remaining side chain atoms are skipped
+    bool backboneOnly = false;
     // Number of atoms & residues
     int nResidue = 0;
     int nAtom = 0;
@@ -106,7 +106,8 @@ float3d Nerf::place_atom(
 std::vector<AtomCoordinate> Nerf::reconstructAminoAcid(
     const std::vector<AtomCoordinate>& original_atoms,
     const std::vector<float>& torsion_angles,
-    const AminoAcid& aa
+    const AminoAcid& aa,
+    size_t maxAtoms
 ) {
     // save three first atoms
     std::vector<AtomCoordinate> reconstructed_atoms = {
@@ -119,7 +120,7 @@ std::vector<AtomCoordinate> Nerf::reconstructAminoAcid(
         0.0f, 0.0f, 0.0f
     );
 
-    int total = aa.atoms.size();
+    int total = std::min(aa.atoms.size(), maxAtoms);
     for (int i = 0; i < (total - 3); i++) {
         // Get current atom's info
         curr_atom.atom_index = reconstructed_atoms[i + 2].atom_index + 1;
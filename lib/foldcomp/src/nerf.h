@@ -22,6 +22,7 @@
 #pragma once
 #include "float3d.h"
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -89,10 +90,12 @@ public:
         std::vector<float> atom_bond_angles
     );
 
+    // maxAtoms limits the reconstruction to the first atoms in the order of aa.atoms
     std::vector<AtomCoordinate> reconstructAminoAcid(
         const std::vector<AtomCoordinate>& original_atoms,
         const std::vector<float>& torsion_angles,
-        const AminoAcid& aa
+        const AminoAcid& aa,
+        size_t maxAtoms = SIZE_MAX
     );
 
     void writeInfoForChecking(
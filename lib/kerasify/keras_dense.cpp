@@ -0,0 +1,177 @@
+#include "keras_dense.h"
+#include "keras_model.h"
+
+#include "simd.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+static bool ReadUint(std::istream* file, unsigned int* i) {
+    file->read((char*)i, sizeof(unsigned int));
+    return file->gcount() == sizeof(unsigned int);
+}
+
+static bool ReadFloatArray(std::istream* file, float* f, size_t n) {
+    file->read((char*)f, sizeof(float) * n);
+    return (size_t)file->gcount() == sizeof(float) * n;
+}
+
+KerasDenseModel::KerasDenseModel() : capacity_(0) {
+    buffers_[0] = NULL;
+    buffers_[1] = NULL;
+}
+
+KerasDenseModel::~KerasDenseModel() {
+    for (size_t i = 0; i < layers_.size(); i++) {
+        free(layers_[i].weights);
+        free(layers_[i].biases);
+    }
+    free(buffers_[0]);
+    free(buffers_[1]);
+}
+
+bool KerasDenseModel::LoadModel(const std::string& data) {
+    std::stringstream file(data);
+
+    unsigned int num_layers = 0;
+    KASSERT(ReadUint(&file, &num_layers), "Expected number of layers");
+
+    for (unsigned int l = 0; l < num_layers; l++) {
+        unsigned int layer_type = 0;
+        KASSERT(ReadUint(&file, &layer_type), "Expected layer type");
+
+        if (layer_type == KerasModel::kActivation) {
+            // a separate activation is fused into the preceding dense layer
+            unsigned int activation = 0;
+            KASSERT(ReadUint(&file, &activation), "Failed to read activation type");
+            KASSERT(layers_.empty() == false, "Activation without dense layer");
+            KASSERT(activation == KerasLayerActivation::kLinear || activation == KerasLayerActivation::kRelu,
+                    "Unsupported activation type %d", activation);
+            layers_.back().relu |= (activation == KerasLayerActivation::kRelu);
+            continue;
+        }
+        KASSERT(layer_type == KerasModel::kDense, "Unsupported layer type %d", layer_type);
+
+        unsigned int rows = 0;
+        unsigned int cols = 0;
+        unsigned int biases = 0;
+        KASSERT(ReadUint(&file, &rows), "Expected weight rows");
+        KASSERT(ReadUint(&file, &cols), "Expected weight cols");
+        KASSERT(ReadUint(&file, &biases), "Expected biases shape");
+        KASSERT(rows > 0 && cols > 0 && biases == cols, "Invalid dense shape");
+        KASSERT(layers_.empty() || layers_.back().outputs == (int)rows, "Dimension mismatch %d %d", layers_.back().outputs, rows);
+
+        Layer layer;
+        layer.inputs = rows;
+        layer.outputs = cols;
+        layer.stride = ((cols + VECSIZE_FLOAT - 1) / VECSIZE_FLOAT) * VECSIZE_FLOAT;
+        layer.relu = false;
+        layer.weights = (float*)mem_align(ALIGN_FLOAT, sizeof(float) * rows * layer.stride);
+        layer.biases = (float*)mem_align(ALIGN_FLOAT, sizeof(float) * layer.stride);
+        memset(layer.weights, 0, sizeof(float) * rows * layer.stride);
+        memset(layer.biases, 0, sizeof(float) * layer.stride);
+        layers_.push_back(layer);
+        for (unsigned int i = 0; i < rows; i++) {
+            KASSERT(ReadFloatArray(&file, layer.weights + i * layer.stride, cols), "Expected weights");
+        }
+        KASSERT(ReadFloatArray(&file, layer.biases, cols), "Expected biases");
+
+        unsigned int activation = 0;
+        KASSERT(ReadUint(&file, &activation), "Failed to read activation type");
+        KASSERT(activation == KerasLayerActivation::kLinear || activation == KerasLayerActivation::kRelu,
+                "Unsupported activation type %d", activation);
+        layers_.back().relu = (activation == KerasLayerActivation::kRelu);
+    }
+    KASSERT(layers_.empty() == false, "Model without layers");
+
+    return true;
+}
+
+// out[r][j] = act(sum_i in[r][i] * w[i][j] + b[j]), four rows share every weight load
+void KerasDenseModel::ApplyLayer(const Layer& layer, const float* in, int inStride, size_t rows, float* out) {
+    const simd_float zero = simdf32_setzero(0);
+    size_t r = 0;
+    for (; r + 4 <= rows; r += 4) {
+        const float* x0 = in + (r + 0) * inStride;
+        const float* x1 = in + (r + 1) * inStride;
+        const float* x2 = in + (r + 2) * inStride;
+        const float* x3 = in + (r + 3) * inStride;
+        for (int j = 0; j < layer.stride; j += VECSIZE_FLOAT) {
+            simd_float a0 = zero;
+            simd_float a1 = zero;
+            simd_float a2 = zero;
+            simd_float a3 = zero;
+            const float* w = layer.weights + j;
+            for (int i = 0; i < layer.inputs; i++, w += layer.stride) {
+                const simd_float wv = simdf32_load(w);
+                a0 = simdf32_fmadd(simdf32_set(x0[i]), wv, a0);
+                a1 = simdf32_fmadd(simdf32_set(x1[i]), wv, a1);
+                a2 = simdf32_fmadd(simdf32_set(x2[i]), wv, a2);
+                a3 = simdf32_fmadd(simdf32_set(x3[i]), wv, a3);
+            }
+            const simd_float b = simdf32_load(layer.biases + j);
+            a0 = simdf32_add(a0, b);
+            a1 = simdf32_add(a1, b);
+            a2 = simdf32_add(a2, b);
+            a3 = simdf32_add(a3, b);
+            if (layer.relu) {
+                a0 = simdf32_max(a0, zero);
+                a1 = simdf32_max(a1, zero);
+                a2 = simdf32_max(a2, zero);
+                a3 = simdf32_max(a3, zero);
+            }
+            simdf32_store(out + (r + 0) * layer.stride + j, a0);
+            simdf32_store(out + (r + 1) * layer.stride + j, a1);
+            simdf32_store(out + (r + 2) * layer.stride + j, a2);
+            simdf32_store(out + (r + 3) * layer.stride + j, a3);
+        }
+    }
+    for (; r < rows; r++) {
+        const float* x = in + r * inStride;
+        for (int j = 0; j < layer.stride; j += VECSIZE_FLOAT) {
+            simd_float a = zero;
+            const float* w = layer.weights + j;
+            for (int i = 0; i < layer.inputs; i++, w += layer.stride) {
+                a = simdf32_fmadd(simdf32_set(x[i]), simdf32_load(w), a);
+            }
+            a = simdf32_add(a, simdf32_load(layer.biases + j));
+            if (layer.relu) {
+                a = simdf32_max(a, zero);
+            }
+            simdf32_store(out + r * layer.stride + j, a);
+        }
+    }
+}
+
+void KerasDenseModel::Apply(const float* in, size_t rows, float* out) {
+    if (rows == 0) {
+        return;
+    }
+    int widest = 0;
+    for (size_t l = 0; l < layers_.size(); l++) {
+        widest = std::max(widest, layers_[l].stride);
+    }
+    if (rows * widest > capacity_) {
+        capacity_ = rows * widest;
+        free(buffers_[0]);
+        free(buffers_[1]);
+        buffers_[0] = (float*)mem_align(ALIGN_FLOAT, sizeof(float) * capacity_);
+        buffers_[1] = (float*)mem_align(ALIGN_FLOAT, sizeof(float) * capacity_);
+    }
+
+    const float* current = in;
+    int currentStride = layers_.front().inputs;
+    for (size_t l = 0; l < layers_.size(); l++) {
+        float* next = buffers_[l % 2];
+        ApplyLayer(layers_[l], current, currentStride, rows, next);
+        current = next;
+        currentStride = layers_[l].stride;
+    }
+
+    const int outputs = layers_.back().outputs;
+    for (size_t r = 0; r < rows; r++) {
+        memcpy(out + r * outputs, current + r * currentStride, sizeof(float) * outputs);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef KERAS_DENSE_H_
+#define KERAS_DENSE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Inference for kerasify models made of dense layers only (with optional separate activation layers).
+// Shapes are fixed at load time, every dense layer is fused with its activation and evaluated
+// as a SIMD GEMM over blocks of rows. Scratch buffers live in the instance, so an instance
+// must not be shared between threads.
+// Rows are accumulated in the same order as KerasModel::Apply, giving the same results.
+class KerasDenseModel {
+  public:
+    KerasDenseModel();
+
+    ~KerasDenseModel();
+
+    // reads the serialized model; fails for layers other than dense and linear/relu activations
+    bool LoadModel(const std::string& data);
+
+    int InputSize() const { return layers_.empty() ? 0 : layers_.front().inputs; }
+
+    int OutputSize() const { return layers_.empty() ? 0 : layers_.back().outputs; }
+
+    // evaluates rows inputs of InputSize() floats each and writes rows * OutputSize() floats
+    void Apply(const float* in, size_t rows, float* out);
+
+  private:
+    struct Layer {
+        int inputs;
+        int outputs;
+        // outputs rounded up to the vector width, weights are stored as inputs x stride
+        int stride;
+        bool relu;
+        float* weights;
+        float* biases;
+    };
+
+    void ApplyLayer(const Layer& layer, const float* in, int inStride, size_t rows, float* out);
+
+    std::vector<Layer> layers_;
+    float* buffers_[2];
+    size_t capacity_;
+
+    KerasDenseModel(const KerasDenseModel&);
+    KerasDenseModel& operator=(const KerasDenseModel&);
+};
+
+#endif // KERAS_DENSE_H_
@@ -699,7 +699,7 @@ std::vector<Command> baseCommands = {
                 "Martin Steinegger <martin.steinegger@snu.ac.kr> & Lars von den Driesch & Maria Hauser",
                 "<i:sequenceDB> <i:resultDB> <o:clusterDB>",
                 CITATION_MMSEQS2|CITATION_MMSEQS1,{{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
-                                                          {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::resultDb },
+                                                          {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::resultOrGraphDb },
                                                           {"clusterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::clusterDb }}},
         {"clusthash",            clusthash,            &par.clusthash,            COMMAND_CLUSTER,
                 "Hash-based clustering of equal length sequences",
@@ -708,6 +708,15 @@ std::vector<Command> baseCommands = {
                 "<i:sequenceDB> <o:alignmentDB>",
                 CITATION_MMSEQS2, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                                           {"alignmentDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb }}},
+        {"result2graph",         result2graph,         &par.result2graph,         COMMAND_CLUSTER,
+                "Convert an alignment DB into a binary alignment graph for clust",
+                "# The graph can be clustered repeatedly with different thresholds\n"
+                "mmseqs result2graph alnDB graphDB\n"
+                "mmseqs clust seqDB graphDB cluDB --min-seq-id 0.5 -c 0.8\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:alignmentDB> <o:graphDB>",
+                CITATION_MMSEQS2, {{"alignmentDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
+                                                          {"graphDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::allDb }}},
         {"mergeclusters",        mergeclusters,        &par.threadsandcompression,COMMAND_CLUSTER,
                 "Merge multiple cascaded clustering steps",
                 NULL,
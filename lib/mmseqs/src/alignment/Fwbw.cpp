@@ -68,7 +68,7 @@ inline simd_float simdf32_prefixsum(simd_float a) {
 
 // FwBwAligner Constructor for general case: use profile scoring matrix
 FwBwAligner::FwBwAligner(SubstitutionMatrix &subMat, float gapOpen, float gapExtend, float temperature, float mact, size_t rowsCapacity, size_t colsCapacity, size_t length, int backtrace)
-                : temperature(temperature), length(length), gapOpen(gapOpen), gapExtend(gapExtend), mact(mact), rowsCapacity(rowsCapacity), colsCapacity(colsCapacity) {    
+                : temperature(temperature), length(length), gapOpen(gapOpen), gapExtend(gapExtend), mact(mact), rowsCapacity(rowsCapacity), colsCapacity(colsCapacity), exactExp(true) {    
     blockCapacity = colsCapacity / length;
     // ZM
     zm = malloc_matrix<float>(rowsCapacity, colsCapacity);
@@ -118,7 +118,7 @@ FwBwAligner::FwBwAligner(SubstitutionMatrix &subMat, float gapOpen, float gapExt
 
 // FwBwAligner Constructor for user-defined scoring matrix
 FwBwAligner::FwBwAligner(float gapOpen, float gapExtend, float temperature, float mact, size_t rowsCapacity, size_t colsCapacity, size_t length, int backtrace)
-                    : temperature(temperature), length(length), gapOpen(gapOpen), gapExtend(gapExtend), mact(mact), rowsCapacity(rowsCapacity), colsCapacity(colsCapacity) {
+                    : temperature(temperature), length(length), gapOpen(gapOpen), gapExtend(gapExtend), mact(mact), rowsCapacity(rowsCapacity), colsCapacity(colsCapacity), exactExp(true) {
     
     // scoreForward
     scoreForward = malloc_matrix<float>(rowsCapacity, colsCapacity);
@@ -446,9 +446,10 @@ void FwBwAligner::forward() {
         float current_max = 0;
         float zmMaxRowBlock = -std::numeric_limits<float>::max();
         float log_zmMax = 0;
+        float expMax = 1.0f;
         simd_float vZmMaxRowBlock;
         for (size_t i = 1; i <= rowSeqLen; ++i) {
-            simd_float vExpMax = simdf32_set(exp(-current_max));
+            simd_float vExpMax = simdf32_set(exactExp ? exp(-current_max) : expMax);
             simd_float vZeI0 = simdf32_set(ze_i0);
             simd_float vLastPrefixSum = simdf32_setzero(); 
             simd_float vZmax_tmp = simdf32_set(-std::numeric_limits<float>::max());
@@ -500,7 +501,7 @@ void FwBwAligner::forward() {
                 simdf32_storeu(&zeBlock[j+1], vZeUpdate);
             }
 
-            log_zmMax = log(zmMaxRowBlock);
+            log_zmMax = exactExp ? log(zmMaxRowBlock) : simdf32_log(simdf32_set(zmMaxRowBlock))[0];
             current_max += log_zmMax;
             simd_float vCurrMax = simdf32_set(current_max);
             for (size_t j = 1; j <= cols; j += VECSIZE_FLOAT){
@@ -550,7 +551,7 @@ void FwBwAligner::forward() {
 #if defined(AVX512)
                 simd_float vNextFirstExp = _mm512_set_ps(
                     0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-                    0.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, -current_max,
                     zfFirst[i] - current_max, 
                     zeFirst[i] - log_zmMax,
                     zmFirst[i] - log_zmMax,
@@ -560,9 +561,10 @@ void FwBwAligner::forward() {
                 vNextFirstExp = simdf32_exp(vNextFirstExp);
                 zmBlockCurr[0] = vNextFirstExp[0]; ze_i0 = vNextFirstExp[1];
                 zmBlockPrev[0] = vNextFirstExp[2]; zeBlock[0] = vNextFirstExp[3]; zfBlock[0] = vNextFirstExp[4];
+                expMax = vNextFirstExp[5];
 #elif defined(AVX2)
                 simd_float vNextFirstExp = _mm256_set_ps(
-                    0.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, -current_max,
                     zfFirst[i] - current_max, 
                     zeFirst[i] - log_zmMax,
                     zmFirst[i] - log_zmMax,
@@ -572,6 +574,7 @@ void FwBwAligner::forward() {
                 vNextFirstExp = simdf32_exp(vNextFirstExp);
                 zmBlockCurr[0] = vNextFirstExp[0]; ze_i0 = vNextFirstExp[1]; 
                 zmBlockPrev[0] = vNextFirstExp[2]; zeBlock[0] = vNextFirstExp[3]; zfBlock[0] = vNextFirstExp[4];
+                expMax = vNextFirstExp[5];
 #else // Fallback to SSE
                 simd_float vNextFirstExp1 = _mm_set_ps(
                     zeFirst[i] - log_zmMax,
@@ -580,14 +583,14 @@ void FwBwAligner::forward() {
                     zmFirst[i+1]
                 );    
                 simd_float vNextFirstExp2= _mm_set_ps(
-                    0.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, -current_max,
                     zfFirst[i] - current_max    
                 );    
                 vNextFirstExp1 = simdf32_exp(vNextFirstExp1);
                 vNextFirstExp2 = simdf32_exp(vNextFirstExp2);
                 zmBlockCurr[0] = vNextFirstExp1[0]; ze_i0 = vNextFirstExp1[1]; 
                 zmBlockPrev[0] = vNextFirstExp1[2]; zeBlock[0] = vNextFirstExp1[3];
-                zfBlock[0] = vNextFirstExp2[0];
+                zfBlock[0] = vNextFirstExp2[0]; expMax = vNextFirstExp2[1];
 #endif 
             } else{
                 zmBlockPrev[0] = exp(zmFirst[i] - log_zmMax);
@@ -649,9 +652,10 @@ void FwBwAligner::backward()  {
         float current_max = 0;
         float zmMaxRowBlock = -std::numeric_limits<float>::max();
         float log_zmMax = 0;
+        float expMax = 1.0f;
         simd_float vZmMaxRowBlock;
         for (size_t i = 1; i <= rowSeqLen; ++i) {
-            simd_float vExpMax = simdf32_set(exp(-current_max));
+            simd_float vExpMax = simdf32_set(exactExp ? exp(-current_max) : expMax);
             simd_float vZeI0 = simdf32_set(ze_i0);
             simd_float vLastPrefixSum = simdf32_setzero(); 
             simd_float vZmax_tmp = simdf32_set(-std::numeric_limits<float>::max());
@@ -716,7 +720,7 @@ void FwBwAligner::backward()  {
                 simdf32_storeu(&zeBlock[j+1], vZeUpdate);
             }
 
-            log_zmMax = log(zmMaxRowBlock);
+            log_zmMax = exactExp ? log(zmMaxRowBlock) : simdf32_log(simdf32_set(zmMaxRowBlock))[0];
             current_max += log_zmMax;
             size_t adjusted_memcpycols = memcpy_cols - memcpy_cols % VECSIZE_FLOAT;
             size_t forwardBlockStart = colSeqLen - start;
@@ -786,7 +790,7 @@ void FwBwAligner::backward()  {
 #if defined(AVX512)
                 simd_float vNextFirstExp = _mm512_set_ps(
                     0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
-                    0.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, -current_max,
                     zfFirst[i] - current_max, 
                     zeFirst[i] - log_zmMax,
                     zmFirst[i] - log_zmMax,
@@ -796,9 +800,10 @@ void FwBwAligner::backward()  {
                 vNextFirstExp = simdf32_exp(vNextFirstExp);
                 zmBlockCurr[0] = vNextFirstExp[0]; ze_i0 = vNextFirstExp[1];
                 zmBlockPrev[0] = vNextFirstExp[2]; zeBlock[0] = vNextFirstExp[3]; zfBlock[0] = vNextFirstExp[4];
+                expMax = vNextFirstExp[5];
 #elif defined(AVX2)
                 simd_float vNextFirstExp = _mm256_set_ps(
-                    0.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, -current_max,
                     zfFirst[i] - current_max, 
                     zeFirst[i] - log_zmMax,
                     zmFirst[i] - log_zmMax,
@@ -808,6 +813,7 @@ void FwBwAligner::backward()  {
                 vNextFirstExp = simdf32_exp(vNextFirstExp);
                 zmBlockCurr[0] = vNextFirstExp[0]; ze_i0 = vNextFirstExp[1]; 
                 zmBlockPrev[0] = vNextFirstExp[2]; zeBlock[0] = vNextFirstExp[3]; zfBlock[0] = vNextFirstExp[4];
+                expMax = vNextFirstExp[5];
 #else // Fallback to SSE
                 simd_float vNextFirstExp1 = _mm_set_ps(
                     zeFirst[i] - log_zmMax,
@@ -816,14 +822,14 @@ void FwBwAligner::backward()  {
                     zmFirst[i+1]
                 );    
                 simd_float vNextFirstExp2= _mm_set_ps(
-                    0.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, -current_max,
                     zfFirst[i] - current_max     
                 );    
                 vNextFirstExp1 = simdf32_exp(vNextFirstExp1);
                 vNextFirstExp2 = simdf32_exp(vNextFirstExp2);
                 zmBlockCurr[0] = vNextFirstExp1[0]; ze_i0 = vNextFirstExp1[1]; 
                 zmBlockPrev[0] = vNextFirstExp1[2]; zeBlock[0] = vNextFirstExp1[3];
-                zfBlock[0] = vNextFirstExp2[0];
+                zfBlock[0] = vNextFirstExp2[0]; expMax = vNextFirstExp2[1];
 #endif 
             } else{
                 zmBlockPrev[0] = exp(zmFirst[i] - log_zmMax);
@@ -925,6 +931,22 @@ void FwBwAligner::computeProbabilityMatrix() {
             simdf32_store(&P[i][j], P_val);
             vMaxP = simdf32_max(vMaxP, P_val);
         }    
+        if (exactExp == false && colLoopEndPos < colSeqLen) {
+            // the rows are padded to a full vector, only the valid lanes are kept
+            simd_float vZmForward_Backward = simdf32_load(&zm[i][colLoopEndPos]);
+            simd_float scoreForwardVal;
+            if (profile) {
+                scoreForwardVal = simdf32_load(&scoreForwardProfile[rowSeqAANum[i]][colLoopEndPos]);
+            } else {
+                scoreForwardVal = simdf32_load(&scoreForward[i][colLoopEndPos]);
+            }
+            simd_float P_val = simdf32_exp(simdf32_sub(vZmForward_Backward, simdf32_add(scoreForwardVal, vLogsumexp_zm)));
+            for (size_t j = colLoopEndPos; j < colSeqLen; ++j) {
+                P[i][j] = P_val[j - colLoopEndPos];
+                maxP = std::max(maxP, P[i][j]);
+            }
+            continue;
+        }
         for (size_t j = colLoopEndPos; j < colSeqLen; ++j) {
             if (profile) {
                 P[i][j] = exp(zm[i][j] - scoreForwardProfile[rowSeqAANum[i]][j] - logsumexp_zm);
@@ -45,6 +45,9 @@ public:
     template<bool profile, int backtrace>
     void resizeMatrix(size_t newRowsCapacity, size_t newColsCapacity);
     void resetParams(float newGapOpen, float newGapExtend, float newTemperature);
+    // false: use the SIMD exp/log approximation also for the per-row rescaling terms
+    // and the column remainder of the probability matrix instead of libm
+    void setExactExp(bool exact) { exactExp = exact; }
     
     //Initilization
     void initProfile(unsigned char* colAANum, size_t colAALen);
@@ -124,6 +127,7 @@ private:
     simd_float vMax_zm;
     simd_float vSum_exp;
     size_t colSeqLen_padding;
+    bool exactExp;
     
     s_align alignResult;
 
@@ -0,0 +1,84 @@
+#include "AlignmentGraph.h"
+#include "Debug.h"
+#include "Util.h"
+
+#include <climits>
+#include <cstring>
+
+const char AlignmentGraph::MAGIC[8] = {'A', 'L', 'N', 'G', 'R', 'P', 'H', '1'};
+
+size_t AlignmentGraph::serializedSize(size_t nodeCount, size_t edgeCount) {
+    return sizeof(Header)
+           + (nodeCount + 1) * sizeof(uint64_t)
+           + nodeCount * sizeof(unsigned int)
+           + edgeCount * (sizeof(unsigned int) + sizeof(int) + sizeof(float) + 3 * sizeof(unsigned short));
+}
+
+AlignmentGraph::AlignmentGraph(char *data, size_t dataSize) {
+    if (dataSize < sizeof(Header) || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        Debug(Debug::ERROR) << "Invalid alignment graph\n";
+        EXIT(EXIT_FAILURE);
+    }
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+    nodeCount = header.nodeCount;
+    edgeCount = header.edgeCount;
+    if (dataSize < serializedSize(nodeCount, edgeCount)) {
+        Debug(Debug::ERROR) << "Alignment graph is truncated\n";
+        EXIT(EXIT_FAILURE);
+    }
+    setupPointers(data);
+}
+
+AlignmentGraph::AlignmentGraph(char *data, size_t nodeCount, size_t edgeCount) : nodeCount(nodeCount), edgeCount(edgeCount) {
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.nodeCount = nodeCount;
+    header.edgeCount = edgeCount;
+    memcpy(data, &header, sizeof(Header));
+    setupPointers(data);
+}
+
+void AlignmentGraph::setupPointers(char *data) {
+    char *pos = data + sizeof(Header);
+    offsets = reinterpret_cast<uint64_t *>(pos);
+    pos += (nodeCount + 1) * sizeof(uint64_t);
+    keys = reinterpret_cast<unsigned int *>(pos);
+    pos += nodeCount * sizeof(unsigned int);
+    targets = reinterpret_cast<unsigned int *>(pos);
+    pos += edgeCount * sizeof(unsigned int);
+    scores = reinterpret_cast<int *>(pos);
+    pos += edgeCount * sizeof(int);
+    evalues = reinterpret_cast<float *>(pos);
+    pos += edgeCount * sizeof(float);
+    seqIds = reinterpret_cast<unsigned short *>(pos);
+    pos += edgeCount * sizeof(unsigned short);
+    queryCovs = reinterpret_cast<unsigned short *>(pos);
+    pos += edgeCount * sizeof(unsigned short);
+    targetCovs = reinterpret_cast<unsigned short *>(pos);
+}
+
+unsigned int AlignmentGraph::getNode(unsigned int key) const {
+    const unsigned int *begin = keys;
+    const unsigned int *end = keys + nodeCount;
+    const unsigned int *it = std::lower_bound(begin, end, key);
+    return (it != end && *it == key) ? static_cast<unsigned int>(it - keys) : UINT_MAX;
+}
+
+bool AlignmentGraph::isAccepted(size_t edge, const EdgeFilter &filter) const {
+    if (filter.evalThr >= 0.0 && evalues[edge] > filter.evalThr) {
+        return false;
+    }
+    if (seqIds[edge] / 1000.0f < filter.seqIdThr) {
+        return false;
+    }
+    return Util::hasCoverage(filter.covThr, filter.covMode, queryCovs[edge] / 65535.0f, targetCovs[edge] / 65535.0f);
+}
+
+size_t AlignmentGraph::acceptedEdgeCount(size_t node, const EdgeFilter &filter) const {
+    size_t count = 0;
+    for (uint64_t edge = offsets[node]; edge < offsets[node + 1]; edge++) {
+        count += isAccepted(edge, filter);
+    }
+    return count;
+}
@@ -0,0 +1,76 @@
+#ifndef ALIGNMENTGRAPH_H
+#define ALIGNMENTGRAPH_H
+
+// Binary CSR form of an alignment result DB. It is stored as the only entry of a DB with dbtype
+// DBTYPE_ALIGNMENT_GRAPH, so the clustering can use the memory mapped data without parsing text.
+//
+// Layout of the entry, all arrays are naturally aligned:
+//   Header
+//   uint64_t offsets[nodeCount + 1]   edges of node i are [offsets[i], offsets[i + 1])
+//   uint32_t keys[nodeCount]          ascending DB keys of the nodes
+//   uint32_t targets[edgeCount]       node index of each edge target, in alignment result order
+//   int32_t  scores[edgeCount]        alignment score column
+//   float    evalues[edgeCount]
+//   uint16_t seqIds[edgeCount]        sequence identity * 1000, truncated like clust does
+//   uint16_t queryCovs[edgeCount]     query coverage * 65535
+//   uint16_t targetCovs[edgeCount]    target coverage * 65535
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+class AlignmentGraph {
+public:
+    struct Header {
+        char magic[8];
+        uint64_t nodeCount;
+        uint64_t edgeCount;
+    };
+
+    // edges below any of the thresholds are skipped, the defaults keep every edge
+    struct EdgeFilter {
+        EdgeFilter() : evalThr(-1.0), seqIdThr(0.0f), covThr(0.0f), covMode(0) {}
+        double evalThr;
+        float seqIdThr;
+        float covThr;
+        int covMode;
+    };
+
+    // view on a serialized graph, exits if the data is not one
+    AlignmentGraph(char *data, size_t dataSize);
+    // writes the header of an empty graph into data, which must hold serializedSize bytes
+    AlignmentGraph(char *data, size_t nodeCount, size_t edgeCount);
+
+    static size_t serializedSize(size_t nodeCount, size_t edgeCount);
+
+    // node index of a DB key or UINT_MAX
+    unsigned int getNode(unsigned int key) const;
+
+    bool isAccepted(size_t edge, const EdgeFilter &filter) const;
+    size_t acceptedEdgeCount(size_t node, const EdgeFilter &filter) const;
+
+    static unsigned short quantizeSeqId(double seqId) {
+        return static_cast<unsigned short>(seqId * 1000.0f);
+    }
+    static unsigned short quantizeCov(float cov) {
+        return static_cast<unsigned short>(std::min(cov, 1.0f) * 65535.0f + 0.5f);
+    }
+
+    size_t nodeCount;
+    size_t edgeCount;
+    uint64_t *offsets;
+    unsigned int *keys;
+    unsigned int *targets;
+    int *scores;
+    float *evalues;
+    unsigned short *seqIds;
+    unsigned short *queryCovs;
+    unsigned short *targetCovs;
+
+private:
+    void setupPointers(char *data);
+
+    static const char MAGIC[8];
+};
+
+#endif
@@ -120,6 +120,43 @@ void AlignmentSymmetry::readInData(DBReader<unsigned int>*alnDbr, DBReader<unsig
     }
 }
 
+void AlignmentSymmetry::readInData(const AlignmentGraph &graph, const AlignmentGraph::EdgeFilter &filter,
+                                   const unsigned int *idToNode, const unsigned int *nodeToId, size_t dbSize,
+                                   unsigned int **elementLookupTable, unsigned short **elementScoreTable,
+                                   int scoretype, size_t *offsets) {
+    Debug::Progress progress(dbSize);
+#pragma omp parallel for schedule(dynamic, 100)
+    for (size_t i = 0; i < dbSize; i++) {
+        progress.updateProgress();
+        const unsigned int node = idToNode[i];
+        const size_t setSize = LEN(offsets, i);
+        size_t writePos = 0;
+        for (uint64_t edge = graph.offsets[node]; edge < graph.offsets[node + 1]; edge++) {
+            if (graph.isAccepted(edge, filter) == false) {
+                continue;
+            }
+            if (writePos >= setSize) {
+                Debug(Debug::ERROR) << "Set " << i << " has more elements than allocated (" << setSize << ")!\n";
+                EXIT(EXIT_FAILURE);
+            }
+            elementLookupTable[i][writePos] = nodeToId[graph.targets[edge]];
+            if (elementScoreTable != NULL) {
+                elementScoreTable[i][writePos] = (scoretype == Parameters::APC_ALIGNMENTSCORE)
+                                                 ? (unsigned short) graph.scores[edge] : graph.seqIds[edge];
+            }
+            writePos++;
+        }
+        // like an empty alignment result entry the node only contains itself
+        if (writePos == 0) {
+            elementLookupTable[i][0] = i;
+            if (elementScoreTable != NULL) {
+                elementScoreTable[i][0] = (scoretype == Parameters::APC_ALIGNMENTSCORE)
+                                          ? (unsigned short) (USHRT_MAX) : (unsigned short) (1.0 * 1000.0f);
+            }
+        }
+    }
+}
+
 size_t AlignmentSymmetry::findMissingLinks(unsigned int ** elementLookupTable, size_t * offsetTable, size_t dbSize, int threads) {
     // init memory for parallel merge
     unsigned int * tmpSize = new(std::nothrow) unsigned int[threads * dbSize];
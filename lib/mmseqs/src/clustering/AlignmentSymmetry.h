@@ -10,10 +10,15 @@
 #include <Util.h>
 
 #include "DBReader.h"
+#include "AlignmentGraph.h"
 
 class AlignmentSymmetry {
 public:
     static void readInData(DBReader<unsigned int>*pReader, DBReader<unsigned int>*pDBReader, unsigned int **pInt,unsigned short**elementScoreTable, int scoretype, size_t *offsets);
+    // same as above for the accepted edges of an alignment graph, idToNode and nodeToId map between sequence and node ids
+    static void readInData(const AlignmentGraph &graph, const AlignmentGraph::EdgeFilter &filter,
+                           const unsigned int *idToNode, const unsigned int *nodeToId, size_t dbSize,
+                           unsigned int **elementLookupTable, unsigned short **elementScoreTable, int scoretype, size_t *offsets);
     template<typename T>
     static void computeOffsetFromCounts(T* elementSizes, size_t dbSize)  {
         size_t prevElementLength = elementSizes[0];
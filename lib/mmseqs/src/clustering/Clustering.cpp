@@ -10,7 +10,10 @@ Clustering::Clustering(const std::string &seqDB, const std::string &seqDBIndex,
                        const std::string &alnDB, const std::string &alnDBIndex,
                        const std::string &outDB, const std::string &outDBIndex,
                        const std::string &sequenceWeightFile,
-                       unsigned int maxIteration, int similarityScoreType, int threads, int compressed) : maxIteration(maxIteration),
+                       unsigned int maxIteration, int similarityScoreType, int threads, int compressed,
+                       const AlignmentGraph::EdgeFilter &edgeFilter) : graph(NULL),
+                                                               edgeFilter(edgeFilter),
+                                                               maxIteration(maxIteration),
                                                                similarityScoreType(similarityScoreType),
                                                                threads(threads),
                                                                compressed(compressed),
@@ -38,10 +41,14 @@ Clustering::Clustering(const std::string &seqDB, const std::string &seqDBIndex,
 
     alnDbr = new DBReader<unsigned int>(alnDB.c_str(), alnDBIndex.c_str(), threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     alnDbr->open(DBReader<unsigned int>::NOSORT);
+    if (Parameters::isEqualDbtype(alnDbr->getDbtype(), Parameters::DBTYPE_ALIGNMENT_GRAPH)) {
+        graph = new AlignmentGraph(alnDbr->getData(0, 0), alnDbr->getEntryLen(0));
+    }
 
 }
 
 Clustering::~Clustering() {
+    delete graph;
     delete seqDbr;
     delete alnDbr;
 }
@@ -53,9 +60,14 @@ void Clustering::run(int mode) {
     dbw->open();
 
     std::pair<unsigned int, unsigned int> * ret;
-    ClusteringAlgorithms *algorithm = new ClusteringAlgorithms(seqDbr, alnDbr,
-                                                               threads, similarityScoreType,
-                                                               maxIteration);
+    ClusteringAlgorithms *algorithm;
+    if (graph != NULL) {
+        algorithm = new ClusteringAlgorithms(seqDbr, graph, edgeFilter,
+                                             threads, similarityScoreType, maxIteration);
+    } else {
+        algorithm = new ClusteringAlgorithms(seqDbr, alnDbr,
+                                             threads, similarityScoreType, maxIteration);
+    }
 
     if (mode == Parameters::GREEDY) {
         Debug(Debug::INFO) << "Clustering mode: Greedy\n";
@@ -66,6 +78,9 @@ void Clustering::run(int mode) {
     } else if (mode == Parameters::SET_COVER) {
         Debug(Debug::INFO) << "Clustering mode: Set Cover\n";
         ret = algorithm->execute(1);
+    } else if (mode == Parameters::SET_COVER_PARALLEL) {
+        Debug(Debug::INFO) << "Clustering mode: Parallel Set Cover\n";
+        ret = algorithm->execute(5);
     } else if (mode == Parameters::CONNECTED_COMPONENT) {
         Debug(Debug::INFO) << "Clustering mode: Connected Component\n";
         ret = algorithm->execute(3);
@@ -76,7 +91,7 @@ void Clustering::run(int mode) {
 
     Timer timerWrite;
 
-    size_t dbSize = alnDbr->getSize();
+    size_t dbSize = (graph != NULL) ? graph->nodeCount : alnDbr->getSize();
     size_t seqDbSize = seqDbr->getSize();
     size_t cluNum = (dbSize > 0) ? 1 : 0;
     for(size_t i = 1; i < dbSize; i++){
@@ -5,6 +5,7 @@
 
 #include "DBReader.h"
 #include "DBWriter.h"
+#include "AlignmentGraph.h"
 
 class Clustering {
 public:
@@ -12,7 +13,8 @@ public:
                const std::string &alnResultsDB, const std::string &alnResultsDBIndex,
                const std::string &outDB, const std::string &outDBIndex,
                const std::string &weightFileName,
-               unsigned int maxIteration, int similarityScoreType, int threads, int compressed);
+               unsigned int maxIteration, int similarityScoreType, int threads, int compressed,
+               const AlignmentGraph::EdgeFilter &edgeFilter = AlignmentGraph::EdgeFilter());
 
     void run(int mode);
 
@@ -25,6 +27,9 @@ private:
 
     DBReader<unsigned int> *seqDbr;
     DBReader<unsigned int> *alnDbr;
+    // set if the result DB is an alignment graph
+    AlignmentGraph *graph;
+    AlignmentGraph::EdgeFilter edgeFilter;
 
     //values for affinity clustering
     unsigned int maxIteration;
@@ -22,6 +22,7 @@ ClusteringAlgorithms::ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, DBRea
         EXIT(EXIT_FAILURE);
     }
     this->alnDbr=alnDbr;
+    this->graph=NULL;
     this->dbSize=alnDbr->getSize();
     this->threads=threads;
     this->scoretype=scoretype;
@@ -31,6 +32,36 @@ ClusteringAlgorithms::ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, DBRea
     std::fill_n(clustersizes, dbSize, 0);
 }
 
+ClusteringAlgorithms::ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, const AlignmentGraph* graph,
+                                           const AlignmentGraph::EdgeFilter& filter,
+                                           int threads, int scoretype, int maxiterations){
+    this->seqDbr=seqDbr;
+    if(seqDbr->getSize() != graph->nodeCount){
+        Debug(Debug::ERROR) << "Sequence db size != alignment graph size\n";
+        EXIT(EXIT_FAILURE);
+    }
+    this->alnDbr=NULL;
+    this->graph=graph;
+    this->edgeFilter=filter;
+    this->dbSize=graph->nodeCount;
+    this->threads=threads;
+    this->scoretype=scoretype;
+    this->maxiterations=maxiterations;
+    idToNode.resize(dbSize);
+    nodeToId.resize(dbSize);
+    for (size_t id = 0; id < dbSize; id++) {
+        const unsigned int node = graph->getNode(seqDbr->getDbKey(id));
+        if (node == UINT_MAX) {
+            Debug(Debug::ERROR) << "Sequence " << seqDbr->getDbKey(id) << " is not contained in the alignment graph\n";
+            EXIT(EXIT_FAILURE);
+        }
+        idToNode[id] = node;
+        nodeToId[node] = id;
+    }
+    this->clustersizes=new int[dbSize];
+    std::fill_n(clustersizes, dbSize, 0);
+}
+
 ClusteringAlgorithms::~ClusteringAlgorithms(){
     delete [] clustersizes;
 }
@@ -54,10 +85,8 @@ std::pair<unsigned int, unsigned int> * ClusteringAlgorithms::execute(int mode)
             thread_idx = omp_get_thread_num();
 #endif
 #pragma omp for schedule(dynamic, 10)
-            for (size_t i = 0; i < alnDbr->getSize(); i++) {
-                const char *data = alnDbr->getData(i, thread_idx);
-                const size_t dataSize = alnDbr->getEntryLen(i);
-                elementCount += (*data == '\0') ? 1 : Util::countLines(data, dataSize);
+            for (size_t i = 0; i < dbSize; i++) {
+                elementCount += getElementCount(i, thread_idx);
             }
         }
         unsigned int * elements = new(std::nothrow) unsigned int[elementCount];
@@ -78,6 +107,8 @@ std::pair<unsigned int, unsigned int> * ClusteringAlgorithms::execute(int mode)
         ClusteringAlgorithms::initClustersizes();
         if (mode == 1) {
             setCover(elementLookupTable, scoreLookupTable, assignedcluster, bestscore, elementOffsets);
+        } else if (mode == 5) {
+            parallelSetCover(elementLookupTable, scoreLookupTable, assignedcluster, elementOffsets);
         } else if (mode == 3) {
             Debug(Debug::INFO) << "connected component mode" << "\n";
             for (int cl_size = dbSize - 1; cl_size >= 0; cl_size--) {
@@ -268,6 +299,151 @@ void ClusteringAlgorithms::setCover(unsigned int **elementLookupTable, unsigned
     }
 }
 
+// bijective mixing of the sequence ids (murmur3 finalizer) to break ties between sets of equal size
+static inline unsigned int mixSetId(unsigned int id) {
+    id ^= id >> 16;
+    id *= 0x85ebca6b;
+    id ^= id >> 13;
+    id *= 0xc2b2ae35;
+    id ^= id >> 16;
+    return id;
+}
+
+// Greedy set cover in parallel rounds. In each round every uncovered sequence whose set has the highest
+// priority (number of uncovered members, then a hash of the id) among all sets sharing an uncovered member
+// becomes a representative. Sequential greedy would select these sets with the same members, since set
+// sizes only decrease, so the result equals set cover with a different order among sets of equal size.
+void ClusteringAlgorithms::parallelSetCover(unsigned int **elementLookupTable, unsigned short ** elementScoreLookupTable,
+                                            unsigned int *assignedcluster, size_t *elementOffsets) {
+    unsigned int *coveredBy = new(std::nothrow) unsigned int[dbSize];
+    Util::checkAllocation(coveredBy, "Can not allocate coveredBy memory in ClusteringAlgorithms::parallelSetCover");
+    std::fill_n(coveredBy, dbSize, UINT_MAX);
+    uint64_t *priority = new(std::nothrow) uint64_t[dbSize];
+    Util::checkAllocation(priority, "Can not allocate priority memory in ClusteringAlgorithms::parallelSetCover");
+    uint64_t *maxPriority = new(std::nothrow) uint64_t[dbSize];
+    Util::checkAllocation(maxPriority, "Can not allocate maxPriority memory in ClusteringAlgorithms::parallelSetCover");
+
+    std::vector<unsigned int> uncovered(dbSize);
+    for (unsigned int i = 0; i < dbSize; i++) {
+        uncovered[i] = i;
+    }
+    // representatives in the order of selection
+    std::vector<unsigned int> representatives;
+    size_t rounds = 0;
+    while (uncovered.empty() == false) {
+        const size_t uncoveredCount = uncovered.size();
+        const size_t roundStart = representatives.size();
+#pragma omp parallel
+        {
+#pragma omp for schedule(dynamic, 1000)
+            for (size_t i = 0; i < uncoveredCount; i++) {
+                const unsigned int id = uncovered[i];
+                uint64_t size = 0;
+                for (size_t j = elementOffsets[id]; j < elementOffsets[id + 1]; j++) {
+                    size += (coveredBy[elementLookupTable[id][j - elementOffsets[id]]] == UINT_MAX);
+                }
+                priority[id] = (size << 32) | mixSetId(id);
+            }
+            // highest priority of all uncovered sets containing the sequence (the graph is symmetric)
+#pragma omp for schedule(dynamic, 1000)
+            for (size_t i = 0; i < uncoveredCount; i++) {
+                const unsigned int id = uncovered[i];
+                uint64_t currMax = priority[id];
+                const size_t elementSize = elementOffsets[id + 1] - elementOffsets[id];
+                for (size_t j = 0; j < elementSize; j++) {
+                    const unsigned int setId = elementLookupTable[id][j];
+                    if (coveredBy[setId] == UINT_MAX) {
+                        currMax = std::max(currMax, priority[setId]);
+                    }
+                }
+                maxPriority[id] = currMax;
+            }
+            std::vector<unsigned int> threadRepresentatives;
+#pragma omp for schedule(dynamic, 1000) nowait
+            for (size_t i = 0; i < uncoveredCount; i++) {
+                const unsigned int id = uncovered[i];
+                bool isRepresentative = (maxPriority[id] == priority[id]);
+                const size_t elementSize = elementOffsets[id + 1] - elementOffsets[id];
+                for (size_t j = 0; j < elementSize && isRepresentative; j++) {
+                    const unsigned int element = elementLookupTable[id][j];
+                    isRepresentative = (coveredBy[element] != UINT_MAX || maxPriority[element] == priority[id]);
+                }
+                if (isRepresentative) {
+                    threadRepresentatives.push_back(id);
+                }
+            }
+#pragma omp critical
+            representatives.insert(representatives.end(), threadRepresentatives.begin(), threadRepresentatives.end());
+        }
+        std::sort(representatives.begin() + roundStart, representatives.end(),
+                  [priority](unsigned int first, unsigned int second) { return priority[first] > priority[second]; });
+        // the selected sets share no uncovered member
+#pragma omp parallel for schedule(dynamic, 100)
+        for (size_t i = roundStart; i < representatives.size(); i++) {
+            const unsigned int representative = representatives[i];
+            coveredBy[representative] = representative;
+            const size_t elementSize = elementOffsets[representative + 1] - elementOffsets[representative];
+            for (size_t j = 0; j < elementSize; j++) {
+                const unsigned int element = elementLookupTable[representative][j];
+                if (coveredBy[element] == UINT_MAX) {
+                    coveredBy[element] = representative;
+                }
+            }
+        }
+        size_t uncoveredPos = 0;
+        for (size_t i = 0; i < uncoveredCount; i++) {
+            if (coveredBy[uncovered[i]] == UINT_MAX) {
+                uncovered[uncoveredPos++] = uncovered[i];
+            }
+        }
+        uncovered.resize(uncoveredPos);
+        rounds++;
+    }
+    Debug(Debug::INFO) << "Selected " << representatives.size() << " representatives in " << rounds << " rounds\n";
+    delete[] maxPriority;
+    delete[] priority;
+
+    // as in setCover, members join the representative with the best score, the earlier selected one on ties
+    uint64_t *bestKey = new(std::nothrow) uint64_t[dbSize];
+    Util::checkAllocation(bestKey, "Can not allocate bestKey memory in ClusteringAlgorithms::parallelSetCover");
+    std::fill_n(bestKey, dbSize, 0);
+#pragma omp parallel for schedule(dynamic, 100)
+    for (size_t i = 0; i < representatives.size(); i++) {
+        const unsigned int representative = representatives[i];
+        const size_t elementSize = elementOffsets[representative + 1] - elementOffsets[representative];
+        for (size_t j = 0; j < elementSize; j++) {
+            const short seqId = elementScoreLookupTable[representative][j];
+            if (seqId == SHRT_MIN) {
+                continue;
+            }
+            const unsigned int element = elementLookupTable[representative][j];
+            const uint64_t key = (static_cast<uint64_t>(seqId - SHRT_MIN) << 32) | (UINT_MAX - i);
+            uint64_t current = bestKey[element];
+            while (key > current) {
+                const uint64_t previous = __sync_val_compare_and_swap(&bestKey[element], current, key);
+                if (previous == current) {
+                    break;
+                }
+                current = previous;
+            }
+        }
+    }
+#pragma omp parallel for schedule(static)
+    for (size_t id = 0; id < dbSize; id++) {
+        if (bestKey[id] == 0) {
+            assignedcluster[id] = coveredBy[id];
+        } else {
+            assignedcluster[id] = representatives[UINT_MAX - static_cast<unsigned int>(bestKey[id] & UINT_MAX)];
+        }
+    }
+#pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < representatives.size(); i++) {
+        assignedcluster[representatives[i]] = representatives[i];
+    }
+    delete[] bestKey;
+    delete[] coveredBy;
+}
+
 void ClusteringAlgorithms::greedyIncrementalLowMem( unsigned int *assignedcluster) {
 
     const long BUFFER_SIZE = 100000; // Set this to a suitable value.
@@ -289,10 +465,20 @@ void ClusteringAlgorithms::greedyIncrementalLowMem( unsigned int *assignedcluste
 #pragma omp parallel for schedule(dynamic, 4)
         for (long i = start; i < end; i++) {
             unsigned int clusterKey = seqDbr->getDbKey(i);
-            const size_t alnId = alnDbr->getId(clusterKey);
-            char* data = alnDbr->getData(alnId, 0);
 
             std::vector<unsigned int>& keys = buffer[i - start].second;
+            if (graph != NULL) {
+                const unsigned int node = idToNode[i];
+                for (uint64_t edge = graph->offsets[node]; edge < graph->offsets[node + 1]; edge++) {
+                    if (graph->isAccepted(edge, edgeFilter)) {
+                        keys.push_back(graph->keys[graph->targets[edge]]);
+                    }
+                }
+                buffer[i - start].first = i;
+                continue;
+            }
+            const size_t alnId = alnDbr->getId(clusterKey);
+            char* data = alnDbr->getData(alnId, 0);
             while (*data != '\0') {
                 char dbKey[255 + 1];
                 Util::parseKey(data, dbKey);
@@ -337,6 +523,17 @@ void ClusteringAlgorithms::greedyIncrementalLowMem( unsigned int *assignedcluste
     }
 }
 
+size_t ClusteringAlgorithms::getElementCount(size_t id, int thread_idx) {
+    if (graph != NULL) {
+        const size_t count = graph->acceptedEdgeCount(idToNode[id], edgeFilter);
+        return (count == 0) ? 1 : count;
+    }
+    const size_t alnId = alnDbr->getId(seqDbr->getDbKey(id));
+    const char *data = alnDbr->getData(alnId, thread_idx);
+    const size_t dataSize = alnDbr->getEntryLen(alnId);
+    return (*data == '\0') ? 1 : Util::countLines(data, dataSize);
+}
+
 void ClusteringAlgorithms::readInClusterData(unsigned int **elementLookupTable, unsigned int *&elements,
                                              unsigned short **scoreLookupTable, unsigned short *&scores,
                                              size_t *elementOffsets, size_t totalElementCount) {
@@ -349,11 +546,7 @@ void ClusteringAlgorithms::readInClusterData(unsigned int **elementLookupTable,
 #endif
 #pragma omp for schedule(dynamic, 1000)
         for (size_t i = 0; i < dbSize; i++) {
-            const unsigned int clusterId = seqDbr->getDbKey(i);
-            const size_t alnId = alnDbr->getId(clusterId);
-            const char *data = alnDbr->getData(alnId, thread_idx);
-            const size_t dataSize = alnDbr->getEntryLen(alnId);
-            elementOffsets[i] = (*data == '\0') ? 1 : Util::countLines(data, dataSize);
+            elementOffsets[i] = getElementCount(i, thread_idx);
         }
     }
 
@@ -363,7 +556,12 @@ void ClusteringAlgorithms::readInClusterData(unsigned int **elementLookupTable,
     AlignmentSymmetry::setupPointers<unsigned int>(elements, elementLookupTable, elementOffsets, dbSize,
                                                    totalElementCount);
     // fill elements
-    AlignmentSymmetry::readInData(alnDbr, seqDbr, elementLookupTable, NULL, 0, elementOffsets);
+    if (graph != NULL) {
+        AlignmentSymmetry::readInData(*graph, edgeFilter, idToNode.data(), nodeToId.data(), dbSize,
+                                      elementLookupTable, NULL, 0, elementOffsets);
+    } else {
+        AlignmentSymmetry::readInData(alnDbr, seqDbr, elementLookupTable, NULL, 0, elementOffsets);
+    }
     Debug(Debug::INFO) << "Sort entries\n";
     AlignmentSymmetry::sortElements(elementLookupTable, elementOffsets, dbSize);
     Debug(Debug::INFO) << "Find missing connections\n";
@@ -389,9 +587,14 @@ void ClusteringAlgorithms::readInClusterData(unsigned int **elementLookupTable,
     AlignmentSymmetry::setupPointers<unsigned short>(scores, scoreLookupTable, newElementOffsets, dbSize, symmetricElementCount);
     //time
     Debug(Debug::INFO) << "Reconstruct initial order\n";
-    alnDbr->remapData(); // need to free memory
-    AlignmentSymmetry::readInData(alnDbr, seqDbr, elementLookupTable, scoreLookupTable, scoretype, elementOffsets);
-    alnDbr->remapData(); // need to free memory
+    if (graph != NULL) {
+        AlignmentSymmetry::readInData(*graph, edgeFilter, idToNode.data(), nodeToId.data(), dbSize,
+                                      elementLookupTable, scoreLookupTable, scoretype, elementOffsets);
+    } else {
+        alnDbr->remapData(); // need to free memory
+        AlignmentSymmetry::readInData(alnDbr, seqDbr, elementLookupTable, scoreLookupTable, scoretype, elementOffsets);
+        alnDbr->remapData(); // need to free memory
+    }
     Debug(Debug::INFO) << "Add missing connections\n";
     AlignmentSymmetry::addMissingLinks(elementLookupTable, elementOffsets, newElementOffsets, dbSize, scoreLookupTable);
     maxClustersize = 0;
@@ -11,10 +11,14 @@
 #include <unordered_map>
 
 #include "DBReader.h"
+#include "AlignmentGraph.h"
 
 class ClusteringAlgorithms {
 public:
     ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, DBReader<unsigned int>* alnDbr, int threads,int scoretype, int maxiterations);
+    // clusters the accepted edges of an alignment graph instead of an alignment result DB
+    ClusteringAlgorithms(DBReader<unsigned int>* seqDbr, const AlignmentGraph* graph, const AlignmentGraph::EdgeFilter& filter,
+                         int threads, int scoretype, int maxiterations);
     ~ClusteringAlgorithms();
     std::pair<unsigned int, unsigned int> * execute(int mode);
 private:
@@ -22,6 +26,11 @@ private:
 
     DBReader<unsigned int>* alnDbr;
 
+    const AlignmentGraph* graph;
+    AlignmentGraph::EdgeFilter edgeFilter;
+    // graph node of each sequence id and sequence id of each node
+    std::vector<unsigned int> idToNode;
+    std::vector<unsigned int> nodeToId;
 
     int threads;
     int scoretype;
@@ -35,6 +44,9 @@ private:
 
 //methods
 
+    // number of elements of the set of sequence id, an empty set contains itself
+    size_t getElementCount(size_t id, int thread_idx);
+
     void initClustersizes();
 
     void removeClustersize(unsigned int clusterid);
@@ -47,6 +59,9 @@ private:
     void setCover(unsigned int **elementLookup, unsigned short ** elementScoreLookupTable,
                   unsigned int *assignedcluster, short *bestscore, size_t *offsets);
 
+    void parallelSetCover(unsigned int **elementLookupTable, unsigned short ** elementScoreLookupTable,
+                          unsigned int *assignedcluster, size_t *offsets);
+
     void greedyIncremental(unsigned int **elementLookupTable, size_t *elementOffsets,
                            size_t n, unsigned int *assignedcluster) ;
 
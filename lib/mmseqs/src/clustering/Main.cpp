@@ -5,9 +5,22 @@ int clust(int argc, const char **argv, const Command& command) {
     Parameters& par = Parameters::getInstance();
     par.parseParameters(argc, argv, command, true, 0, 0);
 
+    // thresholds only apply to alignment graphs, the edges of a result DB were already filtered
+    AlignmentGraph::EdgeFilter edgeFilter;
+    if (par.PARAM_E.wasSet) {
+        edgeFilter.evalThr = par.evalThr;
+    }
+    if (par.PARAM_MIN_SEQ_ID.wasSet) {
+        edgeFilter.seqIdThr = par.seqIdThr;
+    }
+    if (par.PARAM_C.wasSet) {
+        edgeFilter.covThr = par.covThr;
+        edgeFilter.covMode = par.covMode;
+    }
+
     Clustering clu(par.db1, par.db1Index, par.db2, par.db2Index,
                    par.db3, par.db3Index, par.weightFile, par.maxIteration,
-                   par.similarityScoreType, par.threads, par.compressed);
+                   par.similarityScoreType, par.threads, par.compressed, edgeFilter);
     clu.run(par.clusteringMode);
     return EXIT_SUCCESS;
 }
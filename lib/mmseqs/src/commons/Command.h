@@ -54,6 +54,7 @@ struct DbValidator {
     static std::vector<int> prefilterDb;
     static std::vector<int> clusterDb;
     static std::vector<int> resultDb;
+    static std::vector<int> resultOrGraphDb;
     static std::vector<int> ppResultDb;
     static std::vector<int> ca3mDb;
     static std::vector<int> msaDb;
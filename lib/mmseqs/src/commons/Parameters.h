@@ -86,6 +86,7 @@ public:
     static const int DBTYPE_SEQTAXDB = 18; // needed for verification
     static const int DBTYPE_STDIN = 19; // needed for verification
     static const int DBTYPE_URI = 20; // needed for verification
+    static const int DBTYPE_ALIGNMENT_GRAPH = 21;
 
     static const unsigned int DBTYPE_EXTENDED_COMPRESSED = 1;
     static const unsigned int DBTYPE_EXTENDED_INDEX_NEED_SRC = 2;
@@ -192,6 +193,7 @@ public:
     static const int INDEX_SUBSET_NO_HEADERS = 1;
     static const int INDEX_SUBSET_NO_PREFILTER = 2;
     static const int INDEX_SUBSET_NO_ALIGNMENT = 4;
+    static const int INDEX_SUBSET_COMPRESSED_KMERS = 8;
 
 
     static std::vector<int> getOutputFormat(int formatMode, const std::string &outformat, bool &needSequences, bool &needBacktrace, bool &needFullHeaders,
@@ -202,6 +204,7 @@ public:
     static const int CONNECTED_COMPONENT = 1;
     static const int GREEDY = 2;
     static const int GREEDY_MEM = 3;
+    static const int SET_COVER_PARALLEL = 4;
 
     // clustering
     static const int APC_ALIGNMENTSCORE=1;
@@ -573,6 +576,7 @@ public:
     int hashShift;
     int pickNbest;
     int adjustKmerLength;
+    float kmerInfoThr;
     int resultDirection;
     float weightThr;
     std::string weightFile;
@@ -839,6 +843,7 @@ public:
     // logging
     PARAMETER(PARAM_V)
     std::vector<MMseqsParameter*> clust;
+    std::vector<MMseqsParameter*> result2graph;
     // gpu
     PARAMETER(PARAM_GPU)
     PARAMETER(PARAM_GPU_SERVER)
@@ -904,6 +909,7 @@ public:
     PARAMETER(PARAM_HASH_SHIFT)
     PARAMETER(PARAM_PICK_N_SIMILAR)
     PARAMETER(PARAM_ADJUST_KMER_LEN)
+    PARAMETER(PARAM_KMER_INFO_THR)
     PARAMETER(PARAM_RESULT_DIRECTION)
     PARAMETER(PARAM_WEIGHT_FILE)
     PARAMETER(PARAM_WEIGHT_THR)
@@ -1269,6 +1275,7 @@ public:
             case DBTYPE_FLATFILE: return "Flatfile";
             case DBTYPE_STDIN: return "stdin";
             case DBTYPE_URI: return "uri";
+            case DBTYPE_ALIGNMENT_GRAPH: return "Alignment graph";
 
             default: return "Unknown";
         }
@@ -341,28 +341,24 @@ char Util::touchMemory(const char *memory, size_t size) {
         Debug(Debug::WARNING) << "Can not touch " << size << " into main memory\n";
         return 0;
     }
-    size_t pageSize = getPageSize();
-//    Debug::Progress progress(size/pageSize);
-    size_t fourTimesPageSize = 4*pageSize;
-    char buffer1 = 0;
-    char buffer2 = 0;
-    char buffer3 = 0;
-    char buffer4 = 0;
-
-    // touch first page
-    if(size > 0){
-       buffer1 += *(memory);
+    const size_t pageSize = getPageSize();
+    const size_t pages = (size + pageSize - 1) / pageSize;
+    char buffer = 0;
+#pragma omp parallel for schedule(static) reduction(+: buffer) if(pages > 1024)
+    for (size_t page = 0; page < pages; page++) {
+        buffer += *(memory + page * pageSize);
     }
+    return buffer;
+}
 
-    // load always four pages to reduce data dependency
-    for (size_t pos = 0; (pos + fourTimesPageSize) < size; pos += 4*pageSize) {
-        buffer1 += *(memory + pos);
-        buffer2 += *(memory + pos + 2*pageSize);
-        buffer3 += *(memory + pos + 3*pageSize);
-        buffer4 += *(memory + pos + 4*pageSize);
+void Util::ompMemcpy(void *dst, const void *src, size_t size) {
+    const size_t chunkSize = 64 * getPageSize();
+    const size_t chunks = (size + chunkSize - 1) / chunkSize;
+#pragma omp parallel for schedule(static) if(chunks > 16)
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        const size_t offset = chunk * chunkSize;
+        memcpy(static_cast<char *>(dst) + offset, static_cast<const char *>(src) + offset, std::min(chunkSize, size - offset));
     }
-
-    return buffer1+buffer2+buffer3+buffer4;
 }
 
 size_t Util::ompCountLines(const char* data, size_t dataSize, unsigned int MAYBE_UNUSED(threads)) {
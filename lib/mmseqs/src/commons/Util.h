@@ -95,7 +95,9 @@ public:
     static size_t getTotalMemoryPages();
     static uint64_t getL2CacheSize();
 
+    // pages are touched (or copied) by all threads, so the first touch spreads them over the NUMA nodes of the threads
     static char touchMemory(const char* memory, size_t size);
+    static void ompMemcpy(void *dst, const void *src, size_t size);
 
     static size_t countLines(const char *data, size_t length);
 
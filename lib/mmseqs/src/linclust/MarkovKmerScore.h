@@ -6,6 +6,8 @@
 #define MMSEQS_KMERMARKOVSCORE_H
 
 #include <Indexer.h>
+#include <cmath>
+#include <vector>
 
 namespace MarkovScores{
     static const int MARKOV_ORDER=4;
@@ -93,4 +95,55 @@ public:
     }
 };
 
+// First-order Markov model over the letters of k-mers, trained on the input database.
+// Used for alphabets without a pretrained model, such as reduced amino acid or 3Di alphabets,
+// where k-mers of low complexity regions carry much less information than their length suggests.
+class TrainedMarkovKmerScore{
+public:
+    TrainedMarkovKmerScore(int alphabetSize)
+            : alphabetSize(alphabetSize), firstCounts(alphabetSize, 1.0), transitionCounts(alphabetSize * alphabetSize, 1.0),
+              firstScores(alphabetSize), transitionScores(alphabetSize * alphabetSize) {}
+
+    void addKmer(const unsigned char * kmer, unsigned char kmerSize){
+        firstCounts[kmer[0]] += 1.0;
+        for(int pos = 1; pos < kmerSize; pos++){
+            transitionCounts[kmer[pos - 1] * alphabetSize + kmer[pos]] += 1.0;
+        }
+    }
+
+    // converts the counts (with a pseudo count of one) to scores in bits
+    void train(){
+        double firstTotal = 0.0;
+        for(int i = 0; i < alphabetSize; i++){
+            firstTotal += firstCounts[i];
+        }
+        for(int i = 0; i < alphabetSize; i++){
+            firstScores[i] = static_cast<float>(-log2(firstCounts[i] / firstTotal));
+            double rowTotal = 0.0;
+            for(int j = 0; j < alphabetSize; j++){
+                rowTotal += transitionCounts[i * alphabetSize + j];
+            }
+            for(int j = 0; j < alphabetSize; j++){
+                transitionScores[i * alphabetSize + j] = static_cast<float>(-log2(transitionCounts[i * alphabetSize + j] / rowTotal));
+            }
+        }
+    }
+
+    // information content of the k-mer in bits
+    float scoreKmer(const unsigned char * kmer, unsigned char kmerSize) const{
+        float totalScore = firstScores[kmer[0]];
+        for(int pos = 1; pos < kmerSize; pos++){
+            totalScore += transitionScores[kmer[pos - 1] * alphabetSize + kmer[pos]];
+        }
+        return totalScore;
+    }
+
+private:
+    const int alphabetSize;
+    std::vector<double> firstCounts;
+    std::vector<double> transitionCounts;
+    std::vector<float> firstScores;
+    std::vector<float> transitionScores;
+};
+
 #endif //MMSEQS_KMERMARKOVSCORE_H
@@ -56,6 +56,26 @@ KmerPosition<T> *initKmerPositionMemory(size_t size) {
 }
 
 
+// trains the k-mer information model on evenly spaced sequences of the input
+static TrainedMarkovKmerScore *trainKmerInformationModel(DBReader<unsigned int> &seqDbr, Parameters &par, BaseMatrix *subMat) {
+    const size_t MAX_TRAINING_SEQUENCES = 20000;
+    const size_t stride = std::max(seqDbr.getSize() / MAX_TRAINING_SEQUENCES, static_cast<size_t>(1));
+    TrainedMarkovKmerScore *model = new TrainedMarkovKmerScore(subMat->alphabetSize);
+    Sequence seq(par.maxSeqLen, seqDbr.getDbtype(), subMat, par.kmerSize, par.spacedKmer, false, true, par.spacedKmerPattern);
+    for (size_t id = 0; id < seqDbr.getSize(); id += stride) {
+        seq.mapSequence(id, seqDbr.getDbKey(id), seqDbr.getData(id, 0), seqDbr.getSeqLen(id));
+        while (seq.hasNextKmer()) {
+            const unsigned char *kmer = seq.nextKmer();
+            if (seq.kmerContainsX()) {
+                continue;
+            }
+            model->addKmer(kmer, par.kmerSize);
+        }
+    }
+    model->train();
+    return model;
+}
+
 template <int TYPE, typename T>
 std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, size_t kmerArraySize, DBReader<unsigned int> &seqDbr,
                                                 Parameters & par, BaseMatrix * subMat, bool hashWholeSequence,
@@ -71,6 +91,10 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
         two = ExtendedSubstitutionMatrix::calcScoreMatrix(*subMat, 2);
         three = ExtendedSubstitutionMatrix::calcScoreMatrix(*subMat, 3);
     }
+    TrainedMarkovKmerScore *kmerInfoModel = NULL;
+    if (TYPE == Parameters::DBTYPE_AMINO_ACIDS && par.kmerInfoThr > 0.0f) {
+        kmerInfoModel = trainKmerInformationModel(seqDbr, par, subMat);
+    }
 
     Debug::Progress progress(seqDbr.getSize());
 #pragma omp parallel
@@ -185,7 +209,13 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
                         size_t kmerIdx = idxer.int2index(kmer, 0, par.kmerSize);
                         (kmers + seqKmerCount)->kmer = kmerIdx;
                         (kmers + seqKmerCount)->pos = seq.getCurrentPosition();
-                        const unsigned short hash = hashUInt64(kmerIdx, par.hashShift);
+                        unsigned short hash = hashUInt64(kmerIdx, par.hashShift);
+                        if (kmerInfoModel != NULL) {
+                            // low information k-mers are moved to the upper half of the hash range,
+                            // so they are only selected if a sequence has too few informative k-mers
+                            const bool lowInformation = kmerInfoModel->scoreKmer(kmer, par.kmerSize) < par.kmerInfoThr * par.kmerSize;
+                            hash = lowInformation ? (hash | 0x8000) : (hash & 0x7FFF);
+                        }
 //                        (kmers + seqKmerCount)->score = hash;
 //                        const unsigned short hash = circ_hash(kmer, par.kmerSize, 5);
                         (kmers + seqKmerCount)->score = hash;
@@ -363,6 +393,9 @@ std::pair<size_t, size_t> fillKmerPositionArray(KmerPosition<T> * kmerArray, siz
         ExtendedSubstitutionMatrix::freeScoreMatrix(three);
         ExtendedSubstitutionMatrix::freeScoreMatrix(two);
     }
+    if (kmerInfoModel != NULL) {
+        delete kmerInfoModel;
+    }
 
     return std::make_pair(offset, longestKmer);
 }
@@ -685,6 +718,13 @@ int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
     size_t totalKmersPerSplit = std::max(static_cast<size_t>(1024+1),
                                          static_cast<size_t>(std::min(totalSizeNeeded, memoryLimit)/sizeof(KmerPosition<T>))+1);
 
+#ifdef HAVE_MPI
+    // shard the k-mers by hash over all ranks, even if a single node could hold all of them
+    if (MMseqsMPI::numProc > 1) {
+        splits = std::max(static_cast<size_t>(MMseqsMPI::numProc), splits);
+        totalKmersPerSplit = std::min(totalKmersPerSplit, std::max(static_cast<size_t>(1024+1), totalKmers / MMseqsMPI::numProc + 1));
+    }
+#endif
     std::vector<std::pair<size_t, size_t>> hashRanges = setupKmerSplits<T>(par, subMat, seqDbr, totalKmersPerSplit, splits);
     if(splits > 1){
         Debug(Debug::INFO) << "Process file into " << hashRanges.size() << " parts\n";
@@ -713,7 +753,7 @@ int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
 
     for(size_t split = fromSplit; split < fromSplit+splitCount; split++) {
         std::string splitFileName = par.db2 + "_split_" +SSTR(split);
-        hashSeqPair = doComputation<T>(totalKmers, hashRanges[split].first, hashRanges[split].second, splitFileName, seqDbr, par, subMat);
+        hashSeqPair = doComputation<T>(totalKmersPerSplit, hashRanges[split].first, hashRanges[split].second, splitFileName, seqDbr, par, subMat);
     }
     MPI_Barrier(MPI_COMM_WORLD);
     if(mpiRank == 0){
@@ -739,7 +779,7 @@ int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
         std::vector<char> repSequence(seqDbr.getLastKey()+1);
         std::fill(repSequence.begin(), repSequence.end(), false);
         // write result
-        DBWriter dbw(par.db2.c_str(), par.db2Index.c_str(), 1, par.compressed,
+        DBWriter dbw(par.db2.c_str(), par.db2Index.c_str(), par.threads, par.compressed,
                      (Parameters::isEqualDbtype(seqDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES)) ? Parameters::DBTYPE_PREFILTER_REV_RES : Parameters::DBTYPE_PREFILTER_RES );
         dbw.open();
 
@@ -747,9 +787,9 @@ int kmermatcherInner(Parameters& par, DBReader<unsigned int>& seqDbr) {
         if(splits > 1) {
             seqDbr.unmapData();
             if(Parameters::isEqualDbtype(seqDbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES)) {
-                mergeKmerFilesAndOutput<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev>(dbw, splitFiles, repSequence);
+                mergeKmerFilesAndOutput<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev>(dbw, splitFiles, repSequence, par.threads);
             }else{
-                mergeKmerFilesAndOutput<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry>(dbw, splitFiles, repSequence);
+                mergeKmerFilesAndOutput<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry>(dbw, splitFiles, repSequence, par.threads);
             }
             for(size_t i = 0; i < splitFiles.size(); i++){
                 FileUtil::remove(splitFiles[i].c_str());
@@ -987,30 +1027,29 @@ void writeKmerMatcherResult(DBWriter & dbw,
     }
 }
 
-template <int TYPE, typename T>
-size_t queueNextEntry(KmerPositionQueue &queue, int file, size_t offsetPos, T *entries, size_t entrySize) {
-    if(offsetPos + 1 >= entrySize){
-        return offsetPos;
-    }
-    unsigned int repSeqId = entries[offsetPos].seqId;
-    size_t pos = 0;
-    while(entries[offsetPos + pos].seqId != UINT_MAX){
-        if(TYPE == Parameters::DBTYPE_NUCLEOTIDES){
-            queue.push(FileKmerPosition(repSeqId, entries[offsetPos+pos].seqId, entries[offsetPos+pos].diagonal, entries[offsetPos+pos].score, entries[offsetPos+pos].getRev(), file));
-        }else{
-            queue.push(FileKmerPosition(repSeqId, entries[offsetPos+pos].seqId, entries[offsetPos+pos].diagonal, entries[offsetPos+pos].score, file));
-        }
-        pos++;
+template <typename T>
+static bool compareKmerEntryByIdAndDiagonal(const T &first, const T &second) {
+    if (first.seqId < second.seqId)
+        return true;
+    if (second.seqId < first.seqId)
+        return false;
+    return first.diagonal < second.diagonal;
+}
+
+// returns the offset of the terminating entry of the group starting at offsetPos
+template <typename T>
+static size_t findGroupEnd(T *entries, size_t offsetPos, size_t entrySize) {
+    while (offsetPos < entrySize && entries[offsetPos].seqId != UINT_MAX) {
+        offsetPos++;
     }
-    queue.push(FileKmerPosition(repSeqId, UINT_MAX, 0, 0, file));
-    pos++;
-    return offsetPos+pos;
+    return offsetPos;
 }
 
 template <int TYPE, typename T>
 void mergeKmerFilesAndOutput(DBWriter & dbw,
                              std::vector<std::string> tmpFiles,
-                             std::vector<char> &repSequence) {
+                             std::vector<char> &repSequence,
+                             unsigned int threads) {
     Debug(Debug::INFO) << "Merge splits ... ";
 
     const int fileCnt = tmpFiles.size();
@@ -1033,120 +1072,135 @@ void mergeKmerFilesAndOutput(DBWriter & dbw,
             }
 #endif
         }else{
+            entries[file] = NULL;
             dataSize = 0;
         }
 
         dataSizes[file]  = dataSize;
         entrySizes[file] = dataSize/sizeof(T);
-    }
-    KmerPositionQueue queue;
-    // read one entry for each file
-    for(int file = 0; file < fileCnt; file++ ){
-        offsetPos[file] = queueNextEntry<TYPE,T>(queue, file, 0, entries[file], entrySizes[file]);
-    }
-    std::string prefResultsOutString;
-    prefResultsOutString.reserve(100000000);
-    char buffer[100];
-    FileKmerPosition res;
-    bool hasRepSeq =  repSequence.size()>0;
-    unsigned int currRepSeq = UINT_MAX;
-    if(queue.empty() == false){
-        res = queue.top();
-        currRepSeq = res.repSeq;
-        if(hasRepSeq) {
-            hit_t h;
-            h.seqId = res.repSeq;
-            h.prefScore = 0;
-            h.diagonal = 0;
-            int len = QueryMatcher::prefilterHitToBuffer(buffer, h);
-            prefResultsOutString.append(buffer, len);
-        }
+        offsetPos[file] = 0;
     }
 
-//    while(queue.empty() == false) {
-//        res = queue.top();
-//        std::cout << (int)res.repSeq << "\t" << (int)res.id << "\t" <<(int) res.pos << "\t" << (int) res.reverse << std::endl;
-//        queue.pop();
-//        offsetPos[res.file] = queueNextEntry<TYPE,T>(queue, res.file, offsetPos[res.file],
-//                                                     entries[res.file], entrySizes[res.file]);
-//    }
-    while(queue.empty() == false) {
-        res = queue.top();
-        queue.pop();
-        if(res.id == UINT_MAX) {
-            offsetPos[res.file] = queueNextEntry<TYPE,T>(queue, res.file, offsetPos[res.file],
-                                                         entries[res.file], entrySizes[res.file]);
-            dbw.writeData(prefResultsOutString.c_str(), prefResultsOutString.length(), res.repSeq, 0);
-            if(hasRepSeq){
-                repSequence[res.repSeq]=true;
+    // The split files are sorted by representative sequence. Instead of merging them entry by entry,
+    // each round reads a range of representatives from all files and processes them in parallel.
+    const size_t MERGE_BATCH_ENTRIES = 64 * 1024 * 1024;
+    const size_t batchEntries = std::max(MERGE_BATCH_ENTRIES / fileCnt, static_cast<size_t>(1));
+    const bool hasRepSeq = repSequence.size() > 0;
+    std::vector<KmerEntryGroup> groups;
+    std::vector<size_t> repSeqStarts;
+    while (true) {
+        groups.clear();
+        // every file contributes up to batchEntries entries, the round ends before the
+        // first representative sequence that was not read completely from all files
+        size_t batchEnd = SIZE_T_MAX;
+        for (int file = 0; file < fileCnt; file++) {
+            size_t pos = offsetPos[file];
+            size_t readEntries = 0;
+            while (pos < entrySizes[file] && readEntries < batchEntries) {
+                size_t end = findGroupEnd<T>(entries[file], pos, entrySizes[file]);
+                const unsigned int repSeq = entries[file][pos].seqId;
+                groups.emplace_back(repSeq, file, pos, end);
+                readEntries += end - pos + 1;
+                pos = end + 1;
             }
-            prefResultsOutString.clear();
-            // skipe UINT MAX entries
-            while(queue.empty() == false && queue.top().id==UINT_MAX) {
-                res = queue.top();
-                queue.pop();
-                offsetPos[res.file] = queueNextEntry<TYPE,T>(queue, res.file, offsetPos[res.file],
-                                                             entries[res.file], entrySizes[res.file]);
+            if (pos < entrySizes[file]) {
+                batchEnd = std::min(batchEnd, static_cast<size_t>(entries[file][pos].seqId));
+            }
+        }
+        if (groups.empty()) {
+            break;
+        }
+        size_t groupCnt = 0;
+        for (size_t i = 0; i < groups.size(); i++) {
+            if (groups[i].repSeq < batchEnd) {
+                offsetPos[groups[i].file] = groups[i].end + 1;
+                groups[groupCnt++] = groups[i];
             }
-            if(queue.empty() == false) {
-                res = queue.top();
-                currRepSeq = res.repSeq;
-                queue.pop();
-                if(hasRepSeq){
+        }
+        groups.erase(groups.begin() + groupCnt, groups.end());
+        SORT_PARALLEL(groups.begin(), groups.end(), KmerEntryGroup::compareByRepSeqAndFile);
+
+        repSeqStarts.clear();
+        for (size_t i = 0; i < groups.size(); i++) {
+            if (i == 0 || groups[i].repSeq != groups[i - 1].repSeq) {
+                repSeqStarts.push_back(i);
+            }
+        }
+        repSeqStarts.push_back(groups.size());
+
+#pragma omp parallel num_threads(threads)
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+            std::string prefResultsOutString;
+            std::vector<T> mergedHits;
+            char buffer[100];
+#pragma omp for schedule(dynamic, 100)
+            for (size_t i = 0; i < repSeqStarts.size() - 1; i++) {
+                const KmerEntryGroup &firstGroup = groups[repSeqStarts[i]];
+                const unsigned int currRepSeq = firstGroup.repSeq;
+                T *hitsBegin = entries[firstGroup.file] + firstGroup.start;
+                T *hitsEnd = entries[firstGroup.file] + firstGroup.end;
+                // hits of a representative from several splits have to be brought into (id, diagonal) order
+                if (repSeqStarts[i + 1] - repSeqStarts[i] > 1) {
+                    mergedHits.clear();
+                    for (size_t j = repSeqStarts[i]; j < repSeqStarts[i + 1]; j++) {
+                        mergedHits.insert(mergedHits.end(), entries[groups[j].file] + groups[j].start, entries[groups[j].file] + groups[j].end);
+                    }
+                    std::stable_sort(mergedHits.begin(), mergedHits.end(), compareKmerEntryByIdAndDiagonal<T>);
+                    hitsBegin = mergedHits.data();
+                    hitsEnd = mergedHits.data() + mergedHits.size();
+                }
+
+                if (hasRepSeq) {
                     hit_t h;
-                    h.seqId = res.repSeq;
+                    h.seqId = currRepSeq;
                     h.prefScore = 0;
                     h.diagonal = 0;
                     int len = QueryMatcher::prefilterHitToBuffer(buffer, h);
                     prefResultsOutString.append(buffer, len);
                 }
-            }
-        }
-
-        bool hitIsRepSeq = (currRepSeq == res.id);
-        // skip rep. seq. if set does not have rep. sequences
-        if(hitIsRepSeq){
-            continue;
-        }
-        // if its not a duplicate
-        // find maximal diagonal and top score
-        int bestDiagonalCnt = 0;
-        int bestRevertMask = 0;
-        short bestDiagonal = res.pos;
-        int topScore = 0;
-        unsigned int hitId;
-        unsigned int prevHitId;
-        int diagonalScore = 0;
-        short prevDiagonal = res.pos;
-        do {
-            prevHitId = res.id;
-            diagonalScore = (diagonalScore == 0 || prevDiagonal!=res.pos) ? res.score : diagonalScore + res.score;
-            if(diagonalScore >= bestDiagonalCnt){
-                bestDiagonalCnt = diagonalScore;
-                bestDiagonal = res.pos;
-                bestRevertMask = res.reverse;
-            }
-            prevDiagonal = res.pos;
-            topScore += res.score;
-            if(queue.empty() == false) {
-                res = queue.top();
-                queue.pop();
-                hitId = res.id;
-                if(hitId != prevHitId){
-                    queue.push(res);
+                T *hit = hitsBegin;
+                while (hit < hitsEnd) {
+                    const unsigned int hitId = hit->seqId;
+                    // skip the header and the rep. seq. itself
+                    if (hitId == currRepSeq) {
+                        hit++;
+                        continue;
+                    }
+                    // find maximal diagonal and top score
+                    int bestDiagonalCnt = 0;
+                    int bestRevertMask = 0;
+                    short bestDiagonal = hit->diagonal;
+                    int topScore = 0;
+                    int diagonalScore = 0;
+                    short prevDiagonal = hit->diagonal;
+                    for (; hit < hitsEnd && hit->seqId == hitId; hit++) {
+                        diagonalScore = (diagonalScore == 0 || prevDiagonal != hit->diagonal) ? hit->score : diagonalScore + hit->score;
+                        if (diagonalScore >= bestDiagonalCnt) {
+                            bestDiagonalCnt = diagonalScore;
+                            bestDiagonal = hit->diagonal;
+                            bestRevertMask = hit->getRev();
+                        }
+                        prevDiagonal = hit->diagonal;
+                        topScore += hit->score;
+                    }
+                    hit_t h;
+                    h.seqId = hitId;
+                    h.prefScore = (bestRevertMask) ? -topScore : topScore;
+                    h.diagonal = bestDiagonal;
+                    int len = QueryMatcher::prefilterHitToBuffer(buffer, h);
+                    prefResultsOutString.append(buffer, len);
                 }
-            }else{
-                hitId = UINT_MAX;
+                dbw.writeData(prefResultsOutString.c_str(), prefResultsOutString.length(), currRepSeq, thread_idx);
+                if (hasRepSeq) {
+                    repSequence[currRepSeq] = true;
+                }
+                prefResultsOutString.clear();
             }
-
-        } while(hitId == prevHitId && res.repSeq == currRepSeq && hitId != UINT_MAX);
-
-        hit_t h;
-        h.seqId = prevHitId;
-        h.prefScore =  (bestRevertMask) ? -topScore : topScore;
-        h.diagonal =  bestDiagonal;
-        int len = QueryMatcher::prefilterHitToBuffer(buffer, h);
-        prefResultsOutString.append(buffer, len);
+        }
     }
     for(size_t file = 0; file < tmpFiles.size(); file++) {
         if (fclose(files[file]) != 0) {
@@ -157,37 +157,22 @@ struct __attribute__((__packed__)) KmerEntryRev {
     }
 };
 
-struct FileKmerPosition {
-    size_t repSeq;
-    unsigned int id;
-    short pos;
-    unsigned char score;
+// Hits of one representative sequence in a split file: a header entry with the representative,
+// the hits sorted by id and diagonal and a terminating UINT_MAX entry
+struct KmerEntryGroup {
+    unsigned int repSeq;
     unsigned int file;
-    char reverse;
-    FileKmerPosition(){}
-    FileKmerPosition(size_t repSeq, unsigned int id,short pos, unsigned char score, unsigned int file):
-            repSeq(repSeq), id(id), pos(pos), score(score), file(file), reverse(0) {}
-    FileKmerPosition(size_t repSeq, unsigned int id,short pos, unsigned char score, char reverse, unsigned int file):
-            repSeq(repSeq), id(id), pos(pos), score(score), file(file), reverse(reverse) {}
-};
+    size_t start;
+    size_t end;
+    KmerEntryGroup(unsigned int repSeq, unsigned int file, size_t start, size_t end) :
+            repSeq(repSeq), file(file), start(start), end(end) {}
 
-class CompareResultBySeqId {
-public:
-    bool operator() (FileKmerPosition & first, FileKmerPosition & second) const {
-        //return (first.eval < second.eval);
-        if(first.repSeq > second.repSeq )
+    static bool compareByRepSeqAndFile(const KmerEntryGroup &first, const KmerEntryGroup &second) {
+        if (first.repSeq < second.repSeq)
             return true;
-        if(second.repSeq > first.repSeq )
+        if (second.repSeq < first.repSeq)
             return false;
-        if(first.id > second.id )
-            return true;
-        if(second.id > first.id )
-            return false;
-        if(first.pos > second.pos )
-            return true;
-        if(second.pos > first.pos )
-            return false;
-        return false;
+        return first.file < second.file;
     }
 };
 
@@ -196,12 +181,7 @@ template  <int TYPE, typename T>
 size_t assignGroup(KmerPosition<T> *kmers, size_t splitKmerCount, bool includeOnlyExtendable, int covMode, float covThr);
 
 template <int TYPE, typename T>
-void mergeKmerFilesAndOutput(DBWriter & dbw, std::vector<std::string> tmpFiles, std::vector<char> &repSequence);
-
-typedef std::priority_queue<FileKmerPosition, std::vector<FileKmerPosition>, CompareResultBySeqId> KmerPositionQueue;
-
-template <int TYPE, typename T>
-size_t queueNextEntry(KmerPositionQueue &queue, int file, size_t offsetPos, T *entries, size_t entrySize);
+void mergeKmerFilesAndOutput(DBWriter & dbw, std::vector<std::string> tmpFiles, std::vector<char> &repSequence, unsigned int threads);
 
 void setKmerLengthAndAlphabet(Parameters &parameters, size_t aaDbSize, int seqType);
 
@@ -276,13 +276,13 @@ int kmersearch(int argc, const char **argv, const Command &command) {
     tidxdbr.close();
     queryDbr.close();
     if(splitFiles.size()>1){
-        DBWriter writer(par.db3.c_str(), par.db3Index.c_str(), 1, par.compressed, outDbType);
+        DBWriter writer(par.db3.c_str(), par.db3Index.c_str(), par.threads, par.compressed, outDbType);
         writer.open(); // 1 GB buffer
         std::vector<char> empty;
         if(Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_NUCLEOTIDES)) {
-            mergeKmerFilesAndOutput<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev>(writer, splitFiles, empty);
+            mergeKmerFilesAndOutput<Parameters::DBTYPE_NUCLEOTIDES, KmerEntryRev>(writer, splitFiles, empty, par.threads);
         }else{
-            mergeKmerFilesAndOutput<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry>(writer, splitFiles, empty);
+            mergeKmerFilesAndOutput<Parameters::DBTYPE_AMINO_ACIDS, KmerEntry>(writer, splitFiles, empty, par.threads);
         }
         for(size_t i = 0; i < splitFiles.size(); i++){
             FileUtil::remove(splitFiles[i].c_str());
@@ -67,7 +67,8 @@ public:
     IndexTable(int alphabetSize, int kmerSize, bool externalData)
             : tableSize(MathUtil::ipow<size_t>(alphabetSize, kmerSize)), alphabetSize(alphabetSize),
               kmerSize(kmerSize), externalData(externalData), tableEntriesNum(0), size(0),
-              indexer(new Indexer(alphabetSize, kmerSize)), entries(NULL), offsets(NULL) {
+              indexer(new Indexer(alphabetSize, kmerSize)), entries(NULL), offsets(NULL),
+              compressedEntries(NULL), compressedSize(0), compressedOffsets(NULL), blockOffsets(NULL) {
         if (externalData == false) {
             offsets = new(std::nothrow) size_t[tableSize + 1];
             Util::checkAllocation(offsets, "Can not allocate entries memory in IndexTable");
@@ -90,6 +91,18 @@ public:
                 delete[] offsets;
                 offsets = NULL;
             }
+            if (compressedEntries != NULL) {
+                delete[] compressedEntries;
+                compressedEntries = NULL;
+            }
+            if (compressedOffsets != NULL) {
+                delete[] compressedOffsets;
+                compressedOffsets = NULL;
+            }
+            if (blockOffsets != NULL) {
+                delete[] blockOffsets;
+                blockOffsets = NULL;
+            }
         }
     }
 
@@ -179,6 +192,82 @@ public:
         return (entries + offsets[kmer]);
     }
 
+    bool isCompressed() {
+        return compressedEntries != NULL;
+    }
+
+    // get the encoded list of DB sequences containing this k-mer, decode it with decodeDBSeqList
+    inline const unsigned char *getCompressedDBSeqList(size_t kmer, size_t *matchedListSize) {
+        const unsigned char *list = compressedEntries + blockOffsets[kmer / COMPRESSED_BLOCK_SIZE] + compressedOffsets[kmer];
+        const unsigned char *next = compressedEntries + blockOffsets[(kmer + 1) / COMPRESSED_BLOCK_SIZE] + compressedOffsets[kmer + 1];
+        // empty lists take no space, not even for their length
+        *matchedListSize = (list == next) ? 0 : readVarint(list);
+        return list;
+    }
+
+    // decodes the (seqId delta, position) pairs of a list into IndexEntryLocal
+    static inline void decodeDBSeqList(const unsigned char *list, size_t listSize, IndexEntryLocal *out) {
+        unsigned int seqId = 0;
+        for (size_t i = 0; i < listSize; i++) {
+            seqId += readVarint(list);
+            out[i].seqId = seqId;
+            out[i].position_j = static_cast<unsigned short>(readVarint(list));
+        }
+    }
+
+    // replaces entries and offsets by the compressed layout
+    // every non-empty k-mer list is stored as its length followed by (seqId delta, position) pairs, all varint encoded.
+    // Lists are addressed by a 64-bit offset per block of COMPRESSED_BLOCK_SIZE k-mers and a 32-bit offset within the block.
+    void compressEntries() {
+        const size_t blockCount = tableSize / COMPRESSED_BLOCK_SIZE + 1;
+        compressedOffsets = new(std::nothrow) unsigned int[tableSize + 1];
+        Util::checkAllocation(compressedOffsets, "Can not allocate compressed offsets memory in IndexTable");
+        blockOffsets = new(std::nothrow) size_t[blockCount];
+        Util::checkAllocation(blockOffsets, "Can not allocate block offsets memory in IndexTable");
+
+        // sizes of the encoded lists
+        std::vector<size_t> listBytes(tableSize);
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < tableSize; i++) {
+            size_t listSize;
+            IndexEntryLocal *list = getDBSeqList(i, &listSize);
+            listBytes[i] = (listSize == 0) ? 0 : encodeDBSeqList(list, listSize, NULL);
+        }
+
+        size_t offset = 0;
+        for (size_t i = 0; i <= tableSize; i++) {
+            if (i % COMPRESSED_BLOCK_SIZE == 0) {
+                blockOffsets[i / COMPRESSED_BLOCK_SIZE] = offset;
+            }
+            const size_t blockOffset = offset - blockOffsets[i / COMPRESSED_BLOCK_SIZE];
+            if (blockOffset > UINT_MAX) {
+                Debug(Debug::ERROR) << "Compressed k-mer lists exceed 4GB within one block. Please increase --split\n";
+                EXIT(EXIT_FAILURE);
+            }
+            compressedOffsets[i] = static_cast<unsigned int>(blockOffset);
+            if (i < tableSize) {
+                offset += listBytes[i];
+            }
+        }
+        compressedSize = offset;
+
+        compressedEntries = new(std::nothrow) unsigned char[std::max(compressedSize, static_cast<size_t>(1))];
+        Util::checkAllocation(compressedEntries, "Can not allocate " + SSTR(compressedSize) + " bytes for compressed entries in IndexTable");
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < tableSize; i++) {
+            size_t listSize;
+            IndexEntryLocal *list = getDBSeqList(i, &listSize);
+            if (listSize > 0) {
+                encodeDBSeqList(list, listSize, compressedEntries + blockOffsets[i / COMPRESSED_BLOCK_SIZE] + compressedOffsets[i]);
+            }
+        }
+
+        delete[] entries;
+        entries = NULL;
+        delete[] offsets;
+        offsets = NULL;
+    }
+
     void sortDBSeqLists() {
         #pragma omp parallel for
         for (size_t i = 0; i < tableSize; i++) {
@@ -243,9 +332,65 @@ public:
 
         this->entries = new(std::nothrow) IndexEntryLocal[tableEntriesNum];
         Util::checkAllocation(entries, "Can not allocate " + SSTR(tableEntriesNum * sizeof(IndexEntryLocal)) + " bytes for entries in IndexTable::initMemory");
-        memcpy(this->entries, entries, tableEntriesNum * sizeof(IndexEntryLocal));
+        Util::ompMemcpy(this->entries, entries, tableEntriesNum * sizeof(IndexEntryLocal));
+
+        Util::ompMemcpy(this->offsets, entryOffsets, (tableSize + 1) * sizeof(size_t));
+    }
+
+    // init index table with compressed external data (needed for index readin)
+    void initCompressedTableByExternalData(size_t sequenceCount, size_t tableEntriesNum, unsigned char *entries, size_t entriesSize,
+                                           unsigned int *entryOffsets, size_t *entryBlockOffsets) {
+        this->tableEntriesNum = tableEntriesNum;
+        this->size = sequenceCount;
 
-        memcpy(this->offsets, entryOffsets, (tableSize + 1) * sizeof(size_t));
+        this->compressedEntries = entries;
+        this->compressedSize = entriesSize;
+        this->compressedOffsets = entryOffsets;
+        this->blockOffsets = entryBlockOffsets;
+    }
+
+    void initCompressedTableByExternalDataCopy(size_t sequenceCount, size_t tableEntriesNum, unsigned char *entries, size_t entriesSize,
+                                               unsigned int *entryOffsets, size_t *entryBlockOffsets) {
+        this->tableEntriesNum = tableEntriesNum;
+        this->size = sequenceCount;
+
+        // the uncompressed offsets are not needed
+        delete[] offsets;
+        offsets = NULL;
+
+        this->compressedSize = entriesSize;
+        this->compressedEntries = new(std::nothrow) unsigned char[std::max(entriesSize, static_cast<size_t>(1))];
+        Util::checkAllocation(compressedEntries, "Can not allocate " + SSTR(entriesSize) + " bytes for compressed entries in IndexTable");
+        Util::ompMemcpy(this->compressedEntries, entries, entriesSize);
+
+        this->compressedOffsets = new(std::nothrow) unsigned int[tableSize + 1];
+        Util::checkAllocation(compressedOffsets, "Can not allocate compressed offsets memory in IndexTable");
+        Util::ompMemcpy(this->compressedOffsets, entryOffsets, (tableSize + 1) * sizeof(unsigned int));
+
+        const size_t blockCount = getCompressedBlockCount();
+        this->blockOffsets = new(std::nothrow) size_t[blockCount];
+        Util::checkAllocation(blockOffsets, "Can not allocate block offsets memory in IndexTable");
+        memcpy(this->blockOffsets, entryBlockOffsets, blockCount * sizeof(size_t));
+    }
+
+    unsigned char *getCompressedEntries() {
+        return compressedEntries;
+    }
+
+    size_t getCompressedEntriesSize() {
+        return compressedSize;
+    }
+
+    unsigned int *getCompressedOffsets() {
+        return compressedOffsets;
+    }
+
+    size_t *getBlockOffsets() {
+        return blockOffsets;
+    }
+
+    size_t getCompressedBlockCount() {
+        return tableSize / COMPRESSED_BLOCK_SIZE + 1;
     }
 
     void revertPointer() {
@@ -465,6 +610,48 @@ public:
     }
 
 protected:
+    static const size_t COMPRESSED_BLOCK_SIZE = 1024;
+
+    static inline unsigned int readVarint(const unsigned char *&data) {
+        unsigned int value = *data & 0x7F;
+        unsigned int shift = 7;
+        while (*data & 0x80) {
+            data++;
+            value |= static_cast<unsigned int>(*data & 0x7F) << shift;
+            shift += 7;
+        }
+        data++;
+        return value;
+    }
+
+    // returns the number of bytes written, only counts them if out is NULL
+    static inline size_t writeVarint(unsigned int value, unsigned char *out) {
+        size_t bytes = 1;
+        while (value >= 0x80) {
+            if (out != NULL) {
+                *out++ = static_cast<unsigned char>(value | 0x80);
+            }
+            value >>= 7;
+            bytes++;
+        }
+        if (out != NULL) {
+            *out = static_cast<unsigned char>(value);
+        }
+        return bytes;
+    }
+
+    // lists are sorted by seqId (sortDBSeqLists), so the deltas are small and never negative
+    static size_t encodeDBSeqList(const IndexEntryLocal *list, size_t listSize, unsigned char *out) {
+        size_t bytes = writeVarint(static_cast<unsigned int>(listSize), out);
+        unsigned int prevSeqId = 0;
+        for (size_t i = 0; i < listSize; i++) {
+            bytes += writeVarint(list[i].seqId - prevSeqId, (out != NULL) ? out + bytes : NULL);
+            bytes += writeVarint(list[i].position_j, (out != NULL) ? out + bytes : NULL);
+            prevSeqId = list[i].seqId;
+        }
+        return bytes;
+    }
+
     // alphabetSize**kmerSize
     const size_t tableSize;
     const int alphabetSize;
@@ -484,6 +671,12 @@ protected:
     IndexEntryLocal *entries;
     size_t *offsets;
 
+    // compressed layout, see compressEntries
+    unsigned char *compressedEntries;
+    size_t compressedSize;
+    unsigned int *compressedOffsets;
+    size_t *blockOffsets;
+
     // sequence lookup
     SequenceLookup *sequenceLookup;
 };
@@ -151,6 +151,7 @@ Prefiltering::Prefiltering(const std::string &queryDB,
             if (data.splits > 1) {
                 splitMode = Parameters::TARGET_DB_SPLIT;
             }
+            PrefilteringIndexReader::getSplitBounds(tidxdbr, splitBounds);
             spacedKmer = data.spacedKmer != 0;
             spacedKmerPattern = PrefilteringIndexReader::getSpacedPattern(tidxdbr);
             seedScoringMatrixFile = MultiParam<NuclAA<std::string>>(PrefilteringIndexReader::getSubstitutionMatrix(tidxdbr));
@@ -167,6 +168,7 @@ Prefiltering::Prefiltering(const std::string &queryDB,
     // restrict amount of allocated memory if all results are requested
     // INT_MAX would allocate 72GB RAM per thread for no reason
     maxResListLen = std::min(tdbr->getSize(), maxResListLen);
+    totalMaxResListLen = maxResListLen;
 
     // investigate if it makes sense to mask the profile consensus sequence
     if (Parameters::isEqualDbtype(targetSeqType, Parameters::DBTYPE_HMM_PROFILE)) {
@@ -729,10 +731,26 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
     size_t dbSize = tdbr->getSize();
     size_t queryFrom = 0;
     size_t querySize = qdbr->getSize();
+    size_t splitMaxResListLen = maxResListLen;
 
     // create index table based on split parameter
     if (splitMode == Parameters::TARGET_DB_SPLIT) {
-        tdbr->decomposeDomainByAminoAcid(split, splits, &dbFrom, &dbSize);
+        if (splitBounds.size() == static_cast<size_t>(splits) + 1) {
+            dbFrom = splitBounds[split];
+            dbSize = splitBounds[split + 1] - splitBounds[split];
+            if (splits > 1) {
+                // each split contributes to the result list in proportion to its residues
+                size_t splitDataSize = 0;
+                for (size_t i = dbFrom; i < dbFrom + dbSize; i++) {
+                    splitDataSize += tdbr->getEntryLen(i);
+                }
+                const double expectedHits = static_cast<double>(totalMaxResListLen) * splitDataSize / std::max(tdbr->getDataSize(), (size_t)1);
+                const size_t fourTimesStdDeviation = 4 * sqrt(expectedHits);
+                splitMaxResListLen = std::min(totalMaxResListLen, std::max(static_cast<size_t>(1), static_cast<size_t>(expectedHits) + fourTimesStdDeviation));
+            }
+        } else {
+            tdbr->decomposeDomainByAminoAcid(split, splits, &dbFrom, &dbSize);
+        }
         if (dbSize == 0) {
             return false;
         }
@@ -787,19 +805,31 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
     Debug(Debug::INFO) << "Target db start " << (dbFrom + 1) << " to " << dbFrom + dbSize << "\n";
     Debug::Progress progress(querySize);
 
+    // queries of a block share the reads of the index lists, profiles keep one query per block
+    // since the k-mer generator is bound to the profile of a single sequence
+    size_t queryBlockSize = 1;
+    if (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_HMM_PROFILE) == false) {
+        queryBlockSize = std::max(std::min((size_t)16, querySize / (localThreads * 4)), (size_t)1);
+    }
+    const size_t queryBlocks = (querySize + queryBlockSize - 1) / queryBlockSize;
+
 #pragma omp parallel num_threads(localThreads)
     {
         unsigned int thread_idx = 0;
 #ifdef OPENMP
         thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-        Sequence seq(qdbr->getMaxSeqLen(), querySeqType, kmerSubMat, kmerSize, spacedKmer, aaBiasCorrection, true, spacedKmerPattern);
+        std::vector<Sequence *> blockSeqs(queryBlockSize);
+        for (size_t i = 0; i < queryBlockSize; i++) {
+            blockSeqs[i] = new Sequence(qdbr->getMaxSeqLen(), querySeqType, kmerSubMat, kmerSize, spacedKmer, aaBiasCorrection, true, spacedKmerPattern);
+        }
+        Sequence &firstSeq = *blockSeqs[0];
         QueryMatcher matcher(indexTable, sequenceLookup, kmerSubMat,  ungappedSubMat,
-                             kmerThr, kmerSize, dbSize, std::max(tdbr->getMaxSeqLen(),qdbr->getMaxSeqLen()), maxResListLen, aaBiasCorrection, aaBiasCorrectionScale,
+                             kmerThr, kmerSize, dbSize, std::max(tdbr->getMaxSeqLen(),qdbr->getMaxSeqLen()), splitMaxResListLen, aaBiasCorrection, aaBiasCorrectionScale,
                              diagonalScoring, minDiagScoreThr, takeOnlyBestKmer, targetSeqType==Parameters::DBTYPE_NUCLEOTIDES);
 
-        if (seq.profile_matrix != NULL) {
-            matcher.setProfileMatrix(seq.profile_matrix);
+        if (firstSeq.profile_matrix != NULL) {
+            matcher.setProfileMatrix(firstSeq.profile_matrix);
         } else if (_3merSubMatrix.isValid() && _2merSubMatrix.isValid()) {
             matcher.setSubstitutionMatrix(&_3merSubMatrix, &_2merSubMatrix);
         } else {
@@ -815,75 +845,90 @@ bool Prefiltering::runSplit(const std::string &resultDB, const std::string &resu
         result.reserve(1000000);
 
 #pragma omp for schedule(dynamic, 1) reduction (+: kmersPerPos, resSize, dbMatches, doubleMatches, querySeqLenSum, diagonalOverflow)
-        for (size_t id = queryFrom; id < queryFrom + querySize; id++) {
-            progress.updateProgress();
-            // get query sequence
-            char *seqData = qdbr->getData(id, thread_idx);
-            unsigned int qKey = qdbr->getDbKey(id);
-            seq.mapSequence(id, qKey, seqData, qdbr->getSeqLen(id));
-            size_t targetSeqId = UINT_MAX;
-            if (sameQTDB || includeIdentical) {
-                targetSeqId = tdbr->getId(seq.getDbKey());
-                // only the corresponding split should include the id (hack for the hack)
-                if (targetSeqId >= dbFrom && targetSeqId < (dbFrom + dbSize) && targetSeqId != UINT_MAX) {
-                    targetSeqId = targetSeqId - dbFrom;
-                    if(targetSeqId > tdbr->getSize()){
-                        Debug(Debug::ERROR) << "targetSeqId: " << targetSeqId << " > target database size: "  << tdbr->getSize() <<  "\n";
-                        EXIT(EXIT_FAILURE);
+        for (size_t block = 0; block < queryBlocks; block++) {
+            const size_t blockFrom = queryFrom + block * queryBlockSize;
+            const size_t blockTo = std::min(blockFrom + queryBlockSize, queryFrom + querySize);
+            for (size_t id = blockFrom; id < blockTo; id++) {
+                // get query sequence
+                char *seqData = qdbr->getData(id, thread_idx);
+                blockSeqs[id - blockFrom]->mapSequence(id, qdbr->getDbKey(id), seqData, qdbr->getSeqLen(id));
+            }
+            size_t gatheredTo = blockFrom;
+            for (size_t id = blockFrom; id < blockTo; id++) {
+                progress.updateProgress();
+                if (queryBlockSize > 1 && id == gatheredTo) {
+                    gatheredTo = id + matcher.gatherQueryBlock(&blockSeqs[id - blockFrom], blockTo - id);
+                }
+                Sequence &seq = *blockSeqs[id - blockFrom];
+                unsigned int qKey = seq.getDbKey();
+                size_t targetSeqId = UINT_MAX;
+                if (sameQTDB || includeIdentical) {
+                    targetSeqId = tdbr->getId(seq.getDbKey());
+                    // only the corresponding split should include the id (hack for the hack)
+                    if (targetSeqId >= dbFrom && targetSeqId < (dbFrom + dbSize) && targetSeqId != UINT_MAX) {
+                        targetSeqId = targetSeqId - dbFrom;
+                        if(targetSeqId > tdbr->getSize()){
+                            Debug(Debug::ERROR) << "targetSeqId: " << targetSeqId << " > target database size: "  << tdbr->getSize() <<  "\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                    }else{
+                        targetSeqId = UINT_MAX;
                     }
-                }else{
-                    targetSeqId = UINT_MAX;
                 }
-            }
-            // calculate prefiltering results
-            if (taxonomyHook != NULL) {
-                taxonomyHook->setDbFrom(dbFrom);
-            }
-            std::pair<hit_t *, size_t> prefResults = matcher.matchQuery(&seq, targetSeqId, targetSeqType==Parameters::DBTYPE_NUCLEOTIDES);
-            size_t resultSize = prefResults.second;
-            const float queryLength = static_cast<float>(qdbr->getSeqLen(id));
-            for (size_t i = 0; i < resultSize; i++) {
-                hit_t *res = prefResults.first + i;
-                // correct the 0 indexed sequence id again to its real identifier
-                size_t targetSeqId1 = res->seqId + dbFrom;
-                // replace id with key
-                res->seqId = tdbr->getDbKey(targetSeqId1);
-                if (UNLIKELY(targetSeqId1 >= tdbr->getSize())) {
-                    Debug(Debug::WARNING) << "Wrong prefiltering result for query: " << qdbr->getDbKey(id) << " -> " << targetSeqId1 << "\t" << res->prefScore << "\n";
+                // calculate prefiltering results
+                if (taxonomyHook != NULL) {
+                    taxonomyHook->setDbFrom(dbFrom);
                 }
+                std::pair<hit_t *, size_t> prefResults = matcher.matchQuery(&seq, targetSeqId, targetSeqType==Parameters::DBTYPE_NUCLEOTIDES);
+                size_t resultSize = prefResults.second;
+                const float queryLength = static_cast<float>(qdbr->getSeqLen(id));
+                for (size_t i = 0; i < resultSize; i++) {
+                    hit_t *res = prefResults.first + i;
+                    // correct the 0 indexed sequence id again to its real identifier
+                    size_t targetSeqId1 = res->seqId + dbFrom;
+                    // replace id with key
+                    res->seqId = tdbr->getDbKey(targetSeqId1);
+                    if (UNLIKELY(targetSeqId1 >= tdbr->getSize())) {
+                        Debug(Debug::WARNING) << "Wrong prefiltering result for query: " << qdbr->getDbKey(id) << " -> " << targetSeqId1 << "\t" << res->prefScore << "\n";
+                    }
 
-                // TODO: check if this should happen when diagonalScoring == false
-                if (covThr > 0.0 && (covMode == Parameters::COV_MODE_BIDIRECTIONAL
-                                               || covMode == Parameters::COV_MODE_QUERY
-                                               || covMode == Parameters::COV_MODE_LENGTH_SHORTER )) {
-                    const float targetLength = static_cast<float>(tdbr->getSeqLen(targetSeqId1));
-                    if (Util::canBeCovered(covThr, covMode, queryLength, targetLength) == false) {
-                        continue;
+                    // TODO: check if this should happen when diagonalScoring == false
+                    if (covThr > 0.0 && (covMode == Parameters::COV_MODE_BIDIRECTIONAL
+                                                   || covMode == Parameters::COV_MODE_QUERY
+                                                   || covMode == Parameters::COV_MODE_LENGTH_SHORTER )) {
+                        const float targetLength = static_cast<float>(tdbr->getSeqLen(targetSeqId1));
+                        if (Util::canBeCovered(covThr, covMode, queryLength, targetLength) == false) {
+                            continue;
+                        }
                     }
-                }
 
-                // write prefiltering results to a string
-                int len = QueryMatcher::prefilterHitToBuffer(buffer, *res);
-                result.append(buffer, len);
-            }
-            tmpDbw.writeData(result.c_str(), result.length(), qKey, thread_idx);
-            result.clear();
+                    // write prefiltering results to a string
+                    int len = QueryMatcher::prefilterHitToBuffer(buffer, *res);
+                    result.append(buffer, len);
+                }
+                tmpDbw.writeData(result.c_str(), result.length(), qKey, thread_idx);
+                result.clear();
 
-            // update statistics counters
-            if (resultSize != 0) {
-                notEmpty[id - queryFrom] = 1;
-            }
+                // update statistics counters
+                if (resultSize != 0) {
+                    notEmpty[id - queryFrom] = 1;
+                }
 
-            if (Debug::debugLevel >= Debug::INFO) {
-                kmersPerPos += matcher.getStatistics()->kmersPerPos;
-                dbMatches += matcher.getStatistics()->dbMatches;
-                doubleMatches += matcher.getStatistics()->doubleMatches;
-                querySeqLenSum += seq.L;
-                diagonalOverflow += matcher.getStatistics()->diagonalOverflow;
-                resSize += resultSize;
-                reslens[thread_idx]->emplace_back(resultSize);
+                if (Debug::debugLevel >= Debug::INFO) {
+                    kmersPerPos += matcher.getStatistics()->kmersPerPos;
+                    dbMatches += matcher.getStatistics()->dbMatches;
+                    doubleMatches += matcher.getStatistics()->doubleMatches;
+                    querySeqLenSum += seq.L;
+                    diagonalOverflow += matcher.getStatistics()->diagonalOverflow;
+                    resSize += resultSize;
+                    reslens[thread_idx]->emplace_back(resultSize);
+                }
             }
         } // step end
+
+        for (size_t i = 0; i < queryBlockSize; i++) {
+            delete blockSeqs[i];
+        }
     }
 
     if (Debug::debugLevel >= Debug::INFO) {
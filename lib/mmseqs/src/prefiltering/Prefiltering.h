@@ -99,6 +99,10 @@ private:
     int targetSearchMode;
     bool takeOnlyBestKmer;
     size_t maxResListLen;
+    // result list length over all splits, maxResListLen is reduced for uniform target splits
+    size_t totalMaxResListLen;
+    // target splits stored in the index, splits added by updating an index are not uniform
+    std::vector<size_t> splitBounds;
 
     const float sensitivity;
     size_t maxSeqLen;
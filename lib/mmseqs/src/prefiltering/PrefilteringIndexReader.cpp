@@ -32,6 +32,10 @@ unsigned int PrefilteringIndexReader::GENERATOR = 22;
 unsigned int PrefilteringIndexReader::SPACEDPATTERN = 23;
 unsigned int PrefilteringIndexReader::ALNINDEX = 24;
 unsigned int PrefilteringIndexReader::ALNDATA = 25;
+unsigned int PrefilteringIndexReader::COMPRESSEDENTRIES = 26;
+unsigned int PrefilteringIndexReader::COMPRESSEDENTRIESOFFSETS = 27;
+unsigned int PrefilteringIndexReader::COMPRESSEDENTRIESBLOCKOFFSETS = 28;
+unsigned int PrefilteringIndexReader::SPLITBOUNDS = 29;
 
 extern const char* version;
 
@@ -57,12 +61,30 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
                                               bool hasSpacedKmer, const std::string &spacedKmerPattern,
                                               bool compBiasCorrection, int alphabetSize, int kmerSize, int maskMode,
                                               int maskLowerCase, float maskProb, int maskNrepeats, int kmerThr, int targetSearchMode, int splits,
-                                              int indexSubset) {
+                                              int indexSubset, DBReader<unsigned int> *baseIndex) {
     const bool noKmerIndex = (indexSubset & Parameters::INDEX_SUBSET_NO_PREFILTER) != 0;
+    const bool compressedKmerIndex = (indexSubset & Parameters::INDEX_SUBSET_COMPRESSED_KMERS) != 0;
     if (noKmerIndex) {
         splits = 1;
     }
 
+    // the splits of a base index are copied, the entries added to the DB since then form one additional split
+    std::vector<size_t> splitBounds;
+    int baseSplits = 0;
+    if (baseIndex != NULL && getSplitBounds(baseIndex, splitBounds)) {
+        baseSplits = static_cast<int>(splitBounds.size() - 1);
+        splitBounds.push_back(dbr1->getSize());
+        splits = baseSplits + 1;
+    } else {
+        splitBounds.push_back(0);
+        for (int s = 0; s < splits; s++) {
+            size_t dbFrom = 0;
+            size_t dbSize = 0;
+            dbr1->decomposeDomainByAminoAcid(s, splits, &dbFrom, &dbSize);
+            splitBounds.push_back(dbSize == 0 ? splitBounds.back() : dbFrom + dbSize);
+        }
+    }
+
     const int SPLIT_META = splits > 1 ? 0 : 0;
     const int SPLIT_SEQS = splits > 1 ? 1 : 0;
     const int SPLIT_INDX = splits > 1 ? 2 : 0;
@@ -87,6 +109,10 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
     writer.writeData(metadataptr, sizeof(metadata), META, SPLIT_META);
     writer.alignToPageSize(SPLIT_META);
 
+    Debug(Debug::INFO) << "Write SPLITBOUNDS (" << SPLITBOUNDS << ")\n";
+    writer.writeData((char *) splitBounds.data(), splitBounds.size() * sizeof(size_t), SPLITBOUNDS, SPLIT_META);
+    writer.alignToPageSize(SPLIT_META);
+
 
     Debug(Debug::INFO) << "Write SCOREMATRIXNAME (" << SCOREMATRIXNAME << ")\n";
     char* subData = BaseMatrix::serialize(subMat->matrixName, subMat->matrixData);
@@ -217,9 +243,24 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
     }
 
     for (int s = 0; s < splits; s++) {
-        size_t dbFrom = 0;
-        size_t dbSize = 0;
-        dbr1->decomposeDomainByAminoAcid(s, splits, &dbFrom, &dbSize);
+        unsigned int keyOffset = 1000 * s;
+        if (s < baseSplits) {
+            const unsigned int splitKeys[] = { ENTRIES, ENTRIESOFFSETS, ENTRIESNUM, SEQCOUNT, SEQINDEXDATASIZE, SEQINDEXSEQOFFSET, SEQINDEXDATA,
+                                               COMPRESSEDENTRIES, COMPRESSEDENTRIESOFFSETS, COMPRESSEDENTRIESBLOCKOFFSETS };
+            for (size_t i = 0; i < sizeof(splitKeys) / sizeof(splitKeys[0]); i++) {
+                size_t id = baseIndex->getId(keyOffset + splitKeys[i]);
+                if (id == UINT_MAX) {
+                    continue;
+                }
+                Debug(Debug::INFO) << "Copy " << (keyOffset + splitKeys[i]) << " from base index\n";
+                writer.writeData(baseIndex->getData(id, 0), baseIndex->getEntryLen(id) - 1, keyOffset + splitKeys[i], SPLIT_INDX + s);
+                writer.alignToPageSize(SPLIT_INDX + s);
+            }
+            continue;
+        }
+
+        size_t dbFrom = splitBounds[s];
+        size_t dbSize = splitBounds[s + 1] - splitBounds[s];
         if (dbSize == 0) {
             continue;
         }
@@ -239,22 +280,40 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
             Debug(Debug::ERROR) << "Invalid mask mode. No sequence lookup created!\n";
             EXIT(EXIT_FAILURE);
         }
-        unsigned int keyOffset = 1000 * s;
         if(noKmerIndex == false){
             indexTable->printStatistics(subMat->num2aa);
-            // save the entries
-            Debug(Debug::INFO) << "Write ENTRIES (" << (keyOffset + ENTRIES) << ")\n";
-            char *entries = (char *) indexTable->getEntries();
-            size_t entriesSize = indexTable->getTableEntriesNum() * indexTable->getSizeOfEntry();
-            writer.writeData(entries, entriesSize, (keyOffset + ENTRIES), SPLIT_INDX + s);
-            writer.alignToPageSize(SPLIT_INDX + s);
-
-            // save the size
-            Debug(Debug::INFO) << "Write ENTRIESOFFSETS (" << (keyOffset + ENTRIESOFFSETS) << ")\n";
-            char *offsets = (char *) indexTable->getOffsets();
-            size_t offsetsSize = (indexTable->getTableSize() + 1) * sizeof(size_t);
-            writer.writeData(offsets, offsetsSize, (keyOffset + ENTRIESOFFSETS), SPLIT_INDX + s);
-            writer.alignToPageSize(SPLIT_INDX + s);
+            if (compressedKmerIndex) {
+                indexTable->compressEntries();
+                Debug(Debug::INFO) << "Compressed entries: " << indexTable->getCompressedEntriesSize() / 1024 / 1024 << " MB\n";
+
+                Debug(Debug::INFO) << "Write COMPRESSEDENTRIES (" << (keyOffset + COMPRESSEDENTRIES) << ")\n";
+                writer.writeData((char *) indexTable->getCompressedEntries(), indexTable->getCompressedEntriesSize(), (keyOffset + COMPRESSEDENTRIES), SPLIT_INDX + s);
+                writer.alignToPageSize(SPLIT_INDX + s);
+
+                Debug(Debug::INFO) << "Write COMPRESSEDENTRIESOFFSETS (" << (keyOffset + COMPRESSEDENTRIESOFFSETS) << ")\n";
+                size_t offsetsSize = (indexTable->getTableSize() + 1) * sizeof(unsigned int);
+                writer.writeData((char *) indexTable->getCompressedOffsets(), offsetsSize, (keyOffset + COMPRESSEDENTRIESOFFSETS), SPLIT_INDX + s);
+                writer.alignToPageSize(SPLIT_INDX + s);
+
+                Debug(Debug::INFO) << "Write COMPRESSEDENTRIESBLOCKOFFSETS (" << (keyOffset + COMPRESSEDENTRIESBLOCKOFFSETS) << ")\n";
+                size_t blockOffsetsSize = indexTable->getCompressedBlockCount() * sizeof(size_t);
+                writer.writeData((char *) indexTable->getBlockOffsets(), blockOffsetsSize, (keyOffset + COMPRESSEDENTRIESBLOCKOFFSETS), SPLIT_INDX + s);
+                writer.alignToPageSize(SPLIT_INDX + s);
+            } else {
+                // save the entries
+                Debug(Debug::INFO) << "Write ENTRIES (" << (keyOffset + ENTRIES) << ")\n";
+                char *entries = (char *) indexTable->getEntries();
+                size_t entriesSize = indexTable->getTableEntriesNum() * indexTable->getSizeOfEntry();
+                writer.writeData(entries, entriesSize, (keyOffset + ENTRIES), SPLIT_INDX + s);
+                writer.alignToPageSize(SPLIT_INDX + s);
+
+                // save the size
+                Debug(Debug::INFO) << "Write ENTRIESOFFSETS (" << (keyOffset + ENTRIESOFFSETS) << ")\n";
+                char *offsets = (char *) indexTable->getOffsets();
+                size_t offsetsSize = (indexTable->getTableSize() + 1) * sizeof(size_t);
+                writer.writeData(offsets, offsetsSize, (keyOffset + ENTRIESOFFSETS), SPLIT_INDX + s);
+                writer.alignToPageSize(SPLIT_INDX + s);
+            }
             indexTable->deleteEntries();
 
             // ENTRIESNUM
@@ -293,7 +352,7 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
         }
     }
 
-    if (Parameters::isEqualDbtype(seqType, Parameters::DBTYPE_HMM_PROFILE) == false && indexSubset != Parameters::INDEX_SUBSET_NO_PREFILTER) {
+    if (Parameters::isEqualDbtype(seqType, Parameters::DBTYPE_HMM_PROFILE) == false && noKmerIndex == false) {
         ExtendedSubstitutionMatrix::freeScoreMatrix(s3);
         ExtendedSubstitutionMatrix::freeScoreMatrix(s2);
     }
@@ -301,6 +360,30 @@ void PrefilteringIndexReader::createIndexFile(const std::string &outDB,
     writer.close(false);
 }
 
+bool PrefilteringIndexReader::getSplitBounds(DBReader<unsigned int> *dbr, std::vector<size_t> &bounds) {
+    size_t id = dbr->getId(SPLITBOUNDS);
+    if (id == UINT_MAX) {
+        return false;
+    }
+    const size_t *data = reinterpret_cast<const size_t *>(dbr->getData(id, 0));
+    const size_t count = (dbr->getEntryLen(id) - 1) / sizeof(size_t);
+    bounds.assign(data, data + count);
+    return true;
+}
+
+size_t PrefilteringIndexReader::getIndexedPrefixSize(DBReader<unsigned int> *dbr, DBReader<unsigned int> *seqDbr) {
+    DBReader<unsigned int> *indexed = openNewReader(dbr, DBR1DATA, DBR1INDEX, false, 1, false, false);
+    size_t size = indexed->getSize() <= seqDbr->getSize() ? indexed->getSize() : SIZE_MAX;
+    for (size_t i = 0; size != SIZE_MAX && i < size; i++) {
+        if (indexed->getDbKey(i) != seqDbr->getDbKey(i) || indexed->getEntryLen(i) != seqDbr->getEntryLen(i)) {
+            size = SIZE_MAX;
+        }
+    }
+    indexed->close();
+    delete indexed;
+    return size;
+}
+
 DBReader<unsigned int> *PrefilteringIndexReader::openNewHeaderReader(DBReader<unsigned int>*dbr, unsigned int dataIdx, unsigned int indexIdx, int threads,  bool touchIndex, bool touchData) {
     size_t indexId = dbr->getId(indexIdx);
     char *indexData = dbr->getData(indexId, 0);
@@ -416,12 +499,6 @@ IndexTable *PrefilteringIndexReader::getIndexTable(unsigned int split, DBReader<
     size_t sequenceCountId = dbr->getId(splitOffset +SEQCOUNT);
     size_t sequenceCount = *((size_t *)dbr->getDataUncompressed(sequenceCountId));
 
-    size_t entriesDataId = dbr->getId(splitOffset + ENTRIES);
-    char *entriesData = dbr->getDataUncompressed(entriesDataId);
-
-    size_t entriesOffsetsDataId = dbr->getId(splitOffset + ENTRIESOFFSETS);
-    char *entriesOffsetsData = dbr->getDataUncompressed(entriesOffsetsDataId);
-
     int adjustAlphabetSize;
     if (Parameters::isEqualDbtype(data.seqType, Parameters::DBTYPE_NUCLEOTIDES) || Parameters::isEqualDbtype(data.seqType, Parameters::DBTYPE_AMINO_ACIDS)) {
         adjustAlphabetSize = data.alphabetSize - 1;
@@ -429,6 +506,44 @@ IndexTable *PrefilteringIndexReader::getIndexTable(unsigned int split, DBReader<
         adjustAlphabetSize = data.alphabetSize;
     }
 
+    size_t compressedEntriesId = dbr->getId(splitOffset + COMPRESSEDENTRIES);
+    if (compressedEntriesId != UINT_MAX) {
+        char *compressedEntries = dbr->getDataUncompressed(compressedEntriesId);
+        size_t compressedEntriesSize = dbr->getEntryLen(compressedEntriesId);
+
+        size_t compressedOffsetsId = dbr->getId(splitOffset + COMPRESSEDENTRIESOFFSETS);
+        char *compressedOffsets = dbr->getDataUncompressed(compressedOffsetsId);
+
+        size_t blockOffsetsId = dbr->getId(splitOffset + COMPRESSEDENTRIESBLOCKOFFSETS);
+        char *blockOffsets = dbr->getDataUncompressed(blockOffsetsId);
+
+        if (preloadMode == Parameters::PRELOAD_MODE_FREAD) {
+            IndexTable* table = new IndexTable(adjustAlphabetSize, data.kmerSize, false);
+            table->initCompressedTableByExternalDataCopy(sequenceCount, entriesNum, (unsigned char *) compressedEntries, compressedEntriesSize,
+                                                         (unsigned int *) compressedOffsets, (size_t *) blockOffsets);
+            return table;
+        }
+
+        if (preloadMode == Parameters::PRELOAD_MODE_MMAP_TOUCH) {
+            dbr->touchData(entriesNumId);
+            dbr->touchData(sequenceCountId);
+            dbr->touchData(compressedEntriesId);
+            dbr->touchData(compressedOffsetsId);
+            dbr->touchData(blockOffsetsId);
+        }
+
+        IndexTable* table = new IndexTable(adjustAlphabetSize, data.kmerSize, true);
+        table->initCompressedTableByExternalData(sequenceCount, entriesNum, (unsigned char *) compressedEntries, compressedEntriesSize,
+                                                 (unsigned int *) compressedOffsets, (size_t *) blockOffsets);
+        return table;
+    }
+
+    size_t entriesDataId = dbr->getId(splitOffset + ENTRIES);
+    char *entriesData = dbr->getDataUncompressed(entriesDataId);
+
+    size_t entriesOffsetsDataId = dbr->getId(splitOffset + ENTRIESOFFSETS);
+    char *entriesOffsetsData = dbr->getDataUncompressed(entriesOffsetsDataId);
+
     if (preloadMode == Parameters::PRELOAD_MODE_FREAD) {
         IndexTable* table = new IndexTable(adjustAlphabetSize, data.kmerSize, false);
         table->initTableByExternalDataCopy(sequenceCount, entriesNum, (IndexEntryLocal*) entriesData, (size_t *)entriesOffsetsData);
@@ -447,6 +562,10 @@ IndexTable *PrefilteringIndexReader::getIndexTable(unsigned int split, DBReader<
     return table;
 }
 
+bool PrefilteringIndexReader::hasCompressedEntries(DBReader<unsigned int> *dbr) {
+    return dbr->getId(COMPRESSEDENTRIES) != UINT_MAX;
+}
+
 void PrefilteringIndexReader::printSummary(DBReader<unsigned int> *dbr) {
     Debug(Debug::INFO) << "Index version: " << dbr->getDataByDBKey(VERSION, 0) << "\n";
 
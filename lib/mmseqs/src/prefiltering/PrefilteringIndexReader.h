@@ -5,6 +5,7 @@
 #include "IndexTable.h"
 #include "DBReader.h"
 #include <string>
+#include <vector>
 
 struct PrefilteringIndexData {
     int maxSeqLength;
@@ -50,6 +51,10 @@ public:
     static unsigned int SPACEDPATTERN;
     static unsigned int ALNINDEX;
     static unsigned int ALNDATA;
+    static unsigned int COMPRESSEDENTRIES;
+    static unsigned int COMPRESSEDENTRIESOFFSETS;
+    static unsigned int COMPRESSEDENTRIESBLOCKOFFSETS;
+    static unsigned int SPLITBOUNDS;
 
     static bool checkIfIndexFile(DBReader<unsigned int> *reader);
     static std::string indexName(const std::string &outDB);
@@ -60,7 +65,8 @@ public:
                                 DBReader<unsigned int> *alndbr,
                                 BaseMatrix *seedSubMat, int maxSeqLen, bool spacedKmer, const std::string &spacedKmerPattern,
                                 bool compBiasCorrection, int alphabetSize, int kmerSize, int maskMode,
-                                int maskLowerCase, float maskProb, int maskNrepeats, int kmerThr, int targetSearchMode, int splits, int indexSubset = 0);
+                                int maskLowerCase, float maskProb, int maskNrepeats, int kmerThr, int targetSearchMode, int splits, int indexSubset = 0,
+                                DBReader<unsigned int> *baseIndex = NULL);
 
     static DBReader<unsigned int> *openNewHeaderReader(DBReader<unsigned int>*dbr, unsigned int dataIdx, unsigned int indexIdx, int threads, bool touchIndex, bool touchData);
 
@@ -70,6 +76,12 @@ public:
 
     static IndexTable *getIndexTable(unsigned int split, DBReader<unsigned int> *dbr, int preloadMode);
 
+    // first entry of every split followed by the number of entries, false for indices created without split bounds
+    static bool getSplitBounds(DBReader<unsigned int> *dbr, std::vector<size_t> &bounds);
+
+    // number of entries of the indexed DB if they are the first entries of dbr, SIZE_MAX otherwise
+    static size_t getIndexedPrefixSize(DBReader<unsigned int> *dbr, DBReader<unsigned int> *seqDbr);
+
     static void printSummary(DBReader<unsigned int> *dbr);
 
     static PrefilteringIndexData getMetadata(DBReader<unsigned int> *dbr);
@@ -80,6 +92,8 @@ public:
 
     static std::string getSpacedPattern(DBReader<unsigned int> *dbr);
 
+    static bool hasCompressedEntries(DBReader<unsigned int> *dbr);
+
     static ScoreMatrix get2MerScoreMatrix(DBReader<unsigned int> *dbr, int preloadMode);
 
     static ScoreMatrix get3MerScoreMatrix(DBReader<unsigned int> *dbr, int preloadMode);
@@ -65,6 +65,7 @@ QueryMatcher::QueryMatcher(IndexTable *indexTable, SequenceLookup *sequenceLooku
         ungappedAlignment = new UngappedAlignment(maxSeqLen, ungappedAlignmentSubMat, sequenceLookup);
     }
     compositionBias = new float[maxSeqLen];
+    blockQueryPos = 0;
 }
 
 QueryMatcher::~QueryMatcher(){
@@ -82,12 +83,7 @@ QueryMatcher::~QueryMatcher(){
     delete kmerGenerator;
 }
 
-std::pair<hit_t*, size_t> QueryMatcher::matchQuery(Sequence *querySeq, unsigned int identityId, bool isNucleotide) {
-    querySeq->resetCurrPos();
-//    std::cout << "Id: " << querySeq->getId() << std::endl;
-    memset(scoreSizes, 0, SCORE_RANGE * sizeof(unsigned int));
-
-    // bias correction
+void QueryMatcher::computeCompositionBias(Sequence *querySeq) {
     if(aaBiasCorrection == true){
         if(Parameters::isEqualDbtype(querySeq->getSeqType(), Parameters::DBTYPE_AMINO_ACIDS)) {
             SubstitutionMatrix::calcLocalAaBiasCorrection(kmerSubMat, querySeq->numSequence, querySeq->L, compositionBias, scaleBiasCorr);
@@ -97,6 +93,15 @@ std::pair<hit_t*, size_t> QueryMatcher::matchQuery(Sequence *querySeq, unsigned
     } else {
         memset(compositionBias, 0, sizeof(float) * querySeq->L);
     }
+}
+
+std::pair<hit_t*, size_t> QueryMatcher::matchQuery(Sequence *querySeq, unsigned int identityId, bool isNucleotide) {
+    querySeq->resetCurrPos();
+//    std::cout << "Id: " << querySeq->getId() << std::endl;
+    memset(scoreSizes, 0, SCORE_RANGE * sizeof(unsigned int));
+
+    // bias correction
+    computeCompositionBias(querySeq);
     if(diagonalScoring == true){
         ungappedAlignment->createProfile(querySeq, compositionBias);
     }
@@ -210,7 +215,127 @@ std::pair<hit_t*, size_t> QueryMatcher::matchQuery(Sequence *querySeq, unsigned
     return queryResult;
 }
 
+std::pair<const size_t *, size_t> QueryMatcher::getSimilarKmers(Sequence *seq, const unsigned char *kmer, float *compositionBias, size_t *exactKmer) {
+    const unsigned char *pos = seq->getAAPosInSpacedPattern();
+    const unsigned short current_i = seq->getCurrentPosition();
+
+    float biasCorrection = 0;
+    for (int i = 0; i < kmerSize; i++){
+        biasCorrection += compositionBias[current_i + static_cast<short>(pos[i])];
+    }
+    // round bias to next higher or lower value
+    short bias = static_cast<short>((biasCorrection < 0.0) ? biasCorrection - 0.5: biasCorrection + 0.5);
+    short kmerMatchScore = std::max(kmerThr - bias, 0);
+
+    // adjust kmer threshold based on composition bias
+    kmerGenerator->setThreshold(kmerMatchScore);
+
+    if (takeOnlyBestKmer) {
+        *exactKmer = idx.int2index(kmer);
+        return std::make_pair(exactKmer, 1);
+    }
+    std::pair<size_t*, size_t> kmerList = kmerGenerator->generateKmerList(kmer);
+    return std::make_pair(kmerList.first, kmerList.second);
+}
+
+size_t QueryMatcher::gatherQueryBlock(Sequence **querySeqs, size_t count) {
+    blockLists.clear();
+    blockPositions.clear();
+    blockQueries.clear();
+    blockQueryPos = 0;
+    // compressed lists are decoded one by one in match
+    if (count == 0 || indexTable->isCompressed()) {
+        return count;
+    }
+
+    size_t hitOffset = 0;
+    size_t queryCount = 0;
+    for (; queryCount < count; queryCount++) {
+        Sequence *seq = querySeqs[queryCount];
+        const size_t listsFrom = blockLists.size();
+        const size_t positionFrom = blockPositions.size();
+        const size_t queryHitOffset = hitOffset;
+        size_t kmerListLen = 0;
+        unsigned short indexTo = 0;
+
+        computeCompositionBias(seq);
+        seq->resetCurrPos();
+        while (seq->hasNextKmer()) {
+            const unsigned char *kmer = seq->nextKmer();
+            const unsigned short current_i = seq->getCurrentPosition();
+            blockPositions.emplace_back(current_i, hitOffset);
+            indexTo = current_i;
+            if (seq->kmerContainsX()) {
+                continue;
+            }
+            size_t exactKmer;
+            std::pair<const size_t *, size_t> kmerList = getSimilarKmers(seq, kmer, compositionBias, &exactKmer);
+            kmerListLen += kmerList.second;
+            for (size_t kmerPos = 0; kmerPos < kmerList.second; kmerPos++) {
+                size_t seqListSize;
+                // only the offsets are read here, the lists are copied below
+                indexTable->getDBSeqList(kmerList.first[kmerPos], &seqListSize);
+                if (seqListSize > 0) {
+                    BlockList list = { kmerList.first[kmerPos], hitOffset };
+                    blockLists.push_back(list);
+                    hitOffset += seqListSize;
+                }
+            }
+        }
+        seq->resetCurrPos();
+
+        const size_t numMatches = hitOffset - queryHitOffset;
+        // a query that overflows by itself is matched alone by match
+        if (numMatches >= maxDbMatches && queryCount == 0) {
+            blockLists.clear();
+            blockPositions.clear();
+            return 1;
+        }
+        if (numMatches >= maxDbMatches || hitOffset > maxDbMatches) {
+            blockLists.resize(listsFrom);
+            blockPositions.resize(positionFrom);
+            break;
+        }
+        BlockQuery query = { seq, positionFrom, blockPositions.size(), queryHitOffset, numMatches, kmerListLen, indexTo };
+        blockQueries.push_back(query);
+    }
+
+    // every list is read once for all queries of the block
+    SORT_SERIAL(blockLists.begin(), blockLists.end(), BlockList::compareByKmer);
+    for (size_t i = 0; i < blockLists.size(); i++) {
+        size_t seqListSize;
+        const IndexEntryLocal *entries = indexTable->getDBSeqList(blockLists[i].kmer, &seqListSize);
+        memcpy(databaseHits + blockLists[i].hitOffset, entries, sizeof(IndexEntryLocal) * seqListSize);
+    }
+    return queryCount;
+}
+
+size_t QueryMatcher::matchGathered(const BlockQuery &query) {
+    stats->diagonalOverflow = false;
+    for (size_t i = query.positionFrom; i < query.positionTo; i++) {
+        indexPointer[blockPositions[i].first] = databaseHits + blockPositions[i].second;
+    }
+    indexPointer[query.indexTo + 1] = databaseHits + query.hitOffset + query.numMatches;
+    size_t hitCount = 0;
+    if (query.numMatches > 0) {
+        hitCount = findDuplicates(indexPointer, foundDiagonals, foundDiagonalsSize, 0, query.indexTo, (diagonalScoring == false));
+    }
+    stats->doubleMatches = 0;
+    if (diagonalScoring == false) {
+        // remove double entries
+        updateScoreBins(foundDiagonals, hitCount);
+        stats->doubleMatches = getDoubleDiagonalMatches();
+    }
+    stats->kmersPerPos = ((double)query.kmerListLen/(double)query.seq->L);
+    stats->querySeqLen = query.seq->L;
+    stats->dbMatches   = query.numMatches;
+    return hitCount;
+}
+
 size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
+    if (blockQueryPos < blockQueries.size() && blockQueries[blockQueryPos].seq == seq) {
+        return matchGathered(blockQueries[blockQueryPos++]);
+    }
     // go through the query sequence
     size_t kmerListLen = 0;
     size_t numMatches = 0;
@@ -220,41 +345,23 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
     stats->diagonalOverflow = false;
     IndexEntryLocal* sequenceHits = databaseHits;
     size_t seqListSize;
+    const bool compressedIndex = indexTable->isCompressed();
     unsigned short indexStart = 0;
     unsigned short indexTo = 0;
     while (seq->hasNextKmer()) {
         const unsigned char *kmer = seq->nextKmer();
-        const unsigned char *pos = seq->getAAPosInSpacedPattern();
         const unsigned short current_i = seq->getCurrentPosition();
 
-        float biasCorrection = 0;
-        for (int i = 0; i < kmerSize; i++){
-            biasCorrection += compositionBias[current_i + static_cast<short>(pos[i])];
-        }
         if (seq->kmerContainsX()) {
             indexTo = current_i;
             indexPointer[current_i] = sequenceHits;
             continue;
         }
-        // round bias to next higher or lower value
-        short bias = static_cast<short>((biasCorrection < 0.0) ? biasCorrection - 0.5: biasCorrection + 0.5);
-        short kmerMatchScore = std::max(kmerThr - bias, 0);
 
-        // adjust kmer threshold based on composition bias
-        kmerGenerator->setThreshold(kmerMatchScore);
-
-        const size_t *index;
         size_t exactKmer;
-        size_t kmerElementSize;
-        if (takeOnlyBestKmer) {
-            kmerElementSize = 1;
-            exactKmer = idx.int2index(kmer);
-            index = &exactKmer;
-        } else {
-            std::pair<size_t*, size_t> kmerList = kmerGenerator->generateKmerList(kmer);
-            kmerElementSize = kmerList.second;
-            index = kmerList.first;
-        }
+        std::pair<const size_t *, size_t> kmerList = getSimilarKmers(seq, kmer, compositionBias, &exactKmer);
+        const size_t *index = kmerList.first;
+        size_t kmerElementSize = kmerList.second;
         //std::cout << kmer << std::endl;
         indexPointer[current_i] = sequenceHits;
         // match the index table
@@ -264,7 +371,13 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
         kmerListLen += kmerElementSize;
 
         for (unsigned int kmerPos = 0; kmerPos < kmerElementSize; kmerPos++) {
-            const IndexEntryLocal *entries = indexTable->getDBSeqList(index[kmerPos], &seqListSize);
+            const IndexEntryLocal *entries = NULL;
+            const unsigned char *compressedEntries = NULL;
+            if (compressedIndex) {
+                compressedEntries = indexTable->getCompressedDBSeqList(index[kmerPos], &seqListSize);
+            } else {
+                entries = indexTable->getDBSeqList(index[kmerPos], &seqListSize);
+            }
             // DEBUG
             //std::cout << seq->getDbKey() << std::endl;
             //idx.printKmer(index[kmerPos], kmerSize, kmerSubMat->num2aa);
@@ -314,7 +427,12 @@ size_t QueryMatcher::match(Sequence *seq, float *compositionBias) {
                     goto outer;
                 }
             }
-            memcpy(sequenceHits, entries, sizeof(IndexEntryLocal) * seqListSize);
+            if (compressedIndex) {
+                // decode straight into the hit buffer that is sorted by CacheFriendlyOperations
+                IndexTable::decodeDBSeqList(compressedEntries, seqListSize, sequenceHits);
+            } else {
+                memcpy(sequenceHits, entries, sizeof(IndexEntryLocal) * seqListSize);
+            }
             sequenceHits += seqListSize;
             numMatches += seqListSize;
         }
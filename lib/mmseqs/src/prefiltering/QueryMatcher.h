@@ -6,6 +6,7 @@
 #define MMSEQS_QUERYTEMPLATEMATCHEREXACTMATCH_H
 
 #include <cstdlib>
+#include <vector>
 #include "itoa.h"
 #include "EvalueComputation.h"
 #include "CacheFriendlyOperations.h"
@@ -63,6 +64,11 @@ public:
     // identityId is the id of the identitical sequence in the target database if there is any, UINT_MAX otherwise
     std::pair<hit_t*, size_t> matchQuery(Sequence *querySeq, unsigned int identityId,  bool isNucleotide);
 
+    // multi-query mode: collects the index lists of a block of queries and copies every list once for all of them
+    // in k-mer order, matchQuery has to be called afterwards for the gathered queries in the same order
+    // returns how many of the queries can be matched now (at least one), they fit together into the hit buffer
+    size_t gatherQueryBlock(Sequence **querySeqs, size_t count);
+
     void setQueryMatcherHook(QueryMatcherHook* hook) {
         this->hook = hook;
     }
@@ -215,9 +221,44 @@ protected:
         return scoreThr;
     }
 
+    // list of a k-mer and where it is copied to in databaseHits
+    struct BlockList {
+        size_t kmer;
+        size_t hitOffset;
+
+        static bool compareByKmer(const BlockList &first, const BlockList &second) {
+            return first.kmer < second.kmer;
+        }
+    };
+
+    // query of a gathered block, its index positions are blockPositions[positionFrom, positionTo)
+    struct BlockQuery {
+        Sequence *seq;
+        size_t positionFrom;
+        size_t positionTo;
+        size_t hitOffset;
+        size_t numMatches;
+        size_t kmerListLen;
+        unsigned short indexTo;
+    };
+
+    std::vector<BlockList> blockLists;
+    // query position and offset of its first hit in databaseHits
+    std::vector<std::pair<unsigned short, size_t>> blockPositions;
+    std::vector<BlockQuery> blockQueries;
+    size_t blockQueryPos;
+
+    void computeCompositionBias(Sequence *querySeq);
+
+    // similar k-mers of the current query position, the k-mer threshold is adjusted to the local composition bias
+    std::pair<const size_t *, size_t> getSimilarKmers(Sequence *seq, const unsigned char *kmer, float *compositionBias, size_t *exactKmer);
+
     // match sequence against the IndexTable
     size_t match(Sequence *seq, float *compositionBias);
 
+    // find the diagonals of a query whose hits were collected by gatherQueryBlock
+    size_t matchGathered(const BlockQuery &query);
+
     // extract result from databaseHits
     template <int TYPE>
     std::pair<hit_t *, size_t> getResult(CounterResult * results,
@@ -70,6 +70,6 @@ void SequenceLookup::initLookupByExternalData(char *seqData, size_t seqDataSize,
 }
 
 void SequenceLookup::initLookupByExternalDataCopy(char *seqData, size_t *seqOffsets) {
-    memcpy(data, seqData, (dataSize + 1) * sizeof(char));
-    memcpy(offsets, seqOffsets, (sequenceCount + 1) * sizeof(size_t));
+    Util::ompMemcpy(data, seqData, (dataSize + 1) * sizeof(char));
+    Util::ompMemcpy(offsets, seqOffsets, (sequenceCount + 1) * sizeof(size_t));
 }
@@ -38,36 +38,98 @@ void intHandlerClient(int) {
     keepRunningClient = 0;
 }
 
+// host side query state, the next query is prepared while the GPUs scan the current one
+struct GpuQueryBuffer {
+    GpuQueryBuffer(Parameters & par, int querySeqType, BaseMatrix * subMat)
+        : seq(par.maxSeqLen, querySeqType, subMat, 0, false, par.compBiasCorrection),
+          profile(NULL), profileBufferLength(par.maxSeqLen), compositionBias(NULL),
+          compBufferSize((par.maxSeqLen + 1) * sizeof(float)), key(0) {
+        if (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_HMM_PROFILE) == false) {
+            profileStorage = (int8_t*)malloc(subMat->alphabetSize * profileBufferLength * sizeof(int8_t));
+        } else {
+            profileStorage = NULL;
+        }
+        if (par.compBiasCorrection == true) {
+            compositionBias = (float*)malloc(compBufferSize);
+            memset(compositionBias, 0, compBufferSize);
+        }
+    }
+
+    ~GpuQueryBuffer() {
+        free(compositionBias);
+        free(profileStorage);
+    }
+
+    Sequence seq;
+    int8_t* profile;
+    int8_t* profileStorage;
+    size_t profileBufferLength;
+    float* compositionBias;
+    size_t compBufferSize;
+    unsigned int key;
+
+private:
+    GpuQueryBuffer(const GpuQueryBuffer&);
+    GpuQueryBuffer& operator=(const GpuQueryBuffer&);
+};
+
+static void prepareGpuQuery(Parameters & par, BaseMatrix * subMat, DBReader<unsigned int> * qdbr,
+                            size_t id, GpuQueryBuffer & query) {
+    const int querySeqType = qdbr->getDbtype();
+    Sequence &qSeq = query.seq;
+    query.key = qdbr->getDbKey(id);
+    // only the preparing thread reads query data
+    qSeq.mapSequence(id, query.key, qdbr->getData(id, 0), qdbr->getSeqLen(id));
+    if (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_HMM_PROFILE)) {
+        query.profile = qSeq.profile_for_alignment;
+        return;
+    }
+    if ((size_t)qSeq.L >= query.profileBufferLength) {
+        query.profileBufferLength = (size_t)qSeq.L * 1.5;
+        query.profileStorage = (int8_t*)realloc(query.profileStorage, subMat->alphabetSize * query.profileBufferLength * sizeof(int8_t));
+    }
+    query.profile = query.profileStorage;
+    float *compositionBias = query.compositionBias;
+    if (compositionBias != NULL) {
+        if ((size_t)qSeq.L >= query.compBufferSize) {
+            query.compBufferSize = (size_t)qSeq.L * 1.5 * sizeof(float);
+            compositionBias = (float*)realloc(compositionBias, query.compBufferSize);
+            query.compositionBias = compositionBias;
+        }
+        SubstitutionMatrix::calcLocalAaBiasCorrection(subMat, qSeq.numSequence, qSeq.L, compositionBias, par.compBiasCorrectionScale);
+    }
+    int8_t *profile = query.profile;
+    for (size_t j = 0; j < (size_t)subMat->alphabetSize; ++j) {
+        for (size_t i = 0; i < (size_t)qSeq.L; ++i) {
+            short bias = 0;
+            if (compositionBias != NULL) {
+                bias = static_cast<short>((compositionBias[i] < 0.0) ? (compositionBias[i] - 0.5) : (compositionBias[i] + 0.5));
+            }
+            profile[j * qSeq.L  + i] = subMat->subMatrix[j][qSeq.numSequence[i]] + bias;
+        }
+    }
+}
+
 void runFilterOnGpu(Parameters & par, BaseMatrix * subMat,
                     DBReader<unsigned int> * qdbr, DBReader<unsigned int> * tdbr,
                     bool sameDB, DBWriter & resultWriter, EvalueComputation * evaluer,
                     QueryMatcherTaxonomyHook *taxonomyHook){
     Debug::Progress progress(qdbr->getSize());
     const int querySeqType = qdbr->getDbtype();
-    Sequence qSeq(par.maxSeqLen, querySeqType, subMat, 0, false, par.compBiasCorrection);
+    // double buffered, the buffers swap after each query
+    GpuQueryBuffer evenQuery(par, querySeqType, subMat);
+    GpuQueryBuffer oddQuery(par, querySeqType, subMat);
+    GpuQueryBuffer *queryBuffers[2] = { &evenQuery, &oddQuery };
 
     std::vector<Marv::Result> results;
     results.reserve(par.maxResListLen);
     std::vector<hit_t> shortResults;
     std::vector<Matcher::result_t> resultsAln;
 
-    size_t profileBufferLength = par.maxSeqLen;
-    int8_t* profile = NULL;
-    if (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_HMM_PROFILE) == false) {
-        profile = (int8_t*)malloc(subMat->alphabetSize * profileBufferLength * sizeof(int8_t));
-    }
-
     std::string resultBuffer;
     resultBuffer.reserve(262144);
     char buffer[1024+32768];
 
-    size_t compBufferSize = (par.maxSeqLen + 1) * sizeof(float);
-    float *compositionBias = NULL;
-    if (par.compBiasCorrection == true) {
-        compositionBias = (float*)malloc(compBufferSize);
-        memset(compositionBias, 0, compBufferSize);
-    }
-
     std::string hash = "";
     if (par.gpuServer != 0) {
         hash = GPUSharedMemory::getShmHash(par.db2);
@@ -161,39 +223,22 @@ void runFilterOnGpu(Parameters & par, BaseMatrix * subMat,
     }
 
     // marv.prefetch();
+    if (qdbr->getSize() > 0) {
+        prepareGpuQuery(par, subMat, qdbr, 0, *queryBuffers[0]);
+    }
     for (size_t id = 0; id < qdbr->getSize(); id++) {
         if (!keepRunningClient) {
             break;
         }
-        size_t queryKey = qdbr->getDbKey(id);
-        unsigned int querySeqLen = qdbr->getSeqLen(id);
-        char *querySeqData = qdbr->getData(id, 0);
-        qSeq.mapSequence(id, queryKey, querySeqData, querySeqLen);
-        if (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_HMM_PROFILE)) {
-            profile = qSeq.profile_for_alignment;
-        } else {
-            if ((size_t)qSeq.L >= profileBufferLength) {
-                profileBufferLength = (size_t)qSeq.L * 1.5;
-                profile = (int8_t*)realloc(profile, subMat->alphabetSize * profileBufferLength * sizeof(int8_t));
-            }
-            if (compositionBias != NULL) {
-                if ((size_t)qSeq.L >= compBufferSize) {
-                    compBufferSize = (size_t)qSeq.L * 1.5 * sizeof(float);
-                    compositionBias = (float*)realloc(compositionBias, compBufferSize);
-                    // memset(compositionBias, 0, compBufferSize);
-                }
-                SubstitutionMatrix::calcLocalAaBiasCorrection(subMat, qSeq.numSequence, qSeq.L, compositionBias, par.compBiasCorrectionScale);
-            }
-            for (size_t j = 0; j < (size_t)subMat->alphabetSize; ++j) {
-                for (size_t i = 0; i < (size_t)qSeq.L; ++i) {
-                    short bias = 0;
-                    if (compositionBias != NULL) {
-                        bias = static_cast<short>((compositionBias[i] < 0.0) ? (compositionBias[i] - 0.5) : (compositionBias[i] + 0.5));
-                    }
-                    profile[j * qSeq.L  + i] = subMat->subMatrix[j][qSeq.numSequence[i]] + bias;
-                }
-            }
+        GpuQueryBuffer &current = *queryBuffers[id % 2];
+        // the host prepares the next query while the current one is scanned and its hits are written
+        std::thread nextQuery;
+        if (id + 1 < qdbr->getSize()) {
+            nextQuery = std::thread(prepareGpuQuery, std::ref(par), subMat, qdbr, id + 1, std::ref(*queryBuffers[(id + 1) % 2]));
         }
+        Sequence &qSeq = current.seq;
+        int8_t *profile = current.profile;
+        size_t queryKey = current.key;
         Marv::Stats stats;
         if (serverMode == 0) {
             stats = marv->scan(reinterpret_cast<const char *>(qSeq.numSequence), qSeq.L, profile, results.data());
@@ -319,19 +364,15 @@ void runFilterOnGpu(Parameters & par, BaseMatrix * subMat,
         shortResults.clear();
         resultsAln.clear();
         progress.updateProgress();
+        if (nextQuery.joinable()) {
+            nextQuery.join();
+        }
     }
     if (marv != NULL) {
         delete marv;
     } else {
         GPUSharedMemory::unmap(layout);
     }
-
-    if (compositionBias != NULL) {
-        free(compositionBias);
-    }
-    if (Parameters::isEqualDbtype(querySeqType, Parameters::DBTYPE_HMM_PROFILE) == false) {
-        free(profile);
-    }
 }
 #endif
 
@@ -36,6 +36,9 @@ std::string findIncompatibleParameter(DBReader<unsigned int>& index, const Param
         return "seedScoringMatrixFile";
     if (par.spacedKmerPattern != PrefilteringIndexReader::getSpacedPattern(&index))
         return "spacedKmerPattern";
+    if ((par.indexSubset & Parameters::INDEX_SUBSET_NO_PREFILTER) == 0 &&
+        ((par.indexSubset & Parameters::INDEX_SUBSET_COMPRESSED_KMERS) != 0) != PrefilteringIndexReader::hasCompressedEntries(&index))
+        return "indexSubset";
     return "";
 }
 
@@ -129,22 +132,42 @@ int indexdb(int argc, const char **argv, const Command &command) {
 
     int status = EXIT_SUCCESS;
     bool recreate = true;
+    DBReader<unsigned int> *baseIndex = NULL;
     std::string indexDbType = indexDB + ".dbtype";
     if (par.checkCompatible > 0 && FileUtil::fileExists(indexDbType.c_str())) {
         Debug(Debug::INFO) << "Check index " << indexDB << "\n";
-        DBReader<unsigned int> index(indexDB.c_str(), (indexDB + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
-        index.open(DBReader<unsigned int>::NOSORT);
+        DBReader<unsigned int> *index = new DBReader<unsigned int>(indexDB.c_str(), (indexDB + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+        index->open(DBReader<unsigned int>::NOSORT);
 
         if (Parameters::isEqualDbtype(dbr.getDbtype(), Parameters::DBTYPE_NUCLEOTIDES) && par.searchType == Parameters::SEARCH_TYPE_NUCLEOTIDES && par.PARAM_ALPH_SIZE.wasSet) {
             Debug(Debug::WARNING) << "Alphabet size is not taken into account for compatibility check in nucleotide search.\n";
         }
 
         std::string check;
-        const bool compatible = PrefilteringIndexReader::checkIfIndexFile(&index) && (check = findIncompatibleParameter(index, par, kmerScore, dbr.getDbtype())) == "";
-        index.close();
+        bool compatible = PrefilteringIndexReader::checkIfIndexFile(index) && (check = findIncompatibleParameter(*index, par, kmerScore, dbr.getDbtype())) == "";
+        size_t indexedEntries = SIZE_MAX;
+        if (compatible) {
+            indexedEntries = PrefilteringIndexReader::getIndexedPrefixSize(index, &dbr);
+            if (indexedEntries != dbr.getSize()) {
+                compatible = false;
+                check = "database entries";
+            }
+        }
+        // entries appended to the DB are indexed as an additional split, recreate the index with --check-compatible 0 to merge the splits
+        std::vector<size_t> splitBounds;
+        if (compatible == false && par.checkCompatible == 3 && noKmerIndex == false
+            && indexedEntries != SIZE_MAX && PrefilteringIndexReader::getSplitBounds(index, splitBounds)) {
+            Debug(Debug::INFO) << "Index " << (dbr.getSize() - indexedEntries) << " entries added to the database as split " << splitBounds.size() << "\n";
+            baseIndex = index;
+        } else {
+            index->close();
+            delete index;
+        }
         if (compatible) {
             Debug(Debug::INFO) << "Index is up to date and compatible. Force recreation with --check-compatibility 0 parameter.\n";
             recreate = false;
+        } else if (baseIndex != NULL) {
+            recreate = true;
         } else {
             if (par.checkCompatible == 2) {
                 Debug(Debug::ERROR) << "Index is incompatible. Incompatible parameter: " << check << "\n";
@@ -179,11 +202,20 @@ int indexdb(int argc, const char **argv, const Command &command) {
             alndbr->open(DBReader<unsigned int>::NOSORT);
         }
 
-        DBReader<unsigned int>::removeDb(indexDB);
-        PrefilteringIndexReader::createIndexFile(indexDB, &dbr, dbr2, hdbr1, hdbr2, alndbr, seedSubMat, par.maxSeqLen,
+        // the base index is read while its update is written next to it
+        const std::string outDB = (baseIndex != NULL) ? indexDB + "_update" : indexDB;
+        DBReader<unsigned int>::removeDb(outDB);
+        PrefilteringIndexReader::createIndexFile(outDB, &dbr, dbr2, hdbr1, hdbr2, alndbr, seedSubMat, par.maxSeqLen,
                                                  par.spacedKmer, par.spacedKmerPattern, par.compBiasCorrection,
                                                  seedSubMat->alphabetSize, par.kmerSize, par.maskMode, par.maskLowerCaseMode,
-                                                 par.maskProb, par.maskNrepeats,kmerScore, par.targetSearchMode, par.split, par.indexSubset);
+                                                 par.maskProb, par.maskNrepeats,kmerScore, par.targetSearchMode, par.split, par.indexSubset,
+                                                 baseIndex);
+        if (baseIndex != NULL) {
+            baseIndex->close();
+            delete baseIndex;
+            DBReader<unsigned int>::removeDb(indexDB);
+            DBReader<unsigned int>::moveDb(outDB, indexDB);
+        }
 
         if (alndbr != NULL) {
             alndbr->close();
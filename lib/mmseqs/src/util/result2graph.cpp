@@ -0,0 +1,107 @@
+#include "Parameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "Matcher.h"
+#include "StripedSmithWaterman.h"
+#include "AlignmentGraph.h"
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+int result2graph(int argc, const char **argv, const Command &command) {
+    Parameters &par = Parameters::getInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    DBReader<unsigned int> resultReader(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+    resultReader.open(DBReader<unsigned int>::NOSORT);
+    if (resultReader.isCompressed()) {
+        Debug(Debug::ERROR) << "Compressed result databases are not supported\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    // the nodes are the entries of the result DB, their index is sorted by key
+    const size_t nodeCount = resultReader.getSize();
+    size_t *edgeCounts = new size_t[nodeCount + 1];
+    edgeCounts[nodeCount] = 0;
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = (unsigned int) omp_get_thread_num();
+#endif
+#pragma omp for schedule(dynamic, 100)
+        for (size_t id = 0; id < nodeCount; ++id) {
+            const char *data = resultReader.getData(id, thread_idx);
+            edgeCounts[id] = (*data == '\0') ? 0 : Util::countLines(data, resultReader.getEntryLen(id));
+        }
+    }
+    size_t edgeCount = 0;
+    for (size_t id = 0; id < nodeCount; ++id) {
+        edgeCount += edgeCounts[id];
+    }
+
+    const size_t graphSize = AlignmentGraph::serializedSize(nodeCount, edgeCount);
+    char *graphData = static_cast<char *>(malloc(graphSize));
+    Util::checkAllocation(graphData, "Can not allocate alignment graph memory in result2graph");
+    AlignmentGraph graph(graphData, nodeCount, edgeCount);
+    graph.offsets[0] = 0;
+    for (size_t id = 0; id < nodeCount; ++id) {
+        graph.keys[id] = resultReader.getDbKey(id);
+        graph.offsets[id + 1] = graph.offsets[id] + edgeCounts[id];
+    }
+    delete[] edgeCounts;
+
+    Debug::Progress progress(nodeCount);
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = (unsigned int) omp_get_thread_num();
+#endif
+        const char *entry[255];
+#pragma omp for schedule(dynamic, 100)
+        for (size_t id = 0; id < nodeCount; ++id) {
+            progress.updateProgress();
+            char *data = resultReader.getData(id, thread_idx);
+            for (uint64_t edge = graph.offsets[id]; edge < graph.offsets[id + 1]; ++edge) {
+                const size_t columns = Util::getWordsOfLine(data, entry, 255);
+                if (columns < Matcher::ALN_RES_WITHOUT_BT_COL_CNT) {
+                    Debug(Debug::ERROR) << "Invalid alignment result record in entry " << graph.keys[id] << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                const unsigned int targetKey = Util::fast_atoi<unsigned int>(entry[0]);
+                const unsigned int target = graph.getNode(targetKey);
+                if (target == UINT_MAX) {
+                    Debug(Debug::ERROR) << "Target " << targetKey << " of entry " << graph.keys[id]
+                                        << " is not contained in the result database\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                graph.targets[edge] = target;
+                graph.scores[edge] = Util::fast_atoi<int>(entry[1]);
+                // parsed like clust to keep the same truncation
+                graph.seqIds[edge] = AlignmentGraph::quantizeSeqId(atof(entry[2]));
+                graph.evalues[edge] = static_cast<float>(strtod(entry[3], NULL));
+                const int qStart = Util::fast_atoi<int>(entry[4]);
+                const int dbStart = Util::fast_atoi<int>(entry[7]);
+                const float qCov = SmithWaterman::computeCov((qStart == -1) ? 0 : qStart, Util::fast_atoi<int>(entry[5]), Util::fast_atoi<int>(entry[6]));
+                const float dbCov = SmithWaterman::computeCov((dbStart == -1) ? 0 : dbStart, Util::fast_atoi<int>(entry[8]), Util::fast_atoi<int>(entry[9]));
+                graph.queryCovs[edge] = AlignmentGraph::quantizeCov(qCov);
+                graph.targetCovs[edge] = AlignmentGraph::quantizeCov(dbCov);
+                data = Util::skipLine(data);
+            }
+        }
+    }
+    resultReader.close();
+
+    DBWriter graphWriter(par.db2.c_str(), par.db2Index.c_str(), 1, Parameters::WRITER_ASCII_MODE, Parameters::DBTYPE_ALIGNMENT_GRAPH);
+    graphWriter.open();
+    graphWriter.writeData(graphData, graphSize, 0, 0);
+    graphWriter.close(true);
+    free(graphData);
+
+    Debug(Debug::INFO) << "Alignment graph with " << nodeCount << " nodes and " << edgeCount << " edges\n";
+    return EXIT_SUCCESS;
+}
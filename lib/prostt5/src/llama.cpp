@@ -11168,6 +11168,67 @@ struct llm_build_context {
         return lctx.inp_s_mask;
     }
 
+    // CNN head of ProstT5 for the n token rows of cur starting at row first
+    // the <AA2fold> and </s> rows are dropped and one zero row is appended
+    struct ggml_tensor * build_prostt5_head(struct ggml_tensor * cur, int64_t first, int64_t n) {
+        // 1) Slicing: skip first row in dim1
+        size_t offset_bytes = cur->nb[1] * (first + 1);  // skip one row in the dim1 direction
+        ggml_tensor * cur_sliced = ggml_view_3d(
+            ctx0,
+            cur,
+            /* ne0   */ cur->ne[0],
+            /* ne1   */ n - 2,
+            /* ne2   */ cur->ne[2],
+            /* nb1   */ cur->nb[1],
+            /* nb2   */ cur->nb[2],
+            /* offset*/ offset_bytes
+        );
+        cb(cur_sliced, "cur_sliced", -1);
+
+        ggml_tensor * cur_padded = ggml_pad(ctx0, cur_sliced,
+            /*p0=*/0, /*p1=*/1,  // no pad on the n_embd dimension
+            /*p2=*/0, /*p3=*/0   // pad +1 at the end of the tokens dimension
+        );
+        cb(cur_padded, "cur_padded", -1);
+        // PRINT_TENSOR_DIMS("cur_padded", cur_padded)
+
+        ggml_tensor* permuted_tensor = 
+            ggml_cont(ctx0, ggml_permute(ctx0, cur_padded,  2, 0, 1, 3));
+        cb(permuted_tensor, "permuted_tensor", -1);
+        // PRINT_TENSOR_DIMS("permuted_tensor", permuted_tensor)
+
+        // ggml_tensor* cw0 = ggml_cont(ctx0, ggml_permute(ctx0, model.conv0,  1, 0, 2, 3));
+        // cb(cw0, "cw0", -1);
+
+        // ggml_tensor* cur_conv0 = ggml_conv_2d(ctx0, cw0, permuted_tensor, 1, 1, 3, 0, 1, 1);
+        ggml_tensor* cur_conv0 = ggml_conv_2d(ctx0, model.conv0, permuted_tensor, 1, 1, 3, 0, 1, 1);
+        cb(cur_conv0, "cur_conv0", -1);
+        //PRINT_TENSOR_DIMS("cur_conv0", cur_conv0)
+        // ggml_graph_print(gf);
+
+        ggml_tensor* cur_conv0b = ggml_add_inplace(ctx0, cur_conv0, ggml_reshape_4d(ctx0, model.conv0_b, 1, 1, 32, 1));
+        cb(cur_conv0b, "cur_conv0b", -1);
+        //PRINT_TENSOR_DIMS("cur_conv0b", cur_conv0b)
+
+        ggml_tensor* cur_relu = ggml_relu_inplace(ctx0, cur_conv0b);
+        cb(cur_relu, "cur_relu", -1);
+        //PRINT_TENSOR_DIMS("cur_relu", cur_relu)
+
+        // ggml_tensor* cw3 = ggml_cont(ctx0, ggml_permute(ctx0, model.conv3, 1, 0, 2, 3));
+        // cb(cw3, "cw3", -1);
+
+        // ggml_tensor* cur_conv3 = ggml_conv_2d(ctx0, cw3, cur_relu, 1, 1, 3, 0, 1, 1);
+        ggml_tensor* cur_conv3 = ggml_conv_2d(ctx0, model.conv3, cur_relu, 1, 1, 3, 0, 1, 1);
+        cb(cur_conv3, "cur_conv3", -1);
+        //PRINT_TENSOR_DIMS("cur_conv3", cur_conv3)
+
+        ggml_tensor* cur_conv3b = ggml_add_inplace(ctx0, cur_conv3, ggml_reshape_4d(ctx0, model.conv3_b, 1, 1, 20, 1));
+        cb(cur_conv3b, "cur_conv3b", -1);
+        //PRINT_TENSOR_DIMS("cur_conv3b", cur_conv3b)
+
+        return cur_conv3b;
+    }
+
     struct ggml_cgraph * append_pooling(struct ggml_cgraph * gf) {
         // find result_norm tensor for input
         struct ggml_tensor * inp = nullptr;
@@ -11233,62 +11294,21 @@ struct llm_build_context {
         // ggml_graph_print(gf);
         // #define PRINT_TENSOR_DIMS(name, tensor) std::cout << name << " " << (tensor)->ne[0] << "\t" << (tensor)->ne[1] << "\t" << (tensor)->ne[2] << "\t" << (tensor)->ne[3] << std::endl;
 
-        // 1) Slicing: skip first row in dim1
-        size_t offset_bytes = cur->nb[1] * 1ULL;  // skip one row in the dim1 direction
-        ggml_tensor * cur_sliced = ggml_view_3d(
-            ctx0,
-            cur,
-            /* ne0   */ cur->ne[0],
-            /* ne1   */ cur->ne[1] - 2,
-            /* ne2   */ cur->ne[2],
-            /* nb1   */ cur->nb[1],
-            /* nb2   */ cur->nb[2],
-            /* offset*/ offset_bytes
-        );
-        cb(cur_sliced, "cur_sliced", -1);
-
-        ggml_tensor * cur_padded = ggml_pad(ctx0, cur_sliced,
-            /*p0=*/0, /*p1=*/1,  // no pad on the n_embd dimension
-            /*p2=*/0, /*p3=*/0   // pad +1 at the end of the tokens dimension
-        );
-        cb(cur_padded, "cur_padded", -1);
-        // PRINT_TENSOR_DIMS("cur_padded", cur_padded)
-
-        ggml_tensor* permuted_tensor = 
-            ggml_cont(ctx0, ggml_permute(ctx0, cur_padded,  2, 0, 1, 3));
-        cb(permuted_tensor, "permuted_tensor", -1);
-        // PRINT_TENSOR_DIMS("permuted_tensor", permuted_tensor)
-
-        // ggml_tensor* cw0 = ggml_cont(ctx0, ggml_permute(ctx0, model.conv0,  1, 0, 2, 3));
-        // cb(cw0, "cw0", -1);
-
-        // ggml_tensor* cur_conv0 = ggml_conv_2d(ctx0, cw0, permuted_tensor, 1, 1, 3, 0, 1, 1);
-        ggml_tensor* cur_conv0 = ggml_conv_2d(ctx0, model.conv0, permuted_tensor, 1, 1, 3, 0, 1, 1);
-        cb(cur_conv0, "cur_conv0", -1);
-        //PRINT_TENSOR_DIMS("cur_conv0", cur_conv0)
-        // ggml_graph_print(gf);
-
-        ggml_tensor* cur_conv0b = ggml_add_inplace(ctx0, cur_conv0, ggml_reshape_4d(ctx0, model.conv0_b, 1, 1, 32, 1));
-        cb(cur_conv0b, "cur_conv0b", -1);
-        //PRINT_TENSOR_DIMS("cur_conv0b", cur_conv0b)
-
-        ggml_tensor* cur_relu = ggml_relu_inplace(ctx0, cur_conv0b);
-        cb(cur_relu, "cur_relu", -1);
-        //PRINT_TENSOR_DIMS("cur_relu", cur_relu)
-
-        // ggml_tensor* cw3 = ggml_cont(ctx0, ggml_permute(ctx0, model.conv3, 1, 0, 2, 3));
-        // cb(cw3, "cw3", -1);
-
-        // ggml_tensor* cur_conv3 = ggml_conv_2d(ctx0, cw3, cur_relu, 1, 1, 3, 0, 1, 1);
-        ggml_tensor* cur_conv3 = ggml_conv_2d(ctx0, model.conv3, cur_relu, 1, 1, 3, 0, 1, 1);
-        cb(cur_conv3, "cur_conv3", -1);
-        //PRINT_TENSOR_DIMS("cur_conv3", cur_conv3)
-
-        ggml_tensor* cur_conv3b = ggml_add_inplace(ctx0, cur_conv3, ggml_reshape_4d(ctx0, model.conv3_b, 1, 1, 20, 1));
-        cb(cur_conv3b, "result_embd_pooled", -1);
-        //PRINT_TENSOR_DIMS("cur_conv3b", cur_conv3b)
+        // sequences are packed back to back, each gets its own CNN head so that
+        // the convolutions do not mix residues of neighbouring sequences
+        ggml_tensor * cur_head = nullptr;
+        int64_t first = 0;
+        for (int64_t i = 1; i <= cur->ne[1]; ++i) {
+            if (i < cur->ne[1] && (ubatch.seq_id == nullptr || ubatch.seq_id[i][0] == ubatch.seq_id[first][0])) {
+                continue;
+            }
+            ggml_tensor * seq_head = build_prostt5_head(cur, first, i - first);
+            cur_head = cur_head == nullptr ? seq_head : ggml_concat(ctx0, cur_head, seq_head, 0);
+            first = i;
+        }
+        cb(cur_head, "result_embd_pooled", -1);
 
-        ggml_build_forward_expand(gf, cur_conv3b);
+        ggml_build_forward_expand(gf, cur_head);
         // ggml_graph_print(gf);
 #endif
         return gf;
@@ -19117,8 +19137,8 @@ static int llama_encode_internal(
                         float * embd_out = lctx.embd;
 
                         GGML_ASSERT(n_tokens*n_embd <= (int64_t) lctx.embd_size);
-                        int out_channels = 20;
-                        ggml_backend_tensor_get_async(backend_embd, embd, embd_out, 0, (n_tokens - 1)*out_channels*sizeof(float));
+                        // 20 channels of (n_tokens - n_seqs) positions for the packed sequences
+                        ggml_backend_tensor_get_async(backend_embd, embd, embd_out, 0, ggml_nbytes(embd));
                         //ggml_backend_tensor_get_async(backend_embd, embd, embd_out, 0, n_tokens*n_embd*sizeof(float));
                     } break;
                 case LLAMA_POOLING_TYPE_MEAN:
@@ -20191,6 +20211,9 @@ static void llama_model_quantize_internal(const std::string & fname_inp, const s
         // do not quantize relative position bias (T5)
         quantize &= name.find("attn_rel_b.weight") == std::string::npos;
 
+        // do not quantize the ProstT5 CNN head, ggml_conv_2d needs f16/f32 kernels
+        quantize &= name.find("classifier.") == std::string::npos;
+
         enum ggml_type new_type;
         void * new_data;
         size_t new_size;
@@ -334,145 +334,111 @@ void prepare_rbins(double ** ca, int ** rbins, int len, double ** cacoords, doub
   }
 }
 
+// Index of the template with the closest distance bins, prefers the first exact match
+static int find_best_template(const nco_struct * stat, int bin13_1, int bin13_2, int bin14)
+{
+  int j=0;
+  double besthit=1000.;
+  double hit;
+  int bestpos=0;
+  do {
+    hit = fabs(stat[j].bins[0]-bin13_1)+fabs(stat[j].bins[1]-bin13_2)+0.2*fabs(stat[j].bins[2]-bin14);
+    if (hit<besthit) {
+      besthit=hit;
+      bestpos=j;
+    }
+    j++;
+  } while (stat[j].bins[0]>=0 && hit>1e-3);
+  return bestpos;
+}
+
+// The template search only depends on the clamped bins of prepare_rbins,
+// so it is done once for every bin combination instead of once per residue
+struct nco_best_table {
+  int pos[2][10][10][74];
+
+  nco_best_table() {
+    for (int b1=0;b1<10;b1++)
+      for (int b2=0;b2<10;b2++)
+        for (int b3=0;b3<74;b3++) {
+          pos[0][b1][b2][b3] = find_best_template(nco_stat, b1, b2, b3);
+          pos[1][b1][b2][b3] = find_best_template(nco_stat_pro, b1, b2, b3);
+        }
+  }
+};
+
+static const nco_best_table & get_nco_best_table()
+{
+  static const nco_best_table table;
+  return table;
+}
+
 // Reconstruct N and C atoms from Ca atoms. Aminoacids only needed due to Prolin.
 // Note xca: Ca atom coords., where the five first/last fields are empty!!
 void pulchra_rebuild_backbone(double ** xca, double ** n, double ** c, char * aa, int len)
 {
-  double **cacoords, **tmpcoords, **tmpstat;
-  double x1, y1, z1;
-  double x2, y2, z2;
-  double x3, y3, z3;
-  double x4, y4, z4;
-  double besthit, hit;
-  int bestpos;
-  int i, j, k, bin13_1, bin13_2, bin14;
+  double cacoordsData[8][3], tmpcoordsData[8][3], tmpstatData[8][3];
+  double *cacoords[8], *tmpcoords[8], *tmpstat[8];
+  int bestpos, isPro;
+  int i, j, k;
+
+  const nco_best_table & best = get_nco_best_table();
 
+  int * rbinsData = (int*)calloc(sizeof(int)*3*(len+1),1);
   int ** rbins = (int**)calloc(sizeof(int*)*(len+1),1);
   for (i=0;i<len+1;i++)
-    rbins[i] = (int*)calloc(sizeof(int)*3,1);
+    rbins[i] = &rbinsData[3*i];
 
-  cacoords = (double**)calloc(sizeof(double*)*(8),1);
-  tmpcoords = (double**)calloc(sizeof(double*)*(8),1);
-  tmpstat = (double**)calloc(sizeof(double*)*(8),1);
   for (i=0;i<8;i++) {
-    cacoords[i] = (double*)calloc(sizeof(double)*3,1);;
-    tmpcoords[i] = (double*)calloc(sizeof(double)*3,1);;
-    tmpstat[i] = (double*)calloc(sizeof(double)*3,1);;
+    cacoords[i] = cacoordsData[i];
+    tmpcoords[i] = tmpcoordsData[i];
+    tmpstat[i] = tmpstatData[i];
+    for (k=0;k<3;k++) {
+      cacoords[i][k] = 0.;
+      tmpcoords[i][k] = 0.;
+      tmpstat[i][k] = 0.;
+    }
   }
 
   double ** ca = &xca[5];
   prepare_rbins(ca, rbins, len, cacoords, tmpcoords, tmpstat);
 
- for (i=0;i<len+1;i++) {
- 	x1 = ca[i-2][0];
- 	y1 = ca[i-2][1];
- 	z1 = ca[i-2][2];
-
- 	x2 = ca[i-1][0];
- 	y2 = ca[i-1][1];
- 	z2 = ca[i-1][2];
-
- 	x3 = ca[i][0];
- 	y3 = ca[i][1];
- 	z3 = ca[i][2];
-
- 	x4 = ca[i+1][0];
- 	y4 = ca[i+1][1];
- 	z4 = ca[i+1][2];
-
- 	cacoords[0][0] = x1;
- 	cacoords[0][1] = y1;
- 	cacoords[0][2] = z1;
-
- 	cacoords[1][0] = x2;
-  cacoords[1][1] = y2;
-  cacoords[1][2] = z2;
-
-  cacoords[2][0] = x3;
-  cacoords[2][1] = y3;
-  cacoords[2][2] = z3;
-
-  cacoords[3][0] = x4;
-  cacoords[3][1] = y4;
-  cacoords[3][2] = z4;
-
-  bin13_1 = rbins[i][0];
-  bin13_2 = rbins[i][1];
-  bin14 = rbins[i][2];
-
-      if (i>0 && aa[i-1]=='P') {
-        j=0;
-        besthit=1000.;
-        bestpos=0;
-        do {
-          hit = fabs(nco_stat_pro[j].bins[0]-bin13_1)+fabs(nco_stat_pro[j].bins[1]-bin13_2)+0.2*fabs(nco_stat_pro[j].bins[2]-bin14);
-          if (hit<besthit) {
-            besthit=hit;
-            bestpos=j;
-          }
-          j++;
-        } while (nco_stat_pro[j].bins[0]>=0 && hit>1e-3);
-        for (j=0;j<4;j++) {
-         	for (k=0;k<3;k++) {
-         		tmpstat[j][k] = nco_stat_pro[bestpos].data[j][k];
-       	  }
-     	  }
-        for (j=0;j<8;j++) {
-         	for (k=0;k<3;k++) {
-         		tmpcoords[j][k] = nco_stat_pro[bestpos].data[j][k];
-       	  }
-     	  }
-      } else {
-        j=0;
-        besthit=1000.;
-        bestpos=0;
-        do {
-          hit = fabs(nco_stat[j].bins[0]-bin13_1)+fabs(nco_stat[j].bins[1]-bin13_2)+0.2*fabs(nco_stat[j].bins[2]-bin14);
-          if (hit<besthit) {
-            besthit=hit;
-            bestpos=j;
-          }
-          j++;
-        } while (nco_stat[j].bins[0]>=0 && hit>1e-3);
-        for (j=0;j<4;j++) {
-         	for (k=0;k<3;k++) {
-         		tmpstat[j][k] = nco_stat[bestpos].data[j][k];
-       	  }
-     	  }
-        for (j=0;j<8;j++) {
-         	for (k=0;k<3;k++) {
-         		tmpcoords[j][k] = nco_stat[bestpos].data[j][k];
-       	  }
-     	  }
+  for (i=0;i<len+1;i++) {
+    for (j=0;j<4;j++) {
+      for (k=0;k<3;k++) {
+        cacoords[j][k] = ca[i-2+j][k];
       }
+    }
 
-     	superimpose2(cacoords, tmpstat, 4, tmpcoords, 8);
-
-      if (i>0) {
-        c[i-1][0] = tmpcoords[4][0];
-        c[i-1][1] = tmpcoords[4][1];
-        c[i-1][2] = tmpcoords[4][2];
+    isPro = (i>0 && aa[i-1]=='P') ? 1 : 0;
+    const nco_struct * stat = isPro ? nco_stat_pro : nco_stat;
+    bestpos = best.pos[isPro][rbins[i][0]][rbins[i][1]][rbins[i][2]];
+    for (j=0;j<4;j++) {
+      for (k=0;k<3;k++) {
+        tmpstat[j][k] = stat[bestpos].data[j][k];
       }
-
-      if (i<len) {
-        n[i][0] = tmpcoords[6][0];
-        n[i][1] = tmpcoords[6][1];
-        n[i][2] = tmpcoords[6][2];
+    }
+    for (j=0;j<8;j++) {
+      for (k=0;k<3;k++) {
+        tmpcoords[j][k] = stat[bestpos].data[j][k];
       }
- }
- 
-  for (i=0;i<8;i++) {
-    free(cacoords[i]);
-    free(tmpcoords[i]);
-    free(tmpstat[i]);
-  }
-  free(cacoords);
-  free(tmpcoords);
-  free(tmpstat);
+    }
 
-  for (i=0;i<len+1;i++) {
-    free(rbins[i]);
+    superimpose2(cacoords, tmpstat, 4, tmpcoords, 8);
+
+    if (i>0) {
+      c[i-1][0] = tmpcoords[4][0];
+      c[i-1][1] = tmpcoords[4][1];
+      c[i-1][2] = tmpcoords[4][2];
+    }
+
+    if (i<len) {
+      n[i][0] = tmpcoords[6][0];
+      n[i][1] = tmpcoords[6][1];
+      n[i][2] = tmpcoords[6][2];
+    }
   }
+
   free(rbins);
+  free(rbinsData);
 }
-
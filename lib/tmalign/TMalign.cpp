@@ -143,6 +143,87 @@ int score_fun8( Coordinates &xa, Coordinates &ya, int n_ali, float d, int i_ali[
 }
 
 
+static const float laneOffsets[16] __attribute__((aligned(64))) = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+// fused do_rotation + score_fun8: rotates xa by (t, u) in registers instead of writing xt,
+// accumulates the score in vector lanes and collects the pairs below d from the compare mask
+int score_fun8_rotate(const Coordinates &xa, const Coordinates &ya, int n_ali,
+                      float t[3], float u[3][3], float d, int i_ali[],
+                      float *score1, const float Lnorm,
+                      const float score_d8, const float d0, float * mem)
+{
+    float d_tmp=d*d;
+    float d02=d0*d0;
+    float score_d8_cut = score_d8*score_d8;
+    float *distArray = mem;
+    int n_cut = 0;
+
+    simd_float t0 = simdf32_set(t[0]);
+    simd_float t1 = simdf32_set(t[1]);
+    simd_float t2 = simdf32_set(t[2]);
+    simd_float u00 = simdf32_set(u[0][0]);
+    simd_float u01 = simdf32_set(u[0][1]);
+    simd_float u02 = simdf32_set(u[0][2]);
+    simd_float u10 = simdf32_set(u[1][0]);
+    simd_float u11 = simdf32_set(u[1][1]);
+    simd_float u12 = simdf32_set(u[1][2]);
+    simd_float u20 = simdf32_set(u[2][0]);
+    simd_float u21 = simdf32_set(u[2][1]);
+    simd_float u22 = simdf32_set(u[2][2]);
+    simd_float vscore_d8_cut = simdf32_set(score_d8_cut);
+    simd_float vd02 = simdf32_set(d02);
+    simd_float vd_tmp = simdf32_set(d_tmp);
+    simd_float one = simdf32_set(1.0f);
+    simd_float vsum = simdf32_setzero(0);
+    int i;
+    for(i=0; i < n_ali; i+=VECSIZE_FLOAT){
+        simd_float x_x = simdf32_load(&xa.x[i]);
+        simd_float x_y = simdf32_load(&xa.y[i]);
+        simd_float x_z = simdf32_load(&xa.z[i]);
+        simd_float rx = simdf32_add(t0, simdf32_add(simdf32_add(simdf32_mul(u00, x_x), simdf32_mul(u01, x_y)), simdf32_mul(u02, x_z)));
+        simd_float ry = simdf32_add(t1, simdf32_add(simdf32_add(simdf32_mul(u10, x_x), simdf32_mul(u11, x_y)), simdf32_mul(u12, x_z)));
+        simd_float rz = simdf32_add(t2, simdf32_add(simdf32_add(simdf32_mul(u20, x_x), simdf32_mul(u21, x_y)), simdf32_mul(u22, x_z)));
+        rx = simdf32_sub(rx, simdf32_load(&ya.x[i]));
+        ry = simdf32_sub(ry, simdf32_load(&ya.y[i]));
+        rz = simdf32_sub(rz, simdf32_load(&ya.z[i]));
+        simd_float di = simdf32_add(simdf32_add(simdf32_mul(rx, rx), simdf32_mul(ry, ry)), simdf32_mul(rz, rz));
+        simdf32_store(&distArray[i], di);
+        simd_float score = simdf32_div(one, simdf32_add(one, simdf32_div(di, vd02)));
+        score = simdf32_and(simdf32_lt(di, vscore_d8_cut), score);
+        unsigned int cutMask = simdf32_movemask_ps(simdf32_lt(di, vd_tmp));
+        // lanes past n_ali contain stale coordinates
+        const int valid = n_ali - i;
+        if (valid < VECSIZE_FLOAT) {
+            cutMask &= (1u << valid) - 1;
+            simd_float laneValid = simdf32_lt(simdf32_load(laneOffsets), simdf32_set((float) valid));
+            score = simdf32_and(laneValid, score);
+        }
+        vsum = simdf32_add(vsum, score);
+        while (cutMask != 0) {
+            i_ali[n_cut++] = i + __builtin_ctz(cutMask);
+            cutMask &= cutMask - 1;
+        }
+    }
+
+    //there are not enough feasible pairs, reliefe the threshold
+    int inc = 0;
+    while(n_cut<3 && n_ali>3)
+    {
+        inc++;
+        double dinc=(d+inc*0.5);
+        d_tmp = dinc * dinc;
+        n_cut=0;
+        for(i=0; i<n_ali; i++)
+        {
+            i_ali[n_cut]=i;
+            n_cut+=(distArray[i]<d_tmp);
+        }
+    }
+
+    *score1=simdf32_hadd(vsum)/Lnorm;
+    return n_cut;
+}
+
 //int score_fun8( Coordinates &xa, Coordinates &ya, int n_ali, float d, int i_ali[],
 //                float *score1, int score_sum_method, const float Lnorm,
 //                const float score_d8, const float d0, float * mem)
@@ -394,7 +475,8 @@ double TMscore8_search(Coordinates &r1, Coordinates &r2,
 double TMscore8_search_standard(Coordinates &r1, Coordinates &r2,
                                 Coordinates &xtm, Coordinates &ytm, Coordinates &xt, int Lali,
                                 float t0[3], float u0[3][3], int simplify_step,
-                                float *Rcomm, float local_d0_search, float score_d8, float d0, float * mem)
+                                float *Rcomm, float local_d0_search, float score_d8, float d0, float * mem,
+                                bool fused)
 {
     int i, m;
     float score_max, score, rmsd;
@@ -462,14 +544,19 @@ double TMscore8_search_standard(Coordinates &r1, Coordinates &r2,
             KabschFast(r1, r2, L_frag, &rmsd, t, u, mem);
             if (simplify_step != 1)
                 *Rcomm = 0;
-            BasicFunction::do_rotation(xtm, xt, Lali, t, u);
 
             //get subsegment of this fragment
             d = local_d0_search - 1;
-            //n_cut = score_fun8_standard(xt, ytm, Lali, d, i_ali, &score,
-            //                            score_sum_method, score_d8, d0);
-            n_cut = score_fun8(xt, ytm, Lali, d, i_ali, &score,
-                             Lali, score_d8, d0, mem);
+            if (fused) {
+                n_cut = score_fun8_rotate(xtm, ytm, Lali, t, u, d, i_ali, &score,
+                                          Lali, score_d8, d0, mem);
+            } else {
+                BasicFunction::do_rotation(xtm, xt, Lali, t, u);
+                //n_cut = score_fun8_standard(xt, ytm, Lali, d, i_ali, &score,
+                //                            score_sum_method, score_d8, d0);
+                n_cut = score_fun8(xt, ytm, Lali, d, i_ali, &score,
+                                 Lali, score_d8, d0, mem);
+            }
 
             if (score>score_max)
             {
@@ -506,9 +593,14 @@ double TMscore8_search_standard(Coordinates &r1, Coordinates &r2,
                 }
                 //extract rotation matrix based on the fragment
                 KabschFast(r1, r2, n_cut, &rmsd, t, u, mem);
-                BasicFunction::do_rotation(xtm, xt, Lali, t, u);
-                n_cut = score_fun8(xt, ytm, Lali, d, i_ali, &score,
-                                   Lali, score_d8, d0, mem);
+                if (fused) {
+                    n_cut = score_fun8_rotate(xtm, ytm, Lali, t, u, d, i_ali, &score,
+                                              Lali, score_d8, d0, mem);
+                } else {
+                    BasicFunction::do_rotation(xtm, xt, Lali, t, u);
+                    n_cut = score_fun8(xt, ytm, Lali, d, i_ali, &score,
+                                       Lali, score_d8, d0, mem);
+                }
                 if (score>score_max)
                 {
                     score_max = score;
@@ -591,7 +683,8 @@ double detailed_search_standard( Coordinates &r1, Coordinates &r2,
                                  const Coordinates &x, const Coordinates &y,
                                  int ylen, int invmap0[], float t[3], float u[3][3],
                                  int simplify_step, double local_d0_search,
-                                 const bool& bNormalize, float Lnorm, float score_d8, float d0, float * mem)
+                                 const bool& bNormalize, float Lnorm, float score_d8, float d0, float * mem,
+                                 bool fused)
 {
     //x is model, y is template, try to superpose onto y
     int i, j, k;
@@ -617,7 +710,7 @@ double detailed_search_standard( Coordinates &r1, Coordinates &r2,
 
     //detailed search 40-->1
     tmscore = TMscore8_search_standard( r1, r2, xtm, ytm, xt, k, t, u,
-                                        simplify_step, &rmsd, local_d0_search, score_d8, d0, mem);
+                                        simplify_step, &rmsd, local_d0_search, score_d8, d0, mem, fused);
     if (bNormalize)// "-i", to use standard_TMscore, then bNormalize=true, else bNormalize=false;
         tmscore = tmscore * k / Lnorm;
 
@@ -1366,7 +1459,8 @@ double DP_iter(AffineNeedlemanWunsch * affineNW,
 double standard_TMscore(Coordinates &r1, Coordinates &r2, Coordinates &xtm, Coordinates &ytm,
                         Coordinates &xt, Coordinates &x, Coordinates &y, int ylen, int invmap[],
                         int& L_ali, float& RMSD, float D0_MIN, float Lnorm, float d0,
-                        float score_d8, float t[3], float u[3][3], float * mem)
+                        float score_d8, float t[3], float u[3][3], float * mem,
+                        bool fused)
 {
     D0_MIN = 0.5;
     if (Lnorm > 21)
@@ -1419,7 +1513,7 @@ double standard_TMscore(Coordinates &r1, Coordinates &r2, Coordinates &xtm, Coor
     float rms = 0.0;
     tmscore = TMscore8_search_standard(r1, r2, xtm, ytm, xt, n_al, t, u,
                                        temp_simplify_step, &rms, d0_input,
-                                       score_d8, d0, mem);
+                                       score_d8, d0, mem, fused);
     tmscore = tmscore * n_al / (1.0*Lnorm);
 
     return tmscore;
@@ -1439,7 +1533,8 @@ int TMalign_main(
         const int xlen, const int ylen, const float Lnorm_ass,
         const float d0_scale, const bool I_opt, const bool a_opt,
         const bool u_opt, const bool d_opt, const bool fast_opt, float * mem,
-        Coordinates & xtm, Coordinates & ytm, Coordinates & xt, Coordinates & r1, Coordinates & r2)
+        Coordinates & xtm, Coordinates & ytm, Coordinates & xt, Coordinates & r1, Coordinates & r2,
+        const int *seed_invmap, int seed_iter_max)
 {
     float D0_MIN;        //for d0
     float Lnorm;         //normalization length
@@ -1464,6 +1559,28 @@ int TMalign_main(
     float local_d0_search = d0_search;
 
 
+    if (seed_invmap != NULL)
+    {
+        /*************************************************/
+        /*    refine the given alignment, e.g. from 3Di   */
+        /*************************************************/
+        for (i = 0; i<ylen; i++) invmap0[i] = seed_invmap[i];
+        TM = detailed_search(r1, r2, xtm, ytm, xt, xa, ya, ylen, invmap0,
+                             t, u, simplify_step, local_d0_search, Lnorm,
+                             score_d8, d0, mem);
+        if (TM>TMmax) TMmax = TM;
+        TM = DP_iter(affineNW, r1, r2, xtm, ytm, xt, xa, ya,
+                     xlen, ylen, t, u, invmap, 0, 2, seed_iter_max, local_d0_search,
+                     Lnorm, d0, score_d8, mem);
+        if (TM>TMmax)
+        {
+            TMmax = TM;
+            for (i = 0; i<ylen; i++) invmap0[i] = invmap[i];
+        }
+        // the initial alignments below are replaced by the seed
+        goto seeded;
+    }
+
     /******************************************************/
     /*    get initial alignment with gapless threading    */
     /******************************************************/
@@ -1595,6 +1712,7 @@ int TMalign_main(
         }
     }
 
+seeded:
     //*******************************************************************//
     //    The alignment will not be changed any more in the following    //
     //*******************************************************************//
@@ -1625,7 +1743,7 @@ int TMalign_main(
     if (fast_opt) simplify_step=40;
     TM = detailed_search_standard(r1, r2, xtm, ytm, xt, xa, ya, ylen,
                                   invmap0, t, u, simplify_step, local_d0_search,
-                                  false, Lnorm, score_d8, d0, mem);
+                                  false, Lnorm, score_d8, d0, mem, false);
 
     //select pairs with dis<d8 for final TMscore computation and output alignment
     int k=0;
@@ -34,11 +34,25 @@ int score_fun8( Coordinates &xa, Coordinates &ya, int n_ali, float d, int i_ali[
                 float *score1, const float Lnorm,
                 const float score_d8, const float d0, float * mem);
 
+// same as do_rotation(xa, xt, t, u) followed by score_fun8(xt, ya, ...), the score sum differs by rounding
+int score_fun8_rotate(const Coordinates &xa, const Coordinates &ya, int n_ali,
+                      float t[3], float u[3][3], float d, int i_ali[],
+                      float *score1, const float Lnorm,
+                      const float score_d8, const float d0, float * mem);
+
 int score_fun8_standard(Coordinates &xa, Coordinates &ya, int n_ali, float d,
                         int i_ali[], float *score1, int score_sum_method,
                         float score_d8, float d0);
 
 
+bool Kabsch(Coordinates & x,
+            Coordinates & y,
+            int n,
+            int mode,
+            float *rms,
+            float t[3],
+            float u[3][3]);
+
 bool KabschFast(Coordinates & x,
                  Coordinates & y,
                  int n,
@@ -57,7 +71,8 @@ double TMscore8_search(Coordinates &r1, Coordinates &r2,
 double TMscore8_search_standard(Coordinates &r1, Coordinates &r2,
                                 Coordinates &xtm, Coordinates &ytm, Coordinates &xt, int Lali,
                                 float t0[3], float u0[3][3], int simplify_step,
-                                float *Rcomm, float local_d0_search, float score_d8, float d0, float * mem);
+                                float *Rcomm, float local_d0_search, float score_d8, float d0, float * mem,
+                                bool fused = false);
 
 //Comprehensive TMscore search engine
 // input:   two vector sets: x, y
@@ -76,7 +91,8 @@ double detailed_search_standard( Coordinates &r1, Coordinates &r2,
                                  const Coordinates &x, const Coordinates &y,
                                  int ylen, int invmap0[], float t[3], float u[3][3],
                                  int simplify_step, double local_d0_search,
-                                 const bool& bNormalize, float Lnorm, float score_d8, float d0, float * mem);
+                                 const bool& bNormalize, float Lnorm, float score_d8, float d0, float * mem,
+                                 bool fused = false);
 //compute the score quickly in three iterations
 double get_score_fast( Coordinates &r1, Coordinates &r2, Coordinates &xtm, Coordinates &ytm,
                        const Coordinates &x, const Coordinates &y, int ylen, int invmap[],
@@ -141,7 +157,8 @@ double DP_iter(AffineNeedlemanWunsch * affineNW, Coordinates &r1, Coordinates &r
 double standard_TMscore(Coordinates &r1, Coordinates &r2, Coordinates &xtm, Coordinates &ytm,
                         Coordinates &xt, Coordinates &x, Coordinates &y, int ylen, int invmap[],
                         int& L_ali, float& RMSD, float D0_MIN, float Lnorm, float d0,
-                        float score_d8, float t[3], float u[3][3], float * mem);
+                        float score_d8, float t[3], float u[3][3], float * mem,
+                        bool fused = false);
 
 /* entry function for TMalign */
 int TMalign_main(
@@ -157,4 +174,7 @@ int TMalign_main(
         const int xlen, const int ylen, const float Lnorm_ass,
         const float d0_scale, const bool I_opt, const bool a_opt,
         const bool u_opt, const bool d_opt, const bool fast_opt, float * mem,
-        Coordinates &xtm, Coordinates &ytm, Coordinates &xt, Coordinates &r1, Coordinates &r2);
+        Coordinates &xtm, Coordinates &ytm, Coordinates &xt, Coordinates &r1, Coordinates &r2,
+        const int *seed_invmap = NULL, int seed_iter_max = 0);
+// seed_invmap: refines this alignment (index of y -> x or -1) with at most seed_iter_max
+// DP iterations instead of searching the initial alignments
@@ -39,7 +39,7 @@ std::vector<Command> foldseekCommands = {
 #endif
                                     },
                                            {"sequenceDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile }}},
-        {"structureto3didescriptor",             structureto3didescriptor,            &localPar.structurecreatedb,    COMMAND_HIDDEN,
+        {"structureto3didescriptor",             structureto3didescriptor,            &localPar.structureto3didescriptor,    COMMAND_HIDDEN,
                 "Convert PDB/mmCIF/tar[.gz] files to a db",
                 "Convert PDB/mmCIF/tar[.gz] files to a db",
                 "Martin Steinegger <martin.steinegger@snu.ac.kr>",
@@ -104,7 +104,7 @@ std::vector<Command> foldseekCommands = {
                                            {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                            {"alignmentDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
                                            {"tmpDir", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::directory }}},
-        {"easy-rbh",                  structureeasyrbh,                  &localPar.easystructuresearchworkflow,       COMMAND_EASY,
+        {"easy-rbh",                  structureeasyrbh,                  &localPar.easystructurerbhworkflow,       COMMAND_EASY,
                 "Find reciprocal best hit",
                 "# Assign reciprocal best hit\n"
                 "mmseqs easy-rbh examples/QUERY.fasta examples/DB.fasta result tmp\n\n",
@@ -114,7 +114,7 @@ std::vector<Command> foldseekCommands = {
                                            {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::flatfileStdinAndFolder },
                                            {"alignmentFile", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::flatfile },
                                            {"tmpDir", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::directory }}},
-        {"rbh",                  structurerbh,                  &localPar.structuresearchworkflow,       COMMAND_MAIN,
+        {"rbh",                  structurerbh,                  &localPar.structurerbhworkflow,       COMMAND_MAIN,
                 "Reciprocal best hit search",
                 NULL,
                 "Eli Levy Karin & Martin Steinegger <martin.steinegger@snu.ac.kr>",
@@ -130,6 +130,15 @@ std::vector<Command> foldseekCommands = {
                 "<i:sequenceDB> <o:sequenceDB>",
                 CITATION_GPU, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA|DbType::NEED_HEADER, &DbValidator::sequenceDb },
                                           {"sequenceIndexDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::sequenceDb }}},
+        {"prostt5server",        prostt5server,              &localPar.prostt5server,             COMMAND_STORAGE,
+                "Keep a ProstT5 model loaded to predict 3Di for createdb --prostt5-server 1",
+                "# Start the server once\n"
+                "foldseek prostt5server weights --gpu 1\n"
+                "# Queries are predicted by the server without loading the model\n"
+                "foldseek easy-search QUERY.fasta targetDB result.m8 tmp --prostt5-model weights --prostt5-server 1\n\n",
+                "Milot Mirdita <milot@mirdita.de> & Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:prostt5Model>",
+                CITATION_PROSTT5, {{"prostt5Model", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::flatfileAndFolder }}},
         {"result2profile",       result2structprofile,       &localPar.result2structprofile,       COMMAND_PROFILE,
                 "Compute profile DB from a result DB for both amino acid and 3di",
                 NULL,
@@ -158,6 +167,22 @@ std::vector<Command> foldseekCommands = {
                 CITATION_FOLDSEEK|CITATION_MMSEQS2, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                            {"clusterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
                                            {"tmpDir", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::directory }}},
+        {"clusterupdate",        structureclusterupdate,   &localPar.structureclusterupdate,   COMMAND_MAIN,
+                "Update previous clustering with new structures",
+                "# newDB is the updated version of oldDB, missing structures are removed from the clustering\n"
+                "# Added structures are searched against the old representatives, only those without a hit are clustered\n"
+                "foldseek createdb oldAndAddedStructures/ newDB\n"
+                "foldseek clusterupdate oldDB newDB oldClusterDB newMappedDB newClusterDB tmp\n\n"
+                "# newMappedDB holds newDB with the keys of oldDB, use it with newClusterDB\n"
+                "foldseek createtsv newMappedDB newMappedDB newClusterDB newCluster.tsv\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:oldSequenceDB> <i:newSequenceDB> <i:oldClusteringDB> <o:newMappedSequenceDB> <o:newClusteringDB> <tmpDir>",
+                CITATION_FOLDSEEK|CITATION_MMSEQS2, {{"oldSequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"newSequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"oldClusteringDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
+                                           {"newMappedSequenceDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"newClusteringDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::clusterDb },
+                                           {"tmpDir", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::directory }}},
 
 
 
@@ -197,7 +222,35 @@ std::vector<Command> foldseekCommands = {
                                            {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                            {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::resultDb },
                                            {"alignmentDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb }}},
-        {"aln2tmscore", aln2tmscore,      &localPar.threadsandcompression,      COMMAND_ALIGNMENT,
+        {"structurelinclust",     structurelinclust,       &localPar.structurelinclust,      COMMAND_CLUSTER,
+                "Linear time structure clustering of k-mer matches in memory",
+                "Rescores the k-mer matches of kmermatcher along their diagonal, pre-clusters them, aligns the\n"
+                "remaining representatives with structurealign and clusters them again. Only the merged clustering is written",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:sequenceDB> <i:prefilterDB> <o:clusterDB>",
+                CITATION_FOLDSEEK, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"prefilterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::prefilterDb },
+                                           {"clusterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::clusterDb }}},
+        {"structuregreedyclust",     structuregreedyclust,       &localPar.structurealign,      COMMAND_CLUSTER,
+                "Align prefilter hits and cluster greedily by length, skipping alignments of decided structures",
+                "Gives the clustering of structurealign followed by clust --cluster-mode 2, structures that already\n"
+                "belong to a representative are not aligned as query and only until a second hit as target",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:sequenceDB> <i:prefilterDB> <o:clusterDB>",
+                CITATION_FOLDSEEK, {{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"prefilterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::prefilterDb },
+                                           {"clusterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::clusterDb }}},
+        {"structureexpandaln",     structureexpandaln,       &localPar.structureexpandaln,      COMMAND_ALIGNMENT,
+                "Expand representative hits of a cluster search to the members that can reach an E-value",
+                "Composes the query-representative alignments with the representative-member alignments of\n"
+                "targetDB_aln and keeps members whose rescored composed alignment has at most --cluster-search-evalue",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:queryDB> <i:targetDB> <i:alignmentDB> <o:prefilterDB>",
+                CITATION_FOLDSEEK, {{"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"alignmentDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
+                                           {"prefilterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb }}},
+        {"aln2tmscore", aln2tmscore,      &localPar.aln2tmscore,      COMMAND_ALIGNMENT,
                 "Compute tmscore of an alignment database ",
                 NULL,
                 "Martin Steinegger <martin.steinegger@snu.ac.kr>",
@@ -220,7 +273,7 @@ std::vector<Command> foldseekCommands = {
                 "Martin Steinegger <martin.steinegger@snu.ac.kr> & Lars von den Driesch & Maria Hauser",
                 "<i:sequenceDB> <i:resultDB> <o:clusterDB>",
                 CITATION_MMSEQS2|CITATION_MMSEQS1,{{"sequenceDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
-                                           {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::resultDb },
+                                           {"resultDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::resultOrGraphDb },
                                            {"clusterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::clusterDb }}},
         {"databases",            databases,            &localPar.databases,            COMMAND_DATABASE_CREATION,
                 "List and download databases",
@@ -286,6 +339,66 @@ std::vector<Command> foldseekCommands = {
                 "<i:DB> <o:caDB>",
                 CITATION_FOLDSEEK, {{"Db", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::sequenceDb },
                                            {"caDb", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &FoldSeekDbValidator::cadb }}},
+        {"createmulambda",       createmulambda,         &localPar.createmulambda,        COMMAND_DATABASE_CREATION | COMMAND_EXPERT,
+                "Store the E-value mu/lambda of every 3Di sequence next to a structure DB",
+                "# Later alignment stages read DB_mulambda instead of predicting mu/lambda per query\n"
+                "foldseek createmulambda DB DB_mulambda\n\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:DB> <o:muLambdaDB>",
+                CITATION_FOLDSEEK, {{"Db", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::sequenceDb },
+                                           {"muLambdaDb", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &FoldSeekDbValidator::genericDb }}},
+        {"createcomplexlookup",  createcomplexlookup,    &localPar.onlythreads,           COMMAND_DATABASE_CREATION | COMMAND_EXPERT,
+                "Store the chain to complex mapping and the chain copies of a structure DB lookup in binary form",
+                "# Multimer commands read DB_complex instead of parsing DB.lookup\n"
+                "# and reuse superpositions of identical chains listed in DB_symmetry\n"
+                "foldseek createcomplexlookup DB\n\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:DB>",
+                CITATION_FOLDSEEK, {{"Db", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA | DbType::NEED_LOOKUP, &FoldSeekDbValidator::sequenceDb }}},
+        {"mergeprefilter",       mergeprefilter,         &localPar.mergeprefilter,        COMMAND_PREFILTER | COMMAND_EXPERT,
+                "Merge prefilter DBs of the same queries into one DB without duplicate targets",
+                "# Targets found by several prefilters keep their best scoring diagonal\n"
+                "foldseek mergeprefilter queryDB prefDB prefDB_1 prefDB_2\n\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:queryDB> <o:prefilterDB> <i:prefilterDB1> ... <i:prefilterDBn>",
+                CITATION_FOLDSEEK, {{"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
+                                           {"prefilterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::prefilterDb },
+                                           {"prefilterDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA | DbType::VARIADIC, &DbValidator::prefilterDb }}},
+        {"createembeddingindex", createembeddingindex,   &localPar.createembeddingindex,  COMMAND_DATABASE_CREATION | COMMAND_EXPERT,
+                "Cluster the 3Di composition embeddings of a structure DB into an inverted list index",
+                "# Used by --prefilter-mode 4 as a fast approximate candidate search\n"
+                "foldseek createembeddingindex DB DB_emb\n\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:DB> <o:embeddingDB>",
+                CITATION_FOLDSEEK, {{"Db", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::sequenceDb },
+                                           {"embeddingDb", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &FoldSeekDbValidator::genericDb }}},
+        {"embeddingprefilter",   embeddingprefilter,     &localPar.embeddingprefilter,    COMMAND_PREFILTER | COMMAND_EXPERT,
+                "Find the targets with the most similar 3Di composition embedding in an embedding index",
+                "# Search the lists of the 16 closest centroids\n"
+                "foldseek embeddingprefilter queryDB targetDB_emb prefDB --embedding-probes 16\n\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:queryDB> <i:embeddingDB> <o:prefilterDB>",
+                CITATION_FOLDSEEK, {{"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::sequenceDb },
+                                           {"embeddingDb", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::genericDb },
+                                           {"prefilterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::prefilterDb }}},
+        {"createcomplexsketch",  createcomplexsketch,    &localPar.createcomplexsketch,   COMMAND_DATABASE_CREATION | COMMAND_EXPERT,
+                "Sketch the 3Di k-mers of each complex of a structure DB for the complex prefilter",
+                "# Used by multimersearch --complex-prefilter 1, which finds DB_sketch next to the target DB\n"
+                "foldseek createcomplexsketch DB DB_sketch\n\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:DB> <o:sketchDB>",
+                CITATION_FOLDSEEK_MULTIMER, {{"Db", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA | DbType::NEED_LOOKUP, &FoldSeekDbValidator::sequenceDb },
+                                           {"sketchDb", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &FoldSeekDbValidator::genericDb }}},
+        {"complexprefilter",     complexprefilter,       &localPar.complexprefilter,      COMMAND_PREFILTER | COMMAND_EXPERT,
+                "Find the target complexes sharing the most sketched 3Di k-mers with each query complex",
+                "# Candidates are listed in the entry of the first chain of each query complex,\n"
+                "# expandmultimer or alignmultimer add the other chain pairs\n"
+                "foldseek complexprefilter queryDB targetDB_sketch prefDB\n\n",
+                "Martin Steinegger <martin.steinegger@snu.ac.kr>",
+                "<i:queryDB> <i:sketchDB> <o:prefilterDB>",
+                CITATION_FOLDSEEK_MULTIMER, {{"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA | DbType::NEED_LOOKUP, &FoldSeekDbValidator::sequenceDb },
+                                           {"sketchDb", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &FoldSeekDbValidator::genericDb },
+                                           {"prefilterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::prefilterDb }}},
         {"convert2pdb",          convert2pdb,             &localPar.convert2pdb,          COMMAND_FORMAT_CONVERSION,
                 "Convert a foldseek structure db to a single multi model PDB file or a directory of PDB files",
                 NULL,
@@ -313,6 +426,19 @@ std::vector<Command> foldseekCommands = {
         {"scorecomplex", scoremultimer, &localPar.scoremultimer, COMMAND_HIDDEN,
                 "", NULL, "", "", CITATION_FOLDSEEK_MULTIMER, {{"",DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, NULL}}
         },
+        {"alignmultimer", alignmultimer, &localPar.alignmultimer, COMMAND_ALIGNMENT,
+                "Expand, align and score chain pairs of multimer hits in memory",
+                "# Same result as expandmultimer, structurealign and scoremultimer, without the intermediate databases.\n"
+                "foldseek alignmultimer queryDB targetDB alignmentDB complexDB\n",
+                "Woosub Kim <woosubgo@snu.ac.kr>",
+                "<i:queryDb> <i:targetDb> <i:alignmentDB> <o:complexDB>",
+                CITATION_FOLDSEEK_MULTIMER, {
+                                           {"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA | DbType::NEED_HEADER, &DbValidator::sequenceDb},
+                                           {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA | DbType::NEED_HEADER, &DbValidator::sequenceDb},
+                                           {"alignmentDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::prefAlnResDb},
+                                           {"complexDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &DbValidator::alignmentDb}
+                                   }
+        },
         {"filtermultimer", filtermultimer, &localPar.filtermultimer, COMMAND_HIDDEN,
                 "Filters multimers satisfying given coverage",
                 "foldseek filtermultimer queryDB targetDB alignmentDB complexDB -c 0.8 --cov-mode 1\n",
@@ -374,7 +500,9 @@ std::vector<Command> foldseekCommands = {
                 "# Align with TMalign (global)\n"
                 "foldseek multimersearch queryDB targetDB result tmp --alignment-type 1\n"
                 "# Skip prefilter and perform an exhaustive alignment (slower but more sensitive)\n"
-                "foldseek multimersearch queryDB targetDB result tmp --exhaustive-search 1\n\n",
+                "foldseek multimersearch queryDB targetDB result tmp --exhaustive-search 1\n"
+                "# Only align the target complexes sharing sketched 3Di k-mers with the query complexes\n"
+                "foldseek multimersearch queryDB targetDB result tmp --complex-prefilter 1\n\n",
                 "Woosub Kim <woosubgo@snu.ac.kr>",
                 "<i:queryDB> <i:targetDB> <o:alignmentDB> <tmpDir>",
                 CITATION_FOLDSEEK_MULTIMER, {
@@ -438,7 +566,7 @@ std::vector<Command> foldseekCommands = {
                 CITATION_FOLDSEEK_MULTIMER, {
                                         {"queryDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
                                         {"targetDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::sequenceDb },
-                                        {"alignmentDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::alignmentDb },
+                                        {"alignmentDB", DbType::ACCESS_MODE_INPUT, DbType::NEED_DATA, &DbValidator::prefAlnResDb },
                                         {"prefilterDB", DbType::ACCESS_MODE_OUTPUT, DbType::NEED_DATA, &FoldSeekDbValidator::prefilterDb }
                                 }
         },
@@ -7,6 +7,7 @@ extern int structcreatedb(int argc, const char **argv, const Command& command);
 extern int structuresearch(int argc, const char** argv, const Command &command);
 extern int structureindex(int argc, const char** argv, const Command &command);
 extern int structurecluster(int argc, const char** argv, const Command &command);
+extern int structureclusterupdate(int argc, const char** argv, const Command &command);
 extern int easystructuresearch(int argc, const char** argv, const Command &command);
 extern int easystructurecluster(int argc, const char** argv, const Command &command);
 extern int tmalign(int argc, const char** argv, const Command &command);
@@ -18,18 +19,30 @@ extern int structureto3didescriptor(int argc, const char** argv, const Command &
 extern int structurerbh(int argc, const char** argv, const Command &command);
 extern int structureeasyrbh(int argc, const char** argv, const Command &command);
 extern int structureungappedalign(int argc, const char** argv, const Command &command);
+extern int structurelinclust(int argc, const char** argv, const Command &command);
+extern int structuregreedyclust(int argc, const char** argv, const Command &command);
 extern int convert2pdb(int argc, const char** argv, const Command &command);
 extern int compressca(int argc, const char** argv, const Command &command);
 extern int scoremultimer(int argc, const char **argv, const Command& command);
+extern int alignmultimer(int argc, const char **argv, const Command& command);
 extern int filtermultimer(int argc, const char **argv, const Command& command);
 extern int easymultimercluster(int argc, const char** argv, const Command &command);
 extern int multimercluster(int argc, const char** argv, const Command &command);
 extern int easymultimersearch(int argc, const char **argv, const Command &command);
 extern int createmultimerreport(int argc, const char **argv, const Command &command);
 extern int expandmultimer(int argc, const char **argv, const Command &command);
+extern int structureexpandaln(int argc, const char **argv, const Command &command);
 extern int multimersearch(int argc, const char **argv, const Command &command);
 extern int makepaddeddb(int argc, const char **argv, const Command& command);
 extern int result2structprofile(int argc, const char **argv, const Command& command);
 extern int createstructsubdb(int argc, const char **argv, const Command& command);
 extern int lolalign(int argc, const char **argv, const Command& command);
+extern int prostt5server(int argc, const char **argv, const Command& command);
+extern int createmulambda(int argc, const char **argv, const Command& command);
+extern int createcomplexlookup(int argc, const char **argv, const Command& command);
+extern int mergeprefilter(int argc, const char **argv, const Command& command);
+extern int createembeddingindex(int argc, const char **argv, const Command& command);
+extern int embeddingprefilter(int argc, const char **argv, const Command& command);
+extern int createcomplexsketch(int argc, const char **argv, const Command& command);
+extern int complexprefilter(int argc, const char **argv, const Command& command);
 #endif
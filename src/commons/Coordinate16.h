@@ -2,58 +2,124 @@
 #define COORDINATE16_H
 
 #include "LocalParameters.h"
+#include "simd.h"
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 class Coordinate16 {
 public:
-    Coordinate16() : buffer(NULL), bufferSize(0) {}
+    // COORD_STORE_MODE_CA_ALIGNED records consist of a 64 byte header followed by x, y and z blocks of
+    // alignedStride(chainLength) floats each (zero padded). The record size (including the null byte
+    // written by DBWriter) is a multiple of 64, so blocks of mmapped (uncompressed) databases stay
+    // 64 byte aligned, also after merging thread files and reordering entries.
+    // The magic is a NaN bit pattern, which neither float nor diff16 records can start with.
+    static const uint32_t ALIGNED_MAGIC = 0x7FC0CA64;
+    static const size_t ALIGNED_BOUNDARY = 64;
+
+    Coordinate16() : buffer(NULL), bufferSize(0), alignedBuffer(NULL), alignedBufferSize(0) {}
     ~Coordinate16(){
         if(buffer != NULL){
             free(buffer);
         }
+        if(alignedBuffer != NULL){
+            free(alignedBuffer);
+        }
     }
     float* read(const char* mem, size_t chainLength, size_t entryLength) {
-        if (entryLength >= (chainLength * 3) * sizeof(float)) {
+        if (isAligned(mem, entryLength) == false && entryLength >= (chainLength * 3) * sizeof(float)) {
             return (float*) mem;
         }
         if(bufferSize < (chainLength * 3)){
             buffer = (float *)realloc(buffer, (chainLength * 3) * sizeof(float));
             bufferSize = (chainLength * 3);
         }
+        read(mem, chainLength, entryLength, buffer, buffer + chainLength, buffer + 2 * chainLength);
+        return buffer;
+    }
+
+    // decodes into caller owned buffers of at least chainLength floats each
+    static void read(const char* mem, size_t chainLength, size_t entryLength, float* x, float* y, float* z) {
+        const bool aligned = isAligned(mem, entryLength);
+        if (aligned || entryLength >= (chainLength * 3) * sizeof(float)) {
+            const float* data = (const float*) (aligned ? mem + ALIGNED_BOUNDARY : mem);
+            const size_t stride = aligned ? alignedStride(chainLength) : chainLength;
+            if (x != data) {
+                memcpy(x, data, chainLength * sizeof(float));
+            }
+            if (y != data + stride) {
+                memcpy(y, data + stride, chainLength * sizeof(float));
+            }
+            if (z != data + 2 * stride) {
+                memcpy(z, data + 2 * stride, chainLength * sizeof(float));
+            }
+            return;
+        }
         const char* data = mem;
-        int32_t diffSum = 0;
-        int32_t start;
-        memcpy(&start, data, sizeof(int32_t));
-        data += sizeof(int32_t);
-        buffer[0] = start / 1000.0f;
-        int16_t intDiff = 0;
-        for (size_t i = 1; i < chainLength; ++i) {
-            memcpy(&intDiff, data, sizeof(int16_t));
-            data += sizeof(int16_t);
-            diffSum += intDiff;
-            buffer[i] = (start + diffSum) / 1000.0f;
+        data = decodeDiff16(data, chainLength, x);
+        data = decodeDiff16(data, chainLength, y);
+        decodeDiff16(data, chainLength, z);
+    }
+
+    // returns 64 byte aligned x, y and z blocks zero padded to alignedStride(chainLength)
+    // points directly into mem for aligned records, otherwise decodes into an internal buffer
+    void readAligned(const char* mem, size_t chainLength, size_t entryLength, float*& x, float*& y, float*& z) {
+        const size_t stride = alignedStride(chainLength);
+        if (isAligned(mem, entryLength) && ((uintptr_t) mem % ALIGNED_BOUNDARY) == 0) {
+            x = (float*) (mem + ALIGNED_BOUNDARY);
+            y = x + stride;
+            z = y + stride;
+            return;
         }
-        diffSum = 0;
-        memcpy(&start, data, sizeof(int32_t));
-        data += sizeof(int32_t);
-        buffer[chainLength] = start / 1000.0f;
-        for (size_t i = chainLength + 1; i < 2 * chainLength; ++i) {
-            memcpy(&intDiff, data, sizeof(int16_t));
-            data += sizeof(int16_t);
-            diffSum += intDiff;
-            buffer[i] = (start + diffSum) / 1000.0f;
+        if (alignedBufferSize < stride * 3) {
+            free(alignedBuffer);
+            alignedBuffer = (float*) mem_align(ALIGNED_BOUNDARY, stride * 3 * sizeof(float));
+            alignedBufferSize = stride * 3;
         }
-        diffSum = 0;
-        memcpy(&start, data, sizeof(int32_t));
-        data += sizeof(int32_t);
-        buffer[2 * chainLength] = start / 1000.0f;
-        for (size_t i = 2 * chainLength + 1; i < 3 * chainLength; ++i) {
-            memcpy(&intDiff, data, sizeof(int16_t));
-            data += sizeof(int16_t);
-            diffSum += intDiff;
-            buffer[i] = (start + diffSum) / 1000.0f;
+        x = alignedBuffer;
+        y = x + stride;
+        z = y + stride;
+        read(mem, chainLength, entryLength, x, y, z);
+        for (size_t i = chainLength; i < stride; ++i) {
+            x[i] = 0.0f;
+            y[i] = 0.0f;
+            z[i] = 0.0f;
+        }
+    }
+
+    static bool isAligned(const char* mem, size_t entryLength) {
+        if (entryLength < ALIGNED_BOUNDARY) {
+            return false;
+        }
+        uint32_t magic;
+        memcpy(&magic, mem, sizeof(uint32_t));
+        return magic == ALIGNED_MAGIC;
+    }
+
+    static size_t alignedStride(size_t chainLength) {
+        const size_t floatsPerBoundary = ALIGNED_BOUNDARY / sizeof(float);
+        return std::max((size_t) 1, (chainLength + floatsPerBoundary - 1) / floatsPerBoundary) * floatsPerBoundary;
+    }
+
+    // size to pass to DBWriter::writeData, which appends the null byte that completes the last boundary
+    static size_t alignedRecordSize(size_t chainLength) {
+        return ALIGNED_BOUNDARY + alignedStride(chainLength) * 3 * sizeof(float) + ALIGNED_BOUNDARY - 1;
+    }
+
+    template <typename T>
+    static void convertToAligned(size_t len, const T* x, const T* y, const T* z, std::vector<int8_t>& out, int stride = 1) {
+        const size_t alignedLen = alignedStride(len);
+        out.assign(alignedRecordSize(len), 0);
+        uint32_t magic = ALIGNED_MAGIC;
+        memcpy(out.data(), &magic, sizeof(uint32_t));
+        uint32_t chainLength = len;
+        memcpy(out.data() + sizeof(uint32_t), &chainLength, sizeof(uint32_t));
+        float* blocks = reinterpret_cast<float*>(out.data() + ALIGNED_BOUNDARY);
+        for (size_t i = 0; i < len; ++i) {
+            blocks[i] = std::isnan(x[i * stride]) ? 0.0f : x[i * stride];
+            blocks[alignedLen + i] = std::isnan(y[i * stride]) ? 0.0f : y[i * stride];
+            blocks[2 * alignedLen + i] = std::isnan(z[i * stride]) ? 0.0f : z[i * stride];
         }
-        return buffer;
     }
 
     template <typename T>
@@ -73,9 +139,67 @@ public:
         return false;
     }
 
+    // decodes one int32 start followed by (len - 1) int16 deltas
+    // returns the position after the last delta
+    static const char* decodeDiff16(const char* data, size_t len, float* out) {
+        int32_t start;
+        memcpy(&start, data, sizeof(int32_t));
+        data += sizeof(int32_t);
+        out[0] = start / 1000.0f;
+        int32_t sum = start;
+        size_t i = 1;
+#ifdef AVX2
+        __m256i carry = _mm256_set1_epi32(start);
+        const __m256 scale = _mm256_set1_ps(1000.0f);
+        for (; i + 8 <= len; i += 8) {
+            __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*) data));
+            data += 8 * sizeof(int16_t);
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+            x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+            // carry the sum of the lower 128-bit lane into the upper one
+            __m256i lowSum = _mm256_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+            x = _mm256_add_epi32(x, _mm256_permute2x128_si256(lowSum, lowSum, 0x08));
+            x = _mm256_add_epi32(x, carry);
+            carry = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+            _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(x), scale));
+        }
+        sum = _mm256_extract_epi32(carry, 0);
+#else
+        __m128i carry = _mm_set1_epi32(start);
+        const __m128 scale = _mm_set1_ps(1000.0f);
+        for (; i + 8 <= len; i += 8) {
+            __m128i deltas = _mm_loadu_si128((const __m128i*) data);
+            data += 8 * sizeof(int16_t);
+            __m128i lo = _mm_cvtepi16_epi32(deltas);
+            __m128i hi = _mm_cvtepi16_epi32(_mm_srli_si128(deltas, 8));
+            lo = _mm_add_epi32(lo, _mm_slli_si128(lo, 4));
+            lo = _mm_add_epi32(lo, _mm_slli_si128(lo, 8));
+            lo = _mm_add_epi32(lo, carry);
+            carry = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 3, 3, 3));
+            hi = _mm_add_epi32(hi, _mm_slli_si128(hi, 4));
+            hi = _mm_add_epi32(hi, _mm_slli_si128(hi, 8));
+            hi = _mm_add_epi32(hi, carry);
+            carry = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 3, 3, 3));
+            _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(out + i + 4, _mm_div_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+        sum = _mm_cvtsi128_si32(carry);
+#endif
+        for (; i < len; ++i) {
+            int16_t intDiff;
+            memcpy(&intDiff, data, sizeof(int16_t));
+            data += sizeof(int16_t);
+            sum += intDiff;
+            out[i] = sum / 1000.0f;
+        }
+        return data;
+    }
+
 private:
     float * buffer;
     size_t bufferSize;
+    float * alignedBuffer;
+    size_t alignedBufferSize;
 };
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "LDDT.h"
 #include <string.h>
 #include <algorithm>
+#include <climits>
 
 
 static inline float dist(float* arr1, float* arr2) {
@@ -22,10 +23,6 @@ LDDTCalculator::LDDTCalculator(unsigned int maxQueryLength, unsigned int maxTarg
     for(unsigned int i = 0; i < maxTargetLength; i++) {
         target_coordinates[i] = new float[3];
     }
-    dists_to_score = new bool*[maxQueryLength];
-    for(unsigned int i = 0; i < maxQueryLength; i++) {
-        dists_to_score[i] = new bool[maxQueryLength];
-    }
 
     score = new float*[maxAlignLength];
     for(unsigned int i = 0; i < maxAlignLength; i++) {
@@ -52,12 +49,6 @@ LDDTCalculator::~LDDTCalculator() {
         }
         delete[] target_coordinates;
     }
-    if(dists_to_score) {
-        for(unsigned int i = 0; i < maxQueryLength; i++) {
-            delete[] dists_to_score[i];
-        }
-        delete[] dists_to_score;
-    }
     if(score) {
         for(unsigned int i = 0; i < maxAlignLength; i++) {
             delete[] score[i];
@@ -84,6 +75,60 @@ LDDTCalculator::~LDDTCalculator() {
     }
 }
 
+void LDDTCalculator::Grid::build(float ** coords, unsigned int len) {
+    for(int dim = 0; dim < 3; dim++) {
+        min[dim] = INF;
+    }
+    float max[3] = {-INF, -INF, -INF};
+    for(unsigned int i = 0; i < len; i++) {
+        for(int dim = 0; dim < 3; dim++) {
+            if(coords[i][dim] < min[dim]) min[dim] = coords[i][dim];
+            if(coords[i][dim] > max[dim]) max[dim] = coords[i][dim];
+        }
+    }
+    // grow the cells for widely spread structures to bound the grid size
+    const size_t maxCells = std::max(static_cast<size_t>(len) * 8, static_cast<size_t>(4096));
+    cellSize = CUTOFF;
+    size_t totalCells;
+    do {
+        totalCells = 1;
+        for(int dim = 0; dim < 3; dim++) {
+            numCells[dim] = (max[dim] >= min[dim]) ? static_cast<int>((max[dim] - min[dim]) / cellSize) + 1 : 1;
+            totalCells *= numCells[dim];
+        }
+        if(totalCells > maxCells) {
+            cellSize *= 2;
+        }
+    } while(totalCells > maxCells);
+
+    cellStart.assign(totalCells + 1, 0);
+    cellMembers.resize(len);
+    std::vector<unsigned int> cellOf(len);
+    for(unsigned int i = 0; i < len; i++) {
+        float * p = coords[i];
+        // residues without coordinates have no neighbours
+        if(std::isfinite(p[0]) == false || std::isfinite(p[1]) == false || std::isfinite(p[2]) == false) {
+            cellOf[i] = UINT_MAX;
+            continue;
+        }
+        int c[3];
+        for(int dim = 0; dim < 3; dim++) {
+            c[dim] = std::min(static_cast<int>((p[dim] - min[dim]) / cellSize), numCells[dim] - 1);
+        }
+        cellOf[i] = (c[0] * numCells[1] + c[1]) * numCells[2] + c[2];
+        cellStart[cellOf[i] + 1]++;
+    }
+    for(size_t cell = 0; cell < totalCells; cell++) {
+        cellStart[cell + 1] += cellStart[cell];
+    }
+    std::vector<unsigned int> fill(cellStart.begin(), cellStart.end() - 1);
+    for(unsigned int i = 0; i < len; i++) {
+        if(cellOf[i] != UINT_MAX) {
+            cellMembers[fill[cellOf[i]]++] = i;
+        }
+    }
+}
+
 void LDDTCalculator::initQuery(unsigned int queryLen, float *qx, float *qy, float *qz) {
     queryLength = queryLen;
     for(unsigned int i = 0; i < queryLength; i++) {
@@ -91,34 +136,59 @@ void LDDTCalculator::initQuery(unsigned int queryLen, float *qx, float *qy, floa
         query_coordinates[i][1] = qy[i];
         query_coordinates[i][2] = qz[i];
     }
-    // Initialize arrays
-    for(unsigned int i = 0; i < queryLength; i++) {
-        memset(dists_to_score[i], 0, sizeof(bool) * queryLength);
-    }
 
-    query_grid = Grid(query_coordinates, queryLength);
+    query_grid.build(query_coordinates, queryLength);
     memset(norm, 0, sizeof(float) * queryLength);
 
-    for(unsigned int col = 0; col < queryLength; col++) {
-        for (unsigned int row = 0; row < queryLength; row++) {
-            float distance = dist(query_coordinates[row], query_coordinates[col]);
-            bool isClose = (col != row) && (distance < CUTOFF);
-            dists_to_score[col][row] = isClose;
-            dists_to_score[row][col] = isClose;
-            norm[col] += dists_to_score[row][col];
+    // collect all query pairs within the cutoff once, per target only these are scored
+    neighbourStart.resize(queryLength + 1);
+    neighbourIdx.clear();
+    neighbourDist.clear();
+    const Grid & grid = query_grid;
+    for(unsigned int i = 0; i < queryLength; i++) {
+        neighbourStart[i] = neighbourIdx.size();
+        float * p = query_coordinates[i];
+        if(std::isfinite(p[0]) == false || std::isfinite(p[1]) == false || std::isfinite(p[2]) == false) {
+            continue;
+        }
+        int c[3];
+        for(int dim = 0; dim < 3; dim++) {
+            c[dim] = std::min(static_cast<int>((p[dim] - grid.min[dim]) / grid.cellSize), grid.numCells[dim] - 1);
+        }
+        for(int x = std::max(c[0] - 1, 0); x <= std::min(c[0] + 1, grid.numCells[0] - 1); x++) {
+            for(int y = std::max(c[1] - 1, 0); y <= std::min(c[1] + 1, grid.numCells[1] - 1); y++) {
+                for(int z = std::max(c[2] - 1, 0); z <= std::min(c[2] + 1, grid.numCells[2] - 1); z++) {
+                    const unsigned int cell = (x * grid.numCells[1] + y) * grid.numCells[2] + z;
+                    for(unsigned int m = grid.cellStart[cell]; m < grid.cellStart[cell + 1]; m++) {
+                        const unsigned int j = grid.cellMembers[m];
+                        if(j <= i) {
+                            continue;
+                        }
+                        float distance = dist(query_coordinates[i], query_coordinates[j]);
+                        if(distance < CUTOFF) {
+                            neighbourIdx.push_back(j);
+                            neighbourDist.push_back(distance);
+                            norm[i] += 1;
+                            norm[j] += 1;
+                        }
+                    }
+                }
+            }
         }
+    }
+    neighbourStart[queryLength] = neighbourIdx.size();
 
-        if(norm[col] != 0) {
-            norm[col] = 1 / norm[col];
+    for(unsigned int i = 0; i < queryLength; i++) {
+        if(norm[i] != 0) {
+            norm[i] = 1 / norm[i];
         } else {
-            norm[col] = INF;
+            norm[i] = INF;
         }
     }
-
 }
 
 LDDTCalculator::LDDTScoreResult LDDTCalculator::computeLDDTScore(unsigned int targetLen, int qStartPos, int tStartPos, const std::string &backtrace,
-                                                                 float *tx, float *ty, float *tz) {
+                                                                 float *tx, float *ty, float *tz, float *perCaLddtScore) {
     targetLength = targetLen;
 
     for(unsigned int i = 0; i < targetLength; i++) {
@@ -129,83 +199,69 @@ LDDTCalculator::LDDTScoreResult LDDTCalculator::computeLDDTScore(unsigned int ta
 
     constructAlignHashes(qStartPos, tStartPos, backtrace);
     calculateLddtScores();
-    return LDDTScoreResult(reduce_score, alignLength);
+    float sum = 0.0;
+    int scoreLength = alignLength;
+    for(unsigned int i = 0; i < alignLength; i++) {
+        if (std::isnan(reduce_score[i])) {
+            scoreLength = scoreLength - 1;
+            if (perCaLddtScore != NULL) {
+                perCaLddtScore[i] = 0;
+            }
+        } else {
+            sum += reduce_score[i];
+            if (perCaLddtScore != NULL) {
+                perCaLddtScore[i] = reduce_score[i];
+            }
+        }
+    }
+    return LDDTScoreResult((double)(sum/(float)scoreLength), scoreLength);
 }
 
 void LDDTCalculator::constructAlignHashes(int query_idx, int target_idx, const std::string & cigar) {
     memset(query_to_align, -1, sizeof(int) * queryLength);
     memset(target_to_align, -1, sizeof(int) * targetLength);
     int align_idx = 0;
+    int count = 0;
     for(std::size_t i = 0; i < cigar.length(); i++) {
+        // run-length counts of compressed backtraces
+        if(cigar[i] >= '0' && cigar[i] <= '9') {
+            count = count * 10 + cigar[i] - '0';
+            continue;
+        }
+        const int len = (count == 0) ? 1 : count;
+        count = 0;
         if(cigar[i] == 'M') {
-            align_to_query[align_idx] = query_idx;
-            query_to_align[query_idx] = align_idx;
-            align_to_target[align_idx] = target_idx;
-            target_to_align[target_idx] = align_idx;
-            align_idx++; query_idx++; target_idx++;
+            for(int k = 0; k < len; k++) {
+                align_to_query[align_idx] = query_idx;
+                query_to_align[query_idx] = align_idx;
+                align_to_target[align_idx] = target_idx;
+                target_to_align[target_idx] = align_idx;
+                align_idx++; query_idx++; target_idx++;
+            }
         } else if(cigar[i] == 'D') {
-            target_to_align[target_idx] = -1; // does not align
-            target_idx++;
+            target_idx += len; // does not align
         } else if(cigar[i] == 'I') {
-            query_to_align[query_idx] = -1; // does not align
-            query_idx++;
+            query_idx += len; // does not align
         }
     }
     alignLength = align_idx;
 }
 
 void LDDTCalculator::calculateLddtScores() {
-    const int DIR = 14;
-    int dx[DIR] = {0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0};
-    int dy[DIR] = {0, 1, 1, 1, 0, 0, 0, -1, -1, -1, 1, 1, 1, 0};
-    int dz[DIR] = {0, 1, 0, -1, 1, 0, -1, 1, 0, -1, 1, 0, -1, 1};
     memset(reduce_score, 0, sizeof(float) * alignLength);
-    std::map<std::tuple<int, int, int>, bool> visited_boxes;
-    // Create a set of unique boxes containing aligned residues
-    for (unsigned int align_idx = 0; align_idx < alignLength; align_idx++) {
-        if (align_to_query[align_idx] != -1) {
-            std::tuple<int, int, int> box_coord = query_grid.getGridCoordinates(query_coordinates[align_to_query[align_idx]]);
-            // If box_coord has been visited already, skip
-            if (visited_boxes.find(box_coord) != visited_boxes.end()) {
+    for (unsigned int align_idx1 = 0; align_idx1 < alignLength; align_idx1++) {
+        const int query_idx1 = align_to_query[align_idx1];
+        float * target1 = target_coordinates[align_to_target[align_idx1]];
+        for (unsigned int k = neighbourStart[query_idx1]; k < neighbourStart[query_idx1 + 1]; k++) {
+            const int align_idx2 = query_to_align[neighbourIdx[k]];
+            if (align_idx2 == -1) {
                 continue;
             }
-            visited_boxes[box_coord] = true;
-
-            std::pair<size_t, size_t> box_members = query_grid.getBoxMemberRange(box_coord);
-
-            for (size_t i = box_members.first; i < box_members.second; i++) {
-                int query_idx1 = query_grid.box[i].second;
-                int align_idx1 = query_to_align[query_idx1];
-                if (align_idx1 == -1) {
-                    continue;
-                }
-
-                // Different boxes
-                for (int dir = 0; dir < DIR; dir++) {
-                    std::tuple<int, int, int> key = std::make_tuple(std::get<0>(box_coord) + dx[dir],
-                                    std::get<1>(box_coord) + dy[dir],
-                                    std::get<2>(box_coord) + dz[dir]);
-                    std::pair<size_t, size_t> boxPrime_members = query_grid.getBoxMemberRange(key);
-
-                    size_t i2 = (dir == 0) ? i + 1 : boxPrime_members.first;
-                    for (; i2 < boxPrime_members.second; i2++) {
-                        int query_idx2 = query_grid.box[i2].second;;
-                        int align_idx2 = query_to_align[query_idx2];
-                        if (align_idx2 == -1) {
-                            continue;
-                        }
-                        if (dists_to_score[query_idx1][query_idx2]) {
-                            float distance = dist(query_coordinates[query_idx1], query_coordinates[query_idx2]);
-                            float dist_sub = dist(target_coordinates[align_to_target[align_idx1]],
-                                                  target_coordinates[align_to_target[align_idx2]]);
-                            float d_l = std::abs(distance - dist_sub);
-                            float score = 0.25 * ((d_l < 0.5) + (d_l < 1.0) + (d_l < 2.0) + (d_l < 4.0));
-                            reduce_score[align_idx2] += score;
-                            reduce_score[align_idx1] += score;
-                        }
-                    }
-                }
-            }
+            float dist_sub = dist(target1, target_coordinates[align_to_target[align_idx2]]);
+            float d_l = std::abs(neighbourDist[k] - dist_sub);
+            float score = 0.25 * ((d_l < 0.5) + (d_l < 1.0) + (d_l < 2.0) + (d_l < 4.0));
+            reduce_score[align_idx2] += score;
+            reduce_score[align_idx1] += score;
         }
     }
 
@@ -19,12 +19,16 @@ LocalParameters::LocalParameters() :
         PARAM_MODEL_NAME_MODE(PARAM_MODEL_NAME_MODE_ID,"--model-name-mode", "Model name mode", "Add model to name:\n0: auto\n1: always add\n",typeid(int), (void *) &modelNameMode, "^[0-1]{1}$", MMseqsParameter::COMMAND_EXPERT),
         PARAM_WRITE_MAPPING(PARAM_WRITE_MAPPING_ID, "--write-mapping", "Write mapping file", "write _mapping file containing mapping from internal id to taxonomic identifier", typeid(int), (void *) &writeMapping, "^[0-1]{1}", MMseqsParameter::COMMAND_EXPERT),
         PARAM_TMALIGN_FAST(PARAM_TMALIGN_FAST_ID,"--tmalign-fast", "TMalign fast","turn on fast search in TM-align" ,typeid(int), (void *) &tmAlignFast, "^[0-1]{1}$"),
-        PARAM_EXACT_TMSCORE(PARAM_EXACT_TMSCORE_ID,"--exact-tmscore", "Exact TMscore","turn on fast exact TMscore (slow), default is approximate" ,typeid(int), (void *) &exactTMscore, "^[0-1]{1}$"),
+        PARAM_TMALIGN_SEED(PARAM_TMALIGN_SEED_ID,"--tmalign-seed", "TMalign seed","TM-align initial alignment:\n0: search all initial alignments\n1: refine the 3Di+AA alignment of the previous step (faster)" ,typeid(int), (void *) &tmAlignSeed, "^[0-1]{1}$"),
+        PARAM_PAIR_CACHE(PARAM_PAIR_CACHE_ID,"--pair-cache", "Pair cache", "Result DB of an earlier TM-align run with the same parameters, its hits are reused instead of realigned", typeid(std::string), (void *) &pairCache, "^.*$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_EXACT_TMSCORE(PARAM_EXACT_TMSCORE_ID,"--exact-tmscore", "Exact TMscore","TMscore computation:\n0: approximate\n1: exact (slow)\n2: approximate with fused SIMD rotation and scoring (fastest, may differ by rounding)" ,typeid(int), (void *) &exactTMscore, "^[0-2]{1}$"),
+        PARAM_EXACT_FWBW(PARAM_EXACT_FWBW_ID,"--exact-fwbw", "Exact FwBw","Forward-backward rescaling terms:\n0: SIMD exp/log approximation (faster)\n1: libm exp/log" ,typeid(int), (void *) &exactFwbw, "^[0-1]{1}$"),
         PARAM_N_SAMPLE(PARAM_N_SAMPLE_ID, "--n-sample", "Sample size","pick N random sample" ,typeid(int), (void *) &nsample, "^[0-9]{1}[0-9]*$"),
-        PARAM_COORD_STORE_MODE(PARAM_COORD_STORE_MODE_ID, "--coord-store-mode", "Coord store mode", "Coordinate storage mode: \n1: C-alpha as float\n2: C-alpha as difference (uint16_t)", typeid(int), (void *) &coordStoreMode, "^[1-2]{1}$",MMseqsParameter::COMMAND_EXPERT),
+        PARAM_COORD_STORE_MODE(PARAM_COORD_STORE_MODE_ID, "--coord-store-mode", "Coord store mode", "Coordinate storage mode: \n1: C-alpha as float\n2: C-alpha as difference (uint16_t)\n4: C-alpha as 64 byte aligned float blocks", typeid(int), (void *) &coordStoreMode, "^[124]{1}$",MMseqsParameter::COMMAND_EXPERT),
         PARAM_MIN_ASSIGNED_CHAINS_THRESHOLD(PARAM_MIN_ASSIGNED_CHAINS_THRESHOLD_ID, "--min-assigned-chains-ratio", "Minimum assigned chains percentage Threshold", "Minimum ratio of assigned chains out of all query chains > thr [0.0,1.0]", typeid(float), (void *) & minAssignedChainsThreshold, "^[0-9]*(\\.[0-9]+)?$", MMseqsParameter::COMMAND_ALIGN),
         PARAM_MONOMER_INCLUDE_MODE(PARAM_MONOMER_INCLUDE_MODE_ID, "--monomer-include-mode", "Monomer inclusion Mode for MultimerSerch", "Monomer Complex Inclusion 0: include monomers, 1: NOT include monomers", typeid(int), (void *) & monomerIncludeMode, "^[0-1]{1}$", MMseqsParameter::COMMAND_ALIGN),
         PARAM_CLUSTER_SEARCH(PARAM_CLUSTER_SEARCH_ID, "--cluster-search", "Cluster search", "first find representative then align all cluster members", typeid(int), (void *) &clusterSearch, "^[0-1]{1}$",MMseqsParameter::COMMAND_MISC),
+        PARAM_INCREMENTAL_ITERATIONS(PARAM_INCREMENTAL_ITERATIONS_ID, "--incremental-iterations", "Incremental iterations", "Skip converged queries (no new hits) in intermediate iterations, all queries are searched in the last iteration", typeid(int), (void *) &incrementalIterations, "^[0-1]{1}$", MMseqsParameter::COMMAND_MISC),
         PARAM_FILE_INCLUDE(PARAM_FILE_INCLUDE_ID, "--file-include", "File Inclusion Regex", "Include file names based on this regex", typeid(std::string), (void *) &fileInclude, "^.*$"),
         PARAM_FILE_EXCLUDE(PARAM_FILE_EXCLUDE_ID, "--file-exclude", "File Exclusion Regex", "Exclude file names based on this regex", typeid(std::string), (void *) &fileExclude, "^.*$"),
         PARAM_INDEX_EXCLUDE(PARAM_INDEX_EXCLUDE_ID, "--index-exclude", "Index Exclusion", "Exclude parts of the index:\n0: Full index\n1: Exclude k-mer index (for use with --prefilter-mode 1)\n2: Exclude C-alpha coordinates (for use with --sort-by-structure-bits 0)\nFlags can be combined bit wise", typeid(int), (void *) &indexExclude, "^[0-3]{1}$", MMseqsParameter::COMMAND_EXPERT),
@@ -42,7 +46,29 @@ LocalParameters::LocalParameters() :
         PARAM_INTERFACE_LDDT_THRESHOLD(PARAM_INTERFACE_LDDT_THRESHOLD_ID,"--interface-lddt-threshold", "Interface LDDT threshold", "accept alignments with a lddt > thr [0.0,1.0]",typeid(float), (void *) &filtInterfaceLddtThr, "^0(\\.[0-9]+)?|1(\\.0+)?$"),
         PARAM_MULTIDOMAIN(PARAM_MULTIDOMAIN_ID, "--multidomain", "MultiDomain Mode", "MultiDomain Mode LoLalign", typeid(int), (void *) &multiDomain, "^[0-1]{1}$"),
         PARAM_HASH_ENTRY_NAMES(PARAM_HASH_ENTRY_NAMES_ID, "--hash-entry-names", "Hash entry names", "Use hash-based entry names from full paths:\n0: use basename (default)\n1: hash full path to base62", typeid(int), (void *) &hashEntryNames, "^[0-1]{1}$", MMseqsParameter::COMMAND_EXPERT),
-        PARAM_PATHMAP(PARAM_PATHMAP_ID, "--pathmap", "Path mapping file", "Path mapping file to replace hashed IDs with full paths in results", typeid(std::string), (void *) &pathmapFile, "^.*$")
+        PARAM_PATHMAP(PARAM_PATHMAP_ID, "--pathmap", "Path mapping file", "Path mapping file to replace hashed IDs with full paths in results", typeid(std::string), (void *) &pathmapFile, "^.*$"),
+        PARAM_TAR_INDEX(PARAM_TAR_INDEX_ID, "--tar-index", "Tar member index", "Member index <archive>.tarindex next to tar inputs:\n0: do not use\n1: read only included members of indexed archives, index the others", typeid(int), (void *) &tarIndex, "^[0-1]{1}$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_GCS_PREFETCH(PARAM_GCS_PREFETCH_ID, "--gcs-prefetch", "GCS downloads per thread", "Number of Google Cloud Storage objects each thread downloads ahead while parsing", typeid(int), (void *) &gcsPrefetch, "^[1-9]{1}[0-9]*$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PROSTT5_SPLIT_OVERLAP(PARAM_PROSTT5_SPLIT_OVERLAP_ID, "--prostt5-split-overlap", "ProstT5 window overlap", "Residues shared by neighbouring ProstT5 windows of long sequences, predictions are stitched from the window centers (0: consecutive chunks)", typeid(int), (void *) &prostt5SplitOverlap, "^[0-9]{1}[0-9]*$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PROSTT5_PRECISION(PARAM_PROSTT5_PRECISION_ID, "--prostt5-precision", "ProstT5 precision", "Precision of the ProstT5 encoder weights:\n0: auto, pick the fastest on a calibration set (f16 on GPU)\n1: f16\n2: int8 (q8_0)\n3: int4 (q4_0)", typeid(int), (void *) &prostt5Precision, "^[0-3]{1}$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PROSTT5_SERVER(PARAM_PROSTT5_SERVER_ID, "--prostt5-server", "Use ProstT5 server", "Predict 3Di with a running `prostt5server` for the same model instead of loading the model", typeid(int), (void *) &prostt5Server, "^[0-1]{1}$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_PROSTT5_CACHE(PARAM_PROSTT5_CACHE_ID, "--prostt5-cache", "ProstT5 cache", "File storing 3Di predictions by sequence hash, sequences found in it are not predicted again and new predictions are added", typeid(std::string), (void *) &prostt5Cache, "^.*$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_JOINT_PREFILTER_EVALUE(PARAM_JOINT_PREFILTER_EVALUE_ID, "--joint-prefilter-evalue", "Joint prefilter E-value", "Rescore k-mer prefilter diagonals with the ungapped 3Di+AA score and drop hits above this E-value before alignment (0: off)", typeid(double), (void *) &jointPrefilterEvalue, "^([-+]?[0-9]*\\.?[0-9]+([eE][-+]?[0-9]+)?)|[0-9]*(\\.[0-9]+)?$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_SPACED_KMER_PATTERNS(PARAM_SPACED_KMER_PATTERNS_ID, "--spaced-kmer-patterns", "Additional spaced k-mer patterns", "Comma separated spaced k-mer patterns, each runs an additional k-mer prefilter whose hits are merged with the default prefilter (e.g. 1101011,11100111)", typeid(std::string), (void *) &spacedKmerPatterns, "^(1[01]*1(,1[01]*1)*)?$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_DIAGONAL_BAND(PARAM_DIAGONAL_BAND_ID, "--diagonal-band", "Diagonal band", "Align 3Di+AA within this many diagonals around the prefilter diagonal first, the full alignment is only computed if the alignment reaches the band edge (0: full alignment)", typeid(int), (void *) &diagonalBand, "^[0-9]{1}[0-9]*$", MMseqsParameter::COMMAND_ALIGN | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_EMBEDDING_INDEX(PARAM_EMBEDDING_INDEX_ID, "--embedding-index", "Embedding index", "Also create the structure embedding index used by --prefilter-mode 4", typeid(int), (void *) &embeddingIndex, "^[0-1]{1}$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_EMBEDDING_LISTS(PARAM_EMBEDDING_LISTS_ID, "--embedding-lists", "Embedding index lists", "Number of lists the embedding index clusters the database into (0: square root of the database size)", typeid(int), (void *) &embeddingLists, "^[0-9]{1}[0-9]*$", MMseqsParameter::COMMAND_EXPERT),
+        PARAM_EMBEDDING_PROBES(PARAM_EMBEDDING_PROBES_ID, "--embedding-probes", "Embedding index probes", "Number of embedding index lists closest to a query that are searched by --prefilter-mode 4", typeid(int), (void *) &embeddingProbes, "^[1-9]{1}[0-9]*$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_CASCADE_EVALUE(PARAM_CASCADE_EVALUE_ID, "--cascade-evalue", "Cascade E-value", "With --sens-steps > 1, queries with --cascade-hits hits of at most this E-value are done, only the other queries are searched again with a higher sensitivity", typeid(double), (void *) &cascadeEvalue, "^([-+]?[0-9]*\\.?[0-9]+([eE][-+]?[0-9]+)?)|[0-9]*(\\.[0-9]+)?$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_CASCADE_HITS(PARAM_CASCADE_HITS_ID, "--cascade-hits", "Cascade hits", "With --sens-steps > 1, number of hits of at most --cascade-evalue a query needs to be done after a step", typeid(int), (void *) &cascadeHits, "^[1-9]{1}[0-9]*$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_CLUSTER_SEARCH_EVALUE(PARAM_CLUSTER_SEARCH_EVALUE_ID, "--cluster-search-evalue", "Cluster search member E-value", "With --cluster-search 1, only members whose alignment composed from the query-representative and representative-member alignment has at most this E-value are realigned (0: realign all members)", typeid(double), (void *) &clusterSearchEvalue, "^([-+]?[0-9]*\\.?[0-9]+([eE][-+]?[0-9]+)?)|[0-9]*(\\.[0-9]+)?$", MMseqsParameter::COMMAND_MISC | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_COMPLEX_PREFILTER(PARAM_COMPLEX_PREFILTER_ID, "--complex-prefilter", "Complex prefilter", "Multimer prefilter:\n0: search each query chain against all target chains\n1: select the --max-seqs target complexes sharing the most sketched 3Di k-mers with each query complex (createcomplexsketch)", typeid(int), (void *) &complexPrefilter, "^[0-1]{1}$", MMseqsParameter::COMMAND_PREFILTER | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_TARGET_ORDER(PARAM_TARGET_ORDER_ID, "--target-order", "Align hits in target order", "Align the hits of a query in the order of the target database entries instead of the prefilter order to read the target databases sequentially. Only used if --max-accept and --max-rejected do not limit the hits of a query", typeid(int), (void *) &targetOrder, "^[0-1]{1}$", MMseqsParameter::COMMAND_ALIGN | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_BATCH_SCORE(PARAM_BATCH_SCORE_ID, "--batch-score", "Batch score filter", "Score hits with targets of at most 1024 residues several at a time in one SIMD pass before aligning them. Hits whose score cannot pass --e-value are rejected without alignment. Only used for substitution matrix queries", typeid(int), (void *) &batchScore, "^[0-1]{1}$", MMseqsParameter::COMMAND_ALIGN | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_QUERY_COST_ORDER(PARAM_QUERY_COST_ORDER_ID, "--query-cost-order", "Align expensive queries first", "Start the queries with the most hits times query length first so that a single expensive query does not run alone at the end", typeid(int), (void *) &queryCostOrder, "^[0-1]{1}$", MMseqsParameter::COMMAND_ALIGN | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_RBH_BEST_ONLY(PARAM_RBH_BEST_ONLY_ID, "--rbh-best-only", "Reverse search of best hits only", "Search only the target entries that are the best hit of a query entry in the reverse direction. Other target entries can not form a reciprocal best hit, but their reverse hits are no longer merged into the candidates of a query", typeid(int), (void *) &rbhBestOnly, "^[0-1]{1}$", MMseqsParameter::COMMAND_MISC | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_DESCRIPTOR_FORMAT(PARAM_DESCRIPTOR_FORMAT_ID, "--descriptor-format", "Descriptor format", "Format of the 3Di features:\n0: text in the descriptor file\n1: float32 binary in the <descriptor>_features DB", typeid(int), (void *) &descriptorFormat, "^[0-1]{1}$", MMseqsParameter::COMMAND_MISC | MMseqsParameter::COMMAND_EXPERT),
+        PARAM_GREEDY_ALIGN_CLUSTER(PARAM_GREEDY_ALIGN_CLUSTER_ID, "--greedy-align-cluster", "Greedy align and cluster", "With --cluster-mode 2 or 3, align and cluster each cascaded step in one pass (structuregreedyclust) that skips the hits of structures that already have a representative. No aln_step result is written. Only used with unlimited --max-accept and --max-rejected and without --mpi-runner", typeid(int), (void *) &greedyAlignCluster, "^[0-1]{1}$", MMseqsParameter::COMMAND_CLUST | MMseqsParameter::COMMAND_EXPERT)
         {
     PARAM_ALIGNMENT_MODE.description = "How to compute the alignment:\n0: automatic\n1: only score and end_pos\n2: also start_pos and cov\n3: also seq.id";
     PARAM_ALIGNMENT_MODE.regex = "^[0-3]{1}$";
@@ -57,17 +83,21 @@ LocalParameters::LocalParameters() :
     PARAM_TAR_INCLUDE.category = MMseqsParameter::COMMAND_EXPERT;
     PARAM_TAXON_LIST.category = MMseqsParameter::COMMAND_EXPERT;
     PARAM_ZDROP.category = MMseqsParameter::COMMAND_HIDDEN;
+    PARAM_PREF_MODE.description = "Prefilter mode:\n0: kmer/ungapped\n1: ungapped\n2: nofilter\n3: ungapped&gapped\n4: structure embedding index";
+    PARAM_PREF_MODE.regex = "^[0-4]{1}$";
 
     PARAM_FORMAT_MODE.description = "Output format:\n0: BLAST-TAB\n"
                                     "1: SAM\n2: BLAST-TAB + query/db length\n"
                                     "3: Pretty HTML\n4: BLAST-TAB + column headers\n"
                                     "5: Calpha only PDB super-posed to query\n"
-                                    "BLAST-TAB (0) and BLAST-TAB + column headers (4)"
+                                    "6: Apache Arrow IPC stream\n"
+                                    "BLAST-TAB (0), BLAST-TAB + column headers (4) and Arrow (6)"
                                     "support custom output formats (--format-output)\n"
-                                    "(5) Superposed PDB files (Calpha only)";
+                                    "(5) Superposed PDB files (Calpha only)\n"
+                                    "(6) Typed columns, zstd compressed with --compressed 1";
 
     // TODO
-    PARAM_FORMAT_MODE.regex = "^[0-5]{1}$";
+    PARAM_FORMAT_MODE.regex = "^[0-6]{1}$";
     PARAM_SEARCH_TYPE.category = MMseqsParameter::COMMAND_HIDDEN;
     PARAM_TRANSLATION_TABLE.category = MMseqsParameter::COMMAND_HIDDEN;
     PARAM_TRANSLATION_TABLE.category = MMseqsParameter::COMMAND_HIDDEN;
@@ -90,6 +120,10 @@ LocalParameters::LocalParameters() :
     // structurecreatedb
     structurecreatedb.push_back(&PARAM_GPU);
     structurecreatedb.push_back(&PARAM_PROSTT5_MODEL);
+    structurecreatedb.push_back(&PARAM_PROSTT5_SPLIT_OVERLAP);
+    structurecreatedb.push_back(&PARAM_PROSTT5_PRECISION);
+    structurecreatedb.push_back(&PARAM_PROSTT5_SERVER);
+    structurecreatedb.push_back(&PARAM_PROSTT5_CACHE);
     structurecreatedb.push_back(&PARAM_CHAIN_NAME_MODE);
     structurecreatedb.push_back(&PARAM_MODEL_NAME_MODE);
     structurecreatedb.push_back(&PARAM_DB_EXTRACTION_MODE);
@@ -103,13 +137,21 @@ LocalParameters::LocalParameters() :
     // protein chain only
     structurecreatedb.push_back(&PARAM_FILE_INCLUDE);
     structurecreatedb.push_back(&PARAM_FILE_EXCLUDE);
+    structurecreatedb.push_back(&PARAM_TAR_INDEX);
+    structurecreatedb.push_back(&PARAM_GCS_PREFETCH);
     structurecreatedb.push_back(&PARAM_THREADS);
     structurecreatedb.push_back(&PARAM_V);
 
+    // structureto3didescriptor
+    structureto3didescriptor = structurecreatedb;
+    structureto3didescriptor.push_back(&PARAM_DESCRIPTOR_FORMAT);
+
     convertalignments.push_back(&PARAM_EXACT_TMSCORE);
     convertalignments.push_back(&PARAM_PATHMAP);
 
     createindex.push_back(&PARAM_INDEX_EXCLUDE);
+    createindex.push_back(&PARAM_EMBEDDING_INDEX);
+    createindex.push_back(&PARAM_EMBEDDING_LISTS);
 
     // tmalign
     tmalign.push_back(&PARAM_MIN_SEQ_ID);
@@ -118,11 +160,14 @@ LocalParameters::LocalParameters() :
     tmalign.push_back(&PARAM_MAX_REJECTED);
     tmalign.push_back(&PARAM_MAX_ACCEPT);
     tmalign.push_back(&PARAM_ADD_BACKTRACE);
+    tmalign.push_back(&PARAM_QUERY_COST_ORDER);
     tmalign.push_back(&PARAM_INCLUDE_IDENTITY);
     tmalign.push_back(&PARAM_TMSCORE_THRESHOLD);
     tmalign.push_back(&PARAM_TMSCORE_THRESHOLD_MODE);
     tmalign.push_back(&PARAM_TMALIGN_HIT_ORDER);
     tmalign.push_back(&PARAM_TMALIGN_FAST);
+    tmalign.push_back(&PARAM_TMALIGN_SEED);
+    tmalign.push_back(&PARAM_PAIR_CACHE);
     tmalign.push_back(&PARAM_PRELOAD_MODE);
     tmalign.push_back(&PARAM_THREADS);
     tmalign.push_back(&PARAM_V);
@@ -131,6 +176,7 @@ LocalParameters::LocalParameters() :
 
     //LoLalign
     lolalign.push_back(&PARAM_MULTIDOMAIN);
+    lolalign.push_back(&PARAM_EXACT_FWBW);
     lolalign.push_back(&PARAM_MIN_SEQ_ID);
     lolalign.push_back(&PARAM_PRELOAD_MODE);
     lolalign.push_back(&PARAM_MAX_REJECTED);
@@ -138,6 +184,7 @@ LocalParameters::LocalParameters() :
     lolalign.push_back(&PARAM_C);
     lolalign.push_back(&PARAM_COV_MODE);
     lolalign.push_back(&PARAM_ADD_BACKTRACE);
+    lolalign.push_back(&PARAM_SPLIT_MEMORY_LIMIT);
     lolalign.push_back(&PARAM_THREADS);
     lolalign.push_back(&PARAM_V);
 
@@ -156,8 +203,17 @@ LocalParameters::LocalParameters() :
     structurealign.push_back(&PARAM_SORT_BY_STRUCTURE_BITS);
     structurealign.push_back(&PARAM_ALIGNMENT_TYPE);
     structurealign.push_back(&PARAM_EXACT_TMSCORE);
+    structurealign.push_back(&PARAM_DIAGONAL_BAND);
+    structurealign.push_back(&PARAM_TARGET_ORDER);
+    structurealign.push_back(&PARAM_BATCH_SCORE);
+    structurealign.push_back(&PARAM_QUERY_COST_ORDER);
     structurealign = combineList(structurealign, align);
 
+    structurelinclust = combineList(structurerescorediagonal, structurealign);
+    structurelinclust.push_back(&PARAM_CLUSTER_MODE);
+    structurelinclust.push_back(&PARAM_MAXITERATIONS);
+    structurelinclust.push_back(&PARAM_SIMILARITYSCORE);
+
     // strucclust
     strucclust = combineList(clust, structurealign);
     strucclust = combineList(strucclust, structurerescorediagonal);
@@ -189,6 +245,9 @@ LocalParameters::LocalParameters() :
     scoremultimer.push_back(&PARAM_THREADS);
     scoremultimer.push_back(&PARAM_V);
 
+    //alignmultimer
+    alignmultimer = combineList(structurealign, scoremultimer);
+
     //filtermultimer
     filtermultimer.push_back(&PARAM_C);
     filtermultimer.push_back(&PARAM_COV_MODE);
@@ -208,6 +267,55 @@ LocalParameters::LocalParameters() :
     makepaddeddb.push_back(&PARAM_V);
     makepaddeddb.push_back(&PARAM_CLUSTER_SEARCH);
 
+    // prostt5server
+    prostt5server.push_back(&PARAM_GPU);
+    prostt5server.push_back(&PARAM_THREADS);
+    prostt5server.push_back(&PARAM_V);
+
+    // createmulambda
+    createmulambda.push_back(&PARAM_SUB_MAT);
+    createmulambda.push_back(&PARAM_THREADS);
+    createmulambda.push_back(&PARAM_V);
+
+    // createembeddingindex
+    createembeddingindex.push_back(&PARAM_EMBEDDING_LISTS);
+    createembeddingindex.push_back(&PARAM_THREADS);
+    createembeddingindex.push_back(&PARAM_V);
+
+    // embeddingprefilter
+    embeddingprefilter.push_back(&PARAM_EMBEDDING_PROBES);
+    embeddingprefilter.push_back(&PARAM_MAX_SEQS);
+    embeddingprefilter.push_back(&PARAM_PRELOAD_MODE);
+    embeddingprefilter.push_back(&PARAM_THREADS);
+    embeddingprefilter.push_back(&PARAM_COMPRESSED);
+    embeddingprefilter.push_back(&PARAM_V);
+
+    // aln2tmscore
+    aln2tmscore.push_back(&PARAM_EXACT_TMSCORE);
+    aln2tmscore.push_back(&PARAM_PRELOAD_MODE);
+    aln2tmscore.push_back(&PARAM_THREADS);
+    aln2tmscore.push_back(&PARAM_COMPRESSED);
+    aln2tmscore.push_back(&PARAM_V);
+
+    // createcomplexsketch
+    createcomplexsketch.push_back(&PARAM_THREADS);
+    createcomplexsketch.push_back(&PARAM_V);
+
+    // complexprefilter
+    complexprefilter.push_back(&PARAM_MAX_SEQS);
+    complexprefilter.push_back(&PARAM_MIN_ASSIGNED_CHAINS_THRESHOLD);
+    complexprefilter.push_back(&PARAM_MONOMER_INCLUDE_MODE);
+    complexprefilter.push_back(&PARAM_PRELOAD_MODE);
+    complexprefilter.push_back(&PARAM_THREADS);
+    complexprefilter.push_back(&PARAM_COMPRESSED);
+    complexprefilter.push_back(&PARAM_V);
+
+    // mergeprefilter
+    mergeprefilter.push_back(&PARAM_MAX_SEQS);
+    mergeprefilter.push_back(&PARAM_THREADS);
+    mergeprefilter.push_back(&PARAM_COMPRESSED);
+    mergeprefilter.push_back(&PARAM_V);
+
     //result2structprofile
     result2structprofile.push_back(&PARAM_SUB_MAT);
     result2structprofile.push_back(&PARAM_E);
@@ -249,9 +357,24 @@ LocalParameters::LocalParameters() :
     createmultimerreport.push_back(&PARAM_V);
 
     // expandmultimer
+    expandmultimer.push_back(&PARAM_MIN_ASSIGNED_CHAINS_THRESHOLD);
+    expandmultimer.push_back(&PARAM_MONOMER_INCLUDE_MODE);
     expandmultimer.push_back(&PARAM_THREADS);
     expandmultimer.push_back(&PARAM_V);
 
+    // structureexpandaln
+    structureexpandaln.push_back(&PARAM_CLUSTER_SEARCH_EVALUE);
+    structureexpandaln.push_back(&PARAM_ALIGNMENT_TYPE);
+    structureexpandaln.push_back(&PARAM_SUB_MAT);
+    structureexpandaln.push_back(&PARAM_GAP_OPEN);
+    structureexpandaln.push_back(&PARAM_GAP_EXTEND);
+    structureexpandaln.push_back(&PARAM_NO_COMP_BIAS_CORR);
+    structureexpandaln.push_back(&PARAM_MAX_SEQ_LEN);
+    structureexpandaln.push_back(&PARAM_PRELOAD_MODE);
+    structureexpandaln.push_back(&PARAM_THREADS);
+    structureexpandaln.push_back(&PARAM_COMPRESSED);
+    structureexpandaln.push_back(&PARAM_V);
+
     // convert2pdb
     convert2pdb.push_back(&PARAM_PDB_OUTPUT_MODE);
     convert2pdb.push_back(&PARAM_THREADS);
@@ -261,11 +384,22 @@ LocalParameters::LocalParameters() :
     structuresearchworkflow = combineList(structurealign, prefilter);
     structuresearchworkflow = combineList(structuresearchworkflow, ungappedprefilter);
     structuresearchworkflow = combineList(structuresearchworkflow, tmalign);
+    structuresearchworkflow = removeParameter(structuresearchworkflow, PARAM_PAIR_CACHE);
     structuresearchworkflow = combineList(structuresearchworkflow, lolalign);
     structuresearchworkflow = combineList(structuresearchworkflow, result2structprofile);
     structuresearchworkflow.push_back(&PARAM_CLUSTER_SEARCH);
+    structuresearchworkflow.push_back(&PARAM_CLUSTER_SEARCH_EVALUE);
     structuresearchworkflow.push_back(&PARAM_EXHAUSTIVE_SEARCH);
+    structuresearchworkflow.push_back(&PARAM_JOINT_PREFILTER_EVALUE);
+    structuresearchworkflow.push_back(&PARAM_SPACED_KMER_PATTERNS);
+    structuresearchworkflow.push_back(&PARAM_EMBEDDING_PROBES);
+    structuresearchworkflow.push_back(&PARAM_EMBEDDING_LISTS);
+    structuresearchworkflow.push_back(&PARAM_START_SENS);
+    structuresearchworkflow.push_back(&PARAM_SENS_STEPS);
+    structuresearchworkflow.push_back(&PARAM_CASCADE_EVALUE);
+    structuresearchworkflow.push_back(&PARAM_CASCADE_HITS);
     structuresearchworkflow.push_back(&PARAM_NUM_ITERATIONS);
+    structuresearchworkflow.push_back(&PARAM_INCREMENTAL_ITERATIONS);
     structuresearchworkflow.push_back(&PARAM_REMOVE_TMP_FILES);
     structuresearchworkflow.push_back(&PARAM_REUSELATEST);
     structuresearchworkflow.push_back(&PARAM_RUNNER);
@@ -275,18 +409,30 @@ LocalParameters::LocalParameters() :
     easystructuresearchworkflow = combineList(easystructuresearchworkflow, taxonomyreport);
     easystructuresearchworkflow.push_back(&PARAM_GREEDY_BEST_HITS);
 
+    structurerbhworkflow = structuresearchworkflow;
+    structurerbhworkflow.push_back(&PARAM_RBH_BEST_ONLY);
+    easystructurerbhworkflow = easystructuresearchworkflow;
+    easystructurerbhworkflow.push_back(&PARAM_RBH_BEST_ONLY);
+
     structureclusterworkflow = combineList(prefilter, structurealign);
     structureclusterworkflow = combineList(structureclusterworkflow, structurerescorediagonal);
     structureclusterworkflow = combineList(structureclusterworkflow, tmalign);
+    // the workflow sets the pair cache of each TM-align step itself
+    structureclusterworkflow = removeParameter(structureclusterworkflow, PARAM_PAIR_CACHE);
     structureclusterworkflow = combineList(structureclusterworkflow, clust);
     structureclusterworkflow.push_back(&PARAM_CASCADED);
     structureclusterworkflow.push_back(&PARAM_CLUSTER_STEPS);
     structureclusterworkflow.push_back(&PARAM_CLUSTER_REASSIGN);
+    structureclusterworkflow.push_back(&PARAM_GREEDY_ALIGN_CLUSTER);
     structureclusterworkflow.push_back(&PARAM_REMOVE_TMP_FILES);
     structureclusterworkflow.push_back(&PARAM_REUSELATEST);
     structureclusterworkflow.push_back(&PARAM_RUNNER);
     structureclusterworkflow = combineList(structureclusterworkflow, linclustworkflow);
 
+    structureclusterupdate = combineList(structuresearchworkflow, structureclusterworkflow);
+    structureclusterupdate.push_back(&PARAM_USESEQID);
+    structureclusterupdate.push_back(&PARAM_RECOVER_DELETED);
+
     easystructureclusterworkflow = combineList(structureclusterworkflow, structurecreatedb);
     easystructureclusterworkflow = combineList(easystructureclusterworkflow, result2repseq);
 
@@ -297,12 +443,17 @@ LocalParameters::LocalParameters() :
     multimersearchworkflow.push_back(&PARAM_EXPAND_MULTIMER_EVALUE_BC_COMPAT);
     multimersearchworkflow.push_back(&PARAM_MULTIMER_REPORT_MODE);
     multimersearchworkflow.push_back(&PARAM_MULTIMER_REPORT_MODE_BC_COMPAT);
+    multimersearchworkflow.push_back(&PARAM_COMPLEX_PREFILTER);
 
     // easymultimersearchworkflow
     easymultimersearchworkflow = combineList(structurecreatedb, multimersearchworkflow);
     easymultimersearchworkflow = combineList(easymultimersearchworkflow, convertalignments);
     easymultimersearchworkflow = combineList(easymultimersearchworkflow, createmultimerreport);
     easymultimersearchworkflow = removeParameter(easymultimersearchworkflow, PARAM_PROSTT5_MODEL);
+    easymultimersearchworkflow = removeParameter(easymultimersearchworkflow, PARAM_PROSTT5_SPLIT_OVERLAP);
+    easymultimersearchworkflow = removeParameter(easymultimersearchworkflow, PARAM_PROSTT5_PRECISION);
+    easymultimersearchworkflow = removeParameter(easymultimersearchworkflow, PARAM_PROSTT5_SERVER);
+    easymultimersearchworkflow = removeParameter(easymultimersearchworkflow, PARAM_PROSTT5_CACHE);
 
     // multimerclusterworkflow
     multimerclusterworkflow = combineList(multimersearchworkflow, filtermultimer);
@@ -328,9 +479,17 @@ LocalParameters::LocalParameters() :
     fileInclude = ".*";
     fileExclude = "^$";
     prostt5SplitLength = 1024;
+    prostt5SplitOverlap = 0;
+    prostt5Precision = PROSTT5_PRECISION_F16;
+    prostt5Server = 0;
+    prostt5Cache = "";
+    jointPrefilterEvalue = 0.0;
+    spacedKmerPatterns = "";
     prostt5Model = "";
     hashEntryNames = 0;
     pathmapFile = "";
+    tarIndex = 0;
+    gcsPrefetch = 4;
 
     // search parameter
     alignmentType = ALIGNMENT_TYPE_3DI_AA;
@@ -341,11 +500,29 @@ LocalParameters::LocalParameters() :
     evalThr = 10;
     sortByStructureBits = 1;
     clusterSearch = 0;
+    incrementalIterations = 0;
     minDiagScoreThr = 30;
     minAssignedChainsThreshold = 0.0;
     monomerIncludeMode = 0;
     tmAlignFast = 1;
+    tmAlignSeed = 0;
+    pairCache = "";
     exactTMscore = 0;
+    diagonalBand = 0;
+    embeddingIndex = 0;
+    embeddingLists = 0;
+    embeddingProbes = 16;
+    cascadeEvalue = 0.001;
+    cascadeHits = 1;
+    clusterSearchEvalue = 0.0;
+    complexPrefilter = 0;
+    targetOrder = 0;
+    batchScore = 0;
+    queryCostOrder = 0;
+    rbhBestOnly = 0;
+    descriptorFormat = DESCRIPTOR_FORMAT_TEXT;
+    greedyAlignCluster = 0;
+    exactFwbw = 1;
     gapOpen = 10;
     gapExtend = 1;
     nsample = 5000;
@@ -441,7 +618,7 @@ std::vector<int> LocalParameters::getOutputFormat(
         else if (outformatSplit[i].compare("empty") == 0){ code = Parameters::OUTFMT_EMPTY;}
         else if (outformatSplit[i].compare("lddt") == 0) { needQCa = true; needTCa = true; needLDDT = true; needBacktrace = true; code = LocalParameters::OUTFMT_LDDT; }
         else if (outformatSplit[i].compare("lddtfull") == 0) { needQCa = true; needTCa = true; needLDDT = true; needBacktrace = true; code = LocalParameters::OUTFMT_LDDT_FULL; }
-        else if (outformatSplit[i].compare("prob") == 0) { needQCa = true; needTCa = true; needLDDT = true; needBacktrace = true; needTMaligner = true; code = LocalParameters::OUTFMT_PROBTP; }
+        else if (outformatSplit[i].compare("prob") == 0) { code = LocalParameters::OUTFMT_PROBTP; }
         // TODO
         else if (outformatSplit[i].compare("complexqtmscore")==0 || outformatSplit[i].compare("multimerqtmscore")==0){code=LocalParameters::OUTFMT_Q_COMPLEX_TMSCORE; }
         else if (outformatSplit[i].compare("complexttmscore")==0 || outformatSplit[i].compare("multimerttmscore")==0){code=LocalParameters::OUTFMT_T_COMPLEX_TMSCORE;}
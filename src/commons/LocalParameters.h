@@ -74,16 +74,24 @@ public:
     static const int OUTFMT_Q3DIALN = 60;
     static const int OUTFMT_T3DIALN = 61;
 
+    static const int PROSTT5_PRECISION_AUTO = 0;
+    static const int PROSTT5_PRECISION_F16 = 1;
+    static const int PROSTT5_PRECISION_Q8_0 = 2;
+    static const int PROSTT5_PRECISION_Q4_0 = 3;
+
     static const int DB_EXTRACT_MODE_CHAIN = 0;
     static const int DB_EXTRACT_MODE_INTERFACE = 1;
 
     static const int COORD_STORE_MODE_CA_FLOAT = 1;
     static const int COORD_STORE_MODE_CA_DIFF  = 2;
     static const int COORD_STORE_MODE_CA_PLAIN_TEXT  = 3;
+    static const int COORD_STORE_MODE_CA_ALIGNED  = 4;
 
     static const unsigned int INDEX_DB_CA_KEY_DB1 = 500;
     static const unsigned int INDEX_DB_CA_KEY_DB2 = 502;
 
+    static const int PREF_MODE_EMBEDDING = 4;
+
     static const int INDEX_EXCLUDE_NONE = 0;
     static const int INDEX_EXCLUDE_KMER_INDEX = 1 << 0;
     static const int INDEX_EXCLUDE_CA = 1 << 1;
@@ -93,6 +101,10 @@ public:
     static const int PDB_OUTPUT_MODE_SINGLECHAIN = 1;
     static const int PDB_OUTPUT_MODE_COMPLEX = 2;
 
+    // structureto3didescriptor
+    static const int DESCRIPTOR_FORMAT_TEXT = 0;
+    static const int DESCRIPTOR_FORMAT_BINARY = 1;
+
     // filter mode
     // static const int FILTER_MODE_INTERFACE  = 0;
     // static const int FILTER_MODE_CONFORMATION = 1;
@@ -100,19 +112,27 @@ public:
 
     // TODO
     static const unsigned int FORMAT_ALIGNMENT_PDB_SUPERPOSED = 5;
+    static const unsigned int FORMAT_ALIGNMENT_ARROW = 6;
     std::vector<MMseqsParameter *> strucclust;
     std::vector<MMseqsParameter *> tmalign;
+    std::vector<MMseqsParameter *> aln2tmscore;
     std::vector<MMseqsParameter *> structurealign;
     std::vector<MMseqsParameter *> structurerescorediagonal;
+    std::vector<MMseqsParameter *> structurelinclust;
     std::vector<MMseqsParameter *> structuresearchworkflow;
     std::vector<MMseqsParameter *> structureclusterworkflow;
+    std::vector<MMseqsParameter *> structureclusterupdate;
     std::vector<MMseqsParameter *> databases;
     std::vector<MMseqsParameter *> samplemulambda;
     std::vector<MMseqsParameter *> easystructuresearchworkflow;
+    std::vector<MMseqsParameter *> structurerbhworkflow;
+    std::vector<MMseqsParameter *> easystructurerbhworkflow;
     std::vector<MMseqsParameter *> easystructureclusterworkflow;
     std::vector<MMseqsParameter *> structurecreatedb;
+    std::vector<MMseqsParameter *> structureto3didescriptor;
     std::vector<MMseqsParameter *> compressca;
     std::vector<MMseqsParameter *> scoremultimer;
+    std::vector<MMseqsParameter *> alignmultimer;
     std::vector<MMseqsParameter *> filtermultimer;
     std::vector<MMseqsParameter *> multimerclusterworkflow;
     std::vector<MMseqsParameter *> easymultimerclusterworkflow;
@@ -120,8 +140,16 @@ public:
     std::vector<MMseqsParameter *> easymultimersearchworkflow;
     std::vector<MMseqsParameter *> createmultimerreport;
     std::vector<MMseqsParameter *> expandmultimer;
+    std::vector<MMseqsParameter *> structureexpandaln;
     std::vector<MMseqsParameter *> convert2pdb;
     std::vector<MMseqsParameter *> makepaddeddb;
+    std::vector<MMseqsParameter *> prostt5server;
+    std::vector<MMseqsParameter *> createmulambda;
+    std::vector<MMseqsParameter *> mergeprefilter;
+    std::vector<MMseqsParameter *> createembeddingindex;
+    std::vector<MMseqsParameter *> embeddingprefilter;
+    std::vector<MMseqsParameter *> createcomplexsketch;
+    std::vector<MMseqsParameter *> complexprefilter;
     std::vector<MMseqsParameter *> result2structprofile;
     std::vector<MMseqsParameter *> createstructsubdb;
     std::vector<MMseqsParameter *> lolalign;
@@ -137,12 +165,16 @@ public:
     PARAMETER(PARAM_MODEL_NAME_MODE)
     PARAMETER(PARAM_WRITE_MAPPING)
     PARAMETER(PARAM_TMALIGN_FAST)
+    PARAMETER(PARAM_TMALIGN_SEED)
+    PARAMETER(PARAM_PAIR_CACHE)
     PARAMETER(PARAM_EXACT_TMSCORE)
+    PARAMETER(PARAM_EXACT_FWBW)
     PARAMETER(PARAM_N_SAMPLE)
     PARAMETER(PARAM_COORD_STORE_MODE)
     PARAMETER(PARAM_MIN_ASSIGNED_CHAINS_THRESHOLD)
     PARAMETER(PARAM_MONOMER_INCLUDE_MODE)
     PARAMETER(PARAM_CLUSTER_SEARCH)
+    PARAMETER(PARAM_INCREMENTAL_ITERATIONS)
     PARAMETER(PARAM_FILE_INCLUDE)
     PARAMETER(PARAM_FILE_EXCLUDE)
     PARAMETER(PARAM_INDEX_EXCLUDE)
@@ -161,6 +193,28 @@ public:
     PARAMETER(PARAM_MULTIDOMAIN)
     PARAMETER(PARAM_HASH_ENTRY_NAMES)
     PARAMETER(PARAM_PATHMAP)
+    PARAMETER(PARAM_TAR_INDEX)
+    PARAMETER(PARAM_GCS_PREFETCH)
+    PARAMETER(PARAM_PROSTT5_SPLIT_OVERLAP)
+    PARAMETER(PARAM_PROSTT5_PRECISION)
+    PARAMETER(PARAM_PROSTT5_SERVER)
+    PARAMETER(PARAM_PROSTT5_CACHE)
+    PARAMETER(PARAM_JOINT_PREFILTER_EVALUE)
+    PARAMETER(PARAM_SPACED_KMER_PATTERNS)
+    PARAMETER(PARAM_DIAGONAL_BAND)
+    PARAMETER(PARAM_EMBEDDING_INDEX)
+    PARAMETER(PARAM_EMBEDDING_LISTS)
+    PARAMETER(PARAM_EMBEDDING_PROBES)
+    PARAMETER(PARAM_CASCADE_EVALUE)
+    PARAMETER(PARAM_CASCADE_HITS)
+    PARAMETER(PARAM_CLUSTER_SEARCH_EVALUE)
+    PARAMETER(PARAM_COMPLEX_PREFILTER)
+    PARAMETER(PARAM_TARGET_ORDER)
+    PARAMETER(PARAM_BATCH_SCORE)
+    PARAMETER(PARAM_QUERY_COST_ORDER)
+    PARAMETER(PARAM_RBH_BEST_ONLY)
+    PARAMETER(PARAM_DESCRIPTOR_FORMAT)
+    PARAMETER(PARAM_GREEDY_ALIGN_CLUSTER)
 
     float tmScoreThr;
     int tmScoreThrMode;
@@ -173,12 +227,16 @@ public:
     int modelNameMode;
     bool writeMapping;
     int tmAlignFast;
+    int tmAlignSeed;
+    std::string pairCache;
     int exactTMscore;
+    int exactFwbw;
     int nsample;
     int coordStoreMode;
     float minAssignedChainsThreshold;
     int monomerIncludeMode;
     int clusterSearch;
+    int incrementalIterations;
     std::string fileInclude;
     std::string fileExclude;
     int indexExclude;
@@ -193,8 +251,30 @@ public:
     int dbExtractionMode;
     float distanceThreshold;
     int prostt5SplitLength;
+    int prostt5SplitOverlap;
+    int prostt5Precision;
+    int prostt5Server;
+    std::string prostt5Cache;
+    double jointPrefilterEvalue;
+    std::string spacedKmerPatterns;
+    int diagonalBand;
+    int embeddingIndex;
+    int embeddingLists;
+    int embeddingProbes;
+    double cascadeEvalue;
+    int cascadeHits;
+    double clusterSearchEvalue;
+    int complexPrefilter;
+    int targetOrder;
+    int batchScore;
+    int queryCostOrder;
+    int rbhBestOnly;
+    int descriptorFormat;
+    int greedyAlignCluster;
     int multiDomain;
     int hashEntryNames;
+    int tarIndex;
+    int gcsPrefetch;
     std::string pathmapFile;
 
     static std::vector<int> getOutputFormat(
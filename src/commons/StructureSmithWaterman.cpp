@@ -33,6 +33,7 @@ SOFTWARE.
 #include "../strucclustutils/EvalueNeuralNet.h"
 #include "block_aligner.h"
 #include <iostream>
+#include <algorithm>
 
 StructureSmithWaterman::StructureSmithWaterman(size_t maxSequenceLength, int aaSize,
                                                bool aaBiasCorrection, float aaBiasCorrectionScale,
@@ -48,6 +49,24 @@ StructureSmithWaterman::StructureSmithWaterman(size_t maxSequenceLength, int aaS
     vHLoad  = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
     vE      = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
     vHmax   = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
+    resumeScratch = new int32_t[3 * (maxSequenceLength + VECSIZE_INT * 2)];
+    wordTerminateColumn = -1;
+    wordTerminateH = NULL;
+    wordTerminateMax = 0;
+    wordTerminateEndRef = 0;
+    vHStoreRev = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
+    vHLoadRev  = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
+    vERev      = (simd_int*) mem_align(ALIGN_INT, segSize * sizeof(simd_int));
+    maxLetterScoreAA  = new int16_t[aaSize];
+    maxLetterScore3Di = new int16_t[aaSize];
+    remainingScoreBound = new uint32_t[maxSequenceLength + 1];
+    profile_aa_fused_word  = (simd_int*) mem_align(ALIGN_INT, 2 * aaSize * segSize * sizeof(simd_int));
+    profile_3di_fused_word = (simd_int*) mem_align(ALIGN_INT, 2 * aaSize * segSize * sizeof(simd_int));
+    vBatchH      = (simd_int*) mem_align(ALIGN_INT, (maxSequenceLength + 1) * sizeof(simd_int));
+    vBatchE      = (simd_int*) mem_align(ALIGN_INT, (maxSequenceLength + 1) * sizeof(simd_int));
+    vBatchBias   = (simd_int*) mem_align(ALIGN_INT, (maxSequenceLength + 1) * sizeof(simd_int));
+    vBatchScoreAA  = (simd_int*) mem_align(ALIGN_INT, aaSize * sizeof(simd_int));
+    vBatchScore3Di = (simd_int*) mem_align(ALIGN_INT, aaSize * sizeof(simd_int));
     profile = new s_profile();
     profile->profile_aa_byte = (simd_int*)mem_align(ALIGN_INT, aaSize * segSize * sizeof(simd_int));
     profile->profile_aa_word = (simd_int*)mem_align(ALIGN_INT, aaSize * segSize * sizeof(simd_int));
@@ -126,6 +145,38 @@ StructureSmithWaterman::StructureSmithWaterman(size_t maxSequenceLength, int aaS
     memset(profile->composition_bias_aa_rev, 0, maxSequenceLength * sizeof(int8_t));
     memset(profile->composition_bias_ss_rev, 0, maxSequenceLength * sizeof(int8_t));
     block = block_new_aa_trace_xdrop(maxSequenceLength, maxSequenceLength, 4096);
+    blockQueryAA = block_new_padded_aa(maxSequenceLength, 4096);
+    blockQuery3Di = block_new_padded_aa(maxSequenceLength, 4096);
+    blockQueryBias = block_new_pos_bias(maxSequenceLength, 4096);
+    blockTargetAA = block_new_padded_aa(maxSequenceLength, 4096);
+    blockTarget3Di = block_new_padded_aa(maxSequenceLength, 4096);
+    blockTargetBias = block_new_pos_bias(maxSequenceLength, 4096);
+    blockCigar = block_new_cigar(maxSequenceLength, maxSequenceLength);
+    blockQueryBiasRev = new int16_t[maxSequenceLength];
+    blockTargetBiasZero = new int16_t[maxSequenceLength];
+    memset(blockTargetBiasZero, 0, maxSequenceLength * sizeof(int16_t));
+    blockQueryAARev.reserve(maxSequenceLength);
+    blockQuery3DiRev.reserve(maxSequenceLength);
+    blockTargetAARev.reserve(maxSequenceLength);
+    blockTarget3DiRev.reserve(maxSequenceLength);
+    blockMatrixAA = NULL;
+    blockMatrix3Di = NULL;
+    if (subMatAA != NULL && subMat3Di != NULL) {
+        blockMatrixAA = block_new_simple_aamatrix(1, -1);
+        for (int aa1 = 0; aa1 < subMatAA->alphabetSize; aa1++) {
+            for (int aa2 = 0; aa2 < subMatAA->alphabetSize; aa2++) {
+                block_set_aamatrix(blockMatrixAA, subMatAA->num2aa[aa1], subMatAA->num2aa[aa2],
+                                   subMatAA->subMatrix[aa1][aa2]);
+            }
+        }
+        blockMatrix3Di = block_new_simple_aamatrix(1, -1);
+        for (int aa1 = 0; aa1 < subMat3Di->alphabetSize; aa1++) {
+            for (int aa2 = 0; aa2 < subMat3Di->alphabetSize; aa2++) {
+                block_set_aamatrix(blockMatrix3Di, subMat3Di->num2aa[aa1], subMat3Di->num2aa[aa2],
+                                   subMat3Di->subMatrix[aa1][aa2]);
+            }
+        }
+    }
 }
 
 StructureSmithWaterman::~StructureSmithWaterman(){
@@ -133,6 +184,20 @@ StructureSmithWaterman::~StructureSmithWaterman(){
     free(vHLoad);
     free(vE);
     free(vHmax);
+    delete [] resumeScratch;
+    free(vHStoreRev);
+    free(vHLoadRev);
+    free(vERev);
+    delete [] maxLetterScoreAA;
+    delete [] maxLetterScore3Di;
+    delete [] remainingScoreBound;
+    free(profile_aa_fused_word);
+    free(profile_3di_fused_word);
+    free(vBatchH);
+    free(vBatchE);
+    free(vBatchBias);
+    free(vBatchScoreAA);
+    free(vBatchScore3Di);
     free(profile->profile_aa_byte);
     free(profile->profile_aa_word);
     free(profile->profile_aa_int);
@@ -197,6 +262,21 @@ StructureSmithWaterman::~StructureSmithWaterman(){
     delete [] maxColumn;
     delete profile;
     block_free_aa_trace_xdrop(block);
+    block_free_padded_aa(blockQueryAA);
+    block_free_padded_aa(blockQuery3Di);
+    block_free_pos_bias(blockQueryBias);
+    block_free_padded_aa(blockTargetAA);
+    block_free_padded_aa(blockTarget3Di);
+    block_free_pos_bias(blockTargetBias);
+    block_free_cigar(blockCigar);
+    if (blockMatrixAA != NULL) {
+        block_free_aamatrix(blockMatrixAA);
+    }
+    if (blockMatrix3Di != NULL) {
+        block_free_aamatrix(blockMatrix3Di);
+    }
+    delete [] blockQueryBiasRev;
+    delete [] blockTargetBiasZero;
 }
 
 
@@ -297,19 +377,29 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignScoreEndPos (
                                               profile->profile_gDelOpen_word, profile->profile_gDelClose_word, profile->profile_gIns_word,
 #endif
                                               profile->profile_aa_word,
-                                              profile->profile_3di_word, USHRT_MAX, maskLen);
+                                              profile->profile_3di_word, WORD_RESUME_BOUND, maskLen);
 
-        } else {
+        } else if (profile->aaScoring) {
             bests = sw_sse2_word<SUBSTITUTIONMATRIX>(db_aa_sequence, db_3di_sequence, 0, db_length, query_length,
                                                      gap_open, gap_extend,
 #ifdef GAP_POS_SCORING
                                                      NULL, NULL, NULL,
 #endif
                                                      profile->profile_aa_word,
-                                                     profile->profile_3di_word, USHRT_MAX, maskLen);
+                                                     profile->profile_3di_word, WORD_RESUME_BOUND, maskLen);
+        } else {
+            bests = sw_sse2_word<SUBSTITUTIONMATRIX, false>(db_aa_sequence, db_3di_sequence, 0, db_length, query_length,
+                                                            gap_open, gap_extend,
+#ifdef GAP_POS_SCORING
+                                                            NULL, NULL, NULL,
+#endif
+                                                            profile->profile_aa_word,
+                                                            profile->profile_3di_word, WORD_RESUME_BOUND, maskLen);
         }
 
-        if (bests.first.score == INT16_MAX) {
+        // the word pass stops before it can saturate, the int pass continues from the last complete column
+        if (wordTerminateColumn >= 0 || bests.first.score == INT16_MAX) {
+            const int32_t resumeColumn = wordTerminateColumn;
             r.word = 2;
             if(profile->isProfile) {
                 bests = sw_sse2_int<profile_type>(
@@ -319,7 +409,7 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignScoreEndPos (
                     profile->profile_gDelOpen_int, profile->profile_gDelClose_int, profile->profile_gIns_int,
 #endif
                     profile->profile_aa_int,
-                    profile->profile_3di_int, UINT32_MAX, maskLen
+                    profile->profile_3di_int, UINT32_MAX, maskLen, resumeColumn
                 );
             } else {
                 bests = sw_sse2_int<SUBSTITUTIONMATRIX>(
@@ -329,7 +419,7 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignScoreEndPos (
                     NULL, NULL, NULL,
 #endif
                     profile->profile_aa_int,
-                    profile->profile_3di_int, UINT32_MAX, maskLen
+                    profile->profile_3di_int, UINT32_MAX, maskLen, resumeColumn
                 );
             }
         }
@@ -365,6 +455,201 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignScoreEndPos<Structu
 template
 StructureSmithWaterman::s_align StructureSmithWaterman::alignScoreEndPos<StructureSmithWaterman::PROFILE_HMM>(const unsigned char*, const unsigned char*, int32_t, const uint8_t, const uint8_t, const int32_t);
 
+void StructureSmithWaterman::initFusedProfile(const StructureSmithWaterman & reverse) {
+    const int32_t segLen = (profile->query_length + VECSIZE_INT * 2 - 1) / (VECSIZE_INT * 2);
+    const int32_t profileLen = profile->alphabetSize * segLen;
+    for (int32_t k = 0; k < profileLen; k++) {
+        profile_aa_fused_word[2 * k]      = profile->profile_aa_word[k];
+        profile_aa_fused_word[2 * k + 1]  = reverse.profile->profile_aa_word[k];
+        profile_3di_fused_word[2 * k]     = profile->profile_3di_word[k];
+        profile_3di_fused_word[2 * k + 1] = reverse.profile->profile_3di_word[k];
+    }
+    const int32_t rowLen = segLen * VECSIZE_INT * 2;
+    for (int32_t a = 0; a < profile->alphabetSize; a++) {
+        const int16_t * rowAA = (const int16_t *) (profile->profile_aa_word + a * segLen);
+        const int16_t * row3Di = (const int16_t *) (profile->profile_3di_word + a * segLen);
+        int16_t maxAA = 0;
+        int16_t max3Di = 0;
+        for (int32_t k = 0; k < rowLen; k++) {
+            maxAA = std::max(maxAA, rowAA[k]);
+            max3Di = std::max(max3Di, row3Di[k]);
+        }
+        maxLetterScoreAA[a] = maxAA;
+        maxLetterScore3Di[a] = max3Di;
+    }
+}
+
+template <unsigned int profile_type>
+StructureSmithWaterman::s_align StructureSmithWaterman::alignScoreEndPosFused (
+        StructureSmithWaterman & reverse,
+        const unsigned char *db_aa_sequence,
+        const unsigned char *db_3di_sequence,
+        int32_t db_length,
+        const uint8_t gap_open,
+        const uint8_t gap_extend,
+        const int32_t maskLen,
+        uint32_t & revScore,
+        const uint32_t minScore) {
+#ifdef GAP_POS_SCORING
+    // position specific gap penalties are not interleaved
+    if (profile->isProfile) {
+        revScore = reverse.alignScoreEndPos<profile_type>(db_aa_sequence, db_3di_sequence, db_length, gap_open, gap_extend, maskLen).score1;
+        return alignScoreEndPos<profile_type>(db_aa_sequence, db_3di_sequence, db_length, gap_open, gap_extend, maskLen);
+    }
+#endif
+    int32_t query_length = profile->query_length;
+    uint16_t revMax = 0;
+    std::pair<alignment_end, alignment_end> bests;
+    if (profile->aaScoring || reverse.profile->aaScoring) {
+        bests = sw_sse2_word_fused<true>(db_aa_sequence, db_3di_sequence, db_length, query_length,
+                                         gap_open, gap_extend, profile_aa_fused_word, profile_3di_fused_word,
+                                         maskLen, revMax, std::min(minScore, (uint32_t) INT16_MAX));
+    } else {
+        bests = sw_sse2_word_fused<false>(db_aa_sequence, db_3di_sequence, db_length, query_length,
+                                          gap_open, gap_extend, profile_aa_fused_word, profile_3di_fused_word,
+                                          maskLen, revMax, std::min(minScore, (uint32_t) INT16_MAX));
+    }
+    s_align r;
+    // the score bound could not be reached
+    if (bests.first.ref == -1) {
+        revScore = 0;
+        r.word = 1;
+        r.score1 = 0;
+        r.score2 = 0;
+        r.ref_end2 = -1;
+        r.dbStartPos1 = -1;
+        r.dbEndPos1 = -1;
+        r.qStartPos1 = -1;
+        r.qEndPos1 = -1;
+        r.cigar = 0;
+        r.cigarLen = 0;
+        r.qCov = 0.0f;
+        r.tCov = 0.0f;
+        return r;
+    }
+    // word overflow, rescore both directions with the int kernel
+    if (bests.first.score == INT16_MAX || revMax == INT16_MAX) {
+        revScore = reverse.alignScoreEndPos<profile_type>(db_aa_sequence, db_3di_sequence, db_length, gap_open, gap_extend, maskLen).score1;
+        return alignScoreEndPos<profile_type>(db_aa_sequence, db_3di_sequence, db_length, gap_open, gap_extend, maskLen);
+    }
+    revScore = revMax;
+
+    r.word = 1;
+    r.dbStartPos1 = -1;
+    r.qStartPos1 = -1;
+    r.cigar = 0;
+    r.cigarLen = 0;
+    r.score1 = bests.first.score;
+    r.dbEndPos1 = bests.first.ref;
+    r.qEndPos1 = bests.first.read;
+    if (maskLen >= 15) {
+        r.score2 = bests.second.score;
+        r.ref_end2 = bests.second.ref;
+    } else {
+        r.score2 = 0;
+        r.ref_end2 = -1;
+    }
+    // no residue could be aligned
+    if (r.dbEndPos1 == -1) {
+        return r;
+    }
+    r.qCov = computeCov(0, r.qEndPos1, query_length);
+    r.tCov = computeCov(0, r.dbEndPos1, db_length);
+    return r;
+}
+
+template
+StructureSmithWaterman::s_align StructureSmithWaterman::alignScoreEndPosFused<StructureSmithWaterman::PROFILE>(StructureSmithWaterman&, const unsigned char*, const unsigned char*, int32_t, const uint8_t, const uint8_t, const int32_t, uint32_t&, const uint32_t);
+template
+StructureSmithWaterman::s_align StructureSmithWaterman::alignScoreEndPosFused<StructureSmithWaterman::PROFILE_HMM>(StructureSmithWaterman&, const unsigned char*, const unsigned char*, int32_t, const uint8_t, const uint8_t, const int32_t, uint32_t&, const uint32_t);
+
+void StructureSmithWaterman::alignScoreBatch(
+        const unsigned char **db_aa_sequences,
+        const unsigned char **db_3di_sequences,
+        const int32_t *db_lengths,
+        size_t batchSize,
+        const uint8_t gap_open,
+        const uint8_t gap_extend,
+        uint32_t *scores) {
+    // lanes without a target (or past the end of their target) get this score, so they never leave zero
+    const int16_t padScore = -1000;
+    const size_t lanes = getBatchSize();
+    const int32_t query_length = profile->query_length;
+    const int32_t alphabetSize = profile->alphabetSize;
+    int32_t maxDbLength = 0;
+    for (size_t k = 0; k < batchSize; k++) {
+        maxDbLength = std::max(maxDbLength, db_lengths[k]);
+    }
+
+    for (int32_t i = 0; i < query_length; i++) {
+        vBatchBias[i] = simdi16_set(profile->composition_bias_aa[i] + profile->composition_bias_ss[i]);
+    }
+    memset(vBatchH, 0, query_length * sizeof(simd_int));
+    memset(vBatchE, 0, query_length * sizeof(simd_int));
+
+    const simd_int vZero = simdi_setzero();
+    const simd_int vGapO = simdi16_set(gap_open);
+    const simd_int vGapE = simdi16_set(gap_extend);
+    simd_int vMaxScore = vZero;
+    int16_t *scoreAA = (int16_t *) vBatchScoreAA;
+    int16_t *score3Di = (int16_t *) vBatchScore3Di;
+    const int8_t *queryAA = profile->query_aa_sequence;
+    const int8_t *query3Di = profile->query_3di_sequence;
+    // an all zero amino acid matrix contributes nothing, the padding of the 3Di scores alone keeps empty lanes at zero
+    const bool aaScoring = profile->aaScoring;
+    for (int32_t j = 0; j < maxDbLength; j++) {
+        // substitution scores of target column j against every query letter, one lane per target
+        for (size_t k = 0; k < lanes; k++) {
+            if (k < batchSize && j < db_lengths[k]) {
+                const int8_t *mat3DiRow = profile->mat_3di + db_3di_sequences[k][j] * alphabetSize;
+                for (int32_t a = 0; a < alphabetSize; a++) {
+                    score3Di[a * lanes + k] = mat3DiRow[a];
+                }
+                if (aaScoring) {
+                    const int8_t *matAARow = profile->mat_aa + db_aa_sequences[k][j] * alphabetSize;
+                    for (int32_t a = 0; a < alphabetSize; a++) {
+                        scoreAA[a * lanes + k] = matAARow[a];
+                    }
+                }
+            } else {
+                for (int32_t a = 0; a < alphabetSize; a++) {
+                    scoreAA[a * lanes + k] = padScore;
+                    score3Di[a * lanes + k] = padScore;
+                }
+            }
+        }
+
+        simd_int vF = vZero;
+        simd_int vHDiag = vZero;
+        simd_int vHUp = vZero;
+        for (int32_t i = 0; LIKELY(i < query_length); i++) {
+            simd_int vHLeft = simdi_load(vBatchH + i);
+            simd_int score = simdi_load(vBatchScore3Di + query3Di[i]);
+            if (aaScoring) {
+                score = simdi16_adds(score, simdi_load(vBatchScoreAA + queryAA[i]));
+            }
+            score = simdi16_adds(score, simdi_load(vBatchBias + i));
+            simd_int vH = simdi16_adds(vHDiag, score);
+            /* saturation arithmetic, E and F are >= 0 and therefore H is >= 0 */
+            simd_int e = simdi16_max(simdui16_subs(simdi_load(vBatchE + i), vGapE), simdui16_subs(vHLeft, vGapO));
+            vF = simdi16_max(simdui16_subs(vF, vGapE), simdui16_subs(vHUp, vGapO));
+            vH = simdi16_max(vH, e);
+            vH = simdi16_max(vH, vF);
+            vMaxScore = simdi16_max(vMaxScore, vH);
+            simdi_store(vBatchE + i, e);
+            simdi_store(vBatchH + i, vH);
+            vHDiag = vHLeft;
+            vHUp = vH;
+        }
+    }
+
+    int16_t *maxScores = (int16_t *) vBatchBias;
+    simdi_store(vBatchBias, vMaxScore);
+    for (size_t k = 0; k < batchSize; k++) {
+        scores[k] = (maxScores[k] == INT16_MAX) ? UINT32_MAX : static_cast<uint32_t>(maxScores[k]);
+    }
+}
+
 StructureSmithWaterman::s_align StructureSmithWaterman::alignStartPosBacktraceBlock(
         const unsigned char *db_aa_sequence,
         const unsigned char *db_3di_sequence,
@@ -375,77 +660,33 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignStartPosBacktraceBl
         StructureSmithWaterman::s_align r) {
 #define MAX_SIZE 4096 //TODO
     size_t query_len = profile->query_length;
-    size_t target_len = db_length;
     Gaps gaps;
     gaps.open   = -gap_open;
     gaps.extend = -gap_extend;
     int32_t target_score = r.score1;
 
-    // note: instead of query_len or target_len, it is possible to use query_aa really large length
-    // and reuse data structures to avoid allocations
-    PaddedBytes* query_aa = block_new_padded_aa(query_len, MAX_SIZE);
-    PaddedBytes* query_3di = block_new_padded_aa(query_len, MAX_SIZE);
-    PosBias* query_bias = block_new_pos_bias(query_len, MAX_SIZE);
-    PaddedBytes* target_aa = block_new_padded_aa(target_len, MAX_SIZE);
-    PaddedBytes* target_3di = block_new_padded_aa(target_len, MAX_SIZE);
-    PosBias* target_bias = block_new_pos_bias(target_len, MAX_SIZE);
-
+    // the reversed query suffix ending at qEndPos1 starts at queryStartPos in the per query buffers
     int32_t queryStartPos = query_len - (r.qEndPos1 + 1);
     int32_t queryAlnLen = r.qEndPos1 + 1;
-    // convert query_aa_rev_sequence to ascii
-    std::string query_aa_sequence_str;
-    std::string query_3di_sequence_str;
-    int16_t * query_bias_arr = new int16_t[queryAlnLen];
-    for(int i = 0; i < queryAlnLen; i++){
-        query_aa_sequence_str.push_back(subMatAA->num2aa[profile->query_aa_rev_sequence[queryStartPos + i]]);
-        query_3di_sequence_str.push_back(subMat3Di->num2aa[profile->query_3di_rev_sequence[queryStartPos + i]]);
-        query_bias_arr[i] =  profile->composition_bias_aa_rev[queryStartPos + i] +
-                             profile->composition_bias_ss_rev[queryStartPos + i];
-    }
-
-
-    block_set_bytes_padded_aa(query_aa,  (const uint8_t*) query_aa_sequence_str.data(), queryAlnLen, MAX_SIZE);
-    block_set_bytes_padded_aa(query_3di, (const uint8_t*) query_3di_sequence_str.data(), queryAlnLen, MAX_SIZE);
-
-    block_set_pos_bias(query_bias, query_bias_arr, queryAlnLen);
+    const char * query_aa_sequence_str = blockQueryAARev.data() + queryStartPos;
+    block_set_bytes_padded_aa(blockQueryAA,  (const uint8_t*) query_aa_sequence_str, queryAlnLen, MAX_SIZE);
+    block_set_bytes_padded_aa(blockQuery3Di, (const uint8_t*) blockQuery3DiRev.data() + queryStartPos, queryAlnLen, MAX_SIZE);
+    block_set_pos_bias(blockQueryBias, blockQueryBiasRev + queryStartPos, queryAlnLen);
 
     int32_t targetAlnLen = r.dbEndPos1 + 1;
-    std::string db_aa_sequence_str;
-    std::string db_3di_sequence_str;
+    std::string & db_aa_sequence_str = blockTargetAARev;
+    std::string & db_3di_sequence_str = blockTarget3DiRev;
+    db_aa_sequence_str.clear();
+    db_3di_sequence_str.clear();
     // copy this db_aa_sequence,db_aa_sequence + r.dbEndPos1 + 1 in reverse order to db_aa_sequence_str and mappping to ascii using subMatAA->num2aa
     for(int i = targetAlnLen - 1; i >= 0; i--){
         db_aa_sequence_str.push_back(subMatAA->num2aa[db_aa_sequence[i]]);
         db_3di_sequence_str.push_back(subMat3Di->num2aa[db_3di_sequence[i]]);
     }
-    block_set_bytes_padded_aa(target_aa, (const uint8_t*) db_aa_sequence_str.data(), targetAlnLen, MAX_SIZE);
-    block_set_bytes_padded_aa(target_3di, (const uint8_t*)db_3di_sequence_str.data(), targetAlnLen, MAX_SIZE);
-    int16_t * target_bias_arr = new int16_t[targetAlnLen];
-    memset(target_bias_arr, 0, targetAlnLen * sizeof(int16_t));
-    block_set_pos_bias(target_bias, target_bias_arr, targetAlnLen);
-
+    block_set_bytes_padded_aa(blockTargetAA, (const uint8_t*) db_aa_sequence_str.data(), targetAlnLen, MAX_SIZE);
+    block_set_bytes_padded_aa(blockTarget3Di, (const uint8_t*)db_3di_sequence_str.data(), targetAlnLen, MAX_SIZE);
+    block_set_pos_bias(blockTargetBias, blockTargetBiasZero, targetAlnLen);
 
-    AAMatrix* matrix_aa = block_new_simple_aamatrix(1, -1);
-    for (int aa1 = 0; aa1 < subMatAA->alphabetSize; aa1++) {
-        for (int aa2 = 0; aa2 < subMatAA->alphabetSize; aa2++) {
-            // set to actual scores instead of zeros!
-            block_set_aamatrix(matrix_aa, subMatAA->num2aa[aa1], subMatAA->num2aa[aa2],
-                               subMatAA->subMatrix[aa1][aa2]);
-        }
-    }
-
-    AAMatrix* matrix_3di = block_new_simple_aamatrix(1, -1);
-    for (int aa1 = 0; aa1 < subMat3Di->alphabetSize; aa1++) {
-
-        for (int aa2 = 0; aa2 < subMat3Di->alphabetSize; aa2++) {
-            // set to actual scores instead of zeros!
-            block_set_aamatrix(matrix_3di, subMat3Di->num2aa[aa1], subMat3Di->num2aa[aa2],
-                               subMat3Di->subMatrix[aa1][aa2]);
-
-        }
-
-    }
-
-    Cigar* cigar = block_new_cigar(queryAlnLen, targetAlnLen);
 
     AlignResult res;
     size_t min_size = 32;
@@ -461,8 +702,8 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignStartPosBacktraceBl
         range.max = MAX_SIZE;
         // estimated x-drop threshold
         int32_t x_drop = -(min_size * gaps.extend + gaps.open);
-        block_align_3di_aa_trace_xdrop(block, query_aa, query_3di, query_bias, target_aa, target_3di, target_bias,
-                                       matrix_aa, matrix_3di, gaps, range, x_drop);
+        block_align_3di_aa_trace_xdrop(block, blockQueryAA, blockQuery3Di, blockQueryBias, blockTargetAA, blockTarget3Di, blockTargetBias,
+                                       blockMatrixAA, blockMatrix3Di, gaps, range, x_drop);
         res = block_res_aa_trace_xdrop(block);
         min_size *= 2;
     }
@@ -475,7 +716,7 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignStartPosBacktraceBl
         goto cleanup;
     }
 
-    block_cigar_aa_trace_xdrop(block, res.query_idx, res.reference_idx, cigar);
+    block_cigar_aa_trace_xdrop(block, res.query_idx, res.reference_idx, blockCigar);
 //    printf("query_aa: %s\nquery_3di: %s\ntarget_aa: %s\ntarget_3di: %s\nscore: %d\nidx: (%lu, %lu)\n",
 //           profile->query_aa_rev_sequence,
 //           profile->query_3di_rev_sequence,
@@ -486,13 +727,13 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignStartPosBacktraceBl
 //           res.reference_idx);
 
 
-    cigar_len = block_len_cigar(cigar);
+    cigar_len = block_len_cigar(blockCigar);
     // Note: 'M' signals either query_aa match or mismatch
     aaIds = 0;
     queryPos = 0;
     targetPos = 0;
     for (size_t i = 0; i < cigar_len; i++) {
-        OpLen o = block_get_cigar(cigar, i);
+        OpLen o = block_get_cigar(blockCigar, i);
         //printf("%lu%c", o.len, ops_char[o.op]);
         if(o.op == 1){
             for(size_t j = 0; j < o.len; j++){
@@ -521,17 +762,6 @@ StructureSmithWaterman::s_align StructureSmithWaterman::alignStartPosBacktraceBl
     r.tCov = computeCov(r.dbStartPos1, r.dbEndPos1, db_length);
 
 cleanup:
-    block_free_cigar(cigar);
-    block_free_padded_aa(query_aa);
-    block_free_padded_aa(query_3di);
-    block_free_pos_bias(query_bias);
-    block_free_padded_aa(target_aa);
-    block_free_padded_aa(target_3di);
-    block_free_pos_bias(target_bias);
-    block_free_aamatrix(matrix_3di);
-    block_free_aamatrix(matrix_aa);
-    delete [] query_bias_arr;
-    delete [] target_bias_arr;
     return r;
 }
 
@@ -1089,7 +1319,7 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
 #undef max16
 }
 
-template <const unsigned int type>
+template <const unsigned int type, bool aaScoring>
 std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignment_end> StructureSmithWaterman::sw_sse2_word (const unsigned char* db_aa_sequence,
                                                                                                                               const unsigned char* db_3di_sequence,
                                                                                                                               int8_t ref_dir,	// 0: forward ref; 1: reverse ref
@@ -1128,6 +1358,7 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
     memset(pvHLoad,0, segLen*sizeof(simd_int));
     memset(pvE,0,     segLen*sizeof(simd_int));
     memset(pvHmax,0,  segLen*sizeof(simd_int));
+    wordTerminateColumn = -1;
 
     int32_t i, j, k;
     /* 16 byte insertion begin vector */
@@ -1174,7 +1405,7 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
 
         /* inner loop to process the query sequence */
         for (j = 0; LIKELY(j < segLen); j ++) {
-            simd_int score = simdi16_adds(simdi_load(vPAA + j), simdi_load(vP3Di + j));
+            simd_int score = aaScoring ? simdi16_adds(simdi_load(vPAA + j), simdi_load(vP3Di + j)) : simdi_load(vP3Di + j);
             vH = simdi16_adds(vH, score);
 
             /* Get max from vH, vE and vF. */
@@ -1276,7 +1507,14 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
 
         /* Record the max score of current column. */
         max8(maxColumn[i], vMaxColumn);
-        if (maxColumn[i] == terminate) break;
+        if (maxColumn[i] >= terminate) {
+            // column i is complete, keep its state to resume at int width
+            wordTerminateColumn = i;
+            wordTerminateH = pvHStore;
+            wordTerminateMax = max;
+            wordTerminateEndRef = end_ref;
+            break;
+        }
     }
 
     /* Trace the alignment ending position on read. */
@@ -1320,6 +1558,271 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
 #undef max8
 }
 
+template <bool aaScoring>
+std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignment_end> StructureSmithWaterman::sw_sse2_word_fused (const unsigned char* db_aa_sequence,
+                                                                                                                                    const unsigned char* db_3di_sequence,
+                                                                                                                                    int32_t db_length,
+                                                                                                                                    int32_t query_length,
+                                                                                                                                    const uint8_t gap_open, /* will be used as - */
+                                                                                                                                    const uint8_t gap_extend, /* will be used as - */
+                                                                                                                                    const simd_int*query_aa_profile_fused,
+                                                                                                                                    const simd_int*query_3di_profile_fused,
+                                                                                                                                    int32_t maskLen,
+                                                                                                                                    uint16_t & revMax,
+                                                                                                                                    uint16_t minScore) {
+#define max8(m, vm) ((m) = simdi16_hmax((vm)));
+
+    uint16_t max = 0;		                     /* the max alignment score */
+    int32_t end_read = query_length - 1;
+    int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
+    const unsigned int SIMD_SIZE = VECSIZE_INT * 2;
+    int32_t segLen = (query_length + SIMD_SIZE-1) / SIMD_SIZE; /* number of segment */
+    /* array to record the alignment read ending position of the largest score of each reference position */
+    memset(this->maxColumn, 0, db_length * sizeof(uint16_t));
+    uint16_t * maxColumn = (uint16_t *) this->maxColumn;
+
+    simd_int vZero = simdi32_set(0);
+    simd_int* pvHStore = vHStore;
+    simd_int* pvHLoad = vHLoad;
+    simd_int* pvE = vE;
+    simd_int* pvHmax = vHmax;
+    simd_int* pvHStoreRev = vHStoreRev;
+    simd_int* pvHLoadRev = vHLoadRev;
+    simd_int* pvERev = vERev;
+    memset(pvHStore,0,segLen*sizeof(simd_int));
+    memset(pvHLoad,0, segLen*sizeof(simd_int));
+    memset(pvE,0,     segLen*sizeof(simd_int));
+    memset(pvHmax,0,  segLen*sizeof(simd_int));
+    memset(pvHStoreRev,0,segLen*sizeof(simd_int));
+    memset(pvHLoadRev,0, segLen*sizeof(simd_int));
+    memset(pvERev,0,     segLen*sizeof(simd_int));
+
+    int32_t i, j, k;
+    simd_int vGapO = simdi16_set(gap_open);
+    simd_int vGapE = simdi16_set(gap_extend);
+
+    simd_int vMaxScore = vZero; /* Trace the highest score of the whole SW matrix. */
+    simd_int vMaxMark = vZero; /* Trace the highest score till the previous column. */
+    simd_int vMaxScoreRev = vZero; /* Highest score of the reversed query, only the score is needed */
+    simd_int vTemp;
+    int32_t edge;
+
+    /* A column maximum grows by at most the best profile score of the next target residue,
+       so the column maximum plus these suffix sums bounds every score reachable from there. */
+    if (minScore > 0) {
+        remainingScoreBound[db_length] = 0;
+        for (i = db_length - 1; i >= 0; --i) {
+            const int32_t best = maxLetterScoreAA[db_aa_sequence[i]] + maxLetterScore3Di[db_3di_sequence[i]];
+            remainingScoreBound[i] = remainingScoreBound[i + 1] + std::max(best, 0);
+        }
+        if (remainingScoreBound[0] < minScore) {
+            revMax = 0;
+            alignment_end none;
+            none.score = 0;
+            none.ref = -1;
+            none.read = -1;
+            return std::make_pair(none, none);
+        }
+    }
+
+    for (i = 0; LIKELY(i < db_length); ++i) {
+        simd_int e, vF = vZero, vFRev = vZero;
+        simd_int vH = simdi8_shiftl(pvHStore[segLen - 1], 2);
+        simd_int vHRev = simdi8_shiftl(pvHStoreRev[segLen - 1], 2);
+
+        /* Swap the 2 H buffers of both directions. */
+        simd_int* pv = pvHLoad;
+        pvHLoad = pvHStore;
+        pvHStore = pv;
+        pv = pvHLoadRev;
+        pvHLoadRev = pvHStoreRev;
+        pvHStoreRev = pv;
+
+        simd_int vMaxColumn = vZero;
+        simd_int vMaxColumnRev = vZero;
+
+        /* forward and reverse profile rows are interleaved: [fwd_0, rev_0, fwd_1, rev_1, ...] */
+        const simd_int* vPAA = query_aa_profile_fused + db_aa_sequence[i] * segLen * 2;
+        const simd_int* vP3Di = query_3di_profile_fused + db_3di_sequence[i] * segLen * 2;
+
+        for (j = 0; LIKELY(j < segLen); j ++) {
+            simd_int score = aaScoring ? simdi16_adds(simdi_load(vPAA + 2 * j), simdi_load(vP3Di + 2 * j)) : simdi_load(vP3Di + 2 * j);
+            simd_int scoreRev = aaScoring ? simdi16_adds(simdi_load(vPAA + 2 * j + 1), simdi_load(vP3Di + 2 * j + 1)) : simdi_load(vP3Di + 2 * j + 1);
+
+            // forward
+            vH = simdi16_adds(vH, score);
+            e = simdi_load(pvE + j);
+            vH = simdi16_max(vH, e);
+            vH = simdi16_max(vH, vF);
+            vMaxColumn = simdi16_max(vMaxColumn, vH);
+            simdi_store(pvHStore + j, vH);
+            vH = simdui16_subs(vH, vGapO);
+            e = simdui16_subs(e, vGapE);
+            e = simdi16_max(e, vH);
+            simdi_store(pvE + j, e);
+            vF = simdui16_subs(vF, vGapE);
+            vF = simdi16_max(vF, vH);
+            vH = simdi_load(pvHLoad + j);
+
+            // reverse
+            vHRev = simdi16_adds(vHRev, scoreRev);
+            e = simdi_load(pvERev + j);
+            vHRev = simdi16_max(vHRev, e);
+            vHRev = simdi16_max(vHRev, vFRev);
+            vMaxColumnRev = simdi16_max(vMaxColumnRev, vHRev);
+            simdi_store(pvHStoreRev + j, vHRev);
+            vHRev = simdui16_subs(vHRev, vGapO);
+            e = simdui16_subs(e, vGapE);
+            e = simdi16_max(e, vHRev);
+            simdi_store(pvERev + j, e);
+            vFRev = simdui16_subs(vFRev, vGapE);
+            vFRev = simdi16_max(vFRev, vHRev);
+            vHRev = simdi_load(pvHLoadRev + j);
+        }
+
+        /* Lazy_F loops, identical to sw_sse2_word, once per direction */
+        for (k = 0; LIKELY(k < (int32_t) SIMD_SIZE); ++k) {
+            vF = simdi8_shiftl (vF, 2);
+            for (j = 0; LIKELY(j < segLen); ++j) {
+                vH = simdi_load(pvHStore + j);
+                vH = simdi16_max(vH, vF);
+                vMaxColumn = simdi16_max(vMaxColumn, vH);
+                simdi_store(pvHStore + j, vH);
+                vH = simdui16_subs(vH, vGapO);
+                vF = simdui16_subs(vF, vGapE);
+                if (UNLIKELY(! simdi8_movemask(simdi16_gt(vF, vH)))) goto endForward;
+            }
+        }
+        endForward:
+        for (k = 0; LIKELY(k < (int32_t) SIMD_SIZE); ++k) {
+            vFRev = simdi8_shiftl (vFRev, 2);
+            for (j = 0; LIKELY(j < segLen); ++j) {
+                vHRev = simdi_load(pvHStoreRev + j);
+                vHRev = simdi16_max(vHRev, vFRev);
+                vMaxColumnRev = simdi16_max(vMaxColumnRev, vHRev);
+                simdi_store(pvHStoreRev + j, vHRev);
+                vHRev = simdui16_subs(vHRev, vGapO);
+                vFRev = simdui16_subs(vFRev, vGapE);
+                if (UNLIKELY(! simdi8_movemask(simdi16_gt(vFRev, vHRev)))) goto endReverse;
+            }
+        }
+        endReverse:
+        vMaxScoreRev = simdi16_max(vMaxScoreRev, vMaxColumnRev);
+
+        vMaxScore = simdi16_max(vMaxScore, vMaxColumn);
+        vTemp = simdi16_eq(vMaxMark, vMaxScore);
+        uint32_t cmp = simdi8_movemask(vTemp);
+        if (cmp != SIMD_MOVEMASK_MAX) {
+            uint16_t temp;
+            vMaxMark = vMaxScore;
+            max8(temp, vMaxScore);
+            vMaxScore = vMaxMark;
+
+            if (LIKELY(temp > max)) {
+                max = temp;
+                end_ref = i;
+                for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+            }
+        }
+
+        /* Record the max score of current column. */
+        max8(maxColumn[i], vMaxColumn);
+        if (minScore > 0 && max < minScore && maxColumn[i] + remainingScoreBound[i + 1] < minScore) {
+            revMax = 0;
+            alignment_end none;
+            none.score = 0;
+            none.ref = -1;
+            none.read = -1;
+            return std::make_pair(none, none);
+        }
+    }
+    max8(revMax, vMaxScoreRev);
+
+    /* Trace the alignment ending position on read. */
+    uint16_t *t = (uint16_t*)pvHmax;
+    int32_t column_len = segLen * SIMD_SIZE;
+    for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+        int32_t temp;
+        if (*t == max) {
+            temp = i / SIMD_SIZE + i % SIMD_SIZE * segLen;
+            if (temp < end_read) end_read = temp;
+        }
+    }
+
+    /* Find the most possible 2nd best alignment. */
+    alignment_end best0;
+    best0.score = max;
+    best0.ref = end_ref;
+    best0.read = end_read;
+
+    alignment_end best1;
+    best1.score = 0;
+    best1.ref = 0;
+    best1.read = 0;
+
+    edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
+    for (i = 0; i < edge; i ++) {
+        if (maxColumn[i] > best1.score) {
+            best1.score = maxColumn[i];
+            best1.ref = i;
+        }
+    }
+    edge = (end_ref + maskLen) > db_length ? db_length : (end_ref + maskLen);
+    for (i = edge; i < db_length; i ++) {
+        if (maxColumn[i] > best1.score) {
+            best1.score = maxColumn[i];
+            best1.ref = i;
+        }
+    }
+
+    return std::make_pair(best0, best1);
+#undef max8
+}
+
+void StructureSmithWaterman::resumeFromWord(int32_t query_length, int32_t column) {
+    const int32_t wordElements = VECSIZE_INT * 2;
+    const int32_t intElements = VECSIZE_INT;
+    const int32_t wordSegLen = (query_length + wordElements - 1) / wordElements;
+    const int32_t intSegLen = (query_length + intElements - 1) / intElements;
+    // query positions that exist in both striped layouts (real residues and shared padding)
+    const int32_t commonLen = std::min(wordSegLen * wordElements, intSegLen * intElements);
+
+    // gather the word striped H, E and Hmax into query order, then scatter in int striped order
+    const int16_t * wordH = (const int16_t *) wordTerminateH;
+    const int16_t * wordE = (const int16_t *) vE;
+    const int16_t * wordHmax = (const int16_t *) vHmax;
+    int32_t * linearH = resumeScratch;
+    int32_t * linearE = resumeScratch + commonLen;
+    int32_t * linearHmax = resumeScratch + 2 * commonLen;
+    for (int32_t j = 0; j < wordSegLen; j++) {
+        for (int32_t lane = 0; lane < wordElements; lane++) {
+            const int32_t pos = lane * wordSegLen + j;
+            if (pos < commonLen) {
+                linearH[pos] = wordH[j * wordElements + lane];
+                linearE[pos] = wordE[j * wordElements + lane];
+                linearHmax[pos] = wordHmax[j * wordElements + lane];
+            }
+        }
+    }
+    int32_t * intH = (int32_t *) vHStore;
+    int32_t * intE = (int32_t *) vE;
+    int32_t * intHmax = (int32_t *) vHmax;
+    for (int32_t j = 0; j < intSegLen; j++) {
+        for (int32_t lane = 0; lane < intElements; lane++) {
+            const int32_t pos = lane * intSegLen + j;
+            intH[j * intElements + lane] = (pos < commonLen) ? linearH[pos] : 0;
+            intE[j * intElements + lane] = (pos < commonLen) ? linearE[pos] : 0;
+            intHmax[j * intElements + lane] = (pos < commonLen) ? linearHmax[pos] : 0;
+        }
+    }
+
+    // widen the column maxima in place, back to front so no unread entry is overwritten
+    const uint16_t * maxColumnWord = (const uint16_t *) maxColumn;
+    uint32_t * maxColumnInt = (uint32_t *) maxColumn;
+    for (int32_t i = column; i >= 0; i--) {
+        maxColumnInt[i] = maxColumnWord[i];
+    }
+}
 
 template <const unsigned int type>
 std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignment_end> StructureSmithWaterman::sw_sse2_int(
@@ -1338,7 +1841,8 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
     const simd_int* query_aa_profile_int,
     const simd_int* query_3di_profile_int,
     uint32_t terminate,
-    int32_t maskLen) {
+    int32_t maskLen,
+    int32_t resumeColumn) {
 #define max4(m, vm) ((m) = simdi32_hmax((vm)));
 
     uint32_t max = 0; /* the max alignment score */
@@ -1346,8 +1850,6 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
     int32_t end_ref = 0; /* 1_based best alignment ending point; Initialized as isn't aligned - 0. */
     const unsigned int SIMD_SIZE = VECSIZE_INT;
     int32_t segLen = (query_length + SIMD_SIZE-1) / SIMD_SIZE; /* number of segment */
-    /* array to record the alignment read ending position of the largest score of each reference position */
-    memset(this->maxColumn, 0, db_length * sizeof(uint32_t));
     uint32_t * maxColumn = (uint32_t *) this->maxColumn;
 
     /* Define 16 byte 0 vector. */
@@ -1356,10 +1858,22 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
     simd_int* pvHLoad = vHLoad;
     simd_int* pvE = vE;
     simd_int* pvHmax = vHmax;
-    memset(pvHStore, 0, segLen*sizeof(simd_int));
-    memset(pvHLoad,  0, segLen*sizeof(simd_int));
-    memset(pvE,      0, segLen*sizeof(simd_int));
-    memset(pvHmax,   0, segLen*sizeof(simd_int));
+    if (resumeColumn >= 0) {
+        // continue a forward word pass that stopped after column resumeColumn
+        resumeFromWord(query_length, resumeColumn);
+        max = wordTerminateMax;
+        end_ref = wordTerminateEndRef;
+        /* array to record the alignment read ending position of the largest score of each reference position */
+        memset(maxColumn + resumeColumn + 1, 0, (db_length - resumeColumn - 1) * sizeof(uint32_t));
+        memset(pvHLoad,  0, segLen*sizeof(simd_int));
+    } else {
+        /* array to record the alignment read ending position of the largest score of each reference position */
+        memset(this->maxColumn, 0, db_length * sizeof(uint32_t));
+        memset(pvHStore, 0, segLen*sizeof(simd_int));
+        memset(pvHLoad,  0, segLen*sizeof(simd_int));
+        memset(pvE,      0, segLen*sizeof(simd_int));
+        memset(pvHmax,   0, segLen*sizeof(simd_int));
+    }
 
     int32_t i, j, k;
     /* 16 byte insertion begin vector */
@@ -1385,6 +1899,10 @@ std::pair<StructureSmithWaterman::alignment_end, StructureSmithWaterman::alignme
         begin = db_length - 1;
         end = -1;
         step = -1;
+    } else if (resumeColumn >= 0) {
+        begin = resumeColumn + 1;
+        vMaxScore = simdi32_set(max);
+        vMaxMark = vMaxScore;
     }
     for (i = begin; LIKELY(i != end); i += step) {
         simd_int e, vF = vZero; /* Initialize F value to 0.
@@ -1634,6 +2152,7 @@ void StructureSmithWaterman::ssw_init(Sequence* q_aa,
     bias = abs(bias) + abs(compositionBias);
     profile->bias = bias;
     profile->isProfile = false;
+    profile->aaScoring = true;
     if(isProfile){
         profile->isProfile = true;
         createQueryProfile<int8_t, VECSIZE_INT * 4, PROFILE>(profile->profile_aa_byte,profile->query_aa_sequence,NULL,
@@ -1682,6 +2201,24 @@ void StructureSmithWaterman::ssw_init(Sequence* q_aa,
                                                                          profile->query_3di_sequence,
                                                                          profile->composition_bias_ss, profile->mat_3di,
                                                                          q_3di->L, alphabetSize, 0, 0, 0);
+        // 3Di only scoring (--alignment-type 0) uses a zero amino acid matrix, the amino acid word profile then
+        // only holds the composition bias. Fold it into the 3Di word profile so the word kernels load one profile.
+        int32_t matAASize = alphabetSize * alphabetSize;
+        bool zeroMatAA = true;
+        for (int32_t i = 0; i < matAASize; i++) {
+            zeroMatAA &= (mat_aa[i] == 0);
+        }
+        if (zeroMatAA) {
+            const int32_t segLen = (q_aa->L + VECSIZE_INT * 2 - 1) / (VECSIZE_INT * 2);
+            const int32_t wordLen = alphabetSize * segLen * VECSIZE_INT * 2;
+            int16_t * aaWord = (int16_t *) profile->profile_aa_word;
+            int16_t * ssWord = (int16_t *) profile->profile_3di_word;
+            for (int32_t i = 0; i < wordLen; i++) {
+                ssWord[i] += aaWord[i];
+                aaWord[i] = 0;
+            }
+            profile->aaScoring = false;
+        }
     }
     for(int32_t i = 0; i< alphabetSize; i++) {
         profile->profile_aa_word_linear[i] = &profile_aa_word_linear_data[i*q_aa->L];
@@ -1705,6 +2242,17 @@ void StructureSmithWaterman::ssw_init(Sequence* q_aa,
     std::reverse_copy(  profile->composition_bias_aa, profile->composition_bias_aa + q_aa->L, profile->composition_bias_aa_rev);
     std::reverse_copy(  profile->composition_bias_ss, profile->composition_bias_ss + q_3di->L, profile->composition_bias_ss_rev);
 
+    // block aligner input of the reversed query
+    if (subMatAA != NULL && subMat3Di != NULL) {
+        blockQueryAARev.clear();
+        blockQuery3DiRev.clear();
+        for (int32_t i = 0; i < q_aa->L; i++) {
+            blockQueryAARev.push_back(subMatAA->num2aa[profile->query_aa_rev_sequence[i]]);
+            blockQuery3DiRev.push_back(subMat3Di->num2aa[profile->query_3di_rev_sequence[i]]);
+            blockQueryBiasRev[i] = profile->composition_bias_aa_rev[i] + profile->composition_bias_ss_rev[i];
+        }
+    }
+
     profile->query_length = q_aa->L;
     profile->alphabetSize = alphabetSize;
 
@@ -1719,6 +2267,196 @@ void StructureSmithWaterman::ssw_init(Sequence* q_aa,
         }
     }
 }
+
+StructureSmithWaterman::s_align StructureSmithWaterman::alignBanded(const unsigned char *db_aa_sequence,
+                                                                    const unsigned char *db_3di_sequence,
+                                                                    int32_t db_length,
+                                                                    const uint8_t gap_open,
+                                                                    const uint8_t gap_extend,
+                                                                    int32_t diagonal,
+                                                                    int32_t bandWidth,
+                                                                    bool withBacktrace,
+                                                                    std::string & backtrace,
+                                                                    bool & touchesBand) {
+    // traceback state: source of H in the lower two bits, E and F extended instead of opened
+    const uint8_t FROM_ZERO = 0, FROM_DIAG = 1, FROM_E = 2, FROM_F = 3;
+    const uint8_t E_EXTEND = 4, F_EXTEND = 8;
+    const int32_t NEG_INF = INT_MIN / 2;
+
+    const int32_t query_length = profile->query_length;
+    const int32_t nAA = profile->alphabetSize;
+    const int32_t width = 2 * bandWidth + 1;
+    // band column k of query row i is target position i - diagonal - bandWidth + k
+    const int32_t rowFrom = std::max(0, diagonal - bandWidth);
+    const int32_t rowTo = std::min(query_length, db_length + diagonal + bandWidth);
+
+    bandH.assign(width + 1, 0);
+    bandE.assign(width + 1, NEG_INF);
+    bandHPrev.assign(width + 1, 0);
+    bandEPrev.assign(width + 1, NEG_INF);
+    bandHEdge.assign(width + 1, 0);
+    bandEEdge.assign(width + 1, 0);
+    bandHEdgePrev.assign(width + 1, 0);
+    bandEEdgePrev.assign(width + 1, 0);
+    if (withBacktrace) {
+        bandDirection.resize(static_cast<size_t>(query_length) * width);
+    }
+
+    int32_t best = 0;
+    int32_t bestRow = -1;
+    int32_t bestCol = -1;
+    bool bestEdge = false;
+    for (int32_t i = rowFrom; i < rowTo; i++) {
+        const int32_t jOffset = i - diagonal - bandWidth;
+        const int32_t kFrom = std::max(0, -jOffset);
+        const int32_t kTo = std::min(width, db_length - jOffset);
+        const int8_t *matAA = profile->mat_aa + profile->query_aa_sequence[i] * nAA;
+        const int8_t *mat3Di = profile->mat_3di + profile->query_3di_sequence[i] * nAA;
+        const int32_t bias = profile->composition_bias_aa[i] + profile->composition_bias_ss[i];
+        uint8_t *direction = withBacktrace ? &bandDirection[static_cast<size_t>(i) * width] : NULL;
+
+        for (int32_t k = 0; k < kFrom; k++) {
+            bandH[k] = 0;
+            bandE[k] = NEG_INF;
+        }
+        int32_t hLeft = 0;
+        bool hLeftEdge = false;
+        int32_t f = NEG_INF;
+        bool fEdge = false;
+        for (int32_t k = kFrom; k < kTo; k++) {
+            const int32_t j = jOffset + k;
+            // the neighbours left of the first and above the last band column are outside the band
+            const bool isEdge = (k == 0 && j > 0) || (k == width - 1 && i > 0);
+            uint8_t state = 0;
+
+            // gap in the target, from row i - 1 which is one band column to the right
+            int32_t e = bandEPrev[k + 1] - gap_extend;
+            bool eEdge = bandEEdgePrev[k + 1];
+            const int32_t eOpen = bandHPrev[k + 1] - gap_open;
+            if (eOpen > e) {
+                e = eOpen;
+                eEdge = bandHEdgePrev[k + 1];
+            } else {
+                state |= E_EXTEND;
+            }
+            eEdge |= isEdge;
+
+            // gap in the query
+            const int32_t fOpen = hLeft - gap_open;
+            f -= gap_extend;
+            if (fOpen > f) {
+                f = fOpen;
+                fEdge = hLeftEdge;
+            } else {
+                state |= F_EXTEND;
+            }
+            fEdge |= isEdge;
+
+            int32_t h = bandHPrev[k] + matAA[db_aa_sequence[j]] + mat3Di[db_3di_sequence[j]] + bias;
+            bool hEdge = bandHEdgePrev[k];
+            uint8_t from = FROM_DIAG;
+            if (e > h) {
+                h = e;
+                hEdge = eEdge;
+                from = FROM_E;
+            }
+            if (f > h) {
+                h = f;
+                hEdge = fEdge;
+                from = FROM_F;
+            }
+            if (h <= 0) {
+                h = 0;
+                hEdge = false;
+                from = FROM_ZERO;
+            } else {
+                hEdge |= isEdge;
+            }
+            // ties end at the first target position like the striped alignment
+            if (h > best || (h == best && h > 0 && j < bestCol)) {
+                best = h;
+                bestRow = i;
+                bestCol = j;
+                bestEdge = hEdge;
+            }
+            if (withBacktrace) {
+                direction[k] = state | from;
+            }
+            bandH[k] = h;
+            bandE[k] = e;
+            bandHEdge[k] = hEdge;
+            bandEEdge[k] = eEdge;
+            hLeft = h;
+            hLeftEdge = hEdge;
+        }
+        for (int32_t k = kTo; k <= width; k++) {
+            bandH[k] = 0;
+            bandE[k] = NEG_INF;
+        }
+        std::swap(bandH, bandHPrev);
+        std::swap(bandE, bandEPrev);
+        std::swap(bandHEdge, bandHEdgePrev);
+        std::swap(bandEEdge, bandEEdgePrev);
+    }
+
+    s_align r;
+    r.word = 0;
+    r.score1 = best;
+    r.score2 = 0;
+    r.ref_end2 = -1;
+    r.qEndPos1 = bestRow;
+    r.dbEndPos1 = bestCol;
+    r.qStartPos1 = -1;
+    r.dbStartPos1 = -1;
+    r.cigar = 0;
+    r.cigarLen = 0;
+    r.identicalAACnt = 0;
+    r.qCov = 0;
+    r.tCov = 0;
+    touchesBand = bestEdge;
+    if (withBacktrace == false || best == 0) {
+        return r;
+    }
+
+    // trace back from the best cell, stopping once the preceding diagonal cell starts a new alignment
+    backtrace.clear();
+    int32_t i = bestRow;
+    int32_t j = bestCol;
+    // matrix the path is in: FROM_DIAG for H, FROM_E or FROM_F for the gap matrices
+    uint8_t traceState = FROM_DIAG;
+    while (true) {
+        const uint8_t state = bandDirection[static_cast<size_t>(i) * width + (j - (i - diagonal - bandWidth))];
+        if (traceState == FROM_DIAG) {
+            const uint8_t from = state & 3;
+            if (from != FROM_DIAG) {
+                traceState = from;
+                continue;
+            }
+            backtrace.push_back('M');
+            r.identicalAACnt += (db_aa_sequence[j] == profile->query_aa_sequence[i]);
+            r.qStartPos1 = i;
+            r.dbStartPos1 = j;
+            i--;
+            j--;
+            if (i < 0 || j < 0 || (bandDirection[static_cast<size_t>(i) * width + (j - (i - diagonal - bandWidth))] & 3) == FROM_ZERO) {
+                break;
+            }
+        } else if (traceState == FROM_E) {
+            backtrace.push_back('I');
+            traceState = (state & E_EXTEND) ? FROM_E : FROM_DIAG;
+            i--;
+        } else {
+            backtrace.push_back('D');
+            traceState = (state & F_EXTEND) ? FROM_F : FROM_DIAG;
+            j--;
+        }
+    }
+    std::reverse(backtrace.begin(), backtrace.end());
+    r.qCov = computeCov(r.qStartPos1, r.qEndPos1, query_length);
+    r.tCov = computeCov(r.dbStartPos1, r.dbEndPos1, db_length);
+    return r;
+}
+
 template <const unsigned int type>
 StructureSmithWaterman::cigar * StructureSmithWaterman::banded_sw(const unsigned char *db_aa_sequence, const unsigned char *db_3di_sequence,
                                                                   const int8_t *query_aa_sequence, const int8_t *query_3di_sequence, const int8_t * compositionBiasAA,
@@ -1995,33 +2733,27 @@ uint32_t StructureSmithWaterman::to_cigar_int (uint32_t length, char op_letter)
     return res;
 }
 
-void StructureSmithWaterman::printVector(__m128i v){
-    for (int i = 0; i < 8; i++)
-        printf("%d ", ((short) (sse2_extract_epi16(v, i)) + 32768));
+void StructureSmithWaterman::printVector(simd_int v){
+    for (int i = 0; i < (int) (VECSIZE_INT * 2); i++)
+        printf("%d ", ((short) (simd_extract_epi16(v, i)) + 32768));
     std::cout << "\n";
 }
 
-void StructureSmithWaterman::printVectorUS(__m128i v){
-    for (int i = 0; i < 8; i++)
-        printf("%d ", (unsigned short) sse2_extract_epi16(v, i));
+void StructureSmithWaterman::printVectorUS(simd_int v){
+    for (int i = 0; i < (int) (VECSIZE_INT * 2); i++)
+        printf("%d ", (unsigned short) simd_extract_epi16(v, i));
     std::cout << "\n";
 }
 
-unsigned short StructureSmithWaterman::sse2_extract_epi16(__m128i v, int pos) {
-    switch(pos){
-        case 0: return _mm_extract_epi16(v, 0);
-        case 1: return _mm_extract_epi16(v, 1);
-        case 2: return _mm_extract_epi16(v, 2);
-        case 3: return _mm_extract_epi16(v, 3);
-        case 4: return _mm_extract_epi16(v, 4);
-        case 5: return _mm_extract_epi16(v, 5);
-        case 6: return _mm_extract_epi16(v, 6);
-        case 7: return _mm_extract_epi16(v, 7);
-    }
-    std::cerr << "Fatal error in QueryScore: position in the vector is not in the legal range (pos = " << pos << ")\n";
-    EXIT(1);
-    // never executed
-    return 0;
+unsigned short StructureSmithWaterman::simd_extract_epi16(simd_int v, int pos) {
+    if (pos < 0 || pos >= (int) (VECSIZE_INT * 2)) {
+        Debug(Debug::ERROR) << "Position in the vector is not in the legal range (pos = " << pos << ")\n";
+        EXIT(EXIT_FAILURE);
+    }
+    // lane extraction through memory works for every vector width of simd.h
+    uint16_t lanes[VECSIZE_INT * 2] __attribute__((aligned(ALIGN_INT)));
+    simdi_store((simd_int *) lanes, v);
+    return lanes[pos];
 }
 
 float StructureSmithWaterman::computeCov(unsigned int startPos, unsigned int endPos, unsigned int len) {
@@ -38,6 +38,7 @@
 #include "structureto3diseqdist.h"
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
 #if !defined(__APPLE__) && !defined(__llvm__)
 #include <malloc.h>
@@ -59,13 +60,13 @@ public:
                            SubstitutionMatrix * subAAMat, SubstitutionMatrix * sub3DiMat);
     ~StructureSmithWaterman();
 
-    // prints a __m128 vector containing 8 signed shorts
-    static void printVector (__m128i v);
+    // prints a simd_int vector containing VECSIZE_INT * 2 signed shorts
+    static void printVector (simd_int v);
 
-    // prints a __m128 vector containing 8 unsigned shorts, added 32768
-    static void printVectorUS (__m128i v);
+    // prints a simd_int vector containing VECSIZE_INT * 2 unsigned shorts, added 32768
+    static void printVectorUS (simd_int v);
 
-    static unsigned short sse2_extract_epi16(__m128i v, int pos);
+    static unsigned short simd_extract_epi16(simd_int v, int pos);
 
     // The dynamic programming matrix entries for the query and database sequences are stored sequentially (the order see the Farrar paper).
     // This function calculates the index within the dynamic programming matrices for the given query and database sequence position.
@@ -118,6 +119,31 @@ public:
             const uint8_t gap_extend,
             const int32_t maskLen);
 
+    /*!	@function	Forward score and end position plus the score of the reversed query in one pass over the target.
+
+     @param	reverse	aligner initialized with the reversed query; initFusedProfile(reverse) has to be called before
+     @param	revScore	output, the same score as reverse.alignScoreEndPos(...).score1
+     @param	minScore	forward scores below minScore are not needed (0: disabled); the pass stops as soon as
+                        no alignment can reach it anymore and returns score1 = 0 and dbEndPos1 = -1
+
+     @note	Both word profiles are interleaved, so each target residue and profile row is loaded once for both directions.
+     Falls back to two separate passes if either direction overflows the word range.
+     */
+    template <unsigned int profile_type>
+    s_align alignScoreEndPosFused (
+            StructureSmithWaterman & reverse,
+            const unsigned char *db_aa_sequence,
+            const unsigned char *db_3di_sequence,
+            int32_t db_length,
+            const uint8_t gap_open,
+            const uint8_t gap_extend,
+            const int32_t maskLen,
+            uint32_t & revScore,
+            const uint32_t minScore);
+
+    // interleave the word profiles of this query and of the reversed query in reverse (after both ssw_init calls)
+    void initFusedProfile(const StructureSmithWaterman & reverse);
+
     template <unsigned int profile_type>
     s_align alignStartPosBacktrace (
             const unsigned char *db_aa_sequence,
@@ -131,6 +157,30 @@ public:
             const int covMode, const float covThr,
             const int32_t maskLen);
 
+    // number of targets scored together by alignScoreBatch, one target per 16 bit lane
+    static size_t getBatchSize() {
+        return VECSIZE_INT * 2;
+    }
+
+    /*!	@function	Inter-sequence Smith-Waterman score for a batch of targets.
+
+     @param	db_aa_sequences	numerical amino acid target sequences, at most getBatchSize() of them
+     @param	db_3di_sequences	numerical 3Di target sequences
+     @param	scores	output, the best local score of each target; UINT32_MAX if the 16 bit lane saturated
+
+     @note	Each target occupies one SIMD lane and is aligned with the full Gotoh recursion, so the score equals the
+     alignScoreEndPos score and bounds the score of a banded alignment. Only substitution matrix (non-profile) queries
+     are supported.
+     */
+    void alignScoreBatch (
+            const unsigned char **db_aa_sequences,
+            const unsigned char **db_3di_sequences,
+            const int32_t *db_lengths,
+            size_t batchSize,
+            const uint8_t gap_open,
+            const uint8_t gap_extend,
+            uint32_t *scores);
+
     s_align alignStartPosBacktraceBlock (
             const unsigned char *db_aa_sequence,
             const unsigned char *db_3di_sequence,
@@ -140,6 +190,29 @@ public:
             std::string & backtrace,
             StructureSmithWaterman::s_align r);
 
+    /*!	@function	Local alignment restricted to a band around a diagonal.
+
+     @param	diagonal	query minus target position of the band center, e.g. the prefilter diagonal
+     @param	bandWidth	only cells with |qPos - dbPos - diagonal| <= bandWidth are computed, O(L * bandWidth)
+     @param	withBacktrace	also compute start positions, backtrace and identical residues
+     @param	touchesBand	output, true if the optimal alignment passes a cell at the band edge,
+                        so a wider band might find a better alignment
+
+     @note	Only substitution matrix (non-profile) queries are supported. Gap costs and scores are the ones of
+     alignScoreEndPos, so the result is the same as of the full alignment if that stays inside the band.
+     */
+    s_align alignBanded (
+            const unsigned char *db_aa_sequence,
+            const unsigned char *db_3di_sequence,
+            int32_t db_length,
+            const uint8_t gap_open,
+            const uint8_t gap_extend,
+            int32_t diagonal,
+            int32_t bandWidth,
+            bool withBacktrace,
+            std::string & backtrace,
+            bool & touchesBand);
+
 
     /*!	@function	Create the query profile using the query sequence.
      @param	read	pointer to the query sequence; the query sequence needs to be numbers
@@ -179,6 +252,9 @@ public:
     // ssw_align
     const static unsigned int PROFILE_SEQ = 5;
     const static unsigned int PROFILE_PROFILE = 6;
+    // one column adds at most two int8 scores plus two int8 biases (aa and 3Di),
+    // so a word pass whose column maximum stays below this bound cannot saturate in the next column
+    const static uint16_t WORD_RESUME_BOUND = INT16_MAX - 4 * (CHAR_MAX + 1);
 
 private:
 
@@ -237,6 +313,9 @@ private:
         int8_t* alignment_aa_profile;
         int8_t* alignment_3di_profile;
         bool isProfile;
+        // false if the amino acid matrix is all zero (--alignment-type 0), its per position bias is then
+        // folded into profile_3di_word and profile_aa_word is zero, so the word kernels skip it
+        bool aaScoring;
         // Memory layout of if mat + queryProfile is qL * AA
         //    Query length
         // A  -1  -3  -2  -1  -4  -2  -2  -3  -1  -3  -2  -2   7  -1  -2  -1  -1  -2  -5  -3
@@ -262,8 +341,58 @@ private:
     simd_int* vHLoad;
     simd_int* vE;
     simd_int* vHmax;
+    // state of the last column sw_sse2_word completed before reaching terminate, -1 if the pass ran through
+    int32_t wordTerminateColumn;
+    simd_int* wordTerminateH;
+    uint16_t wordTerminateMax;
+    int32_t wordTerminateEndRef;
+    int32_t* resumeScratch;
+    // reverse direction buffers of the fused kernel
+    simd_int* vHStoreRev;
+    simd_int* vHLoadRev;
+    simd_int* vERev;
+    simd_int* profile_aa_fused_word;
+    simd_int* profile_3di_fused_word;
+    // best forward profile score of each target letter and suffix sums of it along the target, for the score bound
+    int16_t* maxLetterScoreAA;
+    int16_t* maxLetterScore3Di;
+    uint32_t* remainingScoreBound;
+    // inter-sequence kernel buffers
+    simd_int* vBatchH;
+    simd_int* vBatchE;
+    simd_int* vBatchBias;
+    simd_int* vBatchScoreAA;
+    simd_int* vBatchScore3Di;
     uint8_t * maxColumn;
     BlockHandle block;
+    // block aligner inputs, allocated once for maxSequenceLength and refilled for every alignment
+    PaddedBytes* blockQueryAA;
+    PaddedBytes* blockQuery3Di;
+    PosBias* blockQueryBias;
+    PaddedBytes* blockTargetAA;
+    PaddedBytes* blockTarget3Di;
+    PosBias* blockTargetBias;
+    AAMatrix* blockMatrixAA;
+    AAMatrix* blockMatrix3Di;
+    Cigar* blockCigar;
+    // reversed query as letters and its combined position bias, built once per query in ssw_init
+    std::string blockQueryAARev;
+    std::string blockQuery3DiRev;
+    int16_t* blockQueryBiasRev;
+    int16_t* blockTargetBiasZero;
+    std::string blockTargetAARev;
+    std::string blockTarget3DiRev;
+    // rows of the banded alignment, one entry per band column plus one beyond the band
+    std::vector<int32_t> bandH;
+    std::vector<int32_t> bandE;
+    std::vector<int32_t> bandHPrev;
+    std::vector<int32_t> bandEPrev;
+    std::vector<uint8_t> bandHEdge;
+    std::vector<uint8_t> bandEEdge;
+    std::vector<uint8_t> bandHEdgePrev;
+    std::vector<uint8_t> bandEEdgePrev;
+    // traceback state of every band cell, query row major
+    std::vector<uint8_t> bandDirection;
     typedef struct {
         uint32_t score;
         int32_t ref;	 //0-based position
@@ -304,7 +433,7 @@ private:
                                                      is set to 0, it will not be used */
                                                           uint8_t bias,  /* Shift 0 point to a positive value. */
                                                           int32_t maskLen);
-    template <const unsigned int type>
+    template <const unsigned int type, bool aaScoring = true>
     std::pair<alignment_end, alignment_end> sw_sse2_word (const unsigned char* db_aa_sequence,
                                                           const unsigned char* db_3di_sequence,
                                                           int8_t ref_dir,	// 0: forward ref; 1: reverse ref
@@ -322,6 +451,20 @@ private:
                                                           uint16_t terminate,
                                                           int32_t maskLen);
 
+    // sw_sse2_word for the forward profile and the score of the reversed query profile, interleaved profile layout
+    template <bool aaScoring>
+    std::pair<alignment_end, alignment_end> sw_sse2_word_fused (const unsigned char* db_aa_sequence,
+                                                                const unsigned char* db_3di_sequence,
+                                                                int32_t db_length,
+                                                                int32_t query_length,
+                                                                const uint8_t gap_open, /* will be used as - */
+                                                                const uint8_t gap_extend, /* will be used as - */
+                                                                const simd_int*query_aa_profile_fused,
+                                                                const simd_int*query_3di_profile_fused,
+                                                                int32_t maskLen,
+                                                                uint16_t & revMax,
+                                                                uint16_t minScore);
+
     template <const unsigned int type>
     std::pair<alignment_end, alignment_end> sw_sse2_int(
         const unsigned char* db_aa_sequence,
@@ -339,9 +482,13 @@ private:
         const simd_int*query_aa_profile_byte,
         const simd_int*query_3di_profile_byte,
         uint32_t terminate,
-        int32_t maskLen
+        int32_t maskLen,
+        int32_t resumeColumn = -1
     );
 
+    // converts the word state of column wordTerminateColumn into the int striped layout
+    void resumeFromWord(int32_t query_length, int32_t column);
+
     template <const unsigned int type>
     StructureSmithWaterman::cigar *banded_sw(const unsigned char *db_aa_sequence, const unsigned char *db_3di_sequence,
                                              const int8_t *query_aa_sequence, const int8_t *query_3di_sequence,
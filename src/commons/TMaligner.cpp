@@ -10,10 +10,10 @@
 #include "StructureSmithWaterman.h"
 #include "LocalParameters.h"
 
-TMaligner::TMaligner(unsigned int maxSeqLen, bool tmAlignFast, bool tmScoreOnly, bool computeExactScore)
+TMaligner::TMaligner(unsigned int maxSeqLen, bool tmAlignFast, bool tmScoreOnly, int tmScoreMode)
    : tmAlignFast(tmAlignFast),
      xtm(maxSeqLen), ytm(maxSeqLen), xt(maxSeqLen),
-     r1(maxSeqLen), r2(maxSeqLen), computeExactScore(computeExactScore){
+     r1(maxSeqLen), r2(maxSeqLen), tmScoreMode(tmScoreMode){
     affineNW = NULL;
     if(tmScoreOnly == false){
         affineNW = new AffineNeedlemanWunsch(maxSeqLen, 20);
@@ -47,30 +47,45 @@ TMaligner::~TMaligner(){
 }
 
 
-TMaligner::TMscoreResult TMaligner::computeAppoximateTMscore(float *x, float *y, float *z, unsigned int targetLen,
-                                                             int qStartPos, int dbStartPos, const std::string &backtrace,
-                                                             int normalizationLen) {
+void TMaligner::setTarget(float *x, float *y, float *z, unsigned int targetLen) {
+    if (x != target_x) {
+        memcpy(target_x, x, sizeof(float) * targetLen);
+        memcpy(target_y, y, sizeof(float) * targetLen);
+        memcpy(target_z, z, sizeof(float) * targetLen);
+    }
+}
+
+void TMaligner::setAlignment(int qStartPos, int dbStartPos, const std::string &backtrace) {
+    // expands run-length compressed backtraces on the fly, uncompressed ones have no counts
     int qPos = qStartPos;
     int tPos = dbStartPos;
-    std::string cigarString = backtrace;
     std::fill(invmap, invmap+queryLen, -1);
-    for (size_t btPos = 0; btPos < cigarString.size(); btPos++) {
-        if (cigarString[btPos] == 'M') {
-            invmap[qPos] = tPos;
-            qPos++;
-            tPos++;
+    int count = 0;
+    for (size_t btPos = 0; btPos < backtrace.size(); btPos++) {
+        const char c = backtrace[btPos];
+        if (c >= '0' && c <= '9') {
+            count = count * 10 + c - '0';
+            continue;
         }
-        else if (cigarString[btPos] == 'I') {
-            qPos++;
+        const int len = (count == 0) ? 1 : count;
+        count = 0;
+        if (c == 'M') {
+            for (int i = 0; i < len; i++) {
+                invmap[qPos + i] = tPos + i;
+            }
+            qPos += len;
+            tPos += len;
+        }
+        else if (c == 'I') {
+            qPos += len;
         }
         else {
-            tPos++;
+            tPos += len;
         }
     }
+}
 
-    memcpy(target_x, x, sizeof(float) * targetLen);
-    memcpy(target_y, y, sizeof(float) * targetLen);
-    memcpy(target_z, z, sizeof(float) * targetLen);
+TMaligner::TMscoreResult TMaligner::computeAppoximateTMscore(int normalizationLen, bool fused) {
     Coordinates targetCaCords;
     targetCaCords.x = target_x;
     targetCaCords.y = target_y;
@@ -93,41 +108,18 @@ TMaligner::TMscoreResult TMaligner::computeAppoximateTMscore(float *x, float *y,
     double prevd0 = d0;
     double local_d0_search = d0_search;
     double TMalnScore = standard_TMscore(r1, r2, xtm, ytm, xt, targetCaCords, queryCaCords, queryLen, invmap,
-                                         L_ali, rmsd0, D0_MIN, Lnorm, d0, score_d8, t, u,  mem);
+                                         L_ali, rmsd0, D0_MIN, Lnorm, d0, score_d8, t, u,  mem, fused);
     D0_MIN = prevD0_MIN;
     Lnorm = prevLnorm;
     d0 = prevd0;
     double TM = detailed_search_standard(r1, r2, xtm, ytm, xt, targetCaCords, queryCaCords, queryLen,
-                                         invmap, t, u, 40, local_d0_search, true, Lnorm, score_d8, d0, mem);
+                                         invmap, t, u, 40, local_d0_search, true, Lnorm, score_d8, d0, mem, fused);
     TM = std::max(TM, TMalnScore);
     return TMaligner::TMscoreResult(u, t, TM, rmsd0);
 }
 
 
-TMaligner::TMscoreResult TMaligner::computeExactTMscore(float *x, float *y, float *z, unsigned int targetLen,
-                                                        int qStartPos, int dbStartPos, const std::string &backtrace,
-                                                        int normalizationLen) {
-    int qPos = qStartPos;
-    int tPos = dbStartPos;
-    std::string cigarString = backtrace;
-    std::fill(invmap, invmap+queryLen, -1);
-    for (size_t btPos = 0; btPos < cigarString.size(); btPos++) {
-        if (cigarString[btPos] == 'M') {
-            invmap[qPos] = tPos;
-            qPos++;
-            tPos++;
-        }
-        else if (cigarString[btPos] == 'I') {
-            qPos++;
-        }
-        else {
-            tPos++;
-        }
-    }
-
-    memcpy(target_x, x, sizeof(float) * targetLen);
-    memcpy(target_y, y, sizeof(float) * targetLen);
-    memcpy(target_z, z, sizeof(float) * targetLen);
+TMaligner::TMscoreResult TMaligner::computeExactTMscore(unsigned int targetLen, int normalizationLen) {
     Coordinates targetCaCords;
     targetCaCords.x = target_x;
     targetCaCords.y = target_y;
@@ -201,13 +193,36 @@ TMaligner::TMscoreResult TMaligner::computeExactTMscore(float *x, float *y, floa
     return TMaligner::TMscoreResult(u, t, TM, rmsd0);
 }
 
+TMaligner::TMscoreResult TMaligner::computeTMscore(unsigned int targetLen, int normalizationLen) {
+    if(tmScoreMode == TMSCORE_EXACT){
+        return computeExactTMscore(targetLen, normalizationLen);
+    } else {
+        return computeAppoximateTMscore(normalizationLen, tmScoreMode == TMSCORE_APPROXIMATE_FUSED);
+    }
+}
+
 TMaligner::TMscoreResult TMaligner::computeTMscore(float *x, float *y, float *z, unsigned int targetLen,
                                                              int qStartPos, int dbStartPos, const std::string &backtrace,
                                                              int normalizationLen) {
-    if(computeExactScore){
-        return computeExactTMscore(x, y, z, targetLen, qStartPos, dbStartPos, backtrace, normalizationLen);
-    } else {
-        return computeAppoximateTMscore(x, y, z, targetLen, qStartPos, dbStartPos, backtrace, normalizationLen);
+    setAlignment(qStartPos, dbStartPos, backtrace);
+    setTarget(x, y, z, targetLen);
+    return computeTMscore(targetLen, normalizationLen);
+}
+
+void TMaligner::computeTMscores(const std::vector<TMscoreTarget> &targets, std::vector<TMscoreResult> &results) {
+    results.resize(targets.size());
+    const TMscoreTarget * prev = NULL;
+    for (size_t i = 0; i < targets.size(); i++) {
+        const TMscoreTarget & target = targets[i];
+        if (prev == NULL || prev->backtrace != target.backtrace
+            || prev->qStartPos != target.qStartPos || prev->targetStartPos != target.targetStartPos) {
+            setAlignment(target.qStartPos, target.targetStartPos, *target.backtrace);
+        }
+        if (prev == NULL || prev->x != target.x || prev->targetLen != target.targetLen) {
+            setTarget(target.x, target.y, target.z, target.targetLen);
+        }
+        results[i] = computeTMscore(target.targetLen, target.normalizationLen);
+        prev = &target;
     }
 }
 
@@ -223,16 +238,41 @@ void TMaligner::initQuery(float *x, float *y, float *z, char * querySeq, unsigne
     queryCaCords.x = query_x;
     queryCaCords.y = query_y;
     queryCaCords.z = query_z;
-    make_sec(queryCaCords, queryLen, querySecStruc); // secondary structure assignment
+    if (affineNW != NULL) {
+        // secondary structure is only needed for the full alignment
+        make_sec(queryCaCords, queryLen, querySecStruc); // secondary structure assignment
+    }
 
 }
 
+void TMaligner::initQuery(const TMaligner &other){
+    memcpy(query_x, other.query_x, sizeof(float) * other.queryLen);
+    memcpy(query_y, other.query_y, sizeof(float) * other.queryLen);
+    memcpy(query_z, other.query_z, sizeof(float) * other.queryLen);
+    memcpy(querySecStruc, other.querySecStruc, sizeof(char) * other.queryLen);
+    this->queryLen = other.queryLen;
+    this->querySeq = other.querySeq;
+}
+
 Matcher::result_t TMaligner::align(unsigned int dbKey, float *x, float *y, float *z, char * targetSeq, unsigned int targetLen, float &TM1){
+    return align(dbKey, x, y, z, targetSeq, targetLen, false, TM1);
+}
+
+Matcher::result_t TMaligner::align(unsigned int dbKey, float *x, float *y, float *z, char * targetSeq, unsigned int targetLen,
+                                   int qStartPos, int targetStartPos, const std::string & seedBacktrace, float &TM1){
+    setAlignment(qStartPos, targetStartPos, seedBacktrace);
+    return align(dbKey, x, y, z, targetSeq, targetLen, true, TM1);
+}
+
+Matcher::result_t TMaligner::align(unsigned int dbKey, float *x, float *y, float *z, char * targetSeq, unsigned int targetLen,
+                                   bool seeded, float &TM1){
     backtrace.clear();
 
-    memcpy(target_x, x, sizeof(float) * targetLen);
-    memcpy(target_y, y, sizeof(float) * targetLen);
-    memcpy(target_z, z, sizeof(float) * targetLen);
+    if (x != target_x) {
+        memcpy(target_x, x, sizeof(float) * targetLen);
+        memcpy(target_y, y, sizeof(float) * targetLen);
+        memcpy(target_z, z, sizeof(float) * targetLen);
+    }
     Coordinates targetCaCords;
     targetCaCords.x = target_x;
     targetCaCords.y = target_y;
@@ -250,7 +290,10 @@ Matcher::result_t TMaligner::align(unsigned int dbKey, float *x, float *y, float
     double  d0_scale = 0.0;
 
     memset(targetSecStruc, 0, sizeof(char) * targetLen);
-    make_sec(targetCaCords, targetLen, targetSecStruc); // secondary structure assignment
+    if (seeded == false) {
+        // only the initial alignments use the secondary structure
+        make_sec(targetCaCords, targetLen, targetSecStruc); // secondary structure assignment
+    }
     /* entry function for structure alignment */
     float t0[3], u0[3][3];
     float TM2;
@@ -273,7 +316,8 @@ Matcher::result_t TMaligner::align(unsigned int dbKey, float *x, float *y, float
                  seqM, seqxA, seqyA,
                  rmsd0, Liden,  n_ali, n_ali8,
                  targetLen, queryLen, Lnorm_ass, d0_scale,
-                 I_opt, a_opt, u_opt, d_opt, tmAlignFast, mem, xtm, ytm, xt, r1, r2);
+                 I_opt, a_opt, u_opt, d_opt, tmAlignFast, mem, xtm, ytm, xt, r1, r2,
+                 seeded ? invmap : NULL, tmAlignFast ? 2 : 30);
     //std::cout << queryId << "\t" << targetId << "\t" <<  TM_0 << "\t" << TM1 << std::endl;
 
     //double seqId = (n_ali8 > 0) ? (Liden / (static_cast<double>(n_ali8))) : 0;
@@ -339,3 +383,20 @@ unsigned int TMaligner::normalization(int mode, unsigned int alignmentLen, unsig
     }
     return 0;
 }
+
+unsigned int TMaligner::alignedPairs(const std::string &backtrace) {
+    unsigned int pairs = 0;
+    int count = 0;
+    for (size_t btPos = 0; btPos < backtrace.size(); btPos++) {
+        const char c = backtrace[btPos];
+        if (c >= '0' && c <= '9') {
+            count = count * 10 + c - '0';
+            continue;
+        }
+        if (c == 'M') {
+            pairs += (count == 0) ? 1 : count;
+        }
+        count = 0;
+    }
+    return pairs;
+}
@@ -12,7 +12,12 @@
 
 class TMaligner{
 public:
-    TMaligner(unsigned int maxSeqLen, bool tmAlignFast, bool tmScoreOnly, bool exact);
+    // computeTMscore modes, see --exact-tmscore
+    static const int TMSCORE_APPROXIMATE = 0;
+    static const int TMSCORE_EXACT = 1;
+    static const int TMSCORE_APPROXIMATE_FUSED = 2;
+
+    TMaligner(unsigned int maxSeqLen, bool tmAlignFast, bool tmScoreOnly, int tmScoreMode);
     ~TMaligner();
 
     struct TMscoreResult{
@@ -34,17 +39,51 @@ public:
         double tmscore;
         double rmsd;
     };
+    // one target of a computeTMscores batch, the backtrace may be compressed or uncompressed
+    struct TMscoreTarget{
+        TMscoreTarget(float *x, float *y, float *z, unsigned int targetLen, int qStartPos,
+                      int targetStartPos, const std::string * backtrace, int normalizationLen)
+            : x(x), y(y), z(z), targetLen(targetLen), qStartPos(qStartPos),
+              targetStartPos(targetStartPos), backtrace(backtrace), normalizationLen(normalizationLen) {}
+        float *x;
+        float *y;
+        float *z;
+        unsigned int targetLen;
+        int qStartPos;
+        int targetStartPos;
+        const std::string * backtrace;
+        int normalizationLen;
+    };
+
     void initQuery(float * x, float * y, float * z, char * querySeq, unsigned int queryLen);
+    // takes over the query of another aligner without repeating the secondary structure assignment
+    void initQuery(const TMaligner &other);
     TMscoreResult computeTMscore(float *x, float *y, float *z,
                                  unsigned int targetLen, int qStartPos,
                                  int targetStartPos, const std::string & backtrace,
                                  int normalizationLen);
+    // scores all targets against the current query, consecutive entries that share
+    // coordinates or backtrace (e.g. several normalizations of one hit) reuse the setup
+    void computeTMscores(const std::vector<TMscoreTarget> &targets, std::vector<TMscoreResult> &results);
 
     Matcher::result_t align(unsigned int dbKey, float *target_x, float *target_y, float *target_z,
                             char * targetSeq, unsigned int targetLen, float &TM);
+    // refines a given (e.g. 3Di/AA) alignment instead of running all TM-align initial alignments
+    Matcher::result_t align(unsigned int dbKey, float *target_x, float *target_y, float *target_z,
+                            char * targetSeq, unsigned int targetLen, int qStartPos, int targetStartPos,
+                            const std::string & seedBacktrace, float &TM);
+
+    // target coordinates can be decoded directly into these buffers to avoid a copy
+    float* getTargetX() { return target_x; }
+    float* getTargetY() { return target_y; }
+    float* getTargetZ() { return target_z; }
 
     static unsigned int normalization(int mode, unsigned int alignmentLen, unsigned int queryLen, unsigned int targetLen);
 
+    // number of aligned residue pairs of a (compressed or uncompressed) backtrace, every pair adds at most
+    // 1/normalizationLen to the TM-score, so pairs/normalizationLen is an upper bound of computeTMscore
+    static unsigned int alignedPairs(const std::string & backtrace);
+
 private:
     AffineNeedlemanWunsch * affineNW;
     std::string backtrace;
@@ -62,17 +101,17 @@ private:
     std::string seqM, seqxA, seqyA;// for output alignment
     bool tmAlignFast;
     Coordinates xtm, ytm, xt, r1, r2;
-    bool computeExactScore;
+    int tmScoreMode;
     int * invmap;
 
-    TMscoreResult computeExactTMscore(float *x, float *y, float *z,
-                                      unsigned int targetLen, int qStartPos,
-                                      int targetStartPos, const std::string & backtrace,
-                                      int normalizationLen);
-    TMscoreResult computeAppoximateTMscore(float *x, float *y, float *z,
-                                      unsigned int targetLen, int qStartPos,
-                                      int targetStartPos, const std::string & backtrace,
-                                      int normalizationLen);
+    Matcher::result_t align(unsigned int dbKey, float *target_x, float *target_y, float *target_z,
+                            char * targetSeq, unsigned int targetLen, bool seeded, float &TM);
+    void setTarget(float *x, float *y, float *z, unsigned int targetLen);
+    void setAlignment(int qStartPos, int targetStartPos, const std::string & backtrace);
+    // both expect setTarget and setAlignment to be called before
+    TMscoreResult computeExactTMscore(unsigned int targetLen, int normalizationLen);
+    TMscoreResult computeAppoximateTMscore(int normalizationLen, bool fused);
+    TMscoreResult computeTMscore(unsigned int targetLen, int normalizationLen);
 };
 
 #endif //FOLDSEEK_TMALIGNER_H
@@ -0,0 +1,259 @@
+#include "ArrowIpc.h"
+#include "Debug.h"
+#include "Util.h"
+
+#include <zstd.h>
+#include <algorithm>
+#include <cstring>
+
+// enums of the Arrow flatbuffer schema (Schema.fbs and Message.fbs)
+static const uint16_t METADATA_VERSION_V5 = 4;
+static const uint8_t MESSAGE_HEADER_SCHEMA = 1;
+static const uint8_t MESSAGE_HEADER_RECORD_BATCH = 3;
+static const uint8_t TYPE_INT = 2;
+static const uint8_t TYPE_FLOATING_POINT = 3;
+static const uint8_t TYPE_UTF8 = 5;
+static const uint16_t PRECISION_SINGLE = 1;
+static const uint16_t PRECISION_DOUBLE = 2;
+static const uint8_t COMPRESSION_ZSTD = 1;
+static const uint8_t COMPRESSION_METHOD_BUFFER = 0;
+
+static const uint32_t CONTINUATION_MARKER = 0xFFFFFFFF;
+
+static size_t roundUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Minimal flatbuffer builder. Objects are written front to back, a table is written before the objects it
+// refers to, so its offset fields are added as placeholders and linked once these objects exist.
+class FlatBufferBuilder {
+public:
+    struct Slot {
+        uint16_t id;
+        uint8_t size;
+        uint64_t value;
+    };
+
+    std::string buf;
+
+    template <typename T>
+    size_t add(T value) {
+        buf.resize(roundUp(buf.size(), sizeof(T)), '\0');
+        const size_t pos = buf.size();
+        buf.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        return pos;
+    }
+
+    // points the offset field at pos to the object at target
+    void link(size_t pos, size_t target) {
+        const uint32_t offset = static_cast<uint32_t>(target - pos);
+        memcpy(&buf[pos], &offset, sizeof(uint32_t));
+    }
+
+    // writes a vtable followed by its table and returns the table position, slotPos receives the field positions
+    size_t addTable(const Slot *slots, size_t count, size_t *slotPos) {
+        uint16_t fieldCount = 0;
+        uint16_t inlineSize = sizeof(int32_t);
+        uint16_t slotOffsets[8];
+        for (size_t i = 0; i < count; i++) {
+            fieldCount = std::max(fieldCount, static_cast<uint16_t>(slots[i].id + 1));
+            inlineSize = static_cast<uint16_t>(roundUp(inlineSize, slots[i].size));
+            slotOffsets[i] = inlineSize;
+            inlineSize += slots[i].size;
+        }
+        const size_t vtableSize = sizeof(uint16_t) * (2 + fieldCount);
+        const size_t tablePos = roundUp(buf.size() + vtableSize, 8);
+        const size_t vtablePos = tablePos - vtableSize;
+        buf.resize(tablePos + inlineSize, '\0');
+        uint16_t *vtable = reinterpret_cast<uint16_t *>(&buf[vtablePos]);
+        vtable[0] = static_cast<uint16_t>(vtableSize);
+        vtable[1] = inlineSize;
+        for (size_t i = 0; i < count; i++) {
+            vtable[2 + slots[i].id] = slotOffsets[i];
+            memcpy(&buf[tablePos + slotOffsets[i]], &slots[i].value, slots[i].size);
+            if (slotPos != NULL) {
+                slotPos[i] = tablePos + slotOffsets[i];
+            }
+        }
+        const int32_t vtableOffset = static_cast<int32_t>(tablePos - vtablePos);
+        memcpy(&buf[tablePos], &vtableOffset, sizeof(int32_t));
+        return tablePos;
+    }
+
+    // vector of count elements, the elements are aligned to elementAlign
+    size_t addVector(const void *data, size_t count, size_t elementSize, size_t elementAlign) {
+        const size_t pos = roundUp(buf.size() + sizeof(uint32_t), std::max(elementAlign, sizeof(uint32_t))) - sizeof(uint32_t);
+        buf.resize(pos, '\0');
+        add(static_cast<uint32_t>(count));
+        if (count > 0) {
+            buf.append(static_cast<const char *>(data), count * elementSize);
+        }
+        return pos;
+    }
+
+    size_t addString(const std::string &str) {
+        const size_t pos = addVector(str.c_str(), str.size(), 1, sizeof(uint32_t));
+        buf.push_back('\0');
+        return pos;
+    }
+};
+
+// encapsulated message: continuation marker, metadata length and the flatbuffer padded to 8 bytes
+static void writeMessage(const std::string &metadata, std::string &out) {
+    const int32_t metadataLength = static_cast<int32_t>(roundUp(metadata.size(), 8));
+    out.append(reinterpret_cast<const char *>(&CONTINUATION_MARKER), sizeof(uint32_t));
+    out.append(reinterpret_cast<const char *>(&metadataLength), sizeof(int32_t));
+    out.append(metadata);
+    out.append(metadataLength - metadata.size(), '\0');
+}
+
+// adds the root message table and returns the position of its header field
+static size_t addMessage(FlatBufferBuilder &fb, uint8_t headerType, int64_t bodyLength) {
+    const size_t root = fb.add(static_cast<uint32_t>(0));
+    const FlatBufferBuilder::Slot message[] = {
+        {3, 8, static_cast<uint64_t>(bodyLength)},
+        {0, 2, METADATA_VERSION_V5},
+        {2, 4, 0},
+        {1, 1, headerType}
+    };
+    size_t slotPos[4];
+    fb.link(root, fb.addTable(message, 4, slotPos));
+    return slotPos[2];
+}
+
+void ArrowIpc::writeSchema(const std::vector<std::string> &names, const std::vector<ColumnType> &types, std::string &out) {
+    FlatBufferBuilder fb;
+    const size_t headerPos = addMessage(fb, MESSAGE_HEADER_SCHEMA, 0);
+    // fields, endianness is little by default
+    const FlatBufferBuilder::Slot schema[] = {{1, 4, 0}};
+    size_t fieldsPos;
+    fb.link(headerPos, fb.addTable(schema, 1, &fieldsPos));
+    const std::vector<uint32_t> fieldOffsets(names.size(), 0);
+    const size_t fieldVector = fb.addVector(fieldOffsets.data(), fieldOffsets.size(), sizeof(uint32_t), sizeof(uint32_t));
+    fb.link(fieldsPos, fieldVector);
+    for (size_t i = 0; i < names.size(); i++) {
+        uint8_t typeType = TYPE_UTF8;
+        if (types[i] == INT32) {
+            typeType = TYPE_INT;
+        } else if (types[i] == FLOAT32 || types[i] == FLOAT64) {
+            typeType = TYPE_FLOATING_POINT;
+        }
+        // name, type, children, nullable is false by default
+        const FlatBufferBuilder::Slot field[] = {{0, 4, 0}, {3, 4, 0}, {5, 4, 0}, {2, 1, typeType}};
+        size_t slotPos[4];
+        fb.link(fieldVector + sizeof(uint32_t) * (i + 1), fb.addTable(field, 4, slotPos));
+        fb.link(slotPos[0], fb.addString(names[i]));
+        size_t typeTable;
+        if (types[i] == INT32) {
+            // bit width and signedness
+            const FlatBufferBuilder::Slot intType[] = {{0, 4, 32}, {1, 1, 1}};
+            typeTable = fb.addTable(intType, 2, NULL);
+        } else if (types[i] == FLOAT32 || types[i] == FLOAT64) {
+            const FlatBufferBuilder::Slot floatType[] = {{0, 2, types[i] == FLOAT32 ? PRECISION_SINGLE : PRECISION_DOUBLE}};
+            typeTable = fb.addTable(floatType, 1, NULL);
+        } else {
+            typeTable = fb.addTable(NULL, 0, NULL);
+        }
+        fb.link(slotPos[1], typeTable);
+        fb.link(slotPos[2], fb.addVector(NULL, 0, sizeof(uint32_t), sizeof(uint32_t)));
+    }
+    writeMessage(fb.buf, out);
+}
+
+void ArrowIpc::writeEndOfStream(std::string &out) {
+    const int32_t metadataLength = 0;
+    out.append(reinterpret_cast<const char *>(&CONTINUATION_MARKER), sizeof(uint32_t));
+    out.append(reinterpret_cast<const char *>(&metadataLength), sizeof(int32_t));
+}
+
+ArrowIpc::Batch::Batch(const std::vector<ColumnType> &types, bool compress) : rows(0), cctx(NULL) {
+    columns.resize(types.size());
+    for (size_t i = 0; i < types.size(); i++) {
+        columns[i].type = types[i];
+    }
+    if (compress) {
+        cctx = ZSTD_createCCtx();
+    }
+}
+
+ArrowIpc::Batch::~Batch() {
+    if (cctx != NULL) {
+        ZSTD_freeCCtx(cctx);
+    }
+}
+
+size_t ArrowIpc::Batch::stringBytes() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i].type == UTF8) {
+            bytes = std::max(bytes, columns[i].values.size());
+        }
+    }
+    return bytes;
+}
+
+// compressed buffers start with their uncompressed length
+void ArrowIpc::Batch::addBuffer(const char *data, size_t length) {
+    const size_t offset = body.size();
+    if (cctx != NULL && length > 0) {
+        const int64_t uncompressedLength = static_cast<int64_t>(length);
+        body.append(reinterpret_cast<const char *>(&uncompressedLength), sizeof(int64_t));
+        const size_t start = body.size();
+        const size_t bound = ZSTD_compressBound(length);
+        body.resize(start + bound);
+        const size_t compressedLength = ZSTD_compressCCtx(cctx, &body[start], bound, data, length, ZSTD_CLEVEL_DEFAULT);
+        if (ZSTD_isError(compressedLength)) {
+            Debug(Debug::ERROR) << "Could not compress Arrow buffer: " << ZSTD_getErrorName(compressedLength) << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        body.resize(start + compressedLength);
+    } else if (length > 0) {
+        body.append(data, length);
+    }
+    buffers.emplace_back(static_cast<int64_t>(offset));
+    buffers.emplace_back(static_cast<int64_t>(body.size() - offset));
+    body.resize(roundUp(body.size(), 8), '\0');
+}
+
+void ArrowIpc::Batch::flush(std::string &out) {
+    if (rows == 0) {
+        return;
+    }
+    for (size_t i = 0; i < columns.size(); i++) {
+        Column &col = columns[i];
+        // length and null count
+        fieldNodes.emplace_back(static_cast<int64_t>(rows));
+        fieldNodes.emplace_back(0);
+        // no validity bitmap without nulls
+        addBuffer(NULL, 0);
+        if (col.type == UTF8) {
+            const int32_t start = 0;
+            offsetBuffer.assign(reinterpret_cast<const char *>(&start), sizeof(int32_t));
+            offsetBuffer.append(col.offsets);
+            addBuffer(offsetBuffer.data(), offsetBuffer.size());
+        }
+        addBuffer(col.values.data(), col.values.size());
+        col.values.clear();
+        col.offsets.clear();
+    }
+
+    FlatBufferBuilder fb;
+    const size_t headerPos = addMessage(fb, MESSAGE_HEADER_RECORD_BATCH, static_cast<int64_t>(body.size()));
+    // length, nodes, buffers and compression
+    const FlatBufferBuilder::Slot recordBatch[] = {{0, 8, static_cast<uint64_t>(rows)}, {1, 4, 0}, {2, 4, 0}, {3, 4, 0}};
+    size_t slotPos[4];
+    fb.link(headerPos, fb.addTable(recordBatch, cctx != NULL ? 4 : 3, slotPos));
+    fb.link(slotPos[1], fb.addVector(fieldNodes.data(), fieldNodes.size() / 2, 2 * sizeof(int64_t), sizeof(int64_t)));
+    fb.link(slotPos[2], fb.addVector(buffers.data(), buffers.size() / 2, 2 * sizeof(int64_t), sizeof(int64_t)));
+    if (cctx != NULL) {
+        const FlatBufferBuilder::Slot compression[] = {{0, 1, COMPRESSION_ZSTD}, {1, 1, COMPRESSION_METHOD_BUFFER}};
+        fb.link(slotPos[3], fb.addTable(compression, 2, NULL));
+    }
+    writeMessage(fb.buf, out);
+    out.append(body);
+
+    body.clear();
+    fieldNodes.clear();
+    buffers.clear();
+    rows = 0;
+}
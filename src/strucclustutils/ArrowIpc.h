@@ -0,0 +1,96 @@
+#ifndef FOLDSEEK_ARROWIPC_H
+#define FOLDSEEK_ARROWIPC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+typedef struct ZSTD_CCtx_s ZSTD_CCtx;
+
+// Writer for the Apache Arrow IPC streaming format (https://arrow.apache.org/docs/format/Columnar.html).
+// A stream is a schema message, any number of record batch messages and an end-of-stream marker. Every message
+// is a multiple of 8 bytes long, so record batches written by different threads can be concatenated in any order
+// between the schema and the end-of-stream marker. The columns have no nulls, their buffers can be zstd compressed.
+class ArrowIpc {
+public:
+    enum ColumnType {
+        INT32,
+        FLOAT32,
+        FLOAT64,
+        UTF8
+    };
+
+    static void writeSchema(const std::vector<std::string> &names, const std::vector<ColumnType> &types, std::string &out);
+
+    static void writeEndOfStream(std::string &out);
+
+    // builds the record batches of one thread, values are appended column by column and row by row
+    class Batch {
+    public:
+        Batch(const std::vector<ColumnType> &types, bool compress);
+        ~Batch();
+
+        void appendInt32(size_t column, int32_t value) {
+            appendValue(column, value);
+        }
+
+        void appendFloat32(size_t column, float value) {
+            appendValue(column, value);
+        }
+
+        void appendFloat64(size_t column, double value) {
+            appendValue(column, value);
+        }
+
+        void appendString(size_t column, const char *data, size_t length) {
+            Column &col = columns[column];
+            col.values.append(data, length);
+            const int32_t end = static_cast<int32_t>(col.values.size());
+            col.offsets.append(reinterpret_cast<const char *>(&end), sizeof(int32_t));
+        }
+
+        void endRow() {
+            rows++;
+        }
+
+        // the batch should be flushed before its strings outgrow the 32 bit offsets
+        bool isFull() const {
+            return rows >= MAX_ROWS || stringBytes() >= MAX_STRING_BYTES;
+        }
+
+        // appends the record batch message to out and starts a new batch
+        void flush(std::string &out);
+
+    private:
+        static const size_t MAX_ROWS = 65536;
+        static const size_t MAX_STRING_BYTES = 256 * 1024 * 1024;
+
+        struct Column {
+            ColumnType type;
+            // fixed width values or the characters of the strings
+            std::string values;
+            // end offsets of the strings, the leading 0 is added on flush
+            std::string offsets;
+        };
+
+        template <typename T>
+        void appendValue(size_t column, T value) {
+            columns[column].values.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        size_t stringBytes() const;
+
+        std::vector<Column> columns;
+        size_t rows;
+        ZSTD_CCtx *cctx;
+        std::string body;
+        std::string offsetBuffer;
+        std::vector<int64_t> fieldNodes;
+        std::vector<int64_t> buffers;
+
+        void addBuffer(const char *data, size_t length);
+    };
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "ComplexSketch.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+static const char ALPHABET_3DI[] = "ACDEFGHIKLMNPQRSTVWY";
+static const unsigned int ALPHABET_SIZE = 20;
+
+struct LetterIndex {
+    signed char index[256];
+
+    LetterIndex() {
+        memset(index, -1, sizeof(index));
+        for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+            index[static_cast<unsigned char>(ALPHABET_3DI[i])] = static_cast<signed char>(i);
+            index[static_cast<unsigned char>(ALPHABET_3DI[i] - 'A' + 'a')] = static_cast<signed char>(i);
+        }
+    }
+};
+
+// murmur3 finalizer, spreads the k-mer codes uniformly over the hash range
+static inline uint32_t hashKmer(uint32_t code) {
+    code ^= code >> 16;
+    code *= 0x85ebca6bU;
+    code ^= code >> 13;
+    code *= 0xc2b2ae35U;
+    code ^= code >> 16;
+    return code;
+}
+
+void ComplexSketch::addSequence(const char *seq3Di, unsigned int len, std::vector<uint32_t> &hashes) {
+    static const LetterIndex letters;
+    static const uint32_t maxHash = UINT32_MAX / SCALE;
+    uint32_t highestPower = 1;
+    for (unsigned int i = 1; i < KMER_SIZE; i++) {
+        highestPower *= ALPHABET_SIZE;
+    }
+    uint32_t code = 0;
+    unsigned int valid = 0;
+    for (unsigned int i = 0; i < len; i++) {
+        const int letter = letters.index[static_cast<unsigned char>(seq3Di[i])];
+        if (letter < 0) {
+            code = 0;
+            valid = 0;
+            continue;
+        }
+        if (valid == KMER_SIZE) {
+            code -= (code / highestPower) * highestPower;
+        } else {
+            valid++;
+        }
+        code = code * ALPHABET_SIZE + static_cast<uint32_t>(letter);
+        if (valid == KMER_SIZE) {
+            const uint32_t hash = hashKmer(code);
+            if (hash <= maxHash) {
+                hashes.emplace_back(hash);
+            }
+        }
+    }
+}
+
+void ComplexSketch::finalize(std::vector<uint32_t> &hashes) {
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+}
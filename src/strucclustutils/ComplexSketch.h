@@ -0,0 +1,49 @@
+#ifndef FOLDSEEK_COMPLEXSKETCH_H
+#define FOLDSEEK_COMPLEXSKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// FracMinHash sketch of the 3Di k-mers of all chains of a complex for the complex prefilter of multimersearch.
+// A sketch keeps the hashes of the distinct k-mers that fall into the lowest 1/SCALE of the hash range, so two
+// complexes share about the same fraction of their sketches as of their k-mers.
+//
+// The sketch DB is a generic DB with one entry per complex, keyed by complex id:
+// an EntryHeader followed by the sorted hashes of the sketch.
+class ComplexSketch {
+public:
+    static const unsigned int KMER_SIZE = 6;
+    static const unsigned int SCALE = 2;
+    // target complexes sharing fewer hashes with a query complex are no candidates
+    static const unsigned int MIN_SHARED_HASHES = 2;
+
+    struct EntryHeader {
+        uint32_t kmerSize;
+        uint32_t scale;
+        // the prefilter lists the complex by this chain, expandmultimer adds its other chains
+        uint32_t firstChainKey;
+        uint32_t chainCount;
+    };
+
+    static EntryHeader makeHeader(unsigned int firstChainKey, unsigned int chainCount) {
+        EntryHeader header;
+        header.kmerSize = KMER_SIZE;
+        header.scale = SCALE;
+        header.firstChainKey = firstChainKey;
+        header.chainCount = chainCount;
+        return header;
+    }
+
+    static bool isCompatible(const EntryHeader &header) {
+        return header.kmerSize == KMER_SIZE && header.scale == SCALE;
+    }
+
+    // adds the sketch hashes of a 3Di sequence given as letters, X and unknown letters end a k-mer
+    static void addSequence(const char *seq3Di, unsigned int len, std::vector<uint32_t> &hashes);
+
+    // sorts the hashes of a complex and removes duplicates
+    static void finalize(std::vector<uint32_t> &hashes);
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "EmbeddingIndex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const char ALPHABET_3DI[] = "ACDEFGHIKLMNPQRSTVWY";
+
+struct LetterIndex {
+    signed char index[256];
+
+    LetterIndex() {
+        memset(index, -1, sizeof(index));
+        for (size_t i = 0; i < EmbeddingIndex::ALPHABET_SIZE; i++) {
+            index[static_cast<unsigned char>(ALPHABET_3DI[i])] = static_cast<signed char>(i);
+            index[static_cast<unsigned char>(ALPHABET_3DI[i] - 'A' + 'a')] = static_cast<signed char>(i);
+        }
+    }
+};
+
+void EmbeddingIndex::computeEmbedding(const char *seq3Di, unsigned int len, float *embedding) {
+    static const LetterIndex letters;
+    memset(embedding, 0, sizeof(float) * DIM);
+    float *pairs = embedding + ALPHABET_SIZE;
+    int prev = -1;
+    for (unsigned int i = 0; i < len; i++) {
+        const int curr = letters.index[static_cast<unsigned char>(seq3Di[i])];
+        if (curr >= 0) {
+            embedding[curr] += 1.0f;
+            if (prev >= 0) {
+                pairs[prev * ALPHABET_SIZE + curr] += 1.0f;
+            }
+        }
+        prev = curr;
+    }
+    float norm = 0.0f;
+    for (size_t i = 0; i < DIM; i++) {
+        embedding[i] = sqrtf(embedding[i]);
+        norm += embedding[i] * embedding[i];
+    }
+    if (norm > 0.0f) {
+        const float invNorm = 1.0f / sqrtf(norm);
+        for (size_t i = 0; i < DIM; i++) {
+            embedding[i] *= invNorm;
+        }
+    }
+}
+
+float EmbeddingIndex::quantize(const float *embedding, unsigned char *code) {
+    float max = 0.0f;
+    for (size_t i = 0; i < DIM; i++) {
+        max = std::max(max, embedding[i]);
+    }
+    if (max == 0.0f) {
+        memset(code, 0, DIM);
+        return 0.0f;
+    }
+    const float factor = 255.0f / max;
+    for (size_t i = 0; i < DIM; i++) {
+        code[i] = static_cast<unsigned char>(embedding[i] * factor + 0.5f);
+    }
+    return max / 255.0f;
+}
+
+size_t EmbeddingIndex::closestList(const float *embedding, const float *centroids, size_t lists) {
+    size_t best = 0;
+    float bestScore = -1.0f;
+    for (size_t l = 0; l < lists; l++) {
+        const float score = dot(embedding, centroids + l * DIM);
+        if (score > bestScore) {
+            bestScore = score;
+            best = l;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,52 @@
+#ifndef FOLDSEEK_EMBEDDINGINDEX_H
+#define FOLDSEEK_EMBEDDINGINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed length structure embedding for approximate nearest neighbour candidate generation (--prefilter-mode 4).
+// The embedding of an entry is the square root of its 3Di letter and letter pair counts scaled to unit length,
+// so the dot product of two embeddings is their cosine similarity.
+//
+// The embedding index is a generic DB of inverted lists:
+// key 0 holds the index header followed by the unit length list centroids as floats,
+// key 1 + l holds the members of list l, each as (key, scale, code[DIM]) of ENTRY_SIZE bytes.
+class EmbeddingIndex {
+public:
+    static const size_t ALPHABET_SIZE = 20;
+    static const size_t DIM = ALPHABET_SIZE + ALPHABET_SIZE * ALPHABET_SIZE;
+    static const unsigned int CENTROID_KEY = 0;
+    static const size_t ENTRY_SIZE = sizeof(unsigned int) + sizeof(float) + DIM;
+
+    struct Header {
+        uint32_t dim;
+        uint32_t lists;
+    };
+
+    // embedding of a 3Di sequence given as letters, X and unknown letters are skipped
+    static void computeEmbedding(const char *seq3Di, unsigned int len, float *embedding);
+
+    // stores the embedding as bytes relative to its largest component, returns the scale to restore it
+    static float quantize(const float *embedding, unsigned char *code);
+
+    static float dot(const float *a, const float *b) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < DIM; i++) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    static float dot(const float *a, const unsigned char *code, float scale) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < DIM; i++) {
+            sum += a[i] * static_cast<float>(code[i]);
+        }
+        return sum * scale;
+    }
+
+    // list whose centroid is closest to the embedding
+    static size_t closestList(const float *embedding, const float *centroids, size_t lists);
+};
+
+#endif
@@ -4,31 +4,133 @@
 
 #include "EvalueNeuralNet.h"
 #include "evalue_nn.kerasify.h"
+#include "DBReader.h"
+#include "FileUtil.h"
+#include "Sequence.h"
+#include "Util.h"
 
+#include <climits>
+#include <cstring>
 
-EvalueNeuralNet::EvalueNeuralNet(size_t dbResCount, BaseMatrix* subMat) : subMat(subMat) {
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+
+EvalueNeuralNet::EvalueNeuralNet(size_t dbResCount, BaseMatrix* subMat) : subMat(subMat), batchCount(0) {
         logDbResidueCount = log(static_cast<double>(dbResCount));
         encoder.LoadModel(
         std::string((const char *)evalue_nn_kerasify,
         evalue_nn_kerasify_len));
-        in = Tensor(subMat->alphabetSize + 1);
-        out = Tensor(2);
+        // one row more than a batch, predictMuLambda uses the row after the queued ones
+        in.resize((BATCH_SIZE + 1) * (subMat->alphabetSize + 1));
+        out.resize((BATCH_SIZE + 1) * encoder.OutputSize());
 }
 
-std::pair<double, double> EvalueNeuralNet::predictMuLambda(unsigned char * seq, unsigned int L){
-    for(int i = 0; i < subMat->alphabetSize; i++){
-        in.data_[i] = 0;
-    }
-    for (unsigned int i = 0; i < L; i++) {
-        in.data_[seq[i]]++; ;
-    }
-    in.data_[subMat->alphabetSize] = L;
-    encoder.Apply(&in, &out);
+std::pair<double, double> EvalueNeuralNet::denormalize(const float * prediction) {
     // used to normalize the output
     double mu1 = 0.17518475184751847;
     double sigma1 = 0.03260331312698818;
     double mu2 = -2.5569312493124934;
     double sigmal2 = 0.4353169278257701;
-    return std::make_pair(out.data_[0]*sigma1+mu1,
-                          out.data_[1]*sigmal2+mu2);
+    return std::make_pair(prediction[0]*sigma1+mu1,
+                          prediction[1]*sigmal2+mu2);
+}
+
+void EvalueNeuralNet::composition(const unsigned char * seq, unsigned int L, float * row) {
+    for(int i = 0; i < subMat->alphabetSize; i++){
+        row[i] = 0;
+    }
+    for (unsigned int i = 0; i < L; i++) {
+        row[seq[i]]++;
+    }
+    row[subMat->alphabetSize] = L;
+}
+
+std::pair<double, double> EvalueNeuralNet::predictMuLambda(unsigned char * seq, unsigned int L){
+    float * row = in.data() + batchCount * (subMat->alphabetSize + 1);
+    composition(seq, L, row);
+    encoder.Apply(row, 1, out.data());
+    return denormalize(out.data());
+}
+
+void EvalueNeuralNet::addToBatch(const unsigned char * seq, unsigned int L) {
+    composition(seq, L, in.data() + batchCount * (subMat->alphabetSize + 1));
+    batchCount++;
+}
+
+void EvalueNeuralNet::predictBatch(std::pair<double, double> * muLambda) {
+    if (batchCount == 0) {
+        return;
+    }
+    encoder.Apply(in.data(), batchCount, out.data());
+    for (size_t i = 0; i < batchCount; i++) {
+        muLambda[i] = denormalize(out.data() + i * encoder.OutputSize());
+    }
+    batchCount = 0;
+}
+
+std::string EvalueNeuralNet::muLambdaDbName(const std::string & db) {
+    if (Util::endsWith(".idx", db)) {
+        return db.substr(0, db.length() - 4) + "_mulambda";
+    }
+    return db + "_mulambda";
+}
+
+std::vector<std::pair<double, double>> EvalueNeuralNet::predictQueries(DBReader<unsigned int> & resultReader, DBReader<unsigned int> & query3Di,
+                                                                       int query3DiDbtype, BaseMatrix * subMat, size_t dbResCount,
+                                                                       int maxSeqLen, int compBiasCorrection, const std::string & muLambdaDb) {
+    std::vector<std::pair<double, double>> muLambda(resultReader.getSize(), std::make_pair(0.0, 0.0));
+    DBReader<unsigned int> * sidecar = NULL;
+    if (FileUtil::fileExists((muLambdaDb + ".dbtype").c_str())) {
+        sidecar = new DBReader<unsigned int>(muLambdaDb.c_str(), (muLambdaDb + ".index").c_str(), 1, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+        sidecar->open(DBReader<unsigned int>::NOSORT);
+    }
+    const size_t batches = (resultReader.getSize() + BATCH_SIZE - 1) / BATCH_SIZE;
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        EvalueNeuralNet evaluer(dbResCount, subMat);
+        Sequence qSeq3Di(maxSeqLen, query3DiDbtype, (const BaseMatrix *) subMat, 0, false, compBiasCorrection);
+        std::vector<size_t> ids;
+        std::vector<std::pair<double, double>> predictions(BATCH_SIZE);
+#pragma omp for schedule(dynamic, 1)
+        for (size_t b = 0; b < batches; b++) {
+            ids.clear();
+            const size_t end = std::min((b + 1) * BATCH_SIZE, resultReader.getSize());
+            for (size_t id = b * BATCH_SIZE; id < end; id++) {
+                // the index alone tells empty results apart, result pages are not touched here
+                if (resultReader.getEntryLen(id) <= 1) {
+                    continue;
+                }
+                size_t queryKey = resultReader.getDbKey(id);
+                if (sidecar != NULL) {
+                    // entries missing from the sidecar are predicted
+                    size_t sidecarId = sidecar->getId(queryKey);
+                    if (sidecarId != UINT_MAX && sidecar->getEntryLen(sidecarId) == 2 * sizeof(double) + 1) {
+                        double stored[2];
+                        memcpy(stored, sidecar->getData(sidecarId, 0), sizeof(stored));
+                        muLambda[id] = std::make_pair(stored[0], stored[1]);
+                        continue;
+                    }
+                }
+                unsigned int queryId = query3Di.getId(queryKey);
+                qSeq3Di.mapSequence(id, queryKey, query3Di.getData(queryId, thread_idx), query3Di.getSeqLen(queryId));
+                evaluer.addToBatch(qSeq3Di.numSequence, qSeq3Di.L);
+                ids.push_back(id);
+            }
+            evaluer.predictBatch(predictions.data());
+            for (size_t i = 0; i < ids.size(); i++) {
+                muLambda[ids[i]] = predictions[i];
+            }
+        }
+    }
+    if (sidecar != NULL) {
+        sidecar->close();
+        delete sidecar;
+    }
+    return muLambda;
 }
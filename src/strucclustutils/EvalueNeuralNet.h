@@ -5,22 +5,49 @@
 #ifndef FOLDSEEK_EVALUENEURALNET_H
 #define FOLDSEEK_EVALUENEURALNET_H
 #include <cmath>
-#include "kerasify/keras_model.h"
+#include "kerasify/keras_dense.h"
 #include "BaseMatrix.h"
 #include <iostream>
+#include <vector>
+
+template <typename T> class DBReader;
+
 class EvalueNeuralNet {
 private:
     BaseMatrix *subMat;
     double logDbResidueCount;
-    KerasModel encoder;
-    Tensor in;
-    Tensor out;
+    KerasDenseModel encoder;
+    std::vector<float> in;
+    std::vector<float> out;
+    size_t batchCount;
+
+    void composition(const unsigned char * seq, unsigned int L, float * row);
+
+    std::pair<double, double> denormalize(const float * prediction);
 public:
+    // number of compositions evaluated together by predictBatch
+    static const size_t BATCH_SIZE = 256;
 
     EvalueNeuralNet(size_t dbResCount, BaseMatrix* subMat);
 
     std::pair<double, double> predictMuLambda(unsigned char * seq, unsigned int L);
 
+    // queues the composition of a sequence, at most BATCH_SIZE before the next predictBatch
+    void addToBatch(const unsigned char * seq, unsigned int L);
+
+    // evaluates the network for all queued sequences at once and writes their mu/lambda in queue order
+    // gives the same values as predictMuLambda
+    void predictBatch(std::pair<double, double> * muLambda);
+
+    // name of the optional mu/lambda database written by createmulambda next to a sequence database
+    static std::string muLambdaDbName(const std::string & db);
+
+    // mu/lambda of every query with results in resultReader, read from the muLambdaDb sidecar if it exists
+    // and otherwise predicted up front in batches, entries without results are set to (0, 0)
+    static std::vector<std::pair<double, double>> predictQueries(DBReader<unsigned int> & resultReader, DBReader<unsigned int> & query3Di,
+                                                                 int query3DiDbtype, BaseMatrix * subMat, size_t dbResCount,
+                                                                 int maxSeqLen, int compBiasCorrection, const std::string & muLambdaDb);
+
     double computePvalue(double score, double lambda_, double mu) {
         double h = lambda_ * (score - mu);
         if(h > 10) {
@@ -43,6 +70,29 @@ public:
 	double corrEvalue = pow(evalue, 0.32);
         return corrEvalue;
     }
+
+    // smallest raw score whose corrected e-value does not exceed evalThr, every lower score is rejected by it
+    // returns 0 if all scores pass, maxScore + 1 if none in [0, maxScore] does
+    uint32_t computeMinScoreCorr(double evalThr, double lambda_, double mu, uint32_t maxScore) {
+        if (computeEvalueCorr(0, lambda_, mu) <= evalThr) {
+            return 0;
+        }
+        if (computeEvalueCorr(maxScore, lambda_, mu) > evalThr) {
+            return maxScore + 1;
+        }
+        // e-value is decreasing in the score for lambda > 0
+        uint32_t lo = 0;
+        uint32_t hi = maxScore;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (computeEvalueCorr(mid, lambda_, mu) > evalThr) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        return hi;
+    }
 };
 
 
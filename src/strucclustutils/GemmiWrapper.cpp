@@ -423,6 +423,9 @@ bool GemmiWrapper::loadFromBuffer(const char * buffer, size_t bufferSize, const
         std::unordered_map<std::string, int> entity_to_tax_id;
         switch (format) {
             case Format::Pdb:
+                if (loadPdbBackbone(newBuffer, newBufferSize, newName)) {
+                    return true;
+                }
                 st = gemmi::pdb_impl::read_pdb_from_stream(gemmi::MemoryStream(newBuffer, newBufferSize), newName, gemmi::PdbReadOptions());
                 break;
             case Format::Mmcif: {
@@ -497,6 +500,8 @@ bool GemmiWrapper::loadFoldcompStructure(std::istream& stream, const std::string
     }
     std::vector<AtomCoordinate> coordinates;
     fc.useAltAtomOrder = false;
+    // only N, CA, C and CB are used, skip placing the rest of the side chains
+    fc.backboneOnly = true;
     res = fc.decompress(coordinates);
     if (res != 0) {
         return false;
@@ -569,6 +574,220 @@ bool GemmiWrapper::loadFoldcompStructure(std::istream& stream, const std::string
     return true;
 }
 
+// Reads only the backbone atoms of a PDB file straight from the buffer, producing the same result as
+// read_pdb_from_stream followed by updateStructure. Returns false for files that need the full gemmi
+// model, e.g. residues or chains that are continued after other ones, duplicate models or broken records.
+bool GemmiWrapper::loadPdbBackbone(const char * buffer, size_t bufferSize, const std::string& filename) {
+    using namespace gemmi::pdb_impl;
+    // gemmi stops reading lines at NUL bytes
+    if (memchr(buffer, '\0', bufferSize) != NULL) {
+        return false;
+    }
+    title.clear();
+    chain.clear();
+    names.clear();
+    chainNames.clear();
+    modelIndices.clear();
+    modelCount = 0;
+    ca.clear();
+    ca_bfactor.clear();
+    c.clear();
+    cb.clear();
+    n.clear();
+    ami.clear();
+    taxIds.clear();
+
+    size_t slash = filename.find_last_of("\\/");
+    std::string name = (std::string::npos == slash) ? filename : filename.substr(slash + 1, filename.length());
+    std::vector<std::string> modelNames;
+    std::vector<std::string> partNames;
+    bool inModel = false;
+    bool inChain = false;
+    bool afterTer = false;
+    std::string chainName;
+
+    // current residue
+    bool hasResidue = false;
+    bool residueIncluded = false;
+    gemmi::ResidueId rid;
+    Vec3 ca_atom, cb_atom, n_atom, c_atom;
+    float ca_atom_bfactor = 0.0f;
+    bool hasCA = false;
+    auto flushResidue = [&]() {
+        if (hasResidue && residueIncluded && hasCA) {
+            ca_bfactor.push_back(ca_atom_bfactor);
+            ca.push_back(ca_atom);
+            cb.push_back(cb_atom);
+            n.push_back(n_atom);
+            c.push_back(c_atom);
+            ami.push_back(threeToOneAA(rid.name));
+        }
+        hasResidue = false;
+    };
+    auto finishChain = [&]() {
+        flushResidue();
+        if (inChain) {
+            taxIds.push_back(0);
+            chain.back().second = ca.size();
+        }
+        inChain = false;
+    };
+    auto addModel = [&](const std::string& modelName) {
+        modelNames.push_back(modelName);
+        partNames.clear();
+        modelCount++;
+        inModel = true;
+    };
+
+    // same line splitting as copy_line_from_stream with the default maximal line length of 120
+    const size_t maxLineLength = 120;
+    char line[maxLineLength + 2] = {0};
+    const char* cur = buffer;
+    const char* end = buffer + bufferSize;
+    try {
+        while (cur < end) {
+            size_t avail = std::min(static_cast<size_t>(end - cur), maxLineLength);
+            const char* nl = (const char*) memchr(cur, '\n', avail);
+            size_t len = nl ? (nl - cur + 1) : avail;
+            const char* lineStart = cur;
+            cur += len;
+            if (nl == NULL) {
+                const char* rest = (const char*) memchr(cur, '\n', end - cur);
+                cur = rest ? rest + 1 : end;
+            }
+            // record names are compared on the first four characters
+            memcpy(line, lineStart, std::min(len, (size_t) 4));
+            if (len < 4) {
+                memset(line + len, 0, 4 - len);
+            }
+            if (is_record_type(line, "ATOM") || is_record_type(line, "HETATM")) {
+                if (len < 55) {
+                    return false;
+                }
+                memcpy(line, lineStart, len);
+                line[len] = '\0';
+                std::string atomChainName = read_string(line + 20, 2);
+                gemmi::ResidueId atomRid = read_res_id(line + 22, line + 17);
+                if (inChain == false || atomChainName != chainName) {
+                    finishChain();
+                    if (inModel == false) {
+                        std::string modelName = std::to_string(modelNames.size() + 1);
+                        if (std::find(modelNames.begin(), modelNames.end(), modelName) != modelNames.end()) {
+                            return false;
+                        }
+                        addModel(modelName);
+                    }
+                    // chains continued after another chain are merged or typed by gemmi
+                    if (std::find(partNames.begin(), partNames.end(), atomChainName) != partNames.end()) {
+                        return false;
+                    }
+                    partNames.push_back(atomChainName);
+                    chainName = atomChainName;
+                    inChain = true;
+                    afterTer = false;
+                    chainNames.push_back(chainName);
+                    const std::string& modelName = modelNames.back();
+                    char* rest;
+                    errno = 0;
+                    unsigned int modelNumber = strtoul(modelName.c_str(), &rest, 10);
+                    if ((rest != modelName.c_str() && *rest != '\0') || errno == ERANGE) {
+                        modelIndices.push_back(modelCount);
+                    } else {
+                        modelIndices.push_back(modelNumber);
+                    }
+                    names.push_back(name);
+                    chain.emplace_back(ca.size(), ca.size());
+                }
+                if (len > 72) {
+                    atomRid.segment = read_string(line + 72, 4);
+                }
+                if (hasResidue == false || rid.matches(atomRid) == false) {
+                    // residues have to appear once and in order, otherwise gemmi regroups them
+                    if (hasResidue) {
+                        int prevNum = rid.seqid.num.value;
+                        int nextNum = atomRid.seqid.num.value;
+                        if (nextNum < prevNum || (nextNum == prevNum && (atomRid.seqid.icode | 0x20) <= (rid.seqid.icode | 0x20))) {
+                            return false;
+                        }
+                    }
+                    flushResidue();
+                    rid = atomRid;
+                    hasResidue = true;
+                    // residues behind TER are water or ligands
+                    residueIncluded = (afterTer == false);
+                    ca_atom = {NAN, NAN, NAN};
+                    cb_atom = {NAN, NAN, NAN};
+                    n_atom  = {NAN, NAN, NAN};
+                    c_atom  = {NAN, NAN, NAN};
+                    ca_atom_bfactor = 0.0f;
+                    hasCA = false;
+                }
+                if (len > 78) {
+                    read_charge(line[78], line[79]);
+                }
+                std::string atomName = read_string(line + 12, 4);
+                if (atomName == "CA") {
+                    ca_atom.x = read_double(line + 30, 8);
+                    ca_atom.y = read_double(line + 38, 8);
+                    ca_atom.z = read_double(line + 46, 8);
+                    ca_atom_bfactor = (len > 64) ? (float) read_double(line + 60, 6) : 20.0f;
+                    hasCA = true;
+                } else if (atomName == "CB") {
+                    cb_atom.x = read_double(line + 30, 8);
+                    cb_atom.y = read_double(line + 38, 8);
+                    cb_atom.z = read_double(line + 46, 8);
+                } else if (atomName == "N") {
+                    n_atom.x = read_double(line + 30, 8);
+                    n_atom.y = read_double(line + 38, 8);
+                    n_atom.z = read_double(line + 46, 8);
+                } else if (atomName == "C") {
+                    c_atom.x = read_double(line + 30, 8);
+                    c_atom.y = read_double(line + 38, 8);
+                    c_atom.z = read_double(line + 46, 8);
+                }
+            } else if (is_record_type(line, "TITLE")) {
+                if (len > 10) {
+                    title += gemmi::rtrim_str(std::string(lineStart + 10, len - 10 - 1));
+                }
+            } else if (is_record_type(line, "MODEL")) {
+                if (inModel && inChain) {
+                    return false;
+                }
+                memcpy(line, lineStart, len);
+                memset(line + len, 0, sizeof(line) - len);
+                std::string modelName = std::to_string(read_int(line + 10, 4));
+                if (std::find(modelNames.begin(), modelNames.end(), modelName) != modelNames.end()) {
+                    return false;
+                }
+                finishChain();
+                addModel(modelName);
+            } else if (is_record_type(line, "ENDMDL")) {
+                finishChain();
+                inModel = false;
+            } else if (is_record_type3(line, "TER")) {
+                if (inChain && afterTer == false) {
+                    afterTer = true;
+                }
+            } else if (is_record_type3(line, "END")) {
+                break;
+            } else if (is_record_type(line, "data") || is_record_type(line, "{\"da")) {
+                // gemmi rejects mmCIF and mmJSON files
+                if (inModel == false) {
+                    return false;
+                }
+            }
+        }
+    } catch (...) {
+        return false;
+    }
+    finishChain();
+    // gemmi adds an empty model to files without atoms
+    if (modelCount == 0) {
+        modelCount = 1;
+    }
+    return true;
+}
+
 void GemmiWrapper::updateStructure(void * void_st, const std::string& filename, std::unordered_map<std::string, int>& entity_to_tax_id) {
     gemmi::Structure * st = (gemmi::Structure *) void_st;
 
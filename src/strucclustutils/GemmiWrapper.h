@@ -57,6 +57,7 @@ private:
     int chainIt;
 
     bool loadFoldcompStructure(std::istream& stream, const std::string& filename);
+    bool loadPdbBackbone(const char * buffer, size_t bufferSize, const std::string& filename);
     void updateStructure(void * structure, const std::string & filename, std::unordered_map<std::string, int>& entity_to_tax_id);
 };
 
@@ -40,8 +40,17 @@ lolAlign::lolAlign(unsigned int maxSeqLen, bool computeExactScore)
     target_x = (float *)mem_align(ALIGN_FLOAT, maxSeqLen * sizeof(float));
     target_y = (float *)mem_align(ALIGN_FLOAT, maxSeqLen * sizeof(float));
     target_z = (float *)mem_align(ALIGN_FLOAT, maxSeqLen * sizeof(float));
-    d_ij = malloc_matrix<float>(maxSeqLen, maxSeqLen);
-    d_kl = malloc_matrix<float>(maxSeqLen, maxSeqLen);
+    // padded so the distance rows can be written with full vector stores
+    const size_t bandLen = maxSeqLen + VECSIZE_FLOAT;
+    d_row_q = (float *)mem_align(ALIGN_FLOAT, bandLen * sizeof(float));
+    d_row_t = (float *)mem_align(ALIGN_FLOAT, bandLen * sizeof(float));
+    anchor_qx = (float *)mem_align(ALIGN_FLOAT, bandLen * sizeof(float));
+    anchor_qy = (float *)mem_align(ALIGN_FLOAT, bandLen * sizeof(float));
+    anchor_qz = (float *)mem_align(ALIGN_FLOAT, bandLen * sizeof(float));
+    anchor_tx = (float *)mem_align(ALIGN_FLOAT, bandLen * sizeof(float));
+    anchor_ty = (float *)mem_align(ALIGN_FLOAT, bandLen * sizeof(float));
+    anchor_tz = (float *)mem_align(ALIGN_FLOAT, bandLen * sizeof(float));
+    rowChanged = (unsigned char *)calloc(maxSeqLen, sizeof(unsigned char));
     //P = malloc_matrix<float>(maxSeqLen, maxSeqLen);
 }
 
@@ -55,8 +64,15 @@ lolAlign::~lolAlign()
     free(target_x);
     free(target_y);
     free(target_z);
-    free(d_ij);
-    free(d_kl);
+    free(d_row_q);
+    free(d_row_t);
+    free(anchor_qx);
+    free(anchor_qy);
+    free(anchor_qz);
+    free(anchor_tx);
+    free(anchor_ty);
+    free(anchor_tz);
+    free(rowChanged);
     free(P);
     free(G);
     free(anchor_query);
@@ -77,8 +93,6 @@ lolAlign::~lolAlign()
 
 
 void lolAlign::reallocate_target(size_t targetL){
-    free(d_kl);
-    d_kl = malloc_matrix<float>(targetL, targetL);
     free(G);
     G = malloc_matrix<float>(queryLen, targetL);
     free(P);
@@ -199,8 +213,6 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
         sa_scores[i] = 0;
     }
 
-    calc_dist_matrix(target_x, target_y, target_z, targetLen, d_kl, false);
-
     for(int sa = 0; sa < num_sa; sa++){
         anchor_length[sa] = 0;
         new_anchor_length[sa] = 0;
@@ -265,11 +277,13 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
         lol_score_vec[std::min(maxIndexX, maxIndexY)] += 200;
          
         for(int i = -start_anchor_length; i < start_anchor_length; i++){
+            calc_dist_row(query_x, query_y, query_z, maxIndexX+i, start_row, start_row + diag_length, d_row_q, true);
+            calc_dist_row(target_x, target_y, target_z, maxIndexY+i, start_col, start_col + diag_length, d_row_t, false);
             for(int j=0; j<diag_length; j++){
 
-                if(d_ij[maxIndexX+i][start_row + j] > 0){
+                if(d_row_q[j] > 0){
 
-                    lol_dist[j] = std::abs(d_ij[maxIndexX+i][start_row + j] - d_kl[maxIndexY+i][start_col+j]);
+                    lol_dist[j] = std::abs(d_row_q[j] - d_row_t[j]);
                     lol_seq_dist[j] =  std::copysign(1.0f, (maxIndexX+i - start_row + j)) * std::log(1 + std::abs((float)(maxIndexX+i - start_row + j)));
 
                     //std::cout << "diag_row_dist[" << j<< "]: " << diag_row_dist[j] - diag_col_dist[j] << std::endl;
@@ -306,6 +320,8 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
     for (int sa_it = 0; sa_it < SeedNumber; sa_it++){
         sa = sa_index[num_sa - sa_it -1];
         bool add_seq = true;
+        gapBlocks.clear();
+        std::fill(rowChanged, rowChanged + queryLen, 0);
         for(int iteration = 0; iteration < 1000; iteration++){
 
             gaps[0] = 0;
@@ -331,7 +347,7 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
                 
 
                 if (gaps[0] != -1){
-                    lolmatrix(anchor_query[sa], anchor_target[sa], new_anchor_length[sa], gaps, d_ij, d_kl, G, queryLen, targetLen, hidden_layer, lol_dist);
+                    lolmatrix(anchor_query[sa], anchor_target[sa], new_anchor_length[sa], gaps, target_x, target_y, target_z, G, queryLen, targetLen);
 
                 }
 
@@ -360,9 +376,31 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
             float maxP = 0.5;
             //float max_temp = 0.5;
 
+            // gaps come in increasing row order and do not overlap, so the blocks of the
+            // previous iteration can be matched with a single cursor
+            size_t prevBlock = 0;
+            nextGapBlocks.clear();
             while((gaps[1] < max_lolmat_idx && gaps[3] < targetLen)){
                 calc_gap(anchor_query[sa], anchor_target[sa], gaps, max_lolmat_idx, targetLen);
                 if(gaps[0] != -1){
+                    while (prevBlock < gapBlocks.size() && gapBlocks[prevBlock].rowStart < gaps[0]) {
+                        prevBlock++;
+                    }
+                    if (prevBlock < gapBlocks.size()) {
+                        const GapBlock &block = gapBlocks[prevBlock];
+                        bool unchanged = block.rowStart == gaps[0] && block.rowEnd == gaps[1]
+                                         && block.colStart == gaps[2] && block.colEnd == gaps[3]
+                                         && block.temperature == fwbwaln->temperature;
+                        for (int i = gaps[0]; unchanged && i < gaps[1]; ++i) {
+                            unchanged = (rowChanged[i] == 0);
+                        }
+                        if (unchanged) {
+                            // P still holds the probabilities of this gap
+                            maxP = std::max(maxP, block.maxP);
+                            nextGapBlocks.push_back(block);
+                            continue;
+                        }
+                    }
                     fwbwaln->initScoreMatrix(G, gaps);
                     fwbwaln->runFwBw<false, 0>(); 
                     float** fwbwP = fwbwaln->getProbabiltyMatrix();
@@ -377,6 +415,8 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
                         gaps[1] = 0;
                         gaps[2] = 0;
                         gaps[3] = 0;
+                        prevBlock = 0;
+                        nextGapBlocks.clear();
                         continue; 
                         
                     }
@@ -385,13 +425,16 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
                         // std::copy(fwbwaln->zm[i][0], fwbwaln->zm[i][(gaps[3] - gaps[2])], &P[i + gaps[0]][gaps[2]]);
                         std::copy(fwbwP[i], fwbwP[i] + (gaps[3] - gaps[2]), &P[i + gaps[0]][gaps[2]]);
                     }
-                    
+                    GapBlock block = { gaps[0], gaps[1], gaps[2], gaps[3], fwbwaln->temperature, fwbwaln->maxP };
+                    nextGapBlocks.push_back(block);
                 }
                 else{
                     break;
                 }         
             }
             fwbwaln->temperature = lol_T;
+            gapBlocks.swap(nextGapBlocks);
+            std::fill(rowChanged, rowChanged + queryLen, 0);
 
 
             new_anchor_length[sa] = 0;
@@ -428,6 +471,7 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
             if (new_anchor_length[sa] == 0){
                 if(!add_seq && md == 1){
                     add_seq = true;
+                    gapBlocks.clear();
                     lolAlign::addForwardScoreMatrix(
                         targetNumAA,
                         targetNum3Di,
@@ -476,22 +520,8 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
             }
         }
         computeDi_score(targetNumAA, targetNum3Di, anchor_length[sa], final_anchor_query, final_anchor_target, subMatAA, lol_score_vec);
-
-        for (int i = 0; i < anchor_length[sa]; i++) {
-            for (int j = 0;j < anchor_length[sa]; j++) {
-                if(d_ij[final_anchor_query[i]][final_anchor_query[j]] > 0.0){
-                    lol_dist[j] = std::abs(d_ij[final_anchor_query[i]][final_anchor_query[j]] - d_kl[final_anchor_target[i]][final_anchor_target[j]]);
-                    //anchor_dist_target[j] = d_kl[final_anchor_target[i]][final_anchor_target[j]];
-                    lol_seq_dist[j] = std::copysign(1.0f, (final_anchor_query[i]-final_anchor_query[j])) * std::log(1 + std::abs((float)(final_anchor_query[i]-final_anchor_query[j])));
-                }
-                else{
-                    lol_dist[j] = -1;
-                    lol_seq_dist[j] = -1;
-                }
-            }
-            lolscore(lol_dist, lol_seq_dist, lol_score_vec, anchor_length[sa], hidden_layer);
-
-        }
+        gather_anchor_coords(final_anchor_query, final_anchor_target, anchor_length[sa], target_x, target_y, target_z);
+        score_anchor_pairs(final_anchor_query, anchor_length[sa], false, lol_score_vec);
 
         float total_lol_score = 0.0;
         for (int i = 0; i < anchor_length[sa]; i++) {
@@ -531,38 +561,9 @@ Matcher::result_t lolAlign::align(unsigned int dbKey, float *target_x, float *ta
         lol_score_vec_sh[i] = 0;
         
     }
-    for (int i = 0; i < anchor_length[max_lol_idx]; i++) {
-        for (int j = 0;j < anchor_length[max_lol_idx]; j++) {
-            if(d_ij[final_anchor_query[i]][final_anchor_query[j]] > 0.0){
-                lol_dist[j] = 0;//std::abs(d_ij[final_anchor_query[i]][final_anchor_query[j]] - d_ij[final_anchor_query[i]][final_anchor_query[j]]);
-                //anchor_dist_target[j] = d_kl[final_anchor_target[i]][final_anchor_target[j]];
-                lol_seq_dist[j] = std::copysign(1.0f, (final_anchor_query[i]-final_anchor_query[j])) * std::log(1 + std::abs((float)(final_anchor_query[i]-final_anchor_query[j])));
-            }
-            else{
-                lol_dist[j] = -1;
-                lol_seq_dist[j] = -1;
-            }
-        }
-        lolscore(lol_dist, lol_seq_dist, lol_score_vec_sh, anchor_length[max_lol_idx], hidden_layer);
-
-    }
-
-
-    for (int i = 0; i < anchor_length[max_lol_idx]; i++) {
-        for (int j = 0;j < anchor_length[max_lol_idx]; j++) {
-            if(d_ij[final_anchor_query[i]][final_anchor_query[j]] > 0.0){
-                lol_dist[j] = std::abs(d_ij[final_anchor_query[i]][final_anchor_query[j]] - d_kl[final_anchor_target[i]][final_anchor_target[j]]);
-                //anchor_dist_target[j] = d_kl[final_anchor_target[i]][final_anchor_target[j]];
-                lol_seq_dist[j] = std::copysign(1.0f, (final_anchor_query[i]-final_anchor_query[j])) * std::log(1 + std::abs((float)(final_anchor_query[i]-final_anchor_query[j])));
-            }
-            else{
-                lol_dist[j] = -1;
-                lol_seq_dist[j] = -1;
-            }
-        }
-        lolscore(lol_dist, lol_seq_dist, lol_score_vec, anchor_length[max_lol_idx], hidden_layer);
-
-    }
+    gather_anchor_coords(final_anchor_query, final_anchor_target, anchor_length[max_lol_idx], target_x, target_y, target_z);
+    score_anchor_pairs(final_anchor_query, anchor_length[max_lol_idx], true, lol_score_vec_sh);
+    score_anchor_pairs(final_anchor_query, anchor_length[max_lol_idx], false, lol_score_vec);
 
     float norm_lol_sh = 0;
     float temp_nan_check = 0;
@@ -727,28 +728,62 @@ void lolAlign::align_startAnchors(int *anchor_query, int *anchor_target, int max
     }
 }
 
-void lolAlign::calc_dist_matrix(float* x, float* y, float* z, size_t len, float** d, bool cutoff){
+void lolAlign::calc_dist_row(const float* x, const float* y, const float* z, int row, int start, int end, float* d, bool cutoff){
     const float cutoff_distance = 20.0f;
-    const float cutoff_sq = cutoff_distance * cutoff_distance;
+    const float cutoff_sq = cutoff ? cutoff_distance * cutoff_distance : FLT_MAX;
+    const simd_float xr = simdf32_set(x[row]);
+    const simd_float yr = simdf32_set(y[row]);
+    const simd_float zr = simdf32_set(z[row]);
+    const simd_float cutoff_vec = simdf32_set(cutoff_sq);
+    int j = start;
+    for (; j + VECSIZE_FLOAT <= end; j += VECSIZE_FLOAT){
+        simd_float dx = simdf32_sub(xr, simdf32_loadu(&x[j]));
+        simd_float dy = simdf32_sub(yr, simdf32_loadu(&y[j]));
+        simd_float dz = simdf32_sub(zr, simdf32_loadu(&z[j]));
+        simd_float dist_sq = simdf32_add(simdf32_fmadd(dx, dx, simdf32_mul(dy, dy)), simdf32_mul(dz, dz));
+        // distances beyond the cutoff are stored as 0
+        simd_float dist = simdf32_andnot(simdf32_gt(dist_sq, cutoff_vec), simdf32_sqrt(dist_sq));
+        simdf32_storeu(&d[j - start], dist);
+    }
+    for (; j < end; ++j){
+        float dx = x[row] - x[j];
+        float dy = y[row] - y[j];
+        float dz = z[row] - z[j];
 
-    for (size_t i = 0; i < len; ++i){
-        d[i][i] = 0.0f;
-        for (size_t j = i + 1; j < len; ++j){
-            float dx = x[i] - x[j];
-            float dy = y[i] - y[j];
-            float dz = z[i] - z[j];
+        float dist_sq = dx * dx + dy * dy + dz * dz;
+        d[j - start] = (dist_sq > cutoff_sq) ? 0.0f : std::sqrt(dist_sq);
+    }
+}
 
-            float dist_sq = dx * dx + dy * dy + dz * dz;
+void lolAlign::gather_anchor_coords(int * final_anchor_query, int * final_anchor_target, int anchor_length, float *tx, float *ty, float *tz){
+    for (int i = 0; i < anchor_length; i++) {
+        anchor_qx[i] = query_x[final_anchor_query[i]];
+        anchor_qy[i] = query_y[final_anchor_query[i]];
+        anchor_qz[i] = query_z[final_anchor_query[i]];
+        anchor_tx[i] = tx[final_anchor_target[i]];
+        anchor_ty[i] = ty[final_anchor_target[i]];
+        anchor_tz[i] = tz[final_anchor_target[i]];
+    }
+}
 
-            if (cutoff && dist_sq > cutoff_sq){
-                d[i][j] = 0.0f;
+// scores all anchor pairs with the gathered anchor coordinates, self compares the query with itself
+void lolAlign::score_anchor_pairs(int * final_anchor_query, int anchor_length, bool self, float * score){
+    for (int i = 0; i < anchor_length; i++) {
+        calc_dist_row(anchor_qx, anchor_qy, anchor_qz, i, 0, anchor_length, d_row_q, true);
+        if (self == false) {
+            calc_dist_row(anchor_tx, anchor_ty, anchor_tz, i, 0, anchor_length, d_row_t, false);
+        }
+        for (int j = 0; j < anchor_length; j++) {
+            if(d_row_q[j] > 0.0){
+                lol_dist[j] = self ? 0 : std::abs(d_row_q[j] - d_row_t[j]);
+                lol_seq_dist[j] = std::copysign(1.0f, (final_anchor_query[i]-final_anchor_query[j])) * std::log(1 + std::abs((float)(final_anchor_query[i]-final_anchor_query[j])));
             }
             else{
-                float dist = std::sqrt(dist_sq);
-                d[i][j] = dist;
+                lol_dist[j] = -1;
+                lol_seq_dist[j] = -1;
             }
-            d[j][i] = d[i][j]; 
         }
+        lolscore(lol_dist, lol_seq_dist, score, anchor_length, hidden_layer);
     }
 }
 
@@ -799,7 +834,6 @@ void lolAlign::initQuery(float *x, float *y, float *z, Sequence& qSeqAA, Sequenc
     lol_score_vec_sh = (float *)mem_align(ALIGN_FLOAT, maxTLen * sizeof(float));
     final_anchor_query = new int[maxTLen];
     final_anchor_target = new int[maxTLen];
-    calc_dist_matrix(query_x, query_y, query_z, queryLen, d_ij, true);
     for(int i = 0; i < queryLen; i++){
         final_anchor_query[i] = i;
     }
@@ -815,21 +849,10 @@ void lolAlign::initQuery(float *x, float *y, float *z, Sequence& qSeqAA, Sequenc
 
 
 
-    for(int i = 0; i < queryLen; i++){
-        for(int j=0; j < queryLen; j++){
-            if(d_ij[i][j] > 0){
-
-                lol_dist[j] = 0;
-                lol_seq_dist[j] =  std::copysign(1.0f, (i-j)) * std::log(1 + std::abs((float)(i-j)));
-
-            }
-            else{
-                lol_dist[j] = -1;
-                lol_seq_dist[j] = -1;
-            }
-        }
-        lolscore(lol_dist, lol_seq_dist, lol_score_vec, queryLen, hidden_layer);
-    }
+    memcpy(anchor_qx, query_x, sizeof(float) * queryLen);
+    memcpy(anchor_qy, query_y, sizeof(float) * queryLen);
+    memcpy(anchor_qz, query_z, sizeof(float) * queryLen);
+    score_anchor_pairs(final_anchor_query, queryLen, true, lol_score_vec);
 
 
 
@@ -849,7 +872,7 @@ void lolAlign::initQuery(float *x, float *y, float *z, Sequence& qSeqAA, Sequenc
     return;
 }
 
-void lolAlign::lolmatrix(int *anchor_query, int *anchor_target, int anchor_length, int *gaps, float **d_ij, float **d_kl, float **G, int queryLen, int targetLen, float ** hidden_layer, float * d_dist)
+void lolAlign::lolmatrix(int *anchor_query, int *anchor_target, int anchor_length, int *gaps, float *tx, float *ty, float *tz, float **G, int queryLen, int targetLen)
 {
     int gap0_start = gaps[0];
     int gap0_end = gaps[1];
@@ -879,22 +902,20 @@ void lolAlign::lolmatrix(int *anchor_query, int *anchor_target, int anchor_lengt
         }
         
 
+        // only the distance bands of the current anchor pair within the gap are needed
+        calc_dist_row(query_x, query_y, query_z, anchor_q, gap0_start, gap0_end, d_row_q, true);
+        calc_dist_row(tx, ty, tz, anchor_t, gap1_start, gap1_end, d_row_t, false);
         for (int j = gap0_start; j < gap0_end; j++)
         {
-            float dq = d_ij[anchor_q][j];
+            float dq = d_row_q[j - gap0_start];
 
             if (dq > 0)
             {
                 min_lolmat_idx = std::min(min_lolmat_idx, j);
                 max_lolmat_idx = std::max(max_lolmat_idx, j+1); 
                 seq_dist = std::copysign(1.0f, (anchor_q-j)) * std::log(1 + std::abs((float)(anchor_q-j)));
-                for(int l = gap1_start; l < gap1_end; l++)
-                {
-                    d_dist[l - gap1_start] = std::abs(dq- d_kl[anchor_t][l]);
-
-                    //seq_dist[l - gap1_start] = std::copysign(1.0f, (anchor_q-j)) * std::log(1 + std::abs((float)(anchor_q-j)));
-                }
-                lolscore(d_dist, seq_dist, G[j], gap1_end - gap1_start, gap1_start, hidden_layer);
+                lolscore(dq, d_row_t, seq_dist, G[j], gap1_end - gap1_start, gap1_start);
+                rowChanged[j] = 1;
             }
         }
     }
@@ -902,53 +923,44 @@ void lolAlign::lolmatrix(int *anchor_query, int *anchor_target, int anchor_lengt
 }
 
 
-void lolAlign::lolscore(float* d_dist, float d_seq, float* score, int length, int start, float** hidden_layer)
+void lolAlign::lolscore(float dq, const float* d_target, float d_seq, float* score, int length, int start)
 {
-     // Zero vector for ReLU
-
-    // Process 8 elements at a time
+    // fused |dq - d_target| and MLP evaluation, hidden layer values stay in registers
+    const simd_float dq_vec = simdf32_set(dq);
+    const simd_float sign_mask = simdf32_set(-0.0f);
     simd_float seq0 = simdf32_mul(simdf32_set(d_seq), w1_0);
     simd_float seq1 = simdf32_mul(simdf32_set(d_seq), w1_1);
     simd_float seq2 = simdf32_mul(simdf32_set(d_seq), w1_2);
     int i = 0;
     for (; i <= length - VECSIZE_FLOAT; i += VECSIZE_FLOAT) {
-        // Load d_dist[i..i+7] into a SIMD register
-        simd_float d_dist_vec = simdf32_loadu(&d_dist[i]);
+        simd_float d_dist_vec = simdf32_andnot(sign_mask, simdf32_sub(dq_vec, simdf32_loadu(&d_target[i])));
 
-        // Compute hidden_layer[i][k] for k = 0, 1, 2
         simd_float hl_0 = simdf32_add(seq0, simdf32_fmadd(d_dist_vec, w1_d0, b1_0));
         simd_float hl_1 = simdf32_add(seq1, simdf32_fmadd(d_dist_vec, w1_d1, b1_1));
         simd_float hl_2 = simdf32_add(seq2, simdf32_fmadd(d_dist_vec, w1_d2, b1_2));
 
-        // Apply ReLU (max(0, x))
+        // ReLU
         hl_0 = simdf32_max(hl_0, zero);
         hl_1 = simdf32_max(hl_1, zero);
         hl_2 = simdf32_max(hl_2, zero);
 
-        // Store hidden_layer[i][k] back to memory
-        simdf32_storeu(&hidden_layer[i][0], hl_0);
-        simdf32_storeu(&hidden_layer[i][1], hl_1);
-        simdf32_storeu(&hidden_layer[i][2], hl_2);
-
-        // Compute score[i+start] += hidden_layer[i][k] * w2[k] for k = 0, 1, 2
         simd_float score_vec = simdf32_loadu(&score[i + start]);
         score_vec = simdf32_fmadd(hl_0, w2_0, score_vec);
         score_vec = simdf32_fmadd(hl_1, w2_1, score_vec);
         score_vec = simdf32_fmadd(hl_2, w2_2, score_vec);
         score_vec = simdf32_add(score_vec, b2_vec);
 
-        // Store the updated score back to memory
         simdf32_storeu(&score[i + start], score_vec);
     }
 
-    // Process remaining elements (if length is not a multiple of 8)
     for (; i < length; ++i) {
+        float d_dist = std::abs(dq - d_target[i]);
         for (int k = 0; k < 3; ++k) {
-            hidden_layer[i][k] = d_seq * w1[0][k];
-            hidden_layer[i][k] += d_dist[i] * w1[1][k];
-            hidden_layer[i][k] += b1[k];
-            hidden_layer[i][k] = std::max(0.0f, hidden_layer[i][k]);
-            score[i + start] += hidden_layer[i][k] * w2[k];
+            float hl = d_seq * w1[0][k];
+            hl += d_dist * w1[1][k];
+            hl += b1[k];
+            hl = std::max(0.0f, hl);
+            score[i + start] += hl * w2[k];
         }
         score[i + start] += b2;
     }
@@ -1013,6 +1025,79 @@ void lolAlign::addForwardScoreMatrix(
 
 
 
+struct LolalignJob {
+    size_t id;
+    size_t queryLen;
+    size_t colLen;
+};
+
+struct LolalignBucket {
+    size_t start;
+    size_t end;
+    size_t colLen;
+    int threads;
+};
+
+static size_t lolalignBucketKey(size_t colLen) {
+    size_t key = 256;
+    while (key < colLen) {
+        key *= 2;
+    }
+    return key;
+}
+
+// G and P of lolAlign plus zm and scoreForward of FwBwAligner dominate, the rest is linear
+static size_t lolalignThreadMemory(size_t rowLen, size_t colLen) {
+    return 4 * rowLen * colLen * sizeof(float) + 16 * (rowLen + colLen) * sizeof(float);
+}
+
+// Groups the queries by the power of two above their longest hit, so every bucket can size
+// its per-thread buffers to its own longest entry and use as many threads as the budget allows
+static std::vector<LolalignBucket> bucketLolalignJobs(std::vector<LolalignJob> &jobs, size_t memoryLimit, int maxThreads) {
+    std::sort(jobs.begin(), jobs.end(), [](const LolalignJob &a, const LolalignJob &b) {
+        size_t keyA = lolalignBucketKey(a.colLen);
+        size_t keyB = lolalignBucketKey(b.colLen);
+        if (keyA != keyB) {
+            return keyA < keyB;
+        }
+        // longest first for better load balancing with dynamic scheduling
+        size_t costA = a.queryLen * a.colLen;
+        size_t costB = b.queryLen * b.colLen;
+        if (costA != costB) {
+            return costA > costB;
+        }
+        return a.id < b.id;
+    });
+
+    std::vector<LolalignBucket> buckets;
+    size_t start = 0;
+    while (start < jobs.size()) {
+        size_t key = lolalignBucketKey(jobs[start].colLen);
+        size_t end = start;
+        size_t rowLen = 0;
+        size_t colLen = 0;
+        while (end < jobs.size() && lolalignBucketKey(jobs[end].colLen) == key) {
+            rowLen = std::max(rowLen, jobs[end].queryLen);
+            colLen = std::max(colLen, jobs[end].colLen);
+            end++;
+        }
+        size_t threadMemory = lolalignThreadMemory(rowLen, colLen);
+        size_t threads = std::max(static_cast<size_t>(1), memoryLimit / std::max(threadMemory, static_cast<size_t>(1)));
+        if (threadMemory > memoryLimit) {
+            Debug(Debug::WARNING) << "lolalign needs " << ((threadMemory + (1 << 20) - 1) >> 20) << "MB for queries up to " << rowLen
+                                  << " and targets up to " << colLen << " residues, which exceeds the memory limit\n";
+        }
+        LolalignBucket bucket;
+        bucket.start = start;
+        bucket.end = end;
+        bucket.colLen = colLen;
+        bucket.threads = static_cast<int>(std::min(threads, static_cast<size_t>(maxThreads)));
+        buckets.push_back(bucket);
+        start = end;
+    }
+    return buckets;
+}
+
 int lolalign(int argc, const char **argv, const Command &command) {
     LocalParameters &par = LocalParameters::getLocalInstance();
     par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
@@ -1103,131 +1188,204 @@ int lolalign(int argc, const char **argv, const Command &command) {
         dbtype = DBReader<unsigned int>::setExtendedDbtype(dbtype, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
     }
 
-    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed, dbtype);
-    dbw.open();
 
     //fwbw aligner
     size_t blockLen_fwbw = 16;
     float gapOpen_fwbw = -2.0;
     float gapExtend_fwbw = -2.0;
     float temperature_fwbw = 2.0;
-    int max_targetLen = static_cast<int>(tdbr->sequenceReader->getMaxSeqLen() + 1);
-    max_targetLen = ((max_targetLen + blockLen_fwbw -1) / blockLen_fwbw) * blockLen_fwbw;
 
-    Debug::Progress progress(resultReader.getSize());
+    // the dense per-thread buffers grow with queryLen x targetLen, so size them by the
+    // longest hit of each query instead of the longest sequence of the target database
+    const size_t resultSize = resultReader.getSize();
+    std::vector<LolalignJob> jobs(resultSize);
 #pragma omp parallel
     {
         unsigned int thread_idx = 0;
 #ifdef OPENMP
         thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-        
-        std::vector<Matcher::result_t> swResults;
-        swResults.reserve(300);
-        std::string backtrace;
-        std::string resultBuffer;
-        resultBuffer.reserve(1024 * 1024);
-        Coordinate16 qcoords;
-        Coordinate16 tcoords;
-
-        Sequence qSeqAA(par.maxSeqLen, qdbr.sequenceReader->getDbtype(), (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
-        Sequence qSeq3Di(par.maxSeqLen, qdbr3Di.sequenceReader->getDbtype(), (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
-        Sequence tSeqAA(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
-        Sequence tSeq3Di(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
-        FwBwAligner fwbwaln(gapOpen_fwbw, gapExtend_fwbw, temperature_fwbw, 0, 1, max_targetLen, blockLen_fwbw, 0);
-        char buffer[1024 + 32768];
-
-#pragma omp for schedule(dynamic, 1)
-        for (size_t id = 0; id < resultReader.getSize(); id++) {
-            progress.updateProgress();
-            size_t queryKey = resultReader.getDbKey(id);
+#pragma omp for schedule(static)
+        for (size_t id = 0; id < resultSize; id++) {
             char *data = resultReader.getData(id, thread_idx);
+            size_t maxLen = 0;
+            size_t queryLen = 0;
             if (*data != '\0') {
-                unsigned int queryId = qdbr.sequenceReader->getId(queryKey);
-
-                char *querySeq = qdbr.sequenceReader->getData(queryId, thread_idx);
-                char *query3diSeq = qdbr3Di.sequenceReader->getData(queryId, thread_idx);
-                int queryLen = static_cast<int>(qdbr.sequenceReader->getSeqLen(queryId));
-                qSeqAA.mapSequence(id, queryKey, querySeq, queryLen);
-                qSeq3Di.mapSequence(id, queryKey, query3diSeq, queryLen);
+                unsigned int queryId = qdbr.sequenceReader->getId(resultReader.getDbKey(id));
+                queryLen = qdbr.sequenceReader->getSeqLen(queryId);
+                maxLen = queryLen;
+                while (*data != '\0') {
+                    const unsigned int dbKey = Util::fast_atoi<unsigned int>(data);
+                    maxLen = std::max(maxLen, tdbr->sequenceReader->getSeqLen(tdbr->sequenceReader->getId(dbKey)));
+                    data = Util::skipLine(data);
+                }
+            }
+            jobs[id].id = id;
+            jobs[id].queryLen = queryLen;
+            jobs[id].colLen = ((maxLen + 1 + blockLen_fwbw - 1) / blockLen_fwbw) * blockLen_fwbw;
+        }
+    }
+    std::vector<LolalignBucket> buckets = bucketLolalignJobs(jobs, Util::computeMemory(par.splitMemoryLimit), par.threads);
 
-                char *qcadata = qcadbr.sequenceReader->getData(queryId, thread_idx);
-                size_t qCaLength = qcadbr.sequenceReader->getEntryLen(queryId);
-                float *qdata = qcoords.read(qcadata, queryLen, qCaLength);
+    // the bucket order breaks the entry order of the data file, restore the input order at the end
+    bool needsReorder = false;
+    for (size_t j = 0; j < jobs.size() && needsReorder == false; j++) {
+        needsReorder = (jobs[j].id != j);
+    }
+    const std::pair<std::string, std::string> unsortedDb = Util::databaseNames(par.db4 + "_tmp");
+    DBWriter dbw(needsReorder ? unsortedDb.first.c_str() : par.db4.c_str(), needsReorder ? unsortedDb.second.c_str() : par.db4Index.c_str(),
+                 static_cast<unsigned int>(par.threads), par.compressed, dbtype);
+    dbw.open();
 
-                lolAlign lolaln(std::max(qdbr.sequenceReader->getMaxSeqLen() + 1, tdbr->sequenceReader->getMaxSeqLen() + 1), false);
-                lolaln.initQuery(qdata, &qdata[queryLen], &qdata[queryLen + queryLen], qSeqAA, qSeq3Di, queryLen, subMatAA, max_targetLen, par.multiDomain);
-                fwbwaln.resizeMatrix<false, 0>(queryLen, max_targetLen);
+    Debug::Progress progress(resultSize);
+    for (size_t b = 0; b < buckets.size(); b++) {
+        const LolalignBucket &bucket = buckets[b];
+        if (bucket.threads < par.threads) {
+            Debug(Debug::INFO) << "Limit lolalign to " << bucket.threads << " threads for targets up to " << bucket.colLen << " residues\n";
+        }
+        const int max_targetLen = static_cast<int>(bucket.colLen);
+#pragma omp parallel num_threads(bucket.threads)
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        
+            std::vector<Matcher::result_t> swResults;
+            swResults.reserve(300);
+            std::string backtrace;
+            std::string resultBuffer;
+            resultBuffer.reserve(1024 * 1024);
+            Coordinate16 qcoords;
+            Coordinate16 tcoords;
+
+            Sequence qSeqAA(par.maxSeqLen, qdbr.sequenceReader->getDbtype(), (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
+            Sequence qSeq3Di(par.maxSeqLen, qdbr3Di.sequenceReader->getDbtype(), (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
+            Sequence tSeqAA(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
+            Sequence tSeq3Di(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
+            FwBwAligner fwbwaln(gapOpen_fwbw, gapExtend_fwbw, temperature_fwbw, 0, 1, max_targetLen, blockLen_fwbw, 0);
+            fwbwaln.setExactExp(par.exactFwbw);
+            char buffer[1024 + 32768];
 
-                if (queryLen <= 10) {
-                    lolaln.set_start_anchor_length(0);
-                }
+#pragma omp for schedule(dynamic, 1)
+            for (size_t j = bucket.start; j < bucket.end; j++) {
+                progress.updateProgress();
+                size_t id = jobs[j].id;
+                size_t queryKey = resultReader.getDbKey(id);
+                char *data = resultReader.getData(id, thread_idx);
+                if (*data != '\0') {
+                    unsigned int queryId = qdbr.sequenceReader->getId(queryKey);
+
+                    char *querySeq = qdbr.sequenceReader->getData(queryId, thread_idx);
+                    char *query3diSeq = qdbr3Di.sequenceReader->getData(queryId, thread_idx);
+                    int queryLen = static_cast<int>(qdbr.sequenceReader->getSeqLen(queryId));
+                    qSeqAA.mapSequence(id, queryKey, querySeq, queryLen);
+                    qSeq3Di.mapSequence(id, queryKey, query3diSeq, queryLen);
+
+                    char *qcadata = qcadbr.sequenceReader->getData(queryId, thread_idx);
+                    size_t qCaLength = qcadbr.sequenceReader->getEntryLen(queryId);
+                    float *qdata = qcoords.read(qcadata, queryLen, qCaLength);
+
+                    lolAlign lolaln(std::max(qdbr.sequenceReader->getMaxSeqLen() + 1, tdbr->sequenceReader->getMaxSeqLen() + 1), false);
+                    lolaln.initQuery(qdata, &qdata[queryLen], &qdata[queryLen + queryLen], qSeqAA, qSeq3Di, queryLen, subMatAA, max_targetLen, par.multiDomain);
+                    fwbwaln.resizeMatrix<false, 0>(queryLen, max_targetLen);
+
+                    if (queryLen <= 10) {
+                        lolaln.set_start_anchor_length(0);
+                    }
 
-                int passedNum = 0;
-                int rejected = 0;
-                while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
-                    char dbKeyBuffer[255 + 1];
-                    Util::parseKey(data, dbKeyBuffer);
-                    data = Util::skipLine(data);
-                    const unsigned int dbKey = (unsigned int)strtoul(dbKeyBuffer, NULL, 10);
-                    unsigned int targetId = tdbr->sequenceReader->getId(dbKey);
-
-                    char *targetSeq = tdbr->sequenceReader->getData(targetId, thread_idx);
-                    int targetLen = static_cast<int>(tdbr->sequenceReader->getSeqLen(targetId));
-                    tSeqAA.mapSequence(targetId, dbKey, targetSeq, targetLen);
-
-                    char *target3diSeq = tdbr3Di->sequenceReader->getData(targetId, thread_idx);
-                    tSeq3Di.mapSequence(targetId, dbKey, target3diSeq, targetLen);
-                    // if (targetLen > max_targetLen) {
-                    //     max_targetLen = ((targetLen*2)/16)*16;
-                    //     lolaln.reallocate_target(max_targetLen);
-                    //     fwbwaln.resizeMatrix(queryLen, max_targetLen);
-                    //     std::cout << "Reallocating target to: " << max_targetLen << std::endl;
-                    // }
-                    // if (Util::canBeCovered(par.covThr, par.covMode, queryLen, targetLen) == false) {
-                    //     continue;
-                    // }
-
-                    char *tcadata = tcadbr->sequenceReader->getData(targetId, thread_idx);
-                    size_t tCaLength = tcadbr->sequenceReader->getEntryLen(targetId);
-                    float *tdata = tcoords.read(tcadata, targetLen, tCaLength);
-
-                    Matcher::result_t result;
-                    if (targetLen <= 10) {
-                        lolaln.set_start_anchor_length(1);
-                        if (targetLen < 4) {
-                            lolaln.set_start_anchor_length(0);
-                        }
-                        result = lolaln.align(dbKey, tdata, &tdata[targetLen], &tdata[targetLen + targetLen], tSeqAA, tSeq3Di, targetLen, subMatAA, &fwbwaln, par.multiDomain);
-                        if (queryLen > 10) {
-                            lolaln.set_start_anchor_length(3);
+                    int passedNum = 0;
+                    int rejected = 0;
+                    while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
+                        char dbKeyBuffer[255 + 1];
+                        Util::parseKey(data, dbKeyBuffer);
+                        data = Util::skipLine(data);
+                        const unsigned int dbKey = (unsigned int)strtoul(dbKeyBuffer, NULL, 10);
+                        unsigned int targetId = tdbr->sequenceReader->getId(dbKey);
+
+                        char *targetSeq = tdbr->sequenceReader->getData(targetId, thread_idx);
+                        int targetLen = static_cast<int>(tdbr->sequenceReader->getSeqLen(targetId));
+                        tSeqAA.mapSequence(targetId, dbKey, targetSeq, targetLen);
+
+                        char *target3diSeq = tdbr3Di->sequenceReader->getData(targetId, thread_idx);
+                        tSeq3Di.mapSequence(targetId, dbKey, target3diSeq, targetLen);
+                        // if (targetLen > max_targetLen) {
+                        //     max_targetLen = ((targetLen*2)/16)*16;
+                        //     lolaln.reallocate_target(max_targetLen);
+                        //     fwbwaln.resizeMatrix(queryLen, max_targetLen);
+                        //     std::cout << "Reallocating target to: " << max_targetLen << std::endl;
+                        // }
+                        // if (Util::canBeCovered(par.covThr, par.covMode, queryLen, targetLen) == false) {
+                        //     continue;
+                        // }
+
+                        char *tcadata = tcadbr->sequenceReader->getData(targetId, thread_idx);
+                        size_t tCaLength = tcadbr->sequenceReader->getEntryLen(targetId);
+                        float *targetX, *targetY, *targetZ;
+                        tcoords.readAligned(tcadata, targetLen, tCaLength, targetX, targetY, targetZ);
+
+                        Matcher::result_t result;
+                        if (targetLen <= 10) {
+                            lolaln.set_start_anchor_length(1);
+                            if (targetLen < 4) {
+                                lolaln.set_start_anchor_length(0);
+                            }
+                            result = lolaln.align(dbKey, targetX, targetY, targetZ, tSeqAA, tSeq3Di, targetLen, subMatAA, &fwbwaln, par.multiDomain);
+                            if (queryLen > 10) {
+                                lolaln.set_start_anchor_length(3);
+                            }
+                        } else {
+                            result = lolaln.align(dbKey, targetX, targetY, targetZ, tSeqAA, tSeq3Di, targetLen, subMatAA, &fwbwaln, par.multiDomain);
                         }
-                    } else {
-                        result = lolaln.align(dbKey, tdata, &tdata[targetLen], &tdata[targetLen + targetLen], tSeqAA, tSeq3Di, targetLen, subMatAA, &fwbwaln, par.multiDomain);
-                    }
 
-                    bool hasCov = Util::hasCoverage(par.covThr, par.covMode, 1.0, 1.0);
-                    bool hasSeqId = result.seqId >= (par.seqIdThr - std::numeric_limits<float>::epsilon());
-                    //bool hasTMscore = (TMscore >= par.tmScoreThr);
+                        bool hasCov = Util::hasCoverage(par.covThr, par.covMode, 1.0, 1.0);
+                        bool hasSeqId = result.seqId >= (par.seqIdThr - std::numeric_limits<float>::epsilon());
+                        //bool hasTMscore = (TMscore >= par.tmScoreThr);
 
-                    if (hasCov && hasSeqId) {
-                        swResults.emplace_back(result);
+                        if (hasCov && hasSeqId) {
+                            swResults.emplace_back(result);
+                        }
                     }
-                }
                 
-                SORT_SERIAL(swResults.begin(), swResults.end(), compareHitsBylolScore);
-                for (size_t i = 0; i < swResults.size(); i++) {
-                    size_t len = Matcher::resultToBuffer(buffer, swResults[i], par.addBacktrace, false);
-                    resultBuffer.append(buffer, len);
+                    SORT_SERIAL(swResults.begin(), swResults.end(), compareHitsBylolScore);
+                    for (size_t i = 0; i < swResults.size(); i++) {
+                        size_t len = Matcher::resultToBuffer(buffer, swResults[i], par.addBacktrace, false);
+                        resultBuffer.append(buffer, len);
+                    }
+                    swResults.clear();
                 }
-                swResults.clear();
-            }
 
-            dbw.writeData(resultBuffer.c_str(), resultBuffer.size(), queryKey, thread_idx);
-            resultBuffer.clear();
+                dbw.writeData(resultBuffer.c_str(), resultBuffer.size(), queryKey, thread_idx);
+                resultBuffer.clear();
+            }
         }
     }
     dbw.close();
+    if (needsReorder) {
+        DBReader<unsigned int> unsortedReader(unsortedDb.first.c_str(), unsortedDb.second.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        unsortedReader.open(DBReader<unsigned int>::NOSORT);
+        unsortedReader.readMmapedDataInMemory();
+        DBWriter sortedWriter(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed, dbtype);
+        sortedWriter.open();
+#pragma omp parallel
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+#pragma omp for schedule(static)
+            for (size_t id = 0; id < resultSize; id++) {
+                unsigned int key = resultReader.getDbKey(id);
+                size_t unsortedId = unsortedReader.getId(key);
+                char *data = unsortedReader.getData(unsortedId, thread_idx);
+                size_t length = unsortedReader.getEntryLen(unsortedId);
+                sortedWriter.writeData(data, (length == 0 ? 0 : length - 1), key, thread_idx);
+            }
+        }
+        sortedWriter.close(true);
+        unsortedReader.close();
+        DBReader<unsigned int>::removeDb(unsortedDb.first);
+    }
     resultReader.close();
     if (sameDB == false) {
         delete tdbr;
@@ -58,15 +58,18 @@ public:
                                             float T, float go, float ge,
                                             size_t rows, size_t start, size_t end, size_t memcpy_cols, size_t targetlen,
                                             float** zm, float* zmax, float** zmBlock, float* zeBlock, float* zfBlock, int* gaps);
-    void calc_dist_matrix(float *x, float *y, float *z, size_t len, float **d, bool cutoff);
+    // distances of residue row to the residues [start, end), written to d[0, end - start)
+    void calc_dist_row(const float *x, const float *y, const float *z, int row, int start, int end, float *d, bool cutoff);
     void reallocate_target(size_t targetL);
     float calc_discore(int * anchor_query, int * anchor_target, int anchor_length);
-    void lolmatrix(int *anchor_query, int* anchor_target,int anchor_length, int *gaps, float **d_ij, float **d_kl, float **G, int queryLen, int targetLen, float ** hidden_layer, float * d_dist);
+    void gather_anchor_coords(int * final_anchor_query, int * final_anchor_target, int anchor_length, float *tx, float *ty, float *tz);
+    void score_anchor_pairs(int * final_anchor_query, int anchor_length, bool self, float * score);
+    void lolmatrix(int *anchor_query, int* anchor_target,int anchor_length, int *gaps, float *tx, float *ty, float *tz, float **G, int queryLen, int targetLen);
     void lolscore(float* dist, float* d_seq, float* score, int length, float** hidden_layer);
     void set_start_anchor_length(int length) {start_anchor_length = length;}
     
 
-    void lolscore(float* d_dist, float d_seq, float* score, int length, int start, float** hidden_layer);
+    void lolscore(float dq, const float* d_target, float d_seq, float* score, int length, int start);
     void computeDi_score(
         unsigned char * targetNumAA,
         unsigned char *targetNum3Di,
@@ -86,9 +89,29 @@ private:
     float * target_z;
     float ** scoreForward;
     float ** P;
-    float ** d_ij;
-    float ** d_kl;
+    // distance bands computed on the fly instead of full query/target distance matrices
+    float * d_row_q;
+    float * d_row_t;
+    float * anchor_qx;
+    float * anchor_qy;
+    float * anchor_qz;
+    float * anchor_tx;
+    float * anchor_ty;
+    float * anchor_tz;
     float ** G;
+    // probability blocks of the previous lol iteration, a gap keeps its block while its bounds,
+    // its temperature and its rows of G stay unchanged
+    struct GapBlock {
+        int rowStart;
+        int rowEnd;
+        int colStart;
+        int colEnd;
+        float temperature;
+        float maxP;
+    };
+    std::vector<GapBlock> gapBlocks;
+    std::vector<GapBlock> nextGapBlocks;
+    unsigned char * rowChanged;
     int ** anchor_query;
     int ** anchor_target;
     int num_sa = 10;
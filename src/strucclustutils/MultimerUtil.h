@@ -4,6 +4,9 @@
 #include "MemoryMapped.h"
 #include "TMaligner.h"
 #include "IndexReader.h"
+#include "DBWriter.h"
+#include "FileUtil.h"
+#include "StructureAlignStages.h"
 
 const unsigned int NOT_AVAILABLE_CHAIN_KEY = std::numeric_limits<uint32_t>::max();
 const float MAX_ASSIGNED_CHAIN_RATIO = 1.0;
@@ -17,9 +20,12 @@ const float TM_SCORE_MARGIN = 0.7;
 const unsigned int MULTIPLE_CHAINED_COMPLEX = 2;
 const unsigned int SIZE_OF_SUPERPOSITION_VECTOR = 12;
 const int SKIP_MONOMERS = 1;
-typedef std::pair<std::string, std::string> compNameChainName_t;
-typedef std::map<unsigned int, unsigned int> chainKeyToComplexId_t;
-typedef std::map<unsigned int, std::vector<unsigned int>> complexIdToChainKeys_t;
+// chains with identical sequences are copies if their C-alphas superpose within this RMSD.
+// Coordinates are stored with 0.001 precision
+const float SYMMETRY_RMSD_THRESHOLD = 0.01;
+// tolerances to match the rigid motion of one copy onto another
+const float SYMMETRY_ROTATION_TOLERANCE = 0.001;
+const float SYMMETRY_CENTER_TOLERANCE = 0.1;
 typedef std::vector<unsigned int> cluster_t;
 typedef std::string resultToWrite_t;
 typedef std::string chainName_t;
@@ -30,34 +36,61 @@ struct Chain {
     Chain(unsigned int complexId, unsigned int chainKey) : complexId(complexId), chainKey(chainKey) {}
     unsigned int complexId;
     unsigned int chainKey;
-    std::vector<float> caVecX;
-    std::vector<float> caVecY;
-    std::vector<float> caVecZ;
+};
+
+// aligned C-alpha pairs of all chain alignments of one query complex in SoA form. Chain alignments
+// only keep their offset, so copying them does not copy coordinates and the buffers are reused
+struct AlignedCaArena {
+    std::vector<float> qX;
+    std::vector<float> qY;
+    std::vector<float> qZ;
+    std::vector<float> dbX;
+    std::vector<float> dbY;
+    std::vector<float> dbZ;
+
+    size_t size() const {
+        return qX.size();
+    }
+
+    void resize(size_t size) {
+        qX.resize(size);
+        qY.resize(size);
+        qZ.resize(size);
+        dbX.resize(size);
+        dbY.resize(size);
+        dbZ.resize(size);
+    }
+
+    void clear() {
+        resize(0);
+    }
 };
 
 struct ChainToChainAln {
     ChainToChainAln() {}
-    ChainToChainAln(Chain &queryChain, Chain &targetChain, float *qCaData, float *dbCaData, Matcher::result_t &alnResult, TMaligner::TMscoreResult &tmResult) : qChain(queryChain), dbChain(targetChain), tmScore((float)tmResult.tmscore) {
+    ChainToChainAln(Chain &queryChain, Chain &targetChain, float *qCaData, float *dbCaData, Matcher::result_t &alnResult, TMaligner::TMscoreResult &tmResult, AlignedCaArena &arena) : qChain(queryChain), dbChain(targetChain), tmScore((float)tmResult.tmscore) {
         alnLength = alnResult.alnLength;
-        matches = 0;
+        matches = std::count(alnResult.backtrace.begin(), alnResult.backtrace.end(), 'M');
+        caOffset = arena.size();
+        arena.resize(caOffset + matches);
+        const float *qX = qCaData;
+        const float *qY = qCaData + alnResult.qLen;
+        const float *qZ = qCaData + alnResult.qLen * 2;
+        const float *dbX = dbCaData;
+        const float *dbY = dbCaData + alnResult.dbLen;
+        const float *dbZ = dbCaData + alnResult.dbLen * 2;
         unsigned int qPos = alnResult.qStartPos;
         unsigned int dbPos = alnResult.dbStartPos;
-        unsigned int qXPos = 0;
-        unsigned int qYPos = alnResult.qLen;
-        unsigned int qZPos = alnResult.qLen * 2;
-        unsigned int dbXPos = 0;
-        unsigned int dbYPos = alnResult.dbLen;
-        unsigned int dbZPos = alnResult.dbLen * 2;
+        size_t caPos = caOffset;
         for (char cigar : alnResult.backtrace) {
             switch (cigar) {
                 case 'M':
-                    matches++;
-                    qChain.caVecX.emplace_back(qCaData[qXPos + qPos]);
-                    qChain.caVecY.emplace_back(qCaData[qYPos + qPos]);
-                    qChain.caVecZ.emplace_back(qCaData[qZPos + qPos++]);
-                    dbChain.caVecX.emplace_back(dbCaData[dbXPos + dbPos]);
-                    dbChain.caVecY.emplace_back(dbCaData[dbYPos + dbPos]);
-                    dbChain.caVecZ.emplace_back(dbCaData[dbZPos + dbPos++]);
+                    arena.qX[caPos] = qX[qPos];
+                    arena.qY[caPos] = qY[qPos];
+                    arena.qZ[caPos] = qZ[qPos++];
+                    arena.dbX[caPos] = dbX[dbPos];
+                    arena.dbY[caPos] = dbY[dbPos];
+                    arena.dbZ[caPos++] = dbZ[dbPos++];
                     break;
                 case 'I':
                     qPos++;
@@ -87,6 +120,8 @@ struct ChainToChainAln {
 
     Chain qChain;
     Chain dbChain;
+    // the aligned C-alpha pairs are [caOffset, caOffset + matches) of the arena of the query complex
+    size_t caOffset;
     unsigned int matches;
     unsigned int alnLength;
     resultToWrite_t resultToWrite;
@@ -103,50 +138,10 @@ struct ChainToChainAln {
     }
 
     void free() {
-        qChain.caVecX.clear();
-        qChain.caVecY.clear();
-        qChain.caVecZ.clear();
-        dbChain.caVecX.clear();
-        dbChain.caVecY.clear();
-        dbChain.caVecZ.clear();
         resultToWrite.clear();
     }
 };
 
-struct ScoreComplexResult {
-    ScoreComplexResult() {}
-    ScoreComplexResult(unsigned int queryComplexId, unsigned int assId, resultToWrite_t &resultToWrite) : queryComplexId(queryComplexId), assId(assId), resultToWrite(resultToWrite) {}
-    unsigned int queryComplexId;
-    unsigned int assId;
-    resultToWrite_t resultToWrite;
-};
-
-//static bool compareComplexResult(const ScoreComplexResult &first, const ScoreComplexResult &second) {
-//    if (first.assId < second.assId) {
-//        return true;
-//    }
-//    if (first.assId > second.assId) {
-//        return false;
-//    }
-//    return false;
-//}
-
-static bool compareComplexResultByQuery(const ScoreComplexResult &first, const ScoreComplexResult &second) {
-    if (first.queryComplexId < second.queryComplexId) {
-        return true;
-    }
-    if (first.queryComplexId > second.queryComplexId) {
-        return false;
-    }
-    if (first.assId < second.assId) {
-        return true;
-    }
-    if (first.assId > second.assId) {
-        return false;
-    }
-    return false;
-}
-
 struct ComplexDataHandler {
     ComplexDataHandler(bool isValid): assId(UINT_MAX), qTmScore(0.0f), tTmScore(0.0f), isValid(isValid) {}
     ComplexDataHandler(unsigned int assId, double qTmScore, double tTmScore, std::string &uString, std::string &tString, bool isValid)
@@ -174,45 +169,351 @@ auto getChainId(ReaderType &dbr, unsigned int chainKey) -> decltype(dbr.sequence
     return dbr.sequenceReader->getId(chainKey);
 }
 
-template <typename ReaderType>
-static void getKeyToIdMapIdToKeysMapIdVec(
-    DBReader<unsigned int> &alnDbr,
-    ReaderType &dbr,
-    const std::string &file,
-    std::map<unsigned int, unsigned int> &chainKeyToComplexIdLookup,
-    std::map<unsigned int, std::vector<unsigned int>> &complexIdToChainKeysLookup,
-    std::vector<unsigned int> &complexIdVec
-) {
-    if (file.empty()) {
-        return;
+// Complexes of a .lookup file as dense tables: the complex id of each chain key and the chain keys of
+// each complex in lookup order, packed in CSR form. Built once per database and shared read-only by all threads.
+class ComplexLookup {
+public:
+    struct ChainKeys {
+        ChainKeys(const unsigned int *first, const unsigned int *last) : first(first), last(last) {}
+        const unsigned int *begin() const { return first; }
+        const unsigned int *end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+        const unsigned int &operator[](size_t i) const { return first[i]; }
+        std::vector<unsigned int> toVector() const { return std::vector<unsigned int>(first, last); }
+    private:
+        const unsigned int *first;
+        const unsigned int *last;
+    };
+
+    // complex id of a chain key or NOT_AVAILABLE_CHAIN_KEY if the chain is not in the database
+    unsigned int getComplexId(unsigned int chainKey) const {
+        return (chainKey < complexIdOfChain.size()) ? complexIdOfChain[chainKey] : NOT_AVAILABLE_CHAIN_KEY;
     }
-    MemoryMapped lookupDB(file, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
-    char *data = (char *) lookupDB.getData();
-    char *end = data + lookupDB.mappedSize();
-    const char *entry[255];
-    std::vector<bool> isVistedSet(alnDbr.getLastKey() + 1, false);
-    while (data < end && *data != '\0') {
-        const size_t columns = Util::getWordsOfLine(data, entry, 255);
-        if (columns < 3) {
-            Debug(Debug::WARNING) << "Not enough columns in lookup file " << file << "\n";
-            continue;
+
+    // chain keys of a complex, empty for unknown complexes
+    ChainKeys getChainKeys(unsigned int complexId) const {
+        if (complexId + 1 >= offsets.size()) {
+            return ChainKeys(NULL, NULL);
         }
-        auto chainKey = Util::fast_atoi<int>(entry[0]);
-        unsigned int chainDbId = getChainId(dbr, chainKey);
-        if (chainDbId != NOT_AVAILABLE_CHAIN_KEY) {
-            auto complexId = Util::fast_atoi<int>(entry[2]);
-            chainKeyToComplexIdLookup.emplace(chainKey, complexId);
-            if (isVistedSet[complexId] == 0){
-                complexIdToChainKeysLookup.emplace(complexId, std::vector<unsigned int>());
-                complexIdVec.emplace_back(complexId);
-                isVistedSet[complexId] = 1;
+        const unsigned int *keys = chainKeys.data();
+        return ChainKeys(keys + offsets[complexId], keys + offsets[complexId + 1]);
+    }
+
+    // complex ids are dense, this is one more than the largest complex id
+    size_t getComplexIdCount() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    // the chain key and complex id columns of DB.lookup in binary form, stored as the only entry of DB_complex
+    struct IndexHeader {
+        char magic[8];
+        uint64_t lookupSize;
+        uint64_t chainCount;
+    };
+
+    static std::string indexDbName(const std::string &db) {
+        return db + "_complex";
+    }
+
+    // writes DB_complex from DB.lookup, read() then skips parsing the lookup text
+    static void createIndex(const std::string &db) {
+        std::vector<unsigned int> chainKeys;
+        std::vector<unsigned int> complexIds;
+        parseLookup(db + ".lookup", chainKeys, complexIds);
+        IndexHeader header;
+        memcpy(header.magic, indexMagic(), sizeof(header.magic));
+        header.lookupSize = FileUtil::getFileSize(db + ".lookup");
+        header.chainCount = chainKeys.size();
+
+        std::string indexDb = indexDbName(db);
+        DBWriter writer(indexDb.c_str(), (indexDb + ".index").c_str(), 1, false, Parameters::DBTYPE_GENERIC_DB);
+        writer.open();
+        writer.writeStart(0);
+        writer.writeAdd(reinterpret_cast<const char *>(&header), sizeof(IndexHeader), 0);
+        writer.writeAdd(reinterpret_cast<const char *>(chainKeys.data()), chainKeys.size() * sizeof(unsigned int), 0);
+        writer.writeAdd(reinterpret_cast<const char *>(complexIds.data()), complexIds.size() * sizeof(unsigned int), 0);
+        writer.writeEnd(0, 0, false);
+        writer.close(true);
+    }
+
+    // reads the chains of dbr from DB_complex or, if it is missing or was written for another DB.lookup, from DB.lookup.
+    // complexIds gets the complex ids in order of their first chain
+    template <typename ReaderType>
+    void read(ReaderType &dbr, const std::string &db, std::vector<unsigned int> &complexIds) {
+        complexIdOfChain.clear();
+        offsets.clear();
+        chainKeys.clear();
+        const std::string lookupFile = db + ".lookup";
+        if (FileUtil::fileExists(lookupFile.c_str()) == false) {
+            return;
+        }
+
+        std::vector<unsigned int> lookupChainKeys;
+        std::vector<unsigned int> lookupComplexIds;
+        const unsigned int *keyColumn = NULL;
+        const unsigned int *complexColumn = NULL;
+        size_t lookupSize = 0;
+        const std::string indexDb = indexDbName(db);
+        DBReader<unsigned int> *indexReader = NULL;
+        if (FileUtil::fileExists((indexDb + ".dbtype").c_str())) {
+            indexReader = new DBReader<unsigned int>(indexDb.c_str(), (indexDb + ".index").c_str(), 1, DBReader<unsigned int>::USE_DATA | DBReader<unsigned int>::USE_INDEX);
+            indexReader->open(DBReader<unsigned int>::NOSORT);
+            const char *data = indexReader->getData(0, 0);
+            IndexHeader header;
+            if (indexReader->getSize() == 1 && indexReader->getEntryLen(0) >= sizeof(IndexHeader)) {
+                memcpy(&header, data, sizeof(IndexHeader));
+            } else {
+                memset(&header, 0, sizeof(IndexHeader));
+            }
+            if (memcmp(header.magic, indexMagic(), sizeof(header.magic)) == 0
+                && header.lookupSize == FileUtil::getFileSize(lookupFile)
+                && indexReader->getEntryLen(0) >= sizeof(IndexHeader) + 2 * header.chainCount * sizeof(unsigned int)) {
+                keyColumn = reinterpret_cast<const unsigned int *>(data + sizeof(IndexHeader));
+                complexColumn = keyColumn + header.chainCount;
+                lookupSize = header.chainCount;
+            } else {
+                Debug(Debug::WARNING) << indexDb << " does not match " << lookupFile << ". Reading the lookup file instead\n";
+            }
+        }
+        if (keyColumn == NULL) {
+            parseLookup(lookupFile, lookupChainKeys, lookupComplexIds);
+            keyColumn = lookupChainKeys.data();
+            complexColumn = lookupComplexIds.data();
+            lookupSize = lookupChainKeys.size();
+        }
+
+        std::vector<std::pair<unsigned int, unsigned int>> chains;
+        unsigned int maxChainKey = 0;
+        unsigned int maxComplexId = 0;
+        for (size_t i = 0; i < lookupSize; i++) {
+            if (getChainId(dbr, keyColumn[i]) != NOT_AVAILABLE_CHAIN_KEY) {
+                chains.emplace_back(keyColumn[i], complexColumn[i]);
+                maxChainKey = std::max(maxChainKey, keyColumn[i]);
+                maxComplexId = std::max(maxComplexId, complexColumn[i]);
+            }
+        }
+        if (indexReader != NULL) {
+            indexReader->close();
+            delete indexReader;
+        }
+        if (chains.empty()) {
+            return;
+        }
+
+        complexIdOfChain.assign(static_cast<size_t>(maxChainKey) + 1, NOT_AVAILABLE_CHAIN_KEY);
+        offsets.assign(static_cast<size_t>(maxComplexId) + 2, 0);
+        for (size_t i = 0; i < chains.size(); i++) {
+            // the first line of a chain key wins
+            if (complexIdOfChain[chains[i].first] != NOT_AVAILABLE_CHAIN_KEY) {
+                continue;
+            }
+            complexIdOfChain[chains[i].first] = chains[i].second;
+            if (offsets[chains[i].second + 1] == 0) {
+                complexIds.emplace_back(chains[i].second);
+            }
+            offsets[chains[i].second + 1]++;
+        }
+        for (size_t id = 1; id < offsets.size(); id++) {
+            offsets[id] += offsets[id - 1];
+        }
+        chainKeys.resize(offsets.back());
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < chains.size(); i++) {
+            if (complexIdOfChain[chains[i].first] == chains[i].second) {
+                chainKeys[fill[chains[i].second]++] = chains[i].first;
             }
-            complexIdToChainKeysLookup.at(complexId).emplace_back(chainKey);
         }
-        data = Util::skipLine(data);
     }
-    lookupDB.close();
-}
+
+private:
+    static const char *indexMagic() {
+        return "CPLXLKP1";
+    }
+
+    static void parseLookup(const std::string &file, std::vector<unsigned int> &chainKeys, std::vector<unsigned int> &complexIds) {
+        MemoryMapped lookupDB(file, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
+        char *data = (char *) lookupDB.getData();
+        char *end = data + lookupDB.mappedSize();
+        const char *entry[255];
+        while (data < end && *data != '\0') {
+            const size_t columns = Util::getWordsOfLine(data, entry, 255);
+            if (columns < 3) {
+                Debug(Debug::WARNING) << "Not enough columns in lookup file " << file << "\n";
+            } else {
+                chainKeys.emplace_back(Util::fast_atoi<unsigned int>(entry[0]));
+                complexIds.emplace_back(Util::fast_atoi<unsigned int>(entry[2]));
+            }
+            data = Util::skipLine(data);
+        }
+        lookupDB.close();
+    }
+
+    std::vector<unsigned int> complexIdOfChain;
+    std::vector<size_t> offsets;
+    std::vector<unsigned int> chainKeys;
+};
+
+// Copies of chains within each complex, stored as the only entry of DB_symmetry. Chains are copies if they
+// have the same sequence and their C-alphas superpose within SYMMETRY_RMSD_THRESHOLD. Every chain of a
+// complex with copies has an entry, chains without copies are their own reference. The rigid motion of the
+// reference onto a chain is x_chain = rot * (x_ref - center_ref) + center_chain.
+class ComplexSymmetry {
+public:
+    struct ChainCopy {
+        unsigned int chainKey;
+        unsigned int refKey;
+        float rot[3][3];
+        float center[3];
+    };
+
+    struct IndexHeader {
+        char magic[8];
+        uint64_t lookupSize;
+        uint64_t chainCount;
+    };
+
+    static std::string indexDbName(const std::string &db) {
+        return db + "_symmetry";
+    }
+
+    // writes DB_symmetry from DB.lookup, DB and DB_ca
+    static void createIndex(const std::string &db, int threads);
+
+    // reads DB_symmetry, no chain has copies if it is missing or was written for another DB.lookup
+    void read(const std::string &db) {
+        chains.clear();
+        const std::string indexDb = indexDbName(db);
+        const std::string lookupFile = db + ".lookup";
+        if (FileUtil::fileExists((indexDb + ".dbtype").c_str()) == false || FileUtil::fileExists(lookupFile.c_str()) == false) {
+            return;
+        }
+        DBReader<unsigned int> indexReader(indexDb.c_str(), (indexDb + ".index").c_str(), 1, DBReader<unsigned int>::USE_DATA | DBReader<unsigned int>::USE_INDEX);
+        indexReader.open(DBReader<unsigned int>::NOSORT);
+        const char *data = indexReader.getData(0, 0);
+        IndexHeader header;
+        if (indexReader.getSize() == 1 && indexReader.getEntryLen(0) >= sizeof(IndexHeader)) {
+            memcpy(&header, data, sizeof(IndexHeader));
+        } else {
+            memset(&header, 0, sizeof(IndexHeader));
+        }
+        if (memcmp(header.magic, indexMagic(), sizeof(header.magic)) == 0
+            && header.lookupSize == FileUtil::getFileSize(lookupFile)
+            && indexReader.getEntryLen(0) >= sizeof(IndexHeader) + header.chainCount * sizeof(ChainCopy)) {
+            chains.resize(header.chainCount);
+            memcpy(chains.data(), data + sizeof(IndexHeader), header.chainCount * sizeof(ChainCopy));
+        } else {
+            Debug(Debug::WARNING) << indexDb << " does not match " << db << ".lookup. Ignoring chain copies\n";
+        }
+        indexReader.close();
+    }
+
+    bool empty() const {
+        return chains.empty();
+    }
+
+    // entry of a chain or NULL if its complex has no copies
+    const ChainCopy *getChain(unsigned int chainKey) const {
+        std::vector<ChainCopy>::const_iterator it = std::lower_bound(chains.begin(), chains.end(), chainKey, compareChainKey);
+        return (it != chains.end() && it->chainKey == chainKey) ? &(*it) : NULL;
+    }
+
+    // entry of a chain or, if its complex has no copies, the chain as its own reference in self
+    const ChainCopy *getChainOrSelf(unsigned int chainKey, ChainCopy &self) const {
+        const ChainCopy *chain = getChain(chainKey);
+        if (chain != NULL) {
+            return chain;
+        }
+        memset(&self, 0, sizeof(ChainCopy));
+        self.chainKey = chainKey;
+        self.refKey = chainKey;
+        self.rot[0][0] = self.rot[1][1] = self.rot[2][2] = 1.0f;
+        return &self;
+    }
+
+    // rotation of the rigid motion of chain from onto its copy to, x_to = rot * (x_from - from.center) + to.center
+    static void getMotion(const ChainCopy &from, const ChainCopy &to, double rot[3][3]) {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                rot[i][j] = 0.0;
+                for (int k = 0; k < 3; k++) {
+                    rot[i][j] += (double) to.rot[i][k] * from.rot[j][k];
+                }
+            }
+        }
+    }
+
+    // superposition of the copies qTo and dbTo given the superposition q = u * db + t of qFrom and dbFrom
+    static void transferSuperposition(const ChainCopy &qFrom, const ChainCopy &qTo, const ChainCopy &dbFrom, const ChainCopy &dbTo,
+                                      const float u[3][3], const float t[3], float uOut[3][3], float tOut[3]) {
+        double qRot[3][3];
+        double dbRot[3][3];
+        getMotion(qFrom, qTo, qRot);
+        getMotion(dbFrom, dbTo, dbRot);
+        // uOut = qRot * u * dbRot^T
+        double qu[3][3];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                qu[i][j] = qRot[i][0] * u[0][j] + qRot[i][1] * u[1][j] + qRot[i][2] * u[2][j];
+            }
+        }
+        double uNew[3][3];
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                uNew[i][j] = qu[i][0] * dbRot[j][0] + qu[i][1] * dbRot[j][1] + qu[i][2] * dbRot[j][2];
+                uOut[i][j] = (float) uNew[i][j];
+            }
+        }
+        // tOut = qRot * (u * dbFrom.center + t - qFrom.center) + qTo.center - uOut * dbTo.center
+        double shifted[3];
+        for (int i = 0; i < 3; i++) {
+            shifted[i] = u[i][0] * dbFrom.center[0] + u[i][1] * dbFrom.center[1] + u[i][2] * dbFrom.center[2] + t[i] - qFrom.center[i];
+        }
+        for (int i = 0; i < 3; i++) {
+            tOut[i] = (float) (qRot[i][0] * shifted[0] + qRot[i][1] * shifted[1] + qRot[i][2] * shifted[2] + qTo.center[i]
+                               - (uNew[i][0] * dbTo.center[0] + uNew[i][1] * dbTo.center[1] + uNew[i][2] * dbTo.center[2]));
+        }
+    }
+
+    // true if the rigid motion rot (mapping the centers from onto to) moves chain onto its copy other
+    static bool movesOnto(const double rot[3][3], const float fromCenter[3], const float toCenter[3], const ChainCopy &chain, const ChainCopy &other) {
+        if (chain.refKey != other.refKey) {
+            return false;
+        }
+        for (int i = 0; i < 3; i++) {
+            const double center = rot[i][0] * (chain.center[0] - fromCenter[0]) + rot[i][1] * (chain.center[1] - fromCenter[1])
+                                  + rot[i][2] * (chain.center[2] - fromCenter[2]) + toCenter[i];
+            if (std::abs(center - other.center[i]) > SYMMETRY_CENTER_TOLERANCE) {
+                return false;
+            }
+            for (int j = 0; j < 3; j++) {
+                const double chainRot = rot[i][0] * chain.rot[0][j] + rot[i][1] * chain.rot[1][j] + rot[i][2] * chain.rot[2][j];
+                if (std::abs(chainRot - other.rot[i][j]) > SYMMETRY_ROTATION_TOLERANCE) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    std::vector<ChainCopy> chains;
+
+    // entries of all complexes with chain copies, sorted by chain key
+    static void findChainCopies(const std::string &db, int threads, std::vector<ChainCopy> &chains);
+
+    static bool compareChainKey(const ChainCopy &chain, unsigned int chainKey) {
+        return chain.chainKey < chainKey;
+    }
+
+    static bool compareChainCopy(const ChainCopy &first, const ChainCopy &second) {
+        return first.chainKey < second.chainKey;
+    }
+
+    static const char *indexMagic() {
+        return "CPLXSYM1";
+    }
+};
 
 static ComplexDataHandler parseScoreComplexResult(const char *data, Matcher::result_t &res) {
     const char *entry[255];
@@ -270,4 +571,25 @@ static char* fastfloatToBuffer(float value, char* buffer) {
     return buffer;
 }
 
+// smallest chain assignment scoremultimer reports for a query complex
+static inline unsigned int minAssignedChains(size_t qChainCount, float minAssignedChainsRatio) {
+    return std::ceil((float) qChainCount * minAssignedChainsRatio);
+}
+
+// false if scoremultimer can not assign the two complexes whatever their chain alignments are.
+// An assignment has at most one alignment per query and target chain.
+static inline bool canAssignComplexes(size_t qChainCount, size_t dbChainCount, float minAssignedChainsRatio, int monomerIncludeMode) {
+    if (monomerIncludeMode == SKIP_MONOMERS && std::min(qChainCount, dbChainCount) < MULTIPLE_CHAINED_COMPLEX) {
+        return false;
+    }
+    return std::min(qChainCount, dbChainCount) >= minAssignedChains(qChainCount, minAssignedChainsRatio);
+}
+
+// Writes for each query chain of qComplexIndices all chains of the target complexes hit by any chain
+// of its complex in alnDbr (expandmultimer). Target chains missing in tDbr are skipped, so are
+// target complexes that fail canAssignComplexes.
+void expandMultimerResults(DBReader<unsigned int> &alnDbr, const ComplexLookup &qComplexLookup, const std::vector<unsigned int> &qComplexIndices,
+                           const ComplexLookup &dbComplexLookup, DBReader<unsigned int> &tDbr,
+                           float minAssignedChainsRatio, int monomerIncludeMode, const StructureResultWriter &writer);
+
 #endif //FOLDSEEK_MULTIMERUTIL_H
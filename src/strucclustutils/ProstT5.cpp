@@ -2,9 +2,12 @@
 
 #include "llama.h"
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 
+#include <sys/stat.h>
+
 static char number_to_char(unsigned int n) {
     switch(n) {
         case 0:  return 'A';
@@ -164,6 +167,42 @@ ProstT5Model::~ProstT5Model() {
     llama_free_model(model);
 }
 
+static bool isFile(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode) == false;
+}
+
+std::string ProstT5Model::findWeights(const std::string& path) {
+    const char* prefix[] = { "", "/model" };
+    const char* suffix[] = { "", "/prostt5-f16.gguf" };
+    for (size_t i = 0; i < 2; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            std::string tensorPath = path + prefix[i] + suffix[j];
+            if (isFile(tensorPath)) {
+                return tensorPath;
+            }
+        }
+    }
+    return "";
+}
+
+bool ProstT5Model::hasLegacyWeights(const std::string& path) {
+    return isFile(path + "/model.safetensors") || isFile(path + "/model/model.safetensors");
+}
+
+bool ProstT5Model::quantize(const std::string& model_file, const std::string& out_file, const std::string& type, int threads) {
+    auto qparams = llama_model_quantize_default_params();
+    if (type == "q8_0") {
+        qparams.ftype = LLAMA_FTYPE_MOSTLY_Q8_0;
+    } else if (type == "q4_0") {
+        qparams.ftype = LLAMA_FTYPE_MOSTLY_Q4_0;
+    } else {
+        return false;
+    }
+    qparams.nthread = threads;
+    return llama_model_quantize(model_file.c_str(), out_file.c_str(), &qparams) == 0;
+}
+
 ProstT5::ProstT5(ProstT5Model& model, int threads) : model(model) {
     auto cparams = llama_context_default_params();
     cparams.n_threads = threads;
@@ -171,6 +210,7 @@ ProstT5::ProstT5(ProstT5Model& model, int threads) : model(model) {
     cparams.n_ubatch = 2048;
     cparams.n_batch = 2048;
     cparams.n_ctx = 2048;
+    cparams.n_seq_max = MAX_BATCH_SEQS;
     cparams.embeddings = true;
     cparams.attention_type = LLAMA_ATTENTION_TYPE_NON_CAUSAL;
 
@@ -190,27 +230,193 @@ ProstT5::~ProstT5() {
     llama_free(ctx);
 }
 
-std::string ProstT5::predict(const std::string& aa) {
-    std::string result;
-    std::vector<llama_token> embd_inp;
-    embd_inp.reserve(aa.length() + 2);
-    embd_inp.emplace_back(llama_token_get_token(model.model, "<AA2fold>"));
+void ProstT5::tokenize(const std::string& aa, std::vector<llama_token>& tokens) {
+    tokens.emplace_back(llama_token_get_token(model.model, "<AA2fold>"));
     llama_token unk_aa = llama_token_get_token(model.model, "▁X");
     for (size_t i = 0; i < aa.length(); ++i) {
         std::string current_char("▁");
         current_char.append(1, toupper(aa[i]));
         llama_token token = llama_token_get_token(model.model, current_char.c_str());
         if (token == LLAMA_TOKEN_NULL) {
-            embd_inp.emplace_back(unk_aa);
+            tokens.emplace_back(unk_aa);
         } else {
-            embd_inp.emplace_back(token);
+            tokens.emplace_back(token);
         }
     }
-    embd_inp.emplace_back(llama_token_get_token(model.model, "</s>"));
+    tokens.emplace_back(llama_token_get_token(model.model, "</s>"));
+}
+
+std::string ProstT5::predict(const std::string& aa) {
+    std::string result;
+    std::vector<llama_token> embd_inp;
+    embd_inp.reserve(aa.length() + 2);
+    tokenize(aa, embd_inp);
     encode(ctx, embd_inp, result);
     return result;
 }
 
+std::vector<std::string> ProstT5::predictBatch(const std::vector<std::string>& aas) {
+    std::vector<std::string> results(aas.size());
+    std::vector<llama_token> tokens;
+    std::vector<llama_pos> pos;
+    std::vector<int32_t> n_seq_id;
+    std::vector<llama_seq_id> seq_id;
+    std::vector<llama_seq_id*> seq_id_ptr;
+    std::vector<int8_t> logits;
+    // index into aas and token offset of each sequence in the current batch
+    std::vector<size_t> members;
+    std::vector<size_t> offsets;
+    size_t next = 0;
+    while (next < aas.size()) {
+        tokens.clear();
+        members.clear();
+        offsets.clear();
+        while (next < aas.size() && members.size() < MAX_BATCH_SEQS) {
+            // an empty sequence has no 3Di states
+            if (aas[next].empty()) {
+                next++;
+                continue;
+            }
+            // a sequence that does not fit by itself is still encoded alone
+            if (members.empty() == false && tokens.size() + aas[next].length() + 2 > MAX_BATCH_TOKENS) {
+                break;
+            }
+            members.emplace_back(next);
+            offsets.emplace_back(tokens.size());
+            tokenize(aas[next], tokens);
+            next++;
+        }
+        if (members.empty()) {
+            break;
+        }
+        offsets.emplace_back(tokens.size());
+
+        const size_t n_tokens = tokens.size();
+        pos.resize(n_tokens);
+        n_seq_id.assign(n_tokens, 1);
+        seq_id.resize(n_tokens);
+        seq_id_ptr.resize(n_tokens);
+        logits.assign(n_tokens, 1);
+        for (size_t m = 0; m < members.size(); ++m) {
+            for (size_t t = offsets[m]; t < offsets[m + 1]; ++t) {
+                pos[t] = t - offsets[m];
+                seq_id[t] = m;
+                seq_id_ptr[t] = &seq_id[t];
+            }
+        }
+
+        llama_batch batch;
+        batch.n_tokens = n_tokens;
+        batch.token = tokens.data();
+        batch.embd = nullptr;
+        batch.pos = pos.data();
+        batch.n_seq_id = n_seq_id.data();
+        batch.seq_id = seq_id_ptr.data();
+        batch.logits = logits.data();
+        if (llama_encode(ctx, batch) < 0) {
+            continue;
+        }
+        float* embeddings = llama_get_embeddings(ctx);
+        if (embeddings == nullptr) {
+            continue;
+        }
+
+        // the CNN head emits 20 channels over the (n_tokens - 1) positions of each sequence
+        const size_t stride = n_tokens - members.size();
+        for (size_t m = 0; m < members.size(); ++m) {
+            const size_t first = offsets[m] - m;
+            const size_t seq_len = offsets[m + 1] - offsets[m] - 2;
+            std::string& result = results[members[m]];
+            result.reserve(seq_len);
+            for (size_t j = 0; j < seq_len; ++j) {
+                int arg_max_idx = 0;
+                float arg_max = std::numeric_limits<float>::lowest();
+                for (int i = 0; i < 20; ++i) {
+                    const float value = embeddings[i * stride + first + j];
+                    if (value > arg_max) {
+                        arg_max_idx = i;
+                        arg_max = value;
+                    }
+                }
+                result.push_back(number_to_char(arg_max_idx));
+            }
+        }
+    }
+    return results;
+}
+
+void ProstT5::splitWindows(size_t length, unsigned int splitLength, unsigned int minSplitLength, unsigned int overlap, std::vector<Window>& windows) {
+    // split length of 0 will deactivate splitting
+    if (splitLength == 0 || length <= splitLength) {
+        windows.emplace_back(0, length, 0, length);
+        return;
+    }
+
+    if (overlap == 0) {
+        unsigned int n_splits, overlap_length;
+        n_splits = int(length / splitLength) + 1;
+        overlap_length = length % splitLength;
+
+        // ensure minimum overlap length; adjustment length was not computed properly with ceil/ceilf now using simple int cast
+        if (overlap_length < minSplitLength) {
+            splitLength -= int((minSplitLength - overlap_length) / (n_splits - 1)) + 1;
+        }
+
+        for (unsigned int i = 0; i < n_splits; i++) {
+            size_t split_start = (size_t) i * splitLength;
+            size_t split_len = std::min((size_t) splitLength, length - split_start);
+            windows.emplace_back(split_start, split_len, 0, split_len);
+        }
+        return;
+    }
+
+    // sliding windows of splitLength residues, neighbouring windows share at least overlap residues
+    // each window keeps the residues up to the middle of its overlaps, so no residue is predicted at a window edge
+    overlap = std::min(overlap, splitLength / 2);
+    const size_t stride = splitLength - overlap;
+    const size_t n_windows = (length - splitLength + stride - 1) / stride + 1;
+    size_t keepStart = 0;
+    for (size_t i = 0; i < n_windows; ++i) {
+        const size_t start = std::min(i * stride, length - splitLength);
+        size_t keepEnd = length;
+        if (i + 1 < n_windows) {
+            const size_t nextStart = std::min((i + 1) * stride, length - splitLength);
+            keepEnd = (nextStart + start + splitLength) / 2;
+        }
+        windows.emplace_back(start, splitLength, keepStart - start, keepEnd - start);
+        keepStart = keepEnd;
+    }
+}
+
+std::vector<std::pair<size_t, size_t>> ProstT5::batchRanges(const std::vector<size_t>& lengths, unsigned int splitLength, unsigned int minSplitLength, unsigned int overlap) {
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::vector<Window> windows;
+    size_t begin = 0;
+    size_t tokens = 0;
+    size_t seqs = 0;
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        // count the windows a long sequence is split into, each with its own special tokens
+        windows.clear();
+        splitWindows(lengths[i], splitLength, minSplitLength, overlap, windows);
+        size_t current = 0;
+        for (size_t j = 0; j < windows.size(); ++j) {
+            current += windows[j].length + 2;
+        }
+        if (i > begin && (tokens + current > MAX_BATCH_TOKENS || seqs + windows.size() > MAX_BATCH_SEQS)) {
+            ranges.emplace_back(begin, i);
+            begin = i;
+            tokens = 0;
+            seqs = 0;
+        }
+        tokens += current;
+        seqs += windows.size();
+    }
+    if (begin < lengths.size()) {
+        ranges.emplace_back(begin, lengths.size());
+    }
+    return ranges;
+}
+
 std::vector<std::string> ProstT5::getDevices() {
     std::vector<std::string> devices;
     for (size_t i = 0; i < ggml_backend_dev_count(); ++i) {
@@ -3,6 +3,8 @@
 
 #include <string>
 #include <vector>
+#include <utility>
+#include <stdint.h>
 
 struct llama_model;
 struct llama_context;
@@ -21,6 +23,13 @@ public:
     ProstT5Model(const std::string& model_file, std::string& device);
     ~ProstT5Model();
 
+    // returns the GGUF weights inside a downloaded ProstT5 model directory or the given file, empty if none is found
+    static std::string findWeights(const std::string& path);
+    // true if the directory holds safetensors weights of previous Foldseek releases
+    static bool hasLegacyWeights(const std::string& path);
+    // writes a copy of the f16 weights with int8 (q8_0) or int4 (q4_0) encoder matrices
+    static bool quantize(const std::string& model_file, const std::string& out_file, const std::string& type, int threads);
+
     llama_model* model;
 };
 
@@ -32,10 +41,38 @@ public:
     static std::vector<std::string> getDevices();
     
     std::string predict(const std::string& aa);
+    // predicts several sequences with as few encoder calls as possible
+    // sequences are packed into batches of at most MAX_BATCH_TOKENS tokens and MAX_BATCH_SEQS sequences
+    std::vector<std::string> predictBatch(const std::vector<std::string>& aas);
+
+    // residues [start, start + length) of a long sequence are predicted together,
+    // [keepStart, keepEnd) of that prediction ends up in the result
+    struct Window {
+        Window(size_t start, size_t length, size_t keepStart, size_t keepEnd)
+            : start(start), length(length), keepStart(keepStart), keepEnd(keepEnd) {}
+        size_t start;
+        size_t length;
+        size_t keepStart;
+        size_t keepEnd;
+    };
+    // splits sequences longer than splitLength into windows that are predicted independently
+    // without overlap the windows are consecutive chunks, otherwise they slide over the sequence
+    // and the predictions are stitched from the central region of each window
+    static void splitWindows(size_t length, unsigned int splitLength, unsigned int minSplitLength, unsigned int overlap, std::vector<Window>& windows);
+    // groups consecutive sequences of the given lengths into [begin, end) ranges that fit into one batch
+    // the token budget accounts for the windows that splitWindows creates from long sequences
+    // for length sorted input every range is a bucket of similarly long sequences
+    static std::vector<std::pair<size_t, size_t>> batchRanges(const std::vector<size_t>& lengths, unsigned int splitLength, unsigned int minSplitLength, unsigned int overlap);
     void perf();
 
     ProstT5Model& model;
     llama_context* ctx;
+
+    static const size_t MAX_BATCH_TOKENS = 2048;
+    static const size_t MAX_BATCH_SEQS = 64;
+
+private:
+    void tokenize(const std::string& aa, std::vector<int32_t>& tokens);
 };
 
 
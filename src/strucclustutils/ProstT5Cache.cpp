@@ -0,0 +1,125 @@
+// include xxhash early to avoid incompatibilites with SIMDe
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#include "ProstT5Cache.h"
+#include "Debug.h"
+#include "FileUtil.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static const char CACHE_MAGIC[4] = { 'P', '3', 'D', 'I' };
+static const size_t CACHE_HEADER_SIZE = sizeof(CACHE_MAGIC) + sizeof(uint64_t);
+static const size_t CACHE_RECORD_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+
+ProstT5Cache::ProstT5Cache(const std::string& fileName, uint64_t version) : fileName(fileName), version(version), valid(false) {
+    if (FileUtil::fileExists(fileName.c_str()) == false) {
+        return;
+    }
+    size_t size = FileUtil::getFileSize(fileName);
+    FILE* handle = FileUtil::openFileOrDie(fileName.c_str(), "rb", true);
+    data.resize(size);
+    if (size > 0 && fread(data.data(), 1, size, handle) != size) {
+        Debug(Debug::ERROR) << "Could not read ProstT5 cache " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(handle) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    uint64_t fileVersion = 0;
+    if (size < CACHE_HEADER_SIZE || memcmp(data.data(), CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0) {
+        Debug(Debug::WARNING) << "Ignoring invalid ProstT5 cache " << fileName << "\n";
+        data.clear();
+        return;
+    }
+    memcpy(&fileVersion, data.data() + sizeof(CACHE_MAGIC), sizeof(uint64_t));
+    if (fileVersion != version) {
+        Debug(Debug::WARNING) << "ProstT5 cache " << fileName << " was written for a different model and will be replaced\n";
+        data.clear();
+        return;
+    }
+    valid = true;
+
+    // a record cut short by an interrupted run ends the cache
+    size_t pos = CACHE_HEADER_SIZE;
+    while (pos + CACHE_RECORD_SIZE <= size) {
+        Entry entry;
+        uint32_t length;
+        memcpy(&entry.hash, data.data() + pos, sizeof(uint64_t));
+        memcpy(&length, data.data() + pos + sizeof(uint64_t), sizeof(uint32_t));
+        entry.offset = pos + CACHE_RECORD_SIZE;
+        entry.length = length;
+        if (entry.offset + length > size) {
+            break;
+        }
+        entries.emplace_back(entry);
+        pos = entry.offset + length;
+    }
+    std::stable_sort(entries.begin(), entries.end());
+    Debug(Debug::INFO) << "Loaded " << entries.size() << " cached 3Di predictions\n";
+}
+
+uint64_t ProstT5Cache::modelVersion(const std::string& weights, const std::string& precision, int splitLength, int splitOverlap) {
+    std::string model = FileUtil::baseName(weights);
+    model.append(SSTR(FileUtil::getFileSize(weights)));
+    model.append(precision);
+    model.append(SSTR(splitLength));
+    model.append(SSTR(splitOverlap));
+    return XXH64(model.c_str(), model.length(), 0);
+}
+
+bool ProstT5Cache::lookup(const char* aa, size_t length, std::string& states) const {
+    Entry key;
+    key.hash = XXH64(aa, length, version);
+    std::vector<Entry>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), key);
+    // every residue has one state, a hash collision with a different length is rejected
+    if (it == entries.end() || it->hash != key.hash || it->length != length) {
+        return false;
+    }
+    states.assign(data.data() + it->offset, it->length);
+    return true;
+}
+
+void ProstT5Cache::add(const char* aa, size_t length, const std::string& states) {
+    if (states.length() != length) {
+        return;
+    }
+    uint64_t hash = XXH64(aa, length, version);
+    uint32_t stateLength = states.length();
+#pragma omp critical
+    {
+        pending.append(reinterpret_cast<const char*>(&hash), sizeof(uint64_t));
+        pending.append(reinterpret_cast<const char*>(&stateLength), sizeof(uint32_t));
+        pending.append(states);
+    }
+}
+
+void ProstT5Cache::flush() {
+    if (pending.empty()) {
+        return;
+    }
+    FILE* handle = fopen(fileName.c_str(), valid ? "ab" : "wb");
+    if (handle == NULL) {
+        Debug(Debug::ERROR) << "Could not open ProstT5 cache " << fileName << " for writing\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (valid == false) {
+        fwrite(CACHE_MAGIC, 1, sizeof(CACHE_MAGIC), handle);
+        fwrite(&version, sizeof(uint64_t), 1, handle);
+        valid = true;
+    }
+    if (fwrite(pending.c_str(), 1, pending.length(), handle) != pending.length()) {
+        Debug(Debug::ERROR) << "Could not write ProstT5 cache " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (fclose(handle) != 0) {
+        Debug(Debug::ERROR) << "Cannot close file " << fileName << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    pending.clear();
+}
@@ -0,0 +1,47 @@
+#ifndef FOLDSEEK_PROSTT5CACHE_H
+#define FOLDSEEK_PROSTT5CACHE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+// Persistent map from amino acid sequences to their predicted 3Di states
+// Entries are keyed by a 64-bit hash of the sequence seeded with the model version,
+// a cache written by a different model or split setting is discarded
+class ProstT5Cache {
+public:
+    ProstT5Cache(const std::string& fileName, uint64_t version);
+
+    // identifies the weights file, its precision and the settings that change the stitched predictions
+    static uint64_t modelVersion(const std::string& weights, const std::string& precision, int splitLength, int splitOverlap);
+
+    // returns true and the 3Di states if the sequence was predicted by an earlier run
+    bool lookup(const char* aa, size_t length, std::string& states) const;
+
+    // remembers a new prediction, thread-safe
+    void add(const char* aa, size_t length, const std::string& states);
+
+    // appends the new predictions to the cache file
+    void flush();
+
+private:
+    struct Entry {
+        uint64_t hash;
+        size_t offset;
+        unsigned int length;
+
+        bool operator<(const Entry& other) const {
+            return hash < other.hash;
+        }
+    };
+
+    std::string fileName;
+    uint64_t version;
+    bool valid;
+    std::vector<char> data;
+    std::vector<Entry> entries;
+    std::string pending;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifdef HAVE_PROSTT5
+#include "ProstT5SharedMemory.h"
+
+#include "Debug.h"
+#include "FileUtil.h"
+#include "Util.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <new>
+
+extern const char* version;
+
+std::string ProstT5SharedMemory::getShmHash(const std::string& weights) {
+    std::string path = FileUtil::getRealPathFromSymLink(weights);
+    char* visibleDevices = getenv("CUDA_VISIBLE_DEVICES");
+    if (visibleDevices) {
+        path.append(visibleDevices);
+    }
+    path.append(version);
+    size_t hash = Util::hash(path.c_str(), path.length());
+    return "prostt5_" + SSTR(hash);
+}
+
+// Allocate and initialize shared memory
+ProstT5SharedMemory* ProstT5SharedMemory::alloc(const std::string& name, unsigned int maxResidues, unsigned int maxSeqs) {
+    size_t shm_size = calculateSize(maxResidues, maxSeqs);
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+    if (fd == -1) {
+        Debug(Debug::ERROR) << "Failed to open shared memory\n";
+        EXIT(EXIT_FAILURE);
+    }
+    if (ftruncate(fd, shm_size) == -1) {
+        close(fd);
+        Debug(Debug::ERROR) << "Failed to size shared memory\n";
+        EXIT(EXIT_FAILURE);
+    }
+    void* ptr = mmap(0, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        Debug(Debug::ERROR) << "Failed to map shared memory\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    ProstT5SharedMemory* layout = new (ptr) ProstT5SharedMemory;
+    layout->maxResidues = maxResidues;
+    layout->maxSeqs = maxSeqs;
+    layout->seqCount = 0;
+    layout->lengthsOffset = sizeof(ProstT5SharedMemory);
+    layout->sequencesOffset = layout->lengthsOffset + sizeof(unsigned int) * maxSeqs;
+    layout->statesOffset = layout->sequencesOffset + sizeof(char) * maxResidues;
+    return layout;
+}
+
+// Deallocate shared memory
+void ProstT5SharedMemory::dealloc(ProstT5SharedMemory* layout, const std::string& name) {
+    if (layout) {
+        size_t shm_size = calculateSize(layout->maxResidues, layout->maxSeqs);
+        if (munmap(layout, shm_size) == -1) {
+            Debug(Debug::ERROR) << "Error unmapping shared memory\n";
+        }
+        if (shm_unlink(name.c_str()) == -1) {
+            Debug(Debug::ERROR) << "Error unlinking shared memory\n";
+        }
+    }
+}
+
+void ProstT5SharedMemory::unmap(ProstT5SharedMemory* layout) {
+    if (layout) {
+        size_t shm_size = calculateSize(layout->maxResidues, layout->maxSeqs);
+        if (munmap(layout, shm_size) == -1) {
+            Debug(Debug::ERROR) << "Error unmapping shared memory\n";
+        }
+    }
+}
+
+// Function to open and map existing shared memory and automatically determine sizes
+ProstT5SharedMemory* ProstT5SharedMemory::openSharedMemory(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0666);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    // Map enough memory to access the first part of the structure
+    void* ptr = mmap(0, sizeof(ProstT5SharedMemory), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        close(fd);
+        Debug(Debug::ERROR) << "Failed to map shared memory\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    // Now read maxResidues and maxSeqs from the mapped memory
+    unsigned int maxResidues = *(reinterpret_cast<unsigned int*>(ptr));
+    unsigned int maxSeqs = *(reinterpret_cast<unsigned int*>(ptr) + 1);
+    size_t shm_size = calculateSize(maxResidues, maxSeqs);
+
+    // Re-map with the full size now that we know it
+    munmap(ptr, sizeof(ProstT5SharedMemory));
+    ptr = mmap(0, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        Debug(Debug::ERROR) << "Failed to remap shared memory\n";
+        EXIT(EXIT_FAILURE);
+    }
+    return reinterpret_cast<ProstT5SharedMemory*>(ptr);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PROSTT5_SHARED_MEMORY_H
+#define PROSTT5_SHARED_MEMORY_H
+
+#include <atomic>
+#include <string>
+#include <cstddef>
+
+struct ProstT5SharedMemory {
+    enum State {
+        IDLE,
+        RESERVED,
+        READY,
+        DONE
+    };
+
+    unsigned int maxResidues;                 // Maximum number of residues per request
+    unsigned int maxSeqs;                     // Maximum number of sequences per request
+    std::atomic<int>  state{IDLE};            // State of the shared memory
+    std::atomic<bool> serverExit{false};      // Has server exited
+    unsigned int seqCount;                    // Number of sequences in the request
+    unsigned int lengthsOffset;               // Offset to the sequence lengths
+    unsigned int sequencesOffset;             // Offset to the concatenated amino acid sequences
+    unsigned int statesOffset;                // Offset to the concatenated 3Di predictions
+
+    // Get pointers to the lengths, amino acid and 3Di sections
+    unsigned int* getLengthsPtr() { return reinterpret_cast<unsigned int*>(reinterpret_cast<char*>(this) + lengthsOffset); }
+    char* getSequencesPtr() { return reinterpret_cast<char*>(this) + sequencesOffset; }
+    char* getStatesPtr() { return reinterpret_cast<char*>(this) + statesOffset; }
+
+    // Calculate the total size needed for the shared memory
+    static size_t calculateSize(unsigned int maxResidues, unsigned int maxSeqs) {
+        return sizeof(ProstT5SharedMemory) +
+               sizeof(unsigned int) * maxSeqs +   // Size for sequence lengths
+               sizeof(char) * maxResidues +       // Size for amino acid sequences
+               sizeof(char) * maxResidues;        // Size for 3Di predictions
+    }
+
+    // name of the shared memory of a server for the given model weights
+    static std::string getShmHash(const std::string& weights);
+
+    // Allocate and initialize shared memory
+    static ProstT5SharedMemory* alloc(const std::string& name, unsigned int maxResidues, unsigned int maxSeqs);
+
+    // Deallocate shared memory
+    static void dealloc(ProstT5SharedMemory* layout, const std::string& name);
+
+    static void unmap(ProstT5SharedMemory* layout);
+
+    // Function to open and map existing shared memory, returns NULL if no server is running
+    static ProstT5SharedMemory* openSharedMemory(const std::string& name);
+};
+
+#endif
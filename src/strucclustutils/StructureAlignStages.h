@@ -0,0 +1,142 @@
+#ifndef FOLDSEEK_STRUCTUREALIGNSTAGES_H
+#define FOLDSEEK_STRUCTUREALIGNSTAGES_H
+
+#include "DBReader.h"
+#include "LocalParameters.h"
+#include "Util.h"
+#include "FastSort.h"
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Receives the result entry of one query, called concurrently with the thread index of the caller
+typedef std::function<void(const char *data, size_t length, unsigned int key, unsigned int thread)> StructureResultWriter;
+
+// Result DB of one pipeline stage that is kept in memory instead of being written to disk.
+// Every thread appends to its own buffer, getReader() joins them into a reader sorted by key.
+class MemoryResultDB {
+public:
+    MemoryResultDB(unsigned int threads) : buffers(threads), entries(threads), index(NULL), data(NULL), reader(NULL) {}
+
+    ~MemoryResultDB() {
+        if (reader != NULL) {
+            reader->close();
+            delete reader;
+        }
+        delete[] index;
+        free(data);
+    }
+
+    void write(const char *entry, size_t length, unsigned int key, unsigned int thread) {
+        DBReader<unsigned int>::Index idx;
+        idx.id = key;
+        idx.offset = buffers[thread].size();
+        idx.length = static_cast<unsigned int>(length + 1);
+        entries[thread].push_back(idx);
+        buffers[thread].append(entry, length);
+        buffers[thread].push_back('\0');
+    }
+
+    StructureResultWriter writer() {
+        return [this](const char *entry, size_t length, unsigned int key, unsigned int thread) {
+            write(entry, length, key, thread);
+        };
+    }
+
+    // no entries can be written afterwards
+    DBReader<unsigned int> *getReader(int dbtype, int threads) {
+        size_t size = 0;
+        size_t dataSize = 0;
+        for (size_t i = 0; i < buffers.size(); i++) {
+            size += entries[i].size();
+            dataSize += buffers[i].size();
+        }
+        index = new DBReader<unsigned int>::Index[size];
+        data = static_cast<char *>(malloc(std::max(dataSize, (size_t) 1)));
+        Util::checkAllocation(data, "Cannot allocate in-memory result data");
+        size_t entryOffset = 0;
+        size_t dataOffset = 0;
+        for (size_t i = 0; i < buffers.size(); i++) {
+            memcpy(data + dataOffset, buffers[i].data(), buffers[i].size());
+            for (size_t j = 0; j < entries[i].size(); j++) {
+                index[entryOffset] = entries[i][j];
+                index[entryOffset].offset += dataOffset;
+                entryOffset++;
+            }
+            dataOffset += buffers[i].size();
+            std::string().swap(buffers[i]);
+            std::vector<DBReader<unsigned int>::Index>().swap(entries[i]);
+        }
+        SORT_PARALLEL(index, index + size, DBReader<unsigned int>::Index::compareById);
+
+        unsigned int lastKey = (size > 0) ? index[size - 1].id : 0;
+        reader = new DBReader<unsigned int>(index, size, dataSize, lastKey, dbtype, 0, threads);
+        reader->open(DBReader<unsigned int>::NOSORT);
+        reader->setData(data, dataSize);
+        reader->setMode(DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA);
+        return reader;
+    }
+
+private:
+    std::vector<std::string> buffers;
+    std::vector<std::vector<DBReader<unsigned int>::Index>> entries;
+    DBReader<unsigned int>::Index *index;
+    char *data;
+    DBReader<unsigned int> *reader;
+};
+
+// Ungapped alignment of the prefilter hits in resultReader along their diagonal (structurerescorediagonal).
+// par.db1 and par.db2 are the query and target structure databases.
+// Only the entries dbFrom to dbFrom + dbSize of resultReader are processed.
+void rescoreStructureDiagonals(LocalParameters &par, DBReader<unsigned int> &resultReader, size_t dbFrom, size_t dbSize, const StructureResultWriter &writer);
+
+// Lets the caller skip alignments whose outcome it has already decided (structuregreedyclust).
+// The entries of order are aligned batch by batch, batchDone runs on a single thread between two
+// batches and may change the answers of isQueryNeeded and isTargetDecided for the following batches.
+struct StructureAlignmentGate {
+    // resultReader ids in the order they are aligned
+    std::vector<size_t> order;
+    size_t batchSize;
+    // queries that are not needed get an empty result
+    std::function<bool(unsigned int queryKey)> isQueryNeeded;
+    // decided targets are aligned after all others and only while the query has less than minAcceptedHits accepted hits
+    std::function<bool(unsigned int targetKey)> isTargetDecided;
+    int minAcceptedHits;
+    std::function<void(size_t batchStart, size_t batchEnd)> batchDone;
+};
+
+// Ids of the entries dbFrom to dbFrom + dbSize of resultReader, the most expensive queries first. The cost of a query
+// is estimated as the size of its result entry, which grows with its number of hits, times the query length.
+// With a dynamic schedule the expensive queries then start first instead of holding up a single thread at the end.
+inline std::vector<size_t> orderQueriesByCost(DBReader<unsigned int> &resultReader, size_t dbFrom, size_t dbSize,
+                                              DBReader<unsigned int> &queryReader) {
+    std::vector<std::pair<size_t, size_t>> costs(dbSize);
+    for (size_t i = 0; i < dbSize; i++) {
+        const size_t id = dbFrom + i;
+        const size_t queryId = queryReader.getId(resultReader.getDbKey(id));
+        const size_t queryLen = (queryId != UINT_MAX) ? queryReader.getSeqLen(queryId) : 1;
+        costs[i] = std::make_pair(resultReader.getEntryLen(id) * queryLen, id);
+    }
+    std::sort(costs.begin(), costs.end(), [](const std::pair<size_t, size_t> &first, const std::pair<size_t, size_t> &second) {
+        if (first.first != second.first) {
+            return first.first > second.first;
+        }
+        return first.second < second.second;
+    });
+    std::vector<size_t> order(dbSize);
+    for (size_t i = 0; i < dbSize; i++) {
+        order[i] = costs[i].second;
+    }
+    return order;
+}
+
+// Gapped 3Di+AA alignment of the hits in resultReader (structurealign).
+// par.db1 and par.db2 are the query and target structure databases.
+// Only the entries dbFrom to dbFrom + dbSize of resultReader are processed, or the entries of gate->order if a gate is given.
+void alignStructureResults(LocalParameters &par, DBReader<unsigned int> &resultReader, size_t dbFrom, size_t dbSize, bool alignmentIsExtended,
+                           const StructureResultWriter &writer, const StructureAlignmentGate *gate = NULL);
+
+#endif
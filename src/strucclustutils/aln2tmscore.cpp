@@ -24,6 +24,9 @@ int aln2tmscore(int argc, const char **argv, const Command& command) {
     DBReader<unsigned int> qdbr((par.db1 + "_ca").c_str(), (par.db1 + "_ca.index").c_str(),
                                 par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
     qdbr.open(DBReader<unsigned int>::NOSORT);
+    if (par.preloadMode != Parameters::PRELOAD_MODE_MMAP) {
+        qdbr.readMmapedDataInMemory();
+    }
 
 
     DBReader<unsigned int> qSeqReader(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX);
@@ -72,6 +75,11 @@ int aln2tmscore(int argc, const char **argv, const Command& command) {
         for (size_t i = 0; i < alndbr.getSize(); i++) {
             progress.updateProgress();
             unsigned int queryKey = alndbr.getDbKey(i);
+            char *data = alndbr.getData(i, thread_idx);
+            if (*data == '\0') {
+                dbw.writeData(resultsStr.c_str(), 0, queryKey, thread_idx);
+                continue;
+            }
 
             unsigned int qSeqId = qSeqReader.getId(queryKey);
             int queryLen = qSeqReader.getSeqLen(qSeqId);
@@ -82,7 +90,6 @@ int aln2tmscore(int argc, const char **argv, const Command& command) {
 
             tmaln.initQuery(qdata, &qdata[queryLen], &qdata[queryLen+queryLen], NULL, queryLen);
 
-            char *data = alndbr.getData(i, thread_idx);
             while (*data != '\0') {
                 Matcher::result_t res = Matcher::parseAlignmentRecord(data, false);
                 data = Util::skipLine(data);
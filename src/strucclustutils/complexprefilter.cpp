@@ -0,0 +1,174 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "QueryMatcher.h"
+#include "MultimerUtil.h"
+#include "ComplexSketch.h"
+
+#include <algorithm>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+// target complex of the sketch DB that has a hash
+struct SketchPosting {
+    uint32_t hash;
+    unsigned int sketchId;
+};
+
+static bool compareSketchPosting(const SketchPosting &first, const SketchPosting &second) {
+    if (first.hash != second.hash) {
+        return first.hash < second.hash;
+    }
+    return first.sketchId < second.sketchId;
+}
+
+static bool compareSketchPostingByHash(const SketchPosting &posting, uint32_t hash) {
+    return posting.hash < hash;
+}
+
+static bool compareCandidateBySharedHashes(const std::pair<unsigned int, unsigned int> &first, const std::pair<unsigned int, unsigned int> &second) {
+    if (first.first != second.first) {
+        return first.first > second.first;
+    }
+    return first.second < second.second;
+}
+
+// Complex level prefilter of multimersearch. The target complexes sharing the most sketch hashes with a query
+// complex are listed by their first chain in the entry of its first chain, the other query chains get empty entries.
+// expandmultimer and alignmultimer expand them to all chain pairs of the two complexes.
+int complexprefilter(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    std::string ssDb = par.db1 + "_ss";
+    DBReader<unsigned int> qdbr(ssDb.c_str(), (ssDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    qdbr.open(DBReader<unsigned int>::NOSORT);
+    ComplexLookup qComplexLookup;
+    std::vector<unsigned int> qComplexIds;
+    qComplexLookup.read(qdbr, par.db1, qComplexIds);
+
+    DBReader<unsigned int> sketchDbr(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    sketchDbr.open(DBReader<unsigned int>::NOSORT);
+    if (par.preloadMode != Parameters::PRELOAD_MODE_MMAP) {
+        sketchDbr.readMmapedDataInMemory();
+    }
+
+    // inverted index of the target sketches
+    const size_t sketchCount = sketchDbr.getSize();
+    std::vector<ComplexSketch::EntryHeader> headers(sketchCount);
+    std::vector<SketchPosting> postings;
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<SketchPosting> threadPostings;
+#pragma omp for schedule(dynamic, 100)
+        for (size_t id = 0; id < sketchCount; id++) {
+            const char *data = sketchDbr.getData(id, thread_idx);
+            const size_t entryLen = sketchDbr.getEntryLen(id);
+            if (entryLen < sizeof(ComplexSketch::EntryHeader)) {
+                Debug(Debug::ERROR) << "Invalid entry " << sketchDbr.getDbKey(id) << " in sketch DB " << par.db2 << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            memcpy(&headers[id], data, sizeof(ComplexSketch::EntryHeader));
+            if (ComplexSketch::isCompatible(headers[id]) == false) {
+                Debug(Debug::ERROR) << "Sketch DB " << par.db2 << " was created with other sketch parameters. Please recreate it with createcomplexsketch\n";
+                EXIT(EXIT_FAILURE);
+            }
+            const size_t hashCount = (entryLen - sizeof(ComplexSketch::EntryHeader)) / sizeof(uint32_t);
+            const char *hashData = data + sizeof(ComplexSketch::EntryHeader);
+            for (size_t i = 0; i < hashCount; i++) {
+                SketchPosting posting;
+                memcpy(&posting.hash, hashData + i * sizeof(uint32_t), sizeof(uint32_t));
+                posting.sketchId = static_cast<unsigned int>(id);
+                threadPostings.emplace_back(posting);
+            }
+        }
+#pragma omp critical
+        {
+            postings.insert(postings.end(), threadPostings.begin(), threadPostings.end());
+        }
+    }
+    SORT_PARALLEL(postings.begin(), postings.end(), compareSketchPosting);
+    sketchDbr.close();
+
+    float minAssignedChainsRatio = par.minAssignedChainsThreshold > MAX_ASSIGNED_CHAIN_RATIO ? MAX_ASSIGNED_CHAIN_RATIO: par.minAssignedChainsThreshold;
+
+    DBWriter writer(par.db3.c_str(), par.db3Index.c_str(), par.threads, par.compressed, Parameters::DBTYPE_PREFILTER_RES);
+    writer.open();
+
+    Debug::Progress progress(qComplexIds.size());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<uint32_t> hashes;
+        std::vector<unsigned int> sharedHashes(sketchCount, 0);
+        std::vector<unsigned int> touched;
+        // shared hashes and sketch id of the candidates
+        std::vector<std::pair<unsigned int, unsigned int>> candidates;
+        char buffer[100];
+        std::string result;
+
+#pragma omp for schedule(dynamic, 10)
+        for (size_t i = 0; i < qComplexIds.size(); i++) {
+            progress.updateProgress();
+            const ComplexLookup::ChainKeys qChainKeys = qComplexLookup.getChainKeys(qComplexIds[i]);
+            for (size_t chainIdx = 0; chainIdx < qChainKeys.size(); chainIdx++) {
+                const size_t id = qdbr.getId(qChainKeys[chainIdx]);
+                ComplexSketch::addSequence(qdbr.getData(id, thread_idx), qdbr.getSeqLen(id), hashes);
+            }
+            ComplexSketch::finalize(hashes);
+
+            std::vector<SketchPosting>::const_iterator posting = postings.begin();
+            for (size_t h = 0; h < hashes.size(); h++) {
+                // the query hashes are sorted, so the search continues from the previous one
+                posting = std::lower_bound(posting, postings.cend(), hashes[h], compareSketchPostingByHash);
+                for (; posting != postings.cend() && posting->hash == hashes[h]; ++posting) {
+                    if (sharedHashes[posting->sketchId]++ == 0) {
+                        touched.emplace_back(posting->sketchId);
+                    }
+                }
+            }
+            for (size_t t = 0; t < touched.size(); t++) {
+                const unsigned int sketchId = touched[t];
+                if (sharedHashes[sketchId] >= ComplexSketch::MIN_SHARED_HASHES
+                    && canAssignComplexes(qChainKeys.size(), headers[sketchId].chainCount, minAssignedChainsRatio, par.monomerIncludeMode)) {
+                    candidates.emplace_back(sharedHashes[sketchId], sketchId);
+                }
+                sharedHashes[sketchId] = 0;
+            }
+
+            const size_t hitCount = std::min(candidates.size(), par.maxResListLen);
+            std::partial_sort(candidates.begin(), candidates.begin() + hitCount, candidates.end(), compareCandidateBySharedHashes);
+            for (size_t c = 0; c < hitCount; c++) {
+                // shared hashes as score, no diagonal is known
+                hit_t hit;
+                hit.seqId = headers[candidates[c].second].firstChainKey;
+                hit.prefScore = static_cast<int>(candidates[c].first);
+                hit.diagonal = 0;
+                size_t len = QueryMatcher::prefilterHitToBuffer(buffer, hit);
+                result.append(buffer, len);
+            }
+            writer.writeData(result.c_str(), result.length(), qChainKeys[0], thread_idx);
+            for (size_t chainIdx = 1; chainIdx < qChainKeys.size(); chainIdx++) {
+                writer.writeData("", 0, qChainKeys[chainIdx], thread_idx);
+            }
+            result.clear();
+            candidates.clear();
+            touched.clear();
+            hashes.clear();
+        }
+    }
+    writer.close();
+    qdbr.close();
+    return EXIT_SUCCESS;
+}
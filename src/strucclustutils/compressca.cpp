@@ -12,7 +12,7 @@
 
 int compressca(int argc, const char **argv, const Command& command) {
     LocalParameters& par = LocalParameters::getLocalInstance();
-    par.overrideParameterDescription(par.PARAM_COORD_STORE_MODE, "Coordinate storage mode: \n1: C-alpha as float\n2: C-alpha as difference (uint16_t)\n3: Plain text list of floats", "^[1-3]{1}$", 0);
+    par.overrideParameterDescription(par.PARAM_COORD_STORE_MODE, "Coordinate storage mode: \n1: C-alpha as float\n2: C-alpha as difference (uint16_t)\n3: Plain text list of floats\n4: C-alpha as 64 byte aligned float blocks", "^[1-4]{1}$", 0);
     par.parseParameters(argc, argv, command, true, 0, 0);
 
     std::string caDbData = par.db1 + "_ca";
@@ -73,6 +73,11 @@ int compressca(int argc, const char **argv, const Command& command) {
             }
 
             const size_t uncompressedSize = chainLen * (3 * sizeof(float));
+            if (Coordinate16::isAligned(data, length)) {
+                // unpack aligned blocks, so they are converted like COORD_STORE_MODE_CA_FLOAT
+                data = reinterpret_cast<char*>(coords.read(data, chainLen, length));
+                length = uncompressedSize;
+            }
             if (par.coordStoreMode == LocalParameters::COORD_STORE_MODE_CA_DIFF) {
                 if (length >= uncompressedSize) {
                     // coords in COORD_STORE_MODE_CA_FLOAT, so convert to diff
@@ -97,6 +102,10 @@ int compressca(int argc, const char **argv, const Command& command) {
                     float* uncompressed = coords.read(data, chainLen, length);
                     writer.writeData((const char*)uncompressed, uncompressedSize, key, thread_idx);
                 }
+            } else if (par.coordStoreMode == LocalParameters::COORD_STORE_MODE_CA_ALIGNED) {
+                float* uncompressed = coords.read(data, chainLen, length);
+                Coordinate16::convertToAligned(chainLen, uncompressed, uncompressed + chainLen, uncompressed + 2 * chainLen, camol);
+                writer.writeData((const char*)camol.data(), camol.size(), key, thread_idx);
             } else if (par.coordStoreMode == LocalParameters::COORD_STORE_MODE_CA_PLAIN_TEXT) {
                 float* uncompressed = coords.read(data, chainLen, length);
                 plain.append(SSTR(uncompressed[0]));
@@ -39,11 +39,11 @@ private:
     unsigned int key;
 };
 
-class MapIterator : public KeyIterator {
+class ComplexIterator : public KeyIterator {
 public:
-    MapIterator(const complexIdToChainKeys_t& map, const std::vector<unsigned int>& complexIndices)
-        : map(map), complexIndices(complexIndices) {}
-    ~MapIterator() {}
+    ComplexIterator(const ComplexLookup& lookup, const std::vector<unsigned int>& complexIndices)
+        : lookup(lookup), complexIndices(complexIndices) {}
+    ~ComplexIterator() {}
 
     size_t getSize() const override {
         return complexIndices.size();
@@ -51,22 +51,25 @@ public:
 
     std::pair<const unsigned int*, size_t> getDbKeys(size_t index) override {
         unsigned int key = complexIndices[index];
-        const std::vector<unsigned int>& currentKeys = map.at(key);
-        return std::make_pair(currentKeys.data(), currentKeys.size());
+        const ComplexLookup::ChainKeys currentKeys = lookup.getChainKeys(key);
+        return std::make_pair(currentKeys.begin(), currentKeys.size());
     }
 
 private:
-    const complexIdToChainKeys_t& map;
+    const ComplexLookup& lookup;
     const std::vector<unsigned int>& complexIndices;
 };
 
-void writeTitle(FILE* handle, const char* headerData, size_t headerLen) {
+void writeTitle(std::string& out, const char* headerData, size_t headerLen) {
+    char line[128];
     int remainingHeader = headerLen;
-    fprintf(handle, "TITLE     %.*s\n",  std::min(70, (int)remainingHeader), headerData);
+    int len = snprintf(line, sizeof(line), "TITLE     %.*s\n",  std::min(70, (int)remainingHeader), headerData);
+    out.append(line, len);
     remainingHeader -= 70;
     int continuation = 2;
     while (remainingHeader > 0) {
-        fprintf(handle, "TITLE  % 3d%.*s\n", continuation, std::min(70, (int)remainingHeader), headerData + (headerLen - remainingHeader));
+        len = snprintf(line, sizeof(line), "TITLE  % 3d%.*s\n", continuation, std::min(70, (int)remainingHeader), headerData + (headerLen - remainingHeader));
+        out.append(line, len);
         remainingHeader -= 70;
         continuation++;
     }
@@ -78,11 +81,6 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
 
     int outputMode = par.pdbOutputMode;
     int localThreads = par.threads;
-    if (outputMode == LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
-        localThreads = 1;
-    } else {
-        localThreads = par.threads;
-    }
 
     int mode = DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX;
     if (outputMode != LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
@@ -99,12 +97,10 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
     DBReader<unsigned int> db_ca(dbCa.c_str(), dbCaIndex.c_str(), localThreads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     db_ca.open(DBReader<unsigned int>::NOSORT);
 
-    std::string lookupFile = par.db1 + ".lookup";
-    chainKeyToComplexId_t chainKeyToComplexIdMap;
-    complexIdToChainKeys_t complexIdToChainKeysMap;
+    ComplexLookup complexLookup;
     std::vector<unsigned int> complexIndices;
     if (outputMode == LocalParameters::PDB_OUTPUT_MODE_COMPLEX || LocalParameters::PDB_OUTPUT_MODE_SINGLECHAIN) {
-        getKeyToIdMapIdToKeysMapIdVec(db, db, lookupFile, chainKeyToComplexIdMap, complexIdToChainKeysMap, complexIndices);
+        complexLookup.read(db, par.db1, complexIndices);
     }
 
     Debug(Debug::INFO) << "Start writing file to " << par.db2 << "\n";
@@ -132,21 +128,23 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
 #ifdef OPENMP
         thread_idx = omp_get_thread_num();
 #endif
-        FILE* threadHandle = NULL;
-        if (outputMode == LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
-            threadHandle = handle;
-        }
+        // every entry is formatted into a buffer first, so the multi-model file can be written in order while
+        // the other threads keep formatting
+        std::string out;
+        char line[128];
         Coordinate16 coords;
 
         KeyIterator* keyIterator;
         if (outputMode == LocalParameters::PDB_OUTPUT_MODE_COMPLEX || LocalParameters::PDB_OUTPUT_MODE_SINGLECHAIN) {
-            keyIterator = new MapIterator(complexIdToChainKeysMap, complexIndices);
+            keyIterator = new ComplexIterator(complexLookup, complexIndices);
         } else {
             keyIterator = new DbKeyIterator(db);
         }
         const size_t size = keyIterator->getSize();
-#pragma omp for schedule(dynamic, 1)
+#pragma omp for ordered schedule(dynamic, 1)
         for (size_t i = 0; i < size; ++i) {
+            out.clear();
+            std::string filename;
             std::pair<const unsigned int*, size_t> keys = keyIterator->getDbKeys(i);
             if (outputMode != LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
                 unsigned int key = keys.first[0];
@@ -162,17 +160,12 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
                         name = name.substr(0, name.find_last_of('_'));
                     }
                 }
-                std::string filename = par.db2 + "/" + name + ".pdb";
-                threadHandle = fopen(filename.c_str(), "w");
-                if (threadHandle == NULL) {
-                    perror(filename.c_str());
-                    EXIT(EXIT_FAILURE);
-                }
+                filename = par.db2 + "/" + name + ".pdb";
 
                 unsigned int headerId = db_header.getId(key);
                 const char* headerData = db_header.getData(headerId, thread_idx);
                 const size_t headerLen = db_header.getEntryLen(headerId) - 2;
-                writeTitle(threadHandle, headerData, headerLen);
+                writeTitle(out, headerData, headerLen);
             }
 
             std::string chainName = "A";
@@ -190,12 +183,13 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
                 float* ca = coords.read(caData, seqLen, caLen);
 
                 if (outputMode == LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
-                    fprintf(threadHandle, "MODEL % 8d\n", key);
+                    int len = snprintf(line, sizeof(line), "MODEL % 8d\n", key);
+                    out.append(line, len);
 
                     unsigned int headerId = db_header.getId(key);
                     const char* headerData = db_header.getData(headerId, thread_idx);
                     const size_t headerLen = db_header.getEntryLen(headerId) - 2;
-                    writeTitle(threadHandle, headerData, headerLen);
+                    writeTitle(out, headerData, headerLen);
                 } else {
                     // std::string name = db.getLookupEntryName(key);
                     size_t lookupKey = db.getLookupIdByKey(key);
@@ -212,13 +206,31 @@ int convert2pdb(int argc, const char **argv, const Command& command) {
                         aa = 'X';
                     }
                     const char* aa3 = threeLetterLookup[(int)(aa - 'A')];
-                    fprintf(threadHandle, "ATOM  %5d  CA  %s %c%4d    %8.3f%8.3f%8.3f\n", (int)(j + 1), aa3, chainName[0], int(j + 1), ca[j], ca[j + (1 * seqLen)], ca[j + (2 * seqLen)]);
+                    int len = snprintf(line, sizeof(line), "ATOM  %5d  CA  %s %c%4d    %8.3f%8.3f%8.3f\n", (int)(j + 1), aa3, chainName[0], int(j + 1), ca[j], ca[j + (1 * seqLen)], ca[j + (2 * seqLen)]);
+                    out.append(line, len);
                 }
                 if (outputMode == LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
-                    fprintf(threadHandle, "ENDMDL\n");
+                    out.append("ENDMDL\n");
                 }
             }
-            if (outputMode != LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
+            if (outputMode == LocalParameters::PDB_OUTPUT_MODE_MULTIMODEL) {
+#pragma omp ordered
+                {
+                    if (fwrite(out.c_str(), sizeof(char), out.size(), handle) != out.size()) {
+                        Debug(Debug::ERROR) << "Cannot write to file " << par.db2 << "\n";
+                        EXIT(EXIT_FAILURE);
+                    }
+                }
+            } else {
+                FILE* threadHandle = fopen(filename.c_str(), "w");
+                if (threadHandle == NULL) {
+                    perror(filename.c_str());
+                    EXIT(EXIT_FAILURE);
+                }
+                if (fwrite(out.c_str(), sizeof(char), out.size(), threadHandle) != out.size()) {
+                    Debug(Debug::ERROR) << "Cannot write to file " << filename << "\n";
+                    EXIT(EXIT_FAILURE);
+                }
                 fclose(threadHandle);
             }
         }
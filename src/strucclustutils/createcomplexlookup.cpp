@@ -0,0 +1,161 @@
+#include "LocalParameters.h"
+#include "Debug.h"
+#include "MultimerUtil.h"
+#include "Coordinate16.h"
+#include "tmalign/TMalign.h"
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+void ComplexSymmetry::findChainCopies(const std::string &db, int threads, std::vector<ChainCopy> &chains) {
+    DBReader<unsigned int> seqDbr(db.c_str(), (db + ".index").c_str(), threads, DBReader<unsigned int>::USE_DATA | DBReader<unsigned int>::USE_INDEX);
+    seqDbr.open(DBReader<unsigned int>::NOSORT);
+    const std::string caDb = db + "_ca";
+    DBReader<unsigned int> caDbr(caDb.c_str(), (caDb + ".index").c_str(), threads, DBReader<unsigned int>::USE_DATA | DBReader<unsigned int>::USE_INDEX);
+    caDbr.open(DBReader<unsigned int>::NOSORT);
+
+    ComplexLookup complexLookup;
+    std::vector<unsigned int> complexIds;
+    complexLookup.read(seqDbr, db, complexIds);
+
+    size_t copyCount = 0;
+    Debug::Progress progress(complexIds.size());
+#pragma omp parallel num_threads(threads) reduction(+:copyCount)
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<ChainCopy> threadChains;
+        std::vector<ChainCopy> complexChains;
+        // C-alphas of the references of the current complex, x, y and z blocks of each
+        std::vector<std::vector<float>> refCa;
+        std::vector<size_t> refIdx;
+        std::vector<float> chainCa;
+        Coordinate16 coords;
+#pragma omp for schedule(dynamic, 10)
+        for (size_t i = 0; i < complexIds.size(); i++) {
+            progress.updateProgress();
+            const ComplexLookup::ChainKeys chainKeys = complexLookup.getChainKeys(complexIds[i]);
+            if (chainKeys.size() < MULTIPLE_CHAINED_COMPLEX) {
+                continue;
+            }
+            complexChains.clear();
+            refIdx.clear();
+            bool hasCopies = false;
+            for (size_t chainIdx = 0; chainIdx < chainKeys.size(); chainIdx++) {
+                const unsigned int chainKey = chainKeys[chainIdx];
+                const size_t seqId = seqDbr.getId(chainKey);
+                const size_t caId = caDbr.getId(chainKey);
+                if (caId == UINT_MAX) {
+                    continue;
+                }
+                const char *seq = seqDbr.getData(seqId, thread_idx);
+                const unsigned int len = seqDbr.getSeqLen(seqId);
+                float *ca = coords.read(caDbr.getData(caId, thread_idx), len, caDbr.getEntryLen(caId));
+                chainCa.assign(ca, ca + len * 3);
+
+                ChainCopy chain;
+                chain.chainKey = chainKey;
+                chain.refKey = chainKey;
+                for (int a = 0; a < 3; a++) {
+                    for (int b = 0; b < 3; b++) {
+                        chain.rot[a][b] = (a == b) ? 1.0f : 0.0f;
+                    }
+                    double sum = 0.0;
+                    for (unsigned int pos = 0; pos < len; pos++) {
+                        sum += chainCa[a * len + pos];
+                    }
+                    chain.center[a] = (len > 0) ? (float) (sum / len) : 0.0f;
+                }
+                for (size_t r = 0; r < refIdx.size() && len > 0; r++) {
+                    const ChainCopy &ref = complexChains[refIdx[r]];
+                    const size_t refSeqId = seqDbr.getId(ref.chainKey);
+                    if (seqDbr.getSeqLen(refSeqId) != len || memcmp(seqDbr.getData(refSeqId, thread_idx), seq, len) != 0) {
+                        continue;
+                    }
+                    std::vector<float> &refCoords = refCa[r];
+                    Coordinates x;
+                    x.x = refCoords.data();
+                    x.y = refCoords.data() + len;
+                    x.z = refCoords.data() + 2 * len;
+                    Coordinates y;
+                    y.x = chainCa.data();
+                    y.y = chainCa.data() + len;
+                    y.z = chainCa.data() + 2 * len;
+                    float rms;
+                    float t[3];
+                    float u[3][3];
+                    Kabsch(x, y, len, 1, &rms, t, u);
+                    double sumSq = 0.0;
+                    for (unsigned int pos = 0; pos < len; pos++) {
+                        for (int a = 0; a < 3; a++) {
+                            const double superposed = (double) u[a][0] * x.x[pos] + (double) u[a][1] * x.y[pos] + (double) u[a][2] * x.z[pos] + t[a];
+                            const double diff = superposed - chainCa[a * len + pos];
+                            sumSq += diff * diff;
+                        }
+                    }
+                    if (std::sqrt(sumSq / len) <= SYMMETRY_RMSD_THRESHOLD) {
+                        chain.refKey = ref.chainKey;
+                        memcpy(chain.rot, u, sizeof(chain.rot));
+                        hasCopies = true;
+                        copyCount++;
+                        break;
+                    }
+                }
+                if (chain.refKey == chainKey) {
+                    if (refCa.size() <= refIdx.size()) {
+                        refCa.emplace_back();
+                    }
+                    refCa[refIdx.size()].assign(chainCa.begin(), chainCa.end());
+                    refIdx.emplace_back(complexChains.size());
+                }
+                complexChains.emplace_back(chain);
+            }
+            if (hasCopies) {
+                threadChains.insert(threadChains.end(), complexChains.begin(), complexChains.end());
+            }
+        }
+#pragma omp critical
+        {
+            chains.insert(chains.end(), threadChains.begin(), threadChains.end());
+        }
+    }
+    SORT_PARALLEL(chains.begin(), chains.end(), compareChainCopy);
+    caDbr.close();
+    seqDbr.close();
+    Debug(Debug::INFO) << copyCount << " chains are copies of another chain of their complex\n";
+}
+
+void ComplexSymmetry::createIndex(const std::string &db, int threads) {
+    std::vector<ChainCopy> chains;
+    const std::string caDb = db + "_ca";
+    if (FileUtil::fileExists((caDb + ".dbtype").c_str())) {
+        findChainCopies(db, threads, chains);
+    } else {
+        Debug(Debug::WARNING) << "No C-alpha database " << caDb << ". Chain copies are not stored\n";
+    }
+
+    IndexHeader header;
+    memcpy(header.magic, indexMagic(), sizeof(header.magic));
+    header.lookupSize = FileUtil::getFileSize(db + ".lookup");
+    header.chainCount = chains.size();
+    std::string indexDb = indexDbName(db);
+    DBWriter writer(indexDb.c_str(), (indexDb + ".index").c_str(), 1, false, Parameters::DBTYPE_GENERIC_DB);
+    writer.open();
+    writer.writeStart(0);
+    writer.writeAdd(reinterpret_cast<const char *>(&header), sizeof(IndexHeader), 0);
+    writer.writeAdd(reinterpret_cast<const char *>(chains.data()), chains.size() * sizeof(ChainCopy), 0);
+    writer.writeEnd(0, 0, false);
+    writer.close(true);
+}
+
+int createcomplexlookup(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    ComplexLookup::createIndex(par.db1);
+    ComplexSymmetry::createIndex(par.db1, par.threads);
+    return EXIT_SUCCESS;
+}
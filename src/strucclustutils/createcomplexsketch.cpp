@@ -0,0 +1,64 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "MultimerUtil.h"
+#include "ComplexSketch.h"
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+int createcomplexsketch(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    std::string ssDb = par.db1 + "_ss";
+    DBReader<unsigned int> reader(ssDb.c_str(), (ssDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    reader.open(DBReader<unsigned int>::NOSORT);
+
+    ComplexLookup complexLookup;
+    std::vector<unsigned int> complexIds;
+    complexLookup.read(reader, par.db1, complexIds);
+    if (complexIds.empty()) {
+        Debug(Debug::ERROR) << "No complexes found in " << par.db1 << ".lookup\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    DBWriter writer(par.db2.c_str(), par.db2Index.c_str(), par.threads, false, Parameters::DBTYPE_GENERIC_DB);
+    writer.open();
+
+    size_t hashCount = 0;
+    Debug::Progress progress(complexIds.size());
+#pragma omp parallel reduction(+:hashCount)
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<uint32_t> hashes;
+#pragma omp for schedule(dynamic, 10)
+        for (size_t i = 0; i < complexIds.size(); i++) {
+            progress.updateProgress();
+            const ComplexLookup::ChainKeys chainKeys = complexLookup.getChainKeys(complexIds[i]);
+            for (size_t chainIdx = 0; chainIdx < chainKeys.size(); chainIdx++) {
+                const size_t id = reader.getId(chainKeys[chainIdx]);
+                ComplexSketch::addSequence(reader.getData(id, thread_idx), reader.getSeqLen(id), hashes);
+            }
+            ComplexSketch::finalize(hashes);
+            const ComplexSketch::EntryHeader header = ComplexSketch::makeHeader(chainKeys[0], chainKeys.size());
+            writer.writeStart(thread_idx);
+            writer.writeAdd(reinterpret_cast<const char *>(&header), sizeof(ComplexSketch::EntryHeader), thread_idx);
+            writer.writeAdd(reinterpret_cast<const char *>(hashes.data()), hashes.size() * sizeof(uint32_t), thread_idx);
+            writer.writeEnd(complexIds[i], thread_idx, false);
+            hashCount += hashes.size();
+            hashes.clear();
+        }
+    }
+    writer.close(true);
+    reader.close();
+
+    Debug(Debug::INFO) << "Sketched " << complexIds.size() << " complexes with " << hashCount << " hashes\n";
+    return EXIT_SUCCESS;
+}
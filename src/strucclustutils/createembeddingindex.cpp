@@ -0,0 +1,167 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "EmbeddingIndex.h"
+
+#include <cmath>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+// k-means on the unit sphere is trained on at most this many entries per list
+static const size_t TRAIN_ENTRIES_PER_LIST = 32;
+static const int TRAIN_ITERATIONS = 10;
+
+static void normalizeCentroid(float *centroid) {
+    float norm = 0.0f;
+    for (size_t i = 0; i < EmbeddingIndex::DIM; i++) {
+        norm += centroid[i] * centroid[i];
+    }
+    if (norm > 0.0f) {
+        const float invNorm = 1.0f / sqrtf(norm);
+        for (size_t i = 0; i < EmbeddingIndex::DIM; i++) {
+            centroid[i] *= invNorm;
+        }
+    }
+}
+
+int createembeddingindex(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    std::string ssDb = par.db1 + "_ss";
+    DBReader<unsigned int> reader(ssDb.c_str(), (ssDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    reader.open(DBReader<unsigned int>::NOSORT);
+
+    const size_t dim = EmbeddingIndex::DIM;
+    const size_t entries = reader.getSize();
+    size_t lists = par.embeddingLists;
+    if (lists == 0) {
+        lists = static_cast<size_t>(sqrt(static_cast<double>(entries)));
+    }
+    lists = std::max(std::min(lists, entries), (size_t)1);
+    const size_t trainSize = std::min(entries, lists * TRAIN_ENTRIES_PER_LIST);
+
+    Debug(Debug::INFO) << "Train " << lists << " lists on " << trainSize << " entries\n";
+    std::vector<float> train(trainSize * dim);
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+#pragma omp for schedule(static)
+        for (size_t i = 0; i < trainSize; i++) {
+            // evenly spaced entries, the database order is arbitrary
+            const size_t id = i * entries / trainSize;
+            EmbeddingIndex::computeEmbedding(reader.getData(id, thread_idx), reader.getSeqLen(id), &train[i * dim]);
+        }
+    }
+
+    std::vector<float> centroids(lists * dim);
+    for (size_t l = 0; l < lists && trainSize > 0; l++) {
+        const size_t i = l * trainSize / lists;
+        memcpy(&centroids[l * dim], &train[i * dim], sizeof(float) * dim);
+    }
+    std::vector<size_t> assignment(trainSize);
+    std::vector<size_t> listSize(lists);
+    for (int iteration = 0; iteration < TRAIN_ITERATIONS && trainSize > 0; iteration++) {
+#pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < trainSize; i++) {
+            assignment[i] = EmbeddingIndex::closestList(&train[i * dim], centroids.data(), lists);
+        }
+        std::fill(centroids.begin(), centroids.end(), 0.0f);
+        std::fill(listSize.begin(), listSize.end(), 0);
+        for (size_t i = 0; i < trainSize; i++) {
+            float *centroid = &centroids[assignment[i] * dim];
+            for (size_t d = 0; d < dim; d++) {
+                centroid[d] += train[i * dim + d];
+            }
+            listSize[assignment[i]]++;
+        }
+        for (size_t l = 0; l < lists; l++) {
+            // an empty list restarts from a training entry
+            if (listSize[l] == 0) {
+                const size_t i = (l * 7919 + iteration) % trainSize;
+                memcpy(&centroids[l * dim], &train[i * dim], sizeof(float) * dim);
+            }
+            normalizeCentroid(&centroids[l * dim]);
+        }
+    }
+    train.clear();
+    train.shrink_to_fit();
+
+    Debug(Debug::INFO) << "Assign entries to lists\n";
+    std::vector<unsigned int> entryList(entries);
+    Debug::Progress progress(entries);
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<float> embedding(dim);
+#pragma omp for schedule(dynamic, 100)
+        for (size_t id = 0; id < entries; id++) {
+            progress.updateProgress();
+            EmbeddingIndex::computeEmbedding(reader.getData(id, thread_idx), reader.getSeqLen(id), embedding.data());
+            entryList[id] = static_cast<unsigned int>(EmbeddingIndex::closestList(embedding.data(), centroids.data(), lists));
+        }
+    }
+
+    // entries grouped by list in database order
+    std::vector<size_t> listOffset(lists + 1, 0);
+    for (size_t id = 0; id < entries; id++) {
+        listOffset[entryList[id] + 1]++;
+    }
+    for (size_t l = 0; l < lists; l++) {
+        listOffset[l + 1] += listOffset[l];
+    }
+    std::vector<size_t> members(entries);
+    {
+        std::vector<size_t> fill(listOffset.begin(), listOffset.end() - 1);
+        for (size_t id = 0; id < entries; id++) {
+            members[fill[entryList[id]]++] = id;
+        }
+    }
+
+    DBWriter writer(par.db2.c_str(), par.db2Index.c_str(), par.threads, false, LocalParameters::DBTYPE_GENERIC_DB);
+    writer.open();
+    EmbeddingIndex::Header header;
+    header.dim = static_cast<uint32_t>(dim);
+    header.lists = static_cast<uint32_t>(lists);
+    writer.writeStart(0);
+    writer.writeAdd(reinterpret_cast<const char *>(&header), sizeof(header), 0);
+    writer.writeAdd(reinterpret_cast<const char *>(centroids.data()), sizeof(float) * centroids.size(), 0);
+    writer.writeEnd(EmbeddingIndex::CENTROID_KEY, 0);
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<float> embedding(dim);
+        std::vector<char> buffer;
+#pragma omp for schedule(dynamic, 1)
+        for (size_t l = 0; l < lists; l++) {
+            buffer.resize((listOffset[l + 1] - listOffset[l]) * EmbeddingIndex::ENTRY_SIZE);
+            char *entry = buffer.data();
+            for (size_t i = listOffset[l]; i < listOffset[l + 1]; i++) {
+                const size_t id = members[i];
+                EmbeddingIndex::computeEmbedding(reader.getData(id, thread_idx), reader.getSeqLen(id), embedding.data());
+                const unsigned int key = reader.getDbKey(id);
+                const float scale = EmbeddingIndex::quantize(embedding.data(), reinterpret_cast<unsigned char *>(entry + sizeof(unsigned int) + sizeof(float)));
+                memcpy(entry, &key, sizeof(unsigned int));
+                memcpy(entry + sizeof(unsigned int), &scale, sizeof(float));
+                entry += EmbeddingIndex::ENTRY_SIZE;
+            }
+            writer.writeData(buffer.data(), buffer.size(), static_cast<unsigned int>(l + 1), thread_idx);
+        }
+    }
+    writer.close(true);
+    reader.close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "Sequence.h"
+#include "SubstitutionMatrix.h"
+#include "EvalueNeuralNet.h"
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+int createmulambda(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    std::string ssDb = par.db1 + "_ss";
+    DBReader<unsigned int> reader(ssDb.c_str(), (ssDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    reader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+
+    SubstitutionMatrix subMat3Di(par.scoringMatrixFile.values.aminoacid().c_str(), 2.1, par.scoreBias);
+
+    // one entry of two doubles (mu, lambda) per sequence, read back without parsing by structurealign and structureungappedalign
+    DBWriter writer(par.db2.c_str(), par.db2Index.c_str(), par.threads, false, LocalParameters::DBTYPE_GENERIC_DB);
+    writer.open();
+
+    const size_t batches = (reader.getSize() + EvalueNeuralNet::BATCH_SIZE - 1) / EvalueNeuralNet::BATCH_SIZE;
+    Debug::Progress progress(batches);
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        // mu and lambda do not depend on the database size
+        EvalueNeuralNet evaluer(1, &subMat3Di);
+        Sequence seq3Di(par.maxSeqLen, reader.getDbtype(), (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
+        std::vector<std::pair<double, double>> predictions(EvalueNeuralNet::BATCH_SIZE);
+        double buffer[2];
+
+#pragma omp for schedule(dynamic, 1)
+        for (size_t b = 0; b < batches; b++) {
+            progress.updateProgress();
+            const size_t start = b * EvalueNeuralNet::BATCH_SIZE;
+            const size_t end = std::min(start + EvalueNeuralNet::BATCH_SIZE, reader.getSize());
+            for (size_t i = start; i < end; i++) {
+                seq3Di.mapSequence(i, reader.getDbKey(i), reader.getData(i, thread_idx), reader.getSeqLen(i));
+                evaluer.addToBatch(seq3Di.numSequence, seq3Di.L);
+            }
+            evaluer.predictBatch(predictions.data());
+            for (size_t i = start; i < end; i++) {
+                buffer[0] = predictions[i - start].first;
+                buffer[1] = predictions[i - start].second;
+                writer.writeData(reinterpret_cast<const char *>(buffer), sizeof(buffer), reader.getDbKey(i), thread_idx);
+            }
+        }
+    }
+    writer.close(true);
+    reader.close();
+    return EXIT_SUCCESS;
+}
@@ -5,73 +5,49 @@
 #include "DBReader.h"
 #include "DBWriter.h"
 #include "FileUtil.h"
-#include "TranslateNucl.h"
-#include "MemoryMapped.h"
 #include "MultimerUtil.h"
-#include "LDDT.h"
-#include "CalcProbTP.h"
-#include <map>
+#include "itoa.h"
+
+#include <algorithm>
 #ifdef OPENMP
 #include <omp.h>
 #endif
 
-void getComplexNameChainName(const chainName_t &chainName, compNameChainName_t &compAndChainName) {
+// the complex name is the chain name up to its last '_', the chain is the rest.
+// Names without '_' are used as both
+static void appendComplexName(std::string &out, const chainName_t &chainName) {
     size_t pos = chainName.rfind('_');
-    std::string comp = chainName.substr(0, pos);
-    std::string chain = chainName.substr(pos + 1);
-    compAndChainName = {comp, chain};
+    out.append(chainName, 0, pos);
 }
 
-void getScoreComplexResults(
-        std::vector<ScoreComplexResult> &scoreComplexResults,
-        const std::vector<std::string> &qChainVector,
-        const std::vector<std::string> &tChainVector,
-        double qTMScore,
-        double tTMScore,
-        const std::string &u,
-        const std::string &t,
-        unsigned int qComplexId,
-        unsigned int assId
-) {
-    char buffer[1024];
-    resultToWrite_t resultToWrite;
-    std::string qComplexName;
-    std::string tComplexName;
-    std::string qChainString;
-    std::string tChainString;
-    compNameChainName_t compAndChainName;
-    getComplexNameChainName(qChainVector[0], compAndChainName);
-    qComplexName = compAndChainName.first;
-    qChainString = compAndChainName.second;
-    getComplexNameChainName(tChainVector[0], compAndChainName);
-    tComplexName = compAndChainName.first;
-    tChainString = compAndChainName.second;
-    for (size_t qChainId = 1; qChainId < qChainVector.size(); qChainId++) {
-        getComplexNameChainName(qChainVector[qChainId], compAndChainName);
-        qChainString += ',' + compAndChainName.second;
-    }
-    for (size_t tChainId = 1; tChainId < tChainVector.size(); tChainId++) {
-        getComplexNameChainName(tChainVector[tChainId], compAndChainName);
-        tChainString += ',' + compAndChainName.second;
-    }
-    int count = snprintf(buffer,sizeof(buffer),"%s\t%s\t%s\t%s\t%1.5f\t%1.5f\t%s\t%s\t%d\n", qComplexName.c_str(), tComplexName.c_str(), qChainString.c_str(), tChainString.c_str(), qTMScore, tTMScore, u.c_str(), t.c_str(), assId);
-    resultToWrite.append(buffer, count);
-    scoreComplexResults.emplace_back(qComplexId, assId, resultToWrite);
+static void appendChainName(std::string &out, const chainName_t &chainName) {
+    size_t pos = chainName.rfind('_');
+    out.append(chainName, (pos == std::string::npos) ? 0 : pos + 1, std::string::npos);
 }
 
 struct ComplexAlignment {
-    ComplexAlignment(){};
-    ComplexAlignment(chainName_t &qChainName, chainName_t &tChainName, double qTmScore, double tTmScore, std::string &u, std::string &t,  unsigned int assId) : qTMScore(qTmScore), tTMScore(tTmScore), u(u), t(t), assId(assId){
-        qChainNames = {qChainName};
-        tChainNames = {tChainName};
-    };
-    std::vector<chainName_t> qChainNames;
-    std::vector<chainName_t> tChainNames;
+    unsigned int assId;
     double qTMScore;
     double tTMScore;
-    std::string u;
-    std::string t;
-    unsigned int assId;
+    // points into the scoremultimer result of the first chain pair of the assignment
+    const char *u;
+    size_t uLen;
+    const char *t;
+    size_t tLen;
+    std::string qComplexName;
+    std::string tComplexName;
+    std::string qChains;
+    std::string tChains;
+
+    static bool compareByAssId(const ComplexAlignment &first, const ComplexAlignment &second) {
+        return first.assId < second.assId;
+    }
+};
+
+// report lines of one query complex, entries holds the assignment id and end offset of each line
+struct ComplexReport {
+    std::string data;
+    std::vector<std::pair<unsigned int, size_t>> entries;
 };
 
 int createmultimerreport(int argc, const char **argv, const Command &command) {
@@ -80,8 +56,6 @@ int createmultimerreport(int argc, const char **argv, const Command &command) {
     const bool sameDB = par.db1.compare(par.db2) == 0 ? true : false;
     const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
     int dbaccessMode = (DBReader<unsigned int>::USE_INDEX);
-    std::map<unsigned int, unsigned int> qKeyToSet;
-    std::map<unsigned int, unsigned int> tKeyToSet;
     IndexReader qDbr(par.db1, par.threads,  IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0, dbaccessMode);
     IndexReader qDbrHeader(par.db1, par.threads, IndexReader::SRC_HEADERS , (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
     IndexReader *tDbrHeader;
@@ -104,82 +78,133 @@ int createmultimerreport(int argc, const char **argv, const Command &command) {
     DBWriter resultWriter(par.db4.c_str(), par.db4Index.c_str(), 1, shouldCompress, dbType);
     resultWriter.open();
     const bool isDb = par.dbOut;
-    std::string qLookupFile = par.db1 + ".lookup";
-    TranslateNucl translateNucl(static_cast<TranslateNucl::GenCode>(par.translationTable));
 
-    std::map<unsigned int, unsigned int> qChainKeyToComplexIdMap;
-    std::map<unsigned int, std::vector<unsigned int>> qComplexIdToChainKeyMap;
+    ComplexLookup qComplexLookup;
     std::vector<unsigned int> qComplexIdVec;
-    getKeyToIdMapIdToKeysMapIdVec(alnDbr, qDbr, qLookupFile, qChainKeyToComplexIdMap, qComplexIdToChainKeyMap, qComplexIdVec);
-    qChainKeyToComplexIdMap.clear();
+    qComplexLookup.read(qDbr, par.db1, qComplexIdVec);
+    // the report is ordered by query complex id and assignment id
+    std::sort(qComplexIdVec.begin(), qComplexIdVec.end());
     Debug::Progress progress(qComplexIdVec.size());
 
-    std::vector<ScoreComplexResult> complexResults;
+    // the complexes are formatted in parallel in batches, which are then written in order
+    const size_t batchSize = std::min(qComplexIdVec.size(), localThreads * 1024);
+    std::vector<ComplexReport> reports(batchSize);
 #pragma omp parallel num_threads(localThreads)
     {
         unsigned int thread_idx = 0;
 #ifdef OPENMP
         thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-        Matcher::result_t res;
-        std::vector<ScoreComplexResult> localComplexResults;
-#pragma omp for schedule(dynamic, 10) nowait
-        for (size_t queryComplexIdx = 0; queryComplexIdx < qComplexIdVec.size(); queryComplexIdx++) {
-            progress.updateProgress();
-            std::vector<unsigned int> assIdVec;
-            std::vector<ComplexAlignment> compAlns;
-            //
-            unsigned int qComplexId = qComplexIdVec[queryComplexIdx];
-            std::vector<unsigned int> &qChainKeys = qComplexIdToChainKeyMap[qComplexId];
-            for (size_t qChainIdx = 0; qChainIdx < qChainKeys.size(); qChainIdx++ ) {
-                unsigned int qChainKey = qChainKeys[qChainIdx];
-                unsigned int qChainDbKey = alnDbr.getId(qChainKey);
-                if (qChainDbKey == NOT_AVAILABLE_CHAIN_KEY) {
-                    continue;
-                }
-                size_t qHeaderId = qDbrHeader.sequenceReader->getId(qChainKey);
-                const char *qHeader = qDbrHeader.sequenceReader->getData(qHeaderId, thread_idx);
-                compNameChainName_t qCompAndChainName;
-                chainName_t queryChainName = Util::parseFastaHeader(qHeader);
-                getComplexNameChainName(queryChainName, qCompAndChainName);
-                char *data = alnDbr.getData(qChainDbKey, thread_idx);
-                while (*data != '\0') {
-                    ComplexDataHandler retComplex = parseScoreComplexResult(data, res);
-                    if (!retComplex.isValid){
-                        Debug(Debug::ERROR) << "No scorecomplex result provided";
-                        EXIT(EXIT_FAILURE);
+        const char *entry[255];
+        char buffer[32];
+        std::vector<ComplexAlignment> compAlns;
+        size_t compAlnCount = 0;
+        for (size_t batchStart = 0; batchStart < qComplexIdVec.size(); batchStart += batchSize) {
+            const size_t batchEnd = std::min(batchStart + batchSize, qComplexIdVec.size());
+#pragma omp for schedule(dynamic, 10)
+            for (size_t queryComplexIdx = batchStart; queryComplexIdx < batchEnd; queryComplexIdx++) {
+                progress.updateProgress();
+                compAlnCount = 0;
+                unsigned int qComplexId = qComplexIdVec[queryComplexIdx];
+                const ComplexLookup::ChainKeys qChainKeys = qComplexLookup.getChainKeys(qComplexId);
+                for (size_t qChainIdx = 0; qChainIdx < qChainKeys.size(); qChainIdx++ ) {
+                    unsigned int qChainKey = qChainKeys[qChainIdx];
+                    unsigned int qChainDbKey = alnDbr.getId(qChainKey);
+                    if (qChainDbKey == NOT_AVAILABLE_CHAIN_KEY) {
+                        continue;
                     }
-                    data = Util::skipLine(data);
-                    size_t tHeaderId = tDbrHeader->sequenceReader->getId(res.dbKey);
-                    const char *tHeader = tDbrHeader->sequenceReader->getData(tHeaderId, thread_idx);
-                    chainName_t targetChainName = Util::parseFastaHeader(tHeader);
-                    unsigned int assId = retComplex.assId;
-                    unsigned int compAlnIdx = std::find(assIdVec.begin(), assIdVec.end(), assId) - assIdVec.begin();
-                    if (compAlnIdx == compAlns.size()) {
-                        assIdVec.emplace_back(assId);
-                        compAlns.emplace_back(queryChainName, targetChainName, retComplex.qTmScore, retComplex.tTmScore, retComplex.uString, retComplex.tString, assId);
-                    } else {
-                        compAlns[compAlnIdx].qChainNames.emplace_back(queryChainName);
-                        compAlns[compAlnIdx].tChainNames.emplace_back(targetChainName);
+                    size_t qHeaderId = qDbrHeader.sequenceReader->getId(qChainKey);
+                    const char *qHeader = qDbrHeader.sequenceReader->getData(qHeaderId, thread_idx);
+                    chainName_t queryChainName = Util::parseFastaHeader(qHeader);
+                    char *data = alnDbr.getData(qChainDbKey, thread_idx);
+                    while (*data != '\0') {
+                        // only the target, TM-scores, superposition and assignment id columns of the
+                        // scoremultimer result are needed
+                        const size_t columns = Util::getWordsOfLine(data, entry, 255);
+                        if (columns != 16) {
+                            Debug(Debug::ERROR) << "No scorecomplex result provided";
+                            EXIT(EXIT_FAILURE);
+                        }
+                        data = Util::skipLine(data);
+                        const unsigned int dbKey = Util::fast_atoi<unsigned int>(entry[0]);
+                        const unsigned int assId = Util::fast_atoi<unsigned int>(entry[15]);
+                        size_t tHeaderId = tDbrHeader->sequenceReader->getId(dbKey);
+                        const char *tHeader = tDbrHeader->sequenceReader->getData(tHeaderId, thread_idx);
+                        chainName_t targetChainName = Util::parseFastaHeader(tHeader);
+                        size_t compAlnIdx = 0;
+                        while (compAlnIdx < compAlnCount && compAlns[compAlnIdx].assId != assId) {
+                            compAlnIdx++;
+                        }
+                        if (compAlnIdx == compAlnCount) {
+                            if (compAlnCount == compAlns.size()) {
+                                compAlns.emplace_back();
+                            }
+                            ComplexAlignment &aln = compAlns[compAlnCount++];
+                            aln.assId = assId;
+                            aln.qTMScore = strtod(entry[11], NULL);
+                            aln.tTMScore = strtod(entry[12], NULL);
+                            aln.u = entry[13];
+                            aln.uLen = entry[14] - entry[13] - 1;
+                            aln.t = entry[14];
+                            aln.tLen = entry[15] - entry[14] - 1;
+                            aln.qComplexName.clear();
+                            appendComplexName(aln.qComplexName, queryChainName);
+                            aln.tComplexName.clear();
+                            appendComplexName(aln.tComplexName, targetChainName);
+                            aln.qChains.clear();
+                            appendChainName(aln.qChains, queryChainName);
+                            aln.tChains.clear();
+                            appendChainName(aln.tChains, targetChainName);
+                        } else {
+                            ComplexAlignment &aln = compAlns[compAlnIdx];
+                            aln.qChains.push_back(',');
+                            appendChainName(aln.qChains, queryChainName);
+                            aln.tChains.push_back(',');
+                            appendChainName(aln.tChains, targetChainName);
+                        }
                     }
-                } // while end
+                }
+                std::sort(compAlns.begin(), compAlns.begin() + compAlnCount, ComplexAlignment::compareByAssId);
+                ComplexReport &report = reports[queryComplexIdx - batchStart];
+                for (size_t compAlnIdx = 0; compAlnIdx < compAlnCount; compAlnIdx++) {
+                    const ComplexAlignment &aln = compAlns[compAlnIdx];
+                    std::string &out = report.data;
+                    out.append(aln.qComplexName);
+                    out.push_back('\t');
+                    out.append(aln.tComplexName);
+                    out.push_back('\t');
+                    out.append(aln.qChains);
+                    out.push_back('\t');
+                    out.append(aln.tChains);
+                    out.push_back('\t');
+                    int count = snprintf(buffer, sizeof(buffer), "%1.5f\t%1.5f\t", aln.qTMScore, aln.tTMScore);
+                    out.append(buffer, count);
+                    out.append(aln.u, aln.uLen);
+                    out.push_back('\t');
+                    out.append(aln.t, aln.tLen);
+                    out.push_back('\t');
+                    char *end = Itoa::u32toa_sse2(aln.assId, buffer);
+                    out.append(buffer, end - buffer - 1);
+                    out.push_back('\n');
+                    report.entries.emplace_back(aln.assId, out.size());
+                }
             }
-            for (size_t compAlnIdx = 0; compAlnIdx < compAlns.size(); compAlnIdx++) {
-                const ComplexAlignment &aln = compAlns[compAlnIdx];
-                getScoreComplexResults(localComplexResults, aln.qChainNames, aln.tChainNames, aln.qTMScore, aln.tTMScore, aln.u, aln.t, qComplexId, aln.assId);
+#pragma omp single
+            {
+                for (size_t i = 0; i < batchEnd - batchStart; i++) {
+                    ComplexReport &report = reports[i];
+                    size_t start = 0;
+                    for (size_t entryIdx = 0; entryIdx < report.entries.size(); entryIdx++) {
+                        const size_t end = report.entries[entryIdx].second;
+                        resultWriter.writeData(report.data.c_str() + start, end - start, report.entries[entryIdx].first, 0, isDb, isDb);
+                        start = end;
+                    }
+                    report.data.clear();
+                    report.entries.clear();
+                }
             }
-        } // for end
-#pragma omp critical
-        {
-            complexResults.insert(complexResults.end(), localComplexResults.begin(), localComplexResults.end());
         }
     } // MP end
-    SORT_PARALLEL(complexResults.begin(), complexResults.end(), compareComplexResultByQuery);
-    for (size_t complexResIdx = 0; complexResIdx < complexResults.size(); complexResIdx++) {
-        const ScoreComplexResult& cRes = complexResults[complexResIdx];
-        const resultToWrite_t& data = cRes.resultToWrite;
-        resultWriter.writeData(data.c_str(), data.length(), cRes.assId, 0, isDb, isDb);
-    }
     resultWriter.close(true);
     if (isDb == false) {
         FileUtil::remove(par.db4Index.c_str());
@@ -189,4 +214,4 @@ int createmultimerreport(int argc, const char **argv, const Command &command) {
         delete tDbrHeader;
     }
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,120 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "QueryMatcher.h"
+#include "EmbeddingIndex.h"
+
+#include <algorithm>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+static bool compareListByScore(const std::pair<float, size_t> &first, const std::pair<float, size_t> &second) {
+    if (first.first != second.first) {
+        return first.first > second.first;
+    }
+    return first.second < second.second;
+}
+
+int embeddingprefilter(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+
+    std::string ssDb = par.db1 + "_ss";
+    DBReader<unsigned int> qdbr(ssDb.c_str(), (ssDb + ".index").c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    qdbr.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+    if (Parameters::isEqualDbtype(qdbr.getDbtype(), Parameters::DBTYPE_HMM_PROFILE)) {
+        Debug(Debug::ERROR) << "Embedding prefilter does not support profile queries\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    DBReader<unsigned int> index(par.db2.c_str(), par.db2Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    index.open(DBReader<unsigned int>::NOSORT);
+    if (par.preloadMode != Parameters::PRELOAD_MODE_MMAP) {
+        index.readMmapedDataInMemory();
+    }
+
+    const size_t centroidId = index.getId(EmbeddingIndex::CENTROID_KEY);
+    if (centroidId == UINT_MAX) {
+        Debug(Debug::ERROR) << "Embedding index " << par.db2 << " has no centroids\n";
+        EXIT(EXIT_FAILURE);
+    }
+    EmbeddingIndex::Header header;
+    const char *centroidData = index.getData(centroidId, 0);
+    memcpy(&header, centroidData, sizeof(header));
+    if (header.dim != EmbeddingIndex::DIM) {
+        Debug(Debug::ERROR) << "Embedding index " << par.db2 << " has " << header.dim << " dimensions, expected " << EmbeddingIndex::DIM << ". Please recreate it\n";
+        EXIT(EXIT_FAILURE);
+    }
+    const size_t lists = header.lists;
+    std::vector<float> centroids(lists * EmbeddingIndex::DIM);
+    memcpy(centroids.data(), centroidData + sizeof(header), sizeof(float) * centroids.size());
+    const size_t probes = std::min(static_cast<size_t>(par.embeddingProbes), lists);
+
+    DBWriter writer(par.db3.c_str(), par.db3Index.c_str(), par.threads, par.compressed, Parameters::DBTYPE_PREFILTER_RES);
+    writer.open();
+
+    Debug::Progress progress(qdbr.getSize());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<float> embedding(EmbeddingIndex::DIM);
+        std::vector<std::pair<float, size_t>> listScores(lists);
+        std::vector<std::pair<float, unsigned int>> candidates;
+        char buffer[100];
+        std::string result;
+
+#pragma omp for schedule(dynamic, 10)
+        for (size_t id = 0; id < qdbr.getSize(); id++) {
+            progress.updateProgress();
+            EmbeddingIndex::computeEmbedding(qdbr.getData(id, thread_idx), qdbr.getSeqLen(id), embedding.data());
+
+            // search the lists with the closest centroids
+            for (size_t l = 0; l < lists; l++) {
+                listScores[l] = std::make_pair(EmbeddingIndex::dot(embedding.data(), &centroids[l * EmbeddingIndex::DIM]), l);
+            }
+            std::partial_sort(listScores.begin(), listScores.begin() + probes, listScores.end(), compareListByScore);
+            for (size_t p = 0; p < probes; p++) {
+                const size_t listId = index.getId(static_cast<unsigned int>(listScores[p].second + 1));
+                if (listId == UINT_MAX) {
+                    continue;
+                }
+                const char *entry = index.getData(listId, thread_idx);
+                const size_t members = (index.getEntryLen(listId) - 1) / EmbeddingIndex::ENTRY_SIZE;
+                for (size_t m = 0; m < members; m++, entry += EmbeddingIndex::ENTRY_SIZE) {
+                    unsigned int key;
+                    float scale;
+                    memcpy(&key, entry, sizeof(unsigned int));
+                    memcpy(&scale, entry + sizeof(unsigned int), sizeof(float));
+                    const unsigned char *code = reinterpret_cast<const unsigned char *>(entry + sizeof(unsigned int) + sizeof(float));
+                    candidates.emplace_back(EmbeddingIndex::dot(embedding.data(), code, scale), key);
+                }
+            }
+
+            const size_t hitCount = std::min(candidates.size(), par.maxResListLen);
+            std::partial_sort(candidates.begin(), candidates.begin() + hitCount, candidates.end(), compareListByScore);
+            for (size_t i = 0; i < hitCount; i++) {
+                // cosine similarity in per mille, no diagonal is known
+                hit_t hit;
+                hit.seqId = candidates[i].second;
+                hit.prefScore = static_cast<int>(candidates[i].first * 1000.0f + 0.5f);
+                hit.diagonal = 0;
+                size_t len = QueryMatcher::prefilterHitToBuffer(buffer, hit);
+                result.append(buffer, len);
+            }
+            writer.writeData(result.c_str(), result.length(), qdbr.getDbKey(id), thread_idx);
+            result.clear();
+            candidates.clear();
+        }
+    }
+    writer.close();
+    index.close();
+    qdbr.close();
+    return EXIT_SUCCESS;
+}
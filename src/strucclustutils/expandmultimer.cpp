@@ -24,53 +24,9 @@ bool compareChainKeyPair_t(const ChainKeyPair_t &first, const ChainKeyPair_t &se
     return false;
 }
 
-int expandmultimer(int argc, const char **argv, const Command &command) {
-    LocalParameters &par = LocalParameters::getLocalInstance();
-    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
-
-    DBReader<unsigned int> alnDbr(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
-    alnDbr.open(DBReader<unsigned int>::LINEAR_ACCCESS);
-
-    int dbType = Parameters::DBTYPE_CLUSTER_RES;
-    uint16_t extended = DBReader<unsigned int>::getExtendedDbtype(alnDbr.getDbtype());
-    bool needSrc = false;
-    if (extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC) {
-        needSrc = true;
-        dbType = DBReader<unsigned int>::setExtendedDbtype(dbType, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
-    }
-    DBWriter resultWriter(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed, dbType);
-    resultWriter.open();
-
-    const bool touch = par.preloadMode != Parameters::PRELOAD_MODE_MMAP;
-    IndexReader tDbr(
-        par.db2,
-        par.threads,
-        needSrc ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-        touch ? IndexReader::PRELOAD_INDEX : 0,
-        DBReader<unsigned int>::USE_INDEX
-    );
-
-    IndexReader qDbr(
-        par.db1,
-        par.threads,
-        needSrc ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
-        touch ? IndexReader::PRELOAD_INDEX : 0,
-        DBReader<unsigned int>::USE_INDEX
-    );
-
-    std::vector<unsigned int> qComplexIndices;
-    std::vector<unsigned int> dbComplexIndices;
-    chainKeyToComplexId_t qChainKeyToComplexIdMap;
-    chainKeyToComplexId_t dbChainKeyToComplexIdMap;
-    complexIdToChainKeys_t qComplexIdToChainKeysMap;
-    complexIdToChainKeys_t dbComplexIdToChainKeysMap;
-    std::string qLookupFile = par.db1 + ".lookup";
-    std::string dbLookupFile = par.db2 + ".lookup";
-    getKeyToIdMapIdToKeysMapIdVec(alnDbr, qDbr, qLookupFile, qChainKeyToComplexIdMap, qComplexIdToChainKeysMap, qComplexIndices);
-    getKeyToIdMapIdToKeysMapIdVec(alnDbr, tDbr, dbLookupFile, dbChainKeyToComplexIdMap, dbComplexIdToChainKeysMap, dbComplexIndices);
-    dbComplexIndices.clear();
-    qChainKeyToComplexIdMap.clear();
-
+void expandMultimerResults(DBReader<unsigned int> &alnDbr, const ComplexLookup &qComplexLookup, const std::vector<unsigned int> &qComplexIndices,
+                           const ComplexLookup &dbComplexLookup, DBReader<unsigned int> &tDbr,
+                           float minAssignedChainsRatio, int monomerIncludeMode, const StructureResultWriter &writer) {
     Debug::Progress progress(qComplexIndices.size());
 #pragma omp parallel
     {
@@ -85,7 +41,7 @@ int expandmultimer(int argc, const char **argv, const Command &command) {
         // for each q complex
         for (size_t qCompIdx = 0; qCompIdx < qComplexIndices.size(); qCompIdx++) {
             unsigned int qComplexId = qComplexIndices[qCompIdx];
-            std::vector<unsigned int> &qChainKeys = qComplexIdToChainKeysMap.at(qComplexId);
+            const ComplexLookup::ChainKeys qChainKeys = qComplexLookup.getChainKeys(qComplexId);
             // For the current query complex
             for (size_t qChainIdx=0; qChainIdx<qChainKeys.size(); qChainIdx++) {
                 unsigned int qKey = alnDbr.getId(qChainKeys[qChainIdx]);
@@ -97,28 +53,31 @@ int expandmultimer(int argc, const char **argv, const Command &command) {
                     char dbKeyBuffer[255 + 1];
                     Util::parseKey(data, dbKeyBuffer);
                     const auto dbChainKey = (unsigned int) strtoul(dbKeyBuffer, NULL, 10);
-                    const unsigned int dbComplexId = dbChainKeyToComplexIdMap.at(dbChainKey);
-                    // find all db complex aligned to the query complex.
-                    dbFoundIndices.insert(dbComplexId);
+                    const unsigned int dbComplexId = dbComplexLookup.getComplexId(dbChainKey);
+                    // find all db complex aligned to the query complex, that can be assigned to it.
+                    if (dbComplexId != NOT_AVAILABLE_CHAIN_KEY
+                        && canAssignComplexes(qChainKeys.size(), dbComplexLookup.getChainKeys(dbComplexId).size(), minAssignedChainsRatio, monomerIncludeMode)) {
+                        dbFoundIndices.insert(dbComplexId);
+                    }
                     data = Util::skipLine(data);
                 }
             }
             if (dbFoundIndices.empty()) {
                 for (size_t qChainIdx=0; qChainIdx<qChainKeys.size(); qChainIdx++) {
-                    resultWriter.writeData(result.c_str(),result.length(),qChainKeys[qChainIdx],thread_idx);
+                    writer(result.c_str(),result.length(),qChainKeys[qChainIdx],thread_idx);
                 }
                 continue;
             }
             // Among all db complexes aligned to query complex
             for (auto dbIter = dbFoundIndices.cbegin(); dbIter != dbFoundIndices.cend(); ++dbIter) {
-                const std::vector<unsigned int> &dbChainKeys = dbComplexIdToChainKeysMap.at(*dbIter);
+                const ComplexLookup::ChainKeys dbChainKeys = dbComplexLookup.getChainKeys(*dbIter);
                 // for all query chains
                 for (size_t qChainIdx=0; qChainIdx<qChainKeys.size(); qChainIdx++) {
                     // and target chains
                     for (size_t dbChainIdx = 0; dbChainIdx < dbChainKeys.size(); dbChainIdx++) {
                         // get all possible alignments
                         unsigned int currentDbKey = dbChainKeys[dbChainIdx];
-                        if (tDbr.sequenceReader->getId(currentDbKey) == UINT_MAX) {
+                        if (tDbr.getId(currentDbKey) == UINT_MAX) {
                             continue;
                         }
                         chainKeyPairs.emplace_back(qChainKeys[qChainIdx], currentDbKey);
@@ -130,24 +89,70 @@ int expandmultimer(int argc, const char **argv, const Command &command) {
             // and write.
             for (size_t chainKeyPairIdx=0; chainKeyPairIdx<chainKeyPairs.size(); chainKeyPairIdx++) {
                 if (chainKeyPairs[chainKeyPairIdx].first != qPrevChainKey) {
-                    resultWriter.writeData(result.c_str(),result.length(),qPrevChainKey,thread_idx);
+                    writer(result.c_str(),result.length(),qPrevChainKey,thread_idx);
                     result.clear();
                     qPrevChainKey = chainKeyPairs[chainKeyPairIdx].first;
                 }
                 result.append(SSTR(chainKeyPairs[chainKeyPairIdx].second));
                 result.push_back('\n');
             }
-            resultWriter.writeData(result.c_str(),result.length(),qPrevChainKey,thread_idx);
+            writer(result.c_str(),result.length(),qPrevChainKey,thread_idx);
             result.clear();
             dbFoundIndices.clear();
             chainKeyPairs.clear();
             progress.updateProgress();
         }
     }
+}
+
+int expandmultimer(int argc, const char **argv, const Command &command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
+
+    DBReader<unsigned int> alnDbr(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+    alnDbr.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+
+    int dbType = Parameters::DBTYPE_CLUSTER_RES;
+    uint16_t extended = DBReader<unsigned int>::getExtendedDbtype(alnDbr.getDbtype());
+    bool needSrc = false;
+    if (extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC) {
+        needSrc = true;
+        dbType = DBReader<unsigned int>::setExtendedDbtype(dbType, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
+    }
+    DBWriter resultWriter(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed, dbType);
+    resultWriter.open();
+
+    const bool touch = par.preloadMode != Parameters::PRELOAD_MODE_MMAP;
+    IndexReader tDbr(
+        par.db2,
+        par.threads,
+        needSrc ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
+        touch ? IndexReader::PRELOAD_INDEX : 0,
+        DBReader<unsigned int>::USE_INDEX
+    );
+
+    IndexReader qDbr(
+        par.db1,
+        par.threads,
+        needSrc ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
+        touch ? IndexReader::PRELOAD_INDEX : 0,
+        DBReader<unsigned int>::USE_INDEX
+    );
+
+    std::vector<unsigned int> qComplexIndices;
+    std::vector<unsigned int> dbComplexIndices;
+    ComplexLookup qComplexLookup;
+    ComplexLookup dbComplexLookup;
+    qComplexLookup.read(qDbr, par.db1, qComplexIndices);
+    dbComplexLookup.read(tDbr, par.db2, dbComplexIndices);
+    dbComplexIndices.clear();
+
+    float minAssignedChainsRatio = par.minAssignedChainsThreshold > MAX_ASSIGNED_CHAIN_RATIO ? MAX_ASSIGNED_CHAIN_RATIO: par.minAssignedChainsThreshold;
+    expandMultimerResults(alnDbr, qComplexLookup, qComplexIndices, dbComplexLookup, *tDbr.sequenceReader,
+                          minAssignedChainsRatio, par.monomerIncludeMode, [&resultWriter](const char *data, size_t length, unsigned int key, unsigned int thread) {
+        resultWriter.writeData(data, length, key, thread);
+    });
     qComplexIndices.clear();
-    dbChainKeyToComplexIdMap.clear();
-    qComplexIdToChainKeysMap.clear();
-    dbComplexIdToChainKeysMap.clear();
     alnDbr.close();
     resultWriter.close(false);
     return EXIT_SUCCESS;
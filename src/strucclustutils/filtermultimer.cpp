@@ -7,8 +7,8 @@
 #include "tmalign/basic_fun.h"
 #include "MultimerUtil.h"
 #include "LDDT.h"
+#include "spatialgrid.h"
 #include <map>
-#include <set>
 
 #ifdef OPENMP
 #include <omp.h>
@@ -18,13 +18,12 @@ struct Complex {
     int complexId;
     unsigned int nChain;
     unsigned int complexLength;
-    std::string complexName;
     std::vector<unsigned int> chainLengths;
     std::vector<unsigned int> chainKeys;
 
     // Coordinate16 Coords;
 
-    Complex() : complexId(0), nChain(0), complexLength(0), complexName("") {}
+    Complex() : complexId(0), nChain(0), complexLength(0) {}
     ~Complex() {
         chainKeys.clear();
     }
@@ -47,6 +46,86 @@ struct AlignedCoordinate {
     }
 };
 
+// Inter-chain residue contacts of a query complex. They only depend on the query coordinates,
+// so they are looked up once per chain pair with a cell list and reused for every target complex.
+class QueryInterface {
+public:
+    typedef std::vector<std::pair<unsigned int, unsigned int>> Contacts;
+
+    explicit QueryInterface(float threshold = 8) : threshold(threshold) {}
+
+    void clear() {
+        chainKeys.clear();
+        chainCa.clear();
+        grids.clear();
+        contacts.clear();
+    }
+
+    // ca holds the x, y and z coordinates of the chain one after another
+    void addChain(unsigned int chainKey, const float *ca, unsigned int chainLen) {
+        chainKeys.push_back(chainKey);
+        chainCa.push_back(std::vector<float>(ca, ca + 3 * chainLen));
+        grids.push_back(SpatialGrid(std::max(threshold, 1.0f)));
+    }
+
+    size_t getChainIdx(unsigned int chainKey) const {
+        return std::find(chainKeys.begin(), chainKeys.end(), chainKey) - chainKeys.begin();
+    }
+
+    unsigned int getChainLen(size_t chainIdx) const {
+        return chainCa[chainIdx].size() / 3;
+    }
+
+    // residue pairs of chainIdx1 and chainIdx2 closer than the threshold
+    const Contacts &getContacts(size_t chainIdx1, size_t chainIdx2) {
+        const std::pair<size_t, size_t> key(chainIdx1, chainIdx2);
+        std::map<std::pair<size_t, size_t>, Contacts>::const_iterator it = contacts.find(key);
+        if (it != contacts.end()) {
+            return it->second;
+        }
+        Contacts &pairs = contacts[key];
+        const SpatialGrid &grid2 = getGrid(chainIdx2);
+        const float *ca1 = chainCa[chainIdx1].data();
+        const float *ca2 = chainCa[chainIdx2].data();
+        const unsigned int len1 = getChainLen(chainIdx1);
+        const unsigned int len2 = getChainLen(chainIdx2);
+        const float t2 = threshold * threshold;
+        const double radius = threshold * (1.0 + 1e-5) + 1e-5;
+        for (unsigned int resIdx1 = 0; resIdx1 < len1; resIdx1++) {
+            const float x1 = ca1[resIdx1];
+            const float y1 = ca1[len1 + resIdx1];
+            const float z1 = ca1[2 * len1 + resIdx1];
+            grid2.forEachCandidate(x1, y1, z1, radius, [&](unsigned int resIdx2) {
+                float dist = BasicFunction::dist(x1, y1, z1, ca2[resIdx2], ca2[len2 + resIdx2], ca2[2 * len2 + resIdx2]);
+                if (dist < t2) {
+                    pairs.emplace_back(resIdx1, resIdx2);
+                }
+            });
+        }
+        return pairs;
+    }
+
+private:
+    const SpatialGrid &getGrid(size_t chainIdx) {
+        SpatialGrid &grid = grids[chainIdx];
+        if (grid.empty()) {
+            const float *ca = chainCa[chainIdx].data();
+            const unsigned int len = getChainLen(chainIdx);
+            for (unsigned int resIdx = 0; resIdx < len; resIdx++) {
+                grid.add(ca[resIdx], ca[len + resIdx], ca[2 * len + resIdx], resIdx);
+            }
+            grid.build();
+        }
+        return grid;
+    }
+
+    float threshold;
+    std::vector<unsigned int> chainKeys;
+    std::vector<std::vector<float>> chainCa;
+    std::vector<SpatialGrid> grids;
+    std::map<std::pair<size_t, size_t>, Contacts> contacts;
+};
+
 unsigned int adjustAlnLen(unsigned int qcov, unsigned int tcov, int covMode) {
     switch (covMode) {
         case Parameters::COV_MODE_BIDIRECTIONAL:
@@ -81,6 +160,8 @@ public:
     std::vector<unsigned int> tAlnChainKeys;
     std::vector<AlignedCoordinate> qAlnChains;
     std::vector<AlignedCoordinate> tAlnChains;
+    // query residue index of each aligned position
+    std::vector<std::vector<unsigned int>> qAlnResIdx;
 
     std::vector<double> qAlnChainTms;
     std::vector<double> tAlnChainTms;
@@ -102,6 +183,7 @@ public:
         tAlnChainKeys.clear();
         qAlnChains.clear();
         tAlnChains.clear();
+        qAlnResIdx.clear();
     }
 
     bool hasTm(float TmThr, int covMode) {
@@ -208,6 +290,7 @@ public:
                             float *qdata, float *tdata, const std::string &cigar, int qStartPos, int tStartPos, int qLen, int tLen) {
         AlignedCoordinate qChain;
         AlignedCoordinate tChain;
+        std::vector<unsigned int> qResIdx(alnLen);
         int qi = qStartPos;
         int ti = tStartPos;
         int mi = 0;
@@ -228,6 +311,7 @@ public:
                 tChain.x[mi] = tdata[ti];
                 tChain.y[mi] = tdata[tLen + ti];
                 tChain.z[mi] = tdata[2*tLen + ti];
+                qResIdx[mi] = qi;
                 qi++;
                 ti++;
                 mi++;
@@ -243,6 +327,7 @@ public:
         tAlnChainKeys.push_back(tChainKey);
         qAlnChains.push_back(qChain);
         tAlnChains.push_back(tChain);
+        qAlnResIdx.push_back(qResIdx);
     }
     // void update(unsigned int qChainKey, unsigned int tChainKey, double qChainTm, double tChainTm) {
     //     this->qAlnChainTms.push_back(qChainTm);
@@ -257,32 +342,45 @@ public:
         tCov = static_cast<float>(tTotalAlnLen) / static_cast<float>(tLen);
     }
 
-    void computeInterfaceLddt(float threshold = 8) {
+    void computeInterfaceLddt(QueryInterface &queryInterface) {
         if (qAlnChains.size() == 1) {
             interfaceLddt = 1;
         }
-        float t2 = threshold * threshold;
-        std::vector<std::set<unsigned int>> qInterfacePos(qAlnChains.size()); // chainIdx, resIdx
+        const size_t alnCount = qAlnChains.size();
+        std::vector<size_t> chainIdx(alnCount);
+        std::vector<std::vector<int>> alnPos(alnCount); // resIdx -> aligned position or -1
+        std::vector<std::vector<unsigned char>> isInterface(alnCount);
+        std::vector<unsigned int> interfaceCount(alnCount, 0);
+        for (size_t alnIdx = 0; alnIdx < alnCount; alnIdx++) {
+            chainIdx[alnIdx] = queryInterface.getChainIdx(qAlnChainKeys[alnIdx]);
+            alnPos[alnIdx].assign(queryInterface.getChainLen(chainIdx[alnIdx]), -1);
+            for (size_t pos = 0; pos < qAlnResIdx[alnIdx].size(); pos++) {
+                alnPos[alnIdx][qAlnResIdx[alnIdx][pos]] = pos;
+            }
+            isInterface[alnIdx].assign(qAlnResIdx[alnIdx].size(), 0);
+        }
         unsigned int intLen = 0;
-        // Find and save interface Coordinates
-        for (size_t chainIdx1 = 0; chainIdx1 < qAlnChains.size(); chainIdx1++) {
-            for (size_t chainIdx2 = chainIdx1+1; chainIdx2 < qAlnChains.size(); chainIdx2++) {
-                AlignedCoordinate qChain1 = qAlnChains[chainIdx1];
-                AlignedCoordinate qChain2 = qAlnChains[chainIdx2];
-                for (size_t resIdx1 = 0; resIdx1 < qChain1.x.size(); resIdx1++) {
-                    for (size_t resIdx2 = 0; resIdx2 < qChain2.x.size(); resIdx2++) {
-                        float dist = BasicFunction::dist(qChain1.x[resIdx1], qChain1.y[resIdx1], qChain1.z[resIdx1],
-                                                         qChain2.x[resIdx2], qChain2.y[resIdx2], qChain2.z[resIdx2]);
-                        if (dist < t2) {
-                            if (qInterfacePos[chainIdx1].find(resIdx1) == qInterfacePos[chainIdx1].end()) {
-                                qInterfacePos[chainIdx1].insert(resIdx1);
-                                intLen++;
-                            }
-                            if (qInterfacePos[chainIdx2].find(resIdx2) == qInterfacePos[chainIdx2].end()) {
-                                qInterfacePos[chainIdx2].insert(resIdx2);
-                                intLen++;
-                            }
-                        }
+        // Find interface residues among the aligned residues
+        for (size_t alnIdx1 = 0; alnIdx1 < alnCount; alnIdx1++) {
+            for (size_t alnIdx2 = alnIdx1+1; alnIdx2 < alnCount; alnIdx2++) {
+                const bool swapped = chainIdx[alnIdx1] > chainIdx[alnIdx2];
+                const QueryInterface::Contacts &contacts = swapped ? queryInterface.getContacts(chainIdx[alnIdx2], chainIdx[alnIdx1])
+                                                                   : queryInterface.getContacts(chainIdx[alnIdx1], chainIdx[alnIdx2]);
+                for (size_t i = 0; i < contacts.size(); i++) {
+                    const int pos1 = alnPos[alnIdx1][swapped ? contacts[i].second : contacts[i].first];
+                    const int pos2 = alnPos[alnIdx2][swapped ? contacts[i].first : contacts[i].second];
+                    if (pos1 < 0 || pos2 < 0) {
+                        continue;
+                    }
+                    if (isInterface[alnIdx1][pos1] == 0) {
+                        isInterface[alnIdx1][pos1] = 1;
+                        interfaceCount[alnIdx1]++;
+                        intLen++;
+                    }
+                    if (isInterface[alnIdx2][pos2] == 0) {
+                        isInterface[alnIdx2][pos2] = 1;
+                        interfaceCount[alnIdx2]++;
+                        intLen++;
                     }
                 }
             }
@@ -294,15 +392,18 @@ public:
         AlignedCoordinate qInterface(intLen);
         AlignedCoordinate tInterface(intLen);
         size_t idx = 0;
-        for (size_t chainIdx = 0; chainIdx < qInterfacePos.size(); chainIdx++) {
-            if (qInterfacePos[chainIdx].size() >= 4) {
-                for (size_t resIdx: qInterfacePos[chainIdx]) {
-                    qInterface.x[idx] = qAlnChains[chainIdx].x[resIdx];
-                    qInterface.y[idx] = qAlnChains[chainIdx].y[resIdx];
-                    qInterface.z[idx] = qAlnChains[chainIdx].z[resIdx];
-                    tInterface.x[idx] = tAlnChains[chainIdx].x[resIdx];
-                    tInterface.y[idx] = tAlnChains[chainIdx].y[resIdx];
-                    tInterface.z[idx] = tAlnChains[chainIdx].z[resIdx];
+        for (size_t alnIdx = 0; alnIdx < alnCount; alnIdx++) {
+            if (interfaceCount[alnIdx] >= 4) {
+                for (size_t resIdx = 0; resIdx < isInterface[alnIdx].size(); resIdx++) {
+                    if (isInterface[alnIdx][resIdx] == 0) {
+                        continue;
+                    }
+                    qInterface.x[idx] = qAlnChains[alnIdx].x[resIdx];
+                    qInterface.y[idx] = qAlnChains[alnIdx].y[resIdx];
+                    qInterface.z[idx] = qAlnChains[alnIdx].z[resIdx];
+                    tInterface.x[idx] = tAlnChains[alnIdx].x[resIdx];
+                    tInterface.y[idx] = tAlnChains[alnIdx].y[resIdx];
+                    tInterface.z[idx] = tAlnChains[alnIdx].z[resIdx];
                     idx++;
                 }
             }
@@ -446,53 +547,25 @@ void getComplexResidueLength( IndexReader *Dbr, std::vector<Complex> &complexes)
     }
 }
 
-static void getlookupInfo(
+static void getComplexes(
         IndexReader* dbr,
-        const std::string &file,
-        std::map<unsigned int, unsigned int> &chainKeyToComplexIdLookup,
+        const std::string &db,
+        ComplexLookup &lookup,
         std::vector<Complex> &complexes,
-        std::map<unsigned int, unsigned int> &complexIdtoIdx
+        std::vector<unsigned int> &complexIdToIdx
 ) {
-    if (file.length() == 0) {
-        return;
-    }
-    MemoryMapped lookupDB(file, MemoryMapped::WholeFile, MemoryMapped::SequentialScan);
-    char *data = (char *) lookupDB.getData();
-    char *end = data + lookupDB.mappedSize();
-    const char *entry[255];
-
-    int nComplex = 0;
-    std::vector<bool> isVistedSet(lookupDB.mappedSize(), false);
-    while (data < end && *data != '\0') {
-        const size_t columns = Util::getWordsOfLine(data, entry, 255);
-        if (columns < 3) {
-            Debug(Debug::WARNING) << "Not enough columns in lookup file " << file << "\n";
-            continue;
-        }
-        auto chainKey = Util::fast_atoi<int>(entry[0]);
-        unsigned int chainDbId = dbr->sequenceReader->getId(chainKey);
-        if (chainDbId != NOT_AVAILABLE_CHAIN_KEY) {
-            auto complexId = Util::fast_atoi<int>(entry[2]);
-            chainKeyToComplexIdLookup.emplace(chainKey, complexId);
-            std::string chainName(entry[1], (entry[2] - entry[1]) - 1);
-            size_t lastUnderscoreIndex = chainName.find_last_of('_');
-            std::string complexName = chainName.substr(0, lastUnderscoreIndex);
-
-            if (isVistedSet[complexId] == 0) {
-                Complex complex;
-                complex.complexId = complexId;
-                complex.complexName = complexName;
-                complexIdtoIdx.emplace(complexId, nComplex);
-                complexes.emplace_back(complex);
-                nComplex++;
-                isVistedSet[complexId] = 1;
-            }
-            complexes[complexIdtoIdx.at(complexId)].chainKeys.emplace_back(chainKey);
-            complexes[complexIdtoIdx.at(complexId)].nChain++;
-        }
-        data = Util::skipLine(data);
+    std::vector<unsigned int> complexIds;
+    lookup.read(dbr, db, complexIds);
+    complexIdToIdx.assign(lookup.getComplexIdCount(), UINT_MAX);
+    complexes.resize(complexIds.size());
+    for (size_t complexIdx = 0; complexIdx < complexIds.size(); complexIdx++) {
+        const ComplexLookup::ChainKeys chainKeys = lookup.getChainKeys(complexIds[complexIdx]);
+        Complex &complex = complexes[complexIdx];
+        complex.complexId = complexIds[complexIdx];
+        complex.chainKeys.assign(chainKeys.begin(), chainKeys.end());
+        complex.nChain = chainKeys.size();
+        complexIdToIdx[complexIds[complexIdx]] = complexIdx;
     }
-    lookupDB.close();
 }
 
 int filtermultimer(int argc, const char **argv, const Command &command) {
@@ -534,23 +607,20 @@ localThreads = std::max(std::min((size_t)par.threads, alnDbr.getSize()), (size_t
     DBWriter resultWrite5((par.db4 + "_info").c_str(), (par.db4 + "_info.index").c_str(), par.threads, shouldCompress, db5Type);
     resultWrite5.open();
 
-    std::string qLookupFile = par.db1 + ".lookup";
-    std::string tLookupFile = par.db2 + ".lookup";
-    
     std::vector<Complex> qComplexes, tComplexes;
-    std::map<unsigned int, unsigned int> qComplexIdToIdx, tComplexIdToIdx;
-    chainKeyToComplexId_t qChainKeyToComplexIdMap, tChainKeyToComplexIdMap;
+    std::vector<unsigned int> qComplexIdToIdx, tComplexIdToIdx;
+    ComplexLookup qComplexLookup, tComplexLookup;
 
-    getlookupInfo(qDbr, qLookupFile, qChainKeyToComplexIdMap, qComplexes, qComplexIdToIdx);
+    getComplexes(qDbr, par.db1, qComplexLookup, qComplexes, qComplexIdToIdx);
     getComplexResidueLength(qDbr, qComplexes);
     Debug::Progress progress(qComplexes.size());
 
     if (sameDB) {
-        tChainKeyToComplexIdMap = qChainKeyToComplexIdMap;
+        tComplexLookup = qComplexLookup;
         tComplexes = qComplexes;
         tComplexIdToIdx = qComplexIdToIdx;
     } else {
-        getlookupInfo(tDbr, tLookupFile, tChainKeyToComplexIdMap, tComplexes, tComplexIdToIdx);
+        getComplexes(tDbr, par.db2, tComplexLookup, tComplexes, tComplexIdToIdx);
         getComplexResidueLength(tDbr, tComplexes);
     }
     // std::vector<unsigned int> qComplexOrder(qComplexes.size());
@@ -578,15 +648,16 @@ localThreads = std::max(std::min((size_t)par.threads, alnDbr.getSize()), (size_t
         std::vector<unsigned int> selectedAssIDs;
         Coordinate16 qcoords;
         Coordinate16 tcoords;
+        QueryInterface queryInterface;
         
         Matcher::result_t res;   
 #pragma omp for schedule(dynamic, 1) 
         for (size_t qComplexIdx = 0; qComplexIdx < qComplexes.size(); qComplexIdx++) {
         // for (size_t qComplexIdx : qComplexOrder) {
             progress.updateProgress();
-            Complex qComplex = qComplexes[qComplexIdx];
+            const Complex &qComplex = qComplexes[qComplexIdx];
             unsigned int qComplexId = qComplex.complexId;
-            std::vector<unsigned int> qChainKeys = qComplex.chainKeys;
+            const std::vector<unsigned int> &qChainKeys = qComplex.chainKeys;
             for (size_t qChainIdx = 0; qChainIdx < qChainKeys.size(); qChainIdx++ ) {
                 unsigned int qChainKey = qChainKeys[qChainIdx];
                 unsigned int qChainAlnId = alnDbr.getId(qChainKey);
@@ -600,6 +671,9 @@ localThreads = std::max(std::min((size_t)par.threads, alnDbr.getSize()), (size_t
                 size_t qCaLength = qStructDbr.getEntryLen(qChainDbId);
                 size_t qChainLen = qDbr->sequenceReader->getSeqLen(qChainDbId);
                 float* qdata = qcoords.read(qcadata, qChainLen, qCaLength);
+                if (par.filtInterfaceLddtThr > 0.0) {
+                    queryInterface.addChain(qChainKey, qdata, qChainLen);
+                }
                 
                 char *data = alnDbr.getData(qChainAlnId, thread_idx);
                 while (*data != '\0' ) {
@@ -614,12 +688,10 @@ localThreads = std::max(std::min((size_t)par.threads, alnDbr.getSize()), (size_t
                     unsigned int assId = retComplex.assId;
                     unsigned int tChainKey = res.dbKey;
                     unsigned int tChainDbId = tDbr->sequenceReader->getId(tChainKey);
-                    unsigned int tComplexId = tChainKeyToComplexIdMap.at(tChainKey);
-                    unsigned int tComplexIdx = tComplexIdToIdx.at(tComplexId);
-                    std::vector<unsigned int> tChainKeys = tComplexes[tComplexIdx].chainKeys;
+                    unsigned int tComplexId = tComplexLookup.getComplexId(tChainKey);
                     //if target is monomer, but user doesn't want, continue
                     unsigned int tChainAlnId = alnDbr.getId(tChainKey);
-                    if (tChainAlnId == NOT_AVAILABLE_CHAIN_KEY) {
+                    if (tComplexId == NOT_AVAILABLE_CHAIN_KEY || tChainAlnId == NOT_AVAILABLE_CHAIN_KEY) {
                         continue;
                     }
                     float u[3][3];
@@ -666,15 +738,14 @@ localThreads = std::max(std::min((size_t)par.threads, alnDbr.getSize()), (size_t
                 unsigned int tComplexId  = assId_res.second.targetComplexId;
                 // unsigned int tComplexId  = localComplexVector.at(assId).targetComplexId;
                 
-                unsigned int tComplexIdx = tComplexIdToIdx.at(tComplexId);
-                Complex  tComplex = tComplexes[tComplexIdx];
+                const Complex &tComplex = tComplexes[tComplexIdToIdx[tComplexId]];
 
                 ComplexFilterCriteria &cmplfiltcrit = assId_res.second;
                 // ComplexFilterCriteria &cmplfiltcrit = localComplexVector.at(assId);
                 cmplfiltcrit.calcCov(qComplex.complexLength, tComplex.complexLength);
 
                 if (par.filtInterfaceLddtThr > 0.0) {
-                    cmplfiltcrit.computeInterfaceLddt();
+                    cmplfiltcrit.computeInterfaceLddt(queryInterface);
                 }
 
                 // Check if the criteria are met
@@ -722,9 +793,6 @@ localThreads = std::max(std::min((size_t)par.threads, alnDbr.getSize()), (size_t
                 ComplexFilterCriteria &cmplfiltcrit = localComplexMap.at(assId);
                 // ComplexFilterCriteria &cmplfiltcrit = localComplexVector.at(assId);
                 unsigned int tComplexId = cmplfiltcrit.targetComplexId;
-                unsigned int tComplexIdx = tComplexIdToIdx.at(tComplexId);
-                Complex tComplex = tComplexes.at(tComplexIdx);
-                
                 char *outpos = Itoa::u32toa_sse2(tComplexId, buffer);
                 result.append(buffer, (outpos - buffer - 1));
                 result.push_back('\n');
@@ -764,6 +832,7 @@ localThreads = std::max(std::min((size_t)par.threads, alnDbr.getSize()), (size_t
             resultWrite5.writeEnd(qComplexId, thread_idx);
             result.clear();
             localComplexMap.clear();
+            queryInterface.clear();
             cmplIdToBestAssId.clear();
             selectedAssIDs.clear();        
             // localComplexVector.clear();
@@ -781,8 +850,6 @@ localThreads = std::max(std::min((size_t)par.threads, alnDbr.getSize()), (size_t
         delete tDbr;
         delete tStructDbr;
     }
-    qChainKeyToComplexIdMap.clear();
-    tChainKeyToComplexIdMap.clear();
     qComplexes.clear();
     tComplexes.clear();
     return EXIT_SUCCESS;
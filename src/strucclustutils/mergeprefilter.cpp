@@ -0,0 +1,97 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "QueryMatcher.h"
+
+#include <algorithm>
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+static bool compareHitsBySeqIdAndScore(const hit_t &first, const hit_t &second) {
+    if (first.seqId != second.seqId) {
+        return first.seqId < second.seqId;
+    }
+    return abs(first.prefScore) > abs(second.prefScore);
+}
+
+static bool hasSameSeqId(const hit_t &first, const hit_t &second) {
+    return first.seqId == second.seqId;
+}
+
+int mergeprefilter(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, Parameters::PARSE_VARIADIC, 0);
+
+    if (par.filenames.size() <= 2) {
+        Debug(Debug::ERROR) << "Need at least one prefilter database for merging\n";
+        EXIT(EXIT_FAILURE);
+    }
+
+    DBReader<unsigned int> qdbr(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX);
+    qdbr.open(DBReader<unsigned int>::NOSORT);
+
+    // skip par.db{1,2}
+    const size_t fileCount = par.filenames.size() - 2;
+    std::vector<DBReader<unsigned int>*> prefilters(fileCount);
+    for (size_t i = 0; i < fileCount; i++) {
+        std::string indexName = par.filenames[i + 2] + ".index";
+        prefilters[i] = new DBReader<unsigned int>(par.filenames[i + 2].c_str(), indexName.c_str(), par.threads, DBReader<unsigned int>::USE_DATA | DBReader<unsigned int>::USE_INDEX);
+        prefilters[i]->open(DBReader<unsigned int>::NOSORT);
+    }
+
+    DBWriter writer(par.db2.c_str(), par.db2Index.c_str(), par.threads, par.compressed, Parameters::DBTYPE_PREFILTER_RES);
+    writer.open();
+
+    Debug::Progress progress(qdbr.getSize());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::vector<hit_t> hits;
+        hits.reserve(par.maxResListLen * fileCount);
+        char buffer[100];
+        std::string result;
+
+#pragma omp for schedule(dynamic, 10)
+        for (size_t id = 0; id < qdbr.getSize(); id++) {
+            progress.updateProgress();
+            unsigned int key = qdbr.getDbKey(id);
+            for (size_t i = 0; i < fileCount; i++) {
+                size_t entryId = prefilters[i]->getId(key);
+                if (entryId == UINT_MAX) {
+                    continue;
+                }
+                QueryMatcher::parsePrefilterHits(prefilters[i]->getData(entryId, thread_idx), hits);
+            }
+
+            // a target found by several seed patterns keeps its best diagonal
+            std::sort(hits.begin(), hits.end(), compareHitsBySeqIdAndScore);
+            hits.erase(std::unique(hits.begin(), hits.end(), hasSameSeqId), hits.end());
+            std::sort(hits.begin(), hits.end(), hit_t::compareHitsByScoreAndId);
+            if (hits.size() > par.maxResListLen) {
+                hits.resize(par.maxResListLen);
+            }
+
+            for (size_t i = 0; i < hits.size(); i++) {
+                size_t len = QueryMatcher::prefilterHitToBuffer(buffer, hits[i]);
+                result.append(buffer, len);
+            }
+            writer.writeData(result.c_str(), result.length(), key, thread_idx);
+            result.clear();
+            hits.clear();
+        }
+    }
+    writer.close();
+    for (size_t i = 0; i < fileCount; i++) {
+        prefilters[i]->close();
+        delete prefilters[i];
+    }
+    qdbr.close();
+    return EXIT_SUCCESS;
+}
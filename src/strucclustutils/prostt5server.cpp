@@ -0,0 +1,104 @@
+#include "LocalParameters.h"
+#include "Debug.h"
+#include "Util.h"
+
+#ifdef HAVE_PROSTT5
+#include "ProstT5.h"
+#include "ProstT5SharedMemory.h"
+#endif
+
+#include <chrono>
+#include <cstring>
+#include <signal.h>
+#include <thread>
+
+static volatile sig_atomic_t keepRunningServer = 1;
+static void serverIntHandler(int) {
+    keepRunningServer = 0;
+}
+
+int prostt5server(int argc, const char **argv, const Command& command) {
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, 0);
+#ifdef HAVE_PROSTT5
+    std::string modelWeights = ProstT5Model::findWeights(par.db1);
+    if (modelWeights.empty()) {
+        Debug(Debug::ERROR) << "Could not find ProstT5 model weights. Download with `foldseek databases ProstT5 prostt5_out tmp`\n";
+        return EXIT_FAILURE;
+    }
+
+    LlamaInitGuard guard(par.verbosity > 3);
+    std::string device = "none";
+    int threads = par.threads;
+    if (par.gpu == 1) {
+        std::vector<std::string> devices = ProstT5::getDevices();
+        for (size_t i = 0; i < devices.size(); ++i) {
+            if (devices[i].find("CUDA") != std::string::npos || devices[i] == "Metal") {
+                device = devices[i];
+                threads = 1;
+                break;
+            }
+        }
+        if (device == "none") {
+            Debug(Debug::ERROR) << "No GPU devices found\n";
+            return EXIT_FAILURE;
+        }
+    }
+    ProstT5Model model(modelWeights, device);
+    ProstT5 context(model, threads);
+
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = serverIntHandler;
+
+    // Set up the handler for SIGINT and SIGTERM
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+
+    const unsigned int maxResidues = 1 << 20;
+    const unsigned int maxSeqs = 1 << 14;
+    std::string shmFile = ProstT5SharedMemory::getShmHash(modelWeights);
+    ProstT5SharedMemory* layout = ProstT5SharedMemory::alloc(shmFile, maxResidues, maxSeqs);
+    Debug(Debug::INFO) << shmFile << "\n";
+    std::vector<std::string> sequences;
+    while (keepRunningServer) {
+        if (layout->state.load(std::memory_order_acquire) == ProstT5SharedMemory::READY) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            unsigned int* lengths = layout->getLengthsPtr();
+            const char* aa = layout->getSequencesPtr();
+            sequences.clear();
+            for (unsigned int i = 0; i < layout->seqCount; ++i) {
+                sequences.emplace_back(aa, lengths[i]);
+                aa += lengths[i];
+            }
+            std::vector<std::string> predictions = context.predictBatch(sequences);
+
+            // predictions are placed at the offsets of their input sequences,
+            // the lengths are replaced by the number of predicted states
+            char* states = layout->getStatesPtr();
+            for (unsigned int i = 0; i < layout->seqCount; ++i) {
+                size_t length = std::min(predictions[i].length(), sequences[i].length());
+                memcpy(states, predictions[i].c_str(), length);
+                states += sequences[i].length();
+                lengths[i] = length;
+            }
+
+            std::atomic_thread_fence(std::memory_order_release);
+            layout->state.store(ProstT5SharedMemory::DONE, std::memory_order_release);
+        } else {
+            // inference takes far longer than a short nap, do not keep a core spinning
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    // server shutdown
+    layout->serverExit.store(true, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    ProstT5SharedMemory::dealloc(layout, shmFile);
+    return EXIT_SUCCESS;
+#else
+    Debug(Debug::ERROR) << "Foldseek was compiled without ProstT5 support\n";
+    return EXIT_FAILURE;
+#endif
+}
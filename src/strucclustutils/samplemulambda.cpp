@@ -17,6 +17,7 @@
 #include <float.h>
 #include <math.h>
 #include <algorithm>
+#include <functional>
 
 #ifdef OPENMP
 #include <omp.h>
@@ -719,8 +720,10 @@ int samplemulambda(int argc, const char **argv, const Command& command) {
 #ifdef OPENMP
         thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-        EvalueNeuralNet evaluer(tAADbr->sequenceReader->getAminoAcidDBSize(), &subMat3Di);
-        std::vector<Matcher::result_t> alignmentResult;
+        // raw scores of the shuffled samples of the current query
+        std::vector<float> scores;
+        scores.reserve(par.nsample);
+        std::vector<int> indices;
         StructureSmithWaterman structureSmithWaterman(par.maxSeqLen, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, NULL, NULL);
         StructureSmithWaterman reverseStructureSmithWaterman(par.maxSeqLen, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, NULL, NULL);
 
@@ -728,7 +731,6 @@ int samplemulambda(int argc, const char **argv, const Command& command) {
         Sequence qSeq3Di(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
         Sequence tSeqAA(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
         Sequence tSeq3Di(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
-        std::string backtrace;
         std::string resultBuffer;
         // write output file
         std::mt19937 rnd(0);
@@ -746,6 +748,7 @@ int samplemulambda(int argc, const char **argv, const Command& command) {
             qSeq3Di.reverse();
             qSeqAA.reverse();
             reverseStructureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+            structureSmithWaterman.initFusedProfile(reverseStructureSmithWaterman);
             for (int sample = 0; sample < par.nsample; sample++) {
                 // pick random number between 0 and size of database
                 size_t sampleIdx = static_cast<size_t>(t3DiDbr->sequenceReader->getSize() * drand48());
@@ -758,7 +761,7 @@ int samplemulambda(int argc, const char **argv, const Command& command) {
                 tSeq3Di.mapSequence(targetId, dbKey, targetSeq3Di, targetLen);
                 tSeqAA.mapSequence(targetId, dbKey, targetSeqAA, targetLen);
                 // shuffle a vector of integers
-                std::vector<int> indices(targetLen);
+                indices.resize(targetLen);
                 for (int i = 0; i < targetLen; i++) {
                     indices[i] = i;
                 }
@@ -768,35 +771,18 @@ int samplemulambda(int argc, const char **argv, const Command& command) {
                     std::swap(tSeqAA.numSequence[i], tSeqAA.numSequence[indices[i]]);
                 }
 
-                StructureSmithWaterman::s_align align = structureSmithWaterman.alignScoreEndPos<StructureSmithWaterman::PROFILE>(tSeqAA.numSequence, tSeq3Di.numSequence, targetLen, par.gapOpen.values.aminoacid(),
-                                                                                                par.gapExtend.values.aminoacid(), querySeqLen / 2);
-                StructureSmithWaterman::s_align revAlign = reverseStructureSmithWaterman.alignScoreEndPos<StructureSmithWaterman::PROFILE>(tSeqAA.numSequence, tSeq3Di.numSequence, targetLen, par.gapOpen.values.aminoacid(),
-                                                                                                          par.gapExtend.values.aminoacid(), querySeqLen / 2);
-                int32_t score = static_cast<int32_t>(align.score1) - static_cast<int32_t>(revAlign.score1);
-                align.evalue = 0.0;
-                //align.evalue = evaluer.computeEvalue(score, muLambda.first, muLambda.second);
-
-                //align = structureSmithWaterman.alignStartPosBacktrace<StructureSmithWaterman::PROFILE>(tSeqAA.numSequence, tSeq3Di.numSequence, targetLen, par.gapOpen.values.aminoacid(),
-                //                                                      par.gapExtend.values.aminoacid(), par.alignmentMode, backtrace,  align, par.covMode, par.covThr, querySeqLen / 2);
-
-                unsigned int alnLength = Matcher::computeAlnLength(align.qStartPos1, align.qEndPos1, align.dbStartPos1, align.dbEndPos1);
-                float seqId = Util::computeSeqId(par.seqIdMode, align.identicalAACnt, querySeqLen, targetLen, alnLength);
-                align.score1 = score;
-                Matcher::result_t res(dbKey, align.score1, align.qCov, align.tCov, seqId, align.evalue, alnLength, align.qStartPos1, align.qEndPos1, querySeqLen, align.dbStartPos1, align.dbEndPos1, targetLen, backtrace);
-                alignmentResult.emplace_back(res);
-
-            }
-            if (alignmentResult.size() > 1) {
-                SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), Matcher::compareHits);
-            }
-            float * scores = new float[alignmentResult.size()];
-            for(size_t i = 0; i < alignmentResult.size(); i++) {
-                scores[i] = alignmentResult[i].score;
+                uint32_t revScore = 0;
+                StructureSmithWaterman::s_align align = structureSmithWaterman.alignScoreEndPosFused<StructureSmithWaterman::PROFILE>(reverseStructureSmithWaterman,
+                                                                                                tSeqAA.numSequence, tSeq3Di.numSequence, targetLen, par.gapOpen.values.aminoacid(),
+                                                                                                par.gapExtend.values.aminoacid(), querySeqLen / 2, revScore, 0);
+                int32_t score = static_cast<int32_t>(align.score1) - static_cast<int32_t>(revScore);
+                scores.push_back(static_cast<float>(score));
             }
+            // only the scores are fitted, they are summed in decreasing order
+            std::sort(scores.begin(), scores.end(), std::greater<float>());
             float mu = 0.0;
 	    float lambda = 0.0;
-            EVDMaxLikelyFit(scores, NULL, alignmentResult.size(), &mu, &lambda);
-            delete [] scores;
+            EVDMaxLikelyFit(scores.data(), NULL, scores.size(), &mu, &lambda);
             resultBuffer.append(querySeqAA, querySeqLen);
 	        resultBuffer.push_back('\t');
             resultBuffer.append(querySeq3Di, querySeqLen);
@@ -807,7 +793,7 @@ int samplemulambda(int argc, const char **argv, const Command& command) {
             resultBuffer.push_back('\n');
             dbw.writeData(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
             resultBuffer.clear();
-            alignmentResult.clear();
+            scores.clear();
         }
     }
 
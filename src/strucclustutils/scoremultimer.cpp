@@ -6,7 +6,9 @@
 #include "StructureUtil.h"
 #include "Coordinate16.h"
 #include "MultimerUtil.h"
+#include "StructureAlignStages.h"
 #include "set"
+#include "map"
 #include "unordered_set"
 #ifdef OPENMP
 #include <omp.h>
@@ -15,16 +17,16 @@
 // carrying chainToChainAlignments from the same query and target complex
 struct SearchResult {
     SearchResult() {}
-    SearchResult(std::vector<unsigned int> &chainKeys) : qChainKeys(chainKeys), alnVec({}) {}
-    SearchResult(std::vector<unsigned int> &chainKeys, unsigned int qResidueLen) : qChainKeys(chainKeys), qResidueLen(qResidueLen), alnVec({}) {}
+    SearchResult(const ComplexLookup::ChainKeys &chainKeys) : qChainKeys(chainKeys.begin(), chainKeys.end()), alnVec({}) {}
+    SearchResult(const ComplexLookup::ChainKeys &chainKeys, unsigned int qResidueLen) : qChainKeys(chainKeys.begin(), chainKeys.end()), qResidueLen(qResidueLen), alnVec({}) {}
     std::vector<unsigned int> qChainKeys;
     std::vector<unsigned int> dbChainKeys;
     unsigned int qResidueLen;
     unsigned int dbResidueLen;
     std::vector<ChainToChainAln> alnVec;
 
-    void resetDbComplex(std::vector<unsigned int> &chainKeys, unsigned int residueLen) {
-        dbChainKeys = chainKeys;
+    void resetDbComplex(const ComplexLookup::ChainKeys &chainKeys, unsigned int residueLen) {
+        dbChainKeys.assign(chainKeys.begin(), chainKeys.end());
         dbResidueLen = residueLen;
     }
 
@@ -69,12 +71,6 @@ struct Assignment {
     unsigned int qResidueLength;
     unsigned int dbResidueLength;
     unsigned int matches;
-    std::vector<float> qCaXVec;
-    std::vector<float> qCaYVec;
-    std::vector<float> qCaZVec;
-    std::vector<float> dbCaXVec;
-    std::vector<float> dbCaYVec;
-    std::vector<float> dbCaZVec;
     double qTmScore;
     double dbTmScore;
     std::string tString;
@@ -86,41 +82,59 @@ struct Assignment {
 
     void appendChainToChainAln(ChainToChainAln &aln) {
         matches += aln.matches;
-        qCaXVec.insert(qCaXVec.end(), aln.qChain.caVecX.begin(), aln.qChain.caVecX.end());
-        qCaYVec.insert(qCaYVec.end(), aln.qChain.caVecY.begin(), aln.qChain.caVecY.end());
-        qCaZVec.insert(qCaZVec.end(), aln.qChain.caVecZ.begin(), aln.qChain.caVecZ.end());
-        dbCaXVec.insert(dbCaXVec.end(), aln.dbChain.caVecX.begin(), aln.dbChain.caVecX.end());
-        dbCaYVec.insert(dbCaYVec.end(), aln.dbChain.caVecY.begin(), aln.dbChain.caVecY.end());
-        dbCaZVec.insert(dbCaZVec.end(), aln.dbChain.caVecZ.begin(), aln.dbChain.caVecZ.end());
         resultToWriteLines.emplace_back(aln.qChain.chainKey, aln.resultToWrite);
     }
 
+    // takes the scores of an assignment this one is a copy of, moved by the superposition u, t
+    void copyTmScore(const Assignment &scored, float u[3][3], float t[3]) {
+        tmResult = TMaligner::TMscoreResult(u, t, scored.tmResult.tmscore, scored.tmResult.rmsd);
+        qTmScore = scored.qTmScore;
+        dbTmScore = scored.dbTmScore;
+    }
+
     void reset() {
         matches = 0;
-        qCaXVec.clear();
-        qCaYVec.clear();
-        qCaZVec.clear();
-        dbCaXVec.clear();
-        dbCaYVec.clear();
-        dbCaZVec.clear();
         resultToWriteLines.clear();
         uString.clear();
         tString.clear();
     }
 
-    void getTmScore(TMaligner &tmAligner) {
-        backtrace = std::string(matches, 'M');
+    // superposes the aligned C-alpha pairs of the assigned chain alignments as one gapless alignment.
+    // The pairs are gathered from the arena, the target side directly into the TMaligner buffers
+    void getTmScore(TMaligner &tmAligner, const AlignedCaArena &arena, const std::vector<ChainToChainAln> &alnVec,
+                    const cluster_t &cluster, std::vector<float> &queryCa) {
         unsigned int normLen = std::min(qResidueLength, dbResidueLength);
-        tmAligner.initQuery(&qCaXVec[0], &qCaYVec[0], &qCaZVec[0], NULL, matches);
-        tmResult = tmAligner.computeTMscore(&dbCaXVec[0], &dbCaYVec[0], &dbCaZVec[0],matches,0,0, backtrace,normLen);
+        queryCa.resize(matches * 3);
+        float *qX = queryCa.data();
+        float *qY = qX + matches;
+        float *qZ = qY + matches;
+        float *dbX = tmAligner.getTargetX();
+        float *dbY = tmAligner.getTargetY();
+        float *dbZ = tmAligner.getTargetZ();
+        size_t pos = 0;
+        for (auto alnIdx: cluster) {
+            const ChainToChainAln &aln = alnVec[alnIdx];
+            const size_t begin = aln.caOffset;
+            const size_t end = aln.caOffset + aln.matches;
+            std::copy(arena.qX.begin() + begin, arena.qX.begin() + end, qX + pos);
+            std::copy(arena.qY.begin() + begin, arena.qY.begin() + end, qY + pos);
+            std::copy(arena.qZ.begin() + begin, arena.qZ.begin() + end, qZ + pos);
+            std::copy(arena.dbX.begin() + begin, arena.dbX.begin() + end, dbX + pos);
+            std::copy(arena.dbY.begin() + begin, arena.dbY.begin() + end, dbY + pos);
+            std::copy(arena.dbZ.begin() + begin, arena.dbZ.begin() + end, dbZ + pos);
+            pos += aln.matches;
+        }
+        if (matches == 0) {
+            tmResult = TMaligner::TMscoreResult();
+        } else {
+            // run-length compressed, the gapless alignment is a single run of matches
+            backtrace = SSTR(matches);
+            backtrace.push_back('M');
+            tmAligner.initQuery(qX, qY, qZ, NULL, matches);
+            tmResult = tmAligner.computeTMscore(dbX, dbY, dbZ, matches, 0, 0, backtrace, normLen);
+        }
         qTmScore = tmResult.tmscore * normLen / qResidueLength;
         dbTmScore = tmResult.tmscore * normLen / dbResidueLength;
-        qCaXVec.clear();
-        qCaYVec.clear();
-        qCaZVec.clear();
-        dbCaXVec.clear();
-        dbCaYVec.clear();
-        dbCaZVec.clear();
         backtrace.clear();
     }
 
@@ -181,7 +195,7 @@ class DBSCANCluster {
 public:
     DBSCANCluster(SearchResult &searchResult, std::set<cluster_t> &finalClusters, float minCov) : searchResult(searchResult), finalClusters(finalClusters) {
         cLabel = 0;
-        minimumClusterSize = std::ceil((float) searchResult.qChainKeys.size() * minCov);
+        minimumClusterSize = minAssignedChains(searchResult.qChainKeys.size(), minCov);
         maximumClusterSize = std::min(searchResult.qChainKeys.size(), searchResult.dbChainKeys.size());
         maximumClusterNum = searchResult.alnVec.size() / maximumClusterSize;
         prevMaxClusterSize = 0;
@@ -219,11 +233,23 @@ private:
     unsigned int minimumClusterSize;
     std::vector<unsigned int> neighbors;
     std::vector<unsigned int> neighborsOfCurrNeighbor;
-    std::unordered_set<unsigned int> foundNeighbors;
     std::vector<NeighborsWithDist> neighborsWithDist;
     std::unordered_set<unsigned int> qFoundChainKeys;
     std::unordered_set<unsigned int> dbFoundChainKeys;
     std::vector<float> distMatrix;
+    // neighbors of each alignment at neighborEps, a cluster expansion queries the same alignment
+    // many times per eps step but its distance row is only scanned once
+    std::vector<std::vector<unsigned int>> neighborLists;
+    std::vector<float> neighborEps;
+    // visited flags are stamps, a new stamp clears them without touching the arrays
+    std::vector<unsigned int> foundStamps;
+    std::vector<unsigned int> qChainStamps;
+    std::vector<unsigned int> dbChainStamps;
+    unsigned int foundStamp;
+    unsigned int chainStamp;
+    // dense index of the query and target chain of each alignment
+    std::vector<unsigned int> qChainIdx;
+    std::vector<unsigned int> dbChainIdx;
     std::vector<cluster_t> currClusters;
     std::set<cluster_t> &finalClusters;
     std::map<unsigned int, float> qBestTmScore;
@@ -260,8 +286,10 @@ private:
                     continue;
 
                 centerAln.label = ++cLabel;
-                foundNeighbors.clear();
-                foundNeighbors.insert(neighbors.begin(), neighbors.end());
+                foundStamp++;
+                for (auto neighbor : neighbors) {
+                    foundStamps[neighbor] = foundStamp;
+                }
                 neighborIdx = 0;
                 while (neighborIdx < neighbors.size()) {
                     neighborAlnIdx = neighbors[neighborIdx++];
@@ -275,8 +303,10 @@ private:
                         continue;
 
                     for (auto neighbor : neighborsOfCurrNeighbor) {
-                        if (foundNeighbors.insert(neighbor).second)
+                        if (foundStamps[neighbor] != foundStamp) {
+                            foundStamps[neighbor] = foundStamp;
                             neighbors.emplace_back(neighbor);
+                        }
                     }
                 }
                 if (neighbors.size() > maximumClusterSize || checkChainRedundancy())
@@ -342,21 +372,45 @@ private:
             }
         }
         eps = minDist;
+
+        neighborLists.resize(size);
+        neighborEps.assign(size, -1.0f);
+        foundStamps.assign(size, 0);
+        foundStamp = 0;
+        qChainIdx.resize(size);
+        dbChainIdx.resize(size);
+        for (size_t i = 0; i < size; i++) {
+            const ChainToChainAln &aln = searchResult.alnVec[i];
+            qChainIdx[i] = std::find(searchResult.qChainKeys.begin(), searchResult.qChainKeys.end(), aln.qChain.chainKey) - searchResult.qChainKeys.begin();
+            dbChainIdx[i] = std::find(searchResult.dbChainKeys.begin(), searchResult.dbChainKeys.end(), aln.dbChain.chainKey) - searchResult.dbChainKeys.begin();
+        }
+        qChainStamps.assign(searchResult.qChainKeys.size() + 1, 0);
+        dbChainStamps.assign(searchResult.dbChainKeys.size() + 1, 0);
+        chainStamp = 0;
     }
 
+    // center first, then all alignments closer than eps in index order
     void getNeighbors(size_t centerIdx, std::vector<unsigned int> &neighborVec) {
+        std::vector<unsigned int> &neighborList = neighborLists[centerIdx];
+        if (neighborEps[centerIdx] != eps) {
+            neighborList.clear();
+            const size_t size = searchResult.alnVec.size();
+            // column above the diagonal of the triangular matrix, then the row of the center
+            size_t rowStart = 0;
+            for (size_t j = 0; j < centerIdx; j++) {
+                if (distMatrix[rowStart + centerIdx - j - 1] < eps)
+                    neighborList.emplace_back(j);
+                rowStart += size - j - 1;
+            }
+            for (size_t j = centerIdx + 1; j < size; j++) {
+                if (distMatrix[rowStart + (j - centerIdx - 1)] < eps)
+                    neighborList.emplace_back(j);
+            }
+            neighborEps[centerIdx] = eps;
+        }
         neighborVec.clear();
         neighborVec.emplace_back(centerIdx);
-        for (size_t neighborIdx = 0; neighborIdx < searchResult.alnVec.size(); neighborIdx++) {
-
-            if (neighborIdx == centerIdx)
-                continue;
-
-            if (distMatrix[getDistMatrixIndex(centerIdx, neighborIdx)] >= eps)
-                continue;
-
-            neighborVec.emplace_back(neighborIdx);
-        }
+        neighborVec.insert(neighborVec.end(), neighborList.begin(), neighborList.end());
     }
 
     void initializeAlnLabels() {
@@ -369,15 +423,15 @@ private:
     }
 
     bool checkChainRedundancy() {
-        qFoundChainKeys.clear();
-        dbFoundChainKeys.clear();
-
+        chainStamp++;
         for (auto neighborIdx : neighbors) {
-            if (!qFoundChainKeys.insert(searchResult.alnVec[neighborIdx].qChain.chainKey).second)
+            if (qChainStamps[qChainIdx[neighborIdx]] == chainStamp)
                 return true;
+            qChainStamps[qChainIdx[neighborIdx]] = chainStamp;
 
-            if (!dbFoundChainKeys.insert(searchResult.alnVec[neighborIdx].dbChain.chainKey).second)
+            if (dbChainStamps[dbChainIdx[neighborIdx]] == chainStamp)
                 return true;
+            dbChainStamps[dbChainIdx[neighborIdx]] = chainStamp;
         }
         return false;
     }
@@ -410,6 +464,8 @@ private:
         qFoundChainKeys.clear();
         dbFoundChainKeys.clear();
         distMatrix.clear();
+        neighborLists.clear();
+        neighborEps.clear();
         return !finalClusters.empty();
     }
 
@@ -453,8 +509,7 @@ private:
     }
 
     void getNearestNeighbors(unsigned int centerIdx) {
-        qFoundChainKeys.clear();
-        dbFoundChainKeys.clear();
+        chainStamp++;
         neighborsWithDist.clear();
         neighborsWithDist.emplace_back(centerIdx, 0.0);
         for (auto neighborIdx: neighbors) {
@@ -465,18 +520,23 @@ private:
         SORT_SERIAL(neighborsWithDist.begin(), neighborsWithDist.end(), compareNeighborWithDist);
         neighbors.clear();
         for (auto neighborWithDist : neighborsWithDist) {
-            if (!qFoundChainKeys.insert(searchResult.alnVec[neighborWithDist.neighbor].qChain.chainKey).second)
+            const unsigned int neighbor = neighborWithDist.neighbor;
+            if (qChainStamps[qChainIdx[neighbor]] == chainStamp)
                 break;
-            if (!dbFoundChainKeys.insert(searchResult.alnVec[neighborWithDist.neighbor].dbChain.chainKey).second)
+            qChainStamps[qChainIdx[neighbor]] = chainStamp;
+            if (dbChainStamps[dbChainIdx[neighbor]] == chainStamp)
                 break;
-            neighbors.emplace_back(neighborWithDist.neighbor);
+            dbChainStamps[dbChainIdx[neighbor]] = chainStamp;
+            neighbors.emplace_back(neighbor);
         }
     }
 };
 
 class ComplexScorer {
 public:
-    ComplexScorer(IndexReader *qDbr3Di, IndexReader *tDbr3Di, DBReader<unsigned int> &alnDbr, IndexReader *qCaDbr, IndexReader *tCaDbr, unsigned int thread_idx, float minAssignedChainsRatio, int monomerIncludeMode) : alnDbr(alnDbr), qCaDbr(qCaDbr), tCaDbr(tCaDbr), thread_idx(thread_idx), minAssignedChainsRatio(minAssignedChainsRatio), monomerIncludeMode(monomerIncludeMode)  {
+    ComplexScorer(IndexReader *qDbr3Di, IndexReader *tDbr3Di, IndexReader *qCaDbr, IndexReader *tCaDbr,
+                  const ComplexSymmetry *qSymmetry, const ComplexSymmetry *dbSymmetry,
+                  unsigned int thread_idx, float minAssignedChainsRatio, int monomerIncludeMode) : qCaDbr(qCaDbr), tCaDbr(tCaDbr), qSymmetry(qSymmetry), dbSymmetry(dbSymmetry), thread_idx(thread_idx), minAssignedChainsRatio(minAssignedChainsRatio), monomerIncludeMode(monomerIncludeMode)  {
         maxChainLen = std::max(qDbr3Di->sequenceReader->getMaxSeqLen()+1, tDbr3Di->sequenceReader->getMaxSeqLen()+1);
         q3diDbr = qDbr3Di;
         t3diDbr = tDbr3Di;
@@ -484,17 +544,20 @@ public:
         tmAligner = new TMaligner(maxResLen, false, true, false);
     }
 
-    void getSearchResults(unsigned int qComplexId, std::vector<unsigned int> &qChainKeys, chainKeyToComplexId_t &dbChainKeyToComplexIdLookup, complexIdToChainKeys_t &dbComplexIdToChainKeysLookup, std::vector<SearchResult> &searchResults) {
+    // qChainAlns holds the alignment result entry of each query chain or NULL
+    void getSearchResults(unsigned int qComplexId, const ComplexLookup::ChainKeys &qChainKeys, const std::vector<char *> &qChainAlns,
+                          const ComplexLookup &dbComplexLookup, std::vector<SearchResult> &searchResults) {
         hasBacktrace = false;
         unsigned int qResLen = getQueryResidueLength(qChainKeys);
         if (qResLen == 0) return;
         paredSearchResult = SearchResult(qChainKeys, qResLen);
+        alignedCa.clear();
+        copyTmScores.clear();
         // for each chain from the query Complex
-        for (auto qChainKey: qChainKeys) {
-            unsigned int qKey = alnDbr.getId(qChainKey);
-            if (qKey == NOT_AVAILABLE_CHAIN_KEY) continue;
-            char *data = alnDbr.getData(qKey, thread_idx);
-            if (*data == '\0') continue;
+        for (size_t qChainIdx = 0; qChainIdx < qChainKeys.size(); qChainIdx++) {
+            const unsigned int qChainKey = qChainKeys[qChainIdx];
+            char *data = qChainAlns[qChainIdx];
+            if (data == NULL || *data == '\0') continue;
             qAlnResult = Matcher::parseAlignmentRecord(data);
             size_t qDbId = qCaDbr->sequenceReader->getId(qChainKey);
             char *qCaData = qCaDbr->sequenceReader->getData(qDbId, thread_idx);
@@ -502,16 +565,18 @@ public:
             unsigned int &qLen = qAlnResult.qLen;
             float *queryCaData = qCoords.read(qCaData, qAlnResult.qLen, qCaLength);
             qChain = Chain(qComplexId, qChainKey);
+            const ComplexSymmetry::ChainCopy *qCopy = qSymmetry->getChainOrSelf(qChainKey, qSelf);
+            const bool qHasCopies = (qCopy != &qSelf);
             tmAligner->initQuery(queryCaData, &queryCaData[qLen], &queryCaData[qLen * 2], NULL, qLen);
             // for each alignment from the query chain
             while (*data != '\0') {
                 char dbKeyBuffer[255 + 1];
                 Util::parseKey(data, dbKeyBuffer);
                 const auto dbChainKey = (unsigned int) strtoul(dbKeyBuffer, NULL, 10);
-                const unsigned int dbComplexId = dbChainKeyToComplexIdLookup.at(dbChainKey);
+                const unsigned int dbComplexId = dbComplexLookup.getComplexId(dbChainKey);
                 dbAlnResult = Matcher::parseAlignmentRecord(data);
                 data = Util::skipLine(data);
-                if (dbAlnResult.backtrace.empty()) continue;
+                if (dbComplexId == NOT_AVAILABLE_CHAIN_KEY || dbAlnResult.backtrace.empty()) continue;
                 hasBacktrace = true;
                 size_t tCaId = tCaDbr->sequenceReader->getId(dbChainKey);
                 char *tCaData = tCaDbr->sequenceReader->getData(tCaId, thread_idx);
@@ -519,8 +584,13 @@ public:
                 unsigned int & dbLen = dbAlnResult.dbLen;
                 float *targetCaData = tCoords.read(tCaData, dbLen, tCaLength);
                 dbChain = Chain(dbComplexId, dbChainKey);
-                tmResult = tmAligner->computeTMscore(targetCaData,&targetCaData[dbLen],&targetCaData[dbLen * 2],dbLen,dbAlnResult.qStartPos,dbAlnResult.dbStartPos,Matcher::uncompressAlignment(dbAlnResult.backtrace),dbAlnResult.qLen);
-                currAln =  ChainToChainAln(qChain, dbChain, queryCaData, targetCaData, dbAlnResult, tmResult);
+                const ComplexSymmetry::ChainCopy *dbCopy = dbSymmetry->getChainOrSelf(dbChainKey, dbSelf);
+                if (qHasCopies || dbCopy != &dbSelf) {
+                    getCopyTmScore(*qCopy, *dbCopy, targetCaData);
+                } else {
+                    tmResult = tmAligner->computeTMscore(targetCaData,&targetCaData[dbLen],&targetCaData[dbLen * 2],dbLen,dbAlnResult.qStartPos,dbAlnResult.dbStartPos,dbAlnResult.backtrace,dbAlnResult.qLen);
+                }
+                currAln =  ChainToChainAln(qChain, dbChain, queryCaData, targetCaData, dbAlnResult, tmResult, alignedCa);
                 currAlns.emplace_back(currAln);
                 currAln.free();
             } // while end
@@ -534,7 +604,7 @@ public:
         }
         SORT_SERIAL(currAlns.begin(), currAlns.end(), compareChainToChainAlnByDbComplexId);
         unsigned int currDbComplexId = currAlns[0].dbChain.complexId;
-        std::vector<unsigned int> currDbChainKeys = dbComplexIdToChainKeysLookup.at(currDbComplexId);
+        ComplexLookup::ChainKeys currDbChainKeys = dbComplexLookup.getChainKeys(currDbComplexId);
         unsigned int currDbResLen = getDbResidueLength(currDbChainKeys);
         paredSearchResult.resetDbComplex(currDbChainKeys, currDbResLen);
         for (auto &aln: currAlns) {
@@ -548,7 +618,7 @@ public:
 
             paredSearchResult.alnVec.clear();
             currDbComplexId = aln.dbChain.complexId;
-            currDbChainKeys = dbComplexIdToChainKeysLookup.at(currDbComplexId);
+            currDbChainKeys = dbComplexLookup.getChainKeys(currDbComplexId);
             currDbResLen = getDbResidueLength(currDbChainKeys);
             paredSearchResult.resetDbComplex(currDbChainKeys, currDbResLen);
             paredSearchResult.alnVec.emplace_back(aln);
@@ -574,11 +644,25 @@ public:
             return;
         }
         assignment = Assignment(searchResult.qResidueLen, searchResult.dbResidueLen);
+        const bool hasCopies = qSymmetry->getChain(searchResult.qChainKeys[0]) != NULL
+                               || dbSymmetry->getChain(searchResult.dbChainKeys[0]) != NULL;
+        if (hasCopies) {
+            setAlnCopies(searchResult);
+        }
+        scoredClusters.clear();
         for (auto &cluster: finalClusters) {
             for (auto alnIdx: cluster) {
                 assignment.appendChainToChainAln(searchResult.alnVec[alnIdx]);
             }
-            assignment.getTmScore(*tmAligner);
+            float u[3][3];
+            float t[3];
+            size_t scoredIdx;
+            if (hasCopies && findScoredCopy(searchResult, cluster, assignments, u, t, scoredIdx)) {
+                assignment.copyTmScore(assignments[scoredIdx], u, t);
+            } else {
+                assignment.getTmScore(*tmAligner, alignedCa, searchResult.alnVec, cluster, queryCa);
+                scoredClusters.emplace_back(&cluster, assignments.size());
+            }
             assignment.updateResultToWriteLines();
             assignments.emplace_back(assignment);
             assignment.reset();
@@ -586,6 +670,41 @@ public:
         finalClusters.clear();
     }
 
+    // scores the query complex and writes one result entry for each of its chains
+    void scoreQueryComplex(unsigned int qComplexId, const ComplexLookup::ChainKeys &qChainKeys, const std::vector<char *> &qChainAlns,
+                           const ComplexLookup &dbComplexLookup, DBWriter &resultWriter) {
+        getSearchResults(qComplexId, qChainKeys, qChainAlns, dbComplexLookup, searchResults);
+        // for each db complex
+        for (size_t dbId = 0; dbId < searchResults.size(); dbId++) {
+            getAssignments(searchResults[dbId], assignments);
+        }
+        SORT_SERIAL(assignments.begin(), assignments.end(), compareAssignment);
+        // for each query chain key
+        for (size_t qChainKeyIdx = 0; qChainKeyIdx < qChainKeys.size(); qChainKeyIdx++) {
+            resultToWriteLines.emplace_back("");
+        }
+        // for each assignment
+        for (unsigned int assignmentId = 0; assignmentId < assignments.size(); assignmentId++){
+            Assignment &assignment = assignments[assignmentId];
+            // for each output line from this assignment
+            for (size_t resultToWriteIdx = 0; resultToWriteIdx < assignment.resultToWriteLines.size(); resultToWriteIdx++) {
+                unsigned int &qKey = assignment.resultToWriteLines[resultToWriteIdx].first;
+                resultToWrite_t &resultToWrite = assignment.resultToWriteLines[resultToWriteIdx].second;
+                snprintf(buffer, sizeof(buffer), "%s\t%d\n", resultToWrite.c_str(), assignmentId);
+                unsigned int currIdx = std::find(qChainKeys.begin(), qChainKeys.end(), qKey) - qChainKeys.begin();
+                resultToWriteLines[currIdx].append(buffer);
+            }
+        }
+        for (size_t qChainKeyIdx = 0; qChainKeyIdx < qChainKeys.size(); qChainKeyIdx++) {
+            resultToWrite_t &resultToWrite = resultToWriteLines[qChainKeyIdx];
+            const unsigned int qKey = qChainKeys[qChainKeyIdx];
+            resultWriter.writeData(resultToWrite.c_str(),resultToWrite.length(),qKey,thread_idx);
+        }
+        assignments.clear();
+        resultToWriteLines.clear();
+        searchResults.clear();
+    }
+
     void free() {
         delete tmAligner;
     }
@@ -596,11 +715,14 @@ private:
     Matcher::result_t qAlnResult;
     Matcher::result_t dbAlnResult;
     unsigned int maxChainLen;
-    DBReader<unsigned int> &alnDbr;
     IndexReader *qCaDbr;
     IndexReader *tCaDbr;
     IndexReader *q3diDbr;
     IndexReader *t3diDbr;
+    const ComplexSymmetry *qSymmetry;
+    const ComplexSymmetry *dbSymmetry;
+    ComplexSymmetry::ChainCopy qSelf;
+    ComplexSymmetry::ChainCopy dbSelf;
     Coordinate16 qCoords;
     Coordinate16 tCoords;
     unsigned int thread_idx;
@@ -610,13 +732,152 @@ private:
     Chain dbChain;
     ChainToChainAln currAln;
     std::vector<ChainToChainAln> currAlns;
+    // coordinates of the chain alignments of the current query complex, valid until the next getSearchResults
+    AlignedCaArena alignedCa;
+    std::vector<float> queryCa;
     Assignment assignment;
     SearchResult paredSearchResult;
     std::set<cluster_t> finalClusters;
     bool hasBacktrace;
     int monomerIncludeMode;
+    std::vector<SearchResult> searchResults;
+    std::vector<Assignment> assignments;
+    std::vector<resultToWrite_t> resultToWriteLines;
+    char buffer[4096];
+
+    // chain alignments between copies of the same query and target reference chains with the same
+    // alignment positions have the same TM-score, only their superpositions are moved by the symmetry
+    struct CopyAlnKey {
+        unsigned int qRefKey;
+        unsigned int dbRefKey;
+        int qStartPos;
+        int dbStartPos;
+        std::string backtrace;
+
+        bool operator<(const CopyAlnKey &other) const {
+            if (qRefKey != other.qRefKey) return qRefKey < other.qRefKey;
+            if (dbRefKey != other.dbRefKey) return dbRefKey < other.dbRefKey;
+            if (qStartPos != other.qStartPos) return qStartPos < other.qStartPos;
+            if (dbStartPos != other.dbStartPos) return dbStartPos < other.dbStartPos;
+            return backtrace < other.backtrace;
+        }
+    };
+    struct CopyTmScore {
+        ComplexSymmetry::ChainCopy qChain;
+        ComplexSymmetry::ChainCopy dbChain;
+        TMaligner::TMscoreResult tmResult;
+    };
+    // chain alignments of the current query complex that were scored, valid until the next getSearchResults
+    std::map<CopyAlnKey, CopyTmScore> copyTmScores;
+    CopyAlnKey copyAlnKey;
+    // query and target chain copy of each chain alignment of the current search result
+    std::vector<std::pair<ComplexSymmetry::ChainCopy, ComplexSymmetry::ChainCopy>> alnCopies;
+    // clusters of the current search result whose TM-score was computed and the index of their assignment
+    std::vector<std::pair<const cluster_t *, size_t>> scoredClusters;
+
+    // sets tmResult of the current chain alignment, moved from an alignment between copies of the same chains if there is one
+    void getCopyTmScore(const ComplexSymmetry::ChainCopy &qCopy, const ComplexSymmetry::ChainCopy &dbCopy, float *targetCaData) {
+        copyAlnKey.qRefKey = qCopy.refKey;
+        copyAlnKey.dbRefKey = dbCopy.refKey;
+        copyAlnKey.qStartPos = dbAlnResult.qStartPos;
+        copyAlnKey.dbStartPos = dbAlnResult.dbStartPos;
+        copyAlnKey.backtrace = dbAlnResult.backtrace;
+        std::map<CopyAlnKey, CopyTmScore>::const_iterator it = copyTmScores.find(copyAlnKey);
+        if (it != copyTmScores.end()) {
+            const CopyTmScore &scored = it->second;
+            ComplexSymmetry::transferSuperposition(scored.qChain, qCopy, scored.dbChain, dbCopy,
+                                                   scored.tmResult.u, scored.tmResult.t, tmResult.u, tmResult.t);
+            tmResult.tmscore = scored.tmResult.tmscore;
+            tmResult.rmsd = scored.tmResult.rmsd;
+            return;
+        }
+        const unsigned int dbLen = dbAlnResult.dbLen;
+        tmResult = tmAligner->computeTMscore(targetCaData, &targetCaData[dbLen], &targetCaData[dbLen * 2], dbLen, dbAlnResult.qStartPos, dbAlnResult.dbStartPos, dbAlnResult.backtrace, dbAlnResult.qLen);
+        CopyTmScore &scored = copyTmScores[copyAlnKey];
+        scored.qChain = qCopy;
+        scored.dbChain = dbCopy;
+        scored.tmResult = tmResult;
+    }
 
-    unsigned int getQueryResidueLength(std::vector<unsigned int> &qChainKeys) {
+    void setAlnCopies(const SearchResult &searchResult) {
+        alnCopies.resize(searchResult.alnVec.size());
+        ComplexSymmetry::ChainCopy self;
+        for (size_t i = 0; i < searchResult.alnVec.size(); i++) {
+            alnCopies[i].first = *qSymmetry->getChainOrSelf(searchResult.alnVec[i].qChain.chainKey, self);
+            alnCopies[i].second = *dbSymmetry->getChainOrSelf(searchResult.alnVec[i].dbChain.chainKey, self);
+        }
+    }
+
+    // alignment columns of a chain alignment record, starting at the query start position
+    static const char *getAlignmentColumns(const std::string &resultToWrite) {
+        const char *columns = resultToWrite.c_str();
+        for (int column = 0; column < 4 && *columns != '\0'; column++) {
+            columns = strchr(columns, '\t');
+            if (columns == NULL) {
+                return "";
+            }
+            columns++;
+        }
+        return columns;
+    }
+
+    bool isSameAlignment(const ChainToChainAln &first, const ChainToChainAln &second) {
+        return strcmp(getAlignmentColumns(first.resultToWrite), getAlignmentColumns(second.resultToWrite)) == 0;
+    }
+
+    // finds a scored cluster that the cluster is a copy of: one rigid motion of the query and one of the target complex
+    // move each chain alignment of the scored cluster onto a chain alignment of the cluster at the same positions.
+    // u, t is then the moved superposition of the scored cluster
+    bool findScoredCopy(const SearchResult &searchResult, const cluster_t &cluster, const std::vector<Assignment> &scoredAssignments,
+                        float u[3][3], float t[3], size_t &scoredIdx) {
+        const std::vector<ChainToChainAln> &alnVec = searchResult.alnVec;
+        double qRot[3][3];
+        double dbRot[3][3];
+        for (size_t i = 0; i < scoredClusters.size(); i++) {
+            const cluster_t &scored = *scoredClusters[i].first;
+            if (scored.size() != cluster.size()) {
+                continue;
+            }
+            const unsigned int first = *scored.begin();
+            const ComplexSymmetry::ChainCopy &qFirst = alnCopies[first].first;
+            const ComplexSymmetry::ChainCopy &dbFirst = alnCopies[first].second;
+            for (auto candidate: cluster) {
+                const ComplexSymmetry::ChainCopy &qCandidate = alnCopies[candidate].first;
+                const ComplexSymmetry::ChainCopy &dbCandidate = alnCopies[candidate].second;
+                if (qCandidate.refKey != qFirst.refKey || dbCandidate.refKey != dbFirst.refKey
+                    || isSameAlignment(alnVec[first], alnVec[candidate]) == false) {
+                    continue;
+                }
+                ComplexSymmetry::getMotion(qFirst, qCandidate, qRot);
+                ComplexSymmetry::getMotion(dbFirst, dbCandidate, dbRot);
+                bool isCopy = true;
+                for (auto alnIdx: scored) {
+                    bool isMoved = false;
+                    for (auto other: cluster) {
+                        if (isSameAlignment(alnVec[alnIdx], alnVec[other])
+                            && ComplexSymmetry::movesOnto(qRot, qFirst.center, qCandidate.center, alnCopies[alnIdx].first, alnCopies[other].first)
+                            && ComplexSymmetry::movesOnto(dbRot, dbFirst.center, dbCandidate.center, alnCopies[alnIdx].second, alnCopies[other].second)) {
+                            isMoved = true;
+                            break;
+                        }
+                    }
+                    if (isMoved == false) {
+                        isCopy = false;
+                        break;
+                    }
+                }
+                if (isCopy) {
+                    scoredIdx = scoredClusters[i].second;
+                    const TMaligner::TMscoreResult &scoredResult = scoredAssignments[scoredIdx].tmResult;
+                    ComplexSymmetry::transferSuperposition(qFirst, qCandidate, dbFirst, dbCandidate, scoredResult.u, scoredResult.t, u, t);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    unsigned int getQueryResidueLength(const ComplexLookup::ChainKeys &qChainKeys) {
         unsigned int qResidueLen = 0;
         size_t qDbId;
         for (auto qChainKey: qChainKeys) {
@@ -630,7 +891,7 @@ private:
         return qResidueLen;
     }
 
-    unsigned int getDbResidueLength(std::vector<unsigned int> &dbChainKeys) {
+    unsigned int getDbResidueLength(const ComplexLookup::ChainKeys &dbChainKeys) {
         unsigned int dbResidueLen = 0;
         size_t tDbId;
         for (auto dbChainKey: dbChainKeys) {
@@ -645,9 +906,20 @@ private:
     }
 };
 
-int scoremultimer(int argc, const char **argv, const Command &command) {
+// With alignChainPairs the alignmentDB holds the search result of the chains, it is expanded to all chain pairs
+// of the hit complexes and aligned in memory (expandmultimer and structurealign), otherwise it holds these alignments.
+static int scoreMultimerResults(int argc, const char **argv, const Command &command, bool alignChainPairs) {
     LocalParameters &par = LocalParameters::getLocalInstance();
+    if (alignChainPairs) {
+        // same defaults as structurealign
+        par.compBiasCorrectionScale = 0.5;
+        par.alignmentType = LocalParameters::ALIGNMENT_TYPE_3DI_AA;
+    }
     par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
+    if (alignChainPairs) {
+        // the chain assignment needs the backtraces
+        par.addBacktrace = true;
+    }
 
     DBReader<unsigned int> alnDbr(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
     alnDbr.open(DBReader<unsigned int>::LINEAR_ACCCESS);
@@ -712,75 +984,130 @@ int scoremultimer(int argc, const char **argv, const Command &command) {
 
     std::vector<unsigned int> qComplexIndices;
     std::vector<unsigned int> dbComplexIndices;
-    chainKeyToComplexId_t qChainKeyToComplexIdMap;
-    chainKeyToComplexId_t dbChainKeyToComplexIdMap;
-    complexIdToChainKeys_t dbComplexIdToChainKeysMap;
-    complexIdToChainKeys_t qComplexIdToChainKeysMap;
-    std::string qLookupFile = par.db1 + ".lookup";
-    std::string dbLookupFile = par.db2 + ".lookup";
-    getKeyToIdMapIdToKeysMapIdVec(alnDbr, q3DiDbr, qLookupFile, qChainKeyToComplexIdMap, qComplexIdToChainKeysMap, qComplexIndices);
-    getKeyToIdMapIdToKeysMapIdVec(alnDbr, t3DiDbr, dbLookupFile, dbChainKeyToComplexIdMap, dbComplexIdToChainKeysMap, dbComplexIndices);
-    qChainKeyToComplexIdMap.clear();
+    ComplexLookup qComplexLookup;
+    ComplexLookup dbComplexLookup;
+    qComplexLookup.read(q3DiDbr, par.db1, qComplexIndices);
+    dbComplexLookup.read(t3DiDbr, par.db2, dbComplexIndices);
     dbComplexIndices.clear();
-    Debug::Progress progress(qComplexIndices.size());
+    // chain copies of symmetric complexes share their TM-score computations
+    ComplexSymmetry qSymmetry;
+    ComplexSymmetry dbSymmetryStorage;
+    qSymmetry.read(par.db1);
+    const ComplexSymmetry *dbSymmetry = &qSymmetry;
+    if (sameDB == false) {
+        dbSymmetryStorage.read(par.db2);
+        dbSymmetry = &dbSymmetryStorage;
+    }
 
+    if (alignChainPairs == false) {
+        Debug::Progress progress(qComplexIndices.size());
 #pragma omp parallel
-    {
-        unsigned int thread_idx = 0;
-        char buffer[4096];
+        {
+            unsigned int thread_idx = 0;
 #ifdef OPENMP
-        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-        std::vector<SearchResult> searchResults;
-        std::vector<Assignment> assignments;
-        std::vector<resultToWrite_t> resultToWriteLines;
-        ComplexScorer complexScorer(q3DiDbr, &t3DiDbr, alnDbr, qCaDbr, &tCaDbr, thread_idx, minAssignedChainsRatio, monomerIncludeMode);
+            std::vector<char *> qChainAlns;
+            ComplexScorer complexScorer(q3DiDbr, &t3DiDbr, qCaDbr, &tCaDbr, &qSymmetry, dbSymmetry, thread_idx, minAssignedChainsRatio, monomerIncludeMode);
 #pragma omp for schedule(dynamic, 1)
-        // for each q complex
+            // for each q complex
+            for (size_t qCompIdx = 0; qCompIdx < qComplexIndices.size(); qCompIdx++) {
+                unsigned int qComplexId = qComplexIndices[qCompIdx];
+                const ComplexLookup::ChainKeys qChainKeys = qComplexLookup.getChainKeys(qComplexId);
+                if (monomerIncludeMode == SKIP_MONOMERS && qChainKeys.size() < MULTIPLE_CHAINED_COMPLEX)
+                    continue;
+                qChainAlns.clear();
+                for (size_t qChainIdx = 0; qChainIdx < qChainKeys.size(); qChainIdx++) {
+                    unsigned int qKey = alnDbr.getId(qChainKeys[qChainIdx]);
+                    qChainAlns.emplace_back((qKey == NOT_AVAILABLE_CHAIN_KEY) ? NULL : alnDbr.getData(qKey, thread_idx));
+                }
+                complexScorer.scoreQueryComplex(qComplexId, qChainKeys, qChainAlns, dbComplexLookup, resultWriter);
+                progress.updateProgress();
+            }
+            complexScorer.free();
+        }
+    } else {
+        // 1. all chain pairs of the hit complexes
+        Debug(Debug::INFO) << "Expand complex hits\n";
+        MemoryResultDB *expanded = new MemoryResultDB(par.threads);
+        expandMultimerResults(alnDbr, qComplexLookup, qComplexIndices, dbComplexLookup, *t3DiDbr.sequenceReader,
+                              minAssignedChainsRatio, monomerIncludeMode, expanded->writer());
+        int expandedType = Parameters::DBTYPE_CLUSTER_RES;
+        if (needSrc) {
+            expandedType = DBReader<unsigned int>::setExtendedDbtype(expandedType, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
+        }
+        DBReader<unsigned int> *expandedReader = expanded->getReader(expandedType, par.threads);
+
+        // a query complex is scored by the thread that receives the alignments of its last chain,
+        // so only the alignments of the complexes in flight are kept
+        std::vector<unsigned int> complexIdToIdx(qComplexLookup.getComplexIdCount(), UINT_MAX);
         for (size_t qCompIdx = 0; qCompIdx < qComplexIndices.size(); qCompIdx++) {
+            complexIdToIdx[qComplexIndices[qCompIdx]] = qCompIdx;
+        }
+        std::vector<unsigned int> expandedChains(qComplexIndices.size(), 0);
+        for (size_t id = 0; id < expandedReader->getSize(); id++) {
+            expandedChains[complexIdToIdx[qComplexLookup.getComplexId(expandedReader->getDbKey(id))]]++;
+        }
+        std::vector<unsigned int> pendingChains(expandedChains);
+        std::vector<std::string> chainAlns(expandedReader->getSize());
+        std::vector<ComplexScorer *> complexScorers(par.threads);
+        std::vector<std::vector<char *>> qChainAlns(par.threads);
+        for (size_t thread = 0; thread < complexScorers.size(); thread++) {
+            complexScorers[thread] = new ComplexScorer(q3DiDbr, &t3DiDbr, qCaDbr, &tCaDbr, &qSymmetry, dbSymmetry, thread, minAssignedChainsRatio, monomerIncludeMode);
+        }
+        auto scoreComplex = [&](size_t qCompIdx, unsigned int thread) {
             unsigned int qComplexId = qComplexIndices[qCompIdx];
-            std::vector<unsigned int> &qChainKeys = qComplexIdToChainKeysMap.at(qComplexId);
+            const ComplexLookup::ChainKeys qChainKeys = qComplexLookup.getChainKeys(qComplexId);
             if (monomerIncludeMode == SKIP_MONOMERS && qChainKeys.size() < MULTIPLE_CHAINED_COMPLEX)
-                continue;
-            complexScorer.getSearchResults(qComplexId, qChainKeys, dbChainKeyToComplexIdMap, dbComplexIdToChainKeysMap, searchResults);
-            // for each db complex
-            for (size_t dbId = 0; dbId < searchResults.size(); dbId++) {
-                complexScorer.getAssignments(searchResults[dbId], assignments);
+                return;
+            std::vector<char *> &alns = qChainAlns[thread];
+            alns.clear();
+            for (size_t qChainIdx = 0; qChainIdx < qChainKeys.size(); qChainIdx++) {
+                size_t id = expandedReader->getId(qChainKeys[qChainIdx]);
+                alns.emplace_back((id == UINT_MAX) ? NULL : &chainAlns[id][0]);
             }
-            SORT_SERIAL(assignments.begin(), assignments.end(), compareAssignment);
-            // for each query chain key
-            for (size_t qChainKeyIdx = 0; qChainKeyIdx < qChainKeys.size(); qChainKeyIdx++) {
-                resultToWriteLines.emplace_back("");
-            }
-            // for each assignment
-            for (unsigned int assignmentId = 0; assignmentId < assignments.size(); assignmentId++){
-                Assignment &assignment = assignments[assignmentId];
-                // for each output line from this assignment
-                for (size_t resultToWriteIdx = 0; resultToWriteIdx < assignment.resultToWriteLines.size(); resultToWriteIdx++) {
-                    unsigned int &qKey = assignment.resultToWriteLines[resultToWriteIdx].first;
-                    resultToWrite_t &resultToWrite = assignment.resultToWriteLines[resultToWriteIdx].second;
-                    snprintf(buffer, sizeof(buffer), "%s\t%d\n", resultToWrite.c_str(), assignmentId);
-                    unsigned int currIdx = find(qChainKeys.begin(), qChainKeys.end(), qKey) - qChainKeys.begin();
-                    resultToWriteLines[currIdx].append(buffer);
+            complexScorers[thread]->scoreQueryComplex(qComplexId, qChainKeys, alns, dbComplexLookup, resultWriter);
+            for (size_t qChainIdx = 0; qChainIdx < qChainKeys.size(); qChainIdx++) {
+                size_t id = expandedReader->getId(qChainKeys[qChainIdx]);
+                if (id != UINT_MAX) {
+                    std::string().swap(chainAlns[id]);
                 }
             }
-            for (size_t qChainKeyIdx = 0; qChainKeyIdx < qChainKeys.size(); qChainKeyIdx++) {
-                resultToWrite_t &resultToWrite = resultToWriteLines[qChainKeyIdx];
-                unsigned int & qKey = qChainKeys[qChainKeyIdx];
-                resultWriter.writeData(resultToWrite.c_str(),resultToWrite.length(),qKey,thread_idx);
+        };
+
+        // 2. align the chain pairs and score each query complex once all its chains are aligned
+        Debug(Debug::INFO) << "Align chain pairs\n";
+        alignStructureResults(par, *expandedReader, 0, expandedReader->getSize(), needSrc,
+                              [&](const char *data, size_t length, unsigned int key, unsigned int thread) {
+            const size_t id = expandedReader->getId(key);
+            chainAlns[id].assign(data, length);
+            const size_t qCompIdx = complexIdToIdx[qComplexLookup.getComplexId(key)];
+            if (__sync_sub_and_fetch(&pendingChains[qCompIdx], 1) == 0) {
+                scoreComplex(qCompIdx, thread);
+            }
+        });
+        // complexes without any expanded chain still get their empty entries
+#pragma omp parallel
+        {
+            unsigned int thread_idx = 0;
+#ifdef OPENMP
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+#pragma omp for schedule(dynamic, 1)
+            for (size_t qCompIdx = 0; qCompIdx < qComplexIndices.size(); qCompIdx++) {
+                if (expandedChains[qCompIdx] == 0) {
+                    scoreComplex(qCompIdx, thread_idx);
+                }
             }
-            assignments.clear();
-            resultToWriteLines.clear();
-            searchResults.clear();
-            progress.updateProgress();
         }
-        complexScorer.free();
+        for (size_t thread = 0; thread < complexScorers.size(); thread++) {
+            complexScorers[thread]->free();
+            delete complexScorers[thread];
+        }
+        delete expanded;
     }
 
     qComplexIndices.clear();
-    dbChainKeyToComplexIdMap.clear();
-    dbComplexIdToChainKeysMap.clear();
-    qComplexIdToChainKeysMap.clear();
     alnDbr.close();
     if (!sameDB) {
         delete q3DiDbr;
@@ -789,3 +1116,11 @@ int scoremultimer(int argc, const char **argv, const Command &command) {
     resultWriter.close(false);
     return EXIT_SUCCESS;
 }
+
+int scoremultimer(int argc, const char **argv, const Command &command) {
+    return scoreMultimerResults(argc, argv, command, false);
+}
+
+int alignmultimer(int argc, const char **argv, const Command &command) {
+    return scoreMultimerResults(argc, argv, command, true);
+}
@@ -8,25 +8,24 @@
 #include "FastSort.h"
 
 #include "structureto3di.h"
+#include "spatialgrid.h"
 #include "SubstitutionMatrix.h"
 #include "GemmiWrapper.h"
 #include "PulchraWrapper.h"
 #include "microtar.h"
 #include "PatternCompiler.h"
 #include "Coordinate16.h"
+#include "MultimerUtil.h"
 #include "itoa.h"
 #include "MathUtil.h"
 #include "PathHasher.h"
+#include "Timer.h"
 
 #ifdef HAVE_PROSTT5
 #include "ProstT5.h"
-#if !defined(__CYGWIN__) && !defined(__EMSCRIPTEN__) && !defined(__APPLE__)
-#include "ProstT5ForkRunner.h"
-#define FORK_RUNNER 1
-#else
-#define FORK_RUNNER 0
-#define prostt5Forking(...)
-#endif
+#include "ProstT5Cache.h"
+#include "ProstT5SharedMemory.h"
+#include <thread>
 #endif
 
 #include <iostream>
@@ -35,6 +34,10 @@
 
 #ifdef HAVE_GCS
 #include "google/cloud/storage/client.h"
+#include <chrono>
+#include <deque>
+#include <future>
+#include <thread>
 #endif
 
 #ifdef OPENMP
@@ -42,24 +45,77 @@
 #endif
 
 
+// Start of an independently decodable frame (seekable zstd) or block (BGZF) of a compressed archive
+struct ArchiveFrame {
+    size_t compressedOffset;
+    size_t decompressedOffset;
+};
+
+// A range of a tar archive that can be read on its own. Parts of one archive start at tar headers.
+struct TarPart {
+    std::string filename;
+    // frame to start decoding from
+    size_t compressedOffset;
+    size_t frameOffset;
+    // first tar header of the part, at or behind the start of the frame
+    size_t decompressedOffset;
+    // first decompressed byte after the part, SIZE_MAX reads to the end of the archive
+    size_t decompressedEnd;
+};
+
+// Fills the remainder of a read that crosses the end of a part with zeros, so that microtar
+// sees a null record there and the part ends like a complete archive
+static size_t partReadLength(size_t pos, size_t end, size_t size) {
+    if (end == SIZE_MAX) {
+        return size;
+    }
+    return (pos < end) ? std::min(size, end - pos) : 0;
+}
+
 #ifdef HAVE_ZLIB
 #include <zlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+struct gz_file_t {
+    gzFile file;
+    size_t pos;
+    size_t end;
+};
+
 static int structure_file_gzread(mtar_t *tar, void *data, size_t size) {
-    size_t res = gzread((gzFile)tar->stream, data, size);
-    return (res == size) ? MTAR_ESUCCESS : MTAR_EREADFAIL;
+    gz_file_t *s = static_cast<gz_file_t*>(tar->stream);
+    size_t length = partReadLength(s->pos, s->end, size);
+    if (length > 0) {
+        int res = gzread(s->file, data, length);
+        if (res < 0 || static_cast<size_t>(res) != length) {
+            return MTAR_EREADFAIL;
+        }
+    }
+    memset(static_cast<char*>(data) + length, 0, size - length);
+    s->pos += size;
+    return MTAR_ESUCCESS;
 }
 
 static int structure_file_gzseek(mtar_t *tar, long offset, int whence) {
-    int res = gzseek((gzFile)tar->stream, offset, whence);
+    gz_file_t *s = static_cast<gz_file_t*>(tar->stream);
+    int res = gzseek(s->file, offset, whence);
+    if (whence == SEEK_CUR) {
+        s->pos += offset;
+    }
     return (res != -1) ? MTAR_ESUCCESS : MTAR_ESEEKFAIL;
 }
 
 static int structure_file_gzclose(mtar_t *tar) {
-    gzclose((gzFile)tar->stream);
+    gz_file_t *s = static_cast<gz_file_t*>(tar->stream);
+    gzclose(s->file);
+    delete s;
+    tar->stream = NULL;
     return MTAR_ESUCCESS;
 }
 
-int structure_mtar_gzopen(mtar_t *tar, const char *filename) {
+// compressedOffset has to point to the start of a gzip member, e.g. a BGZF block
+int structure_mtar_gzopen(mtar_t *tar, const char *filename, size_t compressedOffset = 0) {
     // Init tar struct and functions
     memset(tar, 0, sizeof(*tar));
     tar->read = structure_file_gzread;
@@ -67,19 +123,110 @@ int structure_mtar_gzopen(mtar_t *tar, const char *filename) {
     tar->close = structure_file_gzclose;
     tar->isFinished = 0;
     // Open file
-    tar->stream = gzopen(filename, "rb");
-    if (!tar->stream) {
+    gzFile file;
+    if (compressedOffset == 0) {
+        file = gzopen(filename, "rb");
+    } else {
+        // gzdopen starts decoding at the current offset of the descriptor
+        int fd = open(filename, O_RDONLY);
+        if (fd == -1) {
+            return MTAR_EOPENFAIL;
+        }
+        if (lseek(fd, compressedOffset, SEEK_SET) == -1) {
+            close(fd);
+            return MTAR_EOPENFAIL;
+        }
+        file = gzdopen(fd, "rb");
+        if (file == NULL) {
+            close(fd);
+        }
+    }
+    if (file == NULL) {
         return MTAR_EOPENFAIL;
     }
 
 #if defined(ZLIB_VERNUM) && ZLIB_VERNUM >= 0x1240
-    if (gzbuffer((gzFile)tar->stream, 1 * 1024 * 1024) != 0) {
+    if (gzbuffer(file, 1 * 1024 * 1024) != 0) {
         Debug(Debug::WARNING) << "Could not set gzbuffer size, performance might be bad\n";
     }
 #endif
+    gz_file_t *s = new gz_file_t;
+    s->file = file;
+    s->pos = 0;
+    s->end = SIZE_MAX;
+    tar->stream = s;
 
     return MTAR_ESUCCESS;
 }
+
+static unsigned int readLittleEndian32(const unsigned char *data) {
+    return (unsigned int) data[0] | ((unsigned int) data[1] << 8) | ((unsigned int) data[2] << 16) | ((unsigned int) data[3] << 24);
+}
+
+// Lists the blocks of a BGZF archive, either from the bgzip .gzi index or by walking
+// the block headers. Returns false if the archive is not BGZF.
+static bool readBgzfBlocks(const std::string &filename, std::vector<ArchiveFrame> &frames, size_t &decompressedSize) {
+    frames.clear();
+    decompressedSize = 0;
+    FILE *gzi = fopen((filename + ".gzi").c_str(), "rb");
+    if (gzi != NULL) {
+        uint64_t entries = 0;
+        bool ok = fread(&entries, sizeof(uint64_t), 1, gzi) == 1;
+        ArchiveFrame first = { 0, 0 };
+        frames.push_back(first);
+        for (uint64_t i = 0; ok && i < entries; i++) {
+            uint64_t offsets[2];
+            ok = fread(offsets, sizeof(uint64_t), 2, gzi) == 2;
+            ArchiveFrame frame = { static_cast<size_t>(offsets[0]), static_cast<size_t>(offsets[1]) };
+            frames.push_back(frame);
+        }
+        fclose(gzi);
+        if (ok) {
+            // the index has no total, the last block start is close enough to split the archive
+            decompressedSize = frames.back().decompressedOffset;
+            return true;
+        }
+        Debug(Debug::WARNING) << "Cannot read BGZF index " << filename << ".gzi\n";
+        frames.clear();
+    }
+
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    size_t compressedOffset = 0;
+    unsigned char header[12];
+    unsigned char extra[256];
+    while (fseek(fp, compressedOffset, SEEK_SET) == 0 && fread(header, 1, sizeof(header), fp) == sizeof(header)) {
+        // gzip magic, deflate, FEXTRA
+        if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || (header[3] & 4) == 0) {
+            break;
+        }
+        size_t extraLen = header[10] | (header[11] << 8);
+        if (extraLen > sizeof(extra) || fread(extra, 1, extraLen, fp) != extraLen) {
+            break;
+        }
+        size_t blockSize = 0;
+        for (size_t i = 0; i + 4 <= extraLen; ) {
+            size_t fieldLen = extra[i + 2] | (extra[i + 3] << 8);
+            if (extra[i] == 'B' && extra[i + 1] == 'C' && fieldLen == 2 && i + 6 <= extraLen) {
+                blockSize = (extra[i + 4] | (extra[i + 5] << 8)) + 1;
+                break;
+            }
+            i += 4 + fieldLen;
+        }
+        unsigned char isize[4];
+        if (blockSize == 0 || fseek(fp, compressedOffset + blockSize - 4, SEEK_SET) != 0 || fread(isize, 1, 4, fp) != 4) {
+            break;
+        }
+        ArchiveFrame frame = { compressedOffset, decompressedSize };
+        frames.push_back(frame);
+        decompressedSize += readLittleEndian32(isize);
+        compressedOffset += blockSize;
+    }
+    fclose(fp);
+    return frames.size() > 1;
+}
 #endif
 
 #define ZSTD_STATIC_LINKING_ONLY
@@ -96,11 +243,14 @@ struct zstd_file_t {
     size_t outCap;
     size_t outPos;
     size_t outSize;
+    // decompressed position within the archive and end of the part
+    size_t pos;
+    size_t end;
+    // frame starts of a seekable archive, empty for a plain zstd stream
+    std::vector<ArchiveFrame> frames;
 };
 
-static int file_zstdread(mtar_t *tar, void *data, size_t size) {
-    zstd_file_t *s = static_cast<zstd_file_t*>(tar->stream);
-    char *dst = static_cast<char*>(data);
+static bool zstd_read_stream(zstd_file_t *s, char *dst, size_t size) {
     size_t need = size;
 
     while (need) {
@@ -127,7 +277,7 @@ static int file_zstdread(mtar_t *tar, void *data, size_t size) {
 
         const size_t ret = ZSTD_decompressStream(s->dctx, &out, &in);
         if (ZSTD_isError(ret)) {
-            return MTAR_EREADFAIL;
+            return false;
         }
 
         s->inPos  += in.pos;
@@ -138,22 +288,56 @@ static int file_zstdread(mtar_t *tar, void *data, size_t size) {
             break;
         }
     }
-    return (need == 0) ? MTAR_ESUCCESS : MTAR_EREADFAIL;
+    s->pos += size - need;
+    return need == 0;
+}
+
+static int file_zstdread(mtar_t *tar, void *data, size_t size) {
+    zstd_file_t *s = static_cast<zstd_file_t*>(tar->stream);
+    size_t length = partReadLength(s->pos, s->end, size);
+    if (length > 0 && zstd_read_stream(s, static_cast<char*>(data), length) == false) {
+        return MTAR_EREADFAIL;
+    }
+    memset(static_cast<char*>(data) + length, 0, size - length);
+    s->pos += size - length;
+    return MTAR_ESUCCESS;
+}
+
+// restarts decoding at the start of a frame
+static bool zstd_jump_to_frame(zstd_file_t *s, const ArchiveFrame &frame) {
+    if (fseek(s->fp, frame.compressedOffset, SEEK_SET) != 0 || ZSTD_isError(ZSTD_initDStream(s->dctx))) {
+        return false;
+    }
+    s->inSize = s->inPos = s->outSize = s->outPos = 0;
+    s->pos = frame.decompressedOffset;
+    return true;
 }
 
 static int file_zstdseek(mtar_t *tar, long offset, int whence) {
     if (whence != SEEK_CUR || offset < 0) {
         return MTAR_ESEEKFAIL;
     }
+    zstd_file_t *s = static_cast<zstd_file_t*>(tar->stream);
+    size_t target = s->pos + offset;
+    if (s->frames.empty() == false) {
+        // skip whole frames instead of decompressing them if the target lies in a later frame
+        std::vector<ArchiveFrame>::const_iterator it = std::upper_bound(
+            s->frames.begin(), s->frames.end(), target,
+            [](size_t value, const ArchiveFrame &frame) { return value < frame.decompressedOffset; }
+        );
+        const ArchiveFrame &frame = *(it - 1);
+        if (frame.decompressedOffset > s->pos + (s->outSize - s->outPos) && zstd_jump_to_frame(s, frame) == false) {
+            return MTAR_ESEEKFAIL;
+        }
+    }
 
     char tmp[8192];
-    long left = offset;
-    while (left) {
-        size_t chunk = (left > (long)sizeof(tmp)) ? sizeof(tmp) : (size_t)left;
+    while (s->pos < target) {
+        size_t left = target - s->pos;
+        size_t chunk = (left > sizeof(tmp)) ? sizeof(tmp) : left;
         if (file_zstdread(tar, tmp, chunk) != MTAR_ESUCCESS) {
             return MTAR_ESEEKFAIL;
         }
-        left -= (long)chunk;
     }
     return MTAR_ESUCCESS;
 }
@@ -171,6 +355,45 @@ static int file_zstdclose(mtar_t *tar) {
     return MTAR_ESUCCESS;
 }
 
+// Reads the seek table of the zstd seekable format from the end of the file.
+// Returns false if the archive has none.
+static bool readZstdSeekTable(FILE *fp, std::vector<ArchiveFrame> &frames, size_t &decompressedSize) {
+    const unsigned int SEEKABLE_MAGIC = 0x8F92EAB1;
+    const unsigned int SKIPPABLE_MAGIC = 0x184D2A5E;
+    const size_t FOOTER_SIZE = 9;
+    const size_t SKIPPABLE_HEADER_SIZE = 8;
+    frames.clear();
+    decompressedSize = 0;
+
+    unsigned char footer[FOOTER_SIZE];
+    if (fseek(fp, -(long) FOOTER_SIZE, SEEK_END) != 0 || fread(footer, 1, FOOTER_SIZE, fp) != FOOTER_SIZE
+        || readLittleEndian32(footer + 5) != SEEKABLE_MAGIC) {
+        return false;
+    }
+    size_t numFrames = readLittleEndian32(footer);
+    size_t entrySize = (footer[4] & 0x80) ? 12 : 8;
+    size_t tableSize = numFrames * entrySize;
+    std::vector<unsigned char> table(SKIPPABLE_HEADER_SIZE + tableSize);
+    if (fseek(fp, -(long) (SKIPPABLE_HEADER_SIZE + tableSize + FOOTER_SIZE), SEEK_END) != 0
+        || fread(table.data(), 1, table.size(), fp) != table.size()
+        || readLittleEndian32(table.data()) != SKIPPABLE_MAGIC
+        || readLittleEndian32(table.data() + 4) != tableSize + FOOTER_SIZE) {
+        return false;
+    }
+    size_t compressedOffset = 0;
+    for (size_t i = 0; i < numFrames; i++) {
+        const unsigned char *entry = table.data() + SKIPPABLE_HEADER_SIZE + i * entrySize;
+        ArchiveFrame frame = { compressedOffset, decompressedSize };
+        frames.push_back(frame);
+        compressedOffset += readLittleEndian32(entry);
+        decompressedSize += readLittleEndian32(entry + 4);
+    }
+    // end of the data frames, so that seeking to the end of the archive needs no decoding
+    ArchiveFrame last = { compressedOffset, decompressedSize };
+    frames.push_back(last);
+    return numFrames > 1;
+}
+
 int mtar_zstdopen(mtar_t *tar, const char *filename) {
     std::memset(tar, 0, sizeof(*tar));
     tar->read  = file_zstdread;
@@ -203,10 +426,389 @@ int mtar_zstdopen(mtar_t *tar, const char *filename) {
         return MTAR_EOPENFAIL;
     }
 
+    size_t decompressedSize;
+    if (readZstdSeekTable(s->fp, s->frames, decompressedSize) == false) {
+        s->frames.clear();
+    }
+    if (fseek(s->fp, 0, SEEK_SET) != 0) {
+        file_zstdclose(tar);
+        return MTAR_EOPENFAIL;
+    }
     s->inSize = s->inPos = s->outSize = s->outPos = 0;
+    s->pos = 0;
+    s->end = SIZE_MAX;
+    return MTAR_ESUCCESS;
+}
+
+struct plain_file_t {
+    FILE *fp;
+    size_t pos;
+    size_t end;
+};
+
+static int file_plainread(mtar_t *tar, void *data, size_t size) {
+    plain_file_t *s = static_cast<plain_file_t*>(tar->stream);
+    size_t length = partReadLength(s->pos, s->end, size);
+    if (length > 0 && fread(data, 1, length, s->fp) != length) {
+        return MTAR_EREADFAIL;
+    }
+    memset(static_cast<char*>(data) + length, 0, size - length);
+    s->pos += size;
+    return MTAR_ESUCCESS;
+}
+
+static int file_plainseek(mtar_t *tar, long offset, int whence) {
+    plain_file_t *s = static_cast<plain_file_t*>(tar->stream);
+    if (whence != SEEK_CUR || fseek(s->fp, offset, SEEK_CUR) != 0) {
+        return MTAR_ESEEKFAIL;
+    }
+    s->pos += offset;
+    return MTAR_ESUCCESS;
+}
+
+static int file_plainclose(mtar_t *tar) {
+    plain_file_t *s = static_cast<plain_file_t*>(tar->stream);
+    fclose(s->fp);
+    delete s;
+    tar->stream = NULL;
     return MTAR_ESUCCESS;
 }
 
+// Opens an uncompressed tar for reading a range only, whole archives go through mtar_open
+int mtar_plainopen(mtar_t *tar, const char *filename) {
+    memset(tar, 0, sizeof(*tar));
+    tar->read = file_plainread;
+    tar->seek = file_plainseek;
+    tar->close = file_plainclose;
+    tar->isFinished = 0;
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        return MTAR_EOPENFAIL;
+    }
+    plain_file_t *s = new plain_file_t;
+    s->fp = fp;
+    s->pos = 0;
+    s->end = SIZE_MAX;
+    tar->stream = s;
+    return MTAR_ESUCCESS;
+}
+
+static void openTarFile(mtar_t *tar, const TarPart &part) {
+    const std::string &filename = part.filename;
+    if (Util::endsWith(".tar.gz", filename) || Util::endsWith(".tgz", filename)) {
+#ifdef HAVE_ZLIB
+        if (structure_mtar_gzopen(tar, filename.c_str(), part.compressedOffset) != MTAR_ESUCCESS) {
+            Debug(Debug::ERROR) << "Cannot open file " << filename << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        gz_file_t *s = static_cast<gz_file_t*>(tar->stream);
+        s->pos = part.frameOffset;
+        s->end = part.decompressedEnd;
+#else
+        Debug(Debug::ERROR) << "Foldseek was not compiled with zlib support. Cannot read compressed input.\n";
+        EXIT(EXIT_FAILURE);
+#endif
+    } else if (Util::endsWith(".tar.zstd", filename) || Util::endsWith(".tar.zst", filename)) {
+        if (mtar_zstdopen(tar, filename.c_str()) != MTAR_ESUCCESS) {
+            Debug(Debug::ERROR) << "Cannot open file " << filename << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        zstd_file_t *s = static_cast<zstd_file_t*>(tar->stream);
+        if (part.compressedOffset != 0) {
+            ArchiveFrame frame = { part.compressedOffset, part.frameOffset };
+            if (zstd_jump_to_frame(s, frame) == false) {
+                Debug(Debug::ERROR) << "Cannot seek in file " << filename << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+        }
+        s->end = part.decompressedEnd;
+    } else if (part.decompressedOffset != 0 || part.decompressedEnd != SIZE_MAX) {
+        if (mtar_plainopen(tar, filename.c_str()) != MTAR_ESUCCESS) {
+            Debug(Debug::ERROR) << "Cannot open file " << filename << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        plain_file_t *s = static_cast<plain_file_t*>(tar->stream);
+        if (fseek(s->fp, part.compressedOffset, SEEK_SET) != 0) {
+            Debug(Debug::ERROR) << "Cannot seek in file " << filename << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+        s->pos = part.frameOffset;
+        s->end = part.decompressedEnd;
+    } else {
+        if (mtar_open(tar, filename.c_str(), "r") != MTAR_ESUCCESS) {
+            Debug(Debug::ERROR) << "Cannot open file " << filename << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+    if (part.decompressedOffset > part.frameOffset
+        && tar->seek(tar, part.decompressedOffset - part.frameOffset, SEEK_CUR) != MTAR_ESUCCESS) {
+        Debug(Debug::ERROR) << "Cannot seek in file " << filename << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+}
+
+// A split point is only accepted at a ustar header whose name fits into the header,
+// so that it cannot be the second record of a GNU long name entry
+static bool isTarHeader(const unsigned char *block) {
+    if (block[148] == '\0' || memcmp(block + 257, "ustar", 5) != 0 || memchr(block, '\0', 100) == NULL) {
+        return false;
+    }
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < 512; i++) {
+        checksum += (i >= 148 && i < 156) ? ' ' : block[i];
+    }
+    char stored[9];
+    memcpy(stored, block + 148, 8);
+    stored[8] = '\0';
+    return checksum == strtoul(stored, NULL, 8);
+}
+
+// Lists the independently decodable frames of a seekable zstd or BGZF archive
+static bool readArchiveFrames(const std::string &filename, std::vector<ArchiveFrame> &frames, size_t &decompressedSize) {
+    if (Util::endsWith(".tar.zstd", filename) || Util::endsWith(".tar.zst", filename)) {
+        FILE *fp = fopen(filename.c_str(), "rb");
+        if (fp == NULL) {
+            return false;
+        }
+        bool hasFrames = readZstdSeekTable(fp, frames, decompressedSize);
+        fclose(fp);
+        return hasFrames;
+    }
+#ifdef HAVE_ZLIB
+    if (Util::endsWith(".tar.gz", filename) || Util::endsWith(".tgz", filename)) {
+        return readBgzfBlocks(filename, frames, decompressedSize);
+    }
+#endif
+    return false;
+}
+
+// Splits a seekable zstd or BGZF tar archive into up to maxParts parts. Each part starts at the
+// first tar header behind a frame start, other archives are returned as a single part.
+// Data of a member that looks exactly like a ustar header (e.g. a nested tar) can be mistaken for one.
+static void splitTarArchive(const std::string &filename, size_t maxParts, std::vector<TarPart> &parts) {
+    TarPart whole = { filename, 0, 0, 0, SIZE_MAX };
+    std::vector<ArchiveFrame> frames;
+    size_t decompressedSize = 0;
+    if (maxParts <= 1 || readArchiveFrames(filename, frames, decompressedSize) == false) {
+        parts.push_back(whole);
+        return;
+    }
+
+    // give up on a split point if no header follows within this many decompressed bytes
+    const size_t maxScan = 4 * 1024 * 1024;
+    size_t start = parts.size();
+    parts.push_back(whole);
+    size_t frameIdx = 1;
+    for (size_t i = 1; i < maxParts; i++) {
+        size_t target = (decompressedSize / maxParts) * i;
+        while (frameIdx < frames.size()
+               && (frames[frameIdx].decompressedOffset < target || frames[frameIdx].decompressedOffset <= parts.back().decompressedOffset)) {
+            frameIdx++;
+        }
+        if (frameIdx >= frames.size() || frames[frameIdx].decompressedOffset >= decompressedSize) {
+            break;
+        }
+        const ArchiveFrame &frame = frames[frameIdx];
+        TarPart candidate = { filename, frame.compressedOffset, frame.decompressedOffset, frame.decompressedOffset, SIZE_MAX };
+        mtar_t tar;
+        openTarFile(&tar, candidate);
+        // tar headers are aligned to 512 bytes of the decompressed archive
+        size_t offset = MathUtil::ceilIntDivision(frame.decompressedOffset, (size_t) 512) * 512;
+        bool found = false;
+        if (offset == frame.decompressedOffset || tar.seek(&tar, offset - frame.decompressedOffset, SEEK_CUR) == MTAR_ESUCCESS) {
+            unsigned char block[512];
+            while (offset - frame.decompressedOffset < maxScan && offset < decompressedSize
+                   && tar.read(&tar, block, sizeof(block)) == MTAR_ESUCCESS) {
+                if (isTarHeader(block)) {
+                    found = true;
+                    break;
+                }
+                offset += 512;
+            }
+        }
+        mtar_close(&tar);
+        if (found) {
+            candidate.decompressedOffset = offset;
+            parts.back().decompressedEnd = candidate.decompressedOffset;
+            parts.push_back(candidate);
+        }
+        frameIdx++;
+    }
+    if (parts.size() - start > 1) {
+        Debug(Debug::INFO) << "Split " << filename << " into " << (parts.size() - start) << " parts\n";
+    }
+}
+
+// Regular member of a tar archive, from its (GNU long name) header to the end of its padded data
+struct TarMember {
+    size_t headerOffset;
+    size_t endOffset;
+    // frame to start decoding from to reach the header
+    ArchiveFrame frame;
+    std::string name;
+};
+
+// Sidecar member index of a tar archive, written with --tar-index next to the archive.
+// The first line holds size and modification time of the archive to detect stale indices,
+// then one line per member: header offset, end offset, frame compressed and decompressed offset, name.
+static std::string tarIndexName(const std::string &filename) {
+    return filename + ".tarindex";
+}
+
+static bool readTarIndex(const std::string &filename, std::vector<TarMember> &members) {
+    struct stat st;
+    FILE *fp = fopen(tarIndexName(filename).c_str(), "r");
+    if (fp == NULL || stat(filename.c_str(), &st) != 0) {
+        if (fp != NULL) {
+            fclose(fp);
+        }
+        return false;
+    }
+    char *line = NULL;
+    size_t lineCap = 0;
+    ssize_t lineLen;
+    unsigned long long archiveSize = 0;
+    long long archiveTime = 0;
+    bool valid = getline(&line, &lineCap, fp) > 0
+                 && sscanf(line, "%llu\t%lld", &archiveSize, &archiveTime) == 2
+                 && archiveSize == static_cast<unsigned long long>(st.st_size)
+                 && archiveTime == static_cast<long long>(st.st_mtime);
+    while (valid && (lineLen = getline(&line, &lineCap, fp)) > 0) {
+        if (line[lineLen - 1] == '\n') {
+            line[--lineLen] = '\0';
+        }
+        unsigned long long fields[4];
+        int nameStart = 0;
+        if (sscanf(line, "%llu\t%llu\t%llu\t%llu\t%n", &fields[0], &fields[1], &fields[2], &fields[3], &nameStart) != 4 || nameStart == 0) {
+            valid = false;
+            break;
+        }
+        TarMember member;
+        member.headerOffset = fields[0];
+        member.endOffset = fields[1];
+        member.frame.compressedOffset = fields[2];
+        member.frame.decompressedOffset = fields[3];
+        member.name.assign(line + nameStart, lineLen - nameStart);
+        members.push_back(member);
+    }
+    free(line);
+    fclose(fp);
+    if (valid == false) {
+        Debug(Debug::WARNING) << "Ignoring outdated or invalid tar index " << tarIndexName(filename) << "\n";
+        members.clear();
+    }
+    return valid;
+}
+
+static void writeTarIndex(const std::string &filename, std::vector<TarMember> &members) {
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0) {
+        return;
+    }
+    for (size_t i = 0; i < members.size(); i++) {
+        if (members[i].name.find('\n') != std::string::npos) {
+            Debug(Debug::WARNING) << "Cannot index " << filename << ", member names contain line breaks\n";
+            return;
+        }
+    }
+    // uncompressed archives can be entered at any member
+    bool isPlain = Util::endsWith(".tar", filename);
+    std::vector<ArchiveFrame> frames;
+    size_t decompressedSize;
+    if (isPlain || readArchiveFrames(filename, frames, decompressedSize) == false) {
+        frames.assign(1, ArchiveFrame{ 0, 0 });
+    }
+    std::string indexName = tarIndexName(filename);
+    FILE *fp = fopen(indexName.c_str(), "w");
+    if (fp == NULL) {
+        Debug(Debug::WARNING) << "Cannot write tar index " << indexName << "\n";
+        return;
+    }
+    fprintf(fp, "%llu\t%lld\n", static_cast<unsigned long long>(st.st_size), static_cast<long long>(st.st_mtime));
+    for (size_t i = 0; i < members.size(); i++) {
+        std::vector<ArchiveFrame>::const_iterator it = std::upper_bound(
+            frames.begin(), frames.end(), members[i].headerOffset,
+            [](size_t value, const ArchiveFrame &frame) { return value < frame.decompressedOffset; }
+        );
+        ArchiveFrame frame = *(it - 1);
+        if (isPlain) {
+            frame.compressedOffset = frame.decompressedOffset = members[i].headerOffset;
+        }
+        fprintf(fp, "%zu\t%zu\t%zu\t%zu\t%s\n", members[i].headerOffset, members[i].endOffset,
+                frame.compressedOffset, frame.decompressedOffset, members[i].name.c_str());
+    }
+    if (fclose(fp) != 0) {
+        Debug(Debug::WARNING) << "Cannot close tar index " << indexName << "\n";
+    }
+}
+
+// Turns the indexed members passing the name filters into parts. Members that follow each other or
+// share a frame are read as one part, the name filters skip the members in between.
+static void tarPartsFromIndex(const std::string &filename, const std::vector<TarMember> &members,
+                              PatternCompiler &include, PatternCompiler &exclude, std::vector<TarPart> &parts) {
+    size_t start = parts.size();
+    for (size_t i = 0; i < members.size(); i++) {
+        const TarMember &member = members[i];
+        if (include.isMatch(member.name.c_str()) == false || exclude.isMatch(member.name.c_str()) == true) {
+            continue;
+        }
+        if (parts.size() > start) {
+            TarPart &last = parts.back();
+            if (last.decompressedEnd == member.headerOffset || last.compressedOffset == member.frame.compressedOffset) {
+                last.decompressedEnd = member.endOffset;
+                continue;
+            }
+        }
+        TarPart part = { filename, member.frame.compressedOffset, member.frame.decompressedOffset, member.headerOffset, member.endOffset };
+        parts.push_back(part);
+    }
+}
+
+struct TarReader {
+    mtar_t tar;
+    // part read by this reader and decompressed position within its archive
+    size_t part;
+    size_t pos;
+    // no tar files left for this reader, only changed while holding the lock
+    bool exhausted;
+#ifdef OPENMP
+    omp_lock_t lock;
+#endif
+};
+
+// Returns a locked reader that still has input, preferring idle readers starting at the
+// thread's own one. Returns NULL once all tar files are read.
+static TarReader *acquireTarReader(std::vector<TarReader> &readers, size_t home) {
+#ifdef OPENMP
+    for (int blocking = 0; blocking < 2; blocking++) {
+        for (size_t k = 0; k < readers.size(); k++) {
+            TarReader &reader = readers[(home + k) % readers.size()];
+            if (blocking) {
+                omp_set_lock(&reader.lock);
+            } else if (omp_test_lock(&reader.lock) == 0) {
+                continue;
+            }
+            if (reader.exhausted == false) {
+                return &reader;
+            }
+            omp_unset_lock(&reader.lock);
+        }
+    }
+    return NULL;
+#else
+    (void) home;
+    return readers[0].exhausted ? NULL : &readers[0];
+#endif
+}
+
+static void releaseTarReader(TarReader *reader) {
+#ifdef OPENMP
+    omp_unset_lock(&reader->lock);
+#else
+    (void) reader;
+#endif
+}
+
 template <typename T, typename U>
 static inline bool compareByFirst(const std::pair<T, U>& a, const std::pair<T, U>& b) {
     return a.first < b.first;
@@ -267,38 +869,45 @@ void addMissingAtomsInStructure(GemmiWrapper &readStructure, PulchraWrapper &pul
     chainNames.clear();
 }
 
-void findInterfaceResidues(GemmiWrapper &readStructure, std::pair<size_t, size_t> res1, std::pair<size_t, size_t> res2,
-                           std::vector<size_t> & resIdx1, float distanceThreshold)
+// glycines have no c beta, their c alpha is used for contacts
+static inline void interfaceContactCoordinate(GemmiWrapper &readStructure, size_t resIdx, float &x, float &y, float &z) {
+    const Vec3 &atom = (readStructure.ami[resIdx] == 'G') ? readStructure.ca[resIdx] : readStructure.cb[resIdx];
+    x = atom.x;
+    y = atom.y;
+    z = atom.z;
+}
+
+static void buildInterfaceGrid(GemmiWrapper &readStructure, std::pair<size_t, size_t> res, SpatialGrid &grid) {
+    grid.clear();
+    for (size_t resIdx = res.first; resIdx < res.second; resIdx++) {
+        float x, y, z;
+        interfaceContactCoordinate(readStructure, resIdx, x, y, z);
+        grid.add(x, y, z, static_cast<unsigned int>(resIdx));
+    }
+    grid.build();
+}
+
+// Only residues of res2 close to a residue of res1 can change the result,
+// so instead of scanning all of res2 the candidates are taken from the cell list of res2
+// and visited in the same ascending order as the full scan.
+void findInterfaceResidues(GemmiWrapper &readStructure, std::pair<size_t, size_t> res1, const SpatialGrid &grid2,
+                           std::vector<size_t> & resIdx1, std::vector<unsigned int> & candidates, float distanceThreshold)
 {
-    std::vector<Vec3> coord1, coord2;
     size_t sameRes = 0;
     size_t chainLen = res1.second - res1.first;
     bool noSameRes = true;
     const float squareThreshold = distanceThreshold * distanceThreshold;
+    // residues closer than 0.1 count as the same residue
+    const double radius = std::max(static_cast<double>(std::fabs(distanceThreshold)), 0.1) * (1.0 + 1e-5) + 1e-5;
     for (size_t res1Idx = res1.first; res1Idx < res1.second; res1Idx++) {
         float x1, y1, z1;
-        if (readStructure.ami[res1Idx] == 'G') {
-            x1 = readStructure.ca[res1Idx].x;
-            y1 = readStructure.ca[res1Idx].y;
-            z1 = readStructure.ca[res1Idx].z;
-        }
-        else {
-            x1 = readStructure.cb[res1Idx].x;
-            y1 = readStructure.cb[res1Idx].y;
-            z1 = readStructure.cb[res1Idx].z;
-        }
-        for (size_t res2Idx = res2.first; res2Idx < res2.second; res2Idx++) {
+        interfaceContactCoordinate(readStructure, res1Idx, x1, y1, z1);
+        candidates.clear();
+        grid2.forEachCandidate(x1, y1, z1, radius, [&candidates](unsigned int id) { candidates.push_back(id); });
+        std::sort(candidates.begin(), candidates.end());
+        for (size_t i = 0; i < candidates.size(); i++) {
             float x2, y2, z2;
-            if (readStructure.ami[res2Idx] == 'G') {
-                x2 = readStructure.ca[res2Idx].x;
-                y2 = readStructure.ca[res2Idx].y;
-                z2 = readStructure.ca[res2Idx].z;
-            }
-            else {
-                x2 = readStructure.cb[res2Idx].x;
-                y2 = readStructure.cb[res2Idx].y;
-                z2 = readStructure.cb[res2Idx].z;
-            }
+            interfaceContactCoordinate(readStructure, candidates[i], x2, y2, z2);
             float distance = MathUtil::squareDist(x1, y1, z1, x2, y2, z2);
             if (distance < 0.01) {
                 noSameRes = false;
@@ -331,6 +940,14 @@ void compute3DiInterfaces(GemmiWrapper &readStructure, PulchraWrapper &pulchra,
     std::vector<std::pair<size_t, size_t>> interfaceChain;
     std::unordered_map<unsigned int, unsigned int> modelToInterfaceNum;
     addMissingAtomsInStructure(readStructure, pulchra);
+    const float contactCellSize = std::max(std::fabs(distanceThreshold), 1.0f);
+    std::vector<SpatialGrid> chainGrids(readStructure.chain.size(), SpatialGrid(contactCellSize));
+    for (size_t ch = 0; ch < readStructure.chain.size(); ch++) {
+        if (readStructure.chainNames[ch] != "SKIP") {
+            buildInterfaceGrid(readStructure, readStructure.chain[ch], chainGrids[ch]);
+        }
+    }
+    std::vector<unsigned int> candidates;
     for (size_t ch1 = 0; ch1 < readStructure.chain.size(); ch1++) {
         if (readStructure.chainNames[ch1] == "SKIP") {
             interfaceCa.push_back(Vec3(0,0,0));
@@ -349,8 +966,8 @@ void compute3DiInterfaces(GemmiWrapper &readStructure, PulchraWrapper &pulchra,
                 continue;
             }
             if (readStructure.modelIndices[ch1] == readStructure.modelIndices[ch2]) {
-                findInterfaceResidues(readStructure, readStructure.chain[ch1], readStructure.chain[ch2], resIdx1, distanceThreshold);
-                findInterfaceResidues(readStructure, readStructure.chain[ch2], readStructure.chain[ch1], resIdx2, distanceThreshold);
+                findInterfaceResidues(readStructure, readStructure.chain[ch1], chainGrids[ch2], resIdx1, candidates, distanceThreshold);
+                findInterfaceResidues(readStructure, readStructure.chain[ch2], chainGrids[ch1], resIdx2, candidates, distanceThreshold);
                 if (resIdx1.size() >= 4 && resIdx2.size() >= 4) {
                     modelToInterfaceNum[readStructure.modelIndices[ch2]]++;
                     for (size_t i = 0; i < resIdx1.size(); i++) {
@@ -461,6 +1078,14 @@ void compute3DiInterfaces(GemmiWrapper &readStructure, PulchraWrapper &pulchra,
     readStructure.modelIndices.insert(readStructure.modelIndices.begin(), interfaceModelIndices.begin(), interfaceModelIndices.end());
 }
 
+struct EntryFile {
+    EntryFile(const std::string &entryName, const std::string &filename, unsigned int modelIndex)
+        : entryName(entryName), filename(filename), modelIndex(modelIndex) {}
+    std::string entryName;
+    std::string filename;
+    unsigned int modelIndex;
+};
+
 size_t
 writeStructureEntry(SubstitutionMatrix & mat, GemmiWrapper & readStructure, StructureTo3Di & structureTo3Di,
                     PulchraWrapper & pulchra, std::vector<char> & alphabet3di, std::vector<char> & alphabetAA,
@@ -479,6 +1104,8 @@ writeStructureEntry(SubstitutionMatrix & mat, GemmiWrapper & readStructure, Stru
     }
     size_t id = __sync_fetch_and_add(&globalCnt, readStructure.chain.size());
     size_t entriesAdded = 0;
+    // entry name, file name and model index of every written chain
+    std::vector<EntryFile> entryFiles;
     for (size_t ch = 0; ch < readStructure.chain.size(); ch++) {
         size_t dbKey = id + ch;
         size_t chainStart = readStructure.chain[ch].first;
@@ -578,52 +1205,25 @@ writeStructureEntry(SubstitutionMatrix & mat, GemmiWrapper & readStructure, Stru
         aadbw.writeData(alphabetAA.data(), alphabetAA.size(), dbKey, thread_idx);
         header.push_back('\n');
         std::string entryName = Util::parseFastaHeader(header.c_str());
-#pragma omp critical
-        {
-            // Store hash-to-path mapping when hash mode is enabled
-            if (par.hashEntryNames && !originalFilePath.empty()) {
-                hashToPathMapping[entryName] = originalFilePath;
+        // the file of the entry is looked up once all chains are written, so the lock is taken once per file
+        std::string filenameWithoutExtension;
+        if (par.dbExtractionMode == LocalParameters::DB_EXTRACT_MODE_CHAIN) {
+            std::string filenameWithExtension;
+            if (Util::endsWith(".gz", readStructure.names[ch]) || Util::endsWith(".zstd", readStructure.names[ch]) || Util::endsWith(".zst", readStructure.names[ch])) {
+                filenameWithExtension = Util::remove_extension(Util::remove_extension(readStructure.names[ch]));
+            } else {
+                filenameWithExtension = Util::remove_extension(readStructure.names[ch]);
             }
-            if (par.dbExtractionMode == LocalParameters::DB_EXTRACT_MODE_CHAIN) {
-                std::string filenameWithExtension;
-                if (Util::endsWith(".gz", readStructure.names[ch]) || Util::endsWith(".zstd", readStructure.names[ch]) || Util::endsWith(".zst", readStructure.names[ch])) {
-                    filenameWithExtension = Util::remove_extension(Util::remove_extension(readStructure.names[ch]));
-                } else {
-                    filenameWithExtension = Util::remove_extension(readStructure.names[ch]);
-                }
-                std::string filenameWithoutExtension = Util::remove_extension(filenameWithExtension);
-                std::map<std::string, size_t>::iterator it = filenameToFileId.find(filenameWithoutExtension);
-                size_t fileid;
-                if (it != filenameToFileId.end()) {
-                    fileid = it->second;
-                } else {
-                    fileid = fileidCnt;
-                    filenameToFileId[filenameWithoutExtension] = fileid;
-                    fileIdToName[fileid] = filenameWithoutExtension;
-                    fileidCnt++;
-                }
-                entrynameToFileId[entryName] = std::make_pair(fileid, readStructure.modelIndices[ch]);
-            } else if (par.dbExtractionMode == LocalParameters::DB_EXTRACT_MODE_INTERFACE) {
-                std::string filenameWithoutExtension;
-                if (chainNameMode == LocalParameters::CHAIN_MODE_ADD || chainNameMode == LocalParameters::CHAIN_MODE_AUTO) {
-                    size_t firstUnderscore = readStructure.names[ch].find_last_of('_');
-                    filenameWithoutExtension = readStructure.names[ch].substr(0, firstUnderscore);
-                } else {
-                    filenameWithoutExtension = readStructure.names[ch];
-                }
-                std::map<std::string, size_t>::iterator it = filenameToFileId.find(filenameWithoutExtension);
-                size_t fileid;
-                if (it != filenameToFileId.end()) {
-                    fileid = it->second;
-                } else {
-                    fileid = fileidCnt;
-                    filenameToFileId[filenameWithoutExtension] = fileid;
-                    fileIdToName[fileid] = filenameWithoutExtension;
-                    fileidCnt++;
-                }
-                entrynameToFileId[entryName] = std::make_pair(fileid, readStructure.modelIndices[ch]);
+            filenameWithoutExtension = Util::remove_extension(filenameWithExtension);
+        } else if (par.dbExtractionMode == LocalParameters::DB_EXTRACT_MODE_INTERFACE) {
+            if (chainNameMode == LocalParameters::CHAIN_MODE_ADD || chainNameMode == LocalParameters::CHAIN_MODE_AUTO) {
+                size_t firstUnderscore = readStructure.names[ch].find_last_of('_');
+                filenameWithoutExtension = readStructure.names[ch].substr(0, firstUnderscore);
+            } else {
+                filenameWithoutExtension = readStructure.names[ch];
             }
         }
+        entryFiles.emplace_back(entryName, filenameWithoutExtension, readStructure.modelIndices[ch]);
         hdbw.writeData(header.c_str(), header.size(), dbKey, thread_idx);
 
         if (mappingWriter != NULL) {
@@ -633,6 +1233,12 @@ writeStructureEntry(SubstitutionMatrix & mat, GemmiWrapper & readStructure, Stru
         }
 
         float* camolf32;
+        if (coordStoreMode == LocalParameters::COORD_STORE_MODE_CA_ALIGNED) {
+            const double* ca = (const double*)(readStructure.ca.data() + chainStart);
+            Coordinate16::convertToAligned(chainLen, ca + 0, ca + 1, ca + 2, camol, 3);
+            cadbw.writeData((const char*)camol.data(), camol.size(), dbKey, thread_idx);
+            goto cleanup;
+        }
         if (coordStoreMode == LocalParameters::COORD_STORE_MODE_CA_DIFF) {
             camol.resize((chainLen - 1) * 3 * sizeof(int16_t) + 3 * sizeof(float) + 1 * sizeof(uint8_t));
             int16_t* camolf16 = reinterpret_cast<int16_t*>(camol.data());
@@ -668,27 +1274,244 @@ cleanup:
         camol.clear();
         entriesAdded++;
     }
+    if (entryFiles.empty()) {
+        return entriesAdded;
+    }
+#pragma omp critical
+    {
+        for (size_t i = 0; i < entryFiles.size(); i++) {
+            const EntryFile &entry = entryFiles[i];
+            // Store hash-to-path mapping when hash mode is enabled
+            if (par.hashEntryNames && !originalFilePath.empty()) {
+                hashToPathMapping[entry.entryName] = originalFilePath;
+            }
+            if (par.dbExtractionMode != LocalParameters::DB_EXTRACT_MODE_CHAIN && par.dbExtractionMode != LocalParameters::DB_EXTRACT_MODE_INTERFACE) {
+                continue;
+            }
+            std::map<std::string, size_t>::iterator it = filenameToFileId.find(entry.filename);
+            size_t fileid;
+            if (it != filenameToFileId.end()) {
+                fileid = it->second;
+            } else {
+                fileid = fileidCnt;
+                filenameToFileId[entry.filename] = fileid;
+                fileIdToName[fileid] = entry.filename;
+                fileidCnt++;
+            }
+            entrynameToFileId[entry.entryName] = std::make_pair(fileid, entry.modelIndex);
+        }
+    }
     return entriesAdded;
 }
 
-void sortDatafileByIdOrder(DBWriter & dbw,
-                           DBReader<unsigned int> &dbr,  std::vector<std::pair<std::string, unsigned int>> & order) {
-#pragma omp parallel
-    {
-        int thread_idx = 0;
-#ifdef OPENMP
-        thread_idx = omp_get_thread_num();
+// Assigns the keys of keyToId (sorted by old key) to the entries of a database.
+// Only the index is rewritten, the data file is left untouched.
+void renumberIndexByIdOrder(const std::string & dataFile, const std::string & indexFile,
+                            const std::vector<std::pair<unsigned int, unsigned int>> & keyToId) {
+    DBReader<unsigned int> reader(dataFile.c_str(), indexFile.c_str(), 1, DBReader<unsigned int>::USE_INDEX);
+    reader.open(DBReader<unsigned int>::NOSORT);
+    std::vector<DBReader<unsigned int>::Index> index(reader.getSize());
+    for (size_t i = 0; i < reader.getSize(); i++) {
+        index[i] = *reader.getIndex(i);
+        std::vector<std::pair<unsigned int, unsigned int>>::const_iterator it =
+                std::lower_bound(keyToId.begin(), keyToId.end(), std::make_pair(index[i].id, 0u));
+        if (it == keyToId.end() || it->first != index[i].id) {
+            Debug(Debug::ERROR) << "Key " << index[i].id << " of " << dataFile << " has no header\n";
+            EXIT(EXIT_FAILURE);
+        }
+        index[i].id = it->second;
+    }
+    reader.close();
+    SORT_PARALLEL(index.begin(), index.end(), DBReader<unsigned int>::Index::compareById);
+
+    std::string indexTmp = indexFile + "_tmp";
+    FILE *sIndex = FileUtil::openAndDelete(indexTmp.c_str(), "w");
+    char buffer[1024];
+    for (size_t i = 0; i < index.size(); i++) {
+        size_t len = DBWriter::indexToBuffer(buffer, index[i].id, index[i].offset, index[i].length);
+        size_t written = fwrite(buffer, sizeof(char), len, sIndex);
+        if (written != len) {
+            Debug(Debug::ERROR) << "Cannot write to index file " << indexTmp << "\n";
+            EXIT(EXIT_FAILURE);
+        }
+    }
+    if (fclose(sIndex) != 0) {
+        Debug(Debug::ERROR) << "Cannot close index file " << indexTmp << "\n";
+        EXIT(EXIT_FAILURE);
+    }
+    std::rename(indexTmp.c_str(), indexFile.c_str());
+}
+
+#ifdef HAVE_GCS
+struct GcsObject {
+    std::string name;
+    std::string contents;
+    bool ok;
+};
+
+// Downloads one object, failed requests are retried with exponential backoff
+static GcsObject fetchGcsObject(::google::cloud::storage::Client client, const std::string &bucket, const std::string &name) {
+    const int maxAttempts = 5;
+    GcsObject object;
+    object.name = name;
+    object.ok = false;
+    std::chrono::milliseconds backoff(100);
+    for (int attempt = 1; attempt <= maxAttempts; attempt++) {
+        auto reader = client.ReadObject(bucket, name);
+        if (reader.status().ok()) {
+            object.contents.assign(std::istreambuf_iterator<char>{reader}, {});
+            if (reader.status().ok()) {
+                object.ok = true;
+                break;
+            }
+        }
+        if (attempt == maxAttempts) {
+            Debug(Debug::ERROR) << "Cannot download " << name << ": " << reader.status().message() << "\n";
+            object.contents.clear();
+            break;
+        }
+        std::this_thread::sleep_for(backoff);
+        backoff *= 2;
+    }
+    return object;
+}
 #endif
 
-#pragma omp for schedule(static)
-        for (size_t i = 0; i < dbr.getSize(); i++) {
-            size_t id = order[i].second;
-            char *data = dbr.getData(id, thread_idx);
-            size_t length = dbr.getEntryLen(id);
-            dbw.writeData(data, (length == 0 ? 0 : length - 1), dbr.getDbKey(id), thread_idx);
+#ifdef HAVE_PROSTT5
+static const char* PROSTT5_PRECISION_NAMES[] = { "auto", "f16", "q8_0", "q4_0" };
+// quantized weights whose 3Di predictions agree less with the f16 weights are not used by the auto selection
+static const float PROSTT5_MIN_AGREEMENT = 0.95f;
+static const size_t PROSTT5_CALIBRATION_SEQS = 32;
+static const size_t PROSTT5_CALIBRATION_LENGTH = 512;
+// smaller inputs do not pay off quantizing and benchmarking
+static const size_t PROSTT5_AUTO_MIN_ENTRIES = 1000;
+
+// quantized weights are cached next to the f16 weights, or next to the output database if that directory is read-only
+static std::string prostt5QuantizedWeights(const std::string& weights, const std::string& outputName, int precision, int threads, std::vector<std::string>& temporary) {
+    const std::string type = PROSTT5_PRECISION_NAMES[precision];
+    const std::string cached = FileUtil::dirName(weights) + "/prostt5-" + type + ".gguf";
+    if (FileUtil::fileExists(cached.c_str())) {
+        return cached;
+    }
+    Debug(Debug::INFO) << "Quantizing ProstT5 weights to " << type << "\n";
+    const std::string partial = cached + ".tmp";
+    if (ProstT5Model::quantize(weights, partial, type, threads) && std::rename(partial.c_str(), cached.c_str()) == 0) {
+        return cached;
+    }
+    if (FileUtil::fileExists(partial.c_str())) {
+        FileUtil::remove(partial.c_str());
+    }
+    const std::string local = outputName + "_prostt5-" + type + ".gguf";
+    if (ProstT5Model::quantize(weights, local, type, threads)) {
+        temporary.emplace_back(local);
+        return local;
+    }
+    Debug(Debug::WARNING) << "Could not quantize ProstT5 weights to " << type << "\n";
+    return "";
+}
+
+// predicts a calibration set drawn from the length sorted input with the f16 weights and every quantized candidate
+// and returns the fastest weights whose predictions agree with the f16 ones
+static std::string prostt5SelectWeights(DBReader<unsigned int>& reader, const std::string& weights, const std::vector<std::pair<int, std::string>>& candidates, int threads) {
+    std::vector<std::string> calibration;
+    const size_t step = std::max((size_t) 1, reader.getSize() / PROSTT5_CALIBRATION_SEQS);
+    for (size_t i = 0; i < reader.getSize() && calibration.size() < PROSTT5_CALIBRATION_SEQS; i += step) {
+        size_t length = std::min(reader.getSeqLen(i), PROSTT5_CALIBRATION_LENGTH);
+        calibration.emplace_back(reader.getData(i, 0), length);
+    }
+
+    std::string device = "none";
+    std::vector<std::string> reference;
+    double bestTime = 0.0;
+    std::string best = weights;
+    for (size_t c = 0; c <= candidates.size(); ++c) {
+        const std::string& path = c == 0 ? weights : candidates[c - 1].second;
+        const int precision = c == 0 ? LocalParameters::PROSTT5_PRECISION_F16 : candidates[c - 1].first;
+        ProstT5Model model(path, device);
+        if (model.model == NULL) {
+            continue;
+        }
+        ProstT5 context(model, threads);
+        // the first encoder call allocates the compute graph
+        context.predict("M");
+        Timer timer;
+        std::vector<std::string> predictions = context.predictBatch(calibration);
+        const double time = timer.getTimediff();
+
+        size_t same = 0;
+        size_t total = 0;
+        if (c == 0) {
+            reference = predictions;
+        }
+        for (size_t i = 0; i < predictions.size(); ++i) {
+            for (size_t j = 0; j < std::min(predictions[i].length(), reference[i].length()); ++j) {
+                same += predictions[i][j] == reference[i][j];
+            }
+            total += reference[i].length();
+        }
+        const float agreement = total > 0 ? same / static_cast<float>(total) : 1.0f;
+        Debug(Debug::INFO) << "ProstT5 " << PROSTT5_PRECISION_NAMES[precision] << ": " << time << "s, 3Di agreement " << agreement << "\n";
+        if (c == 0 || (agreement >= PROSTT5_MIN_AGREEMENT && time < bestTime)) {
+            bestTime = time;
+            best = path;
+        }
+    }
+    return best;
+}
+
+// sends the sequences to a running prostt5server, in as many requests as its buffers need
+static std::vector<std::string> prostt5ServerPredict(ProstT5SharedMemory* layout, const std::vector<std::string>& sequences) {
+    std::vector<std::string> predictions(sequences.size());
+    size_t next = 0;
+    while (next < sequences.size()) {
+        int expected = ProstT5SharedMemory::IDLE;
+        while (layout->state.compare_exchange_strong(expected, ProstT5SharedMemory::RESERVED, std::memory_order_acq_rel) == false) {
+            if (layout->serverExit.load(std::memory_order_acquire) == true) {
+                Debug(Debug::ERROR) << "ProstT5 server has unexpectedly shut down\n";
+                EXIT(EXIT_FAILURE);
+            }
+            expected = ProstT5SharedMemory::IDLE;
+            std::this_thread::yield();
+        }
+
+        const size_t first = next;
+        unsigned int* lengths = layout->getLengthsPtr();
+        char* aa = layout->getSequencesPtr();
+        size_t residues = 0;
+        while (next < sequences.size() && next - first < layout->maxSeqs && residues + sequences[next].length() <= layout->maxResidues) {
+            memcpy(aa + residues, sequences[next].c_str(), sequences[next].length());
+            lengths[next - first] = sequences[next].length();
+            residues += sequences[next].length();
+            next++;
+        }
+        if (next == first) {
+            Debug(Debug::ERROR) << "Sequence of length " << sequences[next].length() << " does not fit into the ProstT5 server buffer\n";
+            EXIT(EXIT_FAILURE);
+        }
+        layout->seqCount = next - first;
+        std::atomic_thread_fence(std::memory_order_release);
+        layout->state.store(ProstT5SharedMemory::READY, std::memory_order_release);
+
+        while (layout->state.load(std::memory_order_acquire) != ProstT5SharedMemory::DONE) {
+            if (layout->serverExit.load(std::memory_order_acquire) == true) {
+                Debug(Debug::ERROR) << "ProstT5 server has unexpectedly shut down\n";
+                EXIT(EXIT_FAILURE);
+            }
+            std::this_thread::yield();
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // every prediction starts at the offset of its input sequence
+        const char* states = layout->getStatesPtr();
+        for (size_t i = first; i < next; ++i) {
+            predictions[i].assign(states, lengths[i - first]);
+            states += sequences[i].length();
         }
+        layout->state.store(ProstT5SharedMemory::IDLE, std::memory_order_release);
     }
+    return predictions;
 }
+#endif
 
 extern int createdb(int argc, const char **argv, const Command& command);
 int structcreatedb(int argc, const char **argv, const Command& command) {
@@ -709,140 +1532,224 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
         }
         fflush(stdout);
 
-        std::vector<std::string> prefix = { "", "/model" };
-        std::vector<std::string> suffix = { "", "/prostt5-f16.gguf" };
-        // bool quantized = false;
-        std::string modelWeights;
-        for (size_t i = 0; i < prefix.size(); ++i) {
-            for (size_t j = 0; j < suffix.size(); ++j) {
-                std::string tensorPath = par.prostt5Model + prefix[i] + suffix[j];
-                if (FileUtil::fileExists(tensorPath.c_str()) && FileUtil::directoryExists(tensorPath.c_str()) == false) {
-                    modelWeights = tensorPath;
-                    break;
-                }
+        std::string modelWeights = ProstT5Model::findWeights(par.prostt5Model);
+        if (modelWeights.empty()) {
+            if (ProstT5Model::hasLegacyWeights(par.prostt5Model)) {
+                Debug(Debug::ERROR) << "Found ProstT5 model weights for previous Foldseek release. Download new weights with `foldseek databases ProstT5 prostt5_out tmp`\n";
+            } else {
+                Debug(Debug::ERROR) << "Could not find ProstT5 model weights. Download with `foldseek databases ProstT5 prostt5_out tmp`\n";
             }
+            return EXIT_FAILURE;
         }
-        if (modelWeights.empty()) {
-            std::vector<std::string> prefix = { "", "/model" };
-            std::vector<std::string> suffix = { "/model.safetensors" };
-            std::string modelWeights;
-            for (size_t i = 0; i < prefix.size(); ++i) {
-                for (size_t j = 0; j < suffix.size(); ++j) {
-                    std::string tensorPath = par.prostt5Model + prefix[i] + suffix[j];
-                    if (FileUtil::fileExists(tensorPath.c_str())) {
-                        modelWeights = par.prostt5Model + prefix[i];
-                        break;
+
+        // a running prostt5server already holds the model, so it is neither loaded nor are devices probed
+        ProstT5SharedMemory* server = NULL;
+        if (par.prostt5Server == 1) {
+            server = ProstT5SharedMemory::openSharedMemory(ProstT5SharedMemory::getShmHash(modelWeights));
+            if (server == NULL) {
+                Debug(Debug::ERROR) << "prostt5server for " << modelWeights << " not found.\n"
+                                    << "Please start `foldseek prostt5server " << par.prostt5Model << "` first\n";
+                return EXIT_FAILURE;
+            }
+        }
+
+        LlamaInitGuard guard(par.verbosity > 3);
+        std::vector<std::string> devices;
+        if (server == NULL) {
+            devices = ProstT5::getDevices();
+            for (std::vector<std::string>::iterator it = devices.begin(); it != devices.end(); ++it) {
+                Debug(Debug::INFO) << *it << "\n";
+            }
+            if (par.gpu == 1 && !devices.empty()) {
+                for (std::vector<std::string>::iterator it = devices.begin(); it != devices.end();) {
+                    if (it->find("CUDA") == std::string::npos) {
+                        it = devices.erase(it); // Erase returns the next iterator
+                    } else {
+                        ++it; // Move to the next element
                     }
                 }
-            }
-            if (modelWeights.empty()) {
-                Debug(Debug::ERROR) << "Could not find ProstT5 model weights. Download with `foldseek databases ProstT5 prostt5_out tmp`\n";
-                return EXIT_FAILURE;
+                if (devices.size() == 0) {
+                    Debug(Debug::ERROR) << "No GPU devices found\n";
+                    return EXIT_FAILURE;
+                }
             } else {
-                Debug(Debug::ERROR) << "Found ProstT5 model weights for previous Foldseek release. Download new weights with `foldseek databases ProstT5 prostt5_out tmp`\n";
-                return EXIT_FAILURE;
+                for (size_t i = 0; i < devices.size(); i++) {
+                    if (devices[i] == "Metal") {
+                        par.gpu = 1;
+                        devices.clear();
+                        devices.push_back("Metal");
+                        break;
+                    }
+                }
             }
         }
 
-        LlamaInitGuard guard(par.verbosity > 3);
-        std::vector<std::string> devices = ProstT5::getDevices();
-        for (std::vector<std::string>::iterator it = devices.begin(); it != devices.end(); ++it) {
-            Debug(Debug::INFO) << *it << "\n";
-        }
-        if (par.gpu == 1 && !devices.empty()) {
-            for (std::vector<std::string>::iterator it = devices.begin(); it != devices.end();) {
-                if (it->find("CUDA") == std::string::npos) {
-                    it = devices.erase(it); // Erase returns the next iterator
-                } else {
-                    ++it; // Move to the next element
+        DBReader<unsigned int> reader(outputName.c_str(), (outputName+".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
+        // longest entries first, so that batches are length buckets and no worker is left with a long tail
+        reader.open(DBReader<unsigned int>::SORT_BY_LENGTH);
+
+        // CPU inference profits from quantized encoder weights, the auto mode benchmarks them against f16
+        const std::string baseWeights = modelWeights;
+        int selectedPrecision = LocalParameters::PROSTT5_PRECISION_F16;
+        std::vector<std::string> temporaryWeights;
+        int precision = par.prostt5Precision;
+        if (precision == LocalParameters::PROSTT5_PRECISION_AUTO && (par.gpu == 1 || reader.getSize() < PROSTT5_AUTO_MIN_ENTRIES)) {
+            precision = LocalParameters::PROSTT5_PRECISION_F16;
+        }
+        if (server == NULL && precision != LocalParameters::PROSTT5_PRECISION_F16) {
+            std::vector<std::pair<int, std::string>> candidates;
+            for (int p = LocalParameters::PROSTT5_PRECISION_Q8_0; p <= LocalParameters::PROSTT5_PRECISION_Q4_0; ++p) {
+                if (precision != LocalParameters::PROSTT5_PRECISION_AUTO && precision != p) {
+                    continue;
+                }
+                std::string quantized = prostt5QuantizedWeights(modelWeights, outputName, p, par.threads, temporaryWeights);
+                if (quantized.empty() == false) {
+                    candidates.emplace_back(p, quantized);
                 }
             }
-            if (devices.size() == 0) {
-                Debug(Debug::ERROR) << "No GPU devices found\n";
-                return EXIT_FAILURE;
+            if (precision == LocalParameters::PROSTT5_PRECISION_AUTO) {
+                modelWeights = prostt5SelectWeights(reader, modelWeights, candidates, par.threads);
+            } else if (candidates.empty() == false) {
+                modelWeights = candidates[0].second;
             }
-        } else {
-            for (size_t i = 0; i < devices.size(); i++) {
-                if (devices[i] == "Metal") {
-                    par.gpu = 1;
-                    devices.clear();
-                    devices.push_back("Metal");
-                    break;
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                if (candidates[i].second == modelWeights) {
+                    selectedPrecision = candidates[i].first;
                 }
             }
         }
 
-        bool useForkRunner = FORK_RUNNER && par.gpu == 0;
-        DBReader<unsigned int> reader(outputName.c_str(), (outputName+".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
-        reader.open(useForkRunner ? DBReader<unsigned int>::SORT_BY_LENGTH : DBReader<unsigned int>::LINEAR_ACCCESS);
+        // sequences predicted by an earlier run with the same model are taken from the cache
+        ProstT5Cache* cache = NULL;
+        std::vector<char> cached(reader.getSize(), false);
+        size_t misses = reader.getSize();
+        if (par.prostt5Cache.empty() == false) {
+            uint64_t version = ProstT5Cache::modelVersion(baseWeights, PROSTT5_PRECISION_NAMES[selectedPrecision], par.prostt5SplitLength, par.prostt5SplitOverlap);
+            cache = new ProstT5Cache(par.prostt5Cache, version);
+            std::string states;
+            for (size_t i = 0; i < reader.getSize(); ++i) {
+                cached[i] = cache->lookup(reader.getData(i, 0), reader.getSeqLen(i), states);
+                misses -= cached[i];
+            }
+            Debug(Debug::INFO) << (reader.getSize() - misses) << " of " << reader.getSize() << " sequences found in ProstT5 cache\n";
+        }
 
         unsigned const int MIN_SPLIT_LENGTH = 2;
         std::string ssDb = outputName + "_ss";
         std::string ssIndex = ssDb + ".index"; 
-        if (useForkRunner) {
-            prostt5Forking(modelWeights, par.prostt5SplitLength, MIN_SPLIT_LENGTH, reader, ssDb, ssIndex, par.threads, par.compressed);
+        DBWriter writer(ssDb.c_str(), ssIndex.c_str(), par.threads, par.compressed, reader.getDbtype());
+        writer.open();
+
+        // pack consecutive entries into one encoder batch
+        std::vector<size_t> lengths(reader.getSize());
+        for (size_t i = 0; i < reader.getSize(); ++i) {
+            lengths[i] = cached[i] ? 0 : reader.getSeqLen(i);
+        }
+        std::vector<std::pair<size_t, size_t>> batches = ProstT5::batchRanges(lengths, par.prostt5SplitLength, MIN_SPLIT_LENGTH, par.prostt5SplitOverlap);
+
+        // every GPU needs its own copy of the weights, on the CPU all workers share one model
+        // and each context gets up to 4 threads of its own
+        std::vector<ProstT5Model*> models;
+        std::vector<ProstT5*> contexts;
+        if (server != NULL || misses == 0) {
+            // requests are serialized by the server
+        } else if (par.gpu == 1) {
+            for (size_t i = 0; i < devices.size(); ++i) {
+                models.emplace_back(new ProstT5Model(modelWeights, devices[i]));
+                contexts.emplace_back(new ProstT5(*models.back(), 1));
+            }
         } else {
-            DBWriter writer(ssDb.c_str(), ssIndex.c_str(), par.threads, par.compressed, reader.getDbtype());
-            writer.open();
+            std::string device = "none";
+            models.emplace_back(new ProstT5Model(modelWeights, device));
+            int leftover = par.threads;
+            while (leftover > 0) {
+                int inner = std::min(4, leftover);
+                leftover -= inner;
+                contexts.emplace_back(new ProstT5(*models.back(), inner));
+            }
+        }
 
-            Debug::Progress progress(reader.getSize());
-#ifdef OPENMP
-            size_t localThreads = par.gpu == 1 ? devices.size() : 1;
-#endif
-#pragma omp parallel num_threads(localThreads)
-            {
-                int thread_idx = 0;
+        Debug::Progress progress(reader.getSize());
+#pragma omp parallel num_threads(contexts.empty() ? 1 : contexts.size())
+        {
+            int thread_idx = 0;
 #ifdef OPENMP
-                thread_idx = omp_get_thread_num();
+            thread_idx = omp_get_thread_num();
 #endif
-                std::string device = "none";
-                int localThreads = par.threads;
-                if (par.gpu == 1) {
-                    device = devices[thread_idx];
-                    localThreads = 1;
-                }
-                ProstT5Model model(modelWeights.c_str(), device);
-                ProstT5 context(model, localThreads);
-                const char newline = '\n';
-                std::string result;
+            ProstT5* context = contexts.empty() ? NULL : contexts[thread_idx];
+            const char newline = '\n';
+            std::string states;
+            std::vector<std::string> pieces;
+            std::vector<ProstT5::Window> windows;
+            std::vector<size_t> windowCount;
 #pragma omp for schedule(dynamic, 1)
-                for (size_t i = 0; i < reader.getSize(); ++i) {
-                    unsigned int key = reader.getDbKey(i);
+            for (size_t b = 0; b < batches.size(); ++b) {
+                pieces.clear();
+                windows.clear();
+                windowCount.clear();
+                for (size_t i = batches[b].first; i < batches[b].second; ++i) {
+                    if (cached[i]) {
+                        windowCount.emplace_back(0);
+                        continue;
+                    }
                     size_t length = reader.getSeqLen(i);
-                    std::string seq = std::string(reader.getData(i, thread_idx), length);
-                    result.clear();
-
+                    const char* seq = reader.getData(i, thread_idx);
                     // splitting input sequences longer than ProstT5 attention (current cutoff 6000 AAs)
-                    unsigned int split_length = par.prostt5SplitLength;
-                    // split lenght of 0 will deactivate splitting
-                    if (split_length > 0 && length > split_length) {
-                        unsigned int n_splits, overlap_length;
-                        n_splits = int(length / split_length) + 1;
-                        overlap_length = length % split_length;
-
-                        // ensure minimum overlap length; adjustment length was not computed properly with ceil/ceilf now using simple int cast
-                        if (overlap_length < MIN_SPLIT_LENGTH) {
-                            split_length -= int((MIN_SPLIT_LENGTH - overlap_length) / (n_splits - 1)) + 1;
-                        }
+                    // all windows of one sequence are predicted in the same batch
+                    size_t before = windows.size();
+                    ProstT5::splitWindows(length, par.prostt5SplitLength, MIN_SPLIT_LENGTH, par.prostt5SplitOverlap, windows);
+                    for (size_t j = before; j < windows.size(); ++j) {
+                        pieces.emplace_back(seq + windows[j].start, windows[j].length);
+                    }
+                    windowCount.emplace_back(windows.size() - before);
+                }
+                std::vector<std::string> predictions;
+                if (pieces.empty() == false) {
+                    predictions = server != NULL ? prostt5ServerPredict(server, pieces) : context->predictBatch(pieces);
+                }
 
-                        // loop over splits and predict
-                        for (unsigned int i = 0; i < n_splits; i++){
-                            unsigned int split_start = i * split_length;
-                            result.append(context.predict(seq.substr(split_start, split_length)));
+                size_t piece = 0;
+                for (size_t i = batches[b].first; i < batches[b].second; ++i) {
+                    unsigned int key = reader.getDbKey(i);
+                    const char* seq = reader.getData(i, thread_idx);
+                    size_t length = reader.getSeqLen(i);
+                    states.clear();
+                    if (cached[i]) {
+                        cache->lookup(seq, length, states);
+                    }
+                    for (size_t j = 0; j < windowCount[i - batches[b].first]; ++j, ++piece) {
+                        const ProstT5::Window& window = windows[piece];
+                        if (predictions[piece].length() < window.keepEnd) {
+                            continue;
                         }
-                    } else {
-                        result.append(context.predict(seq));
+                        states.append(predictions[piece].c_str() + window.keepStart, window.keepEnd - window.keepStart);
+                    }
+                    if (cache != NULL && cached[i] == false) {
+                        cache->add(seq, length, states);
                     }
-
                     writer.writeStart(thread_idx);
-                    writer.writeAdd(result.c_str(), result.length(), thread_idx);
+                    writer.writeAdd(states.c_str(), states.length(), thread_idx);
                     writer.writeAdd(&newline, 1, thread_idx);
                     writer.writeEnd(key, thread_idx);
                     progress.updateProgress();
                 }
             }
-            writer.close(true);
         }
+        writer.close(true);
+        if (cache != NULL) {
+            cache->flush();
+            delete cache;
+        }
+        for (size_t i = 0; i < contexts.size(); ++i) {
+            delete contexts[i];
+        }
+        for (size_t i = 0; i < models.size(); ++i) {
+            delete models[i];
+        }
+        for (size_t i = 0; i < temporaryWeights.size(); ++i) {
+            FileUtil::remove(temporaryWeights[i].c_str());
+        }
+        ProstT5SharedMemory::unmap(server);
         reader.close();
 
         DBReader<unsigned int> resultReader(ssDb.c_str(), (ssDb+".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
@@ -991,38 +1898,64 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
     int inputFormat = par.inputFormat;
 
     // Process tar files!
-    for (size_t i = 0; i < tarFiles.size(); i++) {
-        mtar_t tar;
-        if (Util::endsWith(".tar.gz", tarFiles[i]) || Util::endsWith(".tgz", tarFiles[i])) {
-#ifdef HAVE_ZLIB
-            if (structure_mtar_gzopen(&tar, tarFiles[i].c_str()) != MTAR_ESUCCESS) {
-                Debug(Debug::ERROR) << "Cannot open file " << tarFiles[i] << "\n";
-                EXIT(EXIT_FAILURE);
-            }
-#else
-            Debug(Debug::ERROR) << "Foldseek was not compiled with zlib support. Cannot read compressed input.\n";
-            EXIT(EXIT_FAILURE);
-#endif
-        } else if (Util::endsWith(".tar.zstd", tarFiles[i]) || Util::endsWith(".tar.zst", tarFiles[i])) {
-            if (mtar_zstdopen(&tar, tarFiles[i].c_str()) != MTAR_ESUCCESS) {
-                Debug(Debug::ERROR) << "Cannot open file " << tarFiles[i] << "\n";
-                EXIT(EXIT_FAILURE);
+    // Every reader owns one open tar part at a time and moves on to the next unread part
+    // when it is done. Members are read and decompressed under the lock of their reader only,
+    // so up to one tar part per thread is decompressed while the other threads parse.
+    // Seekable zstd and BGZF archives are split into parts if there are fewer archives than threads.
+    // With --tar-index, archives with a member index are only read at the included members,
+    // the others are indexed while they are read.
+    std::vector<TarPart> tarParts;
+    // parts whose members are collected for a new tar index
+    std::vector<char> tarPartIndexed;
+    {
+        PatternCompiler include(par.fileInclude.c_str());
+        PatternCompiler exclude(par.fileExclude.c_str());
+        for (size_t i = 0; i < tarFiles.size(); i++) {
+            std::vector<TarMember> members;
+            size_t start = tarParts.size();
+            bool hasIndex = par.tarIndex && readTarIndex(tarFiles[i], members);
+            if (hasIndex) {
+                tarPartsFromIndex(tarFiles[i], members, include, exclude, tarParts);
+            } else {
+                size_t maxParts = 1;
+                if (tarFiles.size() < static_cast<size_t>(par.threads)) {
+                    maxParts = par.threads / tarFiles.size();
+                }
+                splitTarArchive(tarFiles[i], maxParts, tarParts);
             }
-        } else {
-            if (mtar_open(&tar, tarFiles[i].c_str(), "r") != MTAR_ESUCCESS) {
-                Debug(Debug::ERROR) << "Cannot open file " << tarFiles[i] << "\n";
-                EXIT(EXIT_FAILURE);
+            tarPartIndexed.resize(tarParts.size(), par.tarIndex && hasIndex == false);
+            if (hasIndex && tarParts.size() == start) {
+                progress.updateProgress();
             }
         }
-        progress.updateProgress();
+    }
+    if (tarParts.empty() == false) {
+        std::vector<std::vector<TarMember>> tarPartMembers(tarParts.size());
+        size_t numTarReaders = 1;
 #ifdef OPENMP
-        int localThreads = par.threads;
-        if (localThreads > 1) {
+        numTarReaders = std::min(tarParts.size(), static_cast<size_t>(par.threads));
+        if (par.threads > 1) {
             needsReorderingAtTheEnd = true;
         }
 #endif
+        std::vector<TarReader> tarReaders(numTarReaders);
+        size_t nextTarPart = 0;
+        for (size_t i = 0; i < numTarReaders; i++) {
+            const TarPart &part = tarParts[nextTarPart];
+            openTarFile(&tarReaders[i].tar, part);
+            tarReaders[i].part = nextTarPart;
+            tarReaders[i].pos = part.decompressedOffset;
+            if (nextTarPart == 0 || tarParts[nextTarPart - 1].filename != part.filename) {
+                progress.updateProgress();
+            }
+            nextTarPart++;
+            tarReaders[i].exhausted = false;
+#ifdef OPENMP
+            omp_init_lock(&tarReaders[i].lock);
+#endif
+        }
 
-#pragma omp parallel default(none) shared(tar, par, torsiondbw, hdbw, cadbw, aadbw, mat, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, mappingWriter, hashToPathMapping, std::cerr, std::cout, inputFormat) num_threads(localThreads) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
+#pragma omp parallel default(none) shared(tarReaders, tarParts, nextTarPart, tarPartIndexed, tarPartMembers, par, torsiondbw, hdbw, cadbw, aadbw, mat, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, mappingWriter, hashToPathMapping, std::cerr, std::cout, inputFormat) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
         {
             unsigned int thread_idx = 0;
 #ifdef OPENMP
@@ -1060,66 +1993,85 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
             char *dataBuffer = (char *) malloc(bufferSize);
             size_t inflateSize = 1024 * 1024;
             char *inflateBuffer = (char *) malloc(inflateSize);
-            bool proceed = true;
             PatternCompiler includeThread(par.fileInclude.c_str());
             PatternCompiler excludeThread(par.fileExclude.c_str());
 
-            while (proceed) {
-                bool writeEntry = true;
-#pragma omp critical
-                {
-                    if (tar.isFinished == 0 && (mtar_read_header(&tar, &tarHeader)) != MTAR_ENULLRECORD) {
-                        // GNU tar has special blocks for long filenames
-                        if (tarHeader.type == MTAR_TGNU_LONGNAME || tarHeader.type == MTAR_TGNU_LONGLINK) {
-                            if (tarHeader.size == 0) {
-                                Debug(Debug::ERROR) << "Invalid tar input with long name/link record of size 0\n";
-                                EXIT(EXIT_FAILURE);
-                            }
-                            if (tarHeader.size > bufferSize) {
-                                bufferSize = tarHeader.size * 1.5;
-                                dataBuffer = (char *) realloc(dataBuffer, bufferSize);
-                            }
-                            if (mtar_read_data(&tar, dataBuffer, tarHeader.size) != MTAR_ESUCCESS) {
-                                Debug(Debug::ERROR) << "Cannot read entry " << tarHeader.name << "\n";
-                                EXIT(EXIT_FAILURE);
-                            }
-                            // skip null byte
-                            name.assign(dataBuffer, tarHeader.size - 1);
-                            // skip to next record
-                            if (mtar_read_header(&tar, &tarHeader) == MTAR_ENULLRECORD) {
-                                Debug(Debug::ERROR) << "Tar truncated after entry " << name << "\n";
+            while (true) {
+                TarReader *reader = acquireTarReader(tarReaders, thread_idx);
+                if (reader == NULL) {
+                    break;
+                }
+                bool writeEntry = false;
+                size_t headerOffset = reader->pos;
+                if (reader->tar.isFinished == 0 && (mtar_read_header(&reader->tar, &tarHeader)) != MTAR_ENULLRECORD) {
+                    reader->pos += 512;
+                    // GNU tar has special blocks for long filenames
+                    if (tarHeader.type == MTAR_TGNU_LONGNAME || tarHeader.type == MTAR_TGNU_LONGLINK) {
+                        if (tarHeader.size == 0) {
+                            Debug(Debug::ERROR) << "Invalid tar input with long name/link record of size 0\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                        if (tarHeader.size > bufferSize) {
+                            bufferSize = tarHeader.size * 1.5;
+                            dataBuffer = (char *) realloc(dataBuffer, bufferSize);
+                        }
+                        if (mtar_read_data(&reader->tar, dataBuffer, tarHeader.size) != MTAR_ESUCCESS) {
+                            Debug(Debug::ERROR) << "Cannot read entry " << tarHeader.name << "\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                        reader->pos += MathUtil::ceilIntDivision(static_cast<size_t>(tarHeader.size), (size_t) 512) * 512 + 512;
+                        // skip null byte
+                        name.assign(dataBuffer, tarHeader.size - 1);
+                        // skip to next record
+                        if (mtar_read_header(&reader->tar, &tarHeader) == MTAR_ENULLRECORD) {
+                            Debug(Debug::ERROR) << "Tar truncated after entry " << name << "\n";
+                            EXIT(EXIT_FAILURE);
+                        }
+                    } else {
+                        name = tarHeader.name;
+                    }
+                    if (tarHeader.type == MTAR_TREG || tarHeader.type == MTAR_TCONT ||
+                        tarHeader.type == MTAR_TOLDREG) {
+                        writeEntry = includeThread.isMatch(name.c_str()) == true && excludeThread.isMatch(name.c_str()) == false;
+                        if (writeEntry == false) {
+                            if (mtar_skip_data(&reader->tar) != MTAR_ESUCCESS) {
+                                Debug(Debug::ERROR) << "Cannot skip entry " << name << "\n";
                                 EXIT(EXIT_FAILURE);
                             }
                         } else {
-                            name = tarHeader.name;
-                        }
-                        if (tarHeader.type == MTAR_TREG || tarHeader.type == MTAR_TCONT ||
-                            tarHeader.type == MTAR_TOLDREG) {
                             if (tarHeader.size > bufferSize) {
                                 bufferSize = tarHeader.size * 1.5;
                                 dataBuffer = (char *) realloc(dataBuffer, bufferSize);
                             }
-                            if (mtar_read_data(&tar, dataBuffer, tarHeader.size) != MTAR_ESUCCESS) {
+                            if (mtar_read_data(&reader->tar, dataBuffer, tarHeader.size) != MTAR_ESUCCESS) {
                                 Debug(Debug::ERROR) << "Cannot read entry " << name << "\n";
                                 EXIT(EXIT_FAILURE);
                             }
-                            if (includeThread.isMatch(name.c_str()) == false || excludeThread.isMatch(name.c_str()) == true) {
-                                proceed = true;
-                                writeEntry = false;
-                            } else {
-                                proceed = true;
-                                writeEntry = true;
-                            }
-                        } else {
-                            proceed = true;
-                            writeEntry = false;
+                        }
+                        reader->pos += MathUtil::ceilIntDivision(static_cast<size_t>(tarHeader.size), (size_t) 512) * 512;
+                        if (tarPartIndexed[reader->part]) {
+                            TarMember member = { headerOffset, reader->pos, { 0, 0 }, name };
+                            tarPartMembers[reader->part].push_back(member);
                         }
                     } else {
-                        tar.isFinished = 1;
-                        proceed = false;
                         writeEntry = false;
                     }
+                } else {
+                    reader->tar.isFinished = 1;
+                    mtar_close(&reader->tar);
+                    size_t partIdx = __sync_fetch_and_add(&nextTarPart, 1);
+                    if (partIdx < tarParts.size()) {
+                        openTarFile(&reader->tar, tarParts[partIdx]);
+                        reader->part = partIdx;
+                        reader->pos = tarParts[partIdx].decompressedOffset;
+                        if (tarParts[partIdx - 1].filename != tarParts[partIdx].filename) {
+                            progress.updateProgress();
+                        }
+                    } else {
+                        reader->exhausted = true;
+                    }
                 }
+                releaseTarReader(reader);
 
                 if (writeEntry) {
                     pdbFile.clear();
@@ -1173,8 +2125,27 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
             free(inflateBuffer);
             free(dataBuffer);
         } // end omp open
-        mtar_close(&tar);
-    } // end file for
+#ifdef OPENMP
+        for (size_t i = 0; i < numTarReaders; i++) {
+            omp_destroy_lock(&tarReaders[i].lock);
+        }
+#endif
+        // parts of an archive are consecutive and in archive order
+        for (size_t i = 0; i < tarParts.size(); ) {
+            size_t end = i + 1;
+            while (end < tarParts.size() && tarParts[end].filename == tarParts[i].filename) {
+                end++;
+            }
+            if (tarPartIndexed[i]) {
+                std::vector<TarMember> members;
+                for (size_t j = i; j < end; j++) {
+                    members.insert(members.end(), tarPartMembers[j].begin(), tarPartMembers[j].end());
+                }
+                writeTarIndex(tarParts[i].filename, members);
+            }
+            i = end;
+        }
+    }
 
 
     //===================== single_process ===================//__110710__//
@@ -1219,7 +2190,7 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
 #ifdef HAVE_GCS
     namespace gcs = ::google::cloud::storage;
     auto options = google::cloud::Options{}
-        .set<gcs::ConnectionPoolSizeOption>(par.threads)
+        .set<gcs::ConnectionPoolSizeOption>(par.threads * par.gcsPrefetch)
         .set<google::cloud::storage_experimental::HttpVersionOption>("2.0");
     auto client = gcs::Client(options);
     for (size_t i = 0; i < gcsPaths.size(); i++) {
@@ -1231,11 +2202,27 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
         std::string bucket_name = parts[1];
 
         char filter = '\0';
-        if (parts.size >= 3) {
+        if (parts.size() >= 3) {
             filter = parts[2][0];
         }
-        progress.reset(SIZE_MAX);
-#pragma omp parallel default(none) shared(par, torsiondbw, hdbw, cadbw, aadbw, mat, gcsPaths, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, client, bucket_name, filter, mappingWriter, hashToPathMapping) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel, inputFormat)
+        std::vector<std::string> objectNames;
+        for (auto&& object_metadata : client.ListObjects(bucket_name, gcs::Projection::NoAcl(), gcs::MaxResults(15000))) {
+            if (!object_metadata) {
+                Debug(Debug::ERROR) << "Cannot list bucket " << bucket_name << ": " << object_metadata.status().message() << "\n";
+                break;
+            }
+            std::string obj_name = object_metadata->name();
+            bool skipFilter = filter != '\0' && obj_name.length() >= 9 && obj_name[8] == filter;
+            bool allowedSuffix = Util::endsWith(".cif", obj_name) || Util::endsWith(".pdb", obj_name);
+            if (skipFilter && allowedSuffix) {
+                objectNames.push_back(obj_name);
+            }
+        }
+        progress.reset(objectNames.size());
+        // Every thread keeps up to --gcs-prefetch downloads in flight and parses the oldest one,
+        // so network transfers overlap with parsing instead of alternating with it.
+        size_t nextObject = 0;
+#pragma omp parallel default(none) shared(par, torsiondbw, hdbw, cadbw, aadbw, mat, progress, globalCnt, globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName, client, bucket_name, objectNames, nextObject, mappingWriter, hashToPathMapping, inputFormat) reduction(+:incorrectFiles, tooShort, notProtein, needToWriteModel)
         {
             StructureTo3Di structureTo3Di;
             PulchraWrapper pulchra;
@@ -1245,42 +2232,41 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
             std::vector<int8_t> camol;
             std::string header;
             std::string name;
-
-#pragma omp single
-            for (auto&& object_metadata : client.ListObjects(bucket_name, gcs::Projection::NoAcl(), gcs::MaxResults(15000))) {
-                std::string obj_name = object_metadata->name();
-#pragma omp task firstprivate(obj_name, alphabet3di, alphabetAA, camol, header, name, filter) private(structureTo3Di, pulchra, readStructure)
-                {
-                    bool skipFilter = filter != '\0' && obj_name.length() >= 9 && obj_name[8] == filter;
-                    bool allowedSuffix = Util::endsWith(".cif", obj_name) || Util::endsWith(".pdb", obj_name);
-                    if (skipFilter && allowedSuffix) {
-                        unsigned int thread_idx = 0;
+            unsigned int thread_idx = 0;
 #ifdef OPENMP
-                        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+            thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-                        progress.updateProgress();
-
-                        auto reader = client.ReadObject(bucket_name, obj_name);
-                        if (!reader.status().ok()) {
-                            Debug(Debug::ERROR) << reader.status().message() << "\n";
-                        } else {
-                            std::string contents{std::istreambuf_iterator<char>{reader}, {}};
-                            if (readStructure.loadFromBuffer(contents.c_str(), contents.size(), obj_name, inputFormat) == false) {
-                                incorrectFiles++;
-                            } else {
-                                __sync_add_and_fetch(&needToWriteModel, (readStructure.modelCount > 1));
-                                writeStructureEntry(
-                                    mat, readStructure, structureTo3Di,  pulchra,
-                                    alphabet3di, alphabetAA, camol, header, aadbw, hdbw, torsiondbw, cadbw,
-                                    par.chainNameMode, par.maskBfactorThreshold, tooShort, notProtein, globalCnt, thread_idx, par.coordStoreMode,
-                                    globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName,
-                                    mappingWriter,
-                                    hashToPathMapping,
-                                    obj_name
-                                );
-                            }
-                        }
+            std::deque<std::future<GcsObject>> inFlight;
+            while (true) {
+                while (inFlight.size() < static_cast<size_t>(par.gcsPrefetch)) {
+                    size_t objectIdx = __sync_fetch_and_add(&nextObject, 1);
+                    if (objectIdx >= objectNames.size()) {
+                        break;
                     }
+                    inFlight.push_back(std::async(std::launch::async, fetchGcsObject, client, bucket_name, objectNames[objectIdx]));
+                }
+                if (inFlight.empty()) {
+                    break;
+                }
+                GcsObject object = inFlight.front().get();
+                inFlight.pop_front();
+                progress.updateProgress();
+                if (object.ok == false) {
+                    continue;
+                }
+                if (readStructure.loadFromBuffer(object.contents.c_str(), object.contents.size(), object.name, inputFormat) == false) {
+                    incorrectFiles++;
+                } else {
+                    __sync_add_and_fetch(&needToWriteModel, (readStructure.modelCount > 1));
+                    writeStructureEntry(
+                        mat, readStructure, structureTo3Di,  pulchra,
+                        alphabet3di, alphabetAA, camol, header, aadbw, hdbw, torsiondbw, cadbw,
+                        par.chainNameMode, par.maskBfactorThreshold, tooShort, notProtein, globalCnt, thread_idx, par.coordStoreMode,
+                        globalFileidCnt, entrynameToFileId, filenameToFileId, fileIdToName,
+                        mappingWriter,
+                        hashToPathMapping,
+                        object.name
+                    );
                 }
             }
         }
@@ -1347,10 +2333,11 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
     }
 
     if (needsReorderingAtTheEnd) {
+        // Keys follow the entry names so that they do not depend on the order in which
+        // the threads finished. Only the indices are renumbered, the data files are written once.
         Debug(Debug::INFO) << "Reordering by identifier\n";
         DBReader<unsigned int> header_reorder((outputName+"_h").c_str(), (outputName+"_h.index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
         header_reorder.open(DBReader<unsigned int>::NOSORT);
-        header_reorder.readMmapedDataInMemory();
         std::vector<std::pair<std::string, unsigned int>> mappingOrder(header_reorder.getSize());
 #pragma omp parallel
         {
@@ -1368,10 +2355,15 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
                     filenameWithoutExtension = Util::remove_extension(Util::remove_extension(entryNameRaw));
                 }
                 mappingOrder[i].first = filenameWithoutExtension;
-                mappingOrder[i].second = i;
+                mappingOrder[i].second = header_reorder.getDbKey(i);
             }
         }
         SORT_PARALLEL(mappingOrder.begin(), mappingOrder.end());
+        std::vector<std::pair<unsigned int, unsigned int>> keyToId(mappingOrder.size());
+        for (size_t id = 0; id < mappingOrder.size(); id++) {
+            keyToId[id] = std::make_pair(mappingOrder[id].second, static_cast<unsigned int>(id));
+        }
+        SORT_PARALLEL(keyToId.begin(), keyToId.end());
         std::string lookupFile = outputName + ".lookup";
         FILE* file = FileUtil::openAndDelete(lookupFile.c_str(), "w");
         std::string buffer;
@@ -1393,49 +2385,14 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
             Debug(Debug::ERROR) << "Cannot close lookup file " << lookupFile << "\n";
             EXIT(EXIT_FAILURE);
         }
-
-        DBWriter hdbw_reorder((outputName+"_h").c_str(), (outputName+"_h.index").c_str(), static_cast<unsigned int>(par.threads), par.compressed, Parameters::DBTYPE_GENERIC_DB);
-        hdbw_reorder.open();
-        sortDatafileByIdOrder(hdbw_reorder, header_reorder, mappingOrder);
-        hdbw_reorder.close(true);
         header_reorder.close();
 
-        DBReader<unsigned int> torsiondbr_reorder((outputName+"_ss").c_str(), (outputName+"_ss.index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
-        torsiondbr_reorder.open(DBReader<unsigned int>::NOSORT);
-        torsiondbr_reorder.readMmapedDataInMemory();
-        DBWriter torsiondbw_reorder((outputName+"_ss").c_str(), (outputName+"_ss.index").c_str(), static_cast<unsigned int>(par.threads), par.compressed, Parameters::DBTYPE_AMINO_ACIDS);
-        torsiondbw_reorder.open();
-        sortDatafileByIdOrder(torsiondbw_reorder, torsiondbr_reorder, mappingOrder);
-        torsiondbw_reorder.close(true);
-        torsiondbr_reorder.close();
-
-        DBReader<unsigned int> cadbr_reorder((outputName+"_ca").c_str(), (outputName+"_ca.index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
-        cadbr_reorder.open(DBReader<unsigned int>::NOSORT);
-        cadbr_reorder.readMmapedDataInMemory();
-        DBWriter cadbw_reorder((outputName+"_ca").c_str(), (outputName+"_ca.index").c_str(), static_cast<unsigned int>(par.threads), par.compressed, LocalParameters::DBTYPE_CA_ALPHA);
-        cadbw_reorder.open();
-        sortDatafileByIdOrder(cadbw_reorder, cadbr_reorder, mappingOrder);
-        cadbw_reorder.close(true);
-        cadbr_reorder.close();
-
-        DBReader<unsigned int> aadbr_reorder((outputName).c_str(), (outputName+".index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
-        aadbr_reorder.open(DBReader<unsigned int>::NOSORT);
-        aadbr_reorder.readMmapedDataInMemory();
-        DBWriter aadbw_reorder((outputName).c_str(), (outputName+".index").c_str(), static_cast<unsigned int>(par.threads), par.compressed, Parameters::DBTYPE_AMINO_ACIDS);
-        aadbw_reorder.open();
-        sortDatafileByIdOrder(aadbw_reorder, aadbr_reorder, mappingOrder);
-        aadbw_reorder.close(true);
-        aadbr_reorder.close();
-
+        renumberIndexByIdOrder(outputName+"_h", outputName+"_h.index", keyToId);
+        renumberIndexByIdOrder(outputName+"_ss", outputName+"_ss.index", keyToId);
+        renumberIndexByIdOrder(outputName+"_ca", outputName+"_ca.index", keyToId);
+        renumberIndexByIdOrder(outputName, outputName+".index", keyToId);
         if (par.writeMapping) {
-            DBReader<unsigned int> mappingReader_reorder((outputName+"_mapping_tmp").c_str(), (outputName+"_mapping_tmp.index").c_str(), par.threads, DBReader<unsigned int>::USE_INDEX|DBReader<unsigned int>::USE_DATA);
-            mappingReader_reorder.open(DBReader<unsigned int>::NOSORT);
-            mappingReader_reorder.readMmapedDataInMemory();
-            DBWriter mappingWriter_reorder((outputName+"_mapping_tmp").c_str(), (outputName+"_mapping_tmp.index").c_str(), static_cast<unsigned int>(par.threads), par.compressed, LocalParameters::DBTYPE_CA_ALPHA);
-            mappingWriter_reorder.open();
-            sortDatafileByIdOrder(mappingWriter_reorder, mappingReader_reorder, mappingOrder);
-            mappingWriter_reorder.close(true);
-            mappingReader_reorder.close();
+            renumberIndexByIdOrder(outputName+"_mapping_tmp", outputName+"_mapping_tmp.index", keyToId);
         }
     } else {
         DBWriter::createRenumberedDB((outputName+"_ss").c_str(), (outputName+"_ss.index").c_str(), "", "", DBReader<unsigned int>::LINEAR_ACCCESS);
@@ -1553,6 +2510,9 @@ int structcreatedb(int argc, const char **argv, const Command& command) {
             EXIT(EXIT_FAILURE);
         }
         readerHeader.close();
+        // multimer commands read the complexes from the binary copy of the lookup
+        ComplexLookup::createIndex(outputName);
+        ComplexSymmetry::createIndex(outputName, par.threads);
     }
 
     // Write path mapping file when hash-entry-names mode is enabled
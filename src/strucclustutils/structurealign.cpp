@@ -12,6 +12,12 @@
 #include "TMaligner.h"
 #include "Coordinate16.h"
 #include "LDDT.h"
+#include "QueryMatcher.h"
+#include "StructureAlignStages.h"
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 #ifdef OPENMP
 #include <omp.h>
@@ -29,6 +35,120 @@ static bool compareHitsByStructureBits(const Matcher::result_t &first, const Mat
 }
 
 
+// targets longer than this are not packed into the inter-sequence kernel
+static const int32_t BATCH_MAX_TARGET_LEN = 1024;
+
+// per-thread counts of where the hits of alignStructureResults end up, summed and reported at the end
+struct AlignStats {
+    size_t hits;
+    size_t coverageRejected;
+    size_t boundRejected;
+    size_t evalueRejected;
+    size_t reverseEvalueRejected;
+    size_t criteriaRejected;
+    size_t blockAlignFallbacks;
+    size_t tmScoreBoundRejected;
+    size_t tmScoreEvaluated;
+    size_t tmScoreRejected;
+    size_t lddtEvaluated;
+    size_t lddtRejected;
+    size_t accepted;
+
+    AlignStats() : hits(0), coverageRejected(0), boundRejected(0), evalueRejected(0), reverseEvalueRejected(0),
+                   criteriaRejected(0), blockAlignFallbacks(0), tmScoreBoundRejected(0), tmScoreEvaluated(0), tmScoreRejected(0),
+                   lddtEvaluated(0), lddtRejected(0), accepted(0) {}
+
+    void add(const AlignStats &other) {
+        hits += other.hits;
+        coverageRejected += other.coverageRejected;
+        boundRejected += other.boundRejected;
+        evalueRejected += other.evalueRejected;
+        reverseEvalueRejected += other.reverseEvalueRejected;
+        criteriaRejected += other.criteriaRejected;
+        blockAlignFallbacks += other.blockAlignFallbacks;
+        tmScoreBoundRejected += other.tmScoreBoundRejected;
+        tmScoreEvaluated += other.tmScoreEvaluated;
+        tmScoreRejected += other.tmScoreRejected;
+        lddtEvaluated += other.lddtEvaluated;
+        lddtRejected += other.lddtRejected;
+        accepted += other.accepted;
+    }
+};
+
+// Page cache use of the mmapped DB components and page faults of the process during one alignment stage, reported
+// with --db-load-mode 2 to see which component has to be read from disk. Residency is sampled with mincore.
+class MmapUsage {
+public:
+    void add(const char *name, IndexReader *reader) {
+        if (reader == NULL) {
+            return;
+        }
+        Component component;
+        component.name = name;
+        component.reader = reader->sequenceReader;
+        component.residentBefore = residentBytes(component.reader);
+        components.push_back(component);
+    }
+
+    void start() {
+        getrusage(RUSAGE_SELF, &before);
+    }
+
+    void report() {
+        struct rusage after;
+        getrusage(RUSAGE_SELF, &after);
+        for (size_t i = 0; i < components.size(); i++) {
+            const Component &c = components[i];
+            Debug(Debug::INFO) << "Resident " << c.name << ": " << c.residentBefore / (1024 * 1024) << " MB before, "
+                               << residentBytes(c.reader) / (1024 * 1024) << " MB after of "
+                               << c.reader->getTotalDataSize() / (1024 * 1024) << " MB\n";
+        }
+        Debug(Debug::INFO) << "Page faults: " << (after.ru_majflt - before.ru_majflt) << " major, "
+                           << (after.ru_minflt - before.ru_minflt) << " minor\n";
+    }
+
+private:
+    struct Component {
+        const char *name;
+        DBReader<unsigned int> *reader;
+        size_t residentBefore;
+    };
+
+    static size_t residentBytes(DBReader<unsigned int> *reader) {
+        const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        // at most 1 GB of pages per mincore call
+        const size_t chunkPages = 262144;
+#ifdef __APPLE__
+        std::vector<char> pages(chunkPages);
+#else
+        std::vector<unsigned char> pages(chunkPages);
+#endif
+        size_t resident = 0;
+        for (size_t file = 0; file < reader->getDataFileCnt(); file++) {
+            char *data = reader->getDataForFile(file);
+            if (data == NULL) {
+                continue;
+            }
+            const uintptr_t start = reinterpret_cast<uintptr_t>(data) / pageSize * pageSize;
+            const uintptr_t end = reinterpret_cast<uintptr_t>(data) + reader->getDataSizeForFile(file);
+            for (uintptr_t chunk = start; chunk < end; chunk += chunkPages * pageSize) {
+                const size_t length = std::min(static_cast<size_t>(end - chunk), chunkPages * pageSize);
+                if (mincore(reinterpret_cast<void *>(chunk), length, pages.data()) != 0) {
+                    break;
+                }
+                const size_t count = (length + pageSize - 1) / pageSize;
+                for (size_t i = 0; i < count; i++) {
+                    resident += (pages[i] & 1) * pageSize;
+                }
+            }
+        }
+        return resident;
+    }
+
+    std::vector<Component> components;
+    struct rusage before;
+};
+
 static void structureAlignDefault(LocalParameters & par) {
     par.compBiasCorrectionScale = 0.5;
     par.alignmentType = LocalParameters::ALIGNMENT_TYPE_3DI_AA;
@@ -37,44 +157,64 @@ static void structureAlignDefault(LocalParameters & par) {
 int alignStructure(StructureSmithWaterman & structureSmithWaterman,
                    StructureSmithWaterman & reverseStructureSmithWaterman,
                    Sequence & tSeqAA, Sequence & tSeq3Di,
-                   unsigned int querySeqLen, unsigned int targetSeqLen,
-                   EvalueNeuralNet & evaluer, std::pair<double, double> muLambda,
+                   unsigned int querySeqLen, unsigned int targetSeqLen, int diagonal,
+                   EvalueNeuralNet & evaluer, std::pair<double, double> muLambda, uint32_t minScore,
                    Matcher::result_t & res, std::string & backtrace,
-                   Parameters & par) {
+                   LocalParameters & par, AlignStats & stats) {
 
     float seqId = 0.0;
     backtrace.clear();
-    // align only score and end pos
-    StructureSmithWaterman::s_align align = structureSmithWaterman.alignScoreEndPos<StructureSmithWaterman::PROFILE>(tSeqAA.numSequence, tSeq3Di.numSequence, targetSeqLen, par.gapOpen.values.aminoacid(),
-                                                                                    par.gapExtend.values.aminoacid(), querySeqLen / 2);
+    uint32_t revScore = 0;
+    StructureSmithWaterman::s_align align;
+    // align around the prefilter diagonal first. The reversed query is still scored over the full matrix,
+    // the e-value net was calibrated on full reverse scores and its rows do not map onto the forward band
+    bool isBanded = false;
+    if (par.diagonalBand > 0 && diagonal != INT_MAX && structureSmithWaterman.isProfileSearch() == false) {
+        bool touchesBand = false;
+        align = structureSmithWaterman.alignBanded(tSeqAA.numSequence, tSeq3Di.numSequence, targetSeqLen,
+                                                   par.gapOpen.values.aminoacid(), par.gapExtend.values.aminoacid(),
+                                                   diagonal, par.diagonalBand, true, backtrace, touchesBand);
+        if (touchesBand == false) {
+            revScore = reverseStructureSmithWaterman.alignScoreEndPos<StructureSmithWaterman::PROFILE>(tSeqAA.numSequence, tSeq3Di.numSequence, targetSeqLen,
+                                                                                                       par.gapOpen.values.aminoacid(), par.gapExtend.values.aminoacid(),
+                                                                                                       querySeqLen / 2).score1;
+            isBanded = true;
+        } else {
+            backtrace.clear();
+        }
+    }
+    if (isBanded == false) {
+        // align only score and end pos, the reversed query is scored in the same pass over the target
+        // forward scores below minScore fail the e-value check below, so the pass may stop once it cannot reach it.
+        // Hits that fail the forward check therefore only pay for the reverse columns before that point, this is
+        // also faster than a forward pass followed by a reverse pass for the hits that pass it
+        align = structureSmithWaterman.alignScoreEndPosFused<StructureSmithWaterman::PROFILE>(reverseStructureSmithWaterman,
+                                                                                            tSeqAA.numSequence, tSeq3Di.numSequence, targetSeqLen, par.gapOpen.values.aminoacid(),
+                                                                                            par.gapExtend.values.aminoacid(), querySeqLen / 2, revScore, minScore);
+    }
     bool hasLowerCoverage = !(Util::hasCoverage(par.covThr, par.covMode, align.qCov, align.tCov));
     if(hasLowerCoverage){
+        stats.coverageRejected++;
         return -1;
     }
     // we can already stop if this e-value isn't good enough, it wont be any better in the next step
     align.evalue = evaluer.computeEvalueCorr(align.score1, muLambda.first, muLambda.second);
     bool hasLowerEvalue = align.evalue > par.evalThr;
     if(hasLowerEvalue){
+        stats.evalueRejected++;
         return -1;
     }
 
-    StructureSmithWaterman::s_align revAlign;
-    //if(structureSmithWaterman.isProfileSearch()){
-    //    revAlign.score1 = 0;
-    //} else {
-    revAlign = reverseStructureSmithWaterman.alignScoreEndPos<StructureSmithWaterman::PROFILE>(tSeqAA.numSequence, tSeq3Di.numSequence,
-                                                                  targetSeqLen, par.gapOpen.values.aminoacid(),
-                                                                  par.gapExtend.values.aminoacid(), querySeqLen / 2);
-    //}
-    int32_t score = static_cast<int32_t>(align.score1) - static_cast<int32_t>(revAlign.score1);
+    int32_t score = static_cast<int32_t>(align.score1) - static_cast<int32_t>(revScore);
     align.evalue = evaluer.computeEvalueCorr(score, muLambda.first, muLambda.second);
     hasLowerEvalue = align.evalue > par.evalThr;
     if (hasLowerEvalue) {
+        stats.reverseEvalueRejected++;
         return -1;
     }
 
     bool blockAlignFailed = false;
-    if (structureSmithWaterman.isProfileSearch() == false) {
+    if (isBanded == false && structureSmithWaterman.isProfileSearch() == false) {
         StructureSmithWaterman::s_align alignTmp = structureSmithWaterman.alignStartPosBacktraceBlock(
             tSeqAA.numSequence, tSeq3Di.numSequence, targetSeqLen, par.gapOpen.values.aminoacid(),
             par.gapExtend.values.aminoacid(), backtrace, align
@@ -83,12 +223,13 @@ int alignStructure(StructureSmithWaterman & structureSmithWaterman,
         if (align.score1 == UINT32_MAX) {
             Debug(Debug::WARNING) << "block-align failed, falling back to normal alignment\n";
             blockAlignFailed = true;
+            stats.blockAlignFallbacks++;
         } else {
             align = alignTmp;
         }
     }
 
-    if (blockAlignFailed || structureSmithWaterman.isProfileSearch()) {
+    if (isBanded == false && (blockAlignFailed || structureSmithWaterman.isProfileSearch())) {
         align = structureSmithWaterman.alignStartPosBacktrace<StructureSmithWaterman::PROFILE>(tSeqAA.numSequence,
                                                                                                tSeq3Di.numSequence,
                                                                                                targetSeqLen,
@@ -115,10 +256,10 @@ int alignStructure(StructureSmithWaterman & structureSmithWaterman,
 int computeAlternativeAlignment(StructureSmithWaterman & structureSmithWaterman,
                                 StructureSmithWaterman & reverseStructureSmithWaterman,
                                 Sequence & tSeqAA, Sequence & tSeq3Di,
-                                unsigned int querySeqLen, unsigned int targetSeqLen,
-                                EvalueNeuralNet & evaluer, std::pair<double, double> muLambda,
+                                unsigned int querySeqLen, unsigned int targetSeqLen, int diagonal,
+                                EvalueNeuralNet & evaluer, std::pair<double, double> muLambda, uint32_t minScore,
                                 Matcher::result_t & result, Matcher::result_t & altRes,
-                                std::string & backtrace, Parameters & par) {
+                                std::string & backtrace, LocalParameters & par, AlignStats & stats) {
     const unsigned char xAAIndex = tSeqAA.subMat->aa2num[static_cast<int>('X')];
     const unsigned char x3DiIndex = tSeq3Di.subMat->aa2num[static_cast<int>('X')];
     for (int pos = result.dbStartPos; pos < result.dbEndPos; ++pos) {
@@ -126,8 +267,8 @@ int computeAlternativeAlignment(StructureSmithWaterman & structureSmithWaterman,
         tSeq3Di.numSequence[pos] = x3DiIndex;
     }
     if (alignStructure(structureSmithWaterman, reverseStructureSmithWaterman,
-                       tSeqAA, tSeq3Di, querySeqLen, targetSeqLen,
-                       evaluer, muLambda, altRes, backtrace, par) == -1) {
+                       tSeqAA, tSeq3Di, querySeqLen, targetSeqLen, diagonal,
+                       evaluer, muLambda, minScore, altRes, backtrace, par, stats) == -1) {
         return -1;
     }
     if (Alignment::checkCriteria(altRes, false, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
@@ -138,16 +279,11 @@ int computeAlternativeAlignment(StructureSmithWaterman & structureSmithWaterman,
 }
 
 
-int structurealign(int argc, const char **argv, const Command& command) {
-    LocalParameters &par = LocalParameters::getLocalInstance();
-    structureAlignDefault(par);
-    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
-
+void alignStructureResults(LocalParameters &par, DBReader<unsigned int> &resultReader, size_t dbFrom, size_t dbSize, bool alignmentIsExtended,
+                           const StructureResultWriter &writer, const StructureAlignmentGate *gate) {
     const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
 
     bool sameDB = false;
-    uint16_t extended = DBReader<unsigned int>::getExtendedDbtype(FileUtil::parseDbType(par.db3.c_str()));
-    bool alignmentIsExtended = extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC;
     IndexReader tAADbr(par.db2, par.threads,
                              alignmentIsExtended ? IndexReader::SRC_SEQUENCES : IndexReader::SEQUENCES,
                              (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
@@ -196,16 +332,6 @@ int structurealign(int argc, const char **argv, const Command& command) {
         }
     }
 
-    DBReader<unsigned int> resultReader(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
-    resultReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
-
-    int dbtype =  Parameters::DBTYPE_ALIGNMENT_RES;
-    if(alignmentIsExtended){
-        dbtype = DBReader<unsigned int>::setExtendedDbtype(dbtype, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
-    }
-    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed,  dbtype);
-    dbw.open();
-
     bool needTMaligner = (par.tmScoreThr > 0);
     bool needLDDT = (par.lddtThr > 0);
     if (par.sortByStructureBits) {
@@ -263,8 +389,10 @@ int structurealign(int argc, const char **argv, const Command& command) {
     }
     float aaFactor = (par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA) ? 1.4 : 0.0;
     SubstitutionMatrix subMatAA(blosum.c_str(), aaFactor, par.scoreBias);
+    const size_t entryCount = (gate != NULL) ? gate->order.size() : dbSize;
+    const size_t batchEntries = std::max((gate != NULL) ? gate->batchSize : entryCount, (size_t) 1);
     //temporary output file
-    Debug::Progress progress(resultReader.getSize());
+    Debug::Progress progress(entryCount);
 
     // sub. mat needed for query profile
     int8_t * tinySubMatAA = (int8_t*) mem_align(ALIGN_INT, subMatAA.alphabetSize * 32);
@@ -281,6 +409,35 @@ int structurealign(int argc, const char **argv, const Command& command) {
         }
     }
 
+    AlignStats totalStats;
+    std::vector<size_t> costOrder;
+    if (gate == NULL && par.queryCostOrder) {
+        costOrder = orderQueriesByCost(resultReader, dbFrom, dbSize, *q3DiDbr->sequenceReader);
+    }
+    // the aligners only need to fit the longest query and target instead of --max-seq-len
+    const size_t alignerLen = std::min(static_cast<size_t>(par.maxSeqLen),
+                                       static_cast<size_t>(std::max(std::max(qAADbr->sequenceReader->getMaxSeqLen(), q3DiDbr->sequenceReader->getMaxSeqLen()),
+                                                                    std::max(tAADbr.sequenceReader->getMaxSeqLen(), t3DiDbr.sequenceReader->getMaxSeqLen())) + 1));
+    // mu/lambda of all queries are predicted up front in batches of the e-value network
+    std::vector<std::pair<double, double>> queryMuLambda = EvalueNeuralNet::predictQueries(resultReader, *q3DiDbr->sequenceReader, q3DiDbr->getDbtype(), &subMat3Di,
+                                                                                           tAADbr.sequenceReader->getAminoAcidDBSize(), par.maxSeqLen, par.compBiasCorrection,
+                                                                                           EvalueNeuralNet::muLambdaDbName(par.db1));
+
+    MmapUsage mmapUsage;
+    if (touch == false) {
+        mmapUsage.add("target AA", &tAADbr);
+        mmapUsage.add("target 3Di", &t3DiDbr);
+        if (sameDB == false) {
+            mmapUsage.add("query AA", qAADbr);
+            mmapUsage.add("query 3Di", q3DiDbr);
+        }
+        mmapUsage.add("query C-alpha", qcadbr);
+        if (tcadbr != qcadbr) {
+            mmapUsage.add("target C-alpha", tcadbr);
+        }
+        mmapUsage.start();
+    }
+
 #pragma omp parallel
     {
         unsigned int thread_idx = 0;
@@ -288,9 +445,10 @@ int structurealign(int argc, const char **argv, const Command& command) {
         thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
         EvalueNeuralNet evaluer(tAADbr.sequenceReader->getAminoAcidDBSize(), &subMat3Di);
+        AlignStats stats;
         std::vector<Matcher::result_t> alignmentResult;
-        StructureSmithWaterman structureSmithWaterman(par.maxSeqLen, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, &subMatAA, &subMat3Di);
-        StructureSmithWaterman reverseStructureSmithWaterman(par.maxSeqLen, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, &subMatAA, &subMat3Di);
+        StructureSmithWaterman structureSmithWaterman(alignerLen, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, &subMatAA, &subMat3Di);
+        StructureSmithWaterman reverseStructureSmithWaterman(alignerLen, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, &subMatAA, &subMat3Di);
         TMaligner *tmaligner = NULL;
         if(needTMaligner) {
             tmaligner = new TMaligner(
@@ -305,6 +463,7 @@ int structurealign(int argc, const char **argv, const Command& command) {
         Sequence tSeqAA(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
         Sequence tSeq3Di(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
         std::string backtrace;
+        const char *words[10];
         char buffer[1024+32768];
         std::string resultBuffer;
 
@@ -313,143 +472,306 @@ int structurealign(int argc, const char **argv, const Command& command) {
 
         TMaligner::TMscoreResult tmres;
         LDDTCalculator::LDDTScoreResult lddtres;
+
+        // prefilter hits of the current query and the batched score upper bound of each hit
+        const size_t batchSize = StructureSmithWaterman::getBatchSize();
+        std::vector<unsigned int> hitKeys;
+        // prefilter diagonal of each hit, INT_MAX if the input has none
+        std::vector<int> hitDiagonals;
+        std::vector<unsigned int> decidedKeys;
+        // data offset and prefilter position of each hit to align the hits in target order
+        std::vector<std::pair<size_t, size_t>> hitOrder;
+        std::vector<unsigned int> prefilterKeys;
+        std::vector<int> prefilterDiagonals;
+        std::vector<int> decidedDiagonals;
+        std::vector<uint32_t> hitScoreBounds;
+        std::vector<std::vector<unsigned char>> batchAA(batchSize);
+        std::vector<std::vector<unsigned char>> batch3Di(batchSize);
+        std::vector<const unsigned char *> batchAAPtr(batchSize);
+        std::vector<const unsigned char *> batch3DiPtr(batchSize);
+        std::vector<int32_t> batchLengths(batchSize);
+        std::vector<size_t> batchHitIdx(batchSize);
+        std::vector<uint32_t> batchScores(batchSize);
         // write output file
 
+        for (size_t batchStart = 0; batchStart < entryCount; batchStart += batchEntries) {
+            const size_t batchEnd = std::min(entryCount, batchStart + batchEntries);
 #pragma omp for schedule(dynamic, 1)
-        for (size_t id = 0; id < resultReader.getSize(); id++) {
-            progress.updateProgress();
-            char *data = resultReader.getData(id, thread_idx);
-            size_t queryKey = resultReader.getDbKey(id);
-            if(*data != '\0') {
-                unsigned int queryId = q3DiDbr->sequenceReader->getId(queryKey);
-
-                char *querySeqAA = qAADbr->sequenceReader->getData(queryId, thread_idx);
-                char *querySeq3Di = q3DiDbr->sequenceReader->getData(queryId, thread_idx);
-                unsigned int querySeqLen = q3DiDbr->sequenceReader->getSeqLen(queryId);
-                qSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
-                qSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
-                if(needCalpha){
-                    size_t qId = qcadbr->sequenceReader->getId(queryKey);
-                    char *qcadata = qcadbr->sequenceReader->getData(qId, thread_idx);
-                    size_t qCaLength = qcadbr->sequenceReader->getEntryLen(qId);
-                    float* queryCaData = qcoords.read(qcadata, qSeq3Di.L, qCaLength);
-                    if(needTMaligner){
-                        tmaligner->initQuery(queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L], NULL, qSeq3Di.L);
+            for (size_t entry = batchStart; entry < batchEnd; entry++) {
+                progress.updateProgress();
+                size_t id = dbFrom + entry;
+                if (gate != NULL) {
+                    id = gate->order[entry];
+                } else if (costOrder.empty() == false) {
+                    id = costOrder[entry];
+                }
+                char *data = resultReader.getData(id, thread_idx);
+                size_t queryKey = resultReader.getDbKey(id);
+                if(*data != '\0' && (gate == NULL || gate->isQueryNeeded(queryKey))) {
+                    unsigned int queryId = q3DiDbr->sequenceReader->getId(queryKey);
+
+                    char *querySeqAA = qAADbr->sequenceReader->getData(queryId, thread_idx);
+                    char *querySeq3Di = q3DiDbr->sequenceReader->getData(queryId, thread_idx);
+                    unsigned int querySeqLen = q3DiDbr->sequenceReader->getSeqLen(queryId);
+                    qSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
+                    qSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
+                    if(needCalpha){
+                        size_t qId = qcadbr->sequenceReader->getId(queryKey);
+                        char *qcadata = qcadbr->sequenceReader->getData(qId, thread_idx);
+                        size_t qCaLength = qcadbr->sequenceReader->getEntryLen(qId);
+                        float* queryCaData = qcoords.read(qcadata, qSeq3Di.L, qCaLength);
+                        if(needTMaligner){
+                            tmaligner->initQuery(queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L], NULL, qSeq3Di.L);
+                        }
+                        if(needLDDT){
+                            lddtcalculator->initQuery(qSeq3Di.L, queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L]);
+                        }
                     }
-                    if(needLDDT){
-                        lddtcalculator->initQuery(qSeq3Di.L, queryCaData, &queryCaData[qSeq3Di.L], &queryCaData[qSeq3Di.L+qSeq3Di.L]);
+                    std::pair<double, double> muLambda = queryMuLambda[id];
+                    // raw score bound of the forward e-value check, one below the exact bound to stay clear of rounding
+                    uint32_t minScore = 0;
+                    if (muLambda.first > 0.0) {
+                        minScore = evaluer.computeMinScoreCorr(par.evalThr, muLambda.first, muLambda.second, UINT16_MAX);
+                        minScore = (minScore > 0) ? minScore - 1 : 0;
                     }
-                }
-                std::pair<double, double> muLambda = evaluer.predictMuLambda(qSeq3Di.numSequence, qSeq3Di.L);
-                structureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
-                qSeq3Di.reverse();
-                qSeqAA.reverse();
-                reverseStructureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
-                int passedNum = 0;
-                int rejected = 0;
-                while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
-                    char dbKeyBuffer[255 + 1];
-                    Util::parseKey(data, dbKeyBuffer);
-                    data = Util::skipLine(data);
-                    const unsigned int dbKey = (unsigned int) strtoul(dbKeyBuffer, NULL, 10);
-                    unsigned int targetId = t3DiDbr.sequenceReader->getId(dbKey);
-                    const bool isIdentity = (queryId == targetId && (par.includeIdentity || sameDB))? true : false;
-
-                    char * targetSeq3Di = t3DiDbr.sequenceReader->getData(targetId, thread_idx);
-                    char * targetSeqAA = tAADbr.sequenceReader->getData(targetId, thread_idx);
-                    const int targetSeqLen = static_cast<int>(t3DiDbr.sequenceReader->getSeqLen(targetId));
-
-                    tSeq3Di.mapSequence(targetId, dbKey, targetSeq3Di, targetSeqLen);
-                    tSeqAA.mapSequence(targetId, dbKey, targetSeqAA, targetSeqLen);
-                    if(Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, targetSeqLen) == false){
-                        rejected++;
-                        continue;
+                    structureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+                    qSeq3Di.reverse();
+                    qSeqAA.reverse();
+                    reverseStructureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+                    structureSmithWaterman.initFusedProfile(reverseStructureSmithWaterman);
+                    hitKeys.clear();
+                    hitDiagonals.clear();
+                    while (*data != '\0') {
+                        char dbKeyBuffer[255 + 1];
+                        Util::parseKey(data, dbKeyBuffer);
+                        int diagonal = INT_MAX;
+                        if (par.diagonalBand > 0 && Util::getWordsOfLine(data, words, 10) == 3) {
+                            hit_t hit = QueryMatcher::parsePrefilterHit(data);
+                            diagonal = static_cast<short>(hit.diagonal);
+                        }
+                        data = Util::skipLine(data);
+                        hitKeys.push_back((unsigned int) strtoul(dbKeyBuffer, NULL, 10));
+                        hitDiagonals.push_back(diagonal);
                     }
-                    Matcher::result_t res;
-                    if(alignStructure(structureSmithWaterman, reverseStructureSmithWaterman,
-                                      tSeqAA, tSeq3Di, querySeqLen, targetSeqLen,
-                                      evaluer, muLambda, res, backtrace, par) == -1){
-                        rejected++;
-                        continue;
+                    size_t decidedFrom = hitKeys.size();
+                    if (gate != NULL) {
+                        decidedKeys.clear();
+                        decidedDiagonals.clear();
+                        size_t undecided = 0;
+                        for (size_t hitIdx = 0; hitIdx < hitKeys.size(); hitIdx++) {
+                            if (gate->isTargetDecided(hitKeys[hitIdx])) {
+                                decidedKeys.push_back(hitKeys[hitIdx]);
+                                decidedDiagonals.push_back(hitDiagonals[hitIdx]);
+                            } else {
+                                hitKeys[undecided] = hitKeys[hitIdx];
+                                hitDiagonals[undecided] = hitDiagonals[hitIdx];
+                                undecided++;
+                            }
+                        }
+                        std::copy(decidedKeys.begin(), decidedKeys.end(), hitKeys.begin() + undecided);
+                        std::copy(decidedDiagonals.begin(), decidedDiagonals.end(), hitDiagonals.begin() + undecided);
+                        decidedFrom = undecided;
+                    } else if (par.targetOrder && hitKeys.size() > 1
+                               && static_cast<size_t>(par.maxAccept) >= hitKeys.size() && static_cast<size_t>(par.maxRejected) >= hitKeys.size()) {
+                        // every hit is aligned, so the order only decides how the target data is read
+                        hitOrder.clear();
+                        for (size_t hitIdx = 0; hitIdx < hitKeys.size(); hitIdx++) {
+                            const size_t targetId = t3DiDbr.sequenceReader->getId(hitKeys[hitIdx]);
+                            hitOrder.emplace_back(t3DiDbr.sequenceReader->getOffset(targetId), hitIdx);
+                        }
+                        std::sort(hitOrder.begin(), hitOrder.end());
+                        prefilterKeys.assign(hitKeys.begin(), hitKeys.end());
+                        prefilterDiagonals.assign(hitDiagonals.begin(), hitDiagonals.end());
+                        for (size_t hitIdx = 0; hitIdx < hitOrder.size(); hitIdx++) {
+                            hitKeys[hitIdx] = prefilterKeys[hitOrder[hitIdx].second];
+                            hitDiagonals[hitIdx] = prefilterDiagonals[hitOrder[hitIdx].second];
+                        }
                     }
-
-                    if (Alignment::checkCriteria(res, isIdentity, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
-                        if(needCalpha) {
-                            size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
-                            char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
-                            size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
-                            float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
-                            if(needTMaligner) {
-                                tmres = tmaligner->computeTMscore(targetCaData,
-                                                                  &targetCaData[res.dbLen],
-                                                                  &targetCaData[res.dbLen +
-                                                                                res.dbLen],
-                                                                  res.dbLen,
-                                                                  res.qStartPos,
-                                                                  res.dbStartPos,
-                                                                  res.backtrace,
-                                                                  TMaligner::normalization(par.tmScoreThrMode, std::min(res.qEndPos - res.qStartPos, res.dbEndPos - res.dbStartPos ), res.qLen, res.dbLen));
-
-                                if (tmres.tmscore < par.tmScoreThr) {
+                    hitScoreBounds.assign(hitKeys.size(), UINT32_MAX);
+                    // the inter-sequence kernel only handles substitution matrix scoring and
+                    // its score can only be turned into an e-value bound for a positive lambda
+                    const bool useBatch = par.batchScore && structureSmithWaterman.isProfileSearch() == false && muLambda.first > 0.0;
+                    size_t batchedUpTo = 0;
+                    int passedNum = 0;
+                    int rejected = 0;
+                    for (size_t hitIdx = 0; hitIdx < hitKeys.size() && passedNum < par.maxAccept && rejected < par.maxRejected; hitIdx++) {
+                        if (hitIdx >= decidedFrom && passedNum >= gate->minAcceptedHits) {
+                            break;
+                        }
+                        if (useBatch && hitIdx >= batchedUpTo) {
+                            // collect the next short targets and score them together. The score is the unbanded forward
+                            // score, so it bounds the score of alignStructure. Long targets only waste lanes and stay on
+                            // the per-target path.
+                            // Every visited hit raises the accepted or the rejected count by at most one, so only hits
+                            // within the remaining --max-accept/--max-rejected budget are certainly visited
+                            size_t lookAheadEnd = std::min(hitKeys.size(), hitIdx + 4 * batchSize);
+                            size_t budget = static_cast<size_t>(std::min(par.maxAccept - passedNum, par.maxRejected - rejected));
+                            if (gate != NULL) {
+                                if (hitIdx < decidedFrom) {
+                                    lookAheadEnd = std::min(lookAheadEnd, decidedFrom);
+                                } else {
+                                    budget = std::min(budget, static_cast<size_t>(gate->minAcceptedHits - passedNum));
+                                }
+                            }
+                            lookAheadEnd = std::min(lookAheadEnd, hitIdx + budget);
+                            size_t batchCnt = 0;
+                            size_t k = hitIdx;
+                            for (; k < lookAheadEnd && batchCnt < batchSize; k++) {
+                                unsigned int batchTargetId = t3DiDbr.sequenceReader->getId(hitKeys[k]);
+                                const int32_t batchTargetLen = static_cast<int32_t>(t3DiDbr.sequenceReader->getSeqLen(batchTargetId));
+                                if (batchTargetLen > BATCH_MAX_TARGET_LEN) {
                                     continue;
                                 }
+                                // rejected by the coverage check before the batch score is used
+                                if (Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, batchTargetLen) == false) {
+                                    continue;
+                                }
+                                const char *batchSeqAA = tAADbr.sequenceReader->getData(batchTargetId, thread_idx);
+                                const char *batchSeq3Di = t3DiDbr.sequenceReader->getData(batchTargetId, thread_idx);
+                                batchAA[batchCnt].resize(batchTargetLen);
+                                batch3Di[batchCnt].resize(batchTargetLen);
+                                for (int32_t pos = 0; pos < batchTargetLen; pos++) {
+                                    batchAA[batchCnt][pos] = subMatAA.aa2num[static_cast<unsigned char>(batchSeqAA[pos])];
+                                    batch3Di[batchCnt][pos] = subMat3Di.aa2num[static_cast<unsigned char>(batchSeq3Di[pos])];
+                                }
+                                batchAAPtr[batchCnt] = batchAA[batchCnt].data();
+                                batch3DiPtr[batchCnt] = batch3Di[batchCnt].data();
+                                batchLengths[batchCnt] = batchTargetLen;
+                                batchHitIdx[batchCnt] = k;
+                                batchCnt++;
                             }
-                            if(needLDDT){
-                                lddtres = lddtcalculator->computeLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos,
-                                                                           res.backtrace,
-                                                                           targetCaData, &targetCaData[res.dbLen],
-                                                                           &targetCaData[res.dbLen+res.dbLen]);
+                            batchedUpTo = k;
+                            if (batchCnt > 0) {
+                                structureSmithWaterman.alignScoreBatch(batchAAPtr.data(), batch3DiPtr.data(), batchLengths.data(), batchCnt,
+                                                                       par.gapOpen.values.aminoacid(), par.gapExtend.values.aminoacid(), batchScores.data());
+                                for (size_t b = 0; b < batchCnt; b++) {
+                                    hitScoreBounds[batchHitIdx[b]] = batchScores[b];
+                                }
+                            }
+                        }
+                        const unsigned int dbKey = hitKeys[hitIdx];
+                        unsigned int targetId = t3DiDbr.sequenceReader->getId(dbKey);
+                        const bool isIdentity = (queryId == targetId && (par.includeIdentity || sameDB))? true : false;
+
+                        char * targetSeq3Di = t3DiDbr.sequenceReader->getData(targetId, thread_idx);
+                        char * targetSeqAA = tAADbr.sequenceReader->getData(targetId, thread_idx);
+                        const int targetSeqLen = static_cast<int>(t3DiDbr.sequenceReader->getSeqLen(targetId));
+
+                        tSeq3Di.mapSequence(targetId, dbKey, targetSeq3Di, targetSeqLen);
+                        tSeqAA.mapSequence(targetId, dbKey, targetSeqAA, targetSeqLen);
+                        stats.hits++;
+                        if(Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, targetSeqLen) == false){
+                            stats.coverageRejected++;
+                            rejected++;
+                            continue;
+                        }
+                        // even the unrestricted score cannot pass the e-value threshold
+                        if (hitScoreBounds[hitIdx] != UINT32_MAX
+                            && evaluer.computeEvalueCorr(hitScoreBounds[hitIdx], muLambda.first, muLambda.second) > par.evalThr) {
+                            stats.boundRejected++;
+                            rejected++;
+                            continue;
+                        }
+                        Matcher::result_t res;
+                        if(alignStructure(structureSmithWaterman, reverseStructureSmithWaterman,
+                                          tSeqAA, tSeq3Di, querySeqLen, targetSeqLen, hitDiagonals[hitIdx],
+                                          evaluer, muLambda, minScore, res, backtrace, par, stats) == -1){
+                            rejected++;
+                            continue;
+                        }
 
-                                if(lddtres.avgLddtScore < par.lddtThr){
+                        if (Alignment::checkCriteria(res, isIdentity, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
+                            unsigned int tmNormalizationLen = 0;
+                            if(needTMaligner) {
+                                tmNormalizationLen = TMaligner::normalization(par.tmScoreThrMode, std::min(res.qEndPos - res.qStartPos, res.dbEndPos - res.dbStartPos ), res.qLen, res.dbLen);
+                                // even if all aligned pairs superposed perfectly the TM-score would stay below the threshold
+                                if (TMaligner::alignedPairs(res.backtrace) < par.tmScoreThr * tmNormalizationLen) {
+                                    stats.tmScoreBoundRejected++;
                                     continue;
                                 }
-                                res.dbcov = lddtres.avgLddtScore;
                             }
-                            if(par.sortByStructureBits && needTMaligner && needLDDT){
-                                res.score = res.score * sqrt(lddtres.avgLddtScore * tmres.tmscore);
+                            if(needCalpha) {
+                                size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
+                                char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
+                                size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
+                                float *targetX, *targetY, *targetZ;
+                                tcoords.readAligned(tcadata, res.dbLen, tCaLength, targetX, targetY, targetZ);
+                                if(needTMaligner) {
+                                    tmres = tmaligner->computeTMscore(targetX, targetY, targetZ,
+                                                                      res.dbLen,
+                                                                      res.qStartPos,
+                                                                      res.dbStartPos,
+                                                                      res.backtrace,
+                                                                      tmNormalizationLen);
+                                    stats.tmScoreEvaluated++;
+                                    if (tmres.tmscore < par.tmScoreThr) {
+                                        stats.tmScoreRejected++;
+                                        continue;
+                                    }
+                                }
+                                if(needLDDT){
+                                    lddtres = lddtcalculator->computeLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos,
+                                                                               res.backtrace,
+                                                                               targetX, targetY, targetZ);
+                                    stats.lddtEvaluated++;
+                                    if(lddtres.avgLddtScore < par.lddtThr){
+                                        stats.lddtRejected++;
+                                        continue;
+                                    }
+                                    res.dbcov = lddtres.avgLddtScore;
+                                }
+                                if(par.sortByStructureBits && needTMaligner && needLDDT){
+                                    res.score = res.score * sqrt(lddtres.avgLddtScore * tmres.tmscore);
+                                }
                             }
-                        }
 
 
-                        alignmentResult.emplace_back(res);
-                        int altAli = par.altAlignment;
-                        bool moreAltAli = true;
-                        while(altAli && moreAltAli){
-                            Matcher::result_t altRes;
-                            if(computeAlternativeAlignment(structureSmithWaterman, reverseStructureSmithWaterman,
-                                                           tSeqAA, tSeq3Di, querySeqLen, targetSeqLen,
-                                                           evaluer, muLambda, res, altRes,
-                                                           backtrace, par) == -1) {
-                                moreAltAli = false;
-                                continue;
+                            alignmentResult.emplace_back(res);
+                            int altAli = par.altAlignment;
+                            bool moreAltAli = true;
+                            while(altAli && moreAltAli){
+                                Matcher::result_t altRes;
+                                if(computeAlternativeAlignment(structureSmithWaterman, reverseStructureSmithWaterman,
+                                                               tSeqAA, tSeq3Di, querySeqLen, targetSeqLen, hitDiagonals[hitIdx],
+                                                               evaluer, muLambda, minScore, res, altRes,
+                                                               backtrace, par, stats) == -1) {
+                                    moreAltAli = false;
+                                    continue;
+                                }
+                                alignmentResult.push_back(altRes);
+                                res = altRes;
+                                altAli--;
                             }
-                            alignmentResult.push_back(altRes);
-                            res = altRes;
-                            altAli--;
+                            stats.accepted++;
+                            passedNum++;
+                            rejected = 0;
+                        } else {
+                            stats.criteriaRejected++;
+                            rejected++;
                         }
-                        passedNum++;
-                        rejected = 0;
-                    } else {
-                        rejected++;
                     }
                 }
-            }
 
 
-            if (alignmentResult.size() > 1) {
-                if(par.sortByStructureBits) {
-                    SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), compareHitsByStructureBits);
-                } else {
-                    SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), Matcher::compareHits);
+                if (alignmentResult.size() > 1) {
+                    if(par.sortByStructureBits) {
+                        SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), compareHitsByStructureBits);
+                    } else {
+                        SORT_SERIAL(alignmentResult.begin(), alignmentResult.end(), Matcher::compareHits);
+                    }
                 }
+                for (size_t result = 0; result < alignmentResult.size(); result++) {
+                    size_t len = Matcher::resultToBuffer(buffer, alignmentResult[result], par.addBacktrace);
+                    resultBuffer.append(buffer, len);
+                }
+                writer(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
+                resultBuffer.clear();
+                alignmentResult.clear();
             }
-            for (size_t result = 0; result < alignmentResult.size(); result++) {
-                size_t len = Matcher::resultToBuffer(buffer, alignmentResult[result], par.addBacktrace);
-                resultBuffer.append(buffer, len);
+            if (gate != NULL) {
+#pragma omp single
+                gate->batchDone(batchStart, batchEnd);
             }
-            dbw.writeData(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
-            resultBuffer.clear();
-            alignmentResult.clear();
         }
         if(needTMaligner){
             delete tmaligner;
@@ -457,14 +779,31 @@ int structurealign(int argc, const char **argv, const Command& command) {
         if(needLDDT){
             delete lddtcalculator;
         }
+#pragma omp critical
+        totalStats.add(stats);
+    }
+
+    Debug(Debug::INFO) << totalStats.hits << " hits considered, " << totalStats.accepted << " accepted\n";
+    Debug(Debug::INFO) << "Rejected by coverage: " << totalStats.coverageRejected
+                       << ", score bound: " << totalStats.boundRejected
+                       << ", e-value: " << totalStats.evalueRejected
+                       << ", reverse score e-value: " << totalStats.reverseEvalueRejected
+                       << ", alignment criteria: " << totalStats.criteriaRejected << "\n";
+    if (needTMaligner || needLDDT) {
+        Debug(Debug::INFO) << "Rejected by TM-score bound: " << totalStats.tmScoreBoundRejected
+                           << ", TM-score: " << totalStats.tmScoreRejected << " of " << totalStats.tmScoreEvaluated
+                           << ", LDDT: " << totalStats.lddtRejected << " of " << totalStats.lddtEvaluated << "\n";
+    }
+    if (totalStats.blockAlignFallbacks > 0) {
+        Debug(Debug::INFO) << "Block aligner fallbacks: " << totalStats.blockAlignFallbacks << "\n";
+    }
+    if (touch == false) {
+        mmapUsage.report();
     }
 
     free(tinySubMatAA);
     free(tinySubMat3Di);
 
-    dbw.close();
-    resultReader.close();
-
     if(needCalpha){
         if (sameDB == false) {
             delete tcadbr;
@@ -476,6 +815,54 @@ int structurealign(int argc, const char **argv, const Command& command) {
         delete q3DiDbr;
         delete qAADbr;
     }
+}
+
+int structurealign(int argc, const char **argv, const Command& command) {
+    MMseqsMPI::init(argc, argv);
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    structureAlignDefault(par);
+    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
+
+    uint16_t extended = DBReader<unsigned int>::getExtendedDbtype(FileUtil::parseDbType(par.db3.c_str()));
+    bool alignmentIsExtended = extended & Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC;
+
+    DBReader<unsigned int> resultReader(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    resultReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+
+    int dbtype =  Parameters::DBTYPE_ALIGNMENT_RES;
+    if(alignmentIsExtended){
+        dbtype = DBReader<unsigned int>::setExtendedDbtype(dbtype, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
+    }
+#ifdef HAVE_MPI
+    // every rank aligns a part of the queries (cluster representatives), the master merges the results
+    size_t dbFrom = 0;
+    size_t dbSize = 0;
+    resultReader.decomposeDomainByAminoAcid(MMseqsMPI::rank, MMseqsMPI::numProc, &dbFrom, &dbSize);
+    std::pair<std::string, std::string> tmpOutput = Util::createTmpFileNames(par.db4, par.db4Index, MMseqsMPI::rank);
+    DBWriter dbw(tmpOutput.first.c_str(), tmpOutput.second.c_str(), static_cast<unsigned int>(par.threads), par.compressed,  dbtype);
+#else
+    size_t dbFrom = 0;
+    size_t dbSize = resultReader.getSize();
+    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed,  dbtype);
+#endif
+    dbw.open();
+    alignStructureResults(par, resultReader, dbFrom, dbSize, alignmentIsExtended, [&dbw](const char *data, size_t length, unsigned int key, unsigned int thread) {
+        dbw.writeData(data, length, key, thread);
+    });
+#ifdef HAVE_MPI
+    dbw.close(true);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (MMseqsMPI::isMaster()) {
+        std::vector<std::pair<std::string, std::string>> splitFiles;
+        for (int proc = 0; proc < MMseqsMPI::numProc; ++proc) {
+            splitFiles.push_back(Util::createTmpFileNames(par.db4, par.db4Index, proc));
+        }
+        DBWriter::mergeResults(par.db4, par.db4Index, splitFiles);
+    }
+#else
+    dbw.close();
+#endif
+    resultReader.close();
 
     return EXIT_SUCCESS;
 }
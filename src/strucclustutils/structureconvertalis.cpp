@@ -23,7 +23,9 @@
 #include "TMaligner.h"
 #include "LDDT.h"
 #include "CalcProbTP.h"
+#include "ArrowIpc.h"
 #include <map>
+#include <unordered_map>
 #include <fstream>
 
 #ifdef OPENMP
@@ -248,6 +250,70 @@ std::map<std::string, std::string> loadPathmap(const std::string& pathmapFile) {
     return pathmap;
 }
 
+// taxa whose lineage string is kept per thread before the cache is cleared
+static const size_t MAX_LINEAGE_CACHE_SIZE = 65536;
+
+// numeric columns are stored typed in the Arrow output, all other columns as their text
+static ArrowIpc::ColumnType arrowColumnType(int outcode) {
+    switch (outcode) {
+        case Parameters::OUTFMT_GAPOPEN:
+        case Parameters::OUTFMT_NIDENT:
+        case Parameters::OUTFMT_QSTART:
+        case Parameters::OUTFMT_QEND:
+        case Parameters::OUTFMT_QLEN:
+        case Parameters::OUTFMT_TSTART:
+        case Parameters::OUTFMT_TEND:
+        case Parameters::OUTFMT_TLEN:
+        case Parameters::OUTFMT_ALNLEN:
+        case Parameters::OUTFMT_RAW:
+        case Parameters::OUTFMT_BITS:
+        case Parameters::OUTFMT_MISMATCH:
+        case Parameters::OUTFMT_QSETID:
+        case Parameters::OUTFMT_TSETID:
+        case Parameters::OUTFMT_TAXID:
+        case Parameters::OUTFMT_QORFSTART:
+        case Parameters::OUTFMT_QORFEND:
+        case Parameters::OUTFMT_TORFSTART:
+        case Parameters::OUTFMT_TORFEND:
+        case LocalParameters::OUTFMT_ASSIGN_ID:
+            return ArrowIpc::INT32;
+        case Parameters::OUTFMT_FIDENT:
+        case Parameters::OUTFMT_PIDENT:
+        case Parameters::OUTFMT_QCOV:
+        case Parameters::OUTFMT_TCOV:
+        case LocalParameters::OUTFMT_ALNTMSCORE:
+        case LocalParameters::OUTFMT_QTMSCORE:
+        case LocalParameters::OUTFMT_TTMSCORE:
+        case LocalParameters::OUTFMT_RMSD:
+        case LocalParameters::OUTFMT_LDDT:
+        case LocalParameters::OUTFMT_PROBTP:
+        case LocalParameters::OUTFMT_Q_COMPLEX_TMSCORE:
+        case LocalParameters::OUTFMT_T_COMPLEX_TMSCORE:
+            return ArrowIpc::FLOAT32;
+        case Parameters::OUTFMT_EVALUE:
+            return ArrowIpc::FLOAT64;
+        default:
+            return ArrowIpc::UTF8;
+    }
+}
+
+// TM-score normalization of a column: by target length, by alignment length or by query length
+static int tmScoreKind(int outcode) {
+    switch (outcode) {
+        case LocalParameters::OUTFMT_U:
+        case LocalParameters::OUTFMT_T:
+        case LocalParameters::OUTFMT_TTMSCORE:
+        case LocalParameters::OUTFMT_RMSD:
+            return 0;
+        case LocalParameters::OUTFMT_ALNTMSCORE:
+            return 1;
+        case LocalParameters::OUTFMT_QTMSCORE:
+            return 2;
+        default:
+            return -1;
+    }
+}
+
 int structureconvertalis(int argc, const char **argv, const Command &command) {
     LocalParameters &par = LocalParameters::getLocalInstance();
     par.parseParameters(argc, argv, command, true, 0, 0);
@@ -277,6 +343,26 @@ int structureconvertalis(int argc, const char **argv, const Command &command) {
         format, par.outfmt, needSequenceDB, need3DiDB, needBacktrace, needFullHeaders,
         needLookup, needSource, needTaxonomyMapping, needTaxonomy, needQCA, needTCA, needTMaligner, needLDDT
     );
+    // per residue LDDT scores are only kept for the lddtfull column
+    const bool needLDDTFull = std::find(outcodes.begin(), outcodes.end(), LocalParameters::OUTFMT_LDDT_FULL) != outcodes.end();
+
+    // the TM-score normalizations and the alignment strings the columns need, computed once per hit
+    std::vector<int> tmKinds;
+    bool needAlnStrings = (format == Parameters::FORMAT_ALIGNMENT_HTML);
+    for (size_t i = 0; i < outcodes.size(); i++) {
+        const int kind = tmScoreKind(outcodes[i]);
+        if (kind != -1 && std::find(tmKinds.begin(), tmKinds.end(), kind) == tmKinds.end()) {
+            tmKinds.push_back(kind);
+        }
+        switch (outcodes[i]) {
+            case Parameters::OUTFMT_QALN:
+            case Parameters::OUTFMT_TALN:
+            case LocalParameters::OUTFMT_Q3DIALN:
+            case LocalParameters::OUTFMT_T3DIALN:
+                needAlnStrings = true;
+                break;
+        }
+    }
 
     if(LocalParameters::FORMAT_ALIGNMENT_PDB_SUPERPOSED == format){
         needTMaligner = true;
@@ -466,6 +552,16 @@ int structureconvertalis(int argc, const char **argv, const Command &command) {
     resultWriter.open();
 
     const bool isDb = par.dbOut;
+    std::vector<ArrowIpc::ColumnType> arrowTypes;
+    if (format == LocalParameters::FORMAT_ALIGNMENT_ARROW) {
+        if (isDb || outcodes.empty()) {
+            Debug(Debug::ERROR) << "Arrow output needs --format-output columns and can not be written as database\n";
+            EXIT(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < outcodes.size(); i++) {
+            arrowTypes.emplace_back(arrowColumnType(outcodes[i]));
+        }
+    }
     TranslateNucl translateNucl(static_cast<TranslateNucl::GenCode>(par.translationTable));
 
     if (format == Parameters::FORMAT_ALIGNMENT_SAM) {
@@ -510,15 +606,6 @@ int structureconvertalis(int argc, const char **argv, const Command &command) {
         }
         delete[] headerWritten;
     } else if (format == Parameters::FORMAT_ALIGNMENT_HTML) {
-        // size_t dstSize = ZSTD_findDecompressedSize(result_viz_prelude_fs_html_zst, result_viz_prelude_fs_html_zst_len);
-        // char* dst = (char*)malloc(sizeof(char) * dstSize);
-        // size_t realSize = ZSTD_decompress(dst, dstSize, result_viz_prelude_fs_html_zst, result_viz_prelude_fs_html_zst_len);
-        
-        size_t dstSize = ZSTD_findDecompressedSize(vendor_js_zst, vendor_js_zst_len);
-        char* dst = (char*)malloc(sizeof(char) * dstSize);
-        size_t realSize = ZSTD_decompress(dst, dstSize, vendor_js_zst, vendor_js_zst_len);
-        
-        std::string mainJS(const_cast<char *>(reinterpret_cast<const char *>(main_js)), main_js_len);
         std::string htmlTemplate(
 R"html(<!DOCTYPE html>
 <html lang="en">
@@ -536,21 +623,35 @@ R"html(<!DOCTYPE html>
         std::string scriptStart = "<script>";
         std::string scriptEnd   = "</script>";
 
-        // vendor.js
+        // vendor.js is decompressed chunk by chunk straight into the output
         resultWriter.writeData(scriptStart.c_str(), scriptStart.size(), 0, 0, false, false);
-        resultWriter.writeData(dst, realSize, 0, 0, false, false);
+        ZSTD_DStream* dstream = ZSTD_createDStream();
+        std::vector<char> jsChunk(ZSTD_DStreamOutSize());
+        ZSTD_inBuffer jsIn = { vendor_js_zst, vendor_js_zst_len, 0 };
+        size_t ret = 1;
+        while (jsIn.pos < jsIn.size || ret != 0) {
+            ZSTD_outBuffer jsOut = { jsChunk.data(), jsChunk.size(), 0 };
+            ret = ZSTD_decompressStream(dstream, &jsOut, &jsIn);
+            if (ZSTD_isError(ret)) {
+                Debug(Debug::ERROR) << "Could not decompress vendor.js: " << ZSTD_getErrorName(ret) << "\n";
+                EXIT(EXIT_FAILURE);
+            }
+            if (jsOut.pos == 0 && jsIn.pos == jsIn.size) {
+                break;
+            }
+            resultWriter.writeData(jsChunk.data(), jsOut.pos, 0, 0, false, false);
+        }
+        ZSTD_freeDStream(dstream);
         resultWriter.writeData(scriptEnd.c_str(), scriptEnd.size(), 0, 0, false, false);
         
         // main.js
         resultWriter.writeData(scriptStart.c_str(), scriptStart.size(), 0, 0, false, false);
-        resultWriter.writeData(mainJS.c_str(), mainJS.size(), 0, 0, false, false);
+        resultWriter.writeData(reinterpret_cast<const char *>(main_js), main_js_len, 0, 0, false, false);
         resultWriter.writeData(scriptEnd.c_str(), scriptEnd.size(), 0, 0, false, false);
         
         // Data <div>
         const char* dataStart = "<div id=\"data\" style=\"display: none;\">\n[";
         resultWriter.writeData(dataStart, strlen(dataStart), 0, 0, false, false);
-
-        free(dst);
     } else if (addColumnHeaders == true && outcodes.empty() == false) {
         std::vector<std::string> outfmt = Util::split(par.outfmt, ",");
         std::string header(outfmt[0]);
@@ -560,6 +661,10 @@ R"html(<!DOCTYPE html>
         }
         header.append(1, '\n');
         resultWriter.writeData(header.c_str(), header.length(), 0, 0, false, false);
+    } else if (format == LocalParameters::FORMAT_ALIGNMENT_ARROW) {
+        std::string schema;
+        ArrowIpc::writeSchema(Util::split(par.outfmt, ","), arrowTypes, schema);
+        resultWriter.writeData(schema.c_str(), schema.length(), 0, 0, false, false);
     }
 
     Debug::Progress progress(alnDbr.getSize());
@@ -589,6 +694,12 @@ R"html(<!DOCTYPE html>
         std::string caStr;
         caStr.reserve(1024*1024);
 
+        std::string queryCaStr;
+        queryCaStr.reserve(1024*1024);
+
+        std::string uncompressedBacktrace;
+        uncompressedBacktrace.reserve(1024);
+
         std::string queryProfData;
         queryProfData.reserve(1024);
 
@@ -614,12 +725,23 @@ R"html(<!DOCTYPE html>
         newBacktrace.reserve(1024);
 
         const TaxonNode * taxonNode = NULL;
+        // lineage strings of the taxa seen by this thread, targets of the same taxon recur across queries
+        std::unordered_map<TaxID, std::string> lineageCache;
         TMaligner::TMscoreResult tmres;
 
         Coordinate16 qcoords;
         Coordinate16 tcoords;
 
-        std::string tmpBt;
+        std::vector<float> lddtPerResidue;
+        std::vector<TMaligner::TMscoreTarget> tmBatch;
+        std::vector<TMaligner::TMscoreResult> tmBatchRes;
+
+        // the record batches of each thread are written to its part of the output
+        ArrowIpc::Batch *arrowBatch = NULL;
+        std::string arrowMessage;
+        if (format == LocalParameters::FORMAT_ALIGNMENT_ARROW) {
+            arrowBatch = new ArrowIpc::Batch(arrowTypes, par.compressed);
+        }
 #pragma omp  for schedule(dynamic, 10)
         for (size_t i = 0; i < alnDbr.getSize(); i++) {
             progress.updateProgress();
@@ -676,6 +798,9 @@ R"html(<!DOCTYPE html>
                 queryHeaderBuffer.assign(qHeader, qHeaderLen);
                 qHeader = (char*) queryHeaderBuffer.c_str();
             }
+            // the TM aligner query is set on the first hit of this query
+            unsigned int tmQueryLen = 0;
+            queryCaStr.clear();
             if(needLDDT){
 	            lddtcalculator->initQuery(querySeqLen, queryCaData, &queryCaData[querySeqLen], &queryCaData[querySeqLen+querySeqLen]);
             }
@@ -694,9 +819,8 @@ R"html(<!DOCTYPE html>
                     result.append(querySeqData, querySeqLen);
                 }
                 result.append("\", \"qCa\": \"");
-                caStr.clear();
-                caToStr(queryCaData, querySeqLen, caStr);
-                result.append(caStr, 0, caStr.size()-1);
+                caToStr(queryCaData, querySeqLen, queryCaStr);
+                result.append(queryCaStr, 0, queryCaStr.size()-1);
                 result.append("\"}, \"results\": [\n{\"db\": \"");
                 result.append(par.db2);
                 result.append("\", \"alignments\": [");
@@ -771,16 +895,25 @@ R"html(<!DOCTYPE html>
                     const float bestMatchEstimate = static_cast<float>(std::min(abs(res.qEndPos - adjustQstart), abs(res.dbEndPos - adjustDBstart)));
                     missMatchCount = static_cast<unsigned int>(bestMatchEstimate * (1.0f - res.seqId) + 0.5);
                 }
-                if(needTMaligner){
+                if(needTMaligner && tmQueryLen != res.qLen){
                     tmaligner->initQuery(queryCaData, &queryCaData[res.qLen], &queryCaData[res.qLen+res.qLen], NULL, res.qLen);
-                    tmpBt = Matcher::uncompressAlignment(res.backtrace);
+                    tmQueryLen = res.qLen;
+                }
+                if (needAlnStrings) {
+                    uncompressedBacktrace = Matcher::uncompressAlignment(res.backtrace);
                 }
                 LDDTCalculator::LDDTScoreResult lddtres;
                 if(needLDDT) {
-                    lddtres = lddtcalculator->computeLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos, Matcher::uncompressAlignment(res.backtrace), targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen]);
+                    float *perCaLddtScore = NULL;
+                    if (needLDDTFull) {
+                        lddtPerResidue.resize(std::max(res.qLen, res.dbLen));
+                        perCaLddtScore = lddtPerResidue.data();
+                    }
+                    lddtres = lddtcalculator->computeLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos, res.backtrace, targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], perCaLddtScore);
                 }
                 switch (format) {
-                    case Parameters::FORMAT_ALIGNMENT_BLAST_TAB: {
+                    case Parameters::FORMAT_ALIGNMENT_BLAST_TAB:
+                    case LocalParameters::FORMAT_ALIGNMENT_ARROW: {
                         if (outcodes.empty()) {
                             int count = snprintf(buffer, sizeof(buffer),
                                                  "%s\t%s\t%1.3f\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%.2E\t%d\n",
@@ -827,21 +960,149 @@ R"html(<!DOCTYPE html>
                                 }
                             }
 
-                            for(size_t i = 0; i < outcodes.size(); i++) {
-                                bool computed = false;
-                                switch (outcodes[i]) {
-                                    case LocalParameters::OUTFMT_U:
-                                    case LocalParameters::OUTFMT_T:
-                                        tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
-                                                                          res.qStartPos, res.dbStartPos, tmpBt, res.dbLen);
-                                        computed = true;
-                                        break;
+                            // score all requested TM-score normalizations of this hit in one batch
+                            tmBatch.clear();
+                            int tmBatchIdx[3] = {-1, -1, -1}; // target, alignment, query
+                            for(size_t k = 0; needTMaligner && k < tmKinds.size(); k++) {
+                                const int kind = tmKinds[k];
+                                int normLen = res.dbLen;
+                                if (kind == 1) {
+                                    normLen = std::min(res.qEndPos - res.qStartPos, res.dbEndPos - res.dbStartPos);
+                                } else if (kind == 2) {
+                                    normLen = res.qLen;
                                 }
-                                if(computed){
-                                    break;
+                                tmBatchIdx[kind] = tmBatch.size();
+                                tmBatch.emplace_back(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
+                                                     res.qStartPos, res.dbStartPos, &res.backtrace, normLen);
+                            }
+                            if (tmBatch.empty() == false) {
+                                tmaligner->computeTMscores(tmBatch, tmBatchRes);
+                                if (tmBatchIdx[0] != -1) {
+                                    tmres = tmBatchRes[tmBatchIdx[0]];
                                 }
                             }
                             for(size_t i = 0; i < outcodes.size(); i++) {
+                                const size_t textStart = result.size();
+                                if (arrowBatch != NULL) {
+                                    bool isTyped = true;
+                                    switch (outcodes[i]) {
+                                        case Parameters::OUTFMT_EVALUE:
+                                            arrowBatch->appendFloat64(i, res.eval);
+                                            break;
+                                        case Parameters::OUTFMT_GAPOPEN:
+                                            arrowBatch->appendInt32(i, gapOpenCount);
+                                            break;
+                                        case Parameters::OUTFMT_FIDENT:
+                                            arrowBatch->appendFloat32(i, res.seqId);
+                                            break;
+                                        case Parameters::OUTFMT_PIDENT:
+                                            arrowBatch->appendFloat32(i, res.seqId * 100);
+                                            break;
+                                        case Parameters::OUTFMT_NIDENT:
+                                            arrowBatch->appendInt32(i, identical);
+                                            break;
+                                        case Parameters::OUTFMT_QSTART:
+                                            arrowBatch->appendInt32(i, res.qStartPos + 1);
+                                            break;
+                                        case Parameters::OUTFMT_QEND:
+                                            arrowBatch->appendInt32(i, res.qEndPos + 1);
+                                            break;
+                                        case Parameters::OUTFMT_QLEN:
+                                            arrowBatch->appendInt32(i, res.qLen);
+                                            break;
+                                        case Parameters::OUTFMT_TSTART:
+                                            arrowBatch->appendInt32(i, res.dbStartPos + 1);
+                                            break;
+                                        case Parameters::OUTFMT_TEND:
+                                            arrowBatch->appendInt32(i, res.dbEndPos + 1);
+                                            break;
+                                        case Parameters::OUTFMT_TLEN:
+                                            arrowBatch->appendInt32(i, res.dbLen);
+                                            break;
+                                        case Parameters::OUTFMT_ALNLEN:
+                                            arrowBatch->appendInt32(i, alnLen);
+                                            break;
+                                        case Parameters::OUTFMT_RAW:
+                                            arrowBatch->appendInt32(i, static_cast<int>(evaluer->computeRawScoreFromBitScore(res.score) + 0.5));
+                                            break;
+                                        case Parameters::OUTFMT_BITS:
+                                            arrowBatch->appendInt32(i, res.score);
+                                            break;
+                                        case Parameters::OUTFMT_MISMATCH:
+                                            arrowBatch->appendInt32(i, missMatchCount);
+                                            break;
+                                        case Parameters::OUTFMT_QCOV:
+                                            arrowBatch->appendFloat32(i, res.qcov);
+                                            break;
+                                        case Parameters::OUTFMT_TCOV:
+                                            arrowBatch->appendFloat32(i, res.dbcov);
+                                            break;
+                                        case Parameters::OUTFMT_QSETID:
+                                            arrowBatch->appendInt32(i, qKeyToSet[queryKey]);
+                                            break;
+                                        case Parameters::OUTFMT_TSETID:
+                                            arrowBatch->appendInt32(i, tKeyToSet[res.dbKey]);
+                                            break;
+                                        case Parameters::OUTFMT_TAXID:
+                                            arrowBatch->appendInt32(i, taxon);
+                                            break;
+                                        case Parameters::OUTFMT_QORFSTART:
+                                            arrowBatch->appendInt32(i, res.queryOrfStartPos);
+                                            break;
+                                        case Parameters::OUTFMT_QORFEND:
+                                            arrowBatch->appendInt32(i, res.queryOrfEndPos);
+                                            break;
+                                        case Parameters::OUTFMT_TORFSTART:
+                                            arrowBatch->appendInt32(i, res.dbOrfStartPos);
+                                            break;
+                                        case Parameters::OUTFMT_TORFEND:
+                                            arrowBatch->appendInt32(i, res.dbOrfEndPos);
+                                            break;
+                                        case LocalParameters::OUTFMT_ALNTMSCORE:
+                                            arrowBatch->appendFloat32(i, tmBatchRes[tmBatchIdx[1]].tmscore);
+                                            break;
+                                        case LocalParameters::OUTFMT_QTMSCORE:
+                                            arrowBatch->appendFloat32(i, tmBatchRes[tmBatchIdx[2]].tmscore);
+                                            break;
+                                        case LocalParameters::OUTFMT_TTMSCORE:
+                                            arrowBatch->appendFloat32(i, tmBatchRes[tmBatchIdx[0]].tmscore);
+                                            break;
+                                        case LocalParameters::OUTFMT_RMSD:
+                                            arrowBatch->appendFloat32(i, tmBatchRes[tmBatchIdx[0]].rmsd);
+                                            break;
+                                        case LocalParameters::OUTFMT_LDDT:
+                                            arrowBatch->appendFloat32(i, lddtres.avgLddtScore);
+                                            break;
+                                        case LocalParameters::OUTFMT_PROBTP:
+                                            arrowBatch->appendFloat32(i, CalcProbTP::calculate(res.score));
+                                            break;
+                                        // invalid complex results are reported by the text columns below
+                                        case LocalParameters::OUTFMT_Q_COMPLEX_TMSCORE:
+                                            isTyped = retComplex.isValid;
+                                            if (isTyped) {
+                                                arrowBatch->appendFloat32(i, retComplex.qTmScore);
+                                            }
+                                            break;
+                                        case LocalParameters::OUTFMT_T_COMPLEX_TMSCORE:
+                                            isTyped = retComplex.isValid;
+                                            if (isTyped) {
+                                                arrowBatch->appendFloat32(i, retComplex.tTmScore);
+                                            }
+                                            break;
+                                        case LocalParameters::OUTFMT_ASSIGN_ID:
+                                            isTyped = retComplex.isValid;
+                                            if (isTyped) {
+                                                arrowBatch->appendInt32(i, retComplex.assId);
+                                            }
+                                            break;
+                                        default:
+                                            isTyped = false;
+                                            break;
+                                    }
+                                    if (isTyped) {
+                                        continue;
+                                    }
+                                }
                                 switch (outcodes[i]) {
                                     case Parameters::OUTFMT_QUERY:
                                         result.append(queryId);
@@ -944,7 +1205,7 @@ R"html(<!DOCTYPE html>
                                         }
                                         structurePrintSeqBasedOnAln(
                                             result, print, res.qStartPos,
-                                            Matcher::uncompressAlignment(res.backtrace), false,
+                                            uncompressedBacktrace, false,
                                             (res.qStartPos > res.qEndPos),
                                             (isTranslatedSearch == true && queryNucs == true), translateNucl
                                         );
@@ -961,7 +1222,7 @@ R"html(<!DOCTYPE html>
                                         }
                                         structurePrintSeqBasedOnAln(
                                             result, print, res.dbStartPos,
-                                            Matcher::uncompressAlignment(res.backtrace), true,
+                                            uncompressedBacktrace, true,
                                             (res.dbStartPos > res.dbEndPos),
                                             (isTranslatedSearch == true && targetNucs == true), translateNucl
                                         );
@@ -995,7 +1256,20 @@ R"html(<!DOCTYPE html>
                                         result.append((taxonNode != NULL) ? t->getString(taxonNode->nameIdx) : "unclassified");
                                         break;
                                     case Parameters::OUTFMT_TAXLIN:
-                                        result.append((taxonNode != NULL) ? t->taxLineage(taxonNode, true) : "unclassified");
+                                        if (taxonNode == NULL) {
+                                            result.append("unclassified");
+                                            break;
+                                        }
+                                        {
+                                            std::unordered_map<TaxID, std::string>::const_iterator it = lineageCache.find(taxonNode->taxId);
+                                            if (it == lineageCache.end()) {
+                                                if (lineageCache.size() >= MAX_LINEAGE_CACHE_SIZE) {
+                                                    lineageCache.clear();
+                                                }
+                                                it = lineageCache.emplace(taxonNode->taxId, t->taxLineage(taxonNode, true)).first;
+                                            }
+                                            result.append(it->second);
+                                        }
                                         break;
                                     case Parameters::OUTFMT_EMPTY:
                                         result.push_back('-');
@@ -1013,9 +1287,10 @@ R"html(<!DOCTYPE html>
                                         result.append(SSTR(res.dbOrfEndPos));
                                         break;
                                     case LocalParameters::OUTFMT_QCA:
-                                        caStr.clear();
-                                        caToStr(queryCaData, res.qLen, caStr);
-                                        result.append(caStr, 0, caStr.size()-1);
+                                        if (queryCaStr.empty()) {
+                                            caToStr(queryCaData, res.qLen, queryCaStr);
+                                        }
+                                        result.append(queryCaStr, 0, queryCaStr.size()-1);
                                         break;
                                     case LocalParameters::OUTFMT_TCA:
                                         caStr.clear();
@@ -1049,25 +1324,16 @@ R"html(<!DOCTYPE html>
                                         result.append(SSTR(tmres.t[2]));
                                         break;
                                     case LocalParameters::OUTFMT_ALNTMSCORE:
-                                        tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
-                                                                          res.qStartPos, res.dbStartPos, tmpBt,
-                                                                          std::min(res.qEndPos - res.qStartPos, res.dbEndPos - res.dbStartPos));
-                                        result.append(SSTR(tmres.tmscore));
+                                        result.append(SSTR(tmBatchRes[tmBatchIdx[1]].tmscore));
                                         break;
                                     case LocalParameters::OUTFMT_QTMSCORE:
-                                        tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
-                                                                          res.qStartPos, res.dbStartPos, tmpBt,res.qLen);
-                                        result.append(SSTR(tmres.tmscore));
+                                        result.append(SSTR(tmBatchRes[tmBatchIdx[2]].tmscore));
                                         break;
                                     case LocalParameters::OUTFMT_TTMSCORE:
-                                        tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
-                                                                          res.qStartPos, res.dbStartPos, tmpBt, res.dbLen);
-                                        result.append(SSTR(tmres.tmscore));
+                                        result.append(SSTR(tmBatchRes[tmBatchIdx[0]].tmscore));
                                         break;
                                     case LocalParameters::OUTFMT_RMSD:
-                                        tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
-                                                                          res.qStartPos, res.dbStartPos, tmpBt, res.dbLen);
-                                        result.append(SSTR(tmres.rmsd));
+                                        result.append(SSTR(tmBatchRes[tmBatchIdx[0]].rmsd));
                                         break;
                                     case LocalParameters::OUTFMT_LDDT:
                                         // TODO: make SSTR_approx that outputs %2f, not %3f
@@ -1075,10 +1341,10 @@ R"html(<!DOCTYPE html>
                                         break;
                                     case LocalParameters::OUTFMT_LDDT_FULL:
                                         for(int i = 0; i < lddtres.scoreLength - 1; i++) {
-                                            result.append(SSTR(lddtres.perCaLddtScore[i]));
+                                            result.append(SSTR(lddtPerResidue[i]));
                                             result.push_back(',');
                                         }
-                                        result.append(SSTR(lddtres.perCaLddtScore[lddtres.scoreLength - 1]));
+                                        result.append(SSTR(lddtPerResidue[lddtres.scoreLength - 1]));
                                         break;
                                     case LocalParameters::OUTFMT_PROBTP:
                                         result.append(SSTR(CalcProbTP::calculate(res.score)));
@@ -1119,11 +1385,25 @@ R"html(<!DOCTYPE html>
                                         result.append(retComplex.uString);
                                         break;
                                 }
+                                if (arrowBatch != NULL) {
+                                    arrowBatch->appendString(i, result.c_str() + textStart, result.size() - textStart);
+                                    result.resize(textStart);
+                                    continue;
+                                }
                                 if (i < outcodes.size() - 1) {
                                     result.push_back('\t');
                                 }
                             }
-                            result.push_back('\n');
+                            if (arrowBatch != NULL) {
+                                arrowBatch->endRow();
+                                if (arrowBatch->isFull()) {
+                                    arrowBatch->flush(arrowMessage);
+                                    resultWriter.writeData(arrowMessage.c_str(), arrowMessage.size(), queryKey, thread_idx, false, false);
+                                    arrowMessage.clear();
+                                }
+                            } else {
+                                result.push_back('\n');
+                            }
                         }
                         break;
                     }
@@ -1193,7 +1473,7 @@ R"html(<!DOCTYPE html>
                         result.append(targetId);
                         result.append("\n");
                         tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
-                                                          res.qStartPos, res.dbStartPos, tmpBt, res.dbLen);
+                                                          res.qStartPos, res.dbStartPos, res.backtrace, res.dbLen);
                         for(unsigned int tpos = 0; tpos < res.dbLen; tpos++){
                             size_t tId = tDbr->sequenceReader->getId(res.dbKey);
                             char* targetSeqData  = (char*) tDbr->sequenceReader->getData(tId, thread_idx);
@@ -1236,11 +1516,11 @@ R"html(<!DOCTYPE html>
                         result.append(buffer, count);
                         if (queryProfile) {
                             structurePrintSeqBasedOnAln(result, queryProfData.c_str(), res.qStartPos,
-                                               Matcher::uncompressAlignment(res.backtrace), false, (res.qStartPos > res.qEndPos),
+                                               uncompressedBacktrace, false, (res.qStartPos > res.qEndPos),
                                                (isTranslatedSearch == true && queryNucs == true), translateNucl);
                         } else {
                             structurePrintSeqBasedOnAln(result, querySeqData, res.qStartPos,
-                                               Matcher::uncompressAlignment(res.backtrace), false, (res.qStartPos > res.qEndPos),
+                                               uncompressedBacktrace, false, (res.qStartPos > res.qEndPos),
                                                (isTranslatedSearch == true && queryNucs == true), translateNucl);
                         }
                         result.append("\", \"dbAln\": \"");
@@ -1250,12 +1530,12 @@ R"html(<!DOCTYPE html>
                             size_t targetEntryLen = tDbr->sequenceReader->getEntryLen(tId);
                             Sequence::extractProfileConsensus(targetSeqData, targetEntryLen, *subMat, targetProfData);
                             structurePrintSeqBasedOnAln(result, targetProfData.c_str(), res.dbStartPos,
-                                               Matcher::uncompressAlignment(res.backtrace), true,
+                                               uncompressedBacktrace, true,
                                                (res.dbStartPos > res.dbEndPos),
                                                (isTranslatedSearch == true && targetNucs == true), translateNucl);
                         } else {
                             structurePrintSeqBasedOnAln(result, targetSeqData, res.dbStartPos,
-                                               Matcher::uncompressAlignment(res.backtrace), true,
+                                               uncompressedBacktrace, true,
                                                (res.dbStartPos > res.dbEndPos),
                                                (isTranslatedSearch == true && targetNucs == true), translateNucl);
                         }
@@ -1283,6 +1563,11 @@ R"html(<!DOCTYPE html>
             resultWriter.writeData(result.c_str(), result.size(), queryKey, thread_idx, isDb);
             result.clear();
         }
+        if (arrowBatch != NULL) {
+            arrowBatch->flush(arrowMessage);
+            resultWriter.writeData(arrowMessage.c_str(), arrowMessage.size(), 0, thread_idx, false, false);
+            delete arrowBatch;
+        }
         if(tmaligner != NULL){
             delete tmaligner;
         }
@@ -1293,6 +1578,10 @@ R"html(<!DOCTYPE html>
     const char* htmlEndBlock = "]\n</div>";
     if (format == Parameters::FORMAT_ALIGNMENT_HTML) {
         resultWriter.writeData(htmlEndBlock, strlen(htmlEndBlock), 0, localThreads - 1, false, false);
+    } else if (format == LocalParameters::FORMAT_ALIGNMENT_ARROW) {
+        std::string endOfStream;
+        ArrowIpc::writeEndOfStream(endOfStream);
+        resultWriter.writeData(endOfStream.c_str(), endOfStream.size(), 0, localThreads - 1, false, false);
     }
     // tsv output
     resultWriter.close(true);
@@ -0,0 +1,193 @@
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "IndexReader.h"
+#include "Debug.h"
+#include "Util.h"
+#include "LocalParameters.h"
+#include "Matcher.h"
+#include "SubstitutionMatrix.h"
+#include "BacktraceTranslator.h"
+#include "StructureUtil.h"
+#include "EvalueNeuralNet.h"
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+// Best local 3Di+AA score along the backtrace of a composed alignment. The path is a valid alignment,
+// so this is a lower bound of the score structurealign would compute (without the composition bias)
+static int scoreComposedAlignment(const Matcher::result_t &result,
+                                  const char *querySeqAA, const char *querySeq3Di, unsigned int queryLen,
+                                  const char *targetSeqAA, const char *targetSeq3Di, unsigned int targetLen,
+                                  SubstitutionMatrix &subMatAA, SubstitutionMatrix &subMat3Di, int gapOpen, int gapExtend) {
+    unsigned int qPos = result.qStartPos;
+    unsigned int tPos = result.dbStartPos;
+    int score = 0;
+    int maxScore = 0;
+    char lastState = '\0';
+    for (size_t i = 0; i < result.backtrace.size(); ++i) {
+        const char state = result.backtrace[i];
+        if (state == 'M') {
+            if (qPos >= queryLen || tPos >= targetLen) {
+                break;
+            }
+            const unsigned char qAA = static_cast<unsigned char>(querySeqAA[qPos]);
+            const unsigned char tAA = static_cast<unsigned char>(targetSeqAA[tPos]);
+            const unsigned char q3Di = static_cast<unsigned char>(querySeq3Di[qPos]);
+            const unsigned char t3Di = static_cast<unsigned char>(targetSeq3Di[tPos]);
+            score += subMat3Di.subMatrix[subMat3Di.aa2num[q3Di]][subMat3Di.aa2num[t3Di]]
+                     + subMatAA.subMatrix[subMatAA.aa2num[qAA]][subMatAA.aa2num[tAA]];
+            qPos++;
+            tPos++;
+        } else {
+            score -= (lastState == state) ? gapExtend : gapOpen;
+            if (state == 'I') {
+                qPos++;
+            } else {
+                tPos++;
+            }
+        }
+        score = std::max(score, 0);
+        maxScore = std::max(maxScore, score);
+        lastState = state;
+    }
+    return maxScore;
+}
+
+// Expands the query-representative alignments of a search against a clustered database to the cluster
+// members like mergeresultsbyset, but only keeps members whose query-member alignment, composed from the
+// query-representative and representative-member backtraces, reaches --cluster-search-evalue.
+// Members without a backtrace in the cluster alignments cannot be bounded and are always kept.
+int structureexpandaln(int argc, const char **argv, const Command &command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.alignmentType = LocalParameters::ALIGNMENT_TYPE_3DI_AA;
+    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
+
+    const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
+    DBReader<unsigned int> resultReader(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    resultReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+
+    IndexReader qAADbr(par.db1, par.threads, IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+    IndexReader q3DiDbr(StructureUtil::getIndexWithSuffix(par.db1, "_ss"), par.threads, IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+
+    IndexReader tAADbr(par.db2, par.threads, IndexReader::SRC_SEQUENCES, (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0);
+    std::string t3DiDbrName = StructureUtil::getIndexWithSuffix(par.db2, "_ss");
+    bool is3DiIdx = Parameters::isEqualDbtype(FileUtil::parseDbType(t3DiDbrName.c_str()), Parameters::DBTYPE_INDEX_DB);
+    IndexReader t3DiDbr(is3DiIdx ? t3DiDbrName : par.db2, par.threads, IndexReader::SRC_SEQUENCES,
+                        (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0,
+                        DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA, "_seq_ss");
+    // only the _aln database has backtraces, _clu only lists the members
+    const bool hasAln = FileUtil::fileExists((par.db2 + "_aln.dbtype").c_str());
+    IndexReader clusterReader(par.db2, par.threads, IndexReader::ALIGNMENTS,
+                              (touch) ? (IndexReader::PRELOAD_INDEX | IndexReader::PRELOAD_DATA) : 0,
+                              DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA, hasAln ? "_aln" : "_clu");
+
+    SubstitutionMatrix subMat3Di(par.scoringMatrixFile.values.aminoacid().c_str(), 2.1, par.scoreBias);
+    std::string blosum;
+    for (size_t i = 0; i < par.substitutionMatrices.size(); i++) {
+        if (par.substitutionMatrices[i].name == "blosum62.out") {
+            std::string matrixData((const char *)par.substitutionMatrices[i].subMatData, par.substitutionMatrices[i].subMatDataLen);
+            std::string matrixName = par.substitutionMatrices[i].name;
+            char * serializedMatrix = BaseMatrix::serialize(matrixName, matrixData);
+            blosum.assign(serializedMatrix);
+            free(serializedMatrix);
+            break;
+        }
+    }
+    float aaFactor = (par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA) ? 1.4 : 0.0;
+    SubstitutionMatrix subMatAA(blosum.c_str(), aaFactor, par.scoreBias);
+    const int gapOpen = par.gapOpen.values.aminoacid();
+    const int gapExtend = par.gapExtend.values.aminoacid();
+
+    // E-values are computed like structurealign does against the member database
+    const bool useBound = par.clusterSearchEvalue > 0.0;
+    std::vector<std::pair<double, double>> queryMuLambda;
+    if (useBound) {
+        queryMuLambda = EvalueNeuralNet::predictQueries(resultReader, *q3DiDbr.sequenceReader, q3DiDbr.getDbtype(), &subMat3Di,
+                                                        tAADbr.sequenceReader->getAminoAcidDBSize(), par.maxSeqLen, par.compBiasCorrection,
+                                                        EvalueNeuralNet::muLambdaDbName(par.db1));
+    }
+
+    int dbtype = DBReader<unsigned int>::setExtendedDbtype(Parameters::DBTYPE_ALIGNMENT_RES, Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
+    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), par.threads, par.compressed, dbtype);
+    dbw.open();
+
+    size_t totalMembers = 0;
+    size_t keptMembers = 0;
+    Debug::Progress progress(resultReader.getSize());
+#pragma omp parallel reduction(+:totalMembers, keptMembers)
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        EvalueNeuralNet evaluer(tAADbr.sequenceReader->getAminoAcidDBSize(), &subMat3Di);
+        BacktraceTranslator translator;
+        Matcher::result_t resultAc;
+        const char *words[255];
+        std::string buffer;
+        buffer.reserve(10 * 1024);
+
+#pragma omp for schedule(dynamic, 10)
+        for (size_t id = 0; id < resultReader.getSize(); ++id) {
+            progress.updateProgress();
+            char *data = resultReader.getData(id, thread_idx);
+            const unsigned int queryKey = resultReader.getDbKey(id);
+            const std::pair<double, double> muLambda = useBound ? queryMuLambda[id] : std::make_pair(0.0, 0.0);
+            const bool boundQuery = useBound && muLambda.first > 0.0 && *data != '\0';
+            const char *querySeqAA = NULL;
+            const char *querySeq3Di = NULL;
+            unsigned int queryLen = 0;
+            if (boundQuery) {
+                const size_t queryId = q3DiDbr.sequenceReader->getId(queryKey);
+                querySeqAA = qAADbr.sequenceReader->getData(qAADbr.sequenceReader->getId(queryKey), thread_idx);
+                querySeq3Di = q3DiDbr.sequenceReader->getData(queryId, thread_idx);
+                queryLen = q3DiDbr.sequenceReader->getSeqLen(queryId);
+            }
+            while (*data != '\0') {
+                Matcher::result_t resultAb = Matcher::parseAlignmentRecord(data, false);
+                data = Util::skipLine(data);
+                const size_t repId = clusterReader.sequenceReader->getId(resultAb.dbKey);
+                if (repId == UINT_MAX) {
+                    Debug(Debug::ERROR) << "Invalid key " << resultAb.dbKey << " in entry " << id << ".\n";
+                    EXIT(EXIT_FAILURE);
+                }
+                char *memberData = clusterReader.sequenceReader->getData(repId, thread_idx);
+                while (*memberData != '\0') {
+                    char *lineEnd = Util::skipLine(memberData);
+                    totalMembers++;
+                    bool keep = true;
+                    const size_t columns = Util::getWordsOfLine(memberData, words, 255);
+                    const bool hasBacktrace = (columns == Matcher::ALN_RES_WITH_BT_COL_CNT || columns == Matcher::ALN_RES_WITH_ORF_AND_BT_COL_CNT);
+                    if (boundQuery && hasBacktrace && resultAb.backtrace.empty() == false) {
+                        Matcher::result_t resultBc = Matcher::parseAlignmentRecord(memberData, false);
+                        translator.translateResult(resultAb, resultBc, resultAc);
+                        int score = 0;
+                        const size_t memberId = tAADbr.sequenceReader->getId(resultBc.dbKey);
+                        if (resultAc.backtrace.empty() == false && memberId != UINT_MAX) {
+                            const size_t member3DiId = t3DiDbr.sequenceReader->getId(resultBc.dbKey);
+                            score = scoreComposedAlignment(resultAc, querySeqAA, querySeq3Di, queryLen,
+                                                           tAADbr.sequenceReader->getData(memberId, thread_idx),
+                                                           t3DiDbr.sequenceReader->getData(member3DiId, thread_idx),
+                                                           t3DiDbr.sequenceReader->getSeqLen(member3DiId),
+                                                           subMatAA, subMat3Di, gapOpen, gapExtend);
+                        }
+                        keep = evaluer.computeEvalueCorr(score, muLambda.first, muLambda.second) <= par.clusterSearchEvalue;
+                    }
+                    if (keep) {
+                        buffer.append(memberData, lineEnd - memberData);
+                        keptMembers++;
+                    }
+                    memberData = lineEnd;
+                }
+            }
+            dbw.writeData(buffer.c_str(), buffer.length(), queryKey, thread_idx);
+            buffer.clear();
+        }
+    }
+    dbw.close();
+    resultReader.close();
+
+    Debug(Debug::INFO) << "Kept " << keptMembers << " of " << totalMembers << " cluster members for realignment\n";
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "itoa.h"
+#include "FastSort.h"
+#include "StructureAlignStages.h"
+
+// Structures that are aligned together before the assignments are updated
+static const size_t BATCH_QUERIES_PER_THREAD = 32;
+
+// Aligns the prefilter hits and clusters them like clust --cluster-mode 2, without the alignments
+// that cannot change the clustering. Structures are processed by decreasing length, an unassigned
+// structure with an accepted hit besides itself becomes a representative of all its unassigned hits.
+// Thus a structure assigned to an earlier representative needs no alignment and a representative
+// only needs to align the unassigned hits, decided hits are aligned until a second hit is accepted.
+int structuregreedyclust(int argc, const char **argv, const Command &command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
+
+    // the sequence DB is aligned against itself
+    const std::string prefDb = par.db2;
+    const std::string prefDbIndex = par.db2Index;
+    const std::string outDb = par.db3;
+    const std::string outDbIndex = par.db3Index;
+    par.db2 = par.db1;
+    par.db2Index = par.db1Index;
+
+    DBReader<unsigned int> seqDbr(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX);
+    seqDbr.open(DBReader<unsigned int>::SORT_BY_LENGTH);
+
+    DBReader<unsigned int> prefReader(prefDb.c_str(), prefDbIndex.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    prefReader.open(DBReader<unsigned int>::NOSORT);
+
+    const size_t dbSize = seqDbr.getSize();
+    // representative of each structure by sequence id, in the order of seqDbr
+    std::vector<unsigned int> assignedCluster(dbSize, UINT_MAX);
+
+    StructureAlignmentGate gate;
+    gate.order.resize(dbSize);
+    for (size_t id = 0; id < dbSize; id++) {
+        const size_t prefId = prefReader.getId(seqDbr.getDbKey(id));
+        if (prefId == UINT_MAX) {
+            Debug(Debug::ERROR) << "Prefilter database " << prefDb << " does not contain an entry for every sequence\n";
+            EXIT(EXIT_FAILURE);
+        }
+        gate.order[id] = prefId;
+    }
+    gate.batchSize = BATCH_QUERIES_PER_THREAD * static_cast<size_t>(par.threads);
+    gate.isQueryNeeded = [&](unsigned int queryKey) {
+        return assignedCluster[seqDbr.getId(queryKey)] == UINT_MAX;
+    };
+    gate.isTargetDecided = [&](unsigned int targetKey) {
+        const size_t targetId = seqDbr.getId(targetKey);
+        return targetId == UINT_MAX || assignedCluster[targetId] != UINT_MAX;
+    };
+    // a representative needs one accepted hit besides itself
+    gate.minAcceptedHits = 2;
+
+    // accepted hits of the structures in the current batch
+    std::vector<std::vector<unsigned int>> batchHits(gate.batchSize);
+    size_t currentBatchStart = 0;
+    gate.batchDone = [&](size_t batchStart, size_t batchEnd) {
+        for (size_t id = batchStart; id < batchEnd; id++) {
+            std::vector<unsigned int> &hits = batchHits[id - batchStart];
+            if (assignedCluster[id] == UINT_MAX && hits.size() > 1) {
+                for (size_t i = 0; i < hits.size(); i++) {
+                    const size_t memberId = seqDbr.getId(hits[i]);
+                    if (memberId != UINT_MAX && assignedCluster[memberId] == UINT_MAX) {
+                        assignedCluster[memberId] = id;
+                    }
+                }
+            }
+            hits.clear();
+        }
+        currentBatchStart = batchEnd;
+    };
+
+    alignStructureResults(par, prefReader, 0, prefReader.getSize(), false,
+                          [&](const char *entry, size_t, unsigned int key, unsigned int) {
+        std::vector<unsigned int> &hits = batchHits[seqDbr.getId(key) - currentBatchStart];
+        char *data = const_cast<char *>(entry);
+        char dbKey[255 + 1];
+        while (*data != '\0') {
+            Util::parseKey(data, dbKey);
+            hits.push_back(Util::fast_atoi<unsigned int>(dbKey));
+            data = Util::skipLine(data);
+        }
+    }, &gate);
+    prefReader.close();
+
+    std::pair<unsigned int, unsigned int> *assignment = new std::pair<unsigned int, unsigned int>[dbSize];
+    for (size_t id = 0; id < dbSize; id++) {
+        const unsigned int representative = (assignedCluster[id] == UINT_MAX) ? id : assignedCluster[id];
+        assignment[id].first = seqDbr.getDbKey(representative);
+        assignment[id].second = seqDbr.getDbKey(id);
+    }
+    SORT_PARALLEL(assignment, assignment + dbSize);
+
+    size_t clusterCount = (dbSize > 0) ? 1 : 0;
+    for (size_t i = 1; i < dbSize; i++) {
+        clusterCount += (assignment[i].first != assignment[i - 1].first);
+    }
+    Debug(Debug::INFO) << "Number of clusters: " << clusterCount << "\n";
+
+    DBWriter dbw(outDb.c_str(), outDbIndex.c_str(), 1, par.compressed, Parameters::DBTYPE_CLUSTER_RES);
+    dbw.open();
+    std::string result;
+    char buffer[32];
+    for (size_t i = 0; i < dbSize; i++) {
+        const unsigned int repKey = assignment[i].first;
+        if (i == 0 || repKey != assignment[i - 1].first) {
+            char *outpos = Itoa::u32toa_sse2(repKey, buffer);
+            result.append(buffer, (outpos - buffer - 1));
+            result.push_back('\n');
+        }
+        if (assignment[i].second != repKey) {
+            char *outpos = Itoa::u32toa_sse2(assignment[i].second, buffer);
+            result.append(buffer, (outpos - buffer - 1));
+            result.push_back('\n');
+        }
+        if (i + 1 == dbSize || assignment[i + 1].first != repKey) {
+            dbw.writeData(result.c_str(), result.length(), repKey, 0);
+            result.clear();
+        }
+    }
+    dbw.close();
+
+    delete[] assignment;
+    seqDbr.close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "DBWriter.h"
+#include "Debug.h"
+#include "Util.h"
+#include "itoa.h"
+#include "FastSort.h"
+#include "ClusteringAlgorithms.h"
+#include "StructureAlignStages.h"
+
+#ifdef OPENMP
+#include <omp.h>
+#endif
+
+static std::pair<unsigned int, unsigned int> *clusterResults(DBReader<unsigned int> &seqDbr, DBReader<unsigned int> &alnDbr, LocalParameters &par) {
+    ClusteringAlgorithms algorithm(&seqDbr, &alnDbr, par.threads, par.similarityScoreType, par.maxIteration);
+    if (par.clusteringMode == Parameters::GREEDY || par.clusteringMode == Parameters::GREEDY_MEM) {
+        return algorithm.execute(4);
+    } else if (par.clusteringMode == Parameters::SET_COVER) {
+        return algorithm.execute(1);
+    } else if (par.clusteringMode == Parameters::SET_COVER_PARALLEL) {
+        return algorithm.execute(5);
+    } else if (par.clusteringMode == Parameters::CONNECTED_COMPONENT) {
+        return algorithm.execute(3);
+    }
+    Debug(Debug::ERROR) << "Wrong clustering mode!\n";
+    EXIT(EXIT_FAILURE);
+}
+
+// appends the cluster starting at start in the same format as clust, representative first
+static void appendCluster(std::string &result, const std::pair<unsigned int, unsigned int> *clusters, size_t start, size_t size) {
+    char buffer[32];
+    const unsigned int repKey = clusters[start].first;
+    char *outpos = Itoa::u32toa_sse2(repKey, buffer);
+    result.append(buffer, (outpos - buffer - 1));
+    result.push_back('\n');
+    for (size_t i = start; i < size && clusters[i].first == repKey; i++) {
+        if (clusters[i].second != repKey) {
+            outpos = Itoa::u32toa_sse2(clusters[i].second, buffer);
+            result.append(buffer, (outpos - buffer - 1));
+            result.push_back('\n');
+        }
+    }
+}
+
+int structurelinclust(int argc, const char **argv, const Command &command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
+
+    // the sequence DB is aligned against itself, the stages read it from par.db1 and par.db2
+    const std::string prefDb = par.db2;
+    const std::string prefDbIndex = par.db2Index;
+    const std::string outDb = par.db3;
+    const std::string outDbIndex = par.db3Index;
+    par.db2 = par.db1;
+    par.db2Index = par.db1Index;
+
+    DBReader<unsigned int> seqDbr(par.db1.c_str(), par.db1Index.c_str(), par.threads, DBReader<unsigned int>::USE_INDEX);
+    seqDbr.open(DBReader<unsigned int>::SORT_BY_LENGTH);
+
+    DBReader<unsigned int> prefReader(prefDb.c_str(), prefDbIndex.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    prefReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+
+    // 1. rescore the k-mer matches along their diagonal and pre-cluster them
+    Debug(Debug::INFO) << "Rescore diagonals\n";
+    MemoryResultDB *rescored = new MemoryResultDB(par.threads);
+    const int addBacktrace = par.addBacktrace;
+    rescoreStructureDiagonals(par, prefReader, 0, prefReader.getSize(), rescored->writer());
+    par.addBacktrace = addBacktrace;
+    DBReader<unsigned int> *rescoredReader = rescored->getReader(Parameters::DBTYPE_ALIGNMENT_RES, par.threads);
+    if (seqDbr.getSize() != rescoredReader->getSize()) {
+        Debug(Debug::ERROR) << "Prefilter database " << prefDb << " does not contain an entry for every sequence\n";
+        EXIT(EXIT_FAILURE);
+    }
+    Debug(Debug::INFO) << "Pre-cluster rescored diagonals\n";
+    const size_t preSize = rescoredReader->getSize();
+    std::pair<unsigned int, unsigned int> *preClusters = clusterResults(seqDbr, *rescoredReader, par);
+    delete rescored;
+
+    // first entry of each pre-cluster by the sequence id of its representative
+    std::vector<size_t> preClusterStart(seqDbr.getSize(), SIZE_MAX);
+    size_t representatives = 0;
+    for (size_t i = 0; i < preSize; i++) {
+        if (i == 0 || preClusters[i].first != preClusters[i - 1].first) {
+            preClusterStart[seqDbr.getId(preClusters[i].first)] = i;
+            representatives++;
+        }
+    }
+    Debug(Debug::INFO) << "Number of pre-clusters: " << representatives << "\n";
+
+    // 2. align the k-mer matches between pre-cluster representatives
+    Debug(Debug::INFO) << "Align representatives\n";
+    MemoryResultDB *repPrefilter = new MemoryResultDB(par.threads);
+    Debug::Progress progress(seqDbr.getSize());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        char keyBuffer[255];
+        std::string result;
+#pragma omp for schedule(dynamic, 100)
+        for (size_t id = 0; id < seqDbr.getSize(); id++) {
+            progress.updateProgress();
+            if (preClusterStart[id] == SIZE_MAX) {
+                continue;
+            }
+            const unsigned int repKey = seqDbr.getDbKey(id);
+            const size_t prefId = prefReader.getId(repKey);
+            if (prefId == UINT_MAX) {
+                continue;
+            }
+            char *data = prefReader.getData(prefId, thread_idx);
+            while (*data != '\0') {
+                char *next = Util::skipLine(data);
+                Util::parseKey(data, keyBuffer);
+                const size_t targetId = seqDbr.getId(Util::fast_atoi<unsigned int>(keyBuffer));
+                if (targetId != UINT_MAX && preClusterStart[targetId] != SIZE_MAX) {
+                    result.append(data, next - data);
+                }
+                data = next;
+            }
+            repPrefilter->write(result.c_str(), result.length(), repKey, thread_idx);
+            result.clear();
+        }
+    }
+    prefReader.close();
+    DBReader<unsigned int> *repPrefilterReader = repPrefilter->getReader(Parameters::DBTYPE_PREFILTER_RES, par.threads);
+    MemoryResultDB *repAlignment = new MemoryResultDB(par.threads);
+    alignStructureResults(par, *repPrefilterReader, 0, repPrefilterReader->getSize(), false, repAlignment->writer());
+    delete repPrefilter;
+    DBReader<unsigned int> *repAlignmentReader = repAlignment->getReader(Parameters::DBTYPE_ALIGNMENT_RES, par.threads);
+
+    // 3. cluster the representatives, their sequence DB shares the index entries of the full one
+    DBReader<unsigned int>::Index *repIndex = new DBReader<unsigned int>::Index[representatives];
+    size_t repCount = 0;
+    for (size_t id = 0; id < seqDbr.getSize(); id++) {
+        if (preClusterStart[id] != SIZE_MAX) {
+            repIndex[repCount++] = *seqDbr.getIndex(id);
+        }
+    }
+    SORT_PARALLEL(repIndex, repIndex + repCount, DBReader<unsigned int>::Index::compareById);
+    DBReader<unsigned int> repDbr(repIndex, repCount, 0, (repCount > 0) ? repIndex[repCount - 1].id : 0,
+                                  seqDbr.getDbtype(), seqDbr.getMaxSeqLen(), par.threads);
+    repDbr.open(DBReader<unsigned int>::SORT_BY_LENGTH);
+    repDbr.sortIndex(true);
+    if (repDbr.getSize() != repAlignmentReader->getSize()) {
+        Debug(Debug::ERROR) << "Prefilter database " << prefDb << " does not contain an entry for every representative\n";
+        EXIT(EXIT_FAILURE);
+    }
+    Debug(Debug::INFO) << "Cluster representatives\n";
+    const size_t repSize = repAlignmentReader->getSize();
+    std::pair<unsigned int, unsigned int> *repClusters = clusterResults(repDbr, *repAlignmentReader, par);
+    delete repAlignment;
+    repDbr.close();
+    delete[] repIndex;
+
+    // 4. merge both clusterings like mergeclusters, each member is followed by its pre-cluster
+    std::vector<size_t> clusterStart;
+    for (size_t i = 0; i < repSize; i++) {
+        if (i == 0 || repClusters[i].first != repClusters[i - 1].first) {
+            clusterStart.push_back(i);
+        }
+    }
+    Debug(Debug::INFO) << "Number of clusters: " << clusterStart.size() << "\n";
+
+    DBWriter dbw(outDb.c_str(), outDbIndex.c_str(), par.threads, par.compressed, Parameters::DBTYPE_CLUSTER_RES);
+    dbw.open();
+    progress.reset(clusterStart.size());
+#pragma omp parallel
+    {
+        unsigned int thread_idx = 0;
+#ifdef OPENMP
+        thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+        std::string result;
+#pragma omp for schedule(dynamic, 100)
+        for (size_t c = 0; c < clusterStart.size(); c++) {
+            progress.updateProgress();
+            const unsigned int repKey = repClusters[clusterStart[c]].first;
+            const size_t repStart = preClusterStart[seqDbr.getId(repKey)];
+            if (repStart != SIZE_MAX) {
+                appendCluster(result, preClusters, repStart, preSize);
+            }
+            for (size_t i = clusterStart[c]; i < repSize && repClusters[i].first == repKey; i++) {
+                if (repClusters[i].second == repKey) {
+                    continue;
+                }
+                const size_t memberStart = preClusterStart[seqDbr.getId(repClusters[i].second)];
+                if (memberStart != SIZE_MAX) {
+                    appendCluster(result, preClusters, memberStart, preSize);
+                }
+            }
+            dbw.writeData(result.c_str(), result.length(), repKey, thread_idx);
+            result.clear();
+        }
+    }
+    dbw.close();
+
+    delete[] repClusters;
+    delete[] preClusters;
+    seqDbr.close();
+    return EXIT_SUCCESS;
+}
@@ -14,45 +14,128 @@
 #include "TMaligner.h"
 #include "Coordinate16.h"
 #include "LDDT.h"
+#include "StructureAlignStages.h"
 
 #ifdef OPENMP
 #include <omp.h>
 #endif
 
 
-template<typename T>
-static DistanceCalculator::LocalAlignment ungappedAlignment(const T *seq3Di1,
-                                                            const T *seqAA1,
-                                                            const T *seq3Di2,
-                                                            const T *seqAA2,
-                                                            const unsigned int length,
-                                                            short **sub3DiMat,
-                                                            short **subAAMat) {
-    int maxScore = 0;
-    int maxEndPos = 0;
-    int maxStartPos = 0;
-    int minPos = -1;
-//        int maxMinPos = 0;
-    int score = 0;
-    for(unsigned int pos = 0; pos < length; pos++){
-        int curr3Di = sub3DiMat[static_cast<int>(seq3Di1[pos])][static_cast<int>(seq3Di2[pos])];
-        int currAAi = subAAMat[static_cast<int>(seqAA1[pos])][static_cast<int>(seqAA2[pos])];
-        score = curr3Di + currAAi + score;
-        const bool isMinScore = (score <= 0);
-        score =  (isMinScore) ? 0 : score;
-        minPos = (isMinScore) ? pos : minPos;
-        const bool isNewMaxScore = (score > maxScore);
-        maxEndPos = (isNewMaxScore) ? pos : maxEndPos;
-        maxStartPos = (isNewMaxScore) ? minPos + 1 : maxStartPos;
-        maxScore = (isNewMaxScore)? score : maxScore;
+// Prefilter hits of a query that are rescored together
+static const size_t UNGAPPED_GROUP_SIZE = VECSIZE_INT;
+
+// Overlap of a target with the query on a prefilter diagonal, the query side is read forward and reversed
+struct UngappedDiagonal {
+    const unsigned char *query3Di;
+    const unsigned char *queryAA;
+    const unsigned char *queryRev3Di;
+    const unsigned char *queryRevAA;
+    const unsigned char *target3Di;
+    const unsigned char *targetAA;
+    unsigned int length;
+};
+
+// Local ungapped alignment of the forward and reversed query on each diagonal, VECSIZE_INT lanes at once.
+// Each lane follows the scalar recurrence: the score restarts after dropping to zero and the first maximum is kept.
+// sub3Di and subAA are row-major substitution matrices. laneScores holds the substitution scores of a block
+// position-major and needs room for the longest diagonal.
+static void ungappedAlignmentLanes(const UngappedDiagonal *diagonals, size_t diagonalCount,
+                                   const short *sub3Di, int alphabetSize3Di, const short *subAA, int alphabetSizeAA,
+                                   int *laneScores, DistanceCalculator::LocalAlignment *forward,
+                                   DistanceCalculator::LocalAlignment *reverse) {
+    const size_t diagonalsPerBlock = VECSIZE_INT / 2;
+    int laneLengths[VECSIZE_INT] __attribute__((aligned(ALIGN_INT)));
+    int laneMaxScore[VECSIZE_INT] __attribute__((aligned(ALIGN_INT)));
+    int laneMaxStartPos[VECSIZE_INT] __attribute__((aligned(ALIGN_INT)));
+    int laneMaxEndPos[VECSIZE_INT] __attribute__((aligned(ALIGN_INT)));
+    const simd_int zero = simdi_setzero();
+    const simd_int one = simdi32_set(1);
+    for (size_t first = 0; first < diagonalCount; first += diagonalsPerBlock) {
+        const UngappedDiagonal *block = diagonals + first;
+        const size_t blockSize = std::min(diagonalCount - first, diagonalsPerBlock);
+        unsigned int maxLength = 0;
+        for (size_t i = 0; i < blockSize; i++) {
+            maxLength = std::max(maxLength, block[i].length);
+        }
+        for (size_t i = 0; i < diagonalsPerBlock; i++) {
+            const unsigned int length = (i < blockSize) ? block[i].length : 0;
+            laneLengths[2 * i] = static_cast<int>(length);
+            laneLengths[2 * i + 1] = static_cast<int>(length);
+            int *scores = laneScores + 2 * i;
+            if (length > 0) {
+                const UngappedDiagonal &diagonal = block[i];
+                for (unsigned int pos = 0; pos < length; pos++) {
+                    const short *column3Di = sub3Di + diagonal.target3Di[pos];
+                    const short *columnAA = subAA + diagonal.targetAA[pos];
+                    scores[pos * VECSIZE_INT] = column3Di[diagonal.query3Di[pos] * alphabetSize3Di]
+                                              + columnAA[diagonal.queryAA[pos] * alphabetSizeAA];
+                    scores[pos * VECSIZE_INT + 1] = column3Di[diagonal.queryRev3Di[pos] * alphabetSize3Di]
+                                                  + columnAA[diagonal.queryRevAA[pos] * alphabetSizeAA];
+                }
+            }
+            for (unsigned int pos = length; pos < maxLength; pos++) {
+                scores[pos * VECSIZE_INT] = 0;
+                scores[pos * VECSIZE_INT + 1] = 0;
+            }
+        }
+        const simd_int length = simdi_load((simd_int *) laneLengths);
+        simd_int score = zero;
+        simd_int maxScore = zero;
+        simd_int maxStartPos = zero;
+        simd_int maxEndPos = zero;
+        simd_int minPos = simdi32_set(-1);
+        simd_int position = zero;
+        for (unsigned int pos = 0; pos < maxLength; pos++) {
+            score = simdi32_add(score, simdi_load((simd_int *) (laneScores + pos * VECSIZE_INT)));
+            const simd_int isPositive = simdi32_gt(score, zero);
+            score = simdi_and(score, isPositive);
+            minPos = simdi_or(simdi_and(isPositive, minPos), simdi_andnot(isPositive, position));
+            // lanes past their diagonal length add zeros and must not move their maximum
+            const simd_int isNewMaxScore = simdi_and(simdi32_gt(score, maxScore), simdi32_gt(length, position));
+            maxEndPos = simdi_or(simdi_and(isNewMaxScore, position), simdi_andnot(isNewMaxScore, maxEndPos));
+            maxStartPos = simdi_or(simdi_and(isNewMaxScore, simdi32_add(minPos, one)), simdi_andnot(isNewMaxScore, maxStartPos));
+            maxScore = simdi_or(simdi_and(isNewMaxScore, score), simdi_andnot(isNewMaxScore, maxScore));
+            position = simdi32_add(position, one);
+        }
+        simdi_store((simd_int *) laneMaxScore, maxScore);
+        simdi_store((simd_int *) laneMaxStartPos, maxStartPos);
+        simdi_store((simd_int *) laneMaxEndPos, maxEndPos);
+        for (size_t i = 0; i < blockSize; i++) {
+            forward[first + i] = DistanceCalculator::LocalAlignment(laneMaxStartPos[2 * i], laneMaxEndPos[2 * i], laneMaxScore[2 * i]);
+            reverse[first + i] = DistanceCalculator::LocalAlignment(laneMaxStartPos[2 * i + 1], laneMaxEndPos[2 * i + 1], laneMaxScore[2 * i + 1]);
+        }
+    }
+}
+
+// Sets up the overlap of a prefilter diagonal, returns false if it does not overlap both structures
+static bool ungappedDiagonal(Sequence &qSeqAA, Sequence &qSeq3Di, Sequence &qRevSeqAA, Sequence &qRevSeq3Di,
+                             Sequence &tSeqAA, Sequence &tSeq3Di, int diagonal, UngappedDiagonal &overlap) {
+    unsigned int minDistToDiagonal = abs(diagonal);
+    if (diagonal >= 0 && minDistToDiagonal < static_cast<unsigned int>(qSeqAA.L)) {
+        overlap.query3Di = qSeq3Di.numSequence + minDistToDiagonal;
+        overlap.queryAA = qSeqAA.numSequence + minDistToDiagonal;
+        overlap.queryRev3Di = qRevSeq3Di.numSequence + minDistToDiagonal;
+        overlap.queryRevAA = qRevSeqAA.numSequence + minDistToDiagonal;
+        overlap.target3Di = tSeq3Di.numSequence;
+        overlap.targetAA = tSeqAA.numSequence;
+        overlap.length = std::min(static_cast<unsigned int>(tSeqAA.L), static_cast<unsigned int>(qSeqAA.L) - minDistToDiagonal);
+        return true;
+    } else if (diagonal < 0 && minDistToDiagonal < static_cast<unsigned int>(tSeqAA.L)) {
+        overlap.query3Di = qSeq3Di.numSequence;
+        overlap.queryAA = qSeqAA.numSequence;
+        overlap.queryRev3Di = qRevSeq3Di.numSequence;
+        overlap.queryRevAA = qRevSeqAA.numSequence;
+        overlap.target3Di = tSeq3Di.numSequence + minDistToDiagonal;
+        overlap.targetAA = tSeqAA.numSequence + minDistToDiagonal;
+        overlap.length = std::min(tSeqAA.L - minDistToDiagonal, static_cast<unsigned int>(qSeqAA.L));
+        return true;
     }
-    return DistanceCalculator::LocalAlignment(maxStartPos, maxEndPos, maxScore);
+    return false;
 }
 
-Matcher::result_t ungappedAlignStructure(Sequence & qSeqAA, Sequence & qSeq3Di, Sequence & qRevSeqAA, Sequence & qRevSeq3Di,
-                                         Sequence & tSeqAA, Sequence & tSeq3Di, int diagonal, SubstitutionMatrix & subAAMat,
-                                         SubstitutionMatrix & sub3DiMat, EvalueNeuralNet & evaluer,
-                                         std::pair<double, double> muLambda, std::string & backtrace, Parameters & par) {
+Matcher::result_t ungappedAlignStructure(Sequence & qSeqAA, Sequence & tSeqAA, int diagonal, bool isOverlapping,
+                                         const DistanceCalculator::LocalAlignment &forward, const DistanceCalculator::LocalAlignment &reverse,
+                                         EvalueNeuralNet & evaluer, std::pair<double, double> muLambda, std::string & backtrace, Parameters & par) {
     DistanceCalculator::LocalAlignment res;
     float seqId = 0.0;
     int32_t score = 0;
@@ -60,56 +143,16 @@ Matcher::result_t ungappedAlignStructure(Sequence & qSeqAA, Sequence & qSeq3Di,
     unsigned int minDistToDiagonal = abs(diagonal);
     res.distToDiagonal = minDistToDiagonal;
     res.diagonal = diagonal;
-    if (diagonal >= 0 && minDistToDiagonal < static_cast<unsigned int>(qSeqAA.L)) {
-        unsigned int minSeqLen = std::min(static_cast<unsigned int>(tSeqAA.L), static_cast<unsigned int>(qSeqAA.L) - minDistToDiagonal);
-        res.diagonalLen = minSeqLen;
-        DistanceCalculator::LocalAlignment tmp = ungappedAlignment(qSeq3Di.numSequence + minDistToDiagonal,
-                                                                   qSeqAA.numSequence + minDistToDiagonal,
-                                                                   tSeq3Di.numSequence,
-                                                                   tSeqAA.numSequence,
-                                                                   minSeqLen, sub3DiMat.subMatrix, subAAMat.subMatrix);
-
-        res.score = tmp.score;
-        res.startPos = tmp.startPos;
-        res.endPos = tmp.endPos;
-
-        DistanceCalculator::LocalAlignment revTmp = ungappedAlignment(qRevSeq3Di.numSequence + minDistToDiagonal,
-                                                                      qRevSeqAA.numSequence + minDistToDiagonal,
-                                                                      tSeq3Di.numSequence,
-                                                                      tSeqAA.numSequence,
-                                                                      minSeqLen, sub3DiMat.subMatrix, subAAMat.subMatrix);
-
-        score = static_cast<int32_t>(tmp.score) - static_cast<int32_t>(revTmp.score);
-
-
-    } else if (diagonal < 0 && minDistToDiagonal < static_cast<unsigned int>(tSeqAA.L)) {
-        unsigned int minSeqLen = std::min(tSeqAA.L - minDistToDiagonal, static_cast<unsigned int>(qSeqAA.L));
-        res.diagonalLen = minSeqLen;
-        DistanceCalculator::LocalAlignment tmp = ungappedAlignment(qSeq3Di.numSequence, qSeqAA.numSequence,
-                                                                   tSeq3Di.numSequence + minDistToDiagonal,
-                                                                   tSeqAA.numSequence + minDistToDiagonal,
-                                                                   minSeqLen,sub3DiMat.subMatrix, subAAMat.subMatrix);
-        res.score = tmp.score;
-        res.startPos = tmp.startPos;
-        res.endPos = tmp.endPos;
-
-        DistanceCalculator::LocalAlignment revTmp = ungappedAlignment(qRevSeq3Di.numSequence, qSeqAA.numSequence,
-                                                                      qRevSeqAA.numSequence + minDistToDiagonal,
-                                                                      tSeqAA.numSequence + minDistToDiagonal,
-                                                                      minSeqLen, sub3DiMat.subMatrix, subAAMat.subMatrix);
-
-
-        score = static_cast<int32_t>(tmp.score) - static_cast<int32_t>(revTmp.score);
-
+    if (isOverlapping) {
+        res.score = forward.score;
+        res.startPos = forward.startPos;
+        res.endPos = forward.endPos;
+        score = static_cast<int32_t>(forward.score) - static_cast<int32_t>(reverse.score);
     }
 
     double evalue = evaluer.computeEvalueCorr(score, muLambda.first, muLambda.second);
 
     unsigned int distanceToDiagonal = res.distToDiagonal;
-    int diagonalLen = res.diagonalLen;
-    float targetCov = static_cast<float>(diagonalLen) / static_cast<float>(tSeqAA.L);
-    float queryCov = static_cast<float>(diagonalLen) / static_cast<float>(qSeqAA.L);
-
     Matcher::result_t result;
     int qStartPos, qEndPos, dbStartPos, dbEndPos;
     // -1 since diagonal is computed from sequence Len which starts by 1
@@ -129,8 +172,8 @@ Matcher::result_t ungappedAlignStructure(Sequence & qSeqAA, Sequence & qSeq3Di,
         backtrace.append(alnLength, 'M');
     }
 
-    queryCov = SmithWaterman::computeCov(qStartPos, qEndPos, qSeqAA.L);
-    targetCov = SmithWaterman::computeCov(dbStartPos, dbEndPos, tSeqAA.L);
+    float queryCov = SmithWaterman::computeCov(qStartPos, qEndPos, qSeqAA.L);
+    float targetCov = SmithWaterman::computeCov(dbStartPos, dbEndPos, tSeqAA.L);
 
     bool hasLowerCoverage = !(Util::hasCoverage(par.covThr, par.covMode, queryCov, targetCov));
     if(hasLowerCoverage){
@@ -155,10 +198,7 @@ Matcher::result_t ungappedAlignStructure(Sequence & qSeqAA, Sequence & qSeq3Di,
 }
 
 
-int structureungappedalign(int argc, const char **argv, const Command& command) {
-    LocalParameters &par = LocalParameters::getLocalInstance();
-    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
-
+void rescoreStructureDiagonals(LocalParameters &par, DBReader<unsigned int> &resultReader, size_t dbFrom, size_t dbSize, const StructureResultWriter &writer) {
     const bool touch = (par.preloadMode != Parameters::PRELOAD_MODE_MMAP);
     IndexReader qdbrAA(par.db1, par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
     IndexReader qdbr3Di(StructureUtil::getIndexWithSuffix(par.db1, "_ss"), par.threads, IndexReader::SEQUENCES, touch ? IndexReader::PRELOAD_INDEX : 0);
@@ -204,12 +244,6 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
     }
 
 
-    DBReader<unsigned int> resultReader(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
-    resultReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
-
-    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed,  Parameters::DBTYPE_ALIGNMENT_RES);
-    dbw.open();
-
     SubstitutionMatrix subMat3Di(par.scoringMatrixFile.values.aminoacid().c_str(), 2.1, par.scoreBias);
     std::string blosum;
     for (size_t i = 0; i < par.substitutionMatrices.size(); i++) {
@@ -225,23 +259,28 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
     float aaFactor = (par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA) ? 1.4 : 0.0;
     SubstitutionMatrix subMatAA(blosum.c_str(), aaFactor, par.scoreBias);
     //temporary output file
-    Debug::Progress progress(resultReader.getSize());
+    Debug::Progress progress(dbSize);
 
-    // sub. mat needed for query profile
-    int8_t * tinySubMatAA = (int8_t*) mem_align(ALIGN_INT, subMatAA.alphabetSize * 32);
-    int8_t * tinySubMat3Di = (int8_t*) mem_align(ALIGN_INT, subMat3Di.alphabetSize * 32);
+    // sub. mats flattened for the ungapped lanes
+    short * flatSubMatAA = (short*) mem_align(ALIGN_INT, subMatAA.alphabetSize * subMatAA.alphabetSize * sizeof(short));
+    short * flatSubMat3Di = (short*) mem_align(ALIGN_INT, subMat3Di.alphabetSize * subMat3Di.alphabetSize * sizeof(short));
 
     for (int i = 0; i < subMat3Di.alphabetSize; i++) {
         for (int j = 0; j < subMat3Di.alphabetSize; j++) {
-            tinySubMat3Di[i * subMat3Di.alphabetSize + j] = subMat3Di.subMatrix[i][j]; // for farrar profile
+            flatSubMat3Di[i * subMat3Di.alphabetSize + j] = subMat3Di.subMatrix[i][j];
         }
     }
     for (int i = 0; i < subMatAA.alphabetSize; i++) {
         for (int j = 0; j < subMatAA.alphabetSize; j++) {
-            tinySubMatAA[i * subMatAA.alphabetSize + j] = subMatAA.subMatrix[i][j];
+            flatSubMatAA[i * subMatAA.alphabetSize + j] = subMatAA.subMatrix[i][j];
         }
     }
 
+    // mu/lambda of all queries are predicted up front in batches of the e-value network
+    std::vector<std::pair<double, double>> queryMuLambda = EvalueNeuralNet::predictQueries(resultReader, *qdbr3Di.sequenceReader, qdbr3Di.getDbtype(), &subMat3Di,
+                                                                                           tAADbr->sequenceReader->getAminoAcidDBSize(), par.maxSeqLen, par.compBiasCorrection,
+                                                                                           EvalueNeuralNet::muLambdaDbName(par.db1));
+
 #pragma omp parallel
     {
         unsigned int thread_idx = 0;
@@ -250,15 +289,24 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
 #endif
         EvalueNeuralNet evaluer(tAADbr->sequenceReader->getAminoAcidDBSize(), &subMat3Di);
         std::vector<Matcher::result_t> alignmentResult;
-        StructureSmithWaterman structureSmithWaterman(par.maxSeqLen, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, NULL, NULL);
-        StructureSmithWaterman reverseStructureSmithWaterman(par.maxSeqLen, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, NULL, NULL);
 
         Sequence qSeqAA(par.maxSeqLen, qdbrAA.getDbtype(), (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
         Sequence qSeq3Di(par.maxSeqLen, qdbr3Di.getDbtype(), (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
         Sequence qRevSeqAA(par.maxSeqLen, qdbrAA.getDbtype(), (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
         Sequence qRevSeq3Di(par.maxSeqLen, qdbr3Di.getDbtype(), (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
-        Sequence tSeqAA(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
-        Sequence tSeq3Di(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
+        Sequence *tSeqAA[UNGAPPED_GROUP_SIZE];
+        Sequence *tSeq3Di[UNGAPPED_GROUP_SIZE];
+        for (size_t i = 0; i < UNGAPPED_GROUP_SIZE; i++) {
+            tSeqAA[i] = new Sequence(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMatAA, 0, false, par.compBiasCorrection);
+            tSeq3Di[i] = new Sequence(par.maxSeqLen, Parameters::DBTYPE_AMINO_ACIDS, (const BaseMatrix *) &subMat3Di, 0, false, par.compBiasCorrection);
+        }
+        hit_t groupHits[UNGAPPED_GROUP_SIZE];
+        bool groupOverlapping[UNGAPPED_GROUP_SIZE];
+        UngappedDiagonal groupDiagonals[UNGAPPED_GROUP_SIZE];
+        DistanceCalculator::LocalAlignment groupForward[UNGAPPED_GROUP_SIZE];
+        DistanceCalculator::LocalAlignment groupReverse[UNGAPPED_GROUP_SIZE];
+        const size_t maxDiagonalLen = std::max(qdbr3Di.sequenceReader->getMaxSeqLen(), t3DiDbr->sequenceReader->getMaxSeqLen()) + 1;
+        int *laneScores = (int *) mem_align(ALIGN_INT, maxDiagonalLen * VECSIZE_INT * sizeof(int));
         TMaligner *tmaligner = NULL;
         if(needTMaligner) {
             tmaligner = new TMaligner(
@@ -279,7 +327,7 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
         // write output file
 
 #pragma omp for schedule(dynamic, 1)
-        for (size_t id = 0; id < resultReader.getSize(); id++) {
+        for (size_t id = dbFrom; id < (dbFrom + dbSize); id++) {
             progress.updateProgress();
             char *data = resultReader.getData(id, thread_idx);
             size_t queryKey = resultReader.getDbKey(id);
@@ -306,69 +354,87 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
                 }
                 qRevSeq3Di.mapSequence(id, queryKey, querySeq3Di, querySeqLen);
                 qRevSeqAA.mapSequence(id, queryKey, querySeqAA, querySeqLen);
-                std::pair<double, double> muLambda = evaluer.predictMuLambda(qSeq3Di.numSequence, qSeq3Di.L);
-                structureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+                std::pair<double, double> muLambda = queryMuLambda[id];
                 qRevSeq3Di.reverse();
                 qRevSeqAA.reverse();
-                reverseStructureSmithWaterman.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
                 int passedNum = 0;
                 int rejected = 0;
                 while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
-                    hit_t prefHit = QueryMatcher::parsePrefilterHit(data);
-                    data = Util::skipLine(data);
-                    const unsigned int dbKey = prefHit.seqId;
-                    unsigned int targetId = t3DiDbr->sequenceReader->getId(dbKey);
-                    const bool isIdentity = (queryId == targetId && (par.includeIdentity || sameDB))? true : false;
-
-                    char * targetSeq3Di = t3DiDbr->sequenceReader->getData(targetId, thread_idx);
-                    char * targetSeqAA = tAADbr->sequenceReader->getData(targetId, thread_idx);
-                    const int targetSeqLen = static_cast<int>(t3DiDbr->sequenceReader->getSeqLen(targetId));
-
-                    tSeq3Di.mapSequence(targetId, dbKey, targetSeq3Di, targetSeqLen);
-                    tSeqAA.mapSequence(targetId, dbKey, targetSeqAA, targetSeqLen);
-                    if(Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, targetSeqLen) == false){
-                        rejected++;
-                        continue;
+                    // the center of a k-mer group is rescored against the next members together
+                    size_t groupSize = 0;
+                    size_t diagonalCount = 0;
+                    while (*data != '\0' && groupSize < UNGAPPED_GROUP_SIZE) {
+                        hit_t &prefHit = groupHits[groupSize];
+                        prefHit = QueryMatcher::parsePrefilterHit(data);
+                        data = Util::skipLine(data);
+                        const unsigned int dbKey = prefHit.seqId;
+                        unsigned int targetId = t3DiDbr->sequenceReader->getId(dbKey);
+                        char * targetSeq3Di = t3DiDbr->sequenceReader->getData(targetId, thread_idx);
+                        char * targetSeqAA = tAADbr->sequenceReader->getData(targetId, thread_idx);
+                        const int targetSeqLen = static_cast<int>(t3DiDbr->sequenceReader->getSeqLen(targetId));
+                        tSeq3Di[groupSize]->mapSequence(targetId, dbKey, targetSeq3Di, targetSeqLen);
+                        tSeqAA[groupSize]->mapSequence(targetId, dbKey, targetSeqAA, targetSeqLen);
+                        groupOverlapping[groupSize] = Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, targetSeqLen)
+                                                      && ungappedDiagonal(qSeqAA, qSeq3Di, qRevSeqAA, qRevSeq3Di, *tSeqAA[groupSize], *tSeq3Di[groupSize],
+                                                                          static_cast<short>(prefHit.diagonal), groupDiagonals[diagonalCount]);
+                        diagonalCount += groupOverlapping[groupSize] ? 1 : 0;
+                        groupSize++;
                     }
-                    Matcher::result_t res = ungappedAlignStructure(qSeqAA, qSeq3Di, qRevSeqAA, qRevSeq3Di, tSeqAA, tSeq3Di, static_cast<short>(prefHit.diagonal), subMatAA, subMat3Di, evaluer, muLambda, backtrace, par);
-
-                    if(res.dbKey == UINT_MAX){
-                        rejected++;
-                        continue;
-                    }
-
-                    if(needTMaligner) {
-                        size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
-                        char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
-                        size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
-                        float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
-                        TMaligner::TMscoreResult tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
-                                                                                   res.qStartPos, res.dbStartPos, Matcher::uncompressAlignment(res.backtrace),
-                                                                                   TMaligner::normalization(par.tmScoreThrMode, std::min(res.qEndPos - res.qStartPos, res.dbEndPos - res.dbStartPos ), res.qLen, res.dbLen));
-                        if(tmres.tmscore < par.tmScoreThr){
+                    ungappedAlignmentLanes(groupDiagonals, diagonalCount, flatSubMat3Di, subMat3Di.alphabetSize, flatSubMatAA, subMatAA.alphabetSize,
+                                           laneScores, groupForward, groupReverse);
+
+                    size_t diagonal = 0;
+                    for (size_t member = 0; member < groupSize && passedNum < par.maxAccept && rejected < par.maxRejected; member++) {
+                        const hit_t &prefHit = groupHits[member];
+                        unsigned int targetId = tSeqAA[member]->getId();
+                        const bool isIdentity = (queryId == targetId && (par.includeIdentity || sameDB))? true : false;
+                        if(Util::canBeCovered(par.covThr, par.covMode, qSeq3Di.L, tSeq3Di[member]->L) == false){
+                            rejected++;
                             continue;
                         }
-                    }
-                    if(needLDDT){
-                        size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
-                        char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
-                        size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
-                        float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
-                        LDDTCalculator::LDDTScoreResult lddtres = lddtcalculator->computeLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos,
-                                                                   res.backtrace,
-                                                                   targetCaData, &targetCaData[res.dbLen],
-                                                                   &targetCaData[res.dbLen+res.dbLen]);
-                        if(lddtres.avgLddtScore < par.lddtThr){
+                        const bool isOverlapping = groupOverlapping[member];
+                        Matcher::result_t res = ungappedAlignStructure(qSeqAA, *tSeqAA[member], static_cast<short>(prefHit.diagonal), isOverlapping,
+                                                                       groupForward[diagonal], groupReverse[diagonal], evaluer, muLambda, backtrace, par);
+                        diagonal += isOverlapping ? 1 : 0;
+
+                        if(res.dbKey == UINT_MAX){
+                            rejected++;
                             continue;
                         }
-                    }
 
-                    if (Alignment::checkCriteria(res, isIdentity, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
-                        alignmentResult.emplace_back(res);
-                        passedNum++;
-                        rejected = 0;
-                    } else {
-                        rejected++;
+                        if(needTMaligner) {
+                            size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
+                            char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
+                            size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
+                            float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
+                            TMaligner::TMscoreResult tmres = tmaligner->computeTMscore(targetCaData, &targetCaData[res.dbLen], &targetCaData[res.dbLen+res.dbLen], res.dbLen,
+                                                                                       res.qStartPos, res.dbStartPos, res.backtrace,
+                                                                                       TMaligner::normalization(par.tmScoreThrMode, std::min(res.qEndPos - res.qStartPos, res.dbEndPos - res.dbStartPos ), res.qLen, res.dbLen));
+                            if(tmres.tmscore < par.tmScoreThr){
+                                continue;
+                            }
+                        }
+                        if(needLDDT){
+                            size_t tId = tcadbr->sequenceReader->getId(res.dbKey);
+                            char *tcadata = tcadbr->sequenceReader->getData(tId, thread_idx);
+                            size_t tCaLength = tcadbr->sequenceReader->getEntryLen(tId);
+                            float* targetCaData = tcoords.read(tcadata, res.dbLen, tCaLength);
+                            LDDTCalculator::LDDTScoreResult lddtres = lddtcalculator->computeLDDTScore(res.dbLen, res.qStartPos, res.dbStartPos,
+                                                                       res.backtrace,
+                                                                       targetCaData, &targetCaData[res.dbLen],
+                                                                       &targetCaData[res.dbLen+res.dbLen]);
+                            if(lddtres.avgLddtScore < par.lddtThr){
+                                continue;
+                            }
+                        }
+
+                        if (Alignment::checkCriteria(res, isIdentity, par.evalThr, par.seqIdThr, par.alnLenThr, par.covMode, par.covThr)) {
+                            alignmentResult.emplace_back(res);
+                            passedNum++;
+                            rejected = 0;
+                        } else {
+                            rejected++;
+                        }
                     }
                 }
             }
@@ -381,10 +447,15 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
                 size_t len = Matcher::resultToBuffer(buffer, alignmentResult[result], par.addBacktrace);
                 resultBuffer.append(buffer, len);
             }
-            dbw.writeData(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
+            writer(resultBuffer.c_str(), resultBuffer.length(), queryKey, thread_idx);
             resultBuffer.clear();
             alignmentResult.clear();
         }
+        free(laneScores);
+        for (size_t i = 0; i < UNGAPPED_GROUP_SIZE; i++) {
+            delete tSeqAA[i];
+            delete tSeq3Di[i];
+        }
         if(needTMaligner){
             delete tmaligner;
         }
@@ -393,14 +464,57 @@ int structureungappedalign(int argc, const char **argv, const Command& command)
         }
     }
 
-    free(tinySubMatAA);
-    free(tinySubMat3Di);
+    free(flatSubMatAA);
+    free(flatSubMat3Di);
 
-    dbw.close();
-    resultReader.close();
+    if (needTMaligner || needLDDT) {
+        if (sameDB == false) {
+            delete tcadbr;
+        }
+        delete qcadbr;
+    }
     if (sameDB == false) {
         delete t3DiDbr;
         delete tAADbr;
     }
+}
+
+int structureungappedalign(int argc, const char **argv, const Command& command) {
+    MMseqsMPI::init(argc, argv);
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
+
+    DBReader<unsigned int> resultReader(par.db3.c_str(), par.db3Index.c_str(), par.threads, DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+    resultReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+
+#ifdef HAVE_MPI
+    size_t dbFrom = 0;
+    size_t dbSize = 0;
+    resultReader.decomposeDomainByAminoAcid(MMseqsMPI::rank, MMseqsMPI::numProc, &dbFrom, &dbSize);
+    std::pair<std::string, std::string> tmpOutput = Util::createTmpFileNames(par.db4, par.db4Index, MMseqsMPI::rank);
+    DBWriter dbw(tmpOutput.first.c_str(), tmpOutput.second.c_str(), static_cast<unsigned int>(par.threads), par.compressed,  Parameters::DBTYPE_ALIGNMENT_RES);
+#else
+    size_t dbFrom = 0;
+    size_t dbSize = resultReader.getSize();
+    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), static_cast<unsigned int>(par.threads), par.compressed,  Parameters::DBTYPE_ALIGNMENT_RES);
+#endif
+    dbw.open();
+    rescoreStructureDiagonals(par, resultReader, dbFrom, dbSize, [&dbw](const char *data, size_t length, unsigned int key, unsigned int thread) {
+        dbw.writeData(data, length, key, thread);
+    });
+#ifdef HAVE_MPI
+    dbw.close(true);
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (MMseqsMPI::isMaster()) {
+        std::vector<std::pair<std::string, std::string>> splitFiles;
+        for (int proc = 0; proc < MMseqsMPI::numProc; ++proc) {
+            splitFiles.push_back(Util::createTmpFileNames(par.db4, par.db4Index, proc));
+        }
+        DBWriter::mergeResults(par.db4, par.db4Index, splitFiles);
+    }
+#else
+    dbw.close();
+#endif
+    resultReader.close();
     return EXIT_SUCCESS;
 }
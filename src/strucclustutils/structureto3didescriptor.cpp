@@ -55,6 +55,15 @@ int structureto3didescriptor(int argc, const char **argv, const Command& command
     DBWriter vec3di((outputName).c_str(), (outputName+".index").c_str(), static_cast<unsigned int>(par.threads), par.compressed, LocalParameters::DBTYPE_GENERIC_DB);
     vec3di.open();
 
+    // one entry of chain length times FEATURE_CNT float32 values per chain, keyed like the descriptor lines
+    const bool binaryFeatures = par.descriptorFormat == LocalParameters::DESCRIPTOR_FORMAT_BINARY;
+    DBWriter *featureWriter = NULL;
+    if (binaryFeatures) {
+        const std::string featureName = outputName + "_features";
+        featureWriter = new DBWriter(featureName.c_str(), (featureName + ".index").c_str(), static_cast<unsigned int>(par.threads), par.compressed, LocalParameters::DBTYPE_GENERIC_DB);
+        featureWriter->open();
+    }
+
     SubstitutionMatrix mat(par.scoringMatrixFile.values.aminoacid().c_str(), 2.0, par.scoreBias);
     Debug::Progress progress(filenames.size());
     std::vector<std::pair<size_t, size_t>> fileIdLookup(filenames.size());
@@ -63,7 +72,7 @@ int structureto3didescriptor(int argc, const char **argv, const Command& command
     size_t toShort = 0;
 
     //===================== single_process ===================//__110710__//
-#pragma omp parallel default(none) shared(par, vec3di, mat, filenames, progress, globalCnt, fileIdLookup) reduction(+:incorrectFiles, toShort)
+#pragma omp parallel default(none) shared(par, vec3di, featureWriter, binaryFeatures, mat, filenames, progress, globalCnt, fileIdLookup) reduction(+:incorrectFiles, toShort)
     {
         unsigned int thread_idx = 0;
 #ifdef OPENMP
@@ -78,6 +87,7 @@ int structureto3didescriptor(int argc, const char **argv, const Command& command
         std::string header;
         std::string name;
         std::string result;
+        std::vector<float> featureValues;
 
 #pragma omp for schedule(static)
         for (size_t i = 0; i < filenames.size(); i++) {
@@ -134,7 +144,7 @@ int structureto3didescriptor(int argc, const char **argv, const Command& command
                                                                &readStructure.c[chainStart],
                                                                &readStructure.cb[chainStart],
                                                                chainLen);
-                std::vector<StructureTo3Di::Feature> features = structureTo3Di.getFeatures();
+                const std::vector<StructureTo3Di::Feature> &features = structureTo3Di.getFeatures();
                 result.clear();
                 result.append(header);
                 result.push_back('\t');
@@ -145,19 +155,34 @@ int structureto3didescriptor(int argc, const char **argv, const Command& command
                 for (size_t j = 0; j < chainLen; j++) {
                     result.push_back(mat.num2aa[(size_t)seq3di[j]]);
                 }
-                result.push_back('\t');
-                for (size_t j = 0; j < features.size(); j++) {
-                    for(size_t f = 0; f < Alphabet3Di::FEATURE_CNT; f++){
-                        result.append(SSTR(features[j].f[f]));
-                        result.push_back(',');
+                if (binaryFeatures) {
+                    featureValues.clear();
+                    for (size_t j = 0; j < features.size(); j++) {
+                        for(size_t f = 0; f < Alphabet3Di::FEATURE_CNT; f++){
+                            featureValues.push_back(static_cast<float>(features[j].f[f]));
+                        }
                     }
+                    featureWriter->writeData((const char*)featureValues.data(), featureValues.size() * sizeof(float), dbKey, thread_idx);
+                    result.push_back('\n');
+                } else {
+                    result.push_back('\t');
+                    for (size_t j = 0; j < features.size(); j++) {
+                        for(size_t f = 0; f < Alphabet3Di::FEATURE_CNT; f++){
+                            result.append(SSTR(features[j].f[f]));
+                            result.push_back(',');
+                        }
+                    }
+                    result[result.size() - 1] = '\n';
                 }
-                result[result.size() - 1] = '\n';
                 vec3di.writeData((const char*)result.data(), result.size(), dbKey, thread_idx, false);
             }
         }
     }
     vec3di.close(true);
     FileUtil::remove((outputName+".index").c_str());
+    if (featureWriter != NULL) {
+        featureWriter->close();
+        delete featureWriter;
+    }
     return 0;
 }
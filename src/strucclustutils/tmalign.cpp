@@ -10,6 +10,7 @@
 #include "StructureSmithWaterman.h"
 #include "TMaligner.h"
 #include "Coordinate16.h"
+#include "StructureAlignStages.h"
 
 #ifdef OPENMP
 #include <omp.h>
@@ -28,6 +29,133 @@ bool compareHitsByTMScore(const Matcher::result_t &first, const Matcher::result_
     return first.dbKey < second.dbKey;
 }
 
+static Matcher::result_t alignTarget(LocalParameters &par, TMaligner *aligner, IndexReader *tdbr, IndexReader *tcadbr,
+                                     unsigned int queryId, int queryLen, bool sameDB, unsigned int dbKey,
+                                     const Matcher::result_t *seed, std::string &backtrace, unsigned int thread_idx) {
+    Matcher::result_t tmpResult;
+    unsigned int targetId = tdbr->sequenceReader->getId(dbKey);
+    bool isIdentity = ((queryId == targetId)
+                       && (par.includeIdentity || sameDB));
+    if (isIdentity) {
+        backtrace.clear();
+        backtrace.append(SSTR(queryLen));
+        backtrace.append(1, 'M');
+        return Matcher::result_t(dbKey, 100, 1.0, 1.0, 1.0,
+                                 1.0, std::max(queryLen, queryLen), 0, queryLen - 1,
+                                 queryLen, 0, queryLen - 1, queryLen, backtrace);
+    }
+    tmpResult.dbKey = dbKey;
+    char *targetSeq = tdbr->sequenceReader->getData(targetId, thread_idx);
+    int targetLen = static_cast<int>(tdbr->sequenceReader->getSeqLen(targetId));
+    if (!Util::canBeCovered(par.covThr, par.covMode, queryLen, targetLen)) {
+        tmpResult.eval = -1.0f; // this should avoid that the hit is added
+        tmpResult.score = -1.0f;
+        tmpResult.seqId = -1.0f;
+        tmpResult.qcov = 0.0f;
+        tmpResult.dbcov = 0.0f;
+        return tmpResult;
+    }
+    char *tcadata = tcadbr->sequenceReader->getData(targetId, thread_idx);
+    size_t tCaLength = tcadbr->sequenceReader->getEntryLen(targetId);
+
+    Coordinate16::read(tcadata, targetLen, tCaLength,
+                       aligner->getTargetX(), aligner->getTargetY(), aligner->getTargetZ());
+
+    float TMscore;
+    if (seed != NULL && seed->backtrace.empty() == false) {
+        tmpResult = aligner->align(dbKey,
+                                   aligner->getTargetX(), aligner->getTargetY(),
+                                   aligner->getTargetZ(),
+                                   targetSeq, targetLen, seed->qStartPos, seed->dbStartPos,
+                                   seed->backtrace, TMscore);
+    } else {
+        tmpResult = aligner->align(dbKey,
+                                   aligner->getTargetX(), aligner->getTargetY(),
+                                   aligner->getTargetZ(),
+                                   targetSeq, targetLen, TMscore);
+    }
+    // TM-align could not align
+    if (TMscore == std::numeric_limits<float>::min()) {
+        tmpResult.eval = -1.0f; // this should avoid that the hit is added
+        tmpResult.score = -1.0f;
+        tmpResult.seqId = -1.0f;
+        tmpResult.qcov = 0.0f;
+        tmpResult.dbcov = 0.0f;
+    } else {
+        float qTM = (float) tmpResult.score / 100000.0f;
+        float tTM = tmpResult.eval;
+        switch (par.tmAlignHitOrder) {
+            case LocalParameters::TMALIGN_HIT_ORDER_AVG:
+                tmpResult.eval = (qTM + tTM) / 2.0f;
+                break;
+            case LocalParameters::TMALIGN_HIT_ORDER_QUERY:
+                tmpResult.eval = qTM;
+                break;
+            case LocalParameters::TMALIGN_HIT_ORDER_TARGET:
+                tmpResult.eval = tTM;
+                break;
+            case LocalParameters::TMALIGN_HIT_ORDER_MIN:
+                tmpResult.eval = std::min(qTM, tTM);
+                break;
+            case LocalParameters::TMALIGN_HIT_ORDER_MAX:
+                tmpResult.eval = std::max(qTM, tTM);
+                break;
+        }
+        tmpResult.score = static_cast<int>(qTM * 100.0f); // e.g. scaled
+    }
+    return tmpResult;
+}
+
+static bool acceptHit(LocalParameters &par, const Matcher::result_t &r) {
+    bool hasCov    = Util::hasCoverage(par.covThr, par.covMode, r.qcov, r.dbcov);
+    bool hasSeqId  = (r.seqId >= (par.seqIdThr - std::numeric_limits<float>::epsilon()));
+    bool hasTMscore= (r.eval >= par.tmScoreThr);
+    return hasCov && hasSeqId && hasTMscore;
+}
+
+// hits of the query in the pair cache that pass the current thresholds, sorted by target key
+static void readCachedHits(LocalParameters &par, DBReader<unsigned int> *cacheReader, unsigned int queryKey,
+                           std::vector<Matcher::result_t> &cachedHits, unsigned int thread_idx) {
+    cachedHits.clear();
+    if (cacheReader == NULL) {
+        return;
+    }
+    const size_t cacheId = cacheReader->getId(queryKey);
+    if (cacheId == UINT_MAX) {
+        return;
+    }
+    char *data = cacheReader->getData(cacheId, thread_idx);
+    while (*data != '\0') {
+        // backtraces are written uncompressed
+        Matcher::result_t hit = Matcher::parseAlignmentRecord(data, true);
+        // the cache may come from a run with other thresholds, its hits have to pass the current ones
+        if ((par.addBacktrace == false || hit.backtrace.empty() == false) && acceptHit(par, hit)) {
+            cachedHits.push_back(hit);
+        }
+        data = Util::skipLine(data);
+    }
+    std::sort(cachedHits.begin(), cachedHits.end(), [](const Matcher::result_t &a, const Matcher::result_t &b) {
+        return a.dbKey < b.dbKey;
+    });
+}
+
+static const Matcher::result_t *findCachedHit(const std::vector<Matcher::result_t> &cachedHits, unsigned int dbKey) {
+    std::vector<Matcher::result_t>::const_iterator it = std::lower_bound(cachedHits.begin(), cachedHits.end(), dbKey,
+            [](const Matcher::result_t &hit, unsigned int key) { return hit.dbKey < key; });
+    return (it != cachedHits.end() && it->dbKey == dbKey) ? &(*it) : NULL;
+}
+
+static void writeHits(LocalParameters &par, DBWriter &dbw, std::vector<Matcher::result_t> &finalHits,
+                      std::string &resultBuffer, size_t queryKey, unsigned int thread_idx) {
+    SORT_SERIAL(finalHits.begin(), finalHits.end(), compareHitsByTMScore);
+    char buffer[32768];
+    for (size_t i = 0; i < finalHits.size(); i++) {
+        size_t len = Matcher::resultToBuffer(buffer, finalHits[i], par.addBacktrace, false);
+        resultBuffer.append(buffer, len);
+    }
+    dbw.writeData(resultBuffer.c_str(), resultBuffer.size(), queryKey, thread_idx);
+}
+
 int tmalign(int argc, const char **argv, const Command& command) {
     LocalParameters &par = LocalParameters::getLocalInstance();
     par.parseParameters(argc, argv, command, true, 0, MMseqsParameter::COMMAND_ALIGN);
@@ -76,20 +204,34 @@ int tmalign(int argc, const char **argv, const Command& command) {
                                         par.threads,
                                         DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
     resultReader.open(DBReader<unsigned int>::LINEAR_ACCCESS);
+    // seeding needs the backtraces of a previous alignment step
+    bool seeded = par.tmAlignSeed;
+    if (seeded && Parameters::isEqualDbtype(resultReader.getDbtype(), Parameters::DBTYPE_ALIGNMENT_RES) == false) {
+        Debug(Debug::WARNING) << "--tmalign-seed 1 needs an alignment result as input, running full TM-align\n";
+        seeded = false;
+    }
 
     int dbtype = Parameters::DBTYPE_ALIGNMENT_RES;
     if (alignmentIsExtended) {
         dbtype = DBReader<unsigned int>::setExtendedDbtype(dbtype,Parameters::DBTYPE_EXTENDED_INDEX_NEED_SRC);
     }
-    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), 1, par.compressed, dbtype);
+    DBWriter dbw(par.db4.c_str(), par.db4Index.c_str(), par.threads, par.compressed, dbtype);
     dbw.open();
 
+    // TM-align results do not depend on the target DB, so the pairs of an earlier run with the same
+    // parameters, e.g. a previous cascaded clustering step, are taken over without realigning
+    DBReader<unsigned int> *cacheReader = NULL;
+    if (par.pairCache.empty() == false) {
+        cacheReader = new DBReader<unsigned int>(par.pairCache.c_str(), (par.pairCache + ".index").c_str(), par.threads,
+                                                 DBReader<unsigned int>::USE_DATA|DBReader<unsigned int>::USE_INDEX);
+        cacheReader->open(DBReader<unsigned int>::NOSORT);
+    }
+    size_t cachedPairs = 0;
+
     Debug::Progress progress(resultReader.getSize());
 
     std::vector<TMaligner *> tmaligner;
-    std::vector<Coordinate16 *> tcoords;
     tmaligner.resize(par.threads);
-    tcoords.resize(par.threads);
 
 #pragma omp parallel
     {
@@ -100,179 +242,211 @@ int tmalign(int argc, const char **argv, const Command& command) {
         tmaligner[thread_idx] = new TMaligner(std::max(qdbr.sequenceReader->getMaxSeqLen() + 1,
                                                        tdbr->sequenceReader->getMaxSeqLen() + 1),
                                               par.tmAlignFast, false, false);
-        tcoords[thread_idx] = new Coordinate16();
     }
 
-
-    std::vector<Matcher::result_t> swResults;
-    std::vector<Matcher::result_t> finalHits;
-    std::vector<unsigned int> dbKeys;
-    std::string resultBuffer;
-
-    for (size_t id = 0; id < resultReader.getSize(); id++) {
-        progress.updateProgress();
-        swResults.clear();
-        finalHits.clear();
-        dbKeys.clear();
-        resultBuffer.clear();
-        size_t queryKey = resultReader.getDbKey(id);
-        char *data = resultReader.getData(id,0);
-        if (*data == '\0') {
-            dbw.writeData(resultBuffer.c_str(), resultBuffer.size(), queryKey, 0);
-            continue;
+    // with enough queries each thread aligns whole queries, targets are still processed in order,
+    // so --max-accept and --max-rejected behave the same in both modes
+    const bool queryParallel = resultReader.getSize() >= static_cast<size_t>(par.threads);
+    if (queryParallel) {
+        std::vector<size_t> costOrder;
+        if (par.queryCostOrder) {
+            costOrder = orderQueriesByCost(resultReader, 0, resultReader.getSize(), *qdbr.sequenceReader);
         }
-
-        unsigned int queryId = qdbr.sequenceReader->getId(queryKey);
-        char *querySeq = qdbr.sequenceReader->getData(queryId, 0);
-        int queryLen = static_cast<int>(qdbr.sequenceReader->getSeqLen(queryId));
-
-        char *qcadata = qcadbr.sequenceReader->getData(queryId, 0);
-        size_t qCaLength = qcadbr.sequenceReader->getEntryLen(queryId);
-
-        Coordinate16 qcoords;
-        float* qdata = qcoords.read(qcadata, queryLen, qCaLength);
-
-        while (*data != '\0') {
-            char dbKeyBuffer[256];
-            Util::parseKey(data, dbKeyBuffer);
-            const unsigned int dbKey = static_cast<unsigned int>(strtoul(dbKeyBuffer, NULL, 10));
-            dbKeys.push_back(dbKey);
-            data = Util::skipLine(data);
-        }
-
-        swResults.resize(dbKeys.size());
-#pragma omp parallel
+#pragma omp parallel reduction(+:cachedPairs)
         {
             unsigned int thread_idx = 0;
 #ifdef OPENMP
             thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-            tmaligner[thread_idx]->initQuery(qdata, &qdata[queryLen], &qdata[queryLen + queryLen],
-                                             querySeq, queryLen);
+            TMaligner *aligner = tmaligner[thread_idx];
+            Coordinate16 qcoords;
+            std::vector<Matcher::result_t> cachedHits;
+            std::vector<Matcher::result_t> finalHits;
+            std::string resultBuffer;
+            std::string backtrace;
+            Matcher::result_t seed;
+
+#pragma omp for schedule(dynamic, 1)
+            for (size_t entry = 0; entry < resultReader.getSize(); entry++) {
+                progress.updateProgress();
+                const size_t id = costOrder.empty() ? entry : costOrder[entry];
+                finalHits.clear();
+                resultBuffer.clear();
+                size_t queryKey = resultReader.getDbKey(id);
+                char *data = resultReader.getData(id, thread_idx);
+                if (*data == '\0') {
+                    dbw.writeData(resultBuffer.c_str(), resultBuffer.size(), queryKey, thread_idx);
+                    continue;
+                }
+
+                unsigned int queryId = qdbr.sequenceReader->getId(queryKey);
+                char *querySeq = qdbr.sequenceReader->getData(queryId, thread_idx);
+                int queryLen = static_cast<int>(qdbr.sequenceReader->getSeqLen(queryId));
+
+                char *qcadata = qcadbr.sequenceReader->getData(queryId, thread_idx);
+                size_t qCaLength = qcadbr.sequenceReader->getEntryLen(queryId);
+                float* qdata = qcoords.read(qcadata, queryLen, qCaLength);
+                aligner->initQuery(qdata, &qdata[queryLen], &qdata[queryLen + queryLen], querySeq, queryLen);
+                readCachedHits(par, cacheReader, queryKey, cachedHits, thread_idx);
+
+                int passedNum = 0;
+                int rejected = 0;
+                while (*data != '\0' && passedNum < par.maxAccept && rejected < par.maxRejected) {
+                    char dbKeyBuffer[256];
+                    Util::parseKey(data, dbKeyBuffer);
+                    const unsigned int dbKey = static_cast<unsigned int>(strtoul(dbKeyBuffer, NULL, 10));
+                    const Matcher::result_t *cachedHit = findCachedHit(cachedHits, dbKey);
+                    if (cachedHit != NULL) {
+                        data = Util::skipLine(data);
+                        finalHits.push_back(*cachedHit);
+                        passedNum++;
+                        rejected = 0;
+                        cachedPairs++;
+                        continue;
+                    }
+                    if (seeded) {
+                        seed = Matcher::parseAlignmentRecord(data);
+                    }
+                    data = Util::skipLine(data);
+
+                    Matcher::result_t r = alignTarget(par, aligner, tdbr, tcadbr, queryId, queryLen, sameDB, dbKey,
+                                                      seeded ? &seed : NULL, backtrace, thread_idx);
+                    if (acceptHit(par, r)) {
+                        finalHits.push_back(r);
+                        passedNum++;
+                        rejected = 0;
+                    } else {
+                        rejected++;
+                    }
+                }
+                writeHits(par, dbw, finalHits, resultBuffer, queryKey, thread_idx);
+            }
         }
-        int passedNum = 0;
-        int rejected = 0;
-        size_t chunkSize = (par.maxAccept == INT_MAX &&
-                            par.maxRejected == INT_MAX  ) ? dbKeys.size() : par.threads;
-        for (size_t chunkStart = 0; chunkStart < dbKeys.size(); chunkStart += chunkSize) {
-            if (passedNum >= par.maxAccept || rejected >= par.maxRejected) {
-                break;
+    } else {
+        std::vector<Matcher::result_t> swResults;
+        std::vector<Matcher::result_t> finalHits;
+        std::vector<unsigned int> dbKeys;
+        std::vector<Matcher::result_t> seeds;
+        std::vector<Matcher::result_t> cachedHits;
+        std::vector<const Matcher::result_t *> cached;
+        std::string resultBuffer;
+
+        for (size_t id = 0; id < resultReader.getSize(); id++) {
+            progress.updateProgress();
+            swResults.clear();
+            finalHits.clear();
+            dbKeys.clear();
+            seeds.clear();
+            resultBuffer.clear();
+            size_t queryKey = resultReader.getDbKey(id);
+            char *data = resultReader.getData(id,0);
+            if (*data == '\0') {
+                dbw.writeData(resultBuffer.c_str(), resultBuffer.size(), queryKey, 0);
+                continue;
             }
-            size_t chunkEnd = std::min(chunkStart + chunkSize, dbKeys.size());
+
+            unsigned int queryId = qdbr.sequenceReader->getId(queryKey);
+            char *querySeq = qdbr.sequenceReader->getData(queryId, 0);
+            int queryLen = static_cast<int>(qdbr.sequenceReader->getSeqLen(queryId));
+
+            char *qcadata = qcadbr.sequenceReader->getData(queryId, 0);
+            size_t qCaLength = qcadbr.sequenceReader->getEntryLen(queryId);
+
+            Coordinate16 qcoords;
+            float* qdata = qcoords.read(qcadata, queryLen, qCaLength);
+
+            while (*data != '\0') {
+                char dbKeyBuffer[256];
+                Util::parseKey(data, dbKeyBuffer);
+                const unsigned int dbKey = static_cast<unsigned int>(strtoul(dbKeyBuffer, NULL, 10));
+                dbKeys.push_back(dbKey);
+                if (seeded) {
+                    seeds.emplace_back(Matcher::parseAlignmentRecord(data));
+                }
+                data = Util::skipLine(data);
+            }
+
+            swResults.resize(dbKeys.size());
+            readCachedHits(par, cacheReader, queryKey, cachedHits, 0);
+            cached.resize(dbKeys.size());
+            for (size_t i = 0; i < dbKeys.size(); i++) {
+                cached[i] = findCachedHit(cachedHits, dbKeys[i]);
+            }
+            // the query is prepared once and copied to the other threads
+            tmaligner[0]->initQuery(qdata, &qdata[queryLen], &qdata[queryLen + queryLen], querySeq, queryLen);
 #pragma omp parallel
             {
                 unsigned int thread_idx = 0;
 #ifdef OPENMP
                 thread_idx = static_cast<unsigned int>(omp_get_thread_num());
 #endif
-                std::string backtrace;
+                if (thread_idx != 0) {
+                    tmaligner[thread_idx]->initQuery(*tmaligner[0]);
+                }
+            }
+            int passedNum = 0;
+            int rejected = 0;
+            size_t chunkSize = (par.maxAccept == INT_MAX &&
+                                par.maxRejected == INT_MAX  ) ? dbKeys.size() : par.threads;
+            for (size_t chunkStart = 0; chunkStart < dbKeys.size(); chunkStart += chunkSize) {
+                if (passedNum >= par.maxAccept || rejected >= par.maxRejected) {
+                    break;
+                }
+                size_t chunkEnd = std::min(chunkStart + chunkSize, dbKeys.size());
+#pragma omp parallel
+                {
+                    unsigned int thread_idx = 0;
+#ifdef OPENMP
+                    thread_idx = static_cast<unsigned int>(omp_get_thread_num());
+#endif
+                    std::string backtrace;
 
 #pragma omp for schedule(dynamic, 1)
-                for (size_t i = chunkStart; i < chunkEnd; i++) {
-                    Matcher::result_t tmpResult;
-                    unsigned int targetId = tdbr->sequenceReader->getId(dbKeys[i]);
-                    bool isIdentity = ((queryId == targetId)
-                                       && (par.includeIdentity || sameDB));
-                    if (isIdentity) {
-                        backtrace.clear();
-                        backtrace.append(SSTR(queryLen));
-                        backtrace.append(1, 'M');
-                        tmpResult = Matcher::result_t(dbKeys[i], 100, 1.0, 1.0, 1.0,
-                                                      1.0, std::max(queryLen, queryLen), 0, queryLen - 1,
-                                                      queryLen, 0, queryLen - 1, queryLen, backtrace);
-                    } else {
-                        tmpResult.dbKey = dbKeys[i];
-                        char *targetSeq = tdbr->sequenceReader->getData(targetId, thread_idx);
-                        int targetLen = static_cast<int>(tdbr->sequenceReader->getSeqLen(targetId));
-                        if (!Util::canBeCovered(par.covThr, par.covMode, queryLen, targetLen)) {
-                            tmpResult.eval = -1.0f; // this should avoid that the hit is added
-                            tmpResult.score = -1.0f;
-                            tmpResult.seqId = -1.0f;
-                            tmpResult.qcov = 0.0f;
-                            tmpResult.dbcov = 0.0f;
-                        } else {
-                            char *tcadata = tcadbr->sequenceReader->getData(targetId, thread_idx);
-                            size_t tCaLength = tcadbr->sequenceReader->getEntryLen(targetId);
-
-                            float *tdata = tcoords[thread_idx]->read(tcadata, targetLen, tCaLength);
-
-                            float TMscore;
-                            tmpResult = tmaligner[thread_idx]->align(dbKeys[i],
-                                                                     tdata, &tdata[targetLen],
-                                                                     &tdata[targetLen + targetLen],
-                                                                     targetSeq, targetLen, TMscore);
-                            // TM-align could not align
-                            if (TMscore == std::numeric_limits<float>::min()) {
-                                tmpResult.eval = -1.0f; // this should avoid that the hit is added
-                                tmpResult.score = -1.0f;
-                                tmpResult.seqId = -1.0f;
-                                tmpResult.qcov = 0.0f;
-                                tmpResult.dbcov = 0.0f;
-                            } else {
-                                float qTM = (float) tmpResult.score / 100000.0f;
-                                float tTM = tmpResult.eval;
-                                switch (par.tmAlignHitOrder) {
-                                    case LocalParameters::TMALIGN_HIT_ORDER_AVG:
-                                        tmpResult.eval = (qTM + tTM) / 2.0f;
-                                        break;
-                                    case LocalParameters::TMALIGN_HIT_ORDER_QUERY:
-                                        tmpResult.eval = qTM;
-                                        break;
-                                    case LocalParameters::TMALIGN_HIT_ORDER_TARGET:
-                                        tmpResult.eval = tTM;
-                                        break;
-                                    case LocalParameters::TMALIGN_HIT_ORDER_MIN:
-                                        tmpResult.eval = std::min(qTM, tTM);
-                                        break;
-                                    case LocalParameters::TMALIGN_HIT_ORDER_MAX:
-                                        tmpResult.eval = std::max(qTM, tTM);
-                                        break;
-                                }
-                                tmpResult.score = static_cast<int>(qTM * 100.0f); // e.g. scaled
-                            }
+                    for (size_t i = chunkStart; i < chunkEnd; i++) {
+                        if (cached[i] != NULL) {
+                            continue;
                         }
+                        swResults[i] = alignTarget(par, tmaligner[thread_idx], tdbr, tcadbr, queryId, queryLen, sameDB, dbKeys[i],
+                                                   seeded ? &seeds[i] : NULL, backtrace, thread_idx);
                     }
+                } // end parallel
 
-                    swResults[i] = tmpResult;
-                }
-            } // end parallel
-
-            for (size_t i = chunkStart; i < chunkEnd; i++) {
-                if (passedNum >= par.maxAccept || rejected >= par.maxRejected) {
-                    break;
-                }
-                const Matcher::result_t &r = swResults[i];
-
-                bool hasCov    = Util::hasCoverage(par.covThr, par.covMode, r.qcov, r.dbcov);
-                bool hasSeqId  = (r.seqId >= (par.seqIdThr - std::numeric_limits<float>::epsilon()));
-                bool hasTMscore= (r.eval >= par.tmScoreThr);
-
-                if (hasCov && hasSeqId && hasTMscore) {
-                    finalHits.push_back(r);
-                    passedNum++;
-                    rejected = 0;
-                } else {
-                    rejected++;
+                for (size_t i = chunkStart; i < chunkEnd; i++) {
+                    if (passedNum >= par.maxAccept || rejected >= par.maxRejected) {
+                        break;
+                    }
+                    if (cached[i] != NULL) {
+                        finalHits.push_back(*cached[i]);
+                        passedNum++;
+                        rejected = 0;
+                        cachedPairs++;
+                        continue;
+                    }
+                    const Matcher::result_t &r = swResults[i];
+                    if (acceptHit(par, r)) {
+                        finalHits.push_back(r);
+                        passedNum++;
+                        rejected = 0;
+                    } else {
+                        rejected++;
+                    }
                 }
-            }
-        } // end chunk
+            } // end chunk
 
-        SORT_SERIAL(finalHits.begin(), finalHits.end(), compareHitsByTMScore);
-        char buffer[32768];
-        for (size_t i = 0; i < finalHits.size(); i++) {
-            size_t len = Matcher::resultToBuffer(buffer, finalHits[i], par.addBacktrace, false);
-            resultBuffer.append(buffer, len);
+            writeHits(par, dbw, finalHits, resultBuffer, queryKey, 0);
         }
-
-        dbw.writeData(resultBuffer.c_str(), resultBuffer.size(), queryKey, 0);
     }
 
     dbw.close();
     resultReader.close();
+    if (cacheReader != NULL) {
+        Debug(Debug::INFO) << "Reused " << cachedPairs << " pairs from the pair cache\n";
+        cacheReader->close();
+        delete cacheReader;
+    }
 
     for (int i = 0; i < par.threads; i++) {
         delete tmaligner[i];
-        delete tcoords[i];
     }
 
     if (sameDB == false) {
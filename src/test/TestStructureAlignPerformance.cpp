@@ -0,0 +1,203 @@
+#include "LocalParameters.h"
+#include "DBReader.h"
+#include "Debug.h"
+#include "Util.h"
+#include "Sequence.h"
+#include "SubstitutionMatrix.h"
+#include "StructureSmithWaterman.h"
+#include "TMaligner.h"
+#include "Coordinate16.h"
+#include "Timer.h"
+
+#include <vector>
+#include <string>
+
+const char* binary_name = "test_structurealignperformance";
+void initParameterSingleton() { new LocalParameters; }
+
+// times the structurealign kernels for all query/target pairs of a foldseek database (single thread)
+// usage: test_structurealignperformance <structureDB> [alignment type: 0 3Di, 2 3Di+AA] [repeats]
+int main (int argc, const char** argv) {
+    if (argc < 2) {
+        Debug(Debug::ERROR) << "Usage: " << binary_name << " <structureDB> [alignmentType] [repeats]\n";
+        return EXIT_FAILURE;
+    }
+    const std::string db = argv[1];
+    const int alignmentType = (argc > 2) ? atoi(argv[2]) : LocalParameters::ALIGNMENT_TYPE_3DI_AA;
+    const int repeats = (argc > 3) ? atoi(argv[3]) : 5;
+
+    LocalParameters& par = LocalParameters::getLocalInstance();
+    par.initMatrices();
+    par.compBiasCorrectionScale = 0.5;
+   
+    SubstitutionMatrix subMat3Di(par.scoringMatrixFile.values.aminoacid().c_str(), 2.1, par.scoreBias);
+    std::string blosum;
+    for (size_t i = 0; i < par.substitutionMatrices.size(); i++) {
+        if (par.substitutionMatrices[i].name == "blosum62.out") {
+            std::string matrixData((const char *)par.substitutionMatrices[i].subMatData, par.substitutionMatrices[i].subMatDataLen);
+            char * serializedMatrix = BaseMatrix::serialize(par.substitutionMatrices[i].name, matrixData);
+            blosum.assign(serializedMatrix);
+            free(serializedMatrix);
+            break;
+        }
+    }
+    float aaFactor = (alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA) ? 1.4 : 0.0;
+    SubstitutionMatrix subMatAA(blosum.c_str(), aaFactor, par.scoreBias);
+    int8_t * tinySubMatAA = (int8_t*) mem_align(ALIGN_INT, subMatAA.alphabetSize * 32);
+    int8_t * tinySubMat3Di = (int8_t*) mem_align(ALIGN_INT, subMat3Di.alphabetSize * 32);
+    for (int i = 0; i < subMat3Di.alphabetSize; i++) {
+        for (int j = 0; j < subMat3Di.alphabetSize; j++) {
+            tinySubMat3Di[i * subMat3Di.alphabetSize + j] = subMat3Di.subMatrix[i][j];
+        }
+    }
+    for (int i = 0; i < subMatAA.alphabetSize; i++) {
+        for (int j = 0; j < subMatAA.alphabetSize; j++) {
+            tinySubMatAA[i * subMatAA.alphabetSize + j] = subMatAA.subMatrix[i][j];
+        }
+    }
+
+    const int dataMode = DBReader<unsigned int>::USE_INDEX | DBReader<unsigned int>::USE_DATA;
+    DBReader<unsigned int> aaDbr(db.c_str(), (db + ".index").c_str(), 1, dataMode);
+    aaDbr.open(DBReader<unsigned int>::NOSORT);
+    aaDbr.readMmapedDataInMemory();
+    DBReader<unsigned int> ssDbr((db + "_ss").c_str(), (db + "_ss.index").c_str(), 1, dataMode);
+    ssDbr.open(DBReader<unsigned int>::NOSORT);
+    ssDbr.readMmapedDataInMemory();
+    DBReader<unsigned int> caDbr((db + "_ca").c_str(), (db + "_ca.index").c_str(), 1, dataMode);
+    caDbr.open(DBReader<unsigned int>::NOSORT);
+    caDbr.readMmapedDataInMemory();
+
+    const size_t entries = aaDbr.getSize();
+    std::vector<unsigned int> keys(entries);
+    std::vector<int> lengths(entries);
+    std::vector<std::vector<unsigned char>> numAA(entries);
+    std::vector<std::vector<unsigned char>> num3Di(entries);
+    std::vector<std::vector<float>> coords(entries);
+    size_t maxLen = 0;
+    for (size_t id = 0; id < entries; id++) {
+        keys[id] = aaDbr.getDbKey(id);
+        const int len = static_cast<int>(aaDbr.getSeqLen(id));
+        lengths[id] = len;
+        maxLen = std::max(maxLen, static_cast<size_t>(len));
+        const char *seqAA = aaDbr.getData(id, 0);
+        const char *seq3Di = ssDbr.getData(ssDbr.getId(keys[id]), 0);
+        numAA[id].resize(len);
+        num3Di[id].resize(len);
+        for (int pos = 0; pos < len; pos++) {
+            numAA[id][pos] = subMatAA.aa2num[static_cast<unsigned char>(seqAA[pos])];
+            num3Di[id][pos] = subMat3Di.aa2num[static_cast<unsigned char>(seq3Di[pos])];
+        }
+        coords[id].resize(3 * len);
+    }
+
+    const uint8_t gapOpen = par.gapOpen.values.aminoacid();
+    const uint8_t gapExtend = par.gapExtend.values.aminoacid();
+    StructureSmithWaterman aligner(maxLen + 1, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, &subMatAA, &subMat3Di);
+    StructureSmithWaterman reverseAligner(maxLen + 1, subMat3Di.alphabetSize, par.compBiasCorrection, par.compBiasCorrectionScale, &subMatAA, &subMat3Di);
+    TMaligner tmaligner(maxLen + 1, false, true, par.exactTMscore);
+    Sequence qSeqAA(maxLen + 1, Parameters::DBTYPE_AMINO_ACIDS, &subMatAA, 0, false, par.compBiasCorrection);
+    Sequence qSeq3Di(maxLen + 1, Parameters::DBTYPE_AMINO_ACIDS, &subMat3Di, 0, false, par.compBiasCorrection);
+    Coordinate16 qcoords;
+
+    const size_t batchSize = StructureSmithWaterman::getBatchSize();
+    std::vector<const unsigned char *> batchAAPtr(batchSize);
+    std::vector<const unsigned char *> batch3DiPtr(batchSize);
+    std::vector<int32_t> batchLengths(batchSize);
+    std::vector<uint32_t> batchScores(batchSize);
+    std::vector<StructureSmithWaterman::s_align> alignments(entries);
+    std::vector<std::string> backtraces(entries);
+
+    double timeSeparate = 0, timeFused = 0, timeBatch = 0, timeBacktrace = 0, timeTMscore = 0, timeCoordinates = 0;
+    uint64_t sumForward = 0, sumReverse = 0, sumFused = 0, sumFusedReverse = 0, sumBatch = 0;
+    double sumTMscore = 0;
+    size_t cells = 0;
+    Timer timer;
+       for (int rep = 0; rep < repeats; rep++) {
+        timer.reset();
+        for (size_t id = 0; id < entries; id++) {
+            const size_t caId = caDbr.getId(keys[id]);
+            Coordinate16::read(caDbr.getData(caId, 0), lengths[id], caDbr.getEntryLen(caId),
+                               coords[id].data(), coords[id].data() + lengths[id], coords[id].data() + 2 * lengths[id]);
+        }
+        timeCoordinates += timer.getTimediff();
+
+        for (size_t q = 0; q < entries; q++) {
+            const int qLen = lengths[q];
+            qSeqAA.mapSequence(q, keys[q], aaDbr.getData(q, 0), qLen);
+            qSeq3Di.mapSequence(q, keys[q], ssDbr.getData(ssDbr.getId(keys[q]), 0), qLen);
+            aligner.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+            qSeqAA.reverse();
+            qSeq3Di.reverse();
+            reverseAligner.ssw_init(&qSeqAA, &qSeq3Di, tinySubMatAA, tinySubMat3Di, &subMatAA);
+            aligner.initFusedProfile(reverseAligner);
+            timer.reset();
+            for (size_t t = 0; t < entries; t++) {
+                alignments[t] = aligner.alignScoreEndPos<StructureSmithWaterman::PROFILE>(numAA[t].data(), num3Di[t].data(), lengths[t], gapOpen, gapExtend, qLen / 2);
+                sumForward += alignments[t].score1;
+                sumReverse += reverseAligner.alignScoreEndPos<StructureSmithWaterman::PROFILE>(numAA[t].data(), num3Di[t].data(), lengths[t], gapOpen, gapExtend, qLen / 2).score1;
+                cells += static_cast<size_t>(qLen) * lengths[t];
+            }
+            timeSeparate += timer.getTimediff();
+            timer.reset();
+            for (size_t t = 0; t < entries; t++) {
+                uint32_t revScore = 0;
+                sumFused += aligner.alignScoreEndPosFused<StructureSmithWaterman::PROFILE>(reverseAligner, numAA[t].data(), num3Di[t].data(), lengths[t],
+                                                                                           gapOpen, gapExtend, qLen / 2, revScore, 0).score1;
+                sumFusedReverse += revScore;
+            }
+            timeFused += timer.getTimediff();
+            timer.reset();
+            for (size_t t = 0; t < entries; t += batchSize) {
+                const size_t batchCnt = std::min(batchSize, entries - t);
+                for (size_t b = 0; b < batchCnt; b++) {
+                    batchAAPtr[b] = numAA[t + b].data();
+                    batch3DiPtr[b] = num3Di[t + b].data();
+                    batchLengths[b] = lengths[t + b];
+                }
+                aligner.alignScoreBatch(batchAAPtr.data(), batch3DiPtr.data(), batchLengths.data(), batchCnt, gapOpen, gapExtend, batchScores.data());
+                for (size_t b = 0; b < batchCnt; b++) {
+                    sumBatch += batchScores[b];
+                }
+            }
+            timeBatch += timer.getTimediff();
+            timer.reset();
+            for (size_t t = 0; t < entries; t++) {
+                if (alignments[t].dbEndPos1 == -1) {
+                    continue;
+                }
+                               backtraces[t].clear();
+                alignments[t] = aligner.alignStartPosBacktraceBlock(numAA[t].data(), num3Di[t].data(), lengths[t], gapOpen, gapExtend,
+                                                                    backtraces[t], alignments[t]);
+            }
+            timeBacktrace += timer.getTimediff();
+            const size_t qCaId = caDbr.getId(keys[q]);
+            float *qCa = qcoords.read(caDbr.getData(qCaId, 0), qLen, caDbr.getEntryLen(qCaId));
+            tmaligner.initQuery(qCa, qCa + qLen, qCa + 2 * qLen, NULL, qLen);
+            timer.reset();
+            for (size_t t = 0; t < entries; t++) {
+                if (alignments[t].dbEndPos1 == -1 || backtraces[t].empty()) {
+                    continue;
+                }
+                float *x = coords[t].data();
+                sumTMscore += tmaligner.computeTMscore(x, x + lengths[t], x + 2 * lengths[t], lengths[t],
+                                                       alignments[t].qStartPos1, alignments[t].dbStartPos1, backtraces[t], qLen).tmscore;
+            }
+            timeTMscore += timer.getTimediff();        }
+    }
+
+    Debug(Debug::INFO) << "entries: " << entries << " pairs: " << entries * entries * repeats << " cells: " << cells << "\n";
+    Debug(Debug::INFO) << "kernel\tseconds\tGCUPS\tchecksum (forward, reverse)\n";
+    Debug(Debug::INFO) << "alignScoreEndPos (forward + reverse)\t" << timeSeparate << "\t" << (2 * cells / timeSeparate / 1e9) << "\t" << sumForward << " " << sumReverse << "\n";
+    Debug(Debug::INFO) << "alignScoreEndPosFused\t" << timeFused << "\t" << (2 * cells / timeFused / 1e9) << "\t" << sumFused << " " << sumFusedReverse << "\n";
+    Debug(Debug::INFO) << "alignScoreBatch (forward)\t" << timeBatch << "\t" << (cells / timeBatch / 1e9) << "\t" << sumBatch << "\n";
+    Debug(Debug::INFO) << "alignStartPosBacktraceBlock\t" << timeBacktrace << "\t-\t-\n";
+    Debug(Debug::INFO) << "computeTMscore\t" << timeTMscore << "\t-\t" << sumTMscore << "\n";
+    Debug(Debug::INFO) << "Coordinate16::read\t" << timeCoordinates << "\t-\t-\n";
+
+    free(tinySubMatAA);
+    free(tinySubMat3Di);
+    caDbr.close();
+    ssDbr.close();
+    aaDbr.close();
+    return EXIT_SUCCESS;
+}
@@ -103,6 +103,14 @@ int easymultimersearch(int argc, const char **argv, const Command &command) {
         case LocalParameters::PREF_MODE_UNGAPPED:
             cmd.addVariable("PREFMODE", "UNGAPPED");
             break;
+        // gapped prefilter scores are only computed by the GPU prefilter, ungappedprefilter receives the mode
+        case LocalParameters::PREF_MODE_UNGAPPED_AND_GAPPED:
+            if (par.gpu == 0) {
+                Debug(Debug::ERROR) << "--prefilter-mode 3 is only supported with --gpu 1\n";
+                EXIT(EXIT_FAILURE);
+            }
+            cmd.addVariable("PREFMODE", "UNGAPPED");
+            break;
         case LocalParameters::PREF_MODE_EXHAUSTIVE:
             cmd.addVariable("PREFMODE", "EXHAUSTIVE");
             break;
@@ -98,7 +98,7 @@ int structureeasyrbh(int argc, const char **argv, const Command &command) {
     }
 
     cmd.addVariable("QUERY", par.filenames.back().c_str());
-    cmd.addVariable("SEARCH_PAR", par.createParameterString(par.structuresearchworkflow, true).c_str());
+    cmd.addVariable("SEARCH_PAR", par.createParameterString(par.structurerbhworkflow, true).c_str());
     cmd.addVariable("REMOVE_TMP", par.removeTmpFiles ? "TRUE" : NULL);
     cmd.addVariable("LEAVE_INPUT", par.dbOut ? "TRUE" : NULL);
 
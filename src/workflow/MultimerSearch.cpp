@@ -74,6 +74,7 @@ int multimersearch(int argc, const char **argv, const Command &command) {
         par.evalThr = par.eValueThrExpandMultimer;
         cmd.addVariable("MULTIMER_ALIGNMENT_ALGO", "structurealign");
         cmd.addVariable("MULTIMER_ALIGN_PAR", par.createParameterString(par.structurealign).c_str());
+        cmd.addVariable("ALIGNMULTIMER_PAR", par.createParameterString(par.alignmultimer).c_str());
     }
     par.evalThr = eval;
     switch(par.prefMode){
@@ -83,6 +84,14 @@ int multimersearch(int argc, const char **argv, const Command &command) {
         case LocalParameters::PREF_MODE_UNGAPPED:
             cmd.addVariable("PREFMODE", "UNGAPPED");
             break;
+        // gapped prefilter scores are only computed by the GPU prefilter, ungappedprefilter receives the mode
+        case LocalParameters::PREF_MODE_UNGAPPED_AND_GAPPED:
+            if (par.gpu == 0) {
+                Debug(Debug::ERROR) << "--prefilter-mode 3 is only supported with --gpu 1\n";
+                EXIT(EXIT_FAILURE);
+            }
+            cmd.addVariable("PREFMODE", "UNGAPPED");
+            break;
         case LocalParameters::PREF_MODE_EXHAUSTIVE:
             cmd.addVariable("PREFMODE", "EXHAUSTIVE");
             break;
@@ -90,6 +99,13 @@ int multimersearch(int argc, const char **argv, const Command &command) {
     if(par.exhaustiveSearch){
         cmd.addVariable("PREFMODE", "EXHAUSTIVE");
     }
+    // the complex prefilter replaces the chain search, an exhaustive search needs the chain alignments
+    const bool complexPrefilter = par.complexPrefilter && par.exhaustiveSearch == false && par.prefMode != LocalParameters::PREF_MODE_EXHAUSTIVE;
+    cmd.addVariable("COMPLEX_PREFILTER", complexPrefilter ? "TRUE" : NULL);
+    if (complexPrefilter) {
+        cmd.addVariable("CREATECOMPLEXSKETCH_PAR", par.createParameterString(par.createcomplexsketch).c_str());
+        cmd.addVariable("COMPLEXPREFILTER_PAR", par.createParameterString(par.complexprefilter).c_str());
+    }
     cmd.addVariable("NO_REPORT", par.multimerReportMode == 0 ? "TRUE" : NULL);
     cmd.addVariable("TMP_PATH", tmpDir.c_str());
     cmd.addVariable("OUTPUT", par.filenames.back().c_str());
@@ -106,6 +122,7 @@ int multimersearch(int argc, const char **argv, const Command &command) {
 
     cmd.addVariable("SEARCH_PAR", par.createParameterString(par.structuresearchworkflow, true).c_str());
     cmd.addVariable("SCOREMULTIMER_PAR", par.createParameterString(par.scoremultimer).c_str());
+    cmd.addVariable("EXPANDMULTIMER_PAR", par.createParameterString(par.expandmultimer).c_str());
     cmd.addVariable("THREADS_PAR", par.createParameterString(par.onlythreads).c_str());
     cmd.addVariable("REMOVE_TMP", par.removeTmpFiles ? "TRUE" : NULL);
     cmd.addVariable("VERBOSITY", par.createParameterString(par.onlyverbosity).c_str());
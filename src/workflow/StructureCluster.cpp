@@ -106,6 +106,8 @@ int structurecluster(int argc, const char **argv, const Command& command) {
     std::string alnParam;
     if(par.alignmentType == LocalParameters::ALIGNMENT_TYPE_TMALIGN) {
         cmd.addVariable("ALIGNMENT_ALGO", "tmalign");
+        // all TM-align steps use the same parameters, so later steps can reuse the pairs of earlier ones
+        cmd.addVariable("PAIR_CACHE", "1");
         alnParam = par.createParameterString(par.tmalign);
     } else if(par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA || par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI) {
         cmd.addVariable("ALIGNMENT_ALGO", "structurealign");
@@ -128,6 +130,19 @@ int structurecluster(int argc, const char **argv, const Command& command) {
     cmd.addVariable("CLUSTER_PAR", par.createParameterString(par.clust).c_str());
     cmd.addVariable("ALIGNMENT_PAR", alnParam.c_str());
     cmd.addVariable("RUN_LINCLUST", "1");
+    // rescoring, alignment and both clusterings of the linclust step run in one process,
+    // with an MPI runner the separate steps distribute the rescoring and alignment over the ranks instead
+    if ((par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA || par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI) && par.runner.empty()) {
+        cmd.addVariable("STRUCTURELINCLUST_PAR", par.createParameterString(par.structurelinclust).c_str());
+    }
+
+    // greedy clustering only needs the alignments of structures without a representative,
+    // with --greedy-align-cluster these are computed together with the clustering in one process
+    if (par.greedyAlignCluster && (par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA || par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI) && par.runner.empty()
+        && (par.clusteringMode == Parameters::GREEDY || par.clusteringMode == Parameters::GREEDY_MEM)
+        && par.maxAccept == INT_MAX && par.maxRejected == INT_MAX) {
+        cmd.addVariable("GREEDY_ALIGN_CLUSTER", "1");
+    }
 
     if (par.singleStepClustering == false) {
         // save some values to restore them later
@@ -0,0 +1,72 @@
+#include "Debug.h"
+#include "Util.h"
+#include "FileUtil.h"
+#include "CommandCaller.h"
+#include "LocalParameters.h"
+#include "structureclusterupdate.sh.h"
+
+#include <cassert>
+
+extern void setStructureClusterWorkflowDefaults(LocalParameters *p);
+extern void setStructuralClusterAutomagicParameters(Parameters& par);
+
+int structureclusterupdate(int argc, const char **argv, const Command& command) {
+    LocalParameters &par = LocalParameters::getLocalInstance();
+    setStructureClusterWorkflowDefaults(&par);
+    par.PARAM_ADD_BACKTRACE.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_RESCORE_MODE.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_MAX_REJECTED.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_MAX_ACCEPT.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_ZDROP.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_KMER_PER_SEQ.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_S.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_INCLUDE_ONLY_EXTENDABLE.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_NUM_ITERATIONS.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_CLUSTER_REASSIGN.addCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_COMPRESSED.removeCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_THREADS.removeCategory(MMseqsParameter::COMMAND_EXPERT);
+    par.PARAM_V.removeCategory(MMseqsParameter::COMMAND_EXPERT);
+
+    par.parseParameters(argc, argv, command, true, 0, 0);
+    par.PARAM_ALIGNMENT_MODE.wasSet = true;
+    setStructuralClusterAutomagicParameters(par);
+
+    CommandCaller cmd;
+    cmd.addVariable("REMOVE_TMP", par.removeTmpFiles ? "TRUE" : NULL);
+    cmd.addVariable("RECOVER_DELETED", par.recoverDeleted ? "TRUE" : NULL);
+
+    cmd.addVariable("DIFF_PAR", par.createParameterString(par.diff).c_str());
+    cmd.addVariable("VERBOSITY", par.createParameterString(par.onlyverbosity).c_str());
+
+    int oldVerbosity = par.verbosity;
+    par.verbosity = std::min(par.verbosity, 1);
+    cmd.addVariable("NOWARNINGS_PAR", par.createParameterString(par.onlyverbosity).c_str());
+    par.verbosity = oldVerbosity;
+
+    cmd.addVariable("THREADS_PAR", par.createParameterString(par.onlythreads).c_str());
+    cmd.addVariable("CLUST_PAR", par.createParameterString(par.structureclusterworkflow, true).c_str());
+
+    // new structures only need their best representative
+    int maxAccept = par.maxAccept;
+    par.maxAccept = 1;
+    par.PARAM_MAX_ACCEPT.wasSet = true;
+    cmd.addVariable("SEARCH_PAR", par.createParameterString(par.structuresearchworkflow, true).c_str());
+    par.maxAccept = maxAccept;
+
+    std::string tmpDir = par.db6;
+    std::string hash = SSTR(par.hashParameter(command.databases, par.filenames, par.structureclusterupdate));
+    if (par.reuseLatest) {
+        hash = FileUtil::getHashFromSymLink(tmpDir + "/latest");
+    }
+    tmpDir = FileUtil::createTemporaryDirectory(tmpDir, hash);
+    par.filenames.pop_back();
+    par.filenames.push_back(tmpDir);
+
+    std::string program = tmpDir + "/structureclusterupdate.sh";
+    FileUtil::writeFile(program, structureclusterupdate_sh, structureclusterupdate_sh_len);
+    cmd.execProgram(program.c_str(), par.filenames);
+
+    // Should never get here
+    assert(false);
+    return EXIT_FAILURE;
+}
@@ -59,9 +59,15 @@ int structureindex(int argc, const char **argv, const Command& command) {
     cmd.addVariable("REMOVE_TMP", par.removeTmpFiles ? "TRUE" : NULL);
     cmd.addVariable("CREATEINDEX_PAR", par.createParameterString(createIndexWithoutIndexSubset, true).c_str());
     cmd.addVariable("VERBOSITY_PAR", par.createParameterString(par.onlyverbosity).c_str());
+    cmd.addVariable("THREADS_PAR", par.createParameterString(par.onlythreads).c_str());
+    cmd.addVariable("MULAMBDA_PAR", par.createParameterString(par.createmulambda).c_str());
+    cmd.addVariable("EMBEDDING_INDEX", par.embeddingIndex ? "TRUE" : NULL);
+    cmd.addVariable("EMBEDDING_PAR", par.createParameterString(par.createembeddingindex).c_str());
     cmd.addVariable("INDEX_DB_CA_KEY_DB1", SSTR(LocalParameters::INDEX_DB_CA_KEY_DB1).c_str());
     cmd.addVariable("INDEX_DB_CA_KEY_DB2", SSTR(LocalParameters::INDEX_DB_CA_KEY_DB2).c_str());
-    cmd.addVariable("SS_SUBSET_MODE", SSTR(excludeKmers ? 7 : 5).c_str());
+    // --index-subset only selects the k-mer list compression, the other subsets are fixed by the workflow
+    const int compressedKmers = par.indexSubset & Parameters::INDEX_SUBSET_COMPRESSED_KMERS;
+    cmd.addVariable("SS_SUBSET_MODE", SSTR((excludeKmers ? 7 : 5) | compressedKmers).c_str());
     cmd.addVariable("INCLUDE_CA", excludeCa == false ? "TRUE" : NULL);
 
     std::string program(tmpDir + "/structureindex.sh");
@@ -46,7 +46,7 @@ int structurerbh(int argc, const char **argv, const Command &command) {
 
 
     std::string tmpDir = par.db4;
-    std::string hash = SSTR(par.hashParameter(command.databases, par.filenames, par.searchworkflow));
+    std::string hash = SSTR(par.hashParameter(command.databases, par.filenames, par.structurerbhworkflow));
     if (par.reuseLatest) {
         hash = FileUtil::getHashFromSymLink(tmpDir + "/latest");
     }
@@ -61,6 +61,7 @@ int structurerbh(int argc, const char **argv, const Command &command) {
     cmd.addVariable("SEARCH_B_A_PAR", par.createParameterString(par.structuresearchworkflow).c_str());
     par.covMode = originalCovMode;
     cmd.addVariable("REMOVE_TMP", par.removeTmpFiles ? "TRUE" : NULL);
+    cmd.addVariable("RBH_BEST_ONLY", par.rbhBestOnly ? "TRUE" : NULL);
 
     if(par.alignmentType == LocalParameters::ALIGNMENT_TYPE_TMALIGN){
         cmd.addVariable("ALIGNMENT_ALGO", "tmalign");
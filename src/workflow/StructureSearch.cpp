@@ -1,4 +1,7 @@
 #include <cassert>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 #include "DBReader.h"
 #include "Util.h"
 #include "CommandCaller.h"
@@ -106,7 +109,7 @@ int structuresearch(int argc, const char **argv, const Command &command) {
     par.evalThr = prevEvalueThr;
     par.compBiasCorrectionScale = 0.5;
 
-    // GPU can only use the ungapped prefilter
+    // GPU uses the ungapped prefilter by default
     if (par.gpu == 1 && par.PARAM_PREF_MODE.wasSet == false) {
         par.prefMode = Parameters::PREF_MODE_UNGAPPED;
     }
@@ -118,13 +121,81 @@ int structuresearch(int argc, const char **argv, const Command &command) {
         case LocalParameters::PREF_MODE_UNGAPPED:
             cmd.addVariable("PREFMODE", "UNGAPPED");
             break;
+        // gapped prefilter scores are only computed by the GPU prefilter, ungappedprefilter receives the mode
+        case LocalParameters::PREF_MODE_UNGAPPED_AND_GAPPED:
+            if (par.gpu == 0) {
+                Debug(Debug::ERROR) << "--prefilter-mode 3 is only supported with --gpu 1\n";
+                EXIT(EXIT_FAILURE);
+            }
+            cmd.addVariable("PREFMODE", "UNGAPPED");
+            break;
         case LocalParameters::PREF_MODE_EXHAUSTIVE:
             cmd.addVariable("PREFMODE", "EXHAUSTIVE");
             break;
+        // the embedding index of the target is created by createindex --embedding-index 1 or on the fly
+        case LocalParameters::PREF_MODE_EMBEDDING:
+            cmd.addVariable("PREFMODE", "EMBEDDING");
+            cmd.addVariable("CREATEEMBEDDINGINDEX_PAR", par.createParameterString(par.createembeddingindex).c_str());
+            cmd.addVariable("EMBEDDINGPREFILTER_PAR", par.createParameterString(par.embeddingprefilter).c_str());
+            break;
     }
     if(par.exhaustiveSearch){
         cmd.addVariable("PREFMODE", "EXHAUSTIVE");
     }
+    cmd.addVariable("TAXON_LIST", par.taxonList.empty() ? NULL : par.taxonList.c_str());
+    // the embedding prefilter and the exhaustive search report no diagonal, there is no band to align in
+    if (par.prefMode == LocalParameters::PREF_MODE_EMBEDDING || par.prefMode == LocalParameters::PREF_MODE_EXHAUSTIVE || par.exhaustiveSearch) {
+        par.diagonalBand = 0;
+    }
+    // every additional spaced seed scans the unindexed target, an index stores the k-mers of a single pattern
+    if(par.spacedKmerPatterns.empty() == false){
+        const std::vector<std::string> patterns = Util::split(par.spacedKmerPatterns, ",");
+        const int kmerSize = par.kmerSize;
+        const int spacedKmer = par.spacedKmer;
+        const std::string spacedKmerPattern = par.spacedKmerPattern;
+        par.compBiasCorrectionScale = 0.15;
+        for (size_t i = 0; i < patterns.size(); i++) {
+            par.kmerSize = std::count(patterns[i].begin(), patterns[i].end(), '1');
+            par.spacedKmer = patterns[i].find('0') != std::string::npos;
+            par.spacedKmerPattern = patterns[i];
+            cmd.addVariable(std::string("SEED_PREFILTER_PAR_" + SSTR(i)).c_str(), par.createParameterString(par.prefilter).c_str());
+        }
+        par.compBiasCorrectionScale = 0.5;
+        cmd.addVariable("SEED_COUNT", SSTR(patterns.size()).c_str());
+        cmd.addVariable("MERGEPREFILTER_PAR", par.createParameterString(par.mergeprefilter).c_str());
+        par.kmerSize = kmerSize;
+        par.spacedKmer = spacedKmer;
+        par.spacedKmerPattern = spacedKmerPattern;
+    }
+    // k-mer hits are keyed on 3Di only, their diagonals are rescored with 3Di+AA before the gapped alignment
+    if(par.jointPrefilterEvalue > 0.0){
+        const double evalThr = par.evalThr;
+        const float covThr = par.covThr;
+        const float tmScoreThr = par.tmScoreThr;
+        const float lddtThr = par.lddtThr;
+        const float seqIdThr = par.seqIdThr;
+        const int alnLenThr = par.alnLenThr;
+        const int alignmentType = par.alignmentType;
+        const bool addBacktrace = par.addBacktrace;
+        par.evalThr = par.jointPrefilterEvalue;
+        // ungapped diagonals are shorter than the final alignments, only the E-value filters
+        par.covThr = 0.0;
+        par.tmScoreThr = 0.0;
+        par.lddtThr = 0.0;
+        par.seqIdThr = 0.0;
+        par.alnLenThr = 0;
+        par.alignmentType = LocalParameters::ALIGNMENT_TYPE_3DI_AA;
+        par.addBacktrace = false;
+        cmd.addVariable("JOINT_PREFILTER_PAR", par.createParameterString(par.structurerescorediagonal).c_str());
+        par.evalThr = evalThr;
+        par.covThr = covThr;
+        par.tmScoreThr = tmScoreThr;
+        par.lddtThr = lddtThr;
+        par.seqIdThr = seqIdThr;
+        par.alnLenThr = alnLenThr;
+        par.alignmentType = alignmentType;
+        par.addBacktrace = addBacktrace;
+    }
     if(par.alignmentType == LocalParameters::ALIGNMENT_TYPE_TMALIGN){
         cmd.addVariable("ALIGNMENT_ALGO", "tmalign");
         cmd.addVariable("QUERY_ALIGNMENT", query.c_str());
@@ -135,7 +206,13 @@ int structuresearch(int argc, const char **argv, const Command &command) {
         par.tmScoreThrMode = 0.0;
         par.lddtThr = 0.0;
        //par.evalThr = 10; we want users to adjust this one. Our default is 10 anyhow.
+        // seeded TM-align refines the 3Di+AA backtraces
+        const bool addBacktrace = par.addBacktrace;
+        if (par.tmAlignSeed) {
+            par.addBacktrace = true;
+        }
         cmd.addVariable("STRUCTUREALIGN_PAR", par.createParameterString(par.structurealign).c_str());
+        par.addBacktrace = addBacktrace;
     }else if(par.alignmentType == LocalParameters::ALIGNMENT_TYPE_LOLALIGN){
         cmd.addVariable("ALIGNMENT_ALGO", "lolalign");
         cmd.addVariable("QUERY_ALIGNMENT", query.c_str());
@@ -144,12 +221,74 @@ int structuresearch(int argc, const char **argv, const Command &command) {
         par.alignmentMode = Parameters::ALIGNMENT_MODE_SCORE_ONLY;
         par.sortByStructureBits = 0;
         //par.evalThr = 10; we want users to adjust this one. Our default is 10 anyhow.
+        // seeded TM-align refines the 3Di+AA backtraces
+        const bool addBacktrace = par.addBacktrace;
+        if (par.tmAlignSeed) {
+            par.addBacktrace = true;
+        }
         cmd.addVariable("STRUCTUREALIGN_PAR", par.createParameterString(par.structurealign).c_str());
+        par.addBacktrace = addBacktrace;
     }else if(par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA || par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI){
         cmd.addVariable("ALIGNMENT_ALGO", "structurealign");
         cmd.addVariable("QUERY_ALIGNMENT", query.c_str());
         cmd.addVariable("TARGET_ALIGNMENT", target.c_str());
         cmd.addVariable("ALIGNMENT_PAR", par.createParameterString(par.structurealign).c_str());
+        // representative hits of a pruned cluster search are composed with the member alignments by their backtraces
+        const bool addBacktrace = par.addBacktrace;
+        if (par.clusterSearch == 1 && par.clusterSearchEvalue > 0.0) {
+            par.addBacktrace = true;
+        }
+        cmd.addVariable("REPALIGNMENT_PAR", par.createParameterString(par.structurealign).c_str());
+        par.addBacktrace = addBacktrace;
+    }
+    // cascade: queries with --cascade-hits confident hits after a low sensitivity k-mer prefilter are done,
+    // only the remaining queries are searched again up to -s (and exhaustively with --exhaustive-search 1)
+    if(par.sensSteps > 1){
+        if(par.prefMode != LocalParameters::PREF_MODE_KMER && par.exhaustiveSearch == false){
+            Debug(Debug::ERROR) << "--sens-steps > 1 requires the k-mer prefilter (--prefilter-mode 0)\n";
+            EXIT(EXIT_FAILURE);
+        }
+        if(par.gpu != 0){
+            Debug(Debug::ERROR) << "No GPU support in increasing sensitivity search\n";
+            EXIT(EXIT_FAILURE);
+        }
+        if(par.numIterations != 1 || par.clusterSearch == 1 || par.spacedKmerPatterns.empty() == false || par.jointPrefilterEvalue > 0.0){
+            Debug(Debug::ERROR) << "--sens-steps > 1 cannot be combined with --num-iterations, --cluster-search, --spaced-kmer-patterns or --joint-prefilter-evalue\n";
+            EXIT(EXIT_FAILURE);
+        }
+        if(par.alignmentType != LocalParameters::ALIGNMENT_TYPE_3DI_AA && par.alignmentType != LocalParameters::ALIGNMENT_TYPE_3DI){
+            Debug(Debug::ERROR) << "--sens-steps > 1 requires --alignment-type 0 or 2\n";
+            EXIT(EXIT_FAILURE);
+        }
+        if(par.startSens > par.sensitivity){
+            Debug(Debug::ERROR) << "--start-sens can not be greater than -s\n";
+            EXIT(EXIT_FAILURE);
+        }
+        const float sensStepSize = (par.sensitivity - par.startSens) / (static_cast<float>(par.sensSteps) - 1);
+        for (int step = 0; step < par.sensSteps; step++) {
+            std::stringstream stream;
+            stream << std::fixed << std::setprecision(1) << (par.startSens + sensStepSize * step);
+            cmd.addVariable(std::string("SENSE_" + SSTR(step)).c_str(), stream.str().c_str());
+        }
+        std::vector<MMseqsParameter*> prefilterWithoutS;
+        for (size_t i = 0; i < par.prefilter.size(); i++) {
+            if (par.prefilter[i]->uniqid != par.PARAM_S.uniqid) {
+                prefilterWithoutS.push_back(par.prefilter[i]);
+            }
+        }
+        par.compBiasCorrectionScale = 0.15;
+        cmd.addVariable("CASCADE_PREFILTER_PAR", par.createParameterString(prefilterWithoutS).c_str());
+        par.compBiasCorrectionScale = 0.5;
+        cmd.addVariable("CASCADE_STEPS", SSTR(par.sensSteps).c_str());
+        cmd.addVariable("CASCADE_EXHAUSTIVE", par.exhaustiveSearch ? "TRUE" : NULL);
+        cmd.addVariable("CASCADE_EVALUE", SSTR(par.cascadeEvalue).c_str());
+        cmd.addVariable("CASCADE_HITS", SSTR(par.cascadeHits).c_str());
+        cmd.addVariable("THREADS_COMP_PAR", par.createParameterString(par.threadsandcompression).c_str());
+        // hit counts are read from the uncompressed index
+        const int compressed = par.compressed;
+        par.compressed = 0;
+        cmd.addVariable("THREADS_PAR", par.createParameterString(par.threadsandcompression).c_str());
+        par.compressed = compressed;
     }
     cmd.addVariable("REMOVE_TMP", par.removeTmpFiles ? "TRUE" : NULL);
     cmd.addVariable("RUNNER", par.runner.c_str());
@@ -196,6 +335,7 @@ int structuresearch(int argc, const char **argv, const Command &command) {
         }
 
         cmd.addVariable("NUM_IT", SSTR(par.numIterations).c_str());
+        cmd.addVariable("INCREMENTAL", par.incrementalIterations ? "TRUE" : NULL);
         //do not used PROFILE
         //cmd.addVariable("PROFILE_PAR", par.createParameterString(par.result2structprofile).c_str());
         cmd.addVariable("VERBOSITY_THREADS_PAR", par.createParameterString(par.threadsandcompression).c_str());
@@ -244,6 +384,9 @@ int structuresearch(int argc, const char **argv, const Command &command) {
         }
         cmd.addVariable("MERGERESULTBYSET_PAR", par.createParameterString(par.mergeresultsbyset).c_str());
         cmd.addVariable("EXPAND", "1");
+        if (par.clusterSearchEvalue > 0.0 && (par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI_AA || par.alignmentType == LocalParameters::ALIGNMENT_TYPE_3DI)) {
+            cmd.addVariable("EXPAND_PAR", par.createParameterString(par.structureexpandaln).c_str());
+        }
     }
     cmd.execProgram(program.c_str(), par.filenames);
 